@@ -0,0 +1,289 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR=$(cd "$(dirname "$0")/.." && pwd)
+cd "$ROOT_DIR"
+
+usage() {
+  cat <<'USAGEEOF'
+Usage:
+  scripts/benchmark-io-engine.sh [--quick|--full] [--repeats N] [--engines LIST] [--image-size SIZE]
+
+Description:
+  Compare the data block I/O engines (-o io_engine=mmap|pread|direct) on
+  - large sequential write / read (1 MiB requests, fsync at the end)
+  - random 4 KiB read / write over the same file
+  Each engine gets a fresh image. Between the write and read phases the file
+  system is remounted and, when run as root, the host page cache is dropped.
+
+Options:
+  --engines LIST      Comma-separated engines (default: mmap,pread,direct)
+  --image-size SIZE   Image size passed to truncate (default: 4G quick, 16G full)
+USAGEEOF
+}
+
+PROFILE="quick"
+REPEATS=1
+ENGINES="mmap,pread,direct"
+IMAGE_SIZE=""
+
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    --quick)
+      PROFILE="quick"
+      shift
+      ;;
+    --full)
+      PROFILE="full"
+      shift
+      ;;
+    --repeats)
+      if [[ $# -lt 2 ]]; then
+        echo "missing value for --repeats" >&2
+        exit 2
+      fi
+      REPEATS="$2"
+      shift 2
+      ;;
+    --engines)
+      if [[ $# -lt 2 ]]; then
+        echo "missing value for --engines" >&2
+        exit 2
+      fi
+      ENGINES="$2"
+      shift 2
+      ;;
+    --image-size)
+      if [[ $# -lt 2 ]]; then
+        echo "missing value for --image-size" >&2
+        exit 2
+      fi
+      IMAGE_SIZE="$2"
+      shift 2
+      ;;
+    -h|--help)
+      usage
+      exit 0
+      ;;
+    *)
+      echo "unknown option: $1" >&2
+      usage
+      exit 2
+      ;;
+  esac
+done
+
+if ! [[ "$REPEATS" =~ ^[0-9]+$ ]] || [[ "$REPEATS" -lt 1 ]]; then
+  echo "invalid repeats: $REPEATS" >&2
+  exit 2
+fi
+
+if [[ "$PROFILE" == "quick" ]]; then
+  SEQ_MB=512
+  RAND_OPS=20000
+  IMAGE_SIZE=${IMAGE_SIZE:-4G}
+else
+  SEQ_MB=4096
+  RAND_OPS=200000
+  IMAGE_SIZE=${IMAGE_SIZE:-16G}
+fi
+
+WORKLOAD_TIMEOUT_SEC=${WORKLOAD_TIMEOUT_SEC:-600}
+
+KAFS_BIN="$ROOT_DIR/src/kafs"
+MKFS_BIN="$ROOT_DIR/src/mkfs.kafs"
+KAFSCTL_BIN="$ROOT_DIR/src/kafsctl"
+
+if [[ ! -x "$KAFS_BIN" || ! -x "$MKFS_BIN" ]]; then
+  echo "kafs/mkfs.kafs binaries are missing. Run make first." >&2
+  exit 2
+fi
+if ! command -v /usr/bin/time >/dev/null 2>&1; then
+  echo "/usr/bin/time not found" >&2
+  exit 2
+fi
+
+STAMP=$(date +%Y%m%d-%H%M%S)
+OUT_DIR="$ROOT_DIR/report/perf/io-engine-$STAMP"
+mkdir -p "$OUT_DIR"
+RESULT_CSV="$OUT_DIR/results.csv"
+SUMMARY_MD="$OUT_DIR/SUMMARY.md"
+echo "engine,repeat,workload,seconds,mib_per_s,status" >"$RESULT_CSV"
+
+TMP_BASE=$(mktemp -d "${TMPDIR:-/tmp}/kafs-io-engine.XXXXXX")
+KAFS_PID=""
+KAFS_MNT=""
+
+unmount_kafs() {
+  set +e
+  if [[ -n "${KAFS_MNT:-}" ]]; then
+    fusermount3 -u "$KAFS_MNT" 2>/dev/null || umount "$KAFS_MNT" 2>/dev/null || true
+  fi
+  if [[ -n "${KAFS_PID:-}" ]]; then
+    kill "$KAFS_PID" 2>/dev/null || true
+    wait "$KAFS_PID" 2>/dev/null || true
+  fi
+  KAFS_PID=""
+  set -e
+}
+
+cleanup_all() {
+  set +e
+  unmount_kafs
+  rm -rf "$TMP_BASE" 2>/dev/null || true
+}
+trap cleanup_all EXIT
+
+drop_host_cache() {
+  sync
+  if [[ -w /proc/sys/vm/drop_caches ]]; then
+    echo 3 >/proc/sys/vm/drop_caches 2>/dev/null || true
+  fi
+}
+
+mount_kafs() {
+  local engine="$1"
+  local img="$2"
+  local log="$3"
+  mkdir -p "$KAFS_MNT"
+  "$KAFS_BIN" --image "$img" "$KAFS_MNT" -f -s -o "io_engine=$engine" >>"$log" 2>&1 &
+  KAFS_PID=$!
+  for _ in {1..200}; do
+    if grep -Fq "$KAFS_MNT" /proc/mounts 2>/dev/null; then
+      chmod 777 "$KAFS_MNT" || true
+      return 0
+    fi
+    sleep 0.1
+  done
+  echo "mount failed for io_engine=$engine. see $log" >&2
+  return 1
+}
+
+record_result() {
+  local engine="$1" repeat="$2" workload="$3" sec="$4" mib="$5" status="$6"
+  local rate="NaN"
+  if [[ "$sec" =~ ^[0-9]+([.][0-9]+)?$ ]] && awk "BEGIN{exit !($sec > 0)}"; then
+    rate=$(awk "BEGIN{printf \"%.1f\", $mib / $sec}")
+  fi
+  echo "$engine,$repeat,$workload,$sec,$rate,$status" >>"$RESULT_CSV"
+}
+
+run_timed() {
+  local engine="$1" repeat="$2" workload="$3" mib="$4"
+  shift 4
+  local sec_file="$OUT_DIR/.${engine}.${repeat}.${workload}.sec"
+  local log_file="$OUT_DIR/${engine}.r${repeat}.${workload}.log"
+  local status="ok"
+  if ! /usr/bin/time -f "%e" -o "$sec_file" timeout --preserve-status "$WORKLOAD_TIMEOUT_SEC" \
+    "$@" >"$log_file" 2>&1; then
+    status="fail"
+  fi
+  local sec
+  sec=$(grep -Eo '[0-9]+(\.[0-9]+)?' "$sec_file" 2>/dev/null | tail -n 1 || true)
+  record_result "$engine" "$repeat" "$workload" "${sec:-NaN}" "$mib" "$status"
+}
+
+RAND_IO_PY="$TMP_BASE/rand_io.py"
+cat >"$RAND_IO_PY" <<'PY'
+import os
+import random
+import sys
+
+mode, path, ops = sys.argv[1], sys.argv[2], int(sys.argv[3])
+chunk = 4096
+blocks = max(1, os.path.getsize(path) // chunk)
+r = random.Random(4242)
+buf = r.randbytes(chunk)
+fd = os.open(path, os.O_RDWR if mode == "write" else os.O_RDONLY)
+try:
+    for _ in range(ops):
+        off = r.randrange(blocks) * chunk
+        if mode == "write":
+            os.pwrite(fd, buf, off)
+        else:
+            os.pread(fd, chunk, off)
+    if mode == "write":
+        os.fsync(fd)
+finally:
+    os.close(fd)
+PY
+
+RAND_MIB=$(awk "BEGIN{printf \"%.3f\", $RAND_OPS * 4096 / 1048576}")
+
+echo "[bench] profile=$PROFILE repeats=$REPEATS engines=$ENGINES image=$IMAGE_SIZE"
+echo "[bench] seq=${SEQ_MB}MiB rand_ops=$RAND_OPS output=$OUT_DIR"
+
+IFS=',' read -r -a ENGINE_LIST <<<"$ENGINES"
+for engine in "${ENGINE_LIST[@]}"; do
+  for r in $(seq 1 "$REPEATS"); do
+    img="$TMP_BASE/${engine}.img"
+    log="$OUT_DIR/${engine}.r${r}.kafs.log"
+    KAFS_MNT="$TMP_BASE/${engine}.mnt"
+    rm -f "$img"
+    truncate -s "$IMAGE_SIZE" "$img"
+    "$MKFS_BIN" "$img" >/dev/null 2>&1
+
+    mount_kafs "$engine" "$img" "$log" || {
+      record_result "$engine" "$r" "mount" "NaN" 0 "fail"
+      unmount_kafs
+      continue
+    }
+    run_timed "$engine" "$r" "seq_write" "$SEQ_MB" \
+      dd if=/dev/urandom of="$KAFS_MNT/seq.bin" bs=1M count="$SEQ_MB" conv=fsync status=none
+    unmount_kafs
+    drop_host_cache
+
+    mount_kafs "$engine" "$img" "$log"
+    run_timed "$engine" "$r" "seq_read" "$SEQ_MB" \
+      dd if="$KAFS_MNT/seq.bin" of=/dev/null bs=1M status=none
+    unmount_kafs
+    drop_host_cache
+
+    mount_kafs "$engine" "$img" "$log"
+    run_timed "$engine" "$r" "rand_read_4k" "$RAND_MIB" \
+      python3 "$RAND_IO_PY" read "$KAFS_MNT/seq.bin" "$RAND_OPS"
+    run_timed "$engine" "$r" "rand_write_4k" "$RAND_MIB" \
+      python3 "$RAND_IO_PY" write "$KAFS_MNT/seq.bin" "$RAND_OPS"
+    if [[ -x "$KAFSCTL_BIN" ]]; then
+      "$KAFSCTL_BIN" fsstat "$KAFS_MNT" --json >"$OUT_DIR/${engine}.r${r}.fsstat.json" 2>/dev/null ||
+        true
+    fi
+    unmount_kafs
+    rm -f "$img"
+  done
+done
+
+python3 - "$RESULT_CSV" >"$SUMMARY_MD" <<'PY'
+import csv
+import statistics
+import sys
+from collections import defaultdict
+
+rows = list(csv.DictReader(open(sys.argv[1], encoding="utf-8")))
+rates = defaultdict(list)
+engines = []
+workloads = []
+for row in rows:
+    if row["engine"] not in engines:
+        engines.append(row["engine"])
+    if row["workload"] not in workloads and row["workload"] != "mount":
+        workloads.append(row["workload"])
+    if row["status"] == "ok" and row["mib_per_s"] != "NaN":
+        rates[(row["engine"], row["workload"])].append(float(row["mib_per_s"]))
+
+print("# I/O engine benchmark (median MiB/s)")
+print()
+print("| workload | " + " | ".join(engines) + " |")
+print("|---|" + "---|" * len(engines))
+for w in workloads:
+    cells = []
+    for e in engines:
+        v = rates.get((e, w))
+        cells.append(f"{statistics.median(v):.1f}" if v else "N/A")
+    print(f"| {w} | " + " | ".join(cells) + " |")
+PY
+
+echo
+cat "$SUMMARY_MD"
+echo
+echo "Full results: $RESULT_CSV"
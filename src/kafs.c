@@ -2,6 +2,17 @@
 #include "kafs_context.h"
 #include "kafs_superblock.h"
 #include "kafs_block.h"
+#include "kafs_prealloc.h"
+#include "kafs_dirty.h"
+#include "kafs_meta_map.h"
+#include "kafs_bgsched.h"
+#include "kafs_reclaimq.h"
+#include "kafs_dedup_log.h"
+#include "kafs_dedup_policy.h"
+#include "kafs_cblk.h"
+#include "kafs_bcache.h"
+#include "kafs_pendinglog.h"
+#include "kafs_sparse.h"
 #include "kafs_inode.h"
 #include "kafs_dirent.h"
 #include "kafs_hash.h"
@@ -9,7 +20,10 @@
 #include "kafs_cli_opts.h"
 #include "kafs_ioctl.h"
 #include "kafs_mmap_io.h"
+#include "kafs_io_engine.h"
+#include "kafs_mem_budget.h"
 #include "kafs_rpc.h"
+#include "kafs_rpc_shm.h"
 #include "kafs_core.h"
 #include "kafs_crash_diag.h"
 #include "kafs_tailmeta.h"
@@ -123,6 +137,9 @@ static void kafs_count_superblock_inode_free_wtime_write(struct kafs_context *ct
                                 sizeof(ctx->c_superblock->s_wtime));
 }
 
+// Inode that owns the blocks this thread writes (dirty-range attribution, kafs_dirty.h).
+static __thread uint32_t g_dirty_owner_ino = KAFS_INO_NONE;
+
 #define KAFS_DIAG_CREATE_PATH_MAX 160u
 
 #if KAFS_ENABLE_EXTRA_DIAG
@@ -476,10 +493,12 @@ static void kafs_diag_note_create_event(struct kafs_context *ctx, kafs_inocnt_t
 #define KAFS_PENDING_REF_FLAG 0x80000000u
 #define KAFS_PENDING_REF_MASK 0x7fffffffu
 #define KAFS_PENDINGLOG_CAPACITY_FLOOR 2u
-#define KAFS_TOMBSTONE_GC_INTERVAL_MS_DEFAULT 1000u
-#define KAFS_TOMBSTONE_GC_PRESSURE_INTERVAL_MS_DEFAULT 100u
+#define KAFS_PENDING_WORKERS_DEFAULT 2u
+#define KAFS_PENDING_WORKER_BATCH 32u // 実行器の 1 回で 1 シャードが解決する上限
 #define KAFS_TOMBSTONE_GC_SCAN_BUDGET_DEFAULT 64u
 #define KAFS_TOMBSTONE_GC_SCAN_BUDGET_PRESSURE 512u
+#define KAFS_TOMBSTONE_GC_VISIT_FACTOR 4u // open のまま先頭に居座る tombstone を飛ばす上限
+#define KAFS_TOMBSTONE_SWEEP_CHUNK 4096u  // マウント時の走査で 1 回に見る inode 数
 #define KAFS_TOMBSTONE_GC_PRESSURE_FREE_INODES_MIN 4u
 #define KAFS_TOMBSTONE_GC_PRESSURE_FREE_INODES_PCT 5u
 #define KAFS_BG_DEDUP_INTERVAL_MS_DEFAULT 2000u
@@ -500,6 +519,8 @@ static void kafs_diag_note_create_event(struct kafs_context *ctx, kafs_inocnt_t
 #define KAFS_BG_DEDUP_SWEEP_IDX_CAP_DEFAULT 256u
 #define KAFS_BG_DEDUP_SWEEP_IDX_CAP_PRESSURE 1024u
 #define KAFS_BG_DEDUP_SWEEP_BUCKETS 2048u
+#define KAFS_BG_DEDUP_LOG_CAP 16384u        // 書き込みログの件数（溢れたら inode 表を巡回）
+#define KAFS_BG_DEDUP_LOG_VISIT_FACTOR 8u  // 1 step で取り出す件数の上限 = block budget × これ
 #define KAFS_HRL_RESCUE_RECENT_CAP 64u
 
 #define KAFS_BG_DEDUP_MODE_COLD 1u
@@ -518,41 +539,6 @@ static void kafs_fuse_log_func(enum fuse_log_level level, const char *fmt, va_li
   vfprintf(stderr, fmt, ap);
 }
 
-enum
-{
-  KAFS_PENDING_QUEUED = 1,
-  KAFS_PENDING_HASHED = 2,
-  KAFS_PENDING_RESOLVED = 3,
-  KAFS_PENDING_FAILED = 4,
-};
-
-typedef struct kafs_pendinglog_hdr
-{
-  uint32_t magic;
-  uint16_t version;
-  uint16_t flags;
-  uint32_t entry_size;
-  uint32_t capacity;
-  uint32_t head;
-  uint32_t tail;
-  uint64_t next_pending_id;
-  uint64_t last_seq;
-  uint64_t reserved[4];
-} __attribute__((packed)) kafs_pendinglog_hdr_t;
-
-typedef struct kafs_pendinglog_entry
-{
-  uint64_t pending_id;
-  uint32_t ino;
-  uint32_t iblk;
-  uint32_t ino_epoch;
-  uint32_t temp_blo;
-  uint32_t state;
-  uint32_t target_hrid;
-  uint32_t reserved0;
-  uint64_t seq;
-} __attribute__((packed)) kafs_pendinglog_entry_t;
-
 typedef enum
 {
   KAFS_IBLKREF_FUNC_GET_RAW,
@@ -575,6 +561,44 @@ static int kafs_inode_is_tombstone(const kafs_sinode_t *inoent);
 static int kafs_v6_controlled_write_active(const kafs_context_t *ctx);
 static int kafs_try_reclaim_unlinked_inode_locked(struct kafs_context *ctx, kafs_inocnt_t ino,
                                                   int *reclaimed);
+static void kafs_tombstone_enqueue_locked(struct kafs_context *ctx, kafs_inocnt_t ino);
+static int kafs_apply_worker_priority_self(uint32_t prio_mode, int nice_value);
+
+/// @brief 前景（FUSE）操作の累積数。バックグラウンド実行器が予算を決めるのに使う。
+static uint64_t kafs_bg_fg_ops(void *arg)
+{
+  kafs_context_t *ctx = (kafs_context_t *)arg;
+  return kafs_stat_sum(ctx, KAFS_STAT_PREAD_CALLS) + kafs_stat_sum(ctx, KAFS_STAT_PWRITE_CALLS) +
+         kafs_stat_sum(ctx, KAFS_STAT_ACCESS_CALLS) +
+         kafs_stat_sum(ctx, KAFS_STAT_DIR_SNAPSHOT_CALLS);
+}
+
+/// @brief バックグラウンド作業を実行器に登録する（最初の登録でスレッドプールを起こす）
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static int kafs_bg_work_start(struct kafs_context *ctx, uint32_t id, const kafs_bg_work_t *w)
+{
+  if (!ctx->c_bgsched)
+  {
+    ctx->c_bgsched = kafs_bgsched_create(ctx->c_bg_threads, ctx->c_bg_busy_pct,
+                                         kafs_apply_worker_priority_self, kafs_bg_fg_ops, ctx);
+    if (!ctx->c_bgsched)
+      return errno ? -errno : -ENOMEM;
+  }
+  return kafs_bgsched_register(ctx->c_bgsched, id, w);
+}
+
+/// @brief 登録を外す（走っている回は待つ）。最後の 1 つならスレッドプールも止める。
+static void kafs_bg_work_stop(struct kafs_context *ctx, uint32_t id)
+{
+  if (!ctx->c_bgsched)
+    return;
+  kafs_bgsched_unregister(ctx->c_bgsched, id);
+  if (kafs_bgsched_registered(ctx->c_bgsched) == 0)
+  {
+    kafs_bgsched_destroy(ctx->c_bgsched);
+    ctx->c_bgsched = NULL;
+  }
+}
 
 static int kafs_pendinglog_region(struct kafs_context *ctx, uint64_t *off, uint64_t *size)
 {
@@ -785,14 +809,6 @@ static int kafs_pendinglog_read(struct kafs_context *ctx, uint32_t idx,
   return 0;
 }
 
-static uint32_t kafs_pendinglog_next_idx(const kafs_pendinglog_hdr_t *hdr, uint32_t idx)
-{
-  idx += 1u;
-  if (idx >= hdr->capacity)
-    idx = 0;
-  return idx;
-}
-
 static int kafs_pendinglog_find_by_id(struct kafs_context *ctx, uint64_t pending_id,
                                       kafs_pendinglog_entry_t *out)
 {
@@ -844,26 +860,65 @@ static uint32_t kafs_inode_epoch_get(struct kafs_context *ctx, uint32_t ino)
 {
   if (!ctx || !ctx->c_ino_epoch)
     return 0;
-  if (ino >= kafs_sb_inocnt_get(ctx->c_superblock))
-    return 0;
-  return __atomic_load_n(&ctx->c_ino_epoch[ino], __ATOMIC_RELAXED);
+  return kafs_sparse_u32_get(ctx->c_ino_epoch, ino);
 }
 
 static uint32_t kafs_inode_epoch_bump(struct kafs_context *ctx, uint32_t ino)
 {
   if (!ctx || !ctx->c_ino_epoch)
     return 0;
-  if (ino >= kafs_sb_inocnt_get(ctx->c_superblock))
+  uint32_t *slot = kafs_sparse_u32_slot(ctx->c_ino_epoch, ino);
+  if (!slot)
     return 0;
-  uint32_t v = __atomic_add_fetch(&ctx->c_ino_epoch[ino], 1u, __ATOMIC_RELAXED);
+  uint32_t v = __atomic_add_fetch(slot, 1u, __ATOMIC_RELAXED);
   if (v == 0)
   {
-    __atomic_store_n(&ctx->c_ino_epoch[ino], 1u, __ATOMIC_RELAXED);
+    __atomic_store_n(slot, 1u, __ATOMIC_RELAXED);
     v = 1u;
   }
   return v;
 }
 
+/// @brief inode の dedup 迂回状態語（ポリシー無効・確保失敗なら NULL）
+static uint32_t *kafs_dedup_policy_slot(struct kafs_context *ctx, uint32_t ino)
+{
+  if (!ctx || ctx->c_dedup_bypass_sample == 0)
+    return NULL;
+  return kafs_sparse_u32_slot(ctx->c_dedup_policy, ino);
+}
+
+/// @brief HRL に通したブロックの結果を inode の迂回ポリシーに数える
+static void kafs_dedup_policy_note_hrl(struct kafs_context *ctx, uint32_t ino, int hit)
+{
+  uint32_t *st = kafs_dedup_policy_slot(ctx, ino);
+  if (!st)
+    return;
+  switch (kafs_dedup_policy_note(st, ctx->c_dedup_bypass_sample, ctx->c_dedup_bypass_hit_pct, hit))
+  {
+  case KAFS_DEDUP_POLICY_NOTE_KEEP:
+    __atomic_add_fetch(&ctx->c_stat_dedup_bypass_keep, 1u, __ATOMIC_RELAXED);
+    break;
+  case KAFS_DEDUP_POLICY_NOTE_ENTER:
+    __atomic_add_fetch(&ctx->c_stat_dedup_bypass_enter, 1u, __ATOMIC_RELAXED);
+    break;
+  case KAFS_DEDUP_POLICY_NOTE_LEAVE:
+    __atomic_add_fetch(&ctx->c_stat_dedup_bypass_leave, 1u, __ATOMIC_RELAXED);
+    break;
+  default:
+    break;
+  }
+}
+
+/// @brief 最後の close で迂回状態を初期化する（次に開いた書き込みはまた標本から数える）
+static void kafs_dedup_policy_reset(struct kafs_context *ctx, uint32_t ino)
+{
+  if (!ctx || kafs_sparse_u32_get(ctx->c_dedup_policy, ino) == 0)
+    return;
+  uint32_t *st = kafs_sparse_u32_slot(ctx->c_dedup_policy, ino);
+  if (st)
+    __atomic_store_n(st, 0u, __ATOMIC_RELAXED);
+}
+
 static int kafs_ref_is_pending(kafs_blkcnt_t ref)
 {
   uint32_t raw = (uint32_t)ref;
@@ -918,13 +973,28 @@ static int kafs_ref_resolve_data_blo(struct kafs_context *ctx, kafs_blkcnt_t ref
   return 0;
 }
 
-static void kafs_pending_worker_notify(struct kafs_context *ctx)
+static uint32_t kafs_pending_worker_count(const struct kafs_context *ctx)
+{
+  return ctx->c_pending_workers ? ctx->c_pending_workers : 1u;
+}
+
+/// @brief ino のエントリを受け持つシャードの作業 id
+static uint32_t kafs_pending_worker_work_id(const struct kafs_context *ctx, uint32_t ino)
+{
+  return kafs_bg_work_pending_id(ino % kafs_pending_worker_count(ctx));
+}
+
+static void kafs_pending_worker_reprio_all(struct kafs_context *ctx)
+{
+  for (uint32_t i = 0; i < kafs_pending_worker_count(ctx); ++i)
+    kafs_bgsched_reprio(ctx->c_bgsched, kafs_bg_work_pending_id(i));
+}
+
+static void kafs_pending_worker_notify(struct kafs_context *ctx, uint32_t ino)
 {
   if (!ctx || !ctx->c_pending_worker_lock_init)
     return;
-  pthread_mutex_lock(&ctx->c_pending_worker_lock);
-  pthread_cond_signal(&ctx->c_pending_worker_cond);
-  pthread_mutex_unlock(&ctx->c_pending_worker_lock);
+  kafs_bgsched_kick(ctx->c_bgsched, kafs_pending_worker_work_id(ctx, ino), 0);
 }
 
 static void kafs_pending_worker_notify_all(struct kafs_context *ctx)
@@ -934,6 +1004,7 @@ static void kafs_pending_worker_notify_all(struct kafs_context *ctx)
   pthread_mutex_lock(&ctx->c_pending_worker_lock);
   pthread_cond_broadcast(&ctx->c_pending_worker_cond);
   pthread_mutex_unlock(&ctx->c_pending_worker_lock);
+  kafs_pending_worker_reprio_all(ctx);
 }
 
 static void kafs_pending_worker_watermarks(struct kafs_context *ctx, uint32_t *high_wm,
@@ -991,7 +1062,6 @@ static void kafs_pending_worker_apply_auto_boost(struct kafs_context *ctx, uint3
     {
       ctx->c_pending_worker_prio_mode = KAFS_PENDING_WORKER_PRIO_NORMAL;
       ctx->c_pending_worker_nice = 0;
-      ctx->c_pending_worker_prio_dirty = 1;
       ctx->c_pending_worker_auto_boosted = 1;
     }
     return;
@@ -1001,7 +1071,6 @@ static void kafs_pending_worker_apply_auto_boost(struct kafs_context *ctx, uint3
   {
     ctx->c_pending_worker_prio_mode = ctx->c_pending_worker_prio_base_mode;
     ctx->c_pending_worker_nice = ctx->c_pending_worker_nice_base;
-    ctx->c_pending_worker_prio_dirty = 1;
     ctx->c_pending_worker_auto_boosted = 0;
   }
 }
@@ -1025,6 +1094,8 @@ static void kafs_pending_worker_adjust_priority_locked(struct kafs_context *ctx)
   uint64_t oldest_age_ms = kafs_pending_worker_oldest_age_ms(ctx, hdr, qcnt);
   kafs_pending_worker_update_ttl_state(ctx, oldest_age_ms, &over_soft, &over_hard);
   kafs_pending_worker_apply_auto_boost(ctx, qcnt, high_wm, low_wm, over_soft);
+  // Near the high watermark or past the soft TTL: skip the foreground budget.
+  ctx->c_pending_worker_urgent = (qcnt >= high_wm || over_soft) ? 1u : 0u;
 }
 
 static void kafs_pending_worker_begin_boost(struct kafs_context *ctx, uint32_t *saved_mode,
@@ -1051,11 +1122,11 @@ static void kafs_pending_worker_begin_boost(struct kafs_context *ctx, uint32_t *
   {
     ctx->c_pending_worker_prio_mode = KAFS_PENDING_WORKER_PRIO_NORMAL;
     ctx->c_pending_worker_nice = 0;
-    ctx->c_pending_worker_prio_dirty = 1;
-    pthread_cond_signal(&ctx->c_pending_worker_cond);
     *changed = 1;
   }
   pthread_mutex_unlock(&ctx->c_pending_worker_lock);
+  if (*changed)
+    kafs_pending_worker_reprio_all(ctx);
 }
 
 static void kafs_pending_worker_end_boost(struct kafs_context *ctx, uint32_t saved_mode,
@@ -1069,9 +1140,8 @@ static void kafs_pending_worker_end_boost(struct kafs_context *ctx, uint32_t sav
   pthread_mutex_lock(&ctx->c_pending_worker_lock);
   ctx->c_pending_worker_prio_mode = saved_mode;
   ctx->c_pending_worker_nice = saved_nice;
-  ctx->c_pending_worker_prio_dirty = 1;
-  pthread_cond_signal(&ctx->c_pending_worker_cond);
   pthread_mutex_unlock(&ctx->c_pending_worker_lock);
+  kafs_pending_worker_reprio_all(ctx);
 }
 
 static int kafs_pendinglog_inode_state_locked(struct kafs_context *ctx, uint32_t ino,
@@ -1136,7 +1206,8 @@ static int kafs_pendinglog_drain_inode(struct kafs_context *ctx, uint32_t ino)
       return 0;
     }
 
-    pthread_cond_signal(&ctx->c_pending_worker_cond);
+    // Someone is waiting on this inode: run its shard now, past the foreground budget.
+    kafs_bgsched_kick(ctx->c_bgsched, kafs_pending_worker_work_id(ctx, ino), 1);
     int tw =
         pthread_cond_timedwait(&ctx->c_pending_worker_cond, &ctx->c_pending_worker_lock, &deadline);
     if (tw == ETIMEDOUT)
@@ -1287,8 +1358,9 @@ static int kafs_pendinglog_replay_mount(struct kafs_context *ctx)
 
   if (replay_requeued || replay_dropped)
   {
-    kafs_journal_note(ctx, "PENDINGLOG", "replay: requeued=%u dropped=%u remain=%u",
-                      replay_requeued, replay_dropped, kafs_pendinglog_count(ctx));
+    kafs_journal_note(ctx, KJ_OP_PENDINGLOG, KJ_F_REASON, "replay", KJ_F_REQUEUED,
+                      (unsigned)replay_requeued, KJ_F_DROPPED, (unsigned)replay_dropped,
+                      KJ_F_ENTRIES, (unsigned)kafs_pendinglog_count(ctx), KJ_F_END);
   }
   return 0;
 }
@@ -1437,31 +1509,6 @@ static int kafs_apply_worker_priority_self(uint32_t prio_mode, int nice_value)
   return err;
 }
 
-static int kafs_pending_worker_apply_priority_self(kafs_context_t *ctx)
-{
-  if (!ctx)
-    return -EINVAL;
-
-  int err =
-      kafs_apply_worker_priority_self(ctx->c_pending_worker_prio_mode, ctx->c_pending_worker_nice);
-
-  ctx->c_pending_worker_prio_apply_error = err;
-  ctx->c_pending_worker_prio_dirty = 0;
-  return err;
-}
-
-static int kafs_bg_dedup_worker_apply_priority_self(kafs_context_t *ctx)
-{
-  if (!ctx)
-    return -EINVAL;
-
-  int err = kafs_apply_worker_priority_self(ctx->c_bg_dedup_worker_prio_mode,
-                                            ctx->c_bg_dedup_worker_nice);
-  ctx->c_bg_dedup_worker_prio_apply_error = err;
-  ctx->c_bg_dedup_worker_prio_dirty = 0;
-  return err;
-}
-
 // Keep a tiny rolling cache to cheaply spot DIRECT duplicates that are not yet in HRL.
 static uint64_t kafs_bg_hash64(const void *buf, size_t len)
 {
@@ -1630,7 +1677,7 @@ static int kafs_hrl_try_enospc_rescue(struct kafs_context *ctx, const void *buf,
   kafs_blksize_t bs = kafs_sb_blksize_get(ctx->c_superblock);
   uint64_t fast = kafs_bg_hash64(buf, bs);
 
-  __atomic_add_fetch(&ctx->c_stat_hrl_rescue_attempts, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_RESCUE_ATTEMPTS, 1u);
   kafs_blkcnt_t nucleus = kafs_hrl_rescue_recent_find_dup_blo(ctx, fast, buf);
   if (nucleus == KAFS_BLO_NONE)
     return -ENOENT;
@@ -1638,7 +1685,7 @@ static int kafs_hrl_try_enospc_rescue(struct kafs_context *ctx, const void *buf,
   kafs_blkcnt_t evicted_blo = KAFS_BLO_NONE;
   if (kafs_hrl_evict_ref1_to_direct(ctx, &evicted_blo) != 0)
     return -ENOSPC;
-  __atomic_add_fetch(&ctx->c_stat_hrl_rescue_evicts, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_RESCUE_EVICTS, 1u);
 
   kafs_hrid_t hrid = 0;
   int is_new = 0;
@@ -1647,7 +1694,7 @@ static int kafs_hrl_try_enospc_rescue(struct kafs_context *ctx, const void *buf,
   if (rc != 0)
     return rc;
 
-  __atomic_add_fetch(&ctx->c_stat_hrl_rescue_hits, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_RESCUE_HITS, 1u);
   *out_blo = new_blo;
   *out_is_new = is_new;
   return 0;
@@ -1768,7 +1815,10 @@ static int kafs_bg_dedup_try_install(struct kafs_context *ctx, uint32_t ino, kaf
         {
           kafs_blkcnt_t set_blo = new_blo;
           if (kafs_ino_ibrk_run(ctx, inoent, iblk, &set_blo, KAFS_IBLKREF_FUNC_SET) == 0)
+          {
             installed = 1;
+            kafs_dirty_note(ctx, ino, new_blo);
+          }
         }
       }
     }
@@ -1786,11 +1836,35 @@ typedef struct kafs_bg_dedup_sweep_state
   uint32_t entry_count;
 } kafs_bg_dedup_sweep_state_t;
 
+/// @brief 巡回が 1 周した。書き込みログがあれば、以降はログの差分だけを見る。
+static void kafs_bg_dedup_sweep_done(struct kafs_context *ctx)
+{
+  if (!ctx->c_bg_dedup_log || !__atomic_load_n(&ctx->c_bg_dedup_sweep, __ATOMIC_RELAXED))
+    return;
+  __atomic_store_n(&ctx->c_bg_dedup_sweep, 0u, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ctx->c_stat_bg_dedup_sweeps, 1u, __ATOMIC_RELAXED);
+  kafs_log(KAFS_LOG_INFO, "kafs: bg dedup sweep done, following the write log only\n");
+}
+
+/// @brief 書き込みログが溢れた: 取りこぼした分を拾うため、今の位置から巡回を 1 周やり直す
+static void kafs_bg_dedup_sweep_rearm(struct kafs_context *ctx)
+{
+  if (__atomic_load_n(&ctx->c_bg_dedup_sweep, __ATOMIC_RELAXED))
+    return;
+  ctx->c_bg_dedup_anchor_valid = 0;
+  ctx->c_bg_dedup_anchor_advance_count = 0;
+  __atomic_store_n(&ctx->c_bg_dedup_sweep, 1u, __ATOMIC_RELAXED);
+  kafs_log(KAFS_LOG_INFO, "kafs: bg dedup write log overflowed, sweeping the inode table\n");
+}
+
 static void kafs_bg_dedup_advance_or_cooldown(struct kafs_context *ctx, kafs_inocnt_t inocnt,
                                               uint32_t next_iblk, int pressure_mode)
 {
   if (kafs_bg_advance_cursor(ctx, inocnt, next_iblk))
+  {
     kafs_bg_enter_cooldown(ctx, pressure_mode);
+    kafs_bg_dedup_sweep_done(ctx);
+  }
 }
 
 static void kafs_bg_dedup_sweep_state_init(kafs_bg_dedup_sweep_state_t *state)
@@ -1975,6 +2049,74 @@ static int kafs_bg_dedup_scan_inode(struct kafs_context *ctx, uint32_t ino, kafs
   return 0;
 }
 
+/// @brief 書き込みログの 1 件を確かめる。(ino, iblk) がまだ同じ direct ブロックを指していれば
+/// 読み出して HRL 全体・直近の direct ブロックと突き合わせる。
+/// @return 1: 突き合わせた, 0: 書き換え済みなどで見なかった
+static int kafs_bg_dedup_log_examine(struct kafs_context *ctx, const kafs_dedup_log_ent_t *e,
+                                     kafs_blksize_t bs, uint32_t sweep_cap, uint32_t block_budget,
+                                     uint32_t *scanned_blocks_this_step,
+                                     kafs_bg_dedup_sweep_state_t *sweep_state)
+{
+  if (e->dl_ino >= kafs_sb_inocnt_get(ctx->c_superblock))
+    return 0;
+
+  char buf[bs];
+  int live = 0;
+  kafs_blkcnt_t raw = KAFS_BLO_NONE;
+  kafs_blkcnt_t blo = KAFS_BLO_NONE;
+  kafs_inode_lock(ctx, e->dl_ino);
+  kafs_sinode_t *inoent = kafs_ctx_inode(ctx, e->dl_ino);
+  if (kafs_ino_get_usage(inoent) && !S_ISDIR(kafs_ino_mode_get(inoent)))
+  {
+    kafs_off_t size = kafs_ino_size_get(inoent);
+    kafs_iblkcnt_t iblocnt = (kafs_iblkcnt_t)((size + bs - 1) / bs);
+    if (size > KAFS_INODE_DIRECT_BYTES && e->dl_iblk < iblocnt &&
+        kafs_ino_ibrk_run(ctx, inoent, e->dl_iblk, &raw, KAFS_IBLKREF_FUNC_GET_RAW) == 0 &&
+        !kafs_ref_is_pending(raw) && kafs_ref_resolve_data_blo(ctx, raw, &blo) == 0 &&
+        blo == (kafs_blkcnt_t)e->dl_blo && kafs_blk_read(ctx, blo, buf) == 0)
+      live = 1;
+  }
+  kafs_inode_unlock(ctx, e->dl_ino);
+  if (!live)
+  {
+    __atomic_add_fetch(&ctx->c_stat_bg_dedup_log_stale, 1u, __ATOMIC_RELAXED);
+    return 0;
+  }
+
+  __atomic_add_fetch(&ctx->c_stat_bg_dedup_scanned_blocks, 1u, __ATOMIC_RELAXED);
+  (*scanned_blocks_this_step)++;
+  (void)kafs_bg_dedup_handle_scanned_block(ctx, e->dl_ino, (kafs_iblkcnt_t)e->dl_iblk, raw, blo,
+                                           buf, bs, sweep_cap, block_budget,
+                                           scanned_blocks_this_step, sweep_state);
+  return 1;
+}
+
+/// @brief 書き込みログを block budget ぶん消化する。書き換え済みの件は安いので数えないが、
+/// 1 step で取り出す件数は budget × KAFS_BG_DEDUP_LOG_VISIT_FACTOR までにする。
+static void kafs_bg_dedup_drain_log(struct kafs_context *ctx, kafs_blksize_t bs,
+                                    uint32_t sweep_cap, uint32_t block_budget,
+                                    uint32_t *scanned_blocks_this_step,
+                                    kafs_bg_dedup_sweep_state_t *sweep_state)
+{
+  kafs_dedup_log_ent_t ents[KAFS_BG_DEDUP_BLOCK_BUDGET_PRESSURE];
+  uint32_t taken = 0;
+  uint32_t max_take = block_budget * KAFS_BG_DEDUP_LOG_VISIT_FACTOR;
+  while (*scanned_blocks_this_step < block_budget && taken < max_take)
+  {
+    uint32_t want = block_budget - *scanned_blocks_this_step;
+    if (want > max_take - taken)
+      want = max_take - taken;
+    uint32_t n = kafs_dedup_log_take(ctx->c_bg_dedup_log, ents, want);
+    if (n == 0)
+      break;
+    taken += n;
+    __atomic_add_fetch(&ctx->c_stat_bg_dedup_log_consumed, (uint64_t)n, __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i < n; ++i)
+      (void)kafs_bg_dedup_log_examine(ctx, &ents[i], bs, sweep_cap, block_budget,
+                                      scanned_blocks_this_step, sweep_state);
+  }
+}
+
 static void kafs_bg_dedup_step(struct kafs_context *ctx, int pressure_mode)
 {
   if (!ctx || !ctx->c_superblock)
@@ -1986,10 +2128,6 @@ static void kafs_bg_dedup_step(struct kafs_context *ctx, int pressure_mode)
   if (inocnt == 0)
     return;
 
-  uint64_t now_ns = kafs_now_ns();
-  if (!pressure_mode && ctx->c_bg_dedup_cooldown_until_ns > now_ns)
-    return;
-
   __atomic_add_fetch(&ctx->c_stat_bg_dedup_steps, 1u, __ATOMIC_RELAXED);
 
   kafs_blksize_t bs = kafs_sb_blksize_get(ctx->c_superblock);
@@ -2003,6 +2141,18 @@ static void kafs_bg_dedup_step(struct kafs_context *ctx, int pressure_mode)
   kafs_bg_dedup_sweep_state_t sweep_state;
   kafs_bg_dedup_sweep_state_init(&sweep_state);
 
+  // 新しく書いた direct ブロックを先に見る。巡回はログが無いか、取りこぼしがあるときだけ。
+  if (kafs_dedup_log_take_lost(ctx->c_bg_dedup_log))
+    kafs_bg_dedup_sweep_rearm(ctx);
+  kafs_bg_dedup_drain_log(ctx, bs, sweep_cap, block_budget, &scanned_blocks_this_step,
+                          &sweep_state);
+  if (ctx->c_bg_dedup_log && !__atomic_load_n(&ctx->c_bg_dedup_sweep, __ATOMIC_RELAXED))
+    return;
+  if (scanned_blocks_this_step >= block_budget)
+    return;
+  if (!pressure_mode && ctx->c_bg_dedup_cooldown_until_ns > kafs_now_ns())
+    return;
+
   for (kafs_inocnt_t scanned = 0; scanned < inocnt; ++scanned)
   {
     uint32_t ino = (ctx->c_bg_dedup_ino_cursor + scanned) % inocnt;
@@ -2013,10 +2163,16 @@ static void kafs_bg_dedup_step(struct kafs_context *ctx, int pressure_mode)
   }
 }
 
-static void kafs_pending_worker_record_exit(kafs_context_t *ctx);
-static int kafs_pending_worker_wait_next(kafs_context_t *ctx, uint32_t *idx,
-                                         kafs_pendinglog_entry_t *ent);
-static void kafs_pending_worker_skip_terminal_entry(kafs_context_t *ctx, uint32_t idx);
+// 解決シャード 1 本分（実行器の項目 1 つ）。走査位置は c_pending_worker_lock で守る。
+typedef struct kafs_pending_shard
+{
+  kafs_context_t *ps_ctx;
+  uint32_t ps_shard;
+  kafs_pending_cursor_t ps_cursor;
+} kafs_pending_shard_t;
+
+static int kafs_pending_worker_peek_next(kafs_context_t *ctx, kafs_pending_shard_t *ps,
+                                         uint32_t *idx, kafs_pendinglog_entry_t *ent);
 static int kafs_pending_worker_try_install_block(kafs_context_t *ctx,
                                                  const kafs_pendinglog_entry_t *ent,
                                                  kafs_blkcnt_t final_blo);
@@ -2025,39 +2181,30 @@ static void kafs_pending_worker_finalize_success(kafs_context_t *ctx, uint32_t i
                                                  kafs_hrid_t hrid, kafs_blkcnt_t final_blo,
                                                  int installed);
 static uint32_t kafs_pending_worker_note_retry(kafs_context_t *ctx, uint32_t idx);
-static void kafs_pending_worker_backoff(const kafs_context_t *ctx, uint32_t retry,
-                                        uint64_t entry_seq);
+static uint32_t kafs_pending_worker_backoff_ms(const kafs_context_t *ctx, uint32_t retry,
+                                               uint64_t entry_seq);
 
-static void *kafs_pending_worker_main(void *arg)
+/// @brief 実行器の 1 回分: このシャードの未解決エントリをログの順に最大
+/// KAFS_PENDING_WORKER_BATCH 件解決する。別シャードは別の項目として並行に走る。
+/// @return 次に走らせるまでの ms（空なら kick 待ち、失敗したらバックオフ）
+static uint32_t kafs_pending_work_run(void *arg, uint32_t *urgent)
 {
-  kafs_context_t *ctx = (kafs_context_t *)arg;
-  if (!ctx)
-    return NULL;
-
-  __atomic_store_n(&ctx->c_stat_pending_worker_lwp_tid, (int32_t)syscall(SYS_gettid),
-                   __ATOMIC_RELAXED);
-  __atomic_add_fetch(&ctx->c_stat_pending_worker_main_entries, 1u, __ATOMIC_RELAXED);
-
-  (void)kafs_pending_worker_apply_priority_self(ctx);
+  kafs_pending_shard_t *ps = (kafs_pending_shard_t *)arg;
+  kafs_context_t *ctx = ps->ps_ctx;
+  kafs_blksize_t blksize = kafs_sb_blksize_get(ctx->c_superblock);
+  char buf[blksize];
 
-  for (;;)
+  for (uint32_t n = 0; n < KAFS_PENDING_WORKER_BATCH; ++n)
   {
     uint32_t idx = 0;
     kafs_pendinglog_entry_t ent;
-    if (kafs_pending_worker_wait_next(ctx, &idx, &ent) != 0)
-      return NULL;
+    if (kafs_pending_worker_peek_next(ctx, ps, &idx, &ent) != 0)
+      return KAFS_BG_WAIT_KICK;
 
-    if (ctx->c_pending_worker_prio_dirty)
-      (void)kafs_pending_worker_apply_priority_self(ctx);
+    __atomic_store_n(&ctx->c_stat_pending_worker_lwp_tid, (int32_t)syscall(SYS_gettid),
+                     __ATOMIC_RELAXED);
+    *urgent = ctx->c_pending_worker_urgent;
 
-    if (ent.state == KAFS_PENDING_RESOLVED || ent.state == KAFS_PENDING_FAILED)
-    {
-      kafs_pending_worker_skip_terminal_entry(ctx, idx);
-      continue;
-    }
-
-    kafs_blksize_t blksize = kafs_sb_blksize_get(ctx->c_superblock);
-    char buf[blksize];
     int rc = kafs_blk_read(ctx, (kafs_blkcnt_t)ent.temp_blo, buf);
     if (rc == 0)
     {
@@ -2065,74 +2212,61 @@ static void *kafs_pending_worker_main(void *arg)
       int is_new = 0;
       kafs_blkcnt_t final_blo = KAFS_BLO_NONE;
       int installed = 0;
-      ctx->c_stat_hrl_put_calls++;
+      kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_CALLS, 1);
       uint64_t t0 = kafs_now_ns();
       rc = kafs_hrl_put(ctx, buf, &hrid, &is_new, &final_blo);
       uint64_t t1 = kafs_now_ns();
-      __atomic_add_fetch(&ctx->c_stat_iblk_write_ns_hrl_put, t1 - t0, __ATOMIC_RELAXED);
+      kafs_stat_add(ctx, KAFS_STAT_IBLK_WRITE_NS_HRL_PUT, t1 - t0);
       if (rc == 0)
       {
         if (is_new)
-          ctx->c_stat_hrl_put_misses++;
+          kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_MISSES, 1);
         else
-          ctx->c_stat_hrl_put_hits++;
+          kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_HITS, 1);
 
         installed = kafs_pending_worker_try_install_block(ctx, &ent, final_blo);
+        // 取り付けられなかった（書き換え済みの）ブロックは今のファイル内容ではないので数えない。
+        if (installed)
+          kafs_dedup_policy_note_hrl(ctx, ent.ino, !is_new);
         kafs_pending_worker_finalize_success(ctx, idx, &ent, hrid, final_blo, installed);
         continue;
       }
     }
 
+    // 同じ inode の後続を先に解決しないよう、このシャードは失敗したエントリで止まる。
     uint32_t retry = kafs_pending_worker_note_retry(ctx, idx);
-    kafs_pending_worker_backoff(ctx, retry, ent.seq);
+    return kafs_pending_worker_backoff_ms(ctx, retry, ent.seq);
   }
+  return 0;
 }
 
-static void kafs_pending_worker_record_exit(kafs_context_t *ctx)
-{
-  __atomic_store_n(&ctx->c_stat_pending_worker_lwp_tid, 0, __ATOMIC_RELAXED);
-  __atomic_add_fetch(&ctx->c_stat_pending_worker_main_exits, 1u, __ATOMIC_RELAXED);
-}
-
-static int kafs_pending_worker_wait_next(kafs_context_t *ctx, uint32_t *idx,
-                                         kafs_pendinglog_entry_t *ent)
+static int kafs_pending_worker_peek_next(kafs_context_t *ctx, kafs_pending_shard_t *ps,
+                                         uint32_t *idx, kafs_pendinglog_entry_t *ent)
 {
+  int rc = -ENOENT;
   pthread_mutex_lock(&ctx->c_pending_worker_lock);
-  for (;;)
+  kafs_pendinglog_hdr_t *hdr = kafs_pendinglog_hdr_ptr(ctx);
+  if (!ctx->c_pending_worker_stop && hdr && hdr->capacity > 0)
   {
-    kafs_pendinglog_hdr_t *hdr = kafs_pendinglog_hdr_ptr(ctx);
-    if (ctx->c_pending_worker_stop)
+    // マウント時の replay が途中に残した終わったエントリもここで外れる。
+    if (kafs_pendinglog_trim_done(hdr) > 0)
     {
-      pthread_mutex_unlock(&ctx->c_pending_worker_lock);
-      kafs_pending_worker_record_exit(ctx);
-      return -1;
+      kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_PENDING_LOG, sizeof(*hdr));
+      kafs_pending_worker_adjust_priority_locked(ctx);
     }
-    if (hdr && hdr->capacity > 0 && hdr->head != hdr->tail)
+    if (kafs_pending_shard_next(hdr, ps->ps_shard, kafs_pending_worker_count(ctx),
+                                &ps->ps_cursor, idx) == 0)
     {
-      *idx = hdr->head;
       kafs_pendinglog_entry_t *slot = kafs_pendinglog_entry_ptr(ctx, *idx);
       if (slot)
       {
         *ent = *slot;
-        pthread_mutex_unlock(&ctx->c_pending_worker_lock);
-        return 0;
+        rc = 0;
       }
     }
-    pthread_cond_wait(&ctx->c_pending_worker_cond, &ctx->c_pending_worker_lock);
-  }
-}
-
-static void kafs_pending_worker_skip_terminal_entry(kafs_context_t *ctx, uint32_t idx)
-{
-  pthread_mutex_lock(&ctx->c_pending_worker_lock);
-  kafs_pendinglog_hdr_t *hdr = kafs_pendinglog_hdr_ptr(ctx);
-  if (hdr && hdr->capacity > 0 && hdr->head == idx)
-  {
-    hdr->head = kafs_pendinglog_next_idx(hdr, hdr->head);
-    kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_PENDING_LOG, sizeof(*hdr));
   }
-  kafs_pending_worker_adjust_priority_locked(ctx);
   pthread_mutex_unlock(&ctx->c_pending_worker_lock);
+  return rc;
 }
 
 static int kafs_pending_worker_try_install_block(kafs_context_t *ctx,
@@ -2164,6 +2298,7 @@ static int kafs_pending_worker_try_install_block(kafs_context_t *ctx,
           {
             installed = 1;
             kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_INODE_TABLE, kafs_ctx_inode_bytes(ctx));
+            kafs_dirty_note(ctx, ent->ino, final_blo);
           }
         }
       }
@@ -2186,7 +2321,7 @@ static void kafs_pending_worker_finalize_success(kafs_context_t *ctx, uint32_t i
     (void)kafs_inode_release_hrl_ref(ctx, old_blo);
     __atomic_add_fetch(&ctx->c_stat_pending_old_block_freed, 1u, __ATOMIC_RELAXED);
     uint64_t t_dec1 = kafs_now_ns();
-    __atomic_add_fetch(&ctx->c_stat_iblk_write_ns_dec_ref, t_dec1 - t_dec0, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_IBLK_WRITE_NS_DEC_REF, t_dec1 - t_dec0);
   }
 
   if (!installed && final_blo != KAFS_BLO_NONE && final_blo != (kafs_blkcnt_t)ent->temp_blo)
@@ -2204,8 +2339,9 @@ static void kafs_pending_worker_finalize_success(kafs_context_t *ctx, uint32_t i
     __atomic_add_fetch(&ctx->c_stat_pending_resolved, 1u, __ATOMIC_RELAXED);
     slot->target_hrid = (uint32_t)hrid;
     slot->reserved0 = 0;
-    if (hdr->head == idx)
-      hdr->head = kafs_pendinglog_next_idx(hdr, hdr->head);
+    if (hdr->head != idx)
+      __atomic_add_fetch(&ctx->c_stat_pending_resolved_ahead, 1u, __ATOMIC_RELAXED);
+    (void)kafs_pendinglog_trim_done(hdr);
     kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_PENDING_LOG, sizeof(*slot) + sizeof(*hdr));
   }
   kafs_pending_worker_adjust_priority_locked(ctx);
@@ -2228,8 +2364,8 @@ static uint32_t kafs_pending_worker_note_retry(kafs_context_t *ctx, uint32_t idx
     if (retry >= 32u)
     {
       slot->state = KAFS_PENDING_FAILED;
-      if (hdr && hdr->head == idx)
-        hdr->head = kafs_pendinglog_next_idx(hdr, hdr->head);
+      if (hdr)
+        (void)kafs_pendinglog_trim_done(hdr);
     }
     kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_PENDING_LOG,
                               sizeof(*slot) + (hdr ? sizeof(*hdr) : 0u));
@@ -2240,11 +2376,11 @@ static uint32_t kafs_pending_worker_note_retry(kafs_context_t *ctx, uint32_t idx
   return retry;
 }
 
-static void kafs_pending_worker_backoff(const kafs_context_t *ctx, uint32_t retry,
-                                        uint64_t entry_seq)
+static uint32_t kafs_pending_worker_backoff_ms(const kafs_context_t *ctx, uint32_t retry,
+                                               uint64_t entry_seq)
 {
   if (retry == 0)
-    return;
+    return 0;
 
   int hard_ttl_exceeded = 0;
   if (ctx->c_pending_ttl_hard_ms > 0 && entry_seq > 0)
@@ -2265,12 +2401,7 @@ static void kafs_pending_worker_backoff(const kafs_context_t *ctx, uint32_t retr
       retry = 6u;
     backoff_ms = 1u << retry;
   }
-
-  struct timespec ts = {
-      .tv_sec = (time_t)(backoff_ms / 1000u),
-      .tv_nsec = (long)((backoff_ms % 1000u) * 1000000u),
-  };
-  nanosleep(&ts, NULL);
+  return backoff_ms;
 }
 
 static int kafs_pending_worker_start(struct kafs_context *ctx)
@@ -2300,19 +2431,54 @@ static int kafs_pending_worker_start(struct kafs_context *ctx)
     ctx->c_pending_worker_lock_init = 1;
   }
 
+  uint32_t nshards = kafs_pending_worker_count(ctx);
+  if (nshards > KAFS_BG_PENDING_SHARDS_MAX)
+    nshards = KAFS_BG_PENDING_SHARDS_MAX;
+  ctx->c_pending_workers = nshards;
+  ctx->c_pending_shards = (kafs_pending_shard_t *)calloc(nshards, sizeof(kafs_pending_shard_t));
+  if (!ctx->c_pending_shards)
+  {
+    __atomic_add_fetch(&ctx->c_stat_pending_worker_start_failures, 1u, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctx->c_stat_pending_worker_start_last_error, -ENOMEM, __ATOMIC_RELAXED);
+    return -ENOMEM;
+  }
+
   ctx->c_pending_worker_stop = 0;
-  int prc = pthread_create(&ctx->c_pending_worker_tid, NULL, kafs_pending_worker_main, ctx);
+  ctx->c_pending_worker_running = 1;
+  int prc = 0;
+  uint32_t started = 0;
+  while (started < nshards)
+  {
+    kafs_pending_shard_t *ps = &ctx->c_pending_shards[started];
+    ps->ps_ctx = ctx;
+    ps->ps_shard = started;
+    const kafs_bg_work_t w = {
+        .w_order = 0,
+        .w_run = kafs_pending_work_run,
+        .w_arg = ps,
+        .w_prio_mode = &ctx->c_pending_worker_prio_mode,
+        .w_nice = &ctx->c_pending_worker_nice,
+        .w_prio_err = &ctx->c_pending_worker_prio_apply_error,
+    };
+    prc = kafs_bg_work_start(ctx, kafs_bg_work_pending_id(started), &w);
+    if (prc != 0)
+      break;
+    started++;
+  }
   if (prc != 0)
   {
+    for (uint32_t i = 0; i < started; ++i)
+      kafs_bg_work_stop(ctx, kafs_bg_work_pending_id(i));
+    free(ctx->c_pending_shards);
+    ctx->c_pending_shards = NULL;
+    ctx->c_pending_worker_running = 0;
     __atomic_add_fetch(&ctx->c_stat_pending_worker_start_failures, 1u, __ATOMIC_RELAXED);
-    __atomic_store_n(&ctx->c_stat_pending_worker_start_last_error, -prc, __ATOMIC_RELAXED);
-    return -prc;
+    __atomic_store_n(&ctx->c_stat_pending_worker_start_last_error, prc, __ATOMIC_RELAXED);
+    return prc;
   }
 
-  ctx->c_pending_worker_running = 1;
+  __atomic_add_fetch(&ctx->c_stat_pending_worker_main_entries, 1u, __ATOMIC_RELAXED);
   __atomic_store_n(&ctx->c_stat_pending_worker_start_last_error, 0, __ATOMIC_RELAXED);
-  if (kafs_pendinglog_count(ctx) > 0)
-    kafs_pending_worker_notify(ctx);
   return 0;
 }
 
@@ -2327,8 +2493,13 @@ static void kafs_pending_worker_stop(struct kafs_context *ctx)
     ctx->c_pending_worker_stop = 1;
     pthread_cond_broadcast(&ctx->c_pending_worker_cond);
     pthread_mutex_unlock(&ctx->c_pending_worker_lock);
-    pthread_join(ctx->c_pending_worker_tid, NULL);
+    for (uint32_t i = 0; i < ctx->c_pending_workers; ++i)
+      kafs_bg_work_stop(ctx, kafs_bg_work_pending_id(i));
+    free(ctx->c_pending_shards);
+    ctx->c_pending_shards = NULL;
     ctx->c_pending_worker_running = 0;
+    __atomic_store_n(&ctx->c_stat_pending_worker_lwp_tid, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ctx->c_stat_pending_worker_main_exits, 1u, __ATOMIC_RELAXED);
   }
 
   if (ctx->c_pending_worker_lock_init)
@@ -2384,36 +2555,119 @@ static int kafs_tombstone_pressure(kafs_context_t *ctx)
   return (uint64_t)inode_free <= free_floor;
 }
 
+// Whether unlink/rename/last release should reclaim a tombstone at once instead of queueing it.
+// Without a queue (kafs-back, or the queue could not be allocated) nothing would collect it later.
+static int kafs_tombstone_reclaim_now(kafs_context_t *ctx)
+{
+  if (ctx && ctx->c_superblock && !ctx->c_reclaimq)
+    return 1;
+  return kafs_tombstone_pressure(ctx);
+}
+
 static uint32_t kafs_bg_dedup_used_pct(kafs_context_t *ctx) { return kafs_fs_used_pct(ctx); }
 
-static uint32_t kafs_tombstone_gc_step(struct kafs_context *ctx, int pressure_mode)
+static uint64_t kafs_tombstone_dtime_key(void *arg, uint32_t ino)
 {
-  if (!ctx || !ctx->c_superblock)
-    return 0;
+  kafs_context_t *ctx = (kafs_context_t *)arg;
+  kafs_time_t dt = kafs_ino_dtime_get(kafs_ctx_inode(ctx, ino));
+  return (uint64_t)dt.tv_sec * 1000000000ull + (uint64_t)dt.tv_nsec;
+}
 
+static int kafs_tombstone_is_open(void *arg, uint32_t ino)
+{
+  kafs_context_t *ctx = (kafs_context_t *)arg;
+  return kafs_sparse_u32_get(ctx->c_open_cnt, ino) != 0;
+}
+
+// Requires: caller holds inode lock for ino.
+static void kafs_tombstone_enqueue_locked(struct kafs_context *ctx, kafs_inocnt_t ino)
+{
+  if (!ctx->c_reclaimq)
+  {
+    __atomic_store_n(&ctx->c_tombstone_untracked, 1u, __ATOMIC_RELAXED);
+    return;
+  }
+  int rc = kafs_reclaimq_push(ctx->c_reclaimq, (uint32_t)ino, 0);
+  if (rc < 0)
+  {
+    // 載せられなかった分は次回マウントの走査で拾う（ヒントを書かずにアンマウントする）。
+    __atomic_store_n(&ctx->c_tombstone_untracked, 1u, __ATOMIC_RELAXED);
+    kafs_log(KAFS_LOG_WARNING, "%s: reclaim queue push failed ino=%" PRIuFAST32 " rc=%d\n",
+             __func__, (uint32_t)ino, rc);
+    return;
+  }
+  if (!kafs_tombstone_is_open(ctx, (uint32_t)ino))
+    kafs_bgsched_kick(ctx->c_bgsched, KAFS_BG_WORK_TOMBSTONE_GC, 0);
+}
+
+/// @brief マウント時の走査を 1 チャンク進め、前回のキューを inode 表から拾い直す。
+/// ロックなしで当たりを付け、積む前に inode ロックを取って確かめる。見つけた分は今回のマウントで
+/// 積んだ分より古いので先頭に積み、走査が終わったら dtime 順に並べ直す。
+static void kafs_tombstone_sweep_step(struct kafs_context *ctx)
+{
   const kafs_inocnt_t first_ino = KAFS_INO_ROOTDIR + 1u;
   kafs_inocnt_t inode_total = kafs_sb_inocnt_get(ctx->c_superblock);
-  if (inode_total <= first_ino)
-    return 0;
+  kafs_inocnt_t cursor = ctx->c_tombstone_gc_cursor;
+  if (cursor < first_ino)
+    cursor = first_ino;
+  kafs_inocnt_t end = cursor;
+  if (cursor < inode_total)
+    end = (inode_total - cursor > KAFS_TOMBSTONE_SWEEP_CHUNK) ? cursor + KAFS_TOMBSTONE_SWEEP_CHUNK
+                                                             : inode_total;
 
+  for (kafs_inocnt_t ino = cursor; ino < end && ctx->c_tombstone_sweep_left > 0; ++ino)
+  {
+    if (!kafs_inode_is_tombstone(kafs_ctx_inode(ctx, ino)))
+      continue;
+    int rc = 0;
+    kafs_inode_lock(ctx, (uint32_t)ino);
+    if (kafs_inode_is_tombstone(kafs_ctx_inode(ctx, ino)))
+      rc = kafs_reclaimq_push(ctx->c_reclaimq, (uint32_t)ino, 1);
+    kafs_inode_unlock(ctx, (uint32_t)ino);
+    if (rc < 0)
+      __atomic_store_n(&ctx->c_tombstone_untracked, 1u, __ATOMIC_RELAXED);
+    if (rc != 0 && ctx->c_tombstone_sweep_left != UINT32_MAX)
+      ctx->c_tombstone_sweep_left--;
+  }
+  __atomic_add_fetch(&ctx->c_stat_tombstone_sweep_scanned, (uint64_t)(end - cursor),
+                     __ATOMIC_RELAXED);
+  ctx->c_tombstone_gc_cursor = end;
+  if (end < inode_total && ctx->c_tombstone_sweep_left > 0)
+    return;
+
+  if (kafs_reclaimq_sort(ctx->c_reclaimq, kafs_tombstone_dtime_key, ctx) < 0)
+    __atomic_store_n(&ctx->c_tombstone_untracked, 1u, __ATOMIC_RELAXED);
+  uint32_t len = 0;
+  (void)kafs_reclaimq_peek(ctx->c_reclaimq, &len);
+  __atomic_store_n(&ctx->c_tombstone_sweep, 0u, __ATOMIC_RELEASE);
+  kafs_log(KAFS_LOG_INFO, "kafs: tombstone sweep done queued=%" PRIu32 " scanned=%" PRIu64 "\n",
+           len, __atomic_load_n(&ctx->c_stat_tombstone_sweep_scanned, __ATOMIC_RELAXED));
+}
+
+/// @brief キューの先頭から close 済みの tombstone を budget 個まで回収する
+/// @param more 予算を使い切った（まだ回収できるものが残っているかもしれない）
+static uint32_t kafs_tombstone_gc_step(struct kafs_context *ctx, int pressure_mode, int *more)
+{
+  uint32_t inos[KAFS_TOMBSTONE_GC_SCAN_BUDGET_PRESSURE];
   uint32_t budget = pressure_mode ? KAFS_TOMBSTONE_GC_SCAN_BUDGET_PRESSURE
                                   : KAFS_TOMBSTONE_GC_SCAN_BUDGET_DEFAULT;
-  kafs_inocnt_t cursor = ctx->c_tombstone_gc_cursor;
-  if (cursor < first_ino || cursor >= inode_total)
-    cursor = first_ino;
+  uint32_t visited = 0;
+  uint32_t n = kafs_reclaimq_collect(ctx->c_reclaimq, inos, budget,
+                                     budget * KAFS_TOMBSTONE_GC_VISIT_FACTOR,
+                                     kafs_tombstone_is_open, ctx, &visited);
+  __atomic_add_fetch(&ctx->c_stat_tombstone_gc_visits, (uint64_t)visited, __ATOMIC_RELAXED);
+  *more = (n == budget);
 
   uint32_t reclaimed = 0;
-  for (uint32_t scanned = 0; scanned < budget; ++scanned)
+  for (uint32_t i = 0; i < n; ++i)
   {
-    kafs_inocnt_t ino = cursor;
-    cursor++;
-    if (cursor >= inode_total)
-      cursor = first_ino;
-
+    kafs_inocnt_t ino = inos[i];
     int reclaimed_now = 0;
     kafs_inode_lock(ctx, (uint32_t)ino);
     if (kafs_inode_is_tombstone(kafs_ctx_inode(ctx, ino)))
       (void)kafs_try_reclaim_unlinked_inode_locked(ctx, ino, &reclaimed_now);
+    else
+      (void)kafs_reclaimq_remove(ctx->c_reclaimq, (uint32_t)ino);
     kafs_inode_unlock(ctx, (uint32_t)ino);
 
     if (reclaimed_now)
@@ -2426,59 +2680,80 @@ static uint32_t kafs_tombstone_gc_step(struct kafs_context *ctx, int pressure_mo
       reclaimed++;
     }
   }
-
-  ctx->c_tombstone_gc_cursor = cursor;
   return reclaimed;
 }
 
-static void kafs_timespec_after_ms(struct timespec *wake, uint32_t wait_ms)
+/// @brief 実行器の 1 回分: 走査中なら 1 チャンク進め、キューから回収する。
+/// 回収できるものが無くなったら unlink / 最後の close からの kick を待つ。
+static uint32_t kafs_tombstone_gc_work_run(void *arg, uint32_t *urgent)
 {
-  clock_gettime(CLOCK_REALTIME, wake);
-  wake->tv_nsec += (long)(wait_ms % 1000u) * 1000000l;
-  wake->tv_sec += (time_t)(wait_ms / 1000u);
-  if (wake->tv_nsec >= 1000000000l)
+  kafs_context_t *ctx = (kafs_context_t *)arg;
+  if (!ctx->c_reclaimq)
+    return KAFS_BG_WAIT_KICK;
+  int sweeping = __atomic_load_n(&ctx->c_tombstone_sweep, __ATOMIC_ACQUIRE) != 0;
+  if (sweeping)
+    kafs_tombstone_sweep_step(ctx);
+  int pressure_mode = kafs_tombstone_pressure(ctx);
+  int more = 0;
+  (void)kafs_tombstone_gc_step(ctx, pressure_mode, &more);
+  *urgent = pressure_mode ? 1u : 0u;
+  if (more || sweeping)
+    return pressure_mode ? 0u : 1u;
+  return KAFS_BG_WAIT_KICK;
+}
+
+/// @brief superblock のヒント欄を書き換えたあと、superblock のページだけを同期する
+static void kafs_sb_hint_sync(struct kafs_context *ctx, size_t bytes)
+{
+  kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_SUPERBLOCK_CHECKPOINT, bytes);
+  if (msync(ctx->c_img_base, (size_t)sysconf(_SC_PAGESIZE), MS_SYNC) != 0)
+    kafs_log(KAFS_LOG_WARNING, "kafs: superblock hint msync failed errno=%d\n", errno);
+}
+
+/// @brief 回収待ちキューを作り、superblock のヒントからマウント時の走査の要否を決める。
+/// ヒントはマウント中 0（不明）にしておき、途中で落ちたら次回は inode 表を走査し直す。
+/// イメージのロック（kafs_main_lock_runtime_image）を取った後に呼ぶ。
+static void kafs_tombstone_queue_init(struct kafs_context *ctx)
+{
+  if (!ctx || !ctx->c_superblock || ctx->c_runtime_read_only)
+    return;
+  ctx->c_reclaimq = kafs_reclaimq_create((uint32_t)kafs_sb_inocnt_get(ctx->c_superblock));
+  if (!ctx->c_reclaimq)
+  {
+    kafs_log(KAFS_LOG_WARNING, "kafs: tombstone reclaim queue disabled (no memory)\n");
+    return;
+  }
+  uint32_t hint = kafs_sb_tombstone_hint_get(ctx->c_superblock);
+  ctx->c_tombstone_sweep_left = (hint == 0) ? UINT32_MAX : hint - 1u;
+  ctx->c_tombstone_sweep = (hint != 1u) ? 1u : 0u;
+  ctx->c_tombstone_gc_cursor = KAFS_INO_ROOTDIR + 1u;
+  if (hint != 0)
   {
-    wake->tv_sec += 1;
-    wake->tv_nsec -= 1000000000l;
+    kafs_sb_tombstone_hint_set(ctx->c_superblock, 0);
+    kafs_sb_hint_sync(ctx, sizeof(ctx->c_superblock->s_tombstone_hint));
   }
+  kafs_log(KAFS_LOG_INFO, "kafs: tombstone queue hint=%" PRIu32 " sweep=%s\n", hint,
+           ctx->c_tombstone_sweep ? "on" : "off");
 }
 
-static void *kafs_tombstone_gc_worker_main(void *arg)
+/// @brief アンマウント: キューが inode 表と一致していれば件数をヒントに残して捨てる
+static void kafs_tombstone_queue_fini(struct kafs_context *ctx)
 {
-  kafs_context_t *ctx = (kafs_context_t *)arg;
-  if (!ctx)
-    return NULL;
-
-  for (;;)
+  if (!ctx || !ctx->c_reclaimq)
+    return;
+  uint32_t len = 0;
+  (void)kafs_reclaimq_peek(ctx->c_reclaimq, &len);
+  if (!ctx->c_tombstone_sweep && !ctx->c_tombstone_untracked && len < UINT32_MAX - 1u)
   {
-    pthread_mutex_lock(&ctx->c_tombstone_gc_worker_lock);
-    if (ctx->c_tombstone_gc_worker_stop)
-    {
-      pthread_mutex_unlock(&ctx->c_tombstone_gc_worker_lock);
-      return NULL;
-    }
-    pthread_mutex_unlock(&ctx->c_tombstone_gc_worker_lock);
-
-    int pressure_mode = kafs_tombstone_pressure(ctx);
-    uint32_t reclaimed = kafs_tombstone_gc_step(ctx, pressure_mode);
-    uint32_t wait_ms = pressure_mode ? KAFS_TOMBSTONE_GC_PRESSURE_INTERVAL_MS_DEFAULT
-                                     : KAFS_TOMBSTONE_GC_INTERVAL_MS_DEFAULT;
-    if (reclaimed > 0 && !pressure_mode)
-      wait_ms = 1u;
-
-    pthread_mutex_lock(&ctx->c_tombstone_gc_worker_lock);
-    if (ctx->c_tombstone_gc_worker_stop)
+    // 回収待ちの inode を先に書き出してからヒントを書く。
+    if (msync(ctx->c_img_base, ctx->c_img_size, MS_SYNC) == 0)
     {
-      pthread_mutex_unlock(&ctx->c_tombstone_gc_worker_lock);
-      return NULL;
+      kafs_sb_tombstone_hint_set(ctx->c_superblock, len + 1u);
+      kafs_sb_hint_sync(ctx, sizeof(ctx->c_superblock->s_tombstone_hint));
     }
-
-    struct timespec wake;
-    kafs_timespec_after_ms(&wake, wait_ms);
-    (void)pthread_cond_timedwait(&ctx->c_tombstone_gc_worker_cond, &ctx->c_tombstone_gc_worker_lock,
-                                 &wake);
-    pthread_mutex_unlock(&ctx->c_tombstone_gc_worker_lock);
   }
+  kafs_reclaimq_destroy(ctx->c_reclaimq);
+  ctx->c_reclaimq = NULL;
 }
 
 static int kafs_tombstone_gc_worker_start(struct kafs_context *ctx)
@@ -2488,23 +2763,14 @@ static int kafs_tombstone_gc_worker_start(struct kafs_context *ctx)
   if (ctx->c_tombstone_gc_worker_running)
     return 0;
 
-  if (!ctx->c_tombstone_gc_worker_lock_init)
-  {
-    if (pthread_mutex_init(&ctx->c_tombstone_gc_worker_lock, NULL) != 0)
-      return -EIO;
-    if (pthread_cond_init(&ctx->c_tombstone_gc_worker_cond, NULL) != 0)
-    {
-      pthread_mutex_destroy(&ctx->c_tombstone_gc_worker_lock);
-      return -EIO;
-    }
-    ctx->c_tombstone_gc_worker_lock_init = 1;
-  }
-
-  ctx->c_tombstone_gc_worker_stop = 0;
-  int prc =
-      pthread_create(&ctx->c_tombstone_gc_worker_tid, NULL, kafs_tombstone_gc_worker_main, ctx);
-  if (prc != 0)
-    return -prc;
+  const kafs_bg_work_t w = {
+      .w_order = 1,
+      .w_run = kafs_tombstone_gc_work_run,
+      .w_arg = ctx,
+  };
+  int rc = kafs_bg_work_start(ctx, KAFS_BG_WORK_TOMBSTONE_GC, &w);
+  if (rc != 0)
+    return rc;
 
   ctx->c_tombstone_gc_worker_running = 1;
   return 0;
@@ -2512,30 +2778,15 @@ static int kafs_tombstone_gc_worker_start(struct kafs_context *ctx)
 
 static void kafs_tombstone_gc_worker_stop(struct kafs_context *ctx)
 {
-  if (!ctx)
+  if (!ctx || !ctx->c_tombstone_gc_worker_running)
     return;
-
-  if (ctx->c_tombstone_gc_worker_running)
-  {
-    pthread_mutex_lock(&ctx->c_tombstone_gc_worker_lock);
-    ctx->c_tombstone_gc_worker_stop = 1;
-    pthread_cond_broadcast(&ctx->c_tombstone_gc_worker_cond);
-    pthread_mutex_unlock(&ctx->c_tombstone_gc_worker_lock);
-    pthread_join(ctx->c_tombstone_gc_worker_tid, NULL);
-    ctx->c_tombstone_gc_worker_running = 0;
-  }
-
-  if (ctx->c_tombstone_gc_worker_lock_init)
-  {
-    pthread_cond_destroy(&ctx->c_tombstone_gc_worker_cond);
-    pthread_mutex_destroy(&ctx->c_tombstone_gc_worker_lock);
-    ctx->c_tombstone_gc_worker_lock_init = 0;
-  }
+  kafs_bg_work_stop(ctx, KAFS_BG_WORK_TOMBSTONE_GC);
+  ctx->c_tombstone_gc_worker_running = 0;
 }
 
 static inline uint32_t kafs_u32_min(uint32_t a, uint32_t b) { return (a < b) ? a : b; }
 
-static void kafs_bg_dedup_worker_adjust_priority_locked(kafs_context_t *ctx, int pressure_mode)
+static void kafs_bg_dedup_worker_adjust_priority(kafs_context_t *ctx, int pressure_mode)
 {
   if (!ctx || !ctx->c_bg_dedup_worker_running)
     return;
@@ -2548,12 +2799,8 @@ static void kafs_bg_dedup_worker_adjust_priority_locked(kafs_context_t *ctx, int
     target_nice = 0;
   }
 
-  if (ctx->c_bg_dedup_worker_prio_mode != target_mode || ctx->c_bg_dedup_worker_nice != target_nice)
-  {
-    ctx->c_bg_dedup_worker_prio_mode = target_mode;
-    ctx->c_bg_dedup_worker_nice = target_nice;
-    ctx->c_bg_dedup_worker_prio_dirty = 1;
-  }
+  ctx->c_bg_dedup_worker_prio_mode = target_mode;
+  ctx->c_bg_dedup_worker_nice = target_nice;
   ctx->c_bg_dedup_worker_auto_boosted = pressure_mode ? 1u : 0u;
 }
 
@@ -2562,12 +2809,11 @@ typedef struct kafs_bg_dedup_worker_plan
   uint32_t sleep_ms;
   int run_scan;
   int pressure_mode;
-  int apply_prio;
   uint32_t mode;
 } kafs_bg_dedup_worker_plan_t;
 
-static void kafs_bg_dedup_worker_plan_locked(kafs_context_t *ctx, uint64_t now_ns,
-                                             kafs_bg_dedup_worker_plan_t *plan)
+static void kafs_bg_dedup_worker_plan(kafs_context_t *ctx, uint64_t now_ns,
+                                      kafs_bg_dedup_worker_plan_t *plan)
 {
   plan->sleep_ms = ctx->c_bg_dedup_quiet_interval_ms;
   plan->run_scan = 0;
@@ -2608,7 +2854,8 @@ static void kafs_bg_dedup_worker_plan_locked(kafs_context_t *ctx, uint64_t now_n
     {
       int should_run = 0;
       plan->mode = KAFS_BG_DEDUP_MODE_ADAPTIVE;
-      if (ctx->c_bg_dedup_last_direct_candidates > 0 || ctx->c_bg_dedup_last_replacements > 0)
+      if (ctx->c_bg_dedup_last_direct_candidates > 0 || ctx->c_bg_dedup_last_replacements > 0 ||
+          kafs_dedup_log_pending(ctx->c_bg_dedup_log, NULL) > 0)
         should_run = 1;
       else
       {
@@ -2625,11 +2872,10 @@ static void kafs_bg_dedup_worker_plan_locked(kafs_context_t *ctx, uint64_t now_n
       }
     }
 
-    kafs_bg_dedup_worker_adjust_priority_locked(ctx, plan->pressure_mode);
+    kafs_bg_dedup_worker_adjust_priority(ctx, plan->pressure_mode);
   }
 
   ctx->c_bg_dedup_mode = plan->mode;
-  plan->apply_prio = (ctx->c_bg_dedup_worker_prio_dirty != 0);
 }
 
 static void kafs_bg_dedup_worker_run_scan(kafs_context_t *ctx, int pressure_mode)
@@ -2652,7 +2898,6 @@ static void kafs_bg_dedup_worker_run_scan(kafs_context_t *ctx, int pressure_mode
 
   if (after_steps > before_steps)
   {
-    pthread_mutex_lock(&ctx->c_bg_dedup_worker_lock);
     ctx->c_bg_dedup_telemetry_valid = 1u;
     ctx->c_bg_dedup_last_scanned_blocks =
         (after_scanned >= before_scanned) ? (after_scanned - before_scanned) : 0u;
@@ -2660,121 +2905,209 @@ static void kafs_bg_dedup_worker_run_scan(kafs_context_t *ctx, int pressure_mode
         (after_candidates >= before_candidates) ? (after_candidates - before_candidates) : 0u;
     ctx->c_bg_dedup_last_replacements =
         (after_repl >= before_repl) ? (after_repl - before_repl) : 0u;
-    pthread_mutex_unlock(&ctx->c_bg_dedup_worker_lock);
   }
 }
 
-static int kafs_bg_dedup_worker_wait(kafs_context_t *ctx, int pressure_mode, uint32_t sleep_ms)
+/// @brief 実行器の 1 回分: 計画を立て、必要ならスキャンする
+static uint32_t kafs_bg_dedup_work_run(void *arg, uint32_t *urgent)
 {
-  uint32_t wait_ms =
-      pressure_mode ? sleep_ms : kafs_u32_min(sleep_ms, KAFS_BG_DEDUP_MONITOR_INTERVAL_MS);
-  if (wait_ms == 0)
-    wait_ms = 1;
+  kafs_context_t *ctx = (kafs_context_t *)arg;
+  kafs_bg_dedup_worker_plan_t plan;
+  kafs_bg_dedup_worker_plan(ctx, kafs_now_ns(), &plan);
+  if (plan.run_scan)
+    kafs_bg_dedup_worker_run_scan(ctx, plan.pressure_mode);
+  *urgent = plan.pressure_mode ? 1u : 0u;
 
-  pthread_mutex_lock(&ctx->c_bg_dedup_worker_lock);
-  if (ctx->c_bg_dedup_worker_stop)
-  {
-    pthread_mutex_unlock(&ctx->c_bg_dedup_worker_lock);
-    return 1;
-  }
+  // Below pressure, re-plan at least every monitor interval to notice a fill-up.
+  uint32_t wait_ms = plan.pressure_mode
+                         ? plan.sleep_ms
+                         : kafs_u32_min(plan.sleep_ms, KAFS_BG_DEDUP_MONITOR_INTERVAL_MS);
+  return wait_ms ? wait_ms : 1u;
+}
 
-  struct timespec wake;
-  kafs_timespec_after_ms(&wake, wait_ms);
+static int kafs_bg_dedup_worker_start(struct kafs_context *ctx)
+{
+  if (!ctx || !ctx->c_bg_dedup_enabled)
+    return 0;
+  if (ctx->c_bg_dedup_worker_running)
+    return 0;
 
-  (void)pthread_cond_timedwait(&ctx->c_bg_dedup_worker_cond, &ctx->c_bg_dedup_worker_lock, &wake);
-  pthread_mutex_unlock(&ctx->c_bg_dedup_worker_lock);
-  return 0;
+  ctx->c_bg_dedup_worker_running = 1;
+  const kafs_bg_work_t w = {
+      .w_order = 2,
+      .w_run = kafs_bg_dedup_work_run,
+      .w_arg = ctx,
+      .w_prio_mode = &ctx->c_bg_dedup_worker_prio_mode,
+      .w_nice = &ctx->c_bg_dedup_worker_nice,
+      .w_prio_err = &ctx->c_bg_dedup_worker_prio_apply_error,
+  };
+  int rc = kafs_bg_work_start(ctx, KAFS_BG_WORK_BG_DEDUP, &w);
+  if (rc != 0)
+    ctx->c_bg_dedup_worker_running = 0;
+  return rc;
 }
 
-static void *kafs_bg_dedup_worker_main(void *arg)
+static void kafs_bg_dedup_worker_stop(struct kafs_context *ctx)
 {
-  kafs_context_t *ctx = (kafs_context_t *)arg;
-  if (!ctx)
-    return NULL;
-
-  (void)kafs_bg_dedup_worker_apply_priority_self(ctx);
+  if (!ctx || !ctx->c_bg_dedup_worker_running)
+    return;
+  kafs_bg_work_stop(ctx, KAFS_BG_WORK_BG_DEDUP);
+  ctx->c_bg_dedup_worker_running = 0;
+}
 
-  for (;;)
+/// @brief 書き込みログを作り、superblock のヒントからマウント時の巡回の要否を決める。
+/// ヒントはマウント中 0 にしておき、途中で落ちたら次回は inode 表を 1 周巡回する。
+/// ログを作れなかったときは旧来どおり巡回だけで回す。
+/// イメージのロック（kafs_main_lock_runtime_image）を取った後に呼ぶ。
+static void kafs_bg_dedup_log_init(struct kafs_context *ctx)
+{
+  if (!ctx || !ctx->c_superblock || ctx->c_runtime_read_only)
+    return;
+  uint32_t hint = kafs_sb_bg_dedup_hint_get(ctx->c_superblock);
+  if (hint != 0)
   {
-    kafs_bg_dedup_worker_plan_t plan;
-    uint64_t now_ns = kafs_now_ns();
-
-    pthread_mutex_lock(&ctx->c_bg_dedup_worker_lock);
-    if (ctx->c_bg_dedup_worker_stop)
-    {
-      pthread_mutex_unlock(&ctx->c_bg_dedup_worker_lock);
-      return NULL;
-    }
-
-    kafs_bg_dedup_worker_plan_locked(ctx, now_ns, &plan);
-    pthread_mutex_unlock(&ctx->c_bg_dedup_worker_lock);
-
-    if (plan.apply_prio)
-      (void)kafs_bg_dedup_worker_apply_priority_self(ctx);
-
-    if (plan.run_scan)
-      kafs_bg_dedup_worker_run_scan(ctx, plan.pressure_mode);
+    kafs_sb_bg_dedup_hint_set(ctx->c_superblock, 0);
+    kafs_sb_hint_sync(ctx, sizeof(ctx->c_superblock->s_bg_dedup_hint));
+  }
+  ctx->c_bg_dedup_log = kafs_dedup_log_create(KAFS_BG_DEDUP_LOG_CAP);
+  if (!ctx->c_bg_dedup_log)
+    kafs_log(KAFS_LOG_WARNING, "kafs: bg dedup write log disabled (no memory)\n");
+  ctx->c_bg_dedup_sweep = (hint != 1u) ? 1u : 0u;
+  kafs_log(KAFS_LOG_INFO, "kafs: bg dedup hint=%" PRIu32 " sweep=%s\n", hint,
+           ctx->c_bg_dedup_sweep ? "on" : "off");
+}
 
-    if (kafs_bg_dedup_worker_wait(ctx, plan.pressure_mode, plan.sleep_ms) != 0)
-      return NULL;
+/// @brief アンマウント: 巡回が済み、ログを取りこぼしなく消化していれば、次回の巡回を省く
+/// hotplug の後段が書いたブロックはログに載らないので、後段がつながったマウントでは省かない。
+static void kafs_bg_dedup_log_fini(struct kafs_context *ctx)
+{
+  if (!ctx || !ctx->c_bg_dedup_log)
+    return;
+  int lost = 0;
+  uint32_t left = kafs_dedup_log_pending(ctx->c_bg_dedup_log, &lost);
+  if (!ctx->c_bg_dedup_sweep && !ctx->c_bg_dedup_untracked && !lost && left == 0)
+  {
+    kafs_sb_bg_dedup_hint_set(ctx->c_superblock, 1u);
+    kafs_sb_hint_sync(ctx, sizeof(ctx->c_superblock->s_bg_dedup_hint));
   }
+  kafs_dedup_log_destroy(ctx->c_bg_dedup_log);
+  ctx->c_bg_dedup_log = NULL;
 }
 
-static int kafs_bg_dedup_worker_start(struct kafs_context *ctx)
+/// @brief ブロックキャッシュを作る。展開した圧縮ブロックと、io_engine=pread/direct のときは生の
+/// ブロック（ブロック番号がキー）を置く。mmap の生のブロックは map からの memcpy で済むので、
+/// 圧縮ブロックの無いイメージを mmap で使うときは作らない。
+static void kafs_blk_cache_init(struct kafs_context *ctx)
 {
-  if (!ctx || !ctx->c_bg_dedup_enabled)
-    return 0;
-  if (ctx->c_bg_dedup_worker_running)
-    return 0;
+  if (!ctx || !ctx->c_superblock || ctx->c_blk_cache_mb == 0)
+    return;
+  if ((kafs_sb_feature_flags_get(ctx->c_superblock) & KAFS_FEATURE_COMPRESS) == 0 &&
+      ctx->c_io_engine == KAFS_IO_ENGINE_MMAP)
+    return;
+  uint64_t bytes = (uint64_t)ctx->c_blk_cache_mb << 20;
+  kafs_mem_plan_t plan;
+  kafs_mem_plan(ctx->c_mem_budget, &plan);
+  if (plan.mp_blk_cache && bytes > plan.mp_blk_cache)
+    bytes = plan.mp_blk_cache;
+  ctx->c_bcache =
+      kafs_bcache_create((size_t)bytes, (uint32_t)kafs_sb_blksize_get(ctx->c_superblock));
+  if (!ctx->c_bcache)
+    kafs_log(KAFS_LOG_WARNING, "kafs: block cache disabled (no memory)\n");
+}
 
-  if (!ctx->c_bg_dedup_worker_lock_init)
+/// @brief mem_budget: 休眠しているメタデータ領域を 1 回分トリムする
+static uint32_t kafs_mem_trim_work_run(void *arg, uint32_t *urgent)
+{
+  kafs_context_t *ctx = (kafs_context_t *)arg;
+  kafs_mem_plan_t plan;
+  kafs_mem_plan(ctx->c_mem_budget, &plan);
+  (void)kafs_mem_trim_pass(ctx->c_mem_trim, plan.mp_meta_resident);
+  *urgent = 0;
+  return KAFS_MEM_TRIM_INTERVAL_MS;
+}
+
+/// @brief mem_budget のときだけ、メタデータ領域のトリムを bg 実行器の LOW レーンに載せる
+/// @return 0: 開始（または無効）, < 0: 失敗 (-errno)
+static int kafs_mem_trim_start(struct kafs_context *ctx)
+{
+  static const uint32_t prio_idle = KAFS_PENDING_WORKER_PRIO_IDLE;
+  static const int32_t nice_low = 19;
+  if (!ctx || !ctx->c_mem_budget || ctx->c_mem_trim_running || !ctx->c_img_base ||
+      !ctx->c_superblock)
+    return 0;
+  uint64_t off[KAFS_META_MAP_REGIONS], len[KAFS_META_MAP_REGIONS];
+  char *base[KAFS_META_MAP_REGIONS];
+  size_t sz[KAFS_META_MAP_REGIONS];
+  int n = kafs_meta_map_regions(ctx, off, len);
+  for (int i = 0; i < n; ++i)
+    base[i] = kafs_meta_map_span(ctx, off[i], len[i], &sz[i]);
+  ctx->c_mem_trim = kafs_mem_trim_create((uint32_t)n, base, sz);
+  if (!ctx->c_mem_trim)
+    return -ENOMEM;
+  const kafs_bg_work_t w = {
+      .w_order = 3,
+      .w_run = kafs_mem_trim_work_run,
+      .w_arg = ctx,
+      .w_prio_mode = &prio_idle,
+      .w_nice = &nice_low,
+  };
+  int rc = kafs_bg_work_start(ctx, KAFS_BG_WORK_MEM_TRIM, &w);
+  if (rc != 0)
   {
-    if (pthread_mutex_init(&ctx->c_bg_dedup_worker_lock, NULL) != 0)
-      return -EIO;
-    if (pthread_cond_init(&ctx->c_bg_dedup_worker_cond, NULL) != 0)
-    {
-      pthread_mutex_destroy(&ctx->c_bg_dedup_worker_lock);
-      return -EIO;
-    }
-    ctx->c_bg_dedup_worker_lock_init = 1;
+    kafs_mem_trim_destroy(ctx->c_mem_trim);
+    ctx->c_mem_trim = NULL;
+    return rc;
   }
-
-  ctx->c_bg_dedup_worker_stop = 0;
-  int prc = pthread_create(&ctx->c_bg_dedup_worker_tid, NULL, kafs_bg_dedup_worker_main, ctx);
-  if (prc != 0)
-    return -prc;
-
-  ctx->c_bg_dedup_worker_running = 1;
+  ctx->c_mem_trim_running = 1;
   return 0;
 }
 
-static void kafs_bg_dedup_worker_stop(struct kafs_context *ctx)
+static void kafs_mem_trim_stop(struct kafs_context *ctx)
 {
-  if (!ctx)
+  if (!ctx || !ctx->c_mem_trim_running)
     return;
+  kafs_bg_work_stop(ctx, KAFS_BG_WORK_MEM_TRIM);
+  ctx->c_mem_trim_running = 0;
+}
 
-  if (ctx->c_bg_dedup_worker_running)
+// ---------------------------------------------------------
+// BLOCK OPERATIONS
+// ---------------------------------------------------------
+
+/// @brief データブロックの本体を io_engine に従って読む（範囲は呼び出し側で確かめる）
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static int kafs_blk_io_read(struct kafs_context *ctx, void *buf, size_t len, off_t off)
+{
+  kafs_stat_add(ctx, KAFS_STAT_IO_READ_BLOCKS, 1);
+  switch (ctx->c_io_engine)
   {
-    pthread_mutex_lock(&ctx->c_bg_dedup_worker_lock);
-    ctx->c_bg_dedup_worker_stop = 1;
-    pthread_cond_broadcast(&ctx->c_bg_dedup_worker_cond);
-    pthread_mutex_unlock(&ctx->c_bg_dedup_worker_lock);
-    pthread_join(ctx->c_bg_dedup_worker_tid, NULL);
-    ctx->c_bg_dedup_worker_running = 0;
+  case KAFS_IO_ENGINE_PREAD:
+    return kafs_io_pread_full(ctx->c_fd, buf, len, off);
+  case KAFS_IO_ENGINE_DIRECT:
+    return kafs_io_direct_pread(ctx->c_direct_fd, ctx->c_fd, buf, len, off,
+                                &ctx->c_stat_io_direct_fallbacks);
+  default:
+    return kafs_img_read(ctx, buf, len, off);
   }
+}
 
-  if (ctx->c_bg_dedup_worker_lock_init)
+/// @brief データブロックの本体を io_engine に従って書く（範囲は呼び出し側で確かめる）
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static int kafs_blk_io_write(struct kafs_context *ctx, const void *buf, size_t len, off_t off)
+{
+  kafs_stat_add(ctx, KAFS_STAT_IO_WRITE_BLOCKS, 1);
+  switch (ctx->c_io_engine)
   {
-    pthread_cond_destroy(&ctx->c_bg_dedup_worker_cond);
-    pthread_mutex_destroy(&ctx->c_bg_dedup_worker_lock);
-    ctx->c_bg_dedup_worker_lock_init = 0;
+  case KAFS_IO_ENGINE_PREAD:
+    return kafs_io_pwrite_full(ctx->c_fd, buf, len, off);
+  case KAFS_IO_ENGINE_DIRECT:
+    return kafs_io_direct_pwrite(ctx->c_direct_fd, ctx->c_fd, buf, len, off,
+                                 &ctx->c_stat_io_direct_fallbacks);
+  default:
+    return kafs_img_write(ctx, buf, len, off);
   }
 }
 
-// ---------------------------------------------------------
-// BLOCK OPERATIONS
-// ---------------------------------------------------------
-
 /// @brief ブロック単位でデータを読み出す
 /// @param ctx コンテキスト
 /// @param blo ブロック番号
@@ -2787,6 +3120,8 @@ static int kafs_blk_read(struct kafs_context *ctx, kafs_blkcnt_t blo, void *buf)
   kafs_dlog(3, "%s(blo = %" PRIuFAST32 ")\n", __func__, blo);
   assert(ctx != NULL);
   assert(buf != NULL);
+  if (kafs_cblk_ref_is(blo))
+    return kafs_cblk_read(ctx, blo, buf);
   kafs_blkcnt_t max_blo = kafs_sb_r_blkcnt_get(ctx->c_superblock);
   if (blo != KAFS_BLO_NONE && blo >= max_blo)
   {
@@ -2819,8 +3154,19 @@ static int kafs_blk_read(struct kafs_context *ctx, kafs_blkcnt_t blo, void *buf)
   off_t off = (off_t)blo << log_blksize;
   if ((size_t)off + (size_t)blksize > ctx->c_img_size)
     return -EIO;
-  memcpy(buf, kafs_img_ptr(ctx, off, (size_t)blksize), (size_t)blksize);
-  return KAFS_SUCCESS;
+  // With mmap a raw block is a memcpy from the mapping; with pread/direct it is a syscall (and an
+  // uncached device read for direct), so blocks read again (HRL-shared, piecewise) come from the
+  // block cache by physical blo.
+  if (ctx->c_io_engine == KAFS_IO_ENGINE_MMAP)
+    return kafs_blk_io_read(ctx, buf, (size_t)blksize, off);
+  uint32_t key = kafs_cblk_raw_cache_key(blo);
+  uint32_t epoch = 0;
+  if (kafs_bcache_get(ctx->c_bcache, key, buf, &epoch))
+    return KAFS_SUCCESS;
+  int rc = kafs_blk_io_read(ctx, buf, (size_t)blksize, off);
+  if (rc == 0)
+    (void)kafs_bcache_put(ctx->c_bcache, key, buf, epoch);
+  return rc;
 }
 
 #if KAFS_ENABLE_EXTRA_DIAG
@@ -2907,6 +3253,8 @@ static int kafs_blk_write(struct kafs_context *ctx, kafs_blkcnt_t blo, const voi
   assert(ctx != NULL);
   assert(buf != NULL);
   assert(blo != KAFS_INO_NONE);
+  // 圧縮ブロックは書き換えない（kafs_cblk_store で新しく格納する）
+  assert(!kafs_cblk_ref_is(blo));
   kafs_blkcnt_t max_blo = kafs_sb_r_blkcnt_get(ctx->c_superblock);
   if (blo != KAFS_BLO_NONE && blo >= max_blo)
   {
@@ -2922,7 +3270,12 @@ static int kafs_blk_write(struct kafs_context *ctx, kafs_blkcnt_t blo, const voi
   if ((size_t)off + (size_t)blksize > ctx->c_img_size)
     return -EIO;
   kafs_diag_log_live_dir_block0_write(ctx, blo, buf, (size_t)blksize);
-  memcpy(kafs_img_ptr(ctx, off, (size_t)blksize), buf, (size_t)blksize);
+  int rc = kafs_blk_io_write(ctx, buf, (size_t)blksize, off);
+  // Invalidate after the write so a reader that missed before it cannot put the old contents back.
+  kafs_bcache_invalidate(ctx->c_bcache, kafs_cblk_raw_cache_key(blo));
+  if (rc != 0)
+    return rc;
+  kafs_dirty_note(ctx, g_dirty_owner_ino, blo);
   return KAFS_SUCCESS;
 }
 
@@ -3647,12 +4000,22 @@ static int kafs_ino_iblk_write_legacy(struct kafs_context *ctx, kafs_sinode_t *i
                                       kafs_iblkcnt_t iblo, const void *buf, int record_rescue_hint)
 {
   kafs_blkcnt_t new_blo = KAFS_BLO_NONE;
-  KAFS_CALL(kafs_blk_alloc, ctx, &new_blo);
-
   uint64_t t_lw0 = kafs_now_ns();
-  KAFS_CALL(kafs_blk_write, ctx, new_blo, buf);
+  // ファイルデータは縮むなら圧縮コンテナへ（ディレクトリは生のまま書き換える）。
+  if (S_ISDIR(kafs_ino_mode_get(inoent)) || kafs_cblk_store(ctx, buf, &new_blo) != 0)
+  {
+    new_blo = KAFS_BLO_NONE;
+    KAFS_CALL(kafs_prealloc_blk_alloc, ctx, (uint32_t)kafs_ctx_ino_no(ctx, inoent), iblo,
+              &new_blo);
+    t_lw0 = kafs_now_ns();
+    KAFS_CALL(kafs_blk_write, ctx, new_blo, buf);
+  }
+  else
+  {
+    kafs_dirty_note(ctx, (uint32_t)kafs_ctx_ino_no(ctx, inoent), new_blo);
+  }
   uint64_t t_lw1 = kafs_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_iblk_write_ns_legacy_blk_write, t_lw1 - t_lw0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_IBLK_WRITE_NS_LEGACY_BLK_WRITE, t_lw1 - t_lw0);
 
   kafs_blkcnt_t old_raw = KAFS_BLO_NONE;
   KAFS_CALL(kafs_ino_ibrk_run, ctx, inoent, iblo, &old_raw, KAFS_IBLKREF_FUNC_GET_RAW);
@@ -3665,6 +4028,10 @@ static int kafs_ino_iblk_write_legacy(struct kafs_context *ctx, kafs_sinode_t *i
     kafs_hrl_rescue_recent_note(ctx, kafs_bg_hash64(buf, kafs_sb_blksize_get(ctx->c_superblock)),
                                 new_blo);
   }
+  // HRL を通らなかったファイルデータは背景 dedup の差分として積む（溢れたら巡回で拾う）。
+  if (!S_ISDIR(kafs_ino_mode_get(inoent)))
+    (void)kafs_dedup_log_note(ctx->c_bg_dedup_log, (uint32_t)kafs_ctx_ino_no(ctx, inoent),
+                              (uint32_t)iblo, (uint32_t)new_blo);
 
   if (old_raw != KAFS_BLO_NONE)
   {
@@ -3677,7 +4044,7 @@ static int kafs_ino_iblk_write_legacy(struct kafs_context *ctx, kafs_sinode_t *i
       uint64_t t_dec0 = kafs_now_ns();
       (void)kafs_inode_release_hrl_ref(ctx, old_blo);
       uint64_t t_dec1 = kafs_now_ns();
-      __atomic_add_fetch(&ctx->c_stat_iblk_write_ns_dec_ref, t_dec1 - t_dec0, __ATOMIC_RELAXED);
+      kafs_stat_add(ctx, KAFS_STAT_IBLK_WRITE_NS_DEC_REF, t_dec1 - t_dec0);
     }
     kafs_inode_lock(ctx, ino_idx);
   }
@@ -3689,14 +4056,14 @@ static int kafs_ino_iblk_write_pending(struct kafs_context *ctx, kafs_sinode_t *
                                        kafs_iblkcnt_t iblo, const void *buf, uint32_t *warned_state)
 {
   kafs_blkcnt_t temp_blo = KAFS_BLO_NONE;
-  int rc = kafs_blk_alloc(ctx, &temp_blo);
+  int rc = kafs_prealloc_blk_alloc(ctx, (uint32_t)kafs_ctx_ino_no(ctx, inoent), iblo, &temp_blo);
   if (rc < 0)
     return rc;
 
   uint64_t t_lw0 = kafs_now_ns();
   rc = kafs_blk_write(ctx, temp_blo, buf);
   uint64_t t_lw1 = kafs_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_iblk_write_ns_legacy_blk_write, t_lw1 - t_lw0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_IBLK_WRITE_NS_LEGACY_BLK_WRITE, t_lw1 - t_lw0);
   if (rc < 0)
     return rc;
 
@@ -3758,7 +4125,7 @@ static int kafs_ino_iblk_write_pending(struct kafs_context *ctx, kafs_sinode_t *
   if (rc < 0)
     return rc;
 
-  kafs_pending_worker_notify(ctx);
+  kafs_pending_worker_notify(ctx, ino_idx);
   return 0;
 }
 
@@ -3771,11 +4138,11 @@ static int kafs_iblk_write_hrl_acquire_candidate(struct kafs_context *ctx, const
   *candidate_kind = 0;
 
   kafs_hrid_t hrid = 0;
-  ctx->c_stat_hrl_put_calls++;
+  kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_CALLS, 1);
   uint64_t t_hrl0 = kafs_now_ns();
   int rc = kafs_hrl_put(ctx, buf, &hrid, is_new, candidate_blo);
   uint64_t t_hrl1 = kafs_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_iblk_write_ns_hrl_put, t_hrl1 - t_hrl0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_IBLK_WRITE_NS_HRL_PUT, t_hrl1 - t_hrl0);
   if (rc == 0)
   {
     *candidate_kind = 1;
@@ -3844,22 +4211,27 @@ static int kafs_ino_iblk_write_hrl_retry(struct kafs_context *ctx, kafs_sinode_t
     if (hrl_rc == 0)
     {
       if (is_new)
-        ctx->c_stat_hrl_put_misses++;
+        kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_MISSES, 1);
       else
-        ctx->c_stat_hrl_put_hits++;
+        kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_HITS, 1);
+      if (!S_ISDIR(kafs_ino_mode_get(inoent)))
+        kafs_dedup_policy_note_hrl(ctx, ino_idx, !is_new);
       kafs_diag_log_dir_iblk_write(candidate_kind == 2 ? "iblk_write_rescue" : "iblk_write_hrl",
                                    ctx, inoent, iblo, current_old_blo, candidate_blo, buf,
                                    kafs_sb_blksize_get(ctx->c_superblock));
       rc = kafs_ino_ibrk_run(ctx, inoent, iblo, &candidate_blo, KAFS_IBLKREF_FUNC_SET);
       if (rc < 0)
         return rc;
+      // HRL writes the block by pwrite (or it already existed); either way it is now this
+      // file's data.
+      kafs_dirty_note(ctx, ino_idx, candidate_blo);
       if (current_old_blo != KAFS_BLO_NONE && current_old_blo != candidate_blo)
       {
         kafs_inode_unlock(ctx, ino_idx);
         uint64_t t_dec0 = kafs_now_ns();
         (void)kafs_inode_release_hrl_ref(ctx, current_old_blo);
         uint64_t t_dec1 = kafs_now_ns();
-        __atomic_add_fetch(&ctx->c_stat_iblk_write_ns_dec_ref, t_dec1 - t_dec0, __ATOMIC_RELAXED);
+        kafs_stat_add(ctx, KAFS_STAT_IBLK_WRITE_NS_DEC_REF, t_dec1 - t_dec0);
         kafs_inode_lock(ctx, ino_idx);
       }
       return 0;
@@ -3869,18 +4241,12 @@ static int kafs_ino_iblk_write_hrl_retry(struct kafs_context *ctx, kafs_sinode_t
     break;
   }
 
-  ctx->c_stat_hrl_put_fallback_legacy++;
+  kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_FALLBACK_LEGACY, 1);
   return 1;
 }
 
-/// @brief inode毎のデータを書き込む（ブロック単位）
-/// @param ctx コンテキスト
-/// @param inoent inode テーブルエントリ
-/// @param iblo ブロック番号
-/// @param buf バッファ
-/// @return 0: 成功, < 0: 失敗 (-errno)
-static int kafs_ino_iblk_write(struct kafs_context *ctx, kafs_sinode_t *inoent, kafs_iblkcnt_t iblo,
-                               const void *buf)
+static int kafs_ino_iblk_write_route(struct kafs_context *ctx, kafs_sinode_t *inoent,
+                                     kafs_iblkcnt_t iblo, const void *buf)
 {
   static uint32_t s_pendinglog_full_warned = 0;
   kafs_dlog(3, "%s(ino = %d, iblo = %" PRIuFAST32 ")\n", __func__, kafs_ctx_ino_no(ctx, inoent),
@@ -3889,6 +4255,20 @@ static int kafs_ino_iblk_write(struct kafs_context *ctx, kafs_sinode_t *inoent,
   assert(buf != NULL);
   assert(inoent != NULL);
   assert(kafs_ino_get_usage(inoent));
+  // 直近の HRL ヒット率が低い inode は HRL も pending も通さず direct で書く
+  // （書き込みログ経由で背景 dedup が後から見る）。
+  if (!S_ISDIR(kafs_ino_mode_get(inoent)))
+  {
+    int probe = 0;
+    uint32_t *st = kafs_dedup_policy_slot(ctx, (uint32_t)kafs_ctx_ino_no(ctx, inoent));
+    if (kafs_dedup_policy_route(st, ctx->c_dedup_bypass_sample, &probe))
+    {
+      kafs_stat_add(ctx, KAFS_STAT_DEDUP_BYPASS_BLOCKS, 1);
+      return kafs_ino_iblk_write_legacy(ctx, inoent, iblo, buf, 0);
+    }
+    if (probe)
+      __atomic_add_fetch(&ctx->c_stat_dedup_bypass_probes, 1u, __ATOMIC_RELAXED);
+  }
   // Directory metadata is frequently rewritten and can cross the inline/block-backed boundary.
   // Keep that path synchronous so shrink-to-inline and unlink do not race with pendinglog writes.
   if (ctx->c_pendinglog_enabled && ctx->c_pending_worker_running &&
@@ -3917,6 +4297,22 @@ static int kafs_ino_iblk_write(struct kafs_context *ctx, kafs_sinode_t *inoent,
   return kafs_ino_iblk_write_legacy(ctx, inoent, iblo, buf, 1);
 }
 
+/// @brief inode毎のデータを書き込む（ブロック単位）
+/// @param ctx コンテキスト
+/// @param inoent inode テーブルエントリ
+/// @param iblo ブロック番号
+/// @param buf バッファ
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static int kafs_ino_iblk_write(struct kafs_context *ctx, kafs_sinode_t *inoent, kafs_iblkcnt_t iblo,
+                               const void *buf)
+{
+  uint32_t prev_owner = g_dirty_owner_ino;
+  g_dirty_owner_ino = (uint32_t)kafs_ctx_ino_no(ctx, inoent);
+  int rc = kafs_ino_iblk_write_route(ctx, inoent, iblo, buf);
+  g_dirty_owner_ino = prev_owner;
+  return rc;
+}
+
 __attribute_maybe_unused__ static int
 kafs_ino_iblk_release(struct kafs_context *ctx, kafs_sinode_t *inoent, kafs_iblkcnt_t iblo)
 {
@@ -4696,7 +5092,7 @@ static int kafs_tailmeta_try_reclaim_tombstone_payload_locked(struct kafs_contex
   inoent = kafs_ctx_inode(ctx, ino);
   if (!inoent || !kafs_ino_get_usage(inoent) || kafs_ino_linkcnt_get(inoent) != 0)
     return 0;
-  if (__atomic_load_n(&ctx->c_open_cnt[ino], __ATOMIC_RELAXED) != 0)
+  if (kafs_sparse_u32_get(ctx->c_open_cnt, ino) != 0)
     return 0;
   if (!kafs_tailmeta_inode_is_regular_v5(ctx, inoent))
     return 0;
@@ -4828,7 +5224,7 @@ static int kafs_pwrite_commit_block(struct kafs_context *ctx, kafs_sinode_t *ino
 static void kafs_pwrite_record_write_latency(struct kafs_context *ctx, uint64_t t_w0, uint64_t t_w1)
 {
   uint64_t d = t_w1 - t_w0;
-  __atomic_add_fetch(&ctx->c_stat_pwrite_ns_iblk_write, d, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_PWRITE_NS_IBLK_WRITE, d);
   kafs_stat_record_pwrite_iblk_write_latency(ctx, d);
 }
 
@@ -4848,7 +5244,7 @@ static int kafs_pwrite_read_block_timed(struct kafs_context *ctx, kafs_sinode_t
   uint64_t t_r0 = kafs_now_ns();
   int rc = kafs_ino_iblk_read_or_zero(ctx, inoent, iblo, buf);
   uint64_t t_r1 = kafs_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_pwrite_ns_iblk_read, t_r1 - t_r0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_PWRITE_NS_IBLK_READ, t_r1 - t_r0);
   return rc;
 }
 
@@ -5031,8 +5427,8 @@ static ssize_t kafs_pwrite(struct kafs_context *ctx, kafs_sinode_t *inoent, cons
   if (size == 0)
     return 0;
 
-  __atomic_add_fetch(&ctx->c_stat_pwrite_calls, 1u, __ATOMIC_RELAXED);
-  __atomic_add_fetch(&ctx->c_stat_pwrite_bytes, (uint64_t)size, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_PWRITE_CALLS, 1u);
+  kafs_stat_add(ctx, KAFS_STAT_PWRITE_BYTES, (uint64_t)size);
   kafs_diag_log_first_pwrite_after_create(ctx, inoent, buf, size, offset);
 
   int completed = 0;
@@ -5044,6 +5440,9 @@ static ssize_t kafs_pwrite(struct kafs_context *ctx, kafs_sinode_t *inoent, cons
     return size;
   }
 
+  // Appending past EOF: let sequential block allocations draw from a per-inode window.
+  if (offset >= filesize && S_ISREG(kafs_ino_mode_get(inoent)))
+    kafs_prealloc_arm(ctx, ino, (kafs_iblkcnt_t)(offset >> log_blksize));
   KAFS_PWRITE_TRY(kafs_pwrite_extend_inode_size(ctx, inoent, &filesize, filesize_new));
   kafs_pwrite_sync_regular_taildesc(ctx, inoent, filesize);
 
@@ -5354,6 +5753,7 @@ static int kafs_truncate(struct kafs_context *ctx, kafs_sinode_t *inoent, kafs_o
   kafs_off_t filesize_orig = kafs_ino_size_get(inoent);
   if (filesize_orig == filesize_new)
     return KAFS_SUCCESS;
+  kafs_prealloc_release_ino(ctx, ino_idx);
   kafs_blkcnt_t *deferred_free = NULL;
   size_t deferred_free_cnt = 0;
   size_t deferred_free_cap = 0;
@@ -5499,11 +5899,13 @@ static int kafs_try_reclaim_unlinked_inode_locked(struct kafs_context *ctx, kafs
     return KAFS_SUCCESS;
   if (ctx->c_open_cnt)
   {
-    uint32_t open_cnt = __atomic_load_n(&ctx->c_open_cnt[ino], __ATOMIC_RELAXED);
+    uint32_t open_cnt = kafs_sparse_u32_get(ctx->c_open_cnt, (uint32_t)ino);
     if (open_cnt != 0)
       return KAFS_SUCCESS;
   }
 
+  (void)kafs_reclaimq_remove(ctx->c_reclaimq, (uint32_t)ino);
+  __atomic_add_fetch(&ctx->c_stat_tombstone_reclaimed, 1u, __ATOMIC_RELAXED);
   (void)kafs_inode_epoch_bump(ctx, (uint32_t)ino);
   int trc = kafs_truncate(ctx, inoent, 0);
   if (trc < 0)
@@ -5664,7 +6066,7 @@ static int kafs_dirent_search_snapshot(struct kafs_context *ctx, const char *sna
     return -ENOENT;
 
   kafs_dir_snapshot_meta_t meta;
-  __atomic_add_fetch(&ctx->c_stat_dir_snapshot_meta_load_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_DIR_SNAPSHOT_META_LOAD_CALLS, 1u);
   int rc_meta = kafs_dir_snapshot_meta_load(snap, snap_len, &meta);
   if (rc_meta < 0)
     return rc_meta;
@@ -5675,7 +6077,7 @@ static int kafs_dirent_search_snapshot(struct kafs_context *ctx, const char *sna
   while (1)
   {
     kafs_dirent_view_t view;
-    __atomic_add_fetch(&ctx->c_stat_dirent_view_next_calls, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add_rec(ctx, KAFS_STAT_DIRENT_VIEW_NEXT_CALLS, 1u);
     int step = kafs_dirent_view_next_meta(snap, &meta, off, &view);
     if (step == 0)
       break;
@@ -5730,8 +6132,8 @@ static int kafs_dir_snapshot(struct kafs_context *ctx, kafs_sinode_t *inoent_dir
   *out = NULL;
   *out_len = 0;
   size_t len = (size_t)kafs_ino_size_get(inoent_dir);
-  __atomic_add_fetch(&ctx->c_stat_dir_snapshot_calls, 1u, __ATOMIC_RELAXED);
-  __atomic_add_fetch(&ctx->c_stat_dir_snapshot_bytes, (uint64_t)len, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_DIR_SNAPSHOT_CALLS, 1u);
+  kafs_stat_add(ctx, KAFS_STAT_DIR_SNAPSHOT_BYTES, (uint64_t)len);
   if (len == 0)
     return 0;
   char *buf = (char *)malloc(len);
@@ -5849,7 +6251,7 @@ static int kafs_dirent_find_existing_v4(struct kafs_context *ctx, const char *ol
   while (1)
   {
     kafs_dirent_view_t view;
-    __atomic_add_fetch(&ctx->c_stat_dirent_view_next_calls, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add_rec(ctx, KAFS_STAT_DIRENT_VIEW_NEXT_CALLS, 1u);
     int step = kafs_dirent_view_next_meta(old, meta, off, &view);
     if (step == 0)
       return 0;
@@ -5953,7 +6355,7 @@ static int kafs_dirent_add_nolink(struct kafs_context *ctx, kafs_sinode_t *inoen
     return rc;
 
   kafs_dir_snapshot_meta_t meta;
-  __atomic_add_fetch(&ctx->c_stat_dir_snapshot_meta_load_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_DIR_SNAPSHOT_META_LOAD_CALLS, 1u);
   rc = kafs_dir_snapshot_meta_load(old, old_len, &meta);
   if (rc < 0)
   {
@@ -6016,7 +6418,7 @@ static int kafs_dirent_remove_prepare_snapshot(struct kafs_context *ctx, kafs_si
   if (rc < 0)
     return rc;
 
-  __atomic_add_fetch(&ctx->c_stat_dir_snapshot_meta_load_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_DIR_SNAPSHOT_META_LOAD_CALLS, 1u);
   rc = kafs_dir_snapshot_meta_load(*old, *old_len, meta);
   if (rc < 0)
   {
@@ -6074,7 +6476,7 @@ static int kafs_dirent_remove_nolink(struct kafs_context *ctx, kafs_sinode_t *in
   while (1)
   {
     kafs_dirent_view_t view;
-    __atomic_add_fetch(&ctx->c_stat_dirent_view_next_calls, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add_rec(ctx, KAFS_STAT_DIRENT_VIEW_NEXT_CALLS, 1u);
     int step = kafs_dirent_view_next_meta(old, &meta, off, &view);
     if (step == 0)
       break;
@@ -6198,13 +6600,31 @@ static int kafs_resolve_fh_inode(struct kafs_context *ctx, const struct fuse_fil
   return KAFS_SUCCESS;
 }
 
+// Request context of the calling thread. kafs-back runs the same operation handlers for
+// namespace RPCs outside any FUSE thread; kafs_core_ns_exec() installs a synthetic context carrying
+// the caller's uid/gid/pid for the duration of one request.
+static __thread struct fuse_context *g_kafs_fctx_override = NULL;
+
+static struct fuse_context *kafs_fuse_context(void)
+{
+  return g_kafs_fctx_override ? g_kafs_fctx_override : fuse_get_context();
+}
+
+// Supplementary groups are not carried over RPC; a synthetic context has none.
+static int kafs_fuse_getgroups(int size, gid_t list[])
+{
+  if (g_kafs_fctx_override)
+    return 0;
+  return fuse_getgroups(size, list);
+}
+
 static size_t kafs_access_load_groups(gid_t groups[])
 {
-  ssize_t ng0 = fuse_getgroups(0, NULL);
+  ssize_t ng0 = kafs_fuse_getgroups(0, NULL);
   size_t ngroups = (ng0 > 0) ? (size_t)ng0 : 0;
 
   if (ngroups > 0)
-    (void)fuse_getgroups(ngroups, groups);
+    (void)kafs_fuse_getgroups(ngroups, groups);
   return ngroups;
 }
 
@@ -6228,12 +6648,12 @@ static int kafs_access_resolve_start(struct kafs_context *ctx, const char *path,
 
   if (fh_rc == 0)
   {
-    __atomic_add_fetch(&ctx->c_stat_access_fh_fastpath_hits, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_ACCESS_FH_FASTPATH_HITS, 1u);
     *p = "";
     return KAFS_SUCCESS;
   }
 
-  __atomic_add_fetch(&ctx->c_stat_access_path_walk_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_ACCESS_PATH_WALK_CALLS, 1u);
   *inoent = kafs_ctx_inode(ctx, KAFS_INO_ROOTDIR);
   *p = path + 1;
   return KAFS_SUCCESS;
@@ -6246,7 +6666,7 @@ static int kafs_access_walk_path(struct fuse_context *fctx, kafs_context_t *ctx,
   while (*p != '\0')
   {
     const char *n = strchrnul(p, '/');
-    __atomic_add_fetch(&ctx->c_stat_access_path_components, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add_rec(ctx, KAFS_STAT_ACCESS_PATH_COMPONENTS, 1u);
     kafs_mode_t cur_mode = kafs_ino_mode_get(*inoent);
     kafs_dlog(2, "%s: component='%.*s' checking dir ino=%u mode=%o\n", __func__, (int)(n - p), p,
               (unsigned)kafs_ctx_ino_no(ctx, *inoent), (unsigned)cur_mode);
@@ -6288,11 +6708,11 @@ static int kafs_access(struct fuse_context *fctx, kafs_context_t *ctx, const cha
   assert(path == NULL || *path == '/' || *path == '\0');
 
   kafs_dlog(2, "%s(path=%s, ok=%d, fi=%p)\n", __func__, path ? path : "(null)", ok, (void *)fi);
-  __atomic_add_fetch(&ctx->c_stat_access_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_ACCESS_CALLS, 1u);
 
   uid_t uid = fctx->uid;
   gid_t gid = fctx->gid;
-  ssize_t ng0 = fuse_getgroups(0, NULL);
+  ssize_t ng0 = kafs_fuse_getgroups(0, NULL);
   gid_t groups[(ng0 > 0) ? (size_t)ng0 : 1];
   size_t ngroups = kafs_access_load_groups(groups);
 
@@ -6352,6 +6772,9 @@ static int kafs_hotplug_is_disconnect_error(int rc)
 static int kafs_hotplug_wait_for_back(kafs_context_t *ctx, const char *uds_path, int timeout_ms);
 static void kafs_hotplug_env_lock(kafs_context_t *ctx);
 static void kafs_hotplug_env_unlock(kafs_context_t *ctx);
+static int kafs_hotplug_rpc_call(kafs_context_t *ctx, uint16_t op, const void *req,
+                                 uint32_t req_len, kafs_rpc_resp_hdr_t *resp_hdr, void *resp,
+                                 uint32_t resp_cap, uint32_t *resp_len);
 
 static void kafs_hotplug_set_fd_timeout_ms(int fd, uint32_t timeout_ms)
 {
@@ -6401,6 +6824,9 @@ static int kafs_hotplug_accept_hello(kafs_context_t *ctx, const kafs_rpc_hello_t
       (hello->feature_flags & ~KAFS_RPC_HELLO_FEATURES) != 0)
     return kafs_hotplug_handshake_reject(ctx, -EPROTONOSUPPORT);
 
+  ctx->c_hotplug_max_payload = (hello->feature_flags & KAFS_RPC_HELLO_FEATURE_LARGE_PAYLOAD)
+                                   ? KAFS_RPC_MAX_PAYLOAD_LARGE
+                                   : KAFS_RPC_MAX_PAYLOAD;
   ctx->c_hotplug_compat_result = KAFS_HOTPLUG_COMPAT_OK;
   ctx->c_hotplug_compat_reason = 0;
   return 0;
@@ -6449,10 +6875,95 @@ static int kafs_hotplug_recv_ready(kafs_context_t *ctx, int cli)
   return 0;
 }
 
+// SHM を選んでいて後段が対応していれば、READY の後に memfd のスロットリングを渡す。
+// memfd が作れない・後段が断ったときは接続を続けてデータは INLINE で流す。
+static int kafs_hotplug_attach_shm(kafs_context_t *ctx, int cli, uint64_t session_id,
+                                   uint32_t next_epoch)
+{
+  __atomic_store_n(&ctx->c_hotplug_shm_active, 0, __ATOMIC_RELEASE);
+  if (ctx->c_hotplug_data_mode != KAFS_RPC_DATA_SHM ||
+      (ctx->c_hotplug_back_features & KAFS_RPC_HELLO_FEATURE_SHM) == 0)
+    return 0;
+  if (!ctx->c_hotplug_shm)
+  {
+    kafs_rpc_shm_t *shm = (kafs_rpc_shm_t *)malloc(sizeof(*shm));
+    if (!shm)
+      return 0;
+    int rc = kafs_rpc_shm_create(shm, KAFS_RPC_SHM_SLOTS, KAFS_RPC_SHM_SLOT_SIZE);
+    if (rc != 0)
+    {
+      free(shm);
+      kafs_log(KAFS_LOG_WARNING, "kafs: hotplug shm ring unavailable rc=%d; using inline\n", rc);
+      return 0;
+    }
+    ctx->c_hotplug_shm = shm;
+  }
+
+  kafs_rpc_shm_attach_t att;
+  att.slot_count = ctx->c_hotplug_shm->rs_slot_count;
+  att.slot_size = ctx->c_hotplug_shm->rs_slot_size;
+  uint64_t req_id = kafs_rpc_next_req_id();
+  int rc = kafs_rpc_send_msg_fd(cli, KAFS_RPC_OP_SHM_ATTACH, KAFS_RPC_FLAG_ENDIAN_HOST, req_id,
+                                session_id, next_epoch, &att, sizeof(att),
+                                ctx->c_hotplug_shm->rs_fd);
+  if (rc != 0)
+    return kafs_hotplug_handshake_fail(ctx, rc);
+  kafs_rpc_resp_hdr_t resp_hdr;
+  uint32_t resp_len = 0;
+  rc = kafs_rpc_recv_resp(cli, &resp_hdr, NULL, 0, &resp_len);
+  if (rc != 0)
+    return kafs_hotplug_handshake_fail(ctx, rc);
+  if (resp_hdr.req_id != req_id)
+    return kafs_hotplug_handshake_fail(ctx, -EBADMSG);
+  if (resp_hdr.result != 0)
+  {
+    kafs_log(KAFS_LOG_WARNING, "kafs: kafs-back refused shm attach rc=%d; using inline\n",
+             resp_hdr.result);
+    return 0;
+  }
+  __atomic_store_n(&ctx->c_hotplug_shm_active, 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// The batched sender and read-ahead receiver outlive reconnects; only the receiver is rebound.
+// Calls fail with -ENOTCONN if they could not be allocated.
+static void kafs_hotplug_transport_init(kafs_context_t *ctx)
+{
+  if (!ctx->c_hotplug_tx)
+  {
+    kafs_rpc_tx_t *tx = (kafs_rpc_tx_t *)malloc(sizeof(*tx));
+    if (tx)
+      kafs_rpc_tx_init(tx);
+    ctx->c_hotplug_tx = tx;
+  }
+  if (!ctx->c_hotplug_rx)
+  {
+    kafs_rpc_rx_t *rx = (kafs_rpc_rx_t *)malloc(sizeof(*rx));
+    if (rx && kafs_rpc_rx_init(rx, -1) != 0)
+    {
+      free(rx);
+      rx = NULL;
+    }
+    ctx->c_hotplug_rx = rx;
+  }
+}
+
 static void kafs_hotplug_finish_handshake(kafs_context_t *ctx, int cli, uint64_t session_id,
                                           uint32_t next_epoch)
 {
+  if ((ctx->c_hotplug_back_features & KAFS_RPC_HELLO_FEATURE_NS) && !ctx->c_hotplug_ns_open)
+  {
+    uint32_t cnt = (uint32_t)kafs_sb_inocnt_get(ctx->c_superblock);
+    ctx->c_hotplug_ns_open = kafs_sparse_u32_create(cnt ? cnt : 1u, 0);
+  }
+  // Tombstones the back leaves behind (e.g. still open when it exits) never reach this queue, nor
+  // do the blocks it writes reach the bg dedup log: leave both hints unknown so the next mount
+  // sweeps for them.
+  if (ctx->c_hotplug_back_features & KAFS_RPC_HELLO_FEATURE_NS)
+    __atomic_store_n(&ctx->c_tombstone_untracked, 1u, __ATOMIC_RELAXED);
+  __atomic_store_n(&ctx->c_bg_dedup_untracked, 1u, __ATOMIC_RELAXED);
   ctx->c_hotplug_fd = cli;
+  __atomic_add_fetch(&ctx->c_hotplug_conn_gen, 1u, __ATOMIC_RELEASE);
   ctx->c_hotplug_active = 1;
   ctx->c_hotplug_state = KAFS_HOTPLUG_STATE_CONNECTED;
   ctx->c_hotplug_last_error = 0;
@@ -6463,6 +6974,15 @@ static void kafs_hotplug_finish_handshake(kafs_context_t *ctx, int cli, uint64_t
     if (pthread_mutex_init(&ctx->c_hotplug_lock, NULL) == 0)
       ctx->c_hotplug_lock_init = 1;
   }
+  if (!ctx->c_hotplug_mux_init)
+  {
+    if (pthread_mutex_init(&ctx->c_hotplug_mux_lock, NULL) == 0 &&
+        pthread_cond_init(&ctx->c_hotplug_mux_cond, NULL) == 0)
+      ctx->c_hotplug_mux_init = 1;
+  }
+  kafs_hotplug_transport_init(ctx);
+  if (ctx->c_hotplug_max_payload == 0)
+    ctx->c_hotplug_max_payload = KAFS_RPC_MAX_PAYLOAD; // connected without a HELLO
   kafs_hotplug_wait_notify(ctx);
 }
 
@@ -6489,11 +7009,16 @@ static int kafs_hotplug_complete_handshake(kafs_context_t *ctx, int cli)
   if (rc != 0)
     return rc;
 
+  rc = kafs_hotplug_attach_shm(ctx, cli, session_id, next_epoch);
+  if (rc != 0)
+    return rc;
+
   kafs_hotplug_finish_handshake(ctx, cli, session_id, next_epoch);
   return 0;
 }
 
-static int kafs_hotplug_spawn_back_for_restart(kafs_context_t *ctx, int *out_front_fd)
+static int kafs_hotplug_spawn_back_for_restart(kafs_context_t *ctx, int warm_fd,
+                                               int *out_front_fd)
 {
   if (!ctx || !out_front_fd)
     return -EINVAL;
@@ -6536,12 +7061,19 @@ static int kafs_hotplug_spawn_back_for_restart(kafs_context_t *ctx, int *out_fro
     for (uint32_t i = 0; i < env_count; ++i)
     {
       if (strcmp(envs[i].key, "KAFS_HOTPLUG_BACK_FD") == 0 ||
-          strcmp(envs[i].key, "KAFS_HOTPLUG_UDS") == 0)
+          strcmp(envs[i].key, "KAFS_HOTPLUG_UDS") == 0 ||
+          strcmp(envs[i].key, "KAFS_BACK_WARM_FD") == 0)
         continue;
       (void)setenv(envs[i].key, envs[i].value, 1);
     }
     // Explicit restart uses front-managed transport variables only.
     (void)unsetenv("KAFS_HOTPLUG_UDS");
+    (void)unsetenv("KAFS_BACK_WARM_FD");
+    if (warm_fd >= 0 && fcntl(warm_fd, F_SETFD, 0) == 0)
+    {
+      snprintf(fd_buf, sizeof(fd_buf), "%d", warm_fd);
+      (void)setenv("KAFS_BACK_WARM_FD", fd_buf, 1);
+    }
 
     char *args[] = {back_bin_buf, NULL};
     if (strchr(back_bin_buf, '/') != NULL)
@@ -6626,9 +7158,14 @@ static void kafs_hotplug_mark_disconnected_internal(kafs_context_t *ctx, int rc,
   if (!ctx)
     return;
   if (ctx->c_hotplug_fd >= 0)
+  {
+    // Wake a caller blocked reading responses on this socket before the fd goes away.
+    (void)shutdown(ctx->c_hotplug_fd, SHUT_RDWR);
     close(ctx->c_hotplug_fd);
+  }
   ctx->c_hotplug_fd = -1;
   ctx->c_hotplug_active = 0;
+  __atomic_store_n(&ctx->c_hotplug_shm_active, 0, __ATOMIC_RELEASE);
   ctx->c_hotplug_state = KAFS_HOTPLUG_STATE_WAITING;
   ctx->c_hotplug_last_error = rc;
   kafs_hotplug_wait_notify(ctx);
@@ -6835,6 +7372,46 @@ static int kafs_hotplug_wait_ready(kafs_context_t *ctx)
   return kafs_hotplug_wait_ready_wait(ctx, &deadline);
 }
 
+// Before replacing a back that advertises KAFS_RPC_HELLO_FEATURE_WARM_STATE, have it close the
+// image and return its runtime state, so the successor skips the cold-start scans. Returns a memfd
+// holding that state (handed to the new back as KAFS_BACK_WARM_FD), or -1 to restart cold.
+static int kafs_hotplug_save_warm_state(kafs_context_t *ctx)
+{
+  if (!kafs_hotplug_enabled(ctx) || ctx->c_hotplug_state != KAFS_HOTPLUG_STATE_CONNECTED ||
+      (ctx->c_hotplug_back_features & KAFS_RPC_HELLO_FEATURE_WARM_STATE) == 0)
+    return -1;
+  uint8_t *buf = (uint8_t *)malloc(KAFS_RPC_MAX_PAYLOAD_LARGE);
+  if (!buf)
+    return -1;
+  kafs_rpc_resp_hdr_t resp_hdr;
+  uint32_t len = 0;
+  int rc = kafs_hotplug_rpc_call(ctx, KAFS_RPC_OP_STATE_SAVE, NULL, 0, &resp_hdr, buf,
+                                 KAFS_RPC_MAX_PAYLOAD_LARGE, &len);
+  if (rc == 0 && resp_hdr.result != 0)
+    rc = resp_hdr.result;
+  int fd = -1;
+  if (rc == 0)
+  {
+    fd = memfd_create("kafs-warm-state", MFD_CLOEXEC);
+    if (fd < 0)
+      rc = -errno;
+    else if (pwrite(fd, buf, len, 0) != (ssize_t)len)
+    {
+      rc = -EIO;
+      close(fd);
+      fd = -1;
+    }
+  }
+  free(buf);
+  if (rc != 0)
+  {
+    kafs_log(KAFS_LOG_WARNING, "kafs: kafs-back state not saved rc=%d; restarting cold\n", rc);
+    return -1;
+  }
+  __atomic_store_n(&ctx->c_stat_hotplug_warm_state_bytes, len, __ATOMIC_RELAXED);
+  return fd;
+}
+
 static int kafs_hotplug_restart_back(kafs_context_t *ctx)
 {
   if (!ctx)
@@ -6842,12 +7419,19 @@ static int kafs_hotplug_restart_back(kafs_context_t *ctx)
   if (ctx->c_hotplug_state == KAFS_HOTPLUG_STATE_DISABLED)
     return -ENOSYS;
 
+  int warm_fd = kafs_hotplug_save_warm_state(ctx);
+  __atomic_add_fetch(warm_fd >= 0 ? &ctx->c_stat_hotplug_warm_restarts
+                                  : &ctx->c_stat_hotplug_cold_restarts,
+                     1u, __ATOMIC_RELAXED);
+
   // For explicit restart, stop current channel without scheduling background relisten;
   // we proactively spawn and re-handshake with kafs-back below.
   kafs_hotplug_mark_disconnected_internal(ctx, -ECONNRESET, 0);
 
   int front_fd = -1;
-  int rc = kafs_hotplug_spawn_back_for_restart(ctx, &front_fd);
+  int rc = kafs_hotplug_spawn_back_for_restart(ctx, warm_fd, &front_fd);
+  if (warm_fd >= 0)
+    close(warm_fd);
   if (rc != 0)
   {
     ctx->c_hotplug_last_error = rc;
@@ -6866,6 +7450,182 @@ static int kafs_hotplug_restart_back(kafs_context_t *ctx)
   return 0;
 }
 
+// One outstanding RPC waiting for its response (linked on c_hotplug_calls under the mux lock).
+typedef struct kafs_hotplug_call
+{
+  uint64_t hc_req_id;
+  int hc_fd;
+  int hc_done;
+  int hc_rc; // transport result; 0 when hc_hdr / hc_len are valid
+  uint64_t hc_gen;
+  kafs_rpc_resp_hdr_t hc_hdr;
+  const struct iovec *hc_iov; // where the response body is scattered
+  int hc_iovcnt;
+  uint32_t hc_len;
+  struct kafs_hotplug_call *hc_next;
+} kafs_hotplug_call_t;
+
+static kafs_hotplug_call_t *kafs_hotplug_mux_take_locked(kafs_context_t *ctx, uint64_t req_id)
+{
+  for (kafs_hotplug_call_t **pp = &ctx->c_hotplug_calls; *pp; pp = &(*pp)->hc_next)
+  {
+    if ((*pp)->hc_req_id == req_id)
+    {
+      kafs_hotplug_call_t *c = *pp;
+      *pp = c->hc_next;
+      return c;
+    }
+  }
+  return NULL;
+}
+
+// Fail every call sent on connection generation gen (the fd number may already be reused).
+static void kafs_hotplug_mux_fail_locked(kafs_context_t *ctx, uint64_t gen, int rc)
+{
+  kafs_hotplug_call_t **pp = &ctx->c_hotplug_calls;
+  while (*pp)
+  {
+    kafs_hotplug_call_t *c = *pp;
+    if (c->hc_gen != gen)
+    {
+      pp = &c->hc_next;
+      continue;
+    }
+    *pp = c->hc_next;
+    c->hc_rc = rc;
+    c->hc_done = 1;
+  }
+}
+
+// Read one response and hand it to its caller. Returns <0 only when the stream is unusable.
+// Responses come out of the read-ahead buffer, so one recvmsg often serves several callers.
+static int kafs_hotplug_mux_recv_one(kafs_context_t *ctx, const kafs_hotplug_call_t *self)
+{
+  kafs_rpc_rx_t *rx = ctx->c_hotplug_rx;
+  if (self->hc_gen != __atomic_load_n(&ctx->c_hotplug_conn_gen, __ATOMIC_ACQUIRE))
+    return -ECONNRESET; // reconnected since this call was sent; the buffer is the new socket's
+  if (ctx->c_hotplug_rx_gen != self->hc_gen || rx->rx_fd != self->hc_fd)
+  {
+    kafs_rpc_rx_reset(rx, self->hc_fd);
+    ctx->c_hotplug_rx_gen = self->hc_gen;
+  }
+  kafs_rpc_resp_hdr_t hdr;
+  int rc = kafs_rpc_rx_recv_resp_hdr(rx, &hdr);
+  if (rc != 0)
+    return rc;
+  if (hdr.payload_len > KAFS_RPC_MAX_PAYLOAD_LARGE)
+    return -EBADMSG;
+
+  pthread_mutex_lock(&ctx->c_hotplug_mux_lock);
+  kafs_hotplug_call_t *c = kafs_hotplug_mux_take_locked(ctx, hdr.req_id);
+  pthread_mutex_unlock(&ctx->c_hotplug_mux_lock);
+  // The caller stays blocked until hc_done, so its buffer is safe to fill without the lock.
+  uint32_t len = 0;
+  rc = kafs_rpc_rx_recv_resp_body(rx, &hdr, c ? c->hc_iov : NULL, c ? c->hc_iovcnt : 0, &len);
+  if (rc != 0 && rc != -EMSGSIZE)
+  {
+    if (c)
+    {
+      pthread_mutex_lock(&ctx->c_hotplug_mux_lock);
+      c->hc_rc = rc;
+      c->hc_done = 1;
+      pthread_mutex_unlock(&ctx->c_hotplug_mux_lock);
+    }
+    return rc;
+  }
+  if (!c)
+  {
+    __atomic_add_fetch(&ctx->c_stat_hotplug_rpc_orphans, 1u, __ATOMIC_RELAXED);
+    return 0;
+  }
+  if (c != self)
+    __atomic_add_fetch(&ctx->c_stat_hotplug_rpc_handoffs, 1u, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&ctx->c_hotplug_mux_lock);
+  c->hc_hdr = hdr;
+  c->hc_len = len;
+  c->hc_rc = rc; // -EMSGSIZE: body larger than the caller's buffer (already discarded)
+  c->hc_done = 1;
+  pthread_mutex_unlock(&ctx->c_hotplug_mux_lock);
+  return 0;
+}
+
+// Send one request and wait for the response with the same req_id. Requests from different FUSE
+// threads are pipelined on the socket: sends queued while another thread is writing go out
+// together in one sendmsg (c_hotplug_tx), and whichever waiting caller holds the reader role
+// demultiplexes responses to the others. The request body is gathered from req_iov and the
+// response body scattered into resp_iov, so bulk data is never staged in a bounce buffer.
+// Returns the transport result; the back's result is in resp_hdr->result.
+static int kafs_hotplug_rpc_callv(kafs_context_t *ctx, uint16_t op, const struct iovec *req_iov,
+                                  int req_iovcnt, kafs_rpc_resp_hdr_t *resp_hdr,
+                                  const struct iovec *resp_iov, int resp_iovcnt,
+                                  uint32_t *resp_len)
+{
+  if (!ctx->c_hotplug_mux_init || !ctx->c_hotplug_tx || !ctx->c_hotplug_rx)
+    return -ENOTCONN;
+  kafs_hotplug_call_t call;
+  memset(&call, 0, sizeof(call));
+  call.hc_req_id = kafs_rpc_next_req_id();
+  call.hc_gen = __atomic_load_n(&ctx->c_hotplug_conn_gen, __ATOMIC_ACQUIRE);
+  call.hc_fd = ctx->c_hotplug_fd;
+  call.hc_iov = resp_iov;
+  call.hc_iovcnt = resp_iovcnt;
+
+  // Register before sending so a fast response always finds its caller.
+  pthread_mutex_lock(&ctx->c_hotplug_mux_lock);
+  call.hc_next = ctx->c_hotplug_calls;
+  ctx->c_hotplug_calls = &call;
+  uint32_t inflight = ++ctx->c_hotplug_inflight;
+  if (inflight > ctx->c_hotplug_inflight_max)
+    ctx->c_hotplug_inflight_max = inflight;
+  pthread_mutex_unlock(&ctx->c_hotplug_mux_lock);
+  __atomic_add_fetch(&ctx->c_stat_hotplug_rpc_calls, 1u, __ATOMIC_RELAXED);
+
+  int rc = kafs_rpc_tx_send_msg(ctx->c_hotplug_tx, call.hc_fd, op, KAFS_RPC_FLAG_ENDIAN_HOST,
+                                call.hc_req_id, ctx->c_hotplug_session_id, ctx->c_hotplug_epoch,
+                                req_iov, req_iovcnt);
+
+  pthread_mutex_lock(&ctx->c_hotplug_mux_lock);
+  if (rc != 0)
+  {
+    if (!call.hc_done)
+      (void)kafs_hotplug_mux_take_locked(ctx, call.hc_req_id);
+    call.hc_done = 1;
+    call.hc_rc = rc;
+  }
+  while (!call.hc_done)
+  {
+    if (ctx->c_hotplug_mux_reader)
+    {
+      pthread_cond_wait(&ctx->c_hotplug_mux_cond, &ctx->c_hotplug_mux_lock);
+      continue;
+    }
+    ctx->c_hotplug_mux_reader = 1;
+    pthread_mutex_unlock(&ctx->c_hotplug_mux_lock);
+    int rrc = kafs_hotplug_mux_recv_one(ctx, &call);
+    pthread_mutex_lock(&ctx->c_hotplug_mux_lock);
+    ctx->c_hotplug_mux_reader = 0;
+    if (rrc != 0)
+      kafs_hotplug_mux_fail_locked(ctx, call.hc_gen, rrc);
+    pthread_cond_broadcast(&ctx->c_hotplug_mux_cond);
+  }
+  ctx->c_hotplug_inflight--;
+  pthread_mutex_unlock(&ctx->c_hotplug_mux_lock);
+
+  *resp_hdr = call.hc_hdr;
+  if (resp_len)
+    *resp_len = call.hc_len;
+  return call.hc_rc;
+}
+
+static int kafs_hotplug_rpc_call(kafs_context_t *ctx, uint16_t op, const void *req,
+                                 uint32_t req_len, kafs_rpc_resp_hdr_t *resp_hdr, void *resp,
+                                 uint32_t resp_cap, uint32_t *resp_len)
+{
+  struct iovec req_iov = {(void *)req, req_len};
+  struct iovec resp_iov = {resp, resp_cap};
+  return kafs_hotplug_rpc_callv(ctx, op, &req_iov, 1, resp_hdr, &resp_iov, 1, resp_len);
+}
+
 static int kafs_hotplug_call_getattr(struct fuse_context *fctx, kafs_context_t *ctx,
                                      kafs_sinode_t *inoent, struct stat *st)
 {
@@ -6877,36 +7637,245 @@ static int kafs_hotplug_call_getattr(struct fuse_context *fctx, kafs_context_t *
   req.uid = (uint32_t)fctx->uid;
   req.gid = (uint32_t)fctx->gid;
   req.pid = (uint32_t)fctx->pid;
-  uint64_t req_id = kafs_rpc_next_req_id();
 
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_lock(&ctx->c_hotplug_lock);
-  int rc =
-      kafs_rpc_send_msg(ctx->c_hotplug_fd, KAFS_RPC_OP_GETATTR, KAFS_RPC_FLAG_ENDIAN_HOST, req_id,
-                        ctx->c_hotplug_session_id, ctx->c_hotplug_epoch, &req, sizeof(req));
+  kafs_rpc_resp_hdr_t resp_hdr;
+  kafs_rpc_getattr_resp_t resp;
+  uint32_t resp_len = 0;
+  int rc = kafs_hotplug_rpc_call(ctx, KAFS_RPC_OP_GETATTR, &req, sizeof(req), &resp_hdr, &resp,
+                                 sizeof(resp), &resp_len);
+  if (rc == 0 && resp_hdr.result != 0)
+    rc = resp_hdr.result;
+  if (rc == 0 && resp_len != sizeof(resp))
+    rc = -EBADMSG;
   if (rc == 0)
+    *st = resp.st;
+  if (kafs_hotplug_is_disconnect_error(rc))
   {
-    kafs_rpc_resp_hdr_t resp_hdr;
-    kafs_rpc_getattr_resp_t resp;
-    uint32_t resp_len = 0;
-    rc = kafs_rpc_recv_resp(ctx->c_hotplug_fd, &resp_hdr, &resp, sizeof(resp), &resp_len);
-    if (rc == 0 && resp_hdr.req_id != req_id)
-      rc = -EBADMSG;
-    if (rc == 0 && resp_hdr.result != 0)
-      rc = resp_hdr.result;
-    if (rc == 0 && resp_len != sizeof(resp))
-      rc = -EBADMSG;
-    if (rc == 0)
-      *st = resp.st;
+    kafs_hotplug_mark_disconnected(ctx, rc);
+    rc = -EIO;
+  }
+  return rc;
+}
+
+// Namespace and metadata RPCs. Once the back advertises KAFS_RPC_HELLO_FEATURE_NS it owns the
+// namespace and the open-handle table and the FUSE operations below forward to it; they return
+// KAFS_HOTPLUG_NS_LOCAL (run locally) while hotplug is off or the back lacks the feature. A request
+// that was sent is never retried locally: the caller gets the back's answer, or -EIO if the back
+// went away before answering (it may already have applied the change).
+#define KAFS_HOTPLUG_NS_LOCAL 1
+
+static int kafs_hotplug_ns_ready(kafs_context_t *ctx)
+{
+  int rc = kafs_hotplug_wait_ready(ctx);
+  if (rc != 0)
+    return rc;
+  if ((ctx->c_hotplug_back_features & KAFS_RPC_HELLO_FEATURE_NS) == 0)
+    return -ENOSYS;
+  return 0;
+}
+
+static void kafs_hotplug_ns_req_init(kafs_rpc_ns_req_t *req, const struct fuse_context *fctx,
+                                     const struct fuse_file_info *fi)
+{
+  memset(req, 0, sizeof(*req));
+  req->uid = (uint32_t)fctx->uid;
+  req->gid = (uint32_t)fctx->gid;
+  req->pid = (uint32_t)fctx->pid;
+  if (fi)
+  {
+    req->ino = (uint32_t)fi->fh;
+    req->flags |= KAFS_RPC_NS_F_FH;
+  }
+}
+
+static int kafs_hotplug_ns_call(kafs_context_t *ctx, uint16_t op, kafs_rpc_ns_req_t *req,
+                                const void *extra, uint32_t extra_len, const char *path,
+                                const char *path2, void *resp, uint32_t resp_cap,
+                                uint32_t *resp_len)
+{
+  if (kafs_hotplug_ns_ready(ctx) != 0)
+    return KAFS_HOTPLUG_NS_LOCAL;
+  uint8_t buf[sizeof(kafs_rpc_ns_req_t) + sizeof(kafs_rpc_setattr_t) + 2u * KAFS_RPC_NS_PATH_MAX];
+  int len = kafs_rpc_ns_encode(buf, sizeof(buf), req, extra, extra_len, path, path2);
+  if (len < 0)
+    return len;
+  kafs_rpc_resp_hdr_t resp_hdr;
+  uint32_t got = 0;
+  int rc = kafs_hotplug_rpc_call(ctx, op, buf, (uint32_t)len, &resp_hdr, resp, resp_cap, &got);
+  __atomic_add_fetch(&ctx->c_stat_hotplug_ns_calls, 1u, __ATOMIC_RELAXED);
+  if (kafs_hotplug_is_disconnect_error(rc))
+    kafs_hotplug_mark_disconnected(ctx, rc);
+  if (rc != 0)
+    rc = -EIO;
+  else
+    rc = resp_hdr.result;
+  if (resp_len)
+    *resp_len = got;
+  return rc;
+}
+
+// Forward one namespace op. When st is given the back's kafs_rpc_attr_t answer is stored there.
+static int kafs_hotplug_ns_op(kafs_context_t *ctx, uint16_t op, kafs_rpc_ns_req_t *req,
+                              const void *extra, uint32_t extra_len, const char *path,
+                              const char *path2, struct stat *st)
+{
+  kafs_rpc_attr_t attr;
+  uint32_t len = 0;
+  int rc = kafs_hotplug_ns_call(ctx, op, req, extra, extra_len, path, path2, &attr, sizeof(attr),
+                                &len);
+  if (rc == 0 && st)
+  {
+    if (len != sizeof(attr))
+      return -EBADMSG;
+    kafs_rpc_attr_to_stat(st, &attr);
+  }
+  return rc;
+}
+
+// Handles opened through the back are released there too (per inode, so a handle opened locally
+// while the back was away is still released locally).
+static void kafs_hotplug_ns_open_note(kafs_context_t *ctx, uint32_t ino)
+{
+  uint32_t *slot = kafs_sparse_u32_slot(ctx->c_hotplug_ns_open, ino);
+  if (slot)
+    __atomic_add_fetch(slot, 1u, __ATOMIC_RELAXED);
+}
+
+static int kafs_hotplug_ns_open_take(kafs_context_t *ctx, uint32_t ino)
+{
+  if (!ctx || !ctx->c_hotplug_ns_open || kafs_sparse_u32_get(ctx->c_hotplug_ns_open, ino) == 0)
+    return 0;
+  uint32_t *slot = kafs_sparse_u32_slot(ctx->c_hotplug_ns_open, ino);
+  uint32_t cur = __atomic_load_n(slot, __ATOMIC_RELAXED);
+  while (cur > 0)
+  {
+    if (__atomic_compare_exchange_n(slot, &cur, cur - 1u, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      return 1;
+  }
+  return 0;
+}
+
+static int kafs_hotplug_ns_readdir_emit(kafs_context_t *ctx, void *buf, fuse_fill_dir_t filler,
+                                        enum fuse_readdir_flags flags, const uint8_t *ents,
+                                        uint32_t ents_len, uint32_t count)
+{
+  // Check the whole chunk once so the passes below can walk it without bounds checks.
+  uint32_t off = 0;
+  for (uint32_t k = 0; k < count; ++k)
+  {
+    kafs_rpc_dirent_t d;
+    if (ents_len - off < sizeof(d))
+      return -EBADMSG;
+    memcpy(&d, ents + off, sizeof(d));
+    off += (uint32_t)sizeof(d);
+    if (d.name_len >= FILENAME_MAX || ents_len - off < d.name_len)
+      return -EBADMSG;
+    off += d.name_len;
+  }
+
+  off = 0;
+  uint32_t i = 0;
+  while (i < count)
+  {
+    // With readdirplus, fetch the attributes of the next batch of entries in one round trip.
+    uint32_t batch = count - i;
+    if (batch > KAFS_RPC_GETATTR_MULTI_MAX)
+      batch = KAFS_RPC_GETATTR_MULTI_MAX;
+    kafs_rpc_attr_result_t attrs[KAFS_RPC_GETATTR_MULTI_MAX];
+    int have_attrs = 0;
+    if (flags & FUSE_READDIR_PLUS)
+    {
+      struct
+      {
+        kafs_rpc_getattr_multi_req_t hdr;
+        uint32_t ino[KAFS_RPC_GETATTR_MULTI_MAX];
+      } mreq;
+      mreq.hdr.count = batch;
+      mreq.hdr.reserved = 0;
+      uint32_t o = off;
+      for (uint32_t k = 0; k < batch; ++k)
+      {
+        kafs_rpc_dirent_t d;
+        memcpy(&d, ents + o, sizeof(d));
+        mreq.ino[k] = d.ino;
+        o += (uint32_t)sizeof(d) + d.name_len;
+      }
+      kafs_rpc_resp_hdr_t resp_hdr;
+      uint32_t len = 0;
+      uint32_t req_len = (uint32_t)(sizeof(mreq.hdr) + batch * sizeof(uint32_t));
+      int rc = kafs_hotplug_rpc_call(ctx, KAFS_RPC_OP_GETATTR_MULTI, &mreq, req_len, &resp_hdr,
+                                     attrs, sizeof(attrs), &len);
+      if (rc == 0 && resp_hdr.result == 0 && len == batch * sizeof(attrs[0]))
+      {
+        have_attrs = 1;
+        __atomic_add_fetch(&ctx->c_stat_hotplug_ns_multi_attrs, batch, __ATOMIC_RELAXED);
+      }
+    }
+    for (uint32_t k = 0; k < batch; ++k, ++i)
+    {
+      kafs_rpc_dirent_t d;
+      memcpy(&d, ents + off, sizeof(d));
+      off += (uint32_t)sizeof(d);
+      char name[FILENAME_MAX];
+      memcpy(name, ents + off, d.name_len);
+      name[d.name_len] = '\0';
+      off += d.name_len;
+      struct stat st;
+      enum fuse_fill_dir_flags fill = 0;
+      if (have_attrs && attrs[k].result == 0)
+      {
+        kafs_rpc_attr_to_stat(&st, &attrs[k].attr);
+        fill = FUSE_FILL_DIR_PLUS;
+      }
+      else
+      {
+        memset(&st, 0, sizeof(st));
+        st.st_ino = d.ino;
+        st.st_mode = (mode_t)d.mode;
+      }
+      if (filler(buf, name, &st, 0, fill))
+        return -ENOENT;
+    }
   }
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_unlock(&ctx->c_hotplug_lock);
-  if (kafs_hotplug_is_disconnect_error(rc))
+  return 0;
+}
+
+static int kafs_hotplug_ns_readdir(struct fuse_context *fctx, kafs_context_t *ctx,
+                                   const char *path, void *buf, fuse_fill_dir_t filler,
+                                   struct fuse_file_info *fi, enum fuse_readdir_flags flags)
+{
+  uint8_t resp[KAFS_RPC_MAX_PAYLOAD];
+  uint64_t next = 0;
+  for (int chunk = 0;; ++chunk)
   {
-    kafs_hotplug_mark_disconnected(ctx, rc);
-    rc = -EIO;
+    kafs_rpc_ns_req_t req;
+    kafs_hotplug_ns_req_init(&req, fctx, fi);
+    req.arg = next;
+    uint32_t len = 0;
+    int rc = kafs_hotplug_ns_call(ctx, KAFS_RPC_OP_READDIR, &req, NULL, 0, path, NULL, resp,
+                                  sizeof(resp), &len);
+    if (rc != 0)
+    {
+      // Entries already handed to the filler cannot be taken back by a local retry.
+      if (chunk > 0 && rc == KAFS_HOTPLUG_NS_LOCAL)
+        return -EIO;
+      return rc;
+    }
+    kafs_rpc_readdir_resp_t hdr;
+    if (len < sizeof(hdr))
+      return -EBADMSG;
+    memcpy(&hdr, resp, sizeof(hdr));
+    __atomic_add_fetch(&ctx->c_stat_hotplug_ns_readdir_chunks, 1u, __ATOMIC_RELAXED);
+    if (chunk == 0 && filler(buf, ".", NULL, 0, 0))
+      return -ENOENT;
+    rc = kafs_hotplug_ns_readdir_emit(ctx, buf, filler, flags, resp + sizeof(hdr),
+                                      len - (uint32_t)sizeof(hdr), hdr.count);
+    if (rc != 0)
+      return rc;
+    if (hdr.eof || hdr.next <= next)
+      return 0;
+    next = hdr.next;
   }
-  return rc;
 }
 
 static void kafs_ctx_close_fd(kafs_context_t *ctx)
@@ -7004,7 +7973,7 @@ static int kafs_ctx_map_image(kafs_context_t *ctx, const kafs_ssuperblock_t *sbd
   intptr_t inotbl_off = 0;
   kafs_ctx_compute_map_layout(sbdisk, &mapsize, &imgsize, &blkmask_off, &inotbl_off);
 
-  ctx->c_img_base = mmap(NULL, imgsize, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->c_fd, 0);
+  ctx->c_img_base = kafs_meta_map_image(ctx, (size_t)imgsize, PROT_READ | PROT_WRITE);
   if (ctx->c_img_base == MAP_FAILED)
   {
     int err = -errno;
@@ -7018,6 +7987,7 @@ static int kafs_ctx_map_image(kafs_context_t *ctx, const kafs_ssuperblock_t *sbd
   ctx->c_mapsize = (size_t)mapsize;
   ctx->c_blkmasktbl = (void *)ctx->c_superblock + blkmask_off;
   ctx->c_inotbl = (void *)ctx->c_superblock + inotbl_off;
+  kafs_meta_map_advise(ctx);
   return 0;
 }
 
@@ -7057,6 +8027,17 @@ static void kafs_ctx_setup_meta_delta(kafs_context_t *ctx, kafs_blkcnt_t r_blkcn
 
   size_t bits = sizeof(kafs_blkmask_t) * 8u;
   size_t words = ((size_t)r_blkcnt + bits - 1u) / bits;
+  kafs_mem_plan_t plan;
+  kafs_mem_plan(ctx->c_mem_budget, &plan);
+  if (plan.mp_meta_bitmap &&
+      (uint64_t)words * (sizeof(kafs_blkmask_t) + sizeof(uint8_t)) > plan.mp_meta_bitmap)
+  {
+    // 予算に収まらない複製は持たず、ビットマップはジャーナルの差分でなく従来の経路で書く。
+    kafs_log(KAFS_LOG_INFO, "kafs: mem_budget: metadata delta disabled (bitmap copy %zu bytes)\n",
+             words * (sizeof(kafs_blkmask_t) + sizeof(uint8_t)));
+    ctx->c_meta_delta_enabled = 0;
+    return;
+  }
   ctx->c_meta_bitmap_words = calloc(words, sizeof(kafs_blkmask_t));
   ctx->c_meta_bitmap_dirty = calloc(words, sizeof(uint8_t));
   if (!ctx->c_meta_bitmap_words || !ctx->c_meta_bitmap_dirty)
@@ -7078,15 +8059,36 @@ static void kafs_ctx_setup_meta_delta(kafs_context_t *ctx, kafs_blkcnt_t r_blkcn
   ctx->c_meta_bitmap_words_enabled = 1u;
 }
 
-static void kafs_ctx_init_runtime_journal(kafs_context_t *ctx, const char *image_path,
-                                          kafs_blkcnt_t r_blkcnt, int start_pending_worker)
+// The image still looks exactly as the previous kafs-back left it in kafs_core_close_image_warm.
+static int kafs_ctx_warm_state_matches(kafs_context_t *ctx, const kafs_rpc_warm_state_t *warm)
+{
+  return kafs_journal_seq(ctx) == warm->journal_seq &&
+         (uint64_t)kafs_sb_blkcnt_free_get(ctx->c_superblock) == warm->blkcnt_free &&
+         (uint64_t)kafs_sb_inocnt_free_get(ctx->c_superblock) == warm->inocnt_free;
+}
+
+// warm: runtime state handed over by the previous kafs-back (NULL: cold start).
+// Returns 1 when the HRL free list was adopted from it instead of rebuilt by a full scan.
+static int kafs_ctx_init_runtime_journal(kafs_context_t *ctx, const char *image_path,
+                                         kafs_blkcnt_t r_blkcnt, int start_pending_worker,
+                                         const kafs_rpc_warm_state_t *warm)
 {
-  (void)kafs_hrl_open(ctx);
+  int adopted = 0;
+  if (warm)
+    adopted = kafs_hrl_open_warm(ctx, warm->hrl_free_head_plus1, warm->hrl_free_slot_count) == 0;
+  else
+    (void)kafs_hrl_open(ctx);
   (void)kafs_journal_init(ctx, image_path);
   kafs_ctx_setup_meta_delta(ctx, r_blkcnt);
   (void)kafs_journal_replay(ctx, NULL, NULL);
+  if (adopted && !kafs_ctx_warm_state_matches(ctx, warm))
+  {
+    // Someone wrote to the image after the snapshot: the free list head may be stale.
+    (void)kafs_hrl_rebuild_free_list(ctx);
+    adopted = 0;
+  }
   if (ctx->c_v6_delayed_mutation_policy_applied)
-    return;
+    return adopted;
 
   (void)kafs_pendinglog_init_or_load(ctx);
   if (ctx->c_pendinglog_enabled)
@@ -7094,21 +8096,19 @@ static void kafs_ctx_init_runtime_journal(kafs_context_t *ctx, const char *image
     (void)kafs_pendinglog_replay_mount(ctx);
     if (start_pending_worker)
       (void)kafs_pending_worker_start(ctx);
-    kafs_journal_note(ctx, "PENDINGLOG", "loaded entries=%u cap=%u", kafs_pendinglog_count(ctx),
-                      ctx->c_pendinglog_capacity);
+    kafs_journal_note(ctx, KJ_OP_PENDINGLOG, KJ_F_REASON, "loaded", KJ_F_ENTRIES,
+                      (unsigned)kafs_pendinglog_count(ctx), KJ_F_CAP,
+                      (unsigned)ctx->c_pendinglog_capacity, KJ_F_END);
   }
+  return adopted;
 }
 
 static void kafs_ctx_init_diag_state(kafs_context_t *ctx, const char *image_path,
                                      kafs_inocnt_t inocnt)
 {
   ctx->c_diag_log_fd = -1;
-  ctx->c_ino_epoch = calloc((size_t)inocnt, sizeof(uint32_t));
-  if (ctx->c_ino_epoch)
-  {
-    for (kafs_inocnt_t i = 0; i < inocnt; ++i)
-      ctx->c_ino_epoch[i] = 1u;
-  }
+  ctx->c_ino_epoch = kafs_sparse_u32_create((uint32_t)inocnt, 1u);
+  ctx->c_dedup_policy = kafs_sparse_u32_create((uint32_t)inocnt, 0u);
   if (kafs_extra_diag_enabled())
   {
     ctx->c_diag_create_seq = calloc((size_t)inocnt, sizeof(uint64_t));
@@ -7132,7 +8132,9 @@ static void kafs_ctx_init_diag_state(kafs_context_t *ctx, const char *image_path
   kafs_diag_log_open(ctx, image_path);
 }
 
-int kafs_core_open_image(const char *image_path, kafs_context_t *ctx)
+static int kafs_core_open_image_common(const char *image_path, kafs_context_t *ctx,
+                                       const kafs_rpc_warm_state_t *warm,
+                                       const kafs_rpc_warm_open_t *opens, int *out_warm)
 {
   if (!image_path || !ctx)
     return -EINVAL;
@@ -7141,6 +8143,11 @@ int kafs_core_open_image(const char *image_path, kafs_context_t *ctx)
   ctx->c_fd = open(image_path, O_RDWR, 0666);
   if (ctx->c_fd < 0)
     return -errno;
+  struct stat img_st;
+  if (warm && (fstat(ctx->c_fd, &img_st) != 0 || (uint64_t)img_st.st_dev != warm->img_dev ||
+               (uint64_t)img_st.st_ino != warm->img_ino ||
+               (uint64_t)img_st.st_size != warm->img_size))
+    warm = NULL; // state of some other image
 
   kafs_ssuperblock_t sbdisk;
   int rc = kafs_ctx_read_superblock_fd(ctx, &sbdisk);
@@ -7176,14 +8183,102 @@ int kafs_core_open_image(const char *image_path, kafs_context_t *ctx)
   }
   ctx->c_alloc_v3_summary_dirty = 1;
 
-  kafs_ctx_init_runtime_journal(ctx, image_path, r_blkcnt, 1);
+  int adopted = kafs_ctx_init_runtime_journal(ctx, image_path, r_blkcnt, 1, warm);
+  if (adopted)
+  {
+    ctx->c_ino_search = (kafs_inocnt_t)warm->ino_search;
+    ctx->c_blo_search = (kafs_blkcnt_t)warm->blo_search;
+    if (warm->alloc_summary_clean)
+      ctx->c_alloc_v3_summary_dirty = 0;
+  }
+  // Handles the front still holds stay open here whether or not the rest was adopted.
+  for (uint32_t i = 0; warm && i < warm->open_count; ++i)
+  {
+    uint32_t *slot = kafs_sparse_u32_slot(ctx->c_open_cnt, opens[i].ino);
+    if (slot)
+      *slot = opens[i].count;
+  }
+  if (out_warm)
+    *out_warm = adopted;
+  (void)kafs_journal_flusher_start(ctx);
+  return 0;
+}
+
+int kafs_core_open_image(const char *image_path, kafs_context_t *ctx)
+{
+  return kafs_core_open_image_common(image_path, ctx, NULL, NULL, NULL);
+}
+
+int kafs_core_open_image_warm(const char *image_path, kafs_context_t *ctx, const void *state,
+                              uint32_t state_len, int *out_warm)
+{
+  kafs_rpc_warm_state_t warm;
+  const kafs_rpc_warm_open_t *opens = NULL;
+  if (out_warm)
+    *out_warm = 0;
+  if (!state || kafs_rpc_warm_decode(state, state_len, &warm, &opens) != 0)
+    return kafs_core_open_image_common(image_path, ctx, NULL, NULL, NULL);
+  return kafs_core_open_image_common(image_path, ctx, &warm, opens, out_warm);
+}
+
+int kafs_core_close_image_warm(kafs_context_t *ctx, void *buf, uint32_t cap, uint32_t *out_len)
+{
+  if (!ctx || !buf || !out_len || ctx->c_fd < 0)
+    return -EINVAL;
+  // Refuse before tearing anything down so the caller can keep serving.
+  uint32_t open_count = 0;
+  uint32_t ino = 0;
+  uint32_t cnt = 0;
+  while (kafs_sparse_u32_next(ctx->c_open_cnt, &ino, &cnt))
+  {
+    ++open_count;
+    ++ino;
+  }
+  if (open_count > KAFS_RPC_WARM_OPEN_MAX ||
+      sizeof(kafs_rpc_warm_state_t) + (size_t)open_count * sizeof(kafs_rpc_warm_open_t) > cap)
+    return -E2BIG;
+  struct stat img_st;
+  if (fstat(ctx->c_fd, &img_st) != 0)
+    return -errno;
+
+  kafs_rpc_warm_state_t ws;
+  memset(&ws, 0, sizeof(ws));
+  ws.magic = KAFS_RPC_WARM_MAGIC;
+  ws.version = KAFS_RPC_WARM_VERSION;
+  ws.img_dev = (uint64_t)img_st.st_dev;
+  ws.img_ino = (uint64_t)img_st.st_ino;
+  ws.img_size = (uint64_t)img_st.st_size;
+  kafs_pending_worker_stop(ctx);
+  ws.journal_seq = kafs_journal_seq(ctx);
+  // Shutdown folds the deferred bitmap / free count deltas into the image; sample after it.
+  kafs_journal_shutdown(ctx);
+  ws.blkcnt_free = (uint64_t)kafs_sb_blkcnt_free_get(ctx->c_superblock);
+  ws.inocnt_free = (uint64_t)kafs_sb_inocnt_free_get(ctx->c_superblock);
+  ws.ino_search = (uint64_t)ctx->c_ino_search;
+  ws.blo_search = (uint64_t)ctx->c_blo_search;
+  ws.hrl_free_head_plus1 = ctx->c_hrl_free_head_plus1;
+  ws.hrl_free_slot_count = __atomic_load_n(&ctx->c_hrl_free_slot_count, __ATOMIC_RELAXED);
+  ws.alloc_summary_clean = ctx->c_alloc_v3_summary_dirty ? 0u : 1u;
+
+  kafs_rpc_warm_open_t *opens = (kafs_rpc_warm_open_t *)((uint8_t *)buf + sizeof(ws));
+  ino = 0;
+  while (ws.open_count < open_count && kafs_sparse_u32_next(ctx->c_open_cnt, &ino, &cnt))
+  {
+    opens[ws.open_count].ino = ino;
+    opens[ws.open_count].count = cnt;
+    ws.open_count++;
+    ++ino;
+  }
+  memcpy(buf, &ws, sizeof(ws));
+  *out_len = (uint32_t)(sizeof(ws) + (size_t)ws.open_count * sizeof(kafs_rpc_warm_open_t));
+  kafs_core_close_image(ctx);
   return 0;
 }
 
 void kafs_core_close_image(kafs_context_t *ctx)
 {
-  if (!ctx)
-    return;
+  if (!ctx || (ctx->c_fd < 0 && !ctx->c_img_base))
+    return; // never opened, or already closed by kafs_core_close_image_warm
   kafs_pending_worker_stop(ctx);
   (void)kafs_journal_shutdown(ctx);
   (void)kafs_hrl_close(ctx);
@@ -7252,37 +8347,89 @@ ssize_t kafs_core_write(kafs_context_t *ctx, kafs_inocnt_t ino, const void *buf,
   return ww;
 }
 
-static int kafs_hotplug_read_validate_request(kafs_context_t *ctx, size_t size)
+// Data mode actually used: SHM falls back to INLINE until the ring is attached to this back.
+static uint32_t kafs_hotplug_data_mode(const kafs_context_t *ctx)
+{
+  uint32_t mode = ctx->c_hotplug_data_mode;
+  if (mode == KAFS_RPC_DATA_SHM && !__atomic_load_n(&ctx->c_hotplug_shm_active, __ATOMIC_ACQUIRE))
+    return KAFS_RPC_DATA_INLINE;
+  return mode;
+}
+
+// Pick the data mode for one READ/WRITE. SHM takes a free slot (*slot) or degrades to INLINE.
+// Returns -EOPNOTSUPP when the request cannot travel over RPC (caller falls back to local).
+static int kafs_hotplug_rw_plan(kafs_context_t *ctx, size_t size, size_t inline_max,
+                                uint32_t *mode, int *slot)
+{
+  *slot = -1;
+  *mode = kafs_hotplug_data_mode(ctx);
+  if (*mode == KAFS_RPC_DATA_SHM)
+  {
+    if (size > ctx->c_hotplug_shm->rs_slot_size)
+      return -EOPNOTSUPP;
+    *slot = kafs_rpc_shm_slot_get(ctx->c_hotplug_shm);
+    if (*slot >= 0)
+      return 0;
+    __atomic_add_fetch(&ctx->c_stat_hotplug_shm_slot_misses, 1u, __ATOMIC_RELAXED);
+    *mode = KAFS_RPC_DATA_INLINE;
+  }
+  if (*mode == KAFS_RPC_DATA_INLINE && size > inline_max)
+    return -EOPNOTSUPP;
+  return 0;
+}
+
+static void kafs_hotplug_shm_slot_put(kafs_context_t *ctx, int slot)
+{
+  if (slot >= 0)
+    kafs_rpc_shm_slot_put(ctx->c_hotplug_shm, slot);
+}
+
+static int kafs_hotplug_read_validate_request(kafs_context_t *ctx, size_t size, uint32_t *mode,
+                                              int *slot)
 {
   int wait_rc = kafs_hotplug_wait_ready(ctx);
   if (wait_rc != 0)
     return wait_rc;
-  if (ctx->c_hotplug_data_mode == KAFS_RPC_DATA_SHM)
-    return -EOPNOTSUPP;
-  if (ctx->c_hotplug_data_mode == KAFS_RPC_DATA_INLINE &&
-      size > (KAFS_RPC_MAX_PAYLOAD - sizeof(kafs_rpc_read_resp_t)))
-    return -EOPNOTSUPP;
-  return 0;
+  return kafs_hotplug_rw_plan(ctx, size,
+                              ctx->c_hotplug_max_payload - sizeof(kafs_rpc_read_resp_t), mode,
+                              slot);
 }
 
-static void kafs_hotplug_read_prepare_request(struct fuse_context *fctx, kafs_context_t *ctx,
-                                              kafs_inocnt_t ino, size_t size, off_t offset,
-                                              kafs_rpc_read_req_t *req)
+static uint32_t kafs_hotplug_read_prepare_request(struct fuse_context *fctx, uint32_t mode,
+                                                  int slot, kafs_inocnt_t ino, size_t size,
+                                                  off_t offset, uint8_t *payload)
 {
+  kafs_rpc_read_req_t *req = (kafs_rpc_read_req_t *)payload;
   req->ino = (uint32_t)ino;
   req->uid = (uint32_t)fctx->uid;
   req->gid = (uint32_t)fctx->gid;
   req->pid = (uint32_t)fctx->pid;
   req->off = (uint64_t)offset;
   req->size = (uint32_t)size;
-  req->data_mode = ctx->c_hotplug_data_mode;
+  req->data_mode = mode;
+  if (mode != KAFS_RPC_DATA_SHM)
+    return (uint32_t)sizeof(*req);
+  kafs_rpc_shm_ref_t ref = {(uint32_t)slot, (uint32_t)size};
+  memcpy(payload + sizeof(*req), &ref, sizeof(ref));
+  return (uint32_t)(sizeof(*req) + sizeof(ref));
 }
 
-static int kafs_hotplug_read_handle_inline(kafs_context_t *ctx, char *buf, size_t size,
-                                           uint8_t *resp_buf, uint32_t resp_len)
+// INLINE data has already been scattered into buf right behind the response header.
+static int kafs_hotplug_read_handle_inline(kafs_context_t *ctx, uint32_t mode, int slot, char *buf,
+                                           size_t size, const kafs_rpc_read_resp_t *resp,
+                                           uint32_t resp_len)
 {
-  kafs_rpc_read_resp_t *resp = (kafs_rpc_read_resp_t *)resp_buf;
-  if (ctx->c_hotplug_data_mode != KAFS_RPC_DATA_INLINE)
+  if (mode == KAFS_RPC_DATA_SHM)
+  {
+    if (resp_len != sizeof(*resp) || resp->size > size)
+      return -EBADMSG;
+    memcpy(buf, kafs_rpc_shm_slot_ptr(ctx->c_hotplug_shm, (uint32_t)slot, resp->size),
+           resp->size);
+    __atomic_add_fetch(&ctx->c_stat_hotplug_shm_reads, 1u, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ctx->c_stat_hotplug_shm_bytes, resp->size, __ATOMIC_RELAXED);
+    return (int)resp->size;
+  }
+  if (mode != KAFS_RPC_DATA_INLINE)
   {
     if (resp_len != sizeof(*resp))
       return -EBADMSG;
@@ -7292,7 +8439,6 @@ static int kafs_hotplug_read_handle_inline(kafs_context_t *ctx, char *buf, size_
   uint32_t data_len = resp_len - (uint32_t)sizeof(*resp);
   if (resp->size > data_len || resp->size > size)
     return -EBADMSG;
-  memcpy(buf, resp_buf + sizeof(*resp), resp->size);
   return (int)resp->size;
 }
 
@@ -7327,62 +8473,56 @@ int kafs_core_truncate(kafs_context_t *ctx, kafs_inocnt_t ino, off_t size)
 static ssize_t kafs_hotplug_call_read(struct fuse_context *fctx, kafs_context_t *ctx,
                                       kafs_inocnt_t ino, char *buf, size_t size, off_t offset)
 {
-  int rc = kafs_hotplug_read_validate_request(ctx, size);
+  uint32_t mode;
+  int slot;
+  int rc = kafs_hotplug_read_validate_request(ctx, size, &mode, &slot);
   if (rc != 0)
     return rc;
 
-  kafs_rpc_read_req_t req;
-  kafs_hotplug_read_prepare_request(fctx, ctx, ino, size, offset, &req);
-  uint64_t req_id = kafs_rpc_next_req_id();
+  uint8_t req_buf[sizeof(kafs_rpc_read_req_t) + sizeof(kafs_rpc_shm_ref_t)];
+  uint32_t req_len =
+      kafs_hotplug_read_prepare_request(fctx, mode, slot, ino, size, offset, req_buf);
 
-  uint8_t resp_buf[KAFS_RPC_MAX_PAYLOAD];
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_lock(&ctx->c_hotplug_lock);
-  rc = kafs_rpc_send_msg(ctx->c_hotplug_fd, KAFS_RPC_OP_READ, KAFS_RPC_FLAG_ENDIAN_HOST, req_id,
-                         ctx->c_hotplug_session_id, ctx->c_hotplug_epoch, &req, sizeof(req));
+  kafs_rpc_read_resp_t resp;
+  struct iovec req_iov = {req_buf, req_len};
+  struct iovec resp_iov[2] = {{&resp, sizeof(resp)}, {buf, size}};
+  kafs_rpc_resp_hdr_t resp_hdr;
+  uint32_t resp_len = 0;
+  rc = kafs_hotplug_rpc_callv(ctx, KAFS_RPC_OP_READ, &req_iov, 1, &resp_hdr, resp_iov,
+                              mode == KAFS_RPC_DATA_INLINE ? 2 : 1, &resp_len);
   int need_local = 0;
+  if (rc == 0 && resp_hdr.result != 0)
+    rc = resp_hdr.result;
+  if (rc == 0 && resp_len < sizeof(kafs_rpc_read_resp_t))
+    rc = -EBADMSG;
   if (rc == 0)
   {
-    kafs_rpc_resp_hdr_t resp_hdr;
-    uint32_t resp_len = 0;
-    rc = kafs_rpc_recv_resp(ctx->c_hotplug_fd, &resp_hdr, resp_buf, sizeof(resp_buf), &resp_len);
-    if (rc == 0 && resp_hdr.req_id != req_id)
-      rc = -EBADMSG;
-    if (rc == 0 && resp_hdr.result != 0)
-      rc = resp_hdr.result;
-    if (rc == 0 && resp_len < sizeof(kafs_rpc_read_resp_t))
-      rc = -EBADMSG;
-    if (rc == 0)
+    rc = kafs_hotplug_read_handle_inline(ctx, mode, slot, buf, size, &resp, resp_len);
+    if (rc == 1)
     {
-      rc = kafs_hotplug_read_handle_inline(ctx, buf, size, resp_buf, resp_len);
-      if (rc == 1)
-      {
-        rc = 0;
-        need_local = 1;
-      }
+      rc = 0;
+      need_local = 1;
     }
   }
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_unlock(&ctx->c_hotplug_lock);
+  kafs_hotplug_shm_slot_put(ctx, slot);
   return kafs_hotplug_read_finish(ctx, rc, need_local, ino, buf, size, offset);
 }
 
-static int kafs_hotplug_write_validate_request(kafs_context_t *ctx, size_t size)
+static int kafs_hotplug_write_validate_request(kafs_context_t *ctx, size_t size, uint32_t *mode,
+                                               int *slot)
 {
   int wait_rc = kafs_hotplug_wait_ready(ctx);
   if (wait_rc != 0)
     return wait_rc;
-  if (ctx->c_hotplug_data_mode == KAFS_RPC_DATA_SHM)
-    return -EOPNOTSUPP;
-  if (ctx->c_hotplug_data_mode == KAFS_RPC_DATA_INLINE &&
-      size > (KAFS_RPC_MAX_PAYLOAD - sizeof(kafs_rpc_write_req_t)))
-    return -EOPNOTSUPP;
-  return 0;
+  return kafs_hotplug_rw_plan(ctx, size,
+                              ctx->c_hotplug_max_payload - sizeof(kafs_rpc_write_req_t), mode,
+                              slot);
 }
 
 static uint32_t kafs_hotplug_write_prepare_payload(struct fuse_context *fctx, kafs_context_t *ctx,
-                                                   kafs_inocnt_t ino, const char *buf, size_t size,
-                                                   off_t offset, uint8_t *payload)
+                                                   uint32_t mode, int slot, kafs_inocnt_t ino,
+                                                   const char *buf, size_t size, off_t offset,
+                                                   uint8_t *payload)
 {
   kafs_rpc_write_req_t *req = (kafs_rpc_write_req_t *)payload;
   req->ino = (uint32_t)ino;
@@ -7391,12 +8531,15 @@ static uint32_t kafs_hotplug_write_prepare_payload(struct fuse_context *fctx, ka
   req->pid = (uint32_t)fctx->pid;
   req->off = (uint64_t)offset;
   req->size = (uint32_t)size;
-  req->data_mode = ctx->c_hotplug_data_mode;
+  req->data_mode = mode;
+  // INLINE data is not copied here: the caller sends buf as a second iovec.
   uint32_t payload_len = (uint32_t)sizeof(*req);
-  if (ctx->c_hotplug_data_mode == KAFS_RPC_DATA_INLINE)
+  if (mode == KAFS_RPC_DATA_SHM)
   {
-    memcpy(payload + sizeof(*req), buf, size);
-    payload_len = (uint32_t)(sizeof(*req) + size);
+    memcpy(kafs_rpc_shm_slot_ptr(ctx->c_hotplug_shm, (uint32_t)slot, (uint32_t)size), buf, size);
+    kafs_rpc_shm_ref_t ref = {(uint32_t)slot, (uint32_t)size};
+    memcpy(payload + sizeof(*req), &ref, sizeof(ref));
+    payload_len = (uint32_t)(sizeof(*req) + sizeof(ref));
   }
   return payload_len;
 }
@@ -7421,44 +8564,49 @@ static ssize_t kafs_hotplug_call_write(struct fuse_context *fctx, kafs_context_t
                                        kafs_inocnt_t ino, const char *buf, size_t size,
                                        off_t offset)
 {
-  int rc = kafs_hotplug_write_validate_request(ctx, size);
+  uint32_t mode;
+  int slot;
+  int rc = kafs_hotplug_write_validate_request(ctx, size, &mode, &slot);
   if (rc != 0)
     return rc;
 
-  uint8_t payload[KAFS_RPC_MAX_PAYLOAD];
+  uint8_t payload[sizeof(kafs_rpc_write_req_t) + sizeof(kafs_rpc_shm_ref_t)];
   uint32_t payload_len =
-      kafs_hotplug_write_prepare_payload(fctx, ctx, ino, buf, size, offset, payload);
-  uint64_t req_id = kafs_rpc_next_req_id();
+      kafs_hotplug_write_prepare_payload(fctx, ctx, mode, slot, ino, buf, size, offset, payload);
+  struct iovec req_iov[2] = {{payload, payload_len}, {(void *)buf, size}};
 
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_lock(&ctx->c_hotplug_lock);
-  rc = kafs_rpc_send_msg(ctx->c_hotplug_fd, KAFS_RPC_OP_WRITE, KAFS_RPC_FLAG_ENDIAN_HOST, req_id,
-                         ctx->c_hotplug_session_id, ctx->c_hotplug_epoch, payload, payload_len);
+  kafs_rpc_resp_hdr_t resp_hdr;
+  kafs_rpc_write_resp_t resp;
+  struct iovec resp_iov = {&resp, sizeof(resp)};
+  uint32_t resp_len = 0;
+  rc = kafs_hotplug_rpc_callv(ctx, KAFS_RPC_OP_WRITE, req_iov,
+                              mode == KAFS_RPC_DATA_INLINE ? 2 : 1, &resp_hdr, &resp_iov, 1,
+                              &resp_len);
+  // The back writes through its own mapping, which the ranged fsync cannot see: the next fsync
+  // syncs the whole image (same file, so that covers the back's dirty pages too).
+  if (mode == KAFS_RPC_DATA_INLINE || mode == KAFS_RPC_DATA_SHM)
+    kafs_dirty_mark_full(ctx);
   int need_local = 0;
+  if (rc == 0 && resp_hdr.result != 0)
+    rc = resp_hdr.result;
+  if (rc == 0 && resp_len != sizeof(resp))
+    rc = -EBADMSG;
   if (rc == 0)
   {
-    kafs_rpc_resp_hdr_t resp_hdr;
-    kafs_rpc_write_resp_t resp;
-    uint32_t resp_len = 0;
-    rc = kafs_rpc_recv_resp(ctx->c_hotplug_fd, &resp_hdr, &resp, sizeof(resp), &resp_len);
-    if (rc == 0 && resp_hdr.req_id != req_id)
-      rc = -EBADMSG;
-    if (rc == 0 && resp_hdr.result != 0)
-      rc = resp_hdr.result;
-    if (rc == 0 && resp_len != sizeof(resp))
-      rc = -EBADMSG;
-    if (rc == 0)
+    if (mode == KAFS_RPC_DATA_INLINE)
+      rc = (int)resp.size;
+    else if (mode == KAFS_RPC_DATA_SHM)
     {
-      if (ctx->c_hotplug_data_mode == KAFS_RPC_DATA_INLINE)
-        rc = (int)resp.size;
-      else
-      {
-        need_local = 1;
-      }
+      rc = (int)resp.size;
+      __atomic_add_fetch(&ctx->c_stat_hotplug_shm_writes, 1u, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&ctx->c_stat_hotplug_shm_bytes, resp.size, __ATOMIC_RELAXED);
+    }
+    else
+    {
+      need_local = 1;
     }
   }
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_unlock(&ctx->c_hotplug_lock);
+  kafs_hotplug_shm_slot_put(ctx, slot);
   return kafs_hotplug_write_finish(ctx, rc, need_local, ino, buf, size, offset);
 }
 
@@ -7474,28 +8622,17 @@ static int kafs_hotplug_call_truncate(struct fuse_context *fctx, kafs_context_t
   req.ino = (uint32_t)kafs_ctx_ino_no(ctx, inoent);
   req.reserved = 0;
   req.size = (uint64_t)size;
-  uint64_t req_id = kafs_rpc_next_req_id();
 
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_lock(&ctx->c_hotplug_lock);
-  int rc =
-      kafs_rpc_send_msg(ctx->c_hotplug_fd, KAFS_RPC_OP_TRUNCATE, KAFS_RPC_FLAG_ENDIAN_HOST, req_id,
-                        ctx->c_hotplug_session_id, ctx->c_hotplug_epoch, &req, sizeof(req));
-  if (rc == 0)
-  {
-    kafs_rpc_resp_hdr_t resp_hdr;
-    kafs_rpc_truncate_resp_t resp;
-    uint32_t resp_len = 0;
-    rc = kafs_rpc_recv_resp(ctx->c_hotplug_fd, &resp_hdr, &resp, sizeof(resp), &resp_len);
-    if (rc == 0 && resp_hdr.req_id != req_id)
-      rc = -EBADMSG;
-    if (rc == 0 && resp_hdr.result != 0)
-      rc = resp_hdr.result;
-    if (rc == 0 && resp_len != sizeof(resp))
-      rc = -EBADMSG;
-  }
-  if (ctx->c_hotplug_lock_init)
-    pthread_mutex_unlock(&ctx->c_hotplug_lock);
+  kafs_rpc_resp_hdr_t resp_hdr;
+  kafs_rpc_truncate_resp_t resp;
+  uint32_t resp_len = 0;
+  int rc = kafs_hotplug_rpc_call(ctx, KAFS_RPC_OP_TRUNCATE, &req, sizeof(req), &resp_hdr, &resp,
+                                 sizeof(resp), &resp_len);
+  kafs_dirty_mark_full(ctx); // the back frees / rewrites blocks the ranged fsync does not track
+  if (rc == 0 && resp_hdr.result != 0)
+    rc = resp_hdr.result;
+  if (rc == 0 && resp_len != sizeof(resp))
+    rc = -EBADMSG;
   if (kafs_hotplug_is_disconnect_error(rc))
   {
     kafs_hotplug_mark_disconnected(ctx, rc);
@@ -7531,7 +8668,7 @@ static int kafs_v6_controlled_write_reject(const kafs_context_t *ctx, const char
 static int kafs_mutation_path_context(const char *path, struct fuse_context **fctx_out,
                                       struct kafs_context **ctx_out)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx ? fctx->private_data : NULL;
 
   if (fctx_out)
@@ -7546,7 +8683,7 @@ static int kafs_mutation_path_context(const char *path, struct fuse_context **fc
 
 static int kafs_op_getattr(const char *path, struct stat *st, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   if (kafs_is_ctl_path(path))
   {
@@ -7563,6 +8700,11 @@ static int kafs_op_getattr(const char *path, struct stat *st, struct fuse_file_i
     st->st_ctim = st->st_atim;
     return 0;
   }
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, fi);
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_LOOKUP, &ns_req, NULL, 0, path, NULL, st);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
   struct kafs_sinode *inoent;
   KAFS_CALL(kafs_access, fctx, ctx, path, fi, F_OK, &inoent);
   int rc_hp = kafs_hotplug_call_getattr(fctx, ctx, inoent, st);
@@ -7590,15 +8732,19 @@ static int kafs_op_getattr(const char *path, struct stat *st, struct fuse_file_i
 static int kafs_op_statfs(const char *path, struct statvfs *st)
 {
   (void)path;
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   memset(st, 0, sizeof(*st));
 
   const unsigned blksize = (unsigned)kafs_sb_blksize_get(ctx->c_superblock);
   const kafs_blkcnt_t blocks = kafs_sb_blkcnt_get(ctx->c_superblock);
   kafs_bitmap_lock(ctx);
-  const kafs_blkcnt_t bfree = kafs_sb_blkcnt_free_get(ctx->c_superblock);
+  kafs_blkcnt_t bfree = kafs_sb_blkcnt_free_get(ctx->c_superblock);
   kafs_bitmap_unlock(ctx);
+  // Speculatively reserved blocks are still available to any writer.
+  bfree += (kafs_blkcnt_t)__atomic_load_n(&ctx->c_prealloc_outstanding, __ATOMIC_RELAXED);
+  if (bfree > blocks)
+    bfree = blocks;
   const kafs_inocnt_t files = kafs_sb_inocnt_get(ctx->c_superblock);
   const kafs_inocnt_t ffree = (kafs_inocnt_t)kafs_sb_inocnt_free_get(ctx->c_superblock);
 
@@ -7616,7 +8762,7 @@ static int kafs_op_statfs(const char *path, struct statvfs *st)
   return 0;
 }
 
-#define KAFS_STATS_VERSION 18u
+#define KAFS_STATS_VERSION 39u
 
 static int kafs_u64_cmp(const void *a, const void *b)
 {
@@ -7680,6 +8826,48 @@ static void kafs_stats_snapshot_fs(kafs_context_t *ctx, kafs_stats_t *out, uint3
   out->hrl_entries_total = (uint64_t)kafs_sb_hrl_entry_cnt_get(ctx->c_superblock);
 }
 
+/// @brief 回収待ちキューから tombstone 数と最古の dtime を O(1) で埋める。
+/// 先頭を読む前に回収されていたら 1 回だけ取り直す（数は近似でよい）。
+static void kafs_stats_snapshot_tombstone(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  out->tombstone_reclaimed = __atomic_load_n(&ctx->c_stat_tombstone_reclaimed, __ATOMIC_RELAXED);
+  out->tombstone_gc_visits = __atomic_load_n(&ctx->c_stat_tombstone_gc_visits, __ATOMIC_RELAXED);
+  out->tombstone_sweep_scanned =
+      __atomic_load_n(&ctx->c_stat_tombstone_sweep_scanned, __ATOMIC_RELAXED);
+  if (!ctx->c_reclaimq)
+    return;
+  if (__atomic_load_n(&ctx->c_tombstone_sweep, __ATOMIC_ACQUIRE))
+  {
+    out->tombstone_queue_state = 2u;
+    return;
+  }
+  out->tombstone_queue_state = 1u;
+  for (int attempt = 0; attempt < 2; ++attempt)
+  {
+    uint32_t len = 0;
+    uint32_t head = kafs_reclaimq_peek(ctx->c_reclaimq, &len);
+    out->tombstone_inodes = len;
+    if (head == 0)
+      return;
+    int still = 0;
+    kafs_time_t dtime = {0};
+    kafs_inode_lock(ctx, head);
+    const kafs_sinode_t *inoent = kafs_ctx_inode_const(ctx, head);
+    if (kafs_inode_is_tombstone(inoent))
+    {
+      dtime = kafs_ino_dtime_get(inoent);
+      still = 1;
+    }
+    kafs_inode_unlock(ctx, head);
+    if (still)
+    {
+      out->tombstone_oldest_dtime_sec = (uint64_t)dtime.tv_sec;
+      out->tombstone_oldest_dtime_nsec = (uint64_t)dtime.tv_nsec;
+      return;
+    }
+  }
+}
+
 static void kafs_stats_snapshot_verbose_scan(kafs_context_t *ctx, kafs_stats_t *out,
                                              uint32_t request_flags)
 {
@@ -7690,7 +8878,10 @@ static void kafs_stats_snapshot_verbose_scan(kafs_context_t *ctx, kafs_stats_t *
 
   kafs_time_t oldest_tombstone = {0};
   int have_oldest_tombstone = 0;
-  for (kafs_inocnt_t ino = KAFS_INO_ROOTDIR; ino < (kafs_inocnt_t)out->fs_inodes_total; ++ino)
+  // キューが使えるときは kafs_stats_snapshot_tombstone で埋めてある。
+  kafs_inocnt_t scan_end = out->tombstone_queue_state == 1u ? KAFS_INO_ROOTDIR
+                                                            : (kafs_inocnt_t)out->fs_inodes_total;
+  for (kafs_inocnt_t ino = KAFS_INO_ROOTDIR; ino < scan_end; ++ino)
   {
     kafs_time_t dtime = {0};
     int is_tombstone = 0;
@@ -7745,60 +8936,65 @@ static void kafs_stats_snapshot_verbose_scan(kafs_context_t *ctx, kafs_stats_t *
 
 static void kafs_stats_snapshot_hrl(kafs_context_t *ctx, kafs_stats_t *out)
 {
-  out->hrl_put_calls = ctx->c_stat_hrl_put_calls;
-  out->hrl_put_hits = ctx->c_stat_hrl_put_hits;
-  out->hrl_put_misses = ctx->c_stat_hrl_put_misses;
-  out->hrl_put_fallback_legacy = ctx->c_stat_hrl_put_fallback_legacy;
-  out->hrl_put_ns_hash = ctx->c_stat_hrl_put_ns_hash;
-  out->hrl_put_ns_find = ctx->c_stat_hrl_put_ns_find;
-  out->hrl_put_ns_cmp_content = ctx->c_stat_hrl_put_ns_cmp_content;
-  out->hrl_put_ns_slot_alloc = ctx->c_stat_hrl_put_ns_slot_alloc;
-  out->hrl_put_ns_blk_alloc = ctx->c_stat_hrl_put_ns_blk_alloc;
-  out->hrl_put_ns_blk_write = ctx->c_stat_hrl_put_ns_blk_write;
-  out->hrl_put_chain_steps = ctx->c_stat_hrl_put_chain_steps;
-  out->hrl_put_cmp_calls = ctx->c_stat_hrl_put_cmp_calls;
-  out->hrl_rescue_attempts = ctx->c_stat_hrl_rescue_attempts;
-  out->hrl_rescue_hits = ctx->c_stat_hrl_rescue_hits;
-  out->hrl_rescue_evicts = ctx->c_stat_hrl_rescue_evicts;
+  out->hrl_put_calls = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_CALLS);
+  out->hrl_put_hits = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_HITS);
+  out->hrl_put_misses = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_MISSES);
+  out->hrl_put_fallback_legacy = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_FALLBACK_LEGACY);
+  out->hrl_put_ns_hash = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_NS_HASH);
+  out->hrl_put_ns_find = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_NS_FIND);
+  out->hrl_put_ns_cmp_content = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_NS_CMP_CONTENT);
+  out->hrl_put_ns_slot_alloc = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_NS_SLOT_ALLOC);
+  out->hrl_put_ns_blk_alloc = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_NS_BLK_ALLOC);
+  out->hrl_put_ns_blk_write = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_NS_BLK_WRITE);
+  out->hrl_put_chain_steps = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_CHAIN_STEPS);
+  out->hrl_put_cmp_calls = kafs_stat_sum(ctx, KAFS_STAT_HRL_PUT_CMP_CALLS);
+  out->hrl_rescue_attempts = kafs_stat_sum(ctx, KAFS_STAT_HRL_RESCUE_ATTEMPTS);
+  out->hrl_rescue_hits = kafs_stat_sum(ctx, KAFS_STAT_HRL_RESCUE_HITS);
+  out->hrl_rescue_evicts = kafs_stat_sum(ctx, KAFS_STAT_HRL_RESCUE_EVICTS);
 }
 
 static void kafs_stats_snapshot_locks(kafs_context_t *ctx, kafs_stats_t *out)
 {
-  out->lock_hrl_bucket_acquire = ctx->c_stat_lock_hrl_bucket_acquire;
-  out->lock_hrl_bucket_contended = ctx->c_stat_lock_hrl_bucket_contended;
-  out->lock_hrl_bucket_wait_ns = ctx->c_stat_lock_hrl_bucket_wait_ns;
-  out->lock_hrl_global_acquire = ctx->c_stat_lock_hrl_global_acquire;
-  out->lock_hrl_global_contended = ctx->c_stat_lock_hrl_global_contended;
-  out->lock_hrl_global_wait_ns = ctx->c_stat_lock_hrl_global_wait_ns;
-  out->lock_bitmap_acquire = ctx->c_stat_lock_bitmap_acquire;
-  out->lock_bitmap_contended = ctx->c_stat_lock_bitmap_contended;
-  out->lock_bitmap_wait_ns = ctx->c_stat_lock_bitmap_wait_ns;
-  out->lock_inode_acquire = ctx->c_stat_lock_inode_acquire;
-  out->lock_inode_contended = ctx->c_stat_lock_inode_contended;
-  out->lock_inode_wait_ns = ctx->c_stat_lock_inode_wait_ns;
-  out->lock_inode_alloc_acquire = ctx->c_stat_lock_inode_alloc_acquire;
-  out->lock_inode_alloc_contended = ctx->c_stat_lock_inode_alloc_contended;
-  out->lock_inode_alloc_wait_ns = ctx->c_stat_lock_inode_alloc_wait_ns;
+  out->lock_hrl_bucket_acquire = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_BUCKET_ACQUIRE);
+  out->lock_hrl_bucket_contended = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_BUCKET_CONTENDED);
+  out->lock_hrl_bucket_wait_ns = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_BUCKET_WAIT_NS);
+  out->lock_hrl_global_acquire = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_ACQUIRE);
+  out->lock_hrl_global_contended = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_CONTENDED);
+  out->lock_hrl_global_wait_ns = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_WAIT_NS);
+  out->lock_bitmap_acquire = kafs_stat_sum(ctx, KAFS_STAT_LOCK_BITMAP_ACQUIRE);
+  out->lock_bitmap_contended = kafs_stat_sum(ctx, KAFS_STAT_LOCK_BITMAP_CONTENDED);
+  out->lock_bitmap_wait_ns = kafs_stat_sum(ctx, KAFS_STAT_LOCK_BITMAP_WAIT_NS);
+  out->lock_inode_acquire = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_ACQUIRE);
+  out->lock_inode_contended = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_CONTENDED);
+  out->lock_inode_wait_ns = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_WAIT_NS);
+  out->lock_inode_stripes = kafs_inode_lock_stripes(ctx);
+  out->lock_inode_reentrant = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_REENTRANT);
+  out->inode_track_bytes = kafs_sparse_u32_bytes(ctx->c_open_cnt) +
+                           kafs_sparse_u32_bytes(ctx->c_ino_epoch) +
+                           kafs_sparse_u32_bytes(ctx->c_dedup_policy);
+  out->lock_inode_alloc_acquire = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_ALLOC_ACQUIRE);
+  out->lock_inode_alloc_contended = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_ALLOC_CONTENDED);
+  out->lock_inode_alloc_wait_ns = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_ALLOC_WAIT_NS);
 }
 
 static void kafs_stats_snapshot_access(kafs_context_t *ctx, kafs_stats_t *out)
 {
-  out->access_calls = ctx->c_stat_access_calls;
-  out->access_path_walk_calls = ctx->c_stat_access_path_walk_calls;
-  out->access_fh_fastpath_hits = ctx->c_stat_access_fh_fastpath_hits;
-  out->access_path_components = ctx->c_stat_access_path_components;
-  out->dir_snapshot_calls = ctx->c_stat_dir_snapshot_calls;
-  out->dir_snapshot_bytes = ctx->c_stat_dir_snapshot_bytes;
-  out->dir_snapshot_meta_load_calls = ctx->c_stat_dir_snapshot_meta_load_calls;
-  out->dirent_view_next_calls = ctx->c_stat_dirent_view_next_calls;
+  out->access_calls = kafs_stat_sum(ctx, KAFS_STAT_ACCESS_CALLS);
+  out->access_path_walk_calls = kafs_stat_sum(ctx, KAFS_STAT_ACCESS_PATH_WALK_CALLS);
+  out->access_fh_fastpath_hits = kafs_stat_sum(ctx, KAFS_STAT_ACCESS_FH_FASTPATH_HITS);
+  out->access_path_components = kafs_stat_sum(ctx, KAFS_STAT_ACCESS_PATH_COMPONENTS);
+  out->dir_snapshot_calls = kafs_stat_sum(ctx, KAFS_STAT_DIR_SNAPSHOT_CALLS);
+  out->dir_snapshot_bytes = kafs_stat_sum(ctx, KAFS_STAT_DIR_SNAPSHOT_BYTES);
+  out->dir_snapshot_meta_load_calls = kafs_stat_sum(ctx, KAFS_STAT_DIR_SNAPSHOT_META_LOAD_CALLS);
+  out->dirent_view_next_calls = kafs_stat_sum(ctx, KAFS_STAT_DIRENT_VIEW_NEXT_CALLS);
 }
 
 static void kafs_stats_snapshot_pwrite(kafs_context_t *ctx, kafs_stats_t *out)
 {
-  out->pwrite_calls = ctx->c_stat_pwrite_calls;
-  out->pwrite_bytes = ctx->c_stat_pwrite_bytes;
-  out->pwrite_ns_iblk_read = ctx->c_stat_pwrite_ns_iblk_read;
-  out->pwrite_ns_iblk_write = ctx->c_stat_pwrite_ns_iblk_write;
+  out->pwrite_calls = kafs_stat_sum(ctx, KAFS_STAT_PWRITE_CALLS);
+  out->pwrite_bytes = kafs_stat_sum(ctx, KAFS_STAT_PWRITE_BYTES);
+  out->pwrite_ns_iblk_read = kafs_stat_sum(ctx, KAFS_STAT_PWRITE_NS_IBLK_READ);
+  out->pwrite_ns_iblk_write = kafs_stat_sum(ctx, KAFS_STAT_PWRITE_NS_IBLK_WRITE);
   out->pwrite_iblk_write_sample_count =
       __atomic_load_n(&ctx->c_stat_pwrite_iblk_write_sample_count, __ATOMIC_RELAXED);
   out->pwrite_iblk_write_sample_cap = (uint64_t)(sizeof(ctx->c_stat_pwrite_iblk_write_samples) /
@@ -7816,34 +9012,36 @@ static void kafs_stats_snapshot_pwrite(kafs_context_t *ctx, kafs_stats_t *out)
     out->pwrite_iblk_write_p95_ns = kafs_percentile_u64(tmp, n, 0.95);
     out->pwrite_iblk_write_p99_ns = kafs_percentile_u64(tmp, n, 0.99);
   }
-  out->iblk_write_ns_hrl_put = ctx->c_stat_iblk_write_ns_hrl_put;
-  out->iblk_write_ns_legacy_blk_write = ctx->c_stat_iblk_write_ns_legacy_blk_write;
-  out->iblk_write_ns_dec_ref = ctx->c_stat_iblk_write_ns_dec_ref;
+  out->iblk_write_ns_hrl_put = kafs_stat_sum(ctx, KAFS_STAT_IBLK_WRITE_NS_HRL_PUT);
+  out->iblk_write_ns_legacy_blk_write =
+      kafs_stat_sum(ctx, KAFS_STAT_IBLK_WRITE_NS_LEGACY_BLK_WRITE);
+  out->iblk_write_ns_dec_ref = kafs_stat_sum(ctx, KAFS_STAT_IBLK_WRITE_NS_DEC_REF);
 }
 
 static void kafs_stats_snapshot_alloc(kafs_context_t *ctx, kafs_stats_t *out)
 {
-  out->blk_alloc_calls = ctx->c_stat_blk_alloc_calls;
-  out->blk_alloc_claim_retries = ctx->c_stat_blk_alloc_claim_retries;
-  out->blk_alloc_ns_scan = ctx->c_stat_blk_alloc_ns_scan;
-  out->blk_alloc_ns_claim = ctx->c_stat_blk_alloc_ns_claim;
-  out->blk_alloc_ns_set_usage = ctx->c_stat_blk_alloc_ns_set_usage;
+  out->blk_alloc_calls = kafs_stat_sum(ctx, KAFS_STAT_BLK_ALLOC_CALLS);
+  out->blk_alloc_claim_retries = kafs_stat_sum(ctx, KAFS_STAT_BLK_ALLOC_CLAIM_RETRIES);
+  out->blk_alloc_ns_scan = kafs_stat_sum(ctx, KAFS_STAT_BLK_ALLOC_NS_SCAN);
+  out->blk_alloc_ns_claim = kafs_stat_sum(ctx, KAFS_STAT_BLK_ALLOC_NS_CLAIM);
+  out->blk_alloc_ns_set_usage = kafs_stat_sum(ctx, KAFS_STAT_BLK_ALLOC_NS_SET_USAGE);
 
-  out->blk_set_usage_calls = ctx->c_stat_blk_set_usage_calls;
-  out->blk_set_usage_alloc_calls = ctx->c_stat_blk_set_usage_alloc_calls;
-  out->blk_set_usage_free_calls = ctx->c_stat_blk_set_usage_free_calls;
-  out->blk_set_usage_ns_bit_update = ctx->c_stat_blk_set_usage_ns_bit_update;
-  out->blk_set_usage_ns_freecnt_update = ctx->c_stat_blk_set_usage_ns_freecnt_update;
-  out->blk_set_usage_ns_wtime_update = ctx->c_stat_blk_set_usage_ns_wtime_update;
+  out->blk_set_usage_calls = kafs_stat_sum(ctx, KAFS_STAT_BLK_SET_USAGE_CALLS);
+  out->blk_set_usage_alloc_calls = kafs_stat_sum(ctx, KAFS_STAT_BLK_SET_USAGE_ALLOC_CALLS);
+  out->blk_set_usage_free_calls = kafs_stat_sum(ctx, KAFS_STAT_BLK_SET_USAGE_FREE_CALLS);
+  out->blk_set_usage_ns_bit_update = kafs_stat_sum(ctx, KAFS_STAT_BLK_SET_USAGE_NS_BIT_UPDATE);
+  out->blk_set_usage_ns_freecnt_update =
+      kafs_stat_sum(ctx, KAFS_STAT_BLK_SET_USAGE_NS_FREECNT_UPDATE);
+  out->blk_set_usage_ns_wtime_update = kafs_stat_sum(ctx, KAFS_STAT_BLK_SET_USAGE_NS_WTIME_UPDATE);
 }
 
 static void kafs_stats_snapshot_bg_dedup(kafs_context_t *ctx, kafs_stats_t *out)
 {
-  out->copy_share_attempt_blocks = ctx->c_stat_copy_share_attempt_blocks;
-  out->copy_share_done_blocks = ctx->c_stat_copy_share_done_blocks;
-  out->copy_share_fallback_blocks = ctx->c_stat_copy_share_fallback_blocks;
-  out->copy_share_skip_unaligned = ctx->c_stat_copy_share_skip_unaligned;
-  out->copy_share_skip_dst_inline = ctx->c_stat_copy_share_skip_dst_inline;
+  out->copy_share_attempt_blocks = kafs_stat_sum(ctx, KAFS_STAT_COPY_SHARE_ATTEMPT_BLOCKS);
+  out->copy_share_done_blocks = kafs_stat_sum(ctx, KAFS_STAT_COPY_SHARE_DONE_BLOCKS);
+  out->copy_share_fallback_blocks = kafs_stat_sum(ctx, KAFS_STAT_COPY_SHARE_FALLBACK_BLOCKS);
+  out->copy_share_skip_unaligned = kafs_stat_sum(ctx, KAFS_STAT_COPY_SHARE_SKIP_UNALIGNED);
+  out->copy_share_skip_dst_inline = kafs_stat_sum(ctx, KAFS_STAT_COPY_SHARE_SKIP_DST_INLINE);
   out->bg_dedup_replacements = ctx->c_stat_bg_dedup_replacements;
   out->bg_dedup_evicts = ctx->c_stat_bg_dedup_evicts;
   out->bg_dedup_retries = ctx->c_stat_bg_dedup_retries;
@@ -7859,6 +9057,22 @@ static void kafs_stats_snapshot_bg_dedup(kafs_context_t *ctx, kafs_stats_t *out)
   out->bg_dedup_last_direct_candidates = ctx->c_bg_dedup_last_direct_candidates;
   out->bg_dedup_last_replacements = ctx->c_bg_dedup_last_replacements;
   out->bg_dedup_idle_skip_streak = ctx->c_bg_dedup_idle_skip_streak;
+  out->bg_dedup_log_cap = ctx->c_bg_dedup_log ? ctx->c_bg_dedup_log->dl_mask + 1u : 0u;
+  out->bg_dedup_sweep = __atomic_load_n(&ctx->c_bg_dedup_sweep, __ATOMIC_RELAXED);
+  out->bg_dedup_log_pending = kafs_dedup_log_pending(ctx->c_bg_dedup_log, NULL);
+  kafs_dedup_log_counters(ctx->c_bg_dedup_log, &out->bg_dedup_log_noted,
+                          &out->bg_dedup_log_dropped);
+  out->bg_dedup_log_consumed =
+      __atomic_load_n(&ctx->c_stat_bg_dedup_log_consumed, __ATOMIC_RELAXED);
+  out->bg_dedup_log_stale = __atomic_load_n(&ctx->c_stat_bg_dedup_log_stale, __ATOMIC_RELAXED);
+  out->bg_dedup_sweeps = __atomic_load_n(&ctx->c_stat_bg_dedup_sweeps, __ATOMIC_RELAXED);
+  out->dedup_bypass_sample = ctx->c_dedup_bypass_sample;
+  out->dedup_bypass_hit_pct = ctx->c_dedup_bypass_hit_pct;
+  out->dedup_bypass_blocks = kafs_stat_sum(ctx, KAFS_STAT_DEDUP_BYPASS_BLOCKS);
+  out->dedup_bypass_probes = __atomic_load_n(&ctx->c_stat_dedup_bypass_probes, __ATOMIC_RELAXED);
+  out->dedup_bypass_enter = __atomic_load_n(&ctx->c_stat_dedup_bypass_enter, __ATOMIC_RELAXED);
+  out->dedup_bypass_leave = __atomic_load_n(&ctx->c_stat_dedup_bypass_leave, __ATOMIC_RELAXED);
+  out->dedup_bypass_keep = __atomic_load_n(&ctx->c_stat_dedup_bypass_keep, __ATOMIC_RELAXED);
 
   uint64_t now_ns = kafs_now_ns();
   if (ctx->c_bg_dedup_cold_start_due_ns > now_ns)
@@ -7886,6 +9100,9 @@ static void kafs_stats_snapshot_pending_worker(kafs_context_t *ctx, kafs_stats_t
   out->pending_resolved = __atomic_load_n(&ctx->c_stat_pending_resolved, __ATOMIC_RELAXED);
   out->pending_old_block_freed =
       __atomic_load_n(&ctx->c_stat_pending_old_block_freed, __ATOMIC_RELAXED);
+  out->pending_workers = ctx->c_pending_worker_running ? ctx->c_pending_workers : 0u;
+  out->pending_resolved_ahead =
+      __atomic_load_n(&ctx->c_stat_pending_resolved_ahead, __ATOMIC_RELAXED);
 
   pthread_mutex_lock(&ctx->c_pending_worker_lock);
   kafs_pendinglog_hdr_t *hdr = kafs_pendinglog_hdr_ptr(ctx);
@@ -7925,12 +9142,202 @@ static void kafs_stats_snapshot_runtime_config(kafs_context_t *ctx, kafs_stats_t
   out->pending_worker_nice = ctx->c_pending_worker_nice;
   out->bg_dedup_worker_prio_mode = ctx->c_bg_dedup_worker_prio_mode;
   out->bg_dedup_worker_nice = ctx->c_bg_dedup_worker_nice;
+  out->prealloc_blocks = kafs_prealloc_enabled(ctx) ? ctx->c_prealloc_blocks : 0u;
+}
+
+static void kafs_stats_snapshot_prealloc(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  out->prealloc_windows = kafs_stat_sum(ctx, KAFS_STAT_PREALLOC_WINDOWS);
+  out->prealloc_reserved_blocks =
+      kafs_stat_sum(ctx, KAFS_STAT_PREALLOC_RESERVED_BLOCKS);
+  out->prealloc_hits = kafs_stat_sum(ctx, KAFS_STAT_PREALLOC_HITS);
+  out->prealloc_misses = kafs_stat_sum(ctx, KAFS_STAT_PREALLOC_MISSES);
+  out->prealloc_wasted_blocks =
+      kafs_stat_sum(ctx, KAFS_STAT_PREALLOC_WASTED_BLOCKS);
+  out->prealloc_outstanding_blocks =
+      __atomic_load_n(&ctx->c_prealloc_outstanding, __ATOMIC_RELAXED);
+}
+
+static void kafs_stats_snapshot_cblk(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  out->compress_enabled = ctx->c_cblk_enabled ? 1u : 0u;
+  out->cblk_slots = KAFS_CBLK_SLOTS;
+  out->cblk_stored = __atomic_load_n(&ctx->c_stat_cblk_stored, __ATOMIC_RELAXED);
+  out->cblk_raw = __atomic_load_n(&ctx->c_stat_cblk_raw, __ATOMIC_RELAXED);
+  out->cblk_bytes_out = __atomic_load_n(&ctx->c_stat_cblk_bytes_out, __ATOMIC_RELAXED);
+  out->cblk_containers = __atomic_load_n(&ctx->c_stat_cblk_containers, __ATOMIC_RELAXED);
+  out->cblk_containers_freed =
+      __atomic_load_n(&ctx->c_stat_cblk_containers_freed, __ATOMIC_RELAXED);
+  out->cblk_read_hits = kafs_stat_sum(ctx, KAFS_STAT_CBLK_READ_HITS);
+  out->cblk_read_decodes = kafs_stat_sum(ctx, KAFS_STAT_CBLK_READ_DECODES);
+  out->lock_cblk_acquire = kafs_stat_sum(ctx, KAFS_STAT_LOCK_CBLK_ACQUIRE);
+  out->lock_cblk_contended = kafs_stat_sum(ctx, KAFS_STAT_LOCK_CBLK_CONTENDED);
+  out->lock_cblk_wait_ns = kafs_stat_sum(ctx, KAFS_STAT_LOCK_CBLK_WAIT_NS);
+
+  kafs_bcache_counters_t bc;
+  kafs_bcache_counters(ctx->c_bcache, &bc);
+  out->blk_cache_bytes = kafs_bcache_bytes(ctx->c_bcache);
+  out->blk_cache_hits = bc.hits;
+  out->blk_cache_misses = bc.misses;
+  out->blk_cache_inserts = bc.inserts;
+  out->blk_cache_evictions = bc.evictions;
+  out->blk_cache_invalidations = bc.invalidations;
+}
+
+static void kafs_stats_snapshot_journal(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  kafs_journal_stats_t js;
+  kafs_journal_stats_get(ctx, &js);
+  out->journal_commits = js.commits;
+  out->journal_flushes = js.flushes;
+  out->journal_sync_waits = js.sync_waits;
+  out->journal_gc_window_ns = js.window_ns;
+  out->journal_gc_max_window_ns = js.max_window_ns;
+  out->journal_flusher_running = js.flusher_running;
+  out->journal_uring = js.uring;
+  out->journal_uring_flushes = js.uring_flushes;
+}
+
+static void kafs_stats_snapshot_fsync(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  out->fsync_ranged = kafs_dirty_enabled(ctx) ? 1u : 0u;
+  out->fsync_ranged_calls = __atomic_load_n(&ctx->c_stat_fsync_ranged, __ATOMIC_RELAXED);
+  out->fsync_full_calls = __atomic_load_n(&ctx->c_stat_fsync_full, __ATOMIC_RELAXED);
+  out->fsync_ranged_bytes = __atomic_load_n(&ctx->c_stat_fsync_ranged_bytes, __ATOMIC_RELAXED);
+  out->fsync_dirty_overflows = __atomic_load_n(&ctx->c_stat_dirty_overflows, __ATOMIC_RELAXED);
+}
+
+static void kafs_stats_snapshot_meta_map(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  out->meta_hugepage = ctx->c_meta_hugepage;
+  out->meta_prefault_state = __atomic_load_n(&ctx->c_meta_prefault_state, __ATOMIC_ACQUIRE);
+  out->meta_hugepage_bytes = __atomic_load_n(&ctx->c_stat_meta_hugepage_bytes, __ATOMIC_RELAXED);
+  out->meta_prefault_bytes = __atomic_load_n(&ctx->c_stat_meta_prefault_bytes, __ATOMIC_RELAXED);
+  out->meta_prefault_ns = __atomic_load_n(&ctx->c_stat_meta_prefault_ns, __ATOMIC_RELAXED);
+}
+
+static void kafs_stats_snapshot_io_engine(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  out->io_engine = ctx->c_io_engine;
+  out->io_read_blocks = kafs_stat_sum(ctx, KAFS_STAT_IO_READ_BLOCKS);
+  out->io_write_blocks = kafs_stat_sum(ctx, KAFS_STAT_IO_WRITE_BLOCKS);
+  out->io_direct_fallbacks = __atomic_load_n(&ctx->c_stat_io_direct_fallbacks, __ATOMIC_RELAXED);
+}
+
+static void kafs_stats_snapshot_mem(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  kafs_mem_plan_t plan;
+  kafs_mem_plan(ctx->c_mem_budget, &plan);
+  out->mem_budget = ctx->c_mem_budget;
+  out->mem_blk_cache_bytes = kafs_bcache_bytes(ctx->c_bcache);
+  out->mem_lock_bytes = kafs_ctx_locks_bytes(ctx);
+  out->mem_hrl_locks = kafs_hrl_bucket_locks(ctx);
+  out->mem_track_bytes = kafs_sparse_u32_bytes(ctx->c_open_cnt) +
+                         kafs_sparse_u32_bytes(ctx->c_ino_epoch) +
+                         kafs_sparse_u32_bytes(ctx->c_dedup_policy);
+  if (ctx->c_reclaimq)
+    out->mem_track_bytes += kafs_sparse_u32_bytes(ctx->c_reclaimq->rq_prev) +
+                            kafs_sparse_u32_bytes(ctx->c_reclaimq->rq_next);
+  if (ctx->c_meta_bitmap_words_enabled)
+    out->mem_meta_bitmap_bytes =
+        (uint64_t)ctx->c_meta_bitmap_wordcnt * (sizeof(kafs_blkmask_t) + sizeof(uint8_t));
+  out->mem_fixed_bytes = sizeof(ctx->c_bg_dedup_idx_fast) + sizeof(ctx->c_bg_dedup_idx_blo) +
+                         kafs_mem_trim_bytes(ctx->c_mem_trim);
+  if (ctx->c_bg_dedup_log)
+    out->mem_fixed_bytes += sizeof(kafs_dedup_log_t) +
+                            ((uint64_t)ctx->c_bg_dedup_log->dl_mask + 1u) *
+                                sizeof(kafs_dedup_log_ent_t);
+  if (ctx->c_dirty_tbl)
+    out->mem_fixed_bytes += sizeof(kafs_dirty_table_t);
+  if (ctx->c_stat_shards)
+    out->mem_fixed_bytes += ((uint64_t)ctx->c_stat_shard_mask + 1u) * sizeof(kafs_stat_shard_t);
+  if (ctx->c_mem_trim)
+  {
+    out->mem_meta_resident =
+        __atomic_load_n(&ctx->c_mem_trim->mt_resident_bytes, __ATOMIC_RELAXED);
+    out->mem_meta_target = plan.mp_meta_resident;
+    out->mem_trim_runs = __atomic_load_n(&ctx->c_mem_trim->mt_runs, __ATOMIC_RELAXED);
+    out->mem_cold_bytes = __atomic_load_n(&ctx->c_mem_trim->mt_cold_bytes, __ATOMIC_RELAXED);
+    out->mem_pageout_bytes = __atomic_load_n(&ctx->c_mem_trim->mt_pageout_bytes, __ATOMIC_RELAXED);
+  }
+}
+
+static void kafs_stats_snapshot_hotplug(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  out->hotplug_rpc_calls = __atomic_load_n(&ctx->c_stat_hotplug_rpc_calls, __ATOMIC_RELAXED);
+  out->hotplug_rpc_handoffs = __atomic_load_n(&ctx->c_stat_hotplug_rpc_handoffs, __ATOMIC_RELAXED);
+  out->hotplug_rpc_orphans = __atomic_load_n(&ctx->c_stat_hotplug_rpc_orphans, __ATOMIC_RELAXED);
+  out->hotplug_rpc_inflight = __atomic_load_n(&ctx->c_hotplug_inflight, __ATOMIC_RELAXED);
+  out->hotplug_rpc_inflight_max = __atomic_load_n(&ctx->c_hotplug_inflight_max, __ATOMIC_RELAXED);
+  if (ctx->c_hotplug_tx)
+  {
+    out->hotplug_rpc_tx_msgs = __atomic_load_n(&ctx->c_hotplug_tx->tx_msgs, __ATOMIC_RELAXED);
+    out->hotplug_rpc_tx_batches =
+        __atomic_load_n(&ctx->c_hotplug_tx->tx_batches, __ATOMIC_RELAXED);
+    out->hotplug_rpc_tx_batch_max =
+        __atomic_load_n(&ctx->c_hotplug_tx->tx_batch_max, __ATOMIC_RELAXED);
+  }
+  if (ctx->c_hotplug_rx)
+  {
+    out->hotplug_rpc_rx_msgs = __atomic_load_n(&ctx->c_hotplug_rx->rx_msgs, __ATOMIC_RELAXED);
+    out->hotplug_rpc_rx_syscalls =
+        __atomic_load_n(&ctx->c_hotplug_rx->rx_syscalls, __ATOMIC_RELAXED);
+  }
+  if (ctx->c_hotplug_active)
+    out->hotplug_rpc_max_payload = ctx->c_hotplug_max_payload;
+  out->hotplug_warm_restarts =
+      __atomic_load_n(&ctx->c_stat_hotplug_warm_restarts, __ATOMIC_RELAXED);
+  out->hotplug_cold_restarts =
+      __atomic_load_n(&ctx->c_stat_hotplug_cold_restarts, __ATOMIC_RELAXED);
+  out->hotplug_warm_state_bytes =
+      __atomic_load_n(&ctx->c_stat_hotplug_warm_state_bytes, __ATOMIC_RELAXED);
+  if (__atomic_load_n(&ctx->c_hotplug_shm_active, __ATOMIC_ACQUIRE) && ctx->c_hotplug_shm)
+  {
+    out->hotplug_shm_slots = ctx->c_hotplug_shm->rs_slot_count;
+    out->hotplug_shm_slot_size = ctx->c_hotplug_shm->rs_slot_size;
+  }
+  out->hotplug_shm_reads = __atomic_load_n(&ctx->c_stat_hotplug_shm_reads, __ATOMIC_RELAXED);
+  out->hotplug_shm_writes = __atomic_load_n(&ctx->c_stat_hotplug_shm_writes, __ATOMIC_RELAXED);
+  out->hotplug_shm_bytes = __atomic_load_n(&ctx->c_stat_hotplug_shm_bytes, __ATOMIC_RELAXED);
+  out->hotplug_shm_slot_misses =
+      __atomic_load_n(&ctx->c_stat_hotplug_shm_slot_misses, __ATOMIC_RELAXED);
+  out->hotplug_ns_calls = __atomic_load_n(&ctx->c_stat_hotplug_ns_calls, __ATOMIC_RELAXED);
+  out->hotplug_ns_readdir_chunks =
+      __atomic_load_n(&ctx->c_stat_hotplug_ns_readdir_chunks, __ATOMIC_RELAXED);
+  out->hotplug_ns_multi_attrs =
+      __atomic_load_n(&ctx->c_stat_hotplug_ns_multi_attrs, __ATOMIC_RELAXED);
+}
+
+static void kafs_stats_snapshot_bgsched(kafs_context_t *ctx, kafs_stats_t *out)
+{
+  kafs_bgsched_stats_t bs;
+  kafs_bgsched_stats_get(ctx->c_bgsched, &bs);
+  out->bg_threads = bs.threads;
+  out->bg_busy_pct = ctx->c_bg_busy_pct;
+  out->bg_fg_busy = bs.fg_busy;
+  out->bg_windows = bs.windows;
+  out->bg_busy_windows = bs.busy_windows;
+  out->bg_fg_ops = kafs_bg_fg_ops(ctx);
+  for (uint32_t i = 0; i < KAFS_STATS_BG_WORK; ++i)
+  {
+    out->bg_work_runs[i] = bs.runs[i];
+    out->bg_work_run_ns[i] = bs.run_ns[i];
+    out->bg_work_throttled[i] = bs.throttled[i];
+  }
+  for (uint32_t i = 1; i < KAFS_BG_PENDING_SHARDS_MAX; ++i)
+  {
+    uint32_t id = kafs_bg_work_pending_id(i);
+    out->bg_work_runs[KAFS_STATS_BG_PENDING] += bs.runs[id];
+    out->bg_work_run_ns[KAFS_STATS_BG_PENDING] += bs.run_ns[id];
+    out->bg_work_throttled[KAFS_STATS_BG_PENDING] += bs.throttled[id];
+  }
 }
 
 static void kafs_stats_snapshot(kafs_context_t *ctx, kafs_stats_t *out, uint32_t request_flags)
 {
   memset(out, 0, sizeof(*out));
   kafs_stats_snapshot_fs(ctx, out, request_flags);
+  kafs_stats_snapshot_tombstone(ctx, out);
   kafs_stats_snapshot_verbose_scan(ctx, out, request_flags);
   kafs_stats_snapshot_hrl(ctx, out);
   kafs_stats_snapshot_locks(ctx, out);
@@ -7941,6 +9348,17 @@ static void kafs_stats_snapshot(kafs_context_t *ctx, kafs_stats_t *out, uint32_t
   kafs_stats_snapshot_pending_worker(ctx, out);
   kafs_stats_snapshot_metadata_regions(ctx, out);
   kafs_stats_snapshot_runtime_config(ctx, out);
+  kafs_stats_snapshot_prealloc(ctx, out);
+  kafs_stats_snapshot_cblk(ctx, out);
+  kafs_stats_snapshot_journal(ctx, out);
+  kafs_stats_snapshot_fsync(ctx, out);
+  kafs_stats_snapshot_meta_map(ctx, out);
+  kafs_stats_snapshot_io_engine(ctx, out);
+  kafs_stats_snapshot_mem(ctx, out);
+  kafs_stats_snapshot_hotplug(ctx, out);
+  kafs_stats_snapshot_bgsched(ctx, out);
+  out->stats_shards = ctx->c_stat_shards ? ctx->c_stat_shard_mask + 1u : 0u;
+  out->stats_record_counters = KAFS_ENABLE_RECORD_STATS ? 1u : 0u;
 }
 
 #ifdef __linux__
@@ -8145,7 +9563,7 @@ static int kafs_copy_regular_try_share_locked(kafs_context_t *ctx, kafs_sinode_t
   if (ctx->c_hrl_bucket_cnt == 0 || remain < (kafs_off_t)blksize ||
       (src_off & ((kafs_off_t)blksize - 1)) != 0 || (dst_off & ((kafs_off_t)blksize - 1)) != 0)
   {
-    __atomic_add_fetch(&ctx->c_stat_copy_share_skip_unaligned, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_COPY_SHARE_SKIP_UNALIGNED, 1u);
     return 0;
   }
 
@@ -8159,13 +9577,13 @@ static int kafs_copy_regular_try_share_locked(kafs_context_t *ctx, kafs_sinode_t
     }
     else
     {
-      __atomic_add_fetch(&ctx->c_stat_copy_share_skip_dst_inline, 1u, __ATOMIC_RELAXED);
+      kafs_stat_add(ctx, KAFS_STAT_COPY_SHARE_SKIP_DST_INLINE, 1u);
       return 0;
     }
   }
 
   size_t blocks = (size_t)(remain >> log_blksize);
-  __atomic_add_fetch(&ctx->c_stat_copy_share_attempt_blocks, (uint64_t)blocks, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_COPY_SHARE_ATTEMPT_BLOCKS, (uint64_t)blocks);
   size_t copied_blocks = 0;
   for (size_t i = 0; i < blocks; ++i)
   {
@@ -8214,16 +9632,7 @@ static ssize_t kafs_copy_regular_range(kafs_context_t *ctx, kafs_sinode_t *ino_i
   if (ino_src == ino_dst)
     return 0;
 
-  if (ino_src < ino_dst)
-  {
-    kafs_inode_lock(ctx, ino_src);
-    kafs_inode_lock(ctx, ino_dst);
-  }
-  else
-  {
-    kafs_inode_lock(ctx, ino_dst);
-    kafs_inode_lock(ctx, ino_src);
-  }
+  kafs_inode_lock_pair(ctx, ino_src, ino_dst);
 
   kafs_off_t src_size = kafs_ino_size_get(ino_in);
   if ((kafs_off_t)offset_in >= src_size)
@@ -8345,7 +9754,7 @@ static int kafs_copy_share_one_iblk_locked(kafs_context_t *ctx, kafs_sinode_t *s
 
   if (old_blo == src_blo)
   {
-    __atomic_add_fetch(&ctx->c_stat_copy_share_done_blocks, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_COPY_SHARE_DONE_BLOCKS, 1u);
     return 0;
   }
 
@@ -8354,7 +9763,7 @@ static int kafs_copy_share_one_iblk_locked(kafs_context_t *ctx, kafs_sinode_t *s
     int irc = kafs_hrl_inc_ref_by_blo(ctx, src_blo);
     if (irc == -ENOENT || irc == -ENOSYS)
     {
-      __atomic_add_fetch(&ctx->c_stat_copy_share_fallback_blocks, 1u, __ATOMIC_RELAXED);
+      kafs_stat_add(ctx, KAFS_STAT_COPY_SHARE_FALLBACK_BLOCKS, 1u);
       return -EAGAIN;
     }
     if (irc < 0)
@@ -8379,7 +9788,7 @@ static int kafs_copy_share_one_iblk_locked(kafs_context_t *ctx, kafs_sinode_t *s
 
   kafs_copy_share_append_release(release_list, &release_cnt, old_blo);
   kafs_copy_share_release_refs(ctx, ino_dst, release_list, release_cnt);
-  __atomic_add_fetch(&ctx->c_stat_copy_share_done_blocks, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_COPY_SHARE_DONE_BLOCKS, 1u);
   return 0;
 }
 
@@ -8492,7 +9901,7 @@ static void kafs_ctl_fill_status(const kafs_context_t *ctx, kafs_rpc_hotplug_sta
   memset(out, 0, sizeof(*out));
   out->version = KAFS_HOTPLUG_STATUS_VERSION;
   out->state = (uint32_t)ctx->c_hotplug_state;
-  out->data_mode = ctx->c_hotplug_data_mode;
+  out->data_mode = kafs_hotplug_data_mode(ctx);
   out->session_id = ctx->c_hotplug_session_id;
   out->epoch = ctx->c_hotplug_epoch;
   out->last_error = ctx->c_hotplug_last_error;
@@ -8518,11 +9927,42 @@ static void kafs_ctl_fill_status(const kafs_context_t *ctx, kafs_rpc_hotplug_sta
   out->pending_ttl_over_hard = ctx->c_pending_ttl_over_hard;
 }
 
-static void kafs_ctl_write_status_response(const kafs_context_t *ctx, unsigned char *resp_payload,
+// Ask the back for its execution pool metrics over the data socket. Backs that do not advertise
+// KAFS_RPC_HELLO_FEATURE_BACK_STATUS are not asked; the fields then stay zero.
+static void kafs_ctl_fill_back_status(kafs_context_t *ctx, kafs_rpc_hotplug_status_t *out)
+{
+  if (!kafs_hotplug_enabled(ctx) || ctx->c_hotplug_state != KAFS_HOTPLUG_STATE_CONNECTED ||
+      (ctx->c_hotplug_back_features & KAFS_RPC_HELLO_FEATURE_BACK_STATUS) == 0)
+    return;
+  kafs_rpc_resp_hdr_t resp_hdr;
+  kafs_rpc_back_status_t bst;
+  uint32_t resp_len = 0;
+  int rc = kafs_hotplug_rpc_call(ctx, KAFS_RPC_OP_CTL_STATUS, NULL, 0, &resp_hdr, &bst,
+                                 sizeof(bst), &resp_len);
+  if (rc == 0 && resp_hdr.result != 0)
+    rc = resp_hdr.result;
+  if (rc == 0 && resp_len != sizeof(bst))
+    rc = -EBADMSG;
+  if (kafs_hotplug_is_disconnect_error(rc))
+    kafs_hotplug_mark_disconnected(ctx, rc);
+  if (rc != 0)
+    return;
+  out->back_status_valid = 1;
+  out->back_workers = bst.workers;
+  out->back_queue_depth = bst.queue_depth;
+  out->back_queue_depth_max = bst.queue_depth_max;
+  out->back_requests = bst.requests;
+  out->back_service_ns = bst.service_ns;
+  out->back_service_ns_max = bst.service_ns_max;
+  out->back_queue_wait_ns = bst.queue_wait_ns;
+}
+
+static void kafs_ctl_write_status_response(kafs_context_t *ctx, unsigned char *resp_payload,
                                            uint32_t *resp_len)
 {
   kafs_rpc_hotplug_status_t st;
   kafs_ctl_fill_status(ctx, &st);
+  kafs_ctl_fill_back_status(ctx, &st);
   memcpy(resp_payload, &st, sizeof(st));
   *resp_len = (uint32_t)sizeof(st);
 }
@@ -8587,7 +10027,6 @@ static void kafs_ctl_apply_pending_worker_priority(kafs_context_t *ctx, uint32_t
     ctx->c_pending_worker_prio_mode = ctx->c_pending_worker_prio_base_mode;
     ctx->c_pending_worker_nice = ctx->c_pending_worker_nice_base;
   }
-  ctx->c_pending_worker_prio_dirty = 1;
   kafs_pending_worker_notify_all(ctx);
 }
 
@@ -8608,13 +10047,7 @@ static void kafs_ctl_apply_bg_dedup_worker_priority(kafs_context_t *ctx, uint32_
     ctx->c_bg_dedup_worker_prio_mode = ctx->c_bg_dedup_worker_prio_base_mode;
     ctx->c_bg_dedup_worker_nice = ctx->c_bg_dedup_worker_nice_base;
   }
-  ctx->c_bg_dedup_worker_prio_dirty = 1;
-  if (ctx->c_bg_dedup_worker_lock_init)
-  {
-    pthread_mutex_lock(&ctx->c_bg_dedup_worker_lock);
-    pthread_cond_broadcast(&ctx->c_bg_dedup_worker_cond);
-    pthread_mutex_unlock(&ctx->c_bg_dedup_worker_lock);
-  }
+  kafs_bgsched_reprio(ctx->c_bgsched, KAFS_BG_WORK_BG_DEDUP);
 }
 
 static int kafs_ctl_handle_set_dedup_prio(kafs_context_t *ctx, uint32_t payload_len,
@@ -8672,9 +10105,8 @@ static int kafs_ctl_handle_set_runtime(kafs_context_t *ctx, uint32_t payload_len
   {
     pthread_mutex_lock(&ctx->c_pending_worker_lock);
     kafs_pending_worker_adjust_priority_locked(ctx);
-    if (ctx->c_pending_worker_prio_dirty)
-      pthread_cond_broadcast(&ctx->c_pending_worker_cond);
     pthread_mutex_unlock(&ctx->c_pending_worker_lock);
+    kafs_pending_worker_reprio_all(ctx);
   }
   return 0;
 }
@@ -8875,7 +10307,7 @@ static int kafs_op_ioctl(const char *path, int cmd, void *arg, struct fuse_file_
 {
   (void)flags;
 
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   kafs_context_t *ctx = (kafs_context_t *)fctx->private_data;
 
 #ifdef __linux__
@@ -8914,7 +10346,7 @@ static ssize_t kafs_op_copy_file_range(const char *path_in, struct fuse_file_inf
                                        struct fuse_file_info *fi_out, off_t offset_out, size_t size,
                                        int flags)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   kafs_context_t *ctx = (kafs_context_t *)fctx->private_data;
   int gate = kafs_runtime_write_guard(ctx);
   if (gate != 0)
@@ -8954,7 +10386,7 @@ static ssize_t kafs_op_copy_file_range(const char *path_in, struct fuse_file_inf
 
 static int kafs_op_open(const char *path, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   int accmode = fi->flags & O_ACCMODE;
   if (ctx && ctx->c_runtime_read_only &&
@@ -8976,6 +10408,19 @@ static int kafs_op_open(const char *path, struct fuse_file_info *fi)
     fi->direct_io = 1;
     return 0;
   }
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  ns_req.op_flags = (uint32_t)fi->flags;
+  struct stat ns_st;
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_OPEN, &ns_req, NULL, 0, path, NULL, &ns_st);
+  if (rc_ns == 0)
+  {
+    fi->fh = (uint64_t)ns_st.st_ino;
+    kafs_hotplug_ns_open_note(ctx, (uint32_t)fi->fh);
+    return 0;
+  }
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
   int ok = 0;
   if (accmode == O_RDONLY || accmode == O_RDWR)
     ok |= R_OK;
@@ -8984,8 +10429,7 @@ static int kafs_op_open(const char *path, struct fuse_file_info *fi)
   kafs_sinode_t *inoent;
   KAFS_CALL(kafs_access, fctx, ctx, path, NULL, ok, &inoent);
   fi->fh = kafs_ctx_ino_no(ctx, inoent);
-  if (ctx->c_open_cnt)
-    __atomic_add_fetch(&ctx->c_open_cnt[fi->fh], 1u, __ATOMIC_RELAXED);
+  KAFS_CALL(kafs_open_cnt_inc, ctx, (uint32_t)fi->fh);
   // Handle O_TRUNC on open for existing files to match POSIX semantics
   if ((fi->flags & O_TRUNC) && (accmode == O_WRONLY || accmode == O_RDWR))
   {
@@ -8998,7 +10442,7 @@ static int kafs_op_open(const char *path, struct fuse_file_info *fi)
 
 static int kafs_op_opendir(const char *path, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   kafs_sinode_t *inoent;
   KAFS_CALL(kafs_access, fctx, ctx, path, NULL, R_OK, &inoent);
@@ -9006,13 +10450,13 @@ static int kafs_op_opendir(const char *path, struct fuse_file_info *fi)
   return 0;
 }
 
-static int kafs_op_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset,
-                           struct fuse_file_info *fi, enum fuse_readdir_flags flags)
+// Calls fn(arg, name, ino) for every live entry of the directory at path (or fi), in on-disk
+// order. Returns 0 when all entries were visited, 1 when fn asked to stop, or -errno.
+typedef int (*kafs_dir_walk_fn)(void *arg, const char *name, kafs_inocnt_t ino);
+
+static int kafs_dir_walk(struct fuse_context *fctx, struct kafs_context *ctx, const char *path,
+                         struct fuse_file_info *fi, kafs_dir_walk_fn fn, void *arg)
 {
-  (void)offset;
-  (void)flags;
-  struct fuse_context *fctx = fuse_get_context();
-  struct kafs_context *ctx = fctx->private_data;
   kafs_sinode_t *inoent_dir;
   KAFS_CALL(kafs_access, fctx, ctx, path, fi, R_OK, &inoent_dir);
   uint32_t ino_dir = (uint32_t)kafs_ctx_ino_no(ctx, inoent_dir);
@@ -9024,13 +10468,8 @@ static int kafs_op_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
   kafs_inode_unlock(ctx, ino_dir);
   if (rc < 0)
     return rc;
-  if (filler(buf, ".", NULL, 0, 0))
-  {
-    free(snap);
-    return -ENOENT;
-  }
   kafs_dir_snapshot_meta_t meta;
-  __atomic_add_fetch(&ctx->c_stat_dir_snapshot_meta_load_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_DIR_SNAPSHOT_META_LOAD_CALLS, 1u);
   rc = kafs_dir_snapshot_meta_load(snap, snap_len, &meta);
   if (rc < 0)
   {
@@ -9038,35 +10477,64 @@ static int kafs_op_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
     return rc;
   }
   size_t o = 0;
+  rc = 0;
   while (1)
   {
     kafs_dirent_view_t view;
-    __atomic_add_fetch(&ctx->c_stat_dirent_view_next_calls, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add_rec(ctx, KAFS_STAT_DIRENT_VIEW_NEXT_CALLS, 1u);
     int step = kafs_dirent_view_next_meta(snap, &meta, o, &view);
     if (step == 0)
       break;
     if (step < 0)
     {
-      free(snap);
-      return -EIO;
+      rc = -EIO;
+      break;
     }
+    o = view.record_off + view.record_len;
     if ((view.flags & KAFS_DIRENT_FLAG_TOMBSTONE) != 0)
-    {
-      o = view.record_off + view.record_len;
       continue;
-    }
     char name[FILENAME_MAX];
     memcpy(name, view.name, view.name_len);
     name[view.name_len] = '\0';
-    if (filler(buf, name, NULL, 0, 0))
+    if (fn(arg, name, view.ino))
     {
-      free(snap);
-      return -ENOENT;
+      rc = 1;
+      break;
     }
-    o = view.record_off + view.record_len;
   }
   free(snap);
-  return 0;
+  return rc;
+}
+
+typedef struct
+{
+  void *buf;
+  fuse_fill_dir_t filler;
+} kafs_readdir_fill_t;
+
+static int kafs_readdir_fill(void *arg, const char *name, kafs_inocnt_t ino)
+{
+  kafs_readdir_fill_t *f = (kafs_readdir_fill_t *)arg;
+  (void)ino;
+  return f->filler(f->buf, name, NULL, 0, 0);
+}
+
+static int kafs_op_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset,
+                           struct fuse_file_info *fi, enum fuse_readdir_flags flags)
+{
+  (void)offset;
+  struct fuse_context *fctx = kafs_fuse_context();
+  struct kafs_context *ctx = fctx->private_data;
+  int rc_hp = kafs_hotplug_ns_readdir(fctx, ctx, path, buf, filler, fi, flags);
+  if (rc_hp != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_hp;
+  if (filler(buf, ".", NULL, 0, 0))
+    return -ENOENT;
+  kafs_readdir_fill_t f = {buf, filler};
+  int rc = kafs_dir_walk(fctx, ctx, path, fi, kafs_readdir_fill, &f);
+  if (rc == 1)
+    return -ENOENT;
+  return rc;
 }
 
 static void kafs_create_split_path(char *path_copy, const char **dirpath_out, char **basepath_out)
@@ -9088,12 +10556,12 @@ static int kafs_create_ensure_absent(struct fuse_context *fctx, struct kafs_cont
   kafs_dlog(2, "%s: access(path) rc=%d\n", __func__, ret);
   if (ret == KAFS_SUCCESS)
   {
-    kafs_journal_abort(ctx, jseq, "EEXIST");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -EEXIST, KJ_F_END);
     return -EEXIST;
   }
   if (ret != -ENOENT)
   {
-    kafs_journal_abort(ctx, jseq, "access=%d", ret);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "access", KJ_F_ERR, ret, KJ_F_END);
     return ret;
   }
   return 0;
@@ -9109,12 +10577,12 @@ static int kafs_create_resolve_parent(struct fuse_context *fctx, struct kafs_con
             (unsigned)(inoent_dir ? kafs_ctx_ino_no(ctx, inoent_dir) : 0));
   if (ret < 0)
   {
-    kafs_journal_abort(ctx, jseq, "parent access=%d", ret);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "parent access", KJ_F_ERR, ret, KJ_F_END);
     return ret;
   }
   if (!S_ISDIR(kafs_ino_mode_get(inoent_dir)))
   {
-    kafs_journal_abort(ctx, jseq, "ENOTDIR");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -ENOTDIR, KJ_F_END);
     return -ENOTDIR;
   }
   *inoent_dir_out = inoent_dir;
@@ -9133,7 +10601,7 @@ static int kafs_create_allocate_inode(struct fuse_context *fctx, struct kafs_con
   if (ret < 0)
   {
     kafs_inode_alloc_unlock(ctx);
-    kafs_journal_abort(ctx, jseq, "ino_find_free=%d", ret);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "ino_find_free", KJ_F_ERR, ret, KJ_F_END);
     return ret;
   }
 
@@ -9173,31 +10641,13 @@ static int kafs_create_allocate_inode(struct fuse_context *fctx, struct kafs_con
 static void kafs_create_lock_inodes(struct kafs_context *ctx, uint32_t ino_dir_u32,
                                     uint32_t ino_new_u32)
 {
-  if (ino_dir_u32 < ino_new_u32)
-  {
-    kafs_inode_lock(ctx, ino_dir_u32);
-    kafs_inode_lock(ctx, ino_new_u32);
-    return;
-  }
-
-  kafs_inode_lock(ctx, ino_new_u32);
-  if (ino_dir_u32 != ino_new_u32)
-    kafs_inode_lock(ctx, ino_dir_u32);
+  kafs_inode_lock_pair(ctx, ino_dir_u32, ino_new_u32);
 }
 
 static void kafs_create_unlock_inodes(struct kafs_context *ctx, uint32_t ino_dir_u32,
                                       uint32_t ino_new_u32)
 {
-  if (ino_dir_u32 < ino_new_u32)
-  {
-    kafs_inode_unlock(ctx, ino_new_u32);
-    kafs_inode_unlock(ctx, ino_dir_u32);
-    return;
-  }
-
-  if (ino_dir_u32 != ino_new_u32)
-    kafs_inode_unlock(ctx, ino_dir_u32);
-  kafs_inode_unlock(ctx, ino_new_u32);
+  kafs_inode_unlock_pair(ctx, ino_dir_u32, ino_new_u32);
 }
 
 static int kafs_create(const char *path, kafs_mode_t mode, kafs_dev_t dev, kafs_inocnt_t *pino_dir,
@@ -9206,7 +10656,7 @@ static int kafs_create(const char *path, kafs_mode_t mode, kafs_dev_t dev, kafs_
   assert(path != NULL);
   assert(path[0] == '/');
   assert(path[1] != '\0');
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   char path_copy[strlen(path) + 1];
   strcpy(path_copy, path);
@@ -9214,7 +10664,8 @@ static int kafs_create(const char *path, kafs_mode_t mode, kafs_dev_t dev, kafs_
   char *basepath = NULL;
   kafs_create_split_path(path_copy, &dirpath, &basepath);
 
-  uint64_t jseq = kafs_journal_begin(ctx, "CREATE", "path=%s mode=%o", path, (unsigned)mode);
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_CREATE, KJ_F_PATH, path, KJ_F_MODE, (unsigned)mode,
+                                     KJ_F_END);
   kafs_dlog(2, "%s: dirpath='%s' base='%s'\n", __func__, dirpath, basepath);
   int ret = kafs_create_ensure_absent(fctx, ctx, path, jseq);
   if (ret < 0)
@@ -9243,7 +10694,7 @@ static int kafs_create(const char *path, kafs_mode_t mode, kafs_dev_t dev, kafs_
   {
     kafs_ctx_inode_zero(ctx, inoent_new);
     kafs_create_unlock_inodes(ctx, ino_dir_u32, ino_new_u32);
-    kafs_journal_abort(ctx, jseq, "dirent_add=%d", ret);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dirent_add", KJ_F_ERR, ret, KJ_F_END);
     return ret;
   }
 
@@ -9269,10 +10720,29 @@ static int kafs_create(const char *path, kafs_mode_t mode, kafs_dev_t dev, kafs_
 
 static int kafs_op_create(const char *path, mode_t mode, struct fuse_file_info *fi)
 {
+  struct fuse_context *fctx = NULL;
   struct kafs_context *ctx = NULL;
-  int gate = kafs_mutation_path_context(path, NULL, &ctx);
+  int gate = kafs_mutation_path_context(path, &fctx, &ctx);
   if (gate != 0)
     return gate;
+  if (ctx)
+  {
+    kafs_rpc_ns_req_t ns_req;
+    kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+    ns_req.mode = (uint32_t)mode;
+    ns_req.flags |= KAFS_RPC_NS_F_OPEN;
+    ns_req.op_flags = (uint32_t)fi->flags;
+    struct stat ns_st;
+    int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_CREATE, &ns_req, NULL, 0, path, NULL, &ns_st);
+    if (rc_ns == 0)
+    {
+      fi->fh = (uint64_t)ns_st.st_ino;
+      kafs_hotplug_ns_open_note(ctx, (uint32_t)fi->fh);
+      return 0;
+    }
+    if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+      return rc_ns;
+  }
   kafs_inocnt_t ino_new;
   KAFS_CALL(kafs_create, path, mode | S_IFREG, 0, NULL, &ino_new);
   if (ctx)
@@ -9287,20 +10757,31 @@ static int kafs_op_create(const char *path, mode_t mode, struct fuse_file_info *
     }
   }
   fi->fh = ino_new;
-  if (ctx && ctx->c_open_cnt)
-    __atomic_add_fetch(&ctx->c_open_cnt[ino_new], 1u, __ATOMIC_RELAXED);
+  if (ctx)
+    return kafs_open_cnt_inc(ctx, (uint32_t)ino_new);
   return 0;
 }
 
 static int kafs_op_mknod(const char *path, mode_t mode, dev_t dev)
 {
+  struct fuse_context *fctx = NULL;
   struct kafs_context *ctx = NULL;
-  int gate = kafs_mutation_path_context(path, NULL, &ctx);
+  int gate = kafs_mutation_path_context(path, &fctx, &ctx);
   if (gate != 0)
     return gate;
   gate = kafs_v6_controlled_write_reject(ctx, "mknod");
   if (gate != 0)
     return gate;
+  if (ctx)
+  {
+    kafs_rpc_ns_req_t ns_req;
+    kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+    ns_req.mode = (uint32_t)mode;
+    ns_req.arg = (uint64_t)dev;
+    int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_CREATE, &ns_req, NULL, 0, path, NULL, NULL);
+    if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+      return rc_ns;
+  }
   KAFS_CALL(kafs_create, path, mode, dev, NULL, NULL);
   return 0;
 }
@@ -9585,7 +11066,7 @@ static off_t kafs_lseek_find_hole_locked(kafs_context_t *ctx, kafs_sinode_t *ino
 
 static off_t kafs_op_lseek(const char *path, off_t off, int whence, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   if (kafs_is_ctl_path(path))
     return -EACCES;
@@ -9638,7 +11119,14 @@ static int kafs_op_mkdir(const char *path, mode_t mode)
   gate = kafs_v6_controlled_write_reject(ctx, "mkdir");
   if (gate != 0)
     return gate;
-  uint64_t jseq = kafs_journal_begin(ctx, "MKDIR", "path=%s mode=%o", path, (unsigned)mode);
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  ns_req.mode = (uint32_t)mode;
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_MKDIR, &ns_req, NULL, 0, path, NULL, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_MKDIR, KJ_F_PATH, path, KJ_F_MODE, (unsigned)mode,
+                                     KJ_F_END);
   kafs_inocnt_t ino_dir;
   kafs_inocnt_t ino_new;
   KAFS_CALL(kafs_create, path, mode | S_IFDIR, 0, &ino_dir, &ino_new);
@@ -9649,8 +11137,9 @@ static int kafs_op_mkdir(const char *path, mode_t mode)
              "%s: create type mismatch path=%s ino=%" PRIuFAST32 " mode=%o expected=dir\n",
              __func__, path ? path : "(null)", (uint_fast32_t)ino_new,
              (unsigned)kafs_ino_mode_get(inoent_new));
-    kafs_journal_abort(ctx, jseq, "mkdir type mismatch ino=%u mode=%o", (unsigned)ino_new,
-                       (unsigned)kafs_ino_mode_get(inoent_new));
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "mkdir type mismatch", KJ_F_INO,
+                       (unsigned)ino_new, KJ_F_MODE, (unsigned)kafs_ino_mode_get(inoent_new),
+                       KJ_F_END);
     return -EIO;
   }
   kafs_dlog(2, "%s: created ino=%u mode=%o\n", __func__, (unsigned)ino_new,
@@ -9658,46 +11147,19 @@ static int kafs_op_mkdir(const char *path, mode_t mode)
   // Lock parent + new dir in stable order (dirent_add("..") increments parent linkcnt)
   uint32_t ino_parent = (uint32_t)ino_dir;
   uint32_t ino_new_u32 = (uint32_t)ino_new;
-  if (ino_parent < ino_new_u32)
-  {
-    kafs_inode_lock(ctx, ino_parent);
-    kafs_inode_lock(ctx, ino_new_u32);
-  }
-  else
-  {
-    kafs_inode_lock(ctx, ino_new_u32);
-    kafs_inode_lock(ctx, ino_parent);
-  }
+  kafs_inode_lock_pair(ctx, ino_parent, ino_new_u32);
 
   int rc = kafs_dirent_add(ctx, inoent_new, ino_dir, "..");
   if (rc < 0)
   {
-    if (ino_parent < ino_new_u32)
-    {
-      kafs_inode_unlock(ctx, ino_new_u32);
-      kafs_inode_unlock(ctx, ino_parent);
-    }
-    else
-    {
-      kafs_inode_unlock(ctx, ino_parent);
-      kafs_inode_unlock(ctx, ino_new_u32);
-    }
-    kafs_journal_abort(ctx, jseq, "dirent_add=%d", rc);
+    kafs_inode_unlock_pair(ctx, ino_parent, ino_new_u32);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dirent_add", KJ_F_ERR, rc, KJ_F_END);
     return rc;
   }
 
   // ".." counts as a link for the new directory too.
   kafs_ino_linkcnt_incr(inoent_new);
-  if (ino_parent < ino_new_u32)
-  {
-    kafs_inode_unlock(ctx, ino_new_u32);
-    kafs_inode_unlock(ctx, ino_parent);
-  }
-  else
-  {
-    kafs_inode_unlock(ctx, ino_parent);
-    kafs_inode_unlock(ctx, ino_new_u32);
-  }
+  kafs_inode_unlock_pair(ctx, ino_parent, ino_new_u32);
   kafs_journal_commit(ctx, jseq);
   return 0;
 }
@@ -9712,7 +11174,12 @@ static int kafs_op_rmdir(const char *path)
   gate = kafs_v6_controlled_write_reject(ctx, "rmdir");
   if (gate != 0)
     return gate;
-  uint64_t jseq = kafs_journal_begin(ctx, "RMDIR", "path=%s", path);
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_RMDIR, &ns_req, NULL, 0, path, NULL, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_RMDIR, KJ_F_PATH, path, KJ_F_END);
   char path_copy[strlen(path) + 1];
   strcpy(path_copy, path);
   const char *dirpath = path_copy;
@@ -9727,25 +11194,16 @@ static int kafs_op_rmdir(const char *path)
   kafs_mode_t mode = kafs_ino_mode_get(inoent);
   if (!S_ISDIR(mode))
   {
-    kafs_journal_abort(ctx, jseq, "ENOTDIR");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -ENOTDIR, KJ_F_END);
     return -ENOTDIR;
   }
   kafs_sinode_t *inoent_dir;
   KAFS_CALL(kafs_access, fctx, ctx, dirpath, NULL, W_OK, &inoent_dir);
 
-  // lock parent then target dir in stable order by inode number to avoid deadlock
+  // lock parent then target dir in stable (stripe) order to avoid deadlock
   uint32_t ino_parent = kafs_ctx_ino_no(ctx, inoent_dir);
   uint32_t ino_target = kafs_ctx_ino_no(ctx, inoent);
-  if (ino_parent < ino_target)
-  {
-    kafs_inode_lock(ctx, ino_parent);
-    kafs_inode_lock(ctx, ino_target);
-  }
-  else
-  {
-    kafs_inode_lock(ctx, ino_target);
-    kafs_inode_lock(ctx, ino_parent);
-  }
+  kafs_inode_lock_pair(ctx, ino_parent, ino_target);
 
   // Verify directory emptiness under lock (TOCTOU-safe).
   int empty_rc = kafs_dir_is_empty_locked(ctx, inoent);
@@ -9753,14 +11211,14 @@ static int kafs_op_rmdir(const char *path)
   {
     kafs_inode_unlock(ctx, ino_target);
     kafs_inode_unlock(ctx, ino_parent);
-    kafs_journal_abort(ctx, jseq, "dir_empty=%d", empty_rc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dir_empty", KJ_F_ERR, empty_rc, KJ_F_END);
     return empty_rc;
   }
   if (empty_rc == 0)
   {
     kafs_inode_unlock(ctx, ino_target);
     kafs_inode_unlock(ctx, ino_parent);
-    kafs_journal_abort(ctx, jseq, "ENOTEMPTY");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -ENOTEMPTY, KJ_F_END);
     return -ENOTEMPTY;
   }
 
@@ -9769,7 +11227,7 @@ static int kafs_op_rmdir(const char *path)
   {
     kafs_inode_unlock(ctx, ino_target);
     kafs_inode_unlock(ctx, ino_parent);
-    kafs_journal_abort(ctx, jseq, "dirent_remove(parent)=%d", rc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dirent_remove(parent)", KJ_F_ERR, rc, KJ_F_END);
     return rc;
   }
   rc = kafs_dirent_remove(ctx, inoent, "..");
@@ -9777,29 +11235,37 @@ static int kafs_op_rmdir(const char *path)
   {
     kafs_inode_unlock(ctx, ino_target);
     kafs_inode_unlock(ctx, ino_parent);
-    kafs_journal_abort(ctx, jseq, "dirent_remove(dotdot)=%d", rc);
-    return rc;
-  }
-
-  // Unlock in reverse order of acquisition
-  if (ino_parent < ino_target)
-  {
-    kafs_inode_unlock(ctx, ino_target);
-    kafs_inode_unlock(ctx, ino_parent);
-  }
-  else
-  {
-    kafs_inode_unlock(ctx, ino_parent);
-    kafs_inode_unlock(ctx, ino_target);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dirent_remove(dotdot)", KJ_F_ERR, rc, KJ_F_END);
+    return rc;
   }
+
+  kafs_inode_unlock_pair(ctx, ino_parent, ino_target);
   kafs_journal_commit(ctx, jseq);
   return 0;
 }
 
 static int kafs_op_readlink(const char *path, char *buf, size_t buflen)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
+  if (buflen == 0)
+    return -EINVAL;
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  uint32_t cap = KAFS_RPC_MAX_PAYLOAD;
+  if (buflen - 1u < cap)
+    cap = (uint32_t)(buflen - 1u);
+  ns_req.arg = cap;
+  uint32_t got = 0;
+  int rc_ns = kafs_hotplug_ns_call(ctx, KAFS_RPC_OP_READLINK, &ns_req, NULL, 0, path, NULL, buf,
+                                   cap, &got);
+  if (rc_ns == 0)
+  {
+    buf[got] = '\0';
+    return 0;
+  }
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
   kafs_sinode_t *inoent;
   KAFS_CALL(kafs_access, fctx, ctx, path, NULL, F_OK, &inoent);
   uint32_t ino = kafs_ctx_ino_no(ctx, inoent);
@@ -9818,7 +11284,7 @@ static int kafs_op_readlink(const char *path, char *buf, size_t buflen)
 static int kafs_op_read(const char *path, char *buf, size_t size, off_t offset,
                         struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   if (kafs_is_ctl_path(path))
   {
@@ -9832,6 +11298,7 @@ static int kafs_op_read(const char *path, char *buf, size_t size, off_t offset,
     memcpy(buf, sess->resp + offset, n);
     return (int)n;
   }
+  kafs_stat_add(ctx, KAFS_STAT_PREAD_CALLS, 1u);
   kafs_inocnt_t ino = fi->fh;
   ssize_t rc_hp = kafs_hotplug_call_read(fctx, ctx, ino, buf, size, offset);
   if (rc_hp >= 0)
@@ -9905,7 +11372,7 @@ static int kafs_op_write(const char *path, const char *buf, size_t size, off_t o
 {
   kafs_dlog(3, "%s(path=%s, size=%zu, off=%" PRIuFAST64 ")\n", __func__, path ? path : "(null)",
             size, (uint64_t)offset);
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   int gate = kafs_runtime_write_guard(ctx);
   if (gate != 0)
@@ -9959,6 +11426,19 @@ static int kafs_op_utimens(const char *path, const struct timespec tv[2], struct
   gate = kafs_v6_controlled_write_reject(ctx, "utimens");
   if (gate != 0)
     return gate;
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, fi);
+  kafs_rpc_setattr_t sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.valid = KAFS_RPC_SETATTR_TIMES;
+  sa.atime_sec = (int64_t)tv[0].tv_sec;
+  sa.atime_nsec = (uint32_t)tv[0].tv_nsec;
+  sa.mtime_sec = (int64_t)tv[1].tv_sec;
+  sa.mtime_nsec = (uint32_t)tv[1].tv_nsec;
+  int rc_ns =
+      kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_SETATTR, &ns_req, &sa, sizeof(sa), path, NULL, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
   uint64_t t0_ns = kafs_now_ns();
   kafs_sinode_t *inoent = NULL;
   uint32_t ino = KAFS_INO_NONE;
@@ -10054,6 +11534,8 @@ static kafs_linkcnt_t kafs_inode_drop_link_locked(struct kafs_context *ctx, kafs
     }
     if (reclaim_now)
       (void)kafs_try_reclaim_unlinked_inode_locked(ctx, ino, reclaimed_now);
+    if (!*reclaimed_now)
+      kafs_tombstone_enqueue_locked(ctx, ino);
   }
 
   return nl;
@@ -10072,7 +11554,12 @@ static int kafs_op_unlink(const char *path)
   gate = kafs_v6_controlled_write_reject(ctx, "unlink");
   if (gate != 0)
     return gate;
-  uint64_t jseq = kafs_journal_begin(ctx, "UNLINK", "path=%s", path);
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_UNLINK, &ns_req, NULL, 0, path, NULL, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_UNLINK, KJ_F_PATH, path, KJ_F_END);
   char path_copy[strlen(path) + 1];
   strcpy(path_copy, path);
   const char *dirpath = path_copy;
@@ -10084,7 +11571,7 @@ static int kafs_op_unlink(const char *path)
 
   if (strcmp(basepath, ".") == 0 || strcmp(basepath, "..") == 0)
   {
-    kafs_journal_abort(ctx, jseq, "EINVAL");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -EINVAL, KJ_F_END);
     return -EINVAL;
   }
 
@@ -10095,7 +11582,7 @@ static int kafs_op_unlink(const char *path)
   int arc = kafs_access(fctx, ctx, dirpath, NULL, need_mode, &inoent_dir);
   if (arc < 0)
   {
-    kafs_journal_abort(ctx, jseq, "parent access=%d", arc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "parent access", KJ_F_ERR, arc, KJ_F_END);
     return arc;
   }
   uint32_t ino_dir = kafs_ctx_ino_no(ctx, inoent_dir);
@@ -10109,7 +11596,7 @@ static int kafs_op_unlink(const char *path)
   if (s < 0)
   {
     kafs_inode_unlock(ctx, ino_dir);
-    kafs_journal_abort(ctx, jseq, "ENOENT");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -ENOENT, KJ_F_END);
     return s;
   }
   target_ino = kafs_ctx_ino_no(ctx, inoent_target);
@@ -10117,7 +11604,7 @@ static int kafs_op_unlink(const char *path)
   if (S_ISDIR(kafs_ino_mode_get(inoent_target)))
   {
     kafs_inode_unlock(ctx, ino_dir);
-    kafs_journal_abort(ctx, jseq, "EISDIR");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -EISDIR, KJ_F_END);
     return -EISDIR;
   }
 
@@ -10126,7 +11613,7 @@ static int kafs_op_unlink(const char *path)
   if (rrc < 0)
   {
     kafs_inode_unlock(ctx, ino_dir);
-    kafs_journal_abort(ctx, jseq, "dirent_remove=%d", rrc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dirent_remove", KJ_F_ERR, rrc, KJ_F_END);
     return rrc;
   }
   kafs_inode_unlock(ctx, ino_dir);
@@ -10135,7 +11622,7 @@ static int kafs_op_unlink(const char *path)
     return -ESTALE;
 
   // Decrement link count under target inode lock (keep dir lock hold time short)
-  int reclaim_now = kafs_tombstone_pressure(ctx);
+  int reclaim_now = kafs_tombstone_reclaim_now(ctx);
   int reclaimed_now = 0;
   kafs_inode_lock(ctx, (uint32_t)removed_ino);
   (void)kafs_inode_drop_link_locked(ctx, removed_ino, reclaim_now, &reclaimed_now);
@@ -10158,7 +11645,7 @@ static int kafs_op_access(const char *path, int mode)
 {
   if (kafs_is_ctl_path(path))
     return 0;
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   if ((mode & W_OK) != 0)
   {
@@ -10187,9 +11674,9 @@ static int kafs_split_parent_basename(const char *path, char *path_copy, const c
   return 0;
 }
 
-static size_t kafs_rename_prepare_lock_list(uint32_t lock_list[4], uint32_t ino_from_dir,
-                                            uint32_t ino_to_dir, uint32_t ino_src_u32,
-                                            uint32_t ino_dst_u32)
+static size_t kafs_rename_prepare_lock_list(struct kafs_context *ctx, uint32_t lock_list[4],
+                                            uint32_t ino_from_dir, uint32_t ino_to_dir,
+                                            uint32_t ino_src_u32, uint32_t ino_dst_u32)
 {
   size_t lock_n = 0;
   lock_list[lock_n++] = ino_from_dir;
@@ -10201,15 +11688,7 @@ static size_t kafs_rename_prepare_lock_list(uint32_t lock_list[4], uint32_t ino_
       ino_dst_u32 != ino_src_u32)
     lock_list[lock_n++] = ino_dst_u32;
 
-  for (size_t i = 0; i < lock_n; ++i)
-    for (size_t j = i + 1; j < lock_n; ++j)
-      if (lock_list[j] < lock_list[i])
-      {
-        uint32_t tmp = lock_list[i];
-        lock_list[i] = lock_list[j];
-        lock_list[j] = tmp;
-      }
-
+  kafs_inode_lock_sort(ctx, lock_list, lock_n);
   return lock_n;
 }
 
@@ -10238,13 +11717,13 @@ static int kafs_rename_prepare_existing_destination_locked(struct kafs_context *
   int empty_rc = kafs_dir_is_empty_locked(ctx, inoent_to_exist);
   if (empty_rc < 0)
   {
-    kafs_journal_abort(ctx, jseq, "dst_dir_empty=%d", empty_rc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dst_dir_empty", KJ_F_ERR, empty_rc, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return empty_rc;
   }
   if (empty_rc == 0)
   {
-    kafs_journal_abort(ctx, jseq, "DST_DIR_NOT_EMPTY");
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "DST_DIR_NOT_EMPTY", KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return -ENOTEMPTY;
   }
@@ -10252,7 +11731,7 @@ static int kafs_rename_prepare_existing_destination_locked(struct kafs_context *
   int rr = kafs_dirent_remove(ctx, inoent_to_exist, "..");
   if (rr < 0)
   {
-    kafs_journal_abort(ctx, jseq, "dst_remove_dotdot=%d", rr);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dst_remove_dotdot", KJ_F_ERR, rr, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return rr;
   }
@@ -10274,7 +11753,7 @@ static int kafs_rename_move_entries_locked(struct kafs_context *ctx, uint64_t js
   rc_locked = kafs_dirent_remove_nolink(ctx, inoent_dir_to, to_base, removed_dst_ino);
   if (rc_locked < 0 && rc_locked != -ENOENT)
   {
-    kafs_journal_abort(ctx, jseq, "dst_remove=%d", rc_locked);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dst_remove", KJ_F_ERR, rc_locked, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return rc_locked;
   }
@@ -10284,14 +11763,14 @@ static int kafs_rename_move_entries_locked(struct kafs_context *ctx, uint64_t js
   rc_locked = kafs_dirent_remove_nolink(ctx, inoent_dir_from, from_base, &moved_ino);
   if (rc_locked < 0)
   {
-    kafs_journal_abort(ctx, jseq, "src_remove=%d", rc_locked);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "src_remove", KJ_F_ERR, rc_locked, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return rc_locked;
   }
   if (moved_ino != ino_src)
   {
-    kafs_journal_abort(ctx, jseq, "ESTALE moved_ino=%u src=%u", (unsigned)moved_ino,
-                       (unsigned)ino_src);
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -ESTALE, KJ_F_INO, (unsigned)moved_ino, KJ_F_INO2,
+                       (unsigned)ino_src, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return -ESTALE;
   }
@@ -10299,7 +11778,7 @@ static int kafs_rename_move_entries_locked(struct kafs_context *ctx, uint64_t js
   rc_locked = kafs_dirent_add_nolink(ctx, inoent_dir_to, ino_src, to_base);
   if (rc_locked < 0)
   {
-    kafs_journal_abort(ctx, jseq, "dst_add=%d", rc_locked);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dst_add", KJ_F_ERR, rc_locked, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return rc_locked;
   }
@@ -10318,14 +11797,14 @@ static int kafs_rename_update_dotdot_locked(struct kafs_context *ctx, uint64_t j
   int rr = kafs_dirent_remove(ctx, inoent_src, "..");
   if (rr < 0)
   {
-    kafs_journal_abort(ctx, jseq, "src_remove_dotdot=%d", rr);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "src_remove_dotdot", KJ_F_ERR, rr, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return rr;
   }
   rr = kafs_dirent_add(ctx, inoent_src, (kafs_inocnt_t)ino_to_dir, "..");
   if (rr < 0)
   {
-    kafs_journal_abort(ctx, jseq, "src_add_dotdot=%d", rr);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "src_add_dotdot", KJ_F_ERR, rr, KJ_F_END);
     kafs_rename_lock_list_release(ctx, lock_list, lock_n);
     return rr;
   }
@@ -10403,12 +11882,12 @@ static int kafs_rename_check_noreplace(struct fuse_context *fctx, struct kafs_co
   int ex = kafs_access(fctx, ctx, to, NULL, F_OK, &inoent_tmp);
   if (ex == 0)
   {
-    kafs_journal_abort(ctx, jseq, "EEXIST");
+    kafs_journal_abort(ctx, jseq, KJ_F_ERR, -EEXIST, KJ_F_END);
     return -EEXIST;
   }
   if (ex != -ENOENT)
   {
-    kafs_journal_abort(ctx, jseq, "access(to)=%d", ex);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "access(to)", KJ_F_ERR, ex, KJ_F_END);
     return ex;
   }
   return 0;
@@ -10428,7 +11907,7 @@ static int kafs_rename_check_destination_type(struct fuse_context *fctx, struct
   {
     if (!S_ISDIR(dst_mode))
     {
-      kafs_journal_abort(ctx, jseq, "DST_NOT_DIR");
+      kafs_journal_abort(ctx, jseq, KJ_F_REASON, "DST_NOT_DIR", KJ_F_END);
       return -ENOTDIR;
     }
     return 0;
@@ -10436,12 +11915,12 @@ static int kafs_rename_check_destination_type(struct fuse_context *fctx, struct
 
   if (S_ISDIR(dst_mode))
   {
-    kafs_journal_abort(ctx, jseq, "DST_IS_DIR");
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "DST_IS_DIR", KJ_F_END);
     return -EISDIR;
   }
   if (!S_ISREG(dst_mode) && !S_ISLNK(dst_mode))
   {
-    kafs_journal_abort(ctx, jseq, "DST_NOT_FILE");
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "DST_NOT_FILE", KJ_F_END);
     return -EOPNOTSUPP;
   }
   return 0;
@@ -10453,7 +11932,7 @@ static void kafs_rename_finalize_replaced_inode(struct kafs_context *ctx,
   if (removed_dst_ino == KAFS_INO_NONE)
     return;
 
-  int reclaim_dst_now = kafs_tombstone_pressure(ctx);
+  int reclaim_dst_now = kafs_tombstone_reclaim_now(ctx);
   kafs_inode_lock(ctx, (uint32_t)removed_dst_ino);
   int reclaimed_dst = 0;
   (void)kafs_inode_drop_link_locked(ctx, removed_dst_ino, reclaim_dst_now, &reclaimed_dst);
@@ -10472,7 +11951,7 @@ static void kafs_rename_finalize_replaced_inode(struct kafs_context *ctx,
 static int kafs_op_rename(const char *from, const char *to, unsigned int flags)
 {
   // 最小実装: 通常ファイルのみ対応。RENAME_NOREPLACE は尊重。その他のフラグは未対応。
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   kafs_dlog(2, "%s: enter from=%s to=%s flags=%u\n", __func__, from ? from : "(null)",
             to ? to : "(null)", flags);
@@ -10482,6 +11961,12 @@ static int kafs_op_rename(const char *from, const char *to, unsigned int flags)
   gate = kafs_v6_controlled_write_reject(ctx, "rename");
   if (gate != 0)
     return gate;
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  ns_req.op_flags = flags;
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_RENAME, &ns_req, NULL, 0, from, to, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
   kafs_sinode_t *inoent_src;
   int src_is_dir = 0;
   int rc = kafs_rename_validate_request(from, to, flags);
@@ -10502,7 +11987,8 @@ static int kafs_op_rename(const char *from, const char *to, unsigned int flags)
   if (rc < 0)
     return rc;
 
-  uint64_t jseq = kafs_journal_begin(ctx, "RENAME", "from=%s to=%s flags=%u", from, to, flags);
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_RENAME, KJ_F_PATH, from, KJ_F_PATH2, to, KJ_F_FLAGS,
+                                     (unsigned)flags, KJ_F_END);
 
   kafs_sinode_t *inoent_dir_from;
   kafs_sinode_t *inoent_dir_to;
@@ -10512,7 +11998,7 @@ static int kafs_op_rename(const char *from, const char *to, unsigned int flags)
                                       &ino_from_dir, &ino_to_dir);
   if (rc < 0)
   {
-    kafs_journal_abort(ctx, jseq, "parent_lookup=%d", rc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "parent_lookup", KJ_F_ERR, rc, KJ_F_END);
     return rc;
   }
   rc = kafs_rename_check_noreplace(fctx, ctx, to, flags, jseq);
@@ -10534,8 +12020,8 @@ static int kafs_op_rename(const char *from, const char *to, unsigned int flags)
     ino_dst_u32 = kafs_ctx_ino_no(ctx, inoent_to_exist);
 
   uint32_t lock_list[4];
-  size_t lock_n =
-      kafs_rename_prepare_lock_list(lock_list, ino_from_dir, ino_to_dir, ino_src_u32, ino_dst_u32);
+  size_t lock_n = kafs_rename_prepare_lock_list(ctx, lock_list, ino_from_dir, ino_to_dir,
+                                                ino_src_u32, ino_dst_u32);
   kafs_rename_lock_list_acquire(ctx, lock_list, lock_n);
 
   rc = kafs_rename_prepare_existing_destination_locked(ctx, jseq, lock_list, lock_n, src_is_dir,
@@ -10573,7 +12059,18 @@ static int kafs_op_chmod(const char *path, mode_t mode, struct fuse_file_info *f
   gate = kafs_v6_controlled_write_reject(ctx, "chmod");
   if (gate != 0)
     return gate;
-  uint64_t jseq = kafs_journal_begin(ctx, "CHMOD", "path=%s mode=%o", path, (unsigned)mode);
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, fi);
+  kafs_rpc_setattr_t sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.valid = KAFS_RPC_SETATTR_MODE;
+  ns_req.mode = (uint32_t)mode;
+  int rc_ns =
+      kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_SETATTR, &ns_req, &sa, sizeof(sa), path, NULL, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_CHMOD, KJ_F_PATH, path, KJ_F_MODE, (unsigned)mode,
+                                     KJ_F_END);
   kafs_sinode_t *inoent;
   KAFS_CALL(kafs_access, fctx, ctx, path, fi, F_OK, &inoent);
   uint32_t ino = (uint32_t)kafs_ctx_ino_no(ctx, inoent);
@@ -10595,8 +12092,20 @@ static int kafs_op_chown(const char *path, uid_t uid, gid_t gid, struct fuse_fil
   gate = kafs_v6_controlled_write_reject(ctx, "chown");
   if (gate != 0)
     return gate;
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, fi);
+  kafs_rpc_setattr_t sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.valid = KAFS_RPC_SETATTR_OWNER;
+  sa.uid = (uint32_t)uid;
+  sa.gid = (uint32_t)gid;
+  int rc_ns =
+      kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_SETATTR, &ns_req, &sa, sizeof(sa), path, NULL, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
   uint64_t jseq =
-      kafs_journal_begin(ctx, "CHOWN", "path=%s uid=%u gid=%u", path, (unsigned)uid, (unsigned)gid);
+      kafs_journal_begin(ctx, KJ_OP_CHOWN, KJ_F_PATH, path, KJ_F_UID, (unsigned)uid, KJ_F_GID,
+                         (unsigned)gid, KJ_F_END);
   kafs_sinode_t *inoent;
   KAFS_CALL(kafs_access, fctx, ctx, path, fi, F_OK, &inoent);
   uint32_t ino = (uint32_t)kafs_ctx_ino_no(ctx, inoent);
@@ -10618,7 +12127,14 @@ static int kafs_op_symlink(const char *target, const char *linkpath)
   gate = kafs_v6_controlled_write_reject(ctx, "symlink");
   if (gate != 0)
     return gate;
-  uint64_t jseq = kafs_journal_begin(ctx, "SYMLINK", "target=%s linkpath=%s", target, linkpath);
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  int rc_ns =
+      kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_SYMLINK, &ns_req, NULL, 0, linkpath, target, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_SYMLINK, KJ_F_TARGET, target, KJ_F_PATH, linkpath,
+                                     KJ_F_END);
   kafs_inocnt_t ino;
   KAFS_CALL(kafs_create, linkpath, 0777 | S_IFLNK, 0, NULL, &ino);
   kafs_sinode_t *inoent = kafs_ctx_inode(ctx, ino);
@@ -10630,8 +12146,8 @@ static int kafs_op_symlink(const char *target, const char *linkpath)
              " mode=%o expected=symlink target=%s\n",
              __func__, linkpath ? linkpath : "(null)", (uint_fast32_t)ino, (unsigned)created_mode,
              target ? target : "(null)");
-    kafs_journal_abort(ctx, jseq, "symlink type mismatch ino=%u mode=%o", (unsigned)ino,
-                       (unsigned)created_mode);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "symlink type mismatch", KJ_F_INO, (unsigned)ino,
+                       KJ_F_MODE, (unsigned)created_mode, KJ_F_END);
     return -EIO;
   }
   kafs_inode_lock(ctx, (uint32_t)ino);
@@ -10721,7 +12237,7 @@ static int kafs_op_link(const char *from, const char *to)
   if (from[0] != '/' || to[0] != '/' || from[1] == '\0' || to[1] == '\0')
     return -EINVAL;
 
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   int gate = kafs_runtime_write_guard(ctx);
   if (gate != 0)
@@ -10729,6 +12245,11 @@ static int kafs_op_link(const char *from, const char *to)
   gate = kafs_v6_controlled_write_reject(ctx, "link");
   if (gate != 0)
     return gate;
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, NULL);
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_LINK, &ns_req, NULL, 0, from, to, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
 
   kafs_sinode_t *inoent_src;
   int rc = kafs_link_validate_source(fctx, ctx, from, &inoent_src);
@@ -10742,20 +12263,20 @@ static int kafs_op_link(const char *from, const char *to)
   if (rc < 0)
     return rc;
 
-  uint64_t jseq = kafs_journal_begin(ctx, "LINK", "from=%s to=%s", from, to);
+  uint64_t jseq = kafs_journal_begin(ctx, KJ_OP_LINK, KJ_F_PATH, from, KJ_F_PATH2, to, KJ_F_END);
 
   kafs_sinode_t *inoent_dir;
   int arc = kafs_access(fctx, ctx, to_dir, NULL, W_OK, &inoent_dir);
   if (arc < 0)
   {
-    kafs_journal_abort(ctx, jseq, "parent access=%d", arc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "parent access", KJ_F_ERR, arc, KJ_F_END);
     return arc;
   }
 
   rc = kafs_link_apply(ctx, inoent_src, inoent_dir, to_base);
   if (rc < 0)
   {
-    kafs_journal_abort(ctx, jseq, "dirent_add=%d", rc);
+    kafs_journal_abort(ctx, jseq, KJ_F_REASON, "dirent_add", KJ_F_ERR, rc, KJ_F_END);
     return rc;
   }
 
@@ -10767,7 +12288,7 @@ static int kafs_op_link(const char *from, const char *to)
 
 static int kafs_op_flush(const char *path, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx ? fctx->private_data : NULL;
   uint32_t ino = fi ? (uint32_t)fi->fh : (uint32_t)KAFS_INO_NONE;
   kafs_dlog(2, "%s: enter path=%s ino=%" PRIuFAST32 "\n", __func__, path ? path : "(null)", ino);
@@ -10860,11 +12381,26 @@ static int kafs_fsync_backing_sync(struct kafs_context *ctx, const char *path, u
                                    int isdatasync)
 {
   int src = kafs_test_forced_fsync_error(isdatasync);
+  if (src == 0 && kafs_dirty_enabled(ctx))
+  {
+    // The image file's own inode metadata never matters to KAFS, so a ranged fdatasync of this
+    // inode's blocks plus dirty metadata is as durable as fsync(2) on the whole image.
+    int drc = kafs_dirty_sync(ctx, ino);
+    if (drc < 0)
+    {
+      kafs_log(KAFS_LOG_WARNING, "%s: ranged sync failed path=%s ino=%" PRIuFAST32 " rc=%d\n",
+               __func__, path ? path : "(null)", ino, drc);
+      return drc;
+    }
+    if (drc == 0)
+      return 0;
+  }
   if (src == 0)
     src = isdatasync ? fdatasync(ctx->c_fd) : fsync(ctx->c_fd);
   if (src != 0)
   {
     int e = errno;
+    kafs_dirty_mark_full(ctx);
     kafs_log(KAFS_LOG_WARNING, "%s: %s failed path=%s ino=%" PRIuFAST32 " errno=%d\n", __func__,
              isdatasync ? "fdatasync" : "fsync", path ? path : "(null)", ino, e);
     kafs_dlog(2, "%s: exit rc=%d path=%s ino=%" PRIuFAST32 "\n", __func__, -e,
@@ -10876,7 +12412,7 @@ static int kafs_fsync_backing_sync(struct kafs_context *ctx, const char *path, u
 
 static int kafs_op_fsync(const char *path, int isdatasync, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx->private_data;
   kafs_dlog(2, "%s: enter path=%s isdatasync=%d\n", __func__, path ? path : "(null)", isdatasync);
   if (!ctx || ctx->c_fd < 0)
@@ -10886,6 +12422,12 @@ static int kafs_op_fsync(const char *path, int isdatasync, struct fuse_file_info
   }
   if (ctx->c_runtime_read_only)
     return 0;
+  kafs_rpc_ns_req_t ns_req;
+  kafs_hotplug_ns_req_init(&ns_req, fctx, fi);
+  ns_req.op_flags = (uint32_t)isdatasync;
+  int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_FSYNC, &ns_req, NULL, 0, path, NULL, NULL);
+  if (rc_ns != KAFS_HOTPLUG_NS_LOCAL)
+    return rc_ns;
 
   uint32_t ino = kafs_fsync_resolve_inode(fctx, ctx, path, fi);
   if (ino != KAFS_INO_NONE)
@@ -10898,7 +12440,21 @@ static int kafs_op_fsync(const char *path, int isdatasync, struct fuse_file_info
   uint32_t policy = ctx->c_fsync_policy;
   if (kafs_fsync_use_journal_only(ctx, isdatasync))
   {
-    kafs_journal_force_flush(ctx);
+    int jrc = kafs_journal_force_flush(ctx);
+    if (jrc < 0)
+    {
+      kafs_log(KAFS_LOG_WARNING, "%s: journal flush failed path=%s ino=%" PRIuFAST32 " rc=%d\n",
+               __func__, path ? path : "(null)", ino, jrc);
+      return jrc;
+    }
+    // With ranged sync the journal flush covers only the ring, so the file's own dirty ranges
+    // go out here (before, the ring's whole-image fsync carried them).
+    if (kafs_dirty_enabled(ctx))
+    {
+      int src = kafs_fsync_backing_sync(ctx, path, ino, isdatasync);
+      if (src != 0)
+        return src;
+    }
     kafs_dlog(2,
               "%s: exit rc=0 path=%s ino=%" PRIuFAST32
               " mode=journal-only isdatasync=%d policy=%" PRIuFAST32 "\n",
@@ -10917,7 +12473,7 @@ static int kafs_op_fsync(const char *path, int isdatasync, struct fuse_file_info
 
 static int kafs_op_fsyncdir(const char *path, int isdatasync, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx ? fctx->private_data : NULL;
   int gate = kafs_v6_controlled_write_reject(ctx, "fsyncdir");
   if (gate != 0)
@@ -10944,10 +12500,27 @@ static void *kafs_op_init(struct fuse_conn_info *conn, struct fuse_config *cfg)
       conn->want &= ~((uint32_t)FUSE_CAP_WRITEBACK_CACHE);
   }
 #endif
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   kafs_context_t *ctx = fctx ? (kafs_context_t *)fctx->private_data : NULL;
+  if (ctx)
+  {
+    int mrc = kafs_meta_prefault_start(ctx);
+    if (mrc < 0)
+      kafs_log(KAFS_LOG_WARNING, "kafs: metadata prefault start failed rc=%d\n", mrc);
+    int trc = kafs_mem_trim_start(ctx);
+    if (trc < 0)
+      kafs_log(KAFS_LOG_WARNING, "kafs: mem_budget metadata trim start failed rc=%d\n", trc);
+  }
   if (ctx && ctx->c_runtime_read_only)
     return ctx;
+  if (ctx)
+  {
+    // Threads do not survive daemonizing, so the journal flusher starts here, not in main().
+    int jrc = kafs_journal_flusher_start(ctx);
+    if (jrc < 0)
+      kafs_log(KAFS_LOG_WARNING, "kafs: journal flusher start failed rc=%d (commits fsync inline)\n",
+               jrc);
+  }
   if (ctx && ctx->c_superblock &&
       kafs_sb_format_version_get(ctx->c_superblock) == KAFS_FORMAT_VERSION_V6)
   {
@@ -10956,6 +12529,15 @@ static void *kafs_op_init(struct fuse_conn_info *conn, struct fuse_config *cfg)
                "kafs: suppressing v6 delayed/background workers without explicit policy marker\n");
     return ctx;
   }
+  if (ctx)
+  {
+    int arc = kafs_prealloc_init(ctx);
+    if (arc < 0)
+      kafs_log(KAFS_LOG_WARNING, "kafs: preallocation windows disabled rc=%d\n", arc);
+    int drc = kafs_dirty_init(ctx);
+    if (drc < 0)
+      kafs_log(KAFS_LOG_WARNING, "kafs: ranged fsync disabled rc=%d\n", drc);
+  }
   if (ctx && ctx->c_pendinglog_enabled)
   {
     int prc = kafs_pending_worker_start(ctx);
@@ -10987,6 +12569,11 @@ static void kafs_op_destroy(void *private_data)
   kafs_bg_dedup_worker_stop(ctx);
   kafs_tombstone_gc_worker_stop(ctx);
   kafs_pending_worker_stop(ctx);
+  kafs_prealloc_destroy(ctx);
+  kafs_journal_flusher_stop(ctx);
+  kafs_dirty_destroy(ctx);
+  kafs_meta_prefault_stop(ctx);
+  kafs_mem_trim_stop(ctx);
 }
 
 static int kafs_release_handle_ctl_path(const char *path, struct fuse_file_info *fi)
@@ -11004,7 +12591,7 @@ static int kafs_release_handle_ctl_path(const char *path, struct fuse_file_info
 static void kafs_release_finalize_last_open(struct kafs_context *ctx, kafs_inocnt_t ino,
                                             int *reclaimed)
 {
-  int reclaim_now = kafs_tombstone_pressure(ctx);
+  int reclaim_now = kafs_tombstone_reclaim_now(ctx);
   kafs_inode_lock(ctx, (uint32_t)ino);
   if (kafs_inode_is_tombstone(kafs_ctx_inode(ctx, ino)))
   {
@@ -11019,6 +12606,8 @@ static void kafs_release_finalize_last_open(struct kafs_context *ctx, kafs_inocn
     }
     if (reclaim_now)
       (void)kafs_try_reclaim_unlinked_inode_locked(ctx, ino, reclaimed);
+    if (!*reclaimed)
+      kafs_tombstone_enqueue_locked(ctx, ino);
   }
   else
   {
@@ -11041,7 +12630,7 @@ static void kafs_release_record_reclaimed_inode(struct kafs_context *ctx)
 
 static int kafs_op_release(const char *path, struct fuse_file_info *fi)
 {
-  struct fuse_context *fctx = fuse_get_context();
+  struct fuse_context *fctx = kafs_fuse_context();
   struct kafs_context *ctx = fctx ? fctx->private_data : NULL;
   kafs_dlog(2, "%s: enter path=%s ino=%" PRIuFAST32 "\n", __func__, path ? path : "(null)",
             fi ? (uint32_t)fi->fh : (uint32_t)KAFS_INO_NONE);
@@ -11049,26 +12638,35 @@ static int kafs_op_release(const char *path, struct fuse_file_info *fi)
     return 0;
 
   kafs_inocnt_t ino = fi->fh;
+  if (kafs_hotplug_ns_open_take(ctx, (uint32_t)ino))
+  {
+    kafs_rpc_ns_req_t ns_req;
+    kafs_hotplug_ns_req_init(&ns_req, fctx, fi);
+    ns_req.op_flags = (uint32_t)fi->flags;
+    int rc_ns = kafs_hotplug_ns_op(ctx, KAFS_RPC_OP_RELEASE, &ns_req, NULL, 0, NULL, NULL, NULL);
+    // The handle lived in the back; if that back is gone, so is the handle.
+    return (rc_ns == KAFS_HOTPLUG_NS_LOCAL || rc_ns == -EIO) ? 0 : rc_ns;
+  }
   if (ctx && ctx->c_runtime_read_only)
   {
-    if (ctx->c_open_cnt)
-      (void)__atomic_sub_fetch(&ctx->c_open_cnt[ino], 1u, __ATOMIC_RELAXED);
+    (void)kafs_open_cnt_dec(ctx, (uint32_t)ino);
     return kafs_op_flush(path, fi);
   }
   if (kafs_v6_controlled_write_active(ctx))
   {
-    if (ctx->c_open_cnt)
-      (void)__atomic_sub_fetch(&ctx->c_open_cnt[ino], 1u, __ATOMIC_RELAXED);
+    (void)kafs_open_cnt_dec(ctx, (uint32_t)ino);
     return kafs_op_flush(path, fi);
   }
   int reclaimed = 0;
   if (ctx && ctx->c_open_cnt)
   {
-    uint32_t after = __atomic_sub_fetch(&ctx->c_open_cnt[ino], 1u, __ATOMIC_RELAXED);
+    uint32_t after = kafs_open_cnt_dec(ctx, (uint32_t)ino);
     kafs_dlog(2, "%s: open_cnt after dec ino=%" PRIuFAST32 " after=%" PRIu32 "\n", __func__,
               (uint32_t)ino, after);
     if (after == 0)
     {
+      kafs_prealloc_release_ino(ctx, (uint32_t)ino);
+      kafs_dedup_policy_reset(ctx, (uint32_t)ino);
       kafs_release_finalize_last_open(ctx, ino, &reclaimed);
 
       if (reclaimed)
@@ -11081,6 +12679,284 @@ static int kafs_op_release(const char *path, struct fuse_file_info *fi)
   return rc;
 }
 
+// --- Namespace RPCs, back side ---
+// kafs-back runs the forwarded namespace ops through the same kafs_op_* handlers as a local mount,
+// with the caller's credentials in a per-thread fuse_context (see kafs_fuse_context()).
+
+typedef struct
+{
+  kafs_context_t *ctx;
+  uint8_t *out;
+  uint32_t cap;
+  uint32_t used;
+  uint32_t count;
+  uint64_t index; // entries seen so far (the READDIR cookie)
+  uint64_t skip;
+} kafs_ns_readdir_pack_t;
+
+static int kafs_ns_readdir_pack(void *arg, const char *name, kafs_inocnt_t ino)
+{
+  kafs_ns_readdir_pack_t *p = (kafs_ns_readdir_pack_t *)arg;
+  if (p->index < p->skip)
+  {
+    p->index++;
+    return 0;
+  }
+  size_t name_len = strlen(name);
+  if (p->used + sizeof(kafs_rpc_dirent_t) + name_len > p->cap)
+    return 1;
+  kafs_rpc_dirent_t d;
+  d.ino = (uint32_t)ino;
+  d.mode = 0;
+  if (ino < kafs_sb_inocnt_get(p->ctx->c_superblock))
+    d.mode = (uint32_t)kafs_ino_mode_get(kafs_ctx_inode(p->ctx, ino));
+  d.name_len = (uint16_t)name_len;
+  d.reserved = 0;
+  memcpy(p->out + p->used, &d, sizeof(d));
+  memcpy(p->out + p->used + sizeof(d), name, name_len);
+  p->used += (uint32_t)(sizeof(d) + name_len);
+  p->count++;
+  p->index++;
+  return 0;
+}
+
+static int kafs_core_ns_readdir(struct fuse_context *fctx, kafs_context_t *ctx, const char *path,
+                                struct fuse_file_info *fi, uint64_t start, void *resp,
+                                uint32_t resp_cap, uint32_t *resp_len)
+{
+  kafs_rpc_readdir_resp_t hdr;
+  if (resp_cap < sizeof(hdr))
+    return -EMSGSIZE;
+  kafs_ns_readdir_pack_t p = {ctx, (uint8_t *)resp + sizeof(hdr), resp_cap - (uint32_t)sizeof(hdr),
+                              0, 0, 0, start};
+  int rc = kafs_dir_walk(fctx, ctx, path, fi, kafs_ns_readdir_pack, &p);
+  if (rc < 0)
+    return rc;
+  hdr.count = p.count;
+  hdr.eof = rc == 0;
+  hdr.next = p.index;
+  memcpy(resp, &hdr, sizeof(hdr));
+  *resp_len = (uint32_t)sizeof(hdr) + p.used;
+  return 0;
+}
+
+static int kafs_core_ns_getattr_multi(kafs_context_t *ctx, const void *payload, uint32_t len,
+                                      void *resp, uint32_t resp_cap, uint32_t *resp_len)
+{
+  kafs_rpc_getattr_multi_req_t req;
+  if (len < sizeof(req))
+    return -EBADMSG;
+  memcpy(&req, payload, sizeof(req));
+  if (req.count > KAFS_RPC_GETATTR_MULTI_MAX ||
+      len != sizeof(req) + (uint64_t)req.count * sizeof(uint32_t))
+    return -EBADMSG;
+  if ((uint64_t)req.count * sizeof(kafs_rpc_attr_result_t) > resp_cap)
+    return -EMSGSIZE;
+  const uint8_t *inos = (const uint8_t *)payload + sizeof(req);
+  uint8_t *out = (uint8_t *)resp;
+  for (uint32_t i = 0; i < req.count; ++i)
+  {
+    uint32_t ino;
+    memcpy(&ino, inos + (size_t)i * sizeof(ino), sizeof(ino));
+    kafs_rpc_attr_result_t r;
+    memset(&r, 0, sizeof(r));
+    struct stat st;
+    r.result = kafs_core_getattr(ctx, ino, &st);
+    if (r.result == 0 && !kafs_ino_get_usage(kafs_ctx_inode(ctx, ino)))
+      r.result = -ENOENT;
+    if (r.result == 0)
+      kafs_rpc_attr_from_stat(&r.attr, &st);
+    memcpy(out + (size_t)i * sizeof(r), &r, sizeof(r));
+  }
+  *resp_len = req.count * (uint32_t)sizeof(kafs_rpc_attr_result_t);
+  return 0;
+}
+
+static int kafs_core_ns_setattr(const kafs_rpc_ns_req_t *req, const uint8_t *extra,
+                                const char *path, struct fuse_file_info *fi)
+{
+  kafs_rpc_setattr_t sa;
+  if (req->extra_len != sizeof(sa))
+    return -EBADMSG;
+  memcpy(&sa, extra, sizeof(sa));
+  switch (sa.valid)
+  {
+  case KAFS_RPC_SETATTR_MODE:
+    return kafs_op_chmod(path, (mode_t)req->mode, fi);
+  case KAFS_RPC_SETATTR_OWNER:
+    return kafs_op_chown(path, (uid_t)sa.uid, (gid_t)sa.gid, fi);
+  case KAFS_RPC_SETATTR_TIMES:
+  {
+    struct timespec tv[2];
+    tv[0].tv_sec = (time_t)sa.atime_sec;
+    tv[0].tv_nsec = (long)sa.atime_nsec;
+    tv[1].tv_sec = (time_t)sa.mtime_sec;
+    tv[1].tv_nsec = (long)sa.mtime_nsec;
+    return kafs_op_utimens(path, tv, fi);
+  }
+  default:
+    return -EINVAL;
+  }
+}
+
+static int kafs_core_ns_needs_path(uint16_t op)
+{
+  switch (op)
+  {
+  case KAFS_RPC_OP_CREATE:
+  case KAFS_RPC_OP_MKDIR:
+  case KAFS_RPC_OP_UNLINK:
+  case KAFS_RPC_OP_RMDIR:
+  case KAFS_RPC_OP_RENAME:
+  case KAFS_RPC_OP_LINK:
+  case KAFS_RPC_OP_SYMLINK:
+  case KAFS_RPC_OP_READLINK:
+  case KAFS_RPC_OP_OPEN:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+int kafs_core_ns_exec(kafs_context_t *ctx, uint16_t op, const void *payload, uint32_t len,
+                      void *resp, uint32_t resp_cap, uint32_t *resp_len)
+{
+  *resp_len = 0;
+  if (!ctx)
+    return -EINVAL;
+  if (op == KAFS_RPC_OP_GETATTR_MULTI)
+    return kafs_core_ns_getattr_multi(ctx, payload, len, resp, resp_cap, resp_len);
+
+  kafs_rpc_ns_req_t req;
+  const uint8_t *extra;
+  const char *p1;
+  const char *p2;
+  int rc = kafs_rpc_ns_decode(payload, len, &req, &extra, &p1, &p2);
+  if (rc != 0)
+    return rc;
+  char path[KAFS_RPC_NS_PATH_MAX + 1];
+  char path2[KAFS_RPC_NS_PATH_MAX + 1];
+  memcpy(path, p1, req.path_len);
+  path[req.path_len] = '\0';
+  memcpy(path2, p2, req.path2_len);
+  path2[req.path2_len] = '\0';
+  const char *pp = req.path_len ? path : NULL;
+  const char *pp2 = req.path2_len ? path2 : NULL;
+  if (pp && pp[0] != '/')
+    return -EINVAL;
+  if (!pp && (kafs_core_ns_needs_path(op) || (req.flags & KAFS_RPC_NS_F_FH) == 0))
+    return -EINVAL;
+  if (!pp2 && (op == KAFS_RPC_OP_RENAME || op == KAFS_RPC_OP_LINK || op == KAFS_RPC_OP_SYMLINK))
+    return -EINVAL;
+  if ((op == KAFS_RPC_OP_RENAME || op == KAFS_RPC_OP_LINK) && pp2[0] != '/')
+    return -EINVAL;
+
+  struct fuse_file_info fi;
+  memset(&fi, 0, sizeof(fi));
+  fi.fh = req.ino;
+  fi.flags = (int)req.op_flags;
+  struct fuse_file_info *pfi = (req.flags & KAFS_RPC_NS_F_FH) ? &fi : NULL;
+
+  struct fuse_context fctx;
+  memset(&fctx, 0, sizeof(fctx));
+  fctx.uid = (uid_t)req.uid;
+  fctx.gid = (gid_t)req.gid;
+  fctx.pid = (pid_t)req.pid;
+  fctx.private_data = ctx;
+  g_kafs_fctx_override = &fctx;
+
+  struct stat st;
+  int want_attr = 0;
+  switch (op)
+  {
+  case KAFS_RPC_OP_LOOKUP:
+    rc = kafs_op_getattr(pp, &st, pfi);
+    want_attr = 1;
+    break;
+  case KAFS_RPC_OP_READDIR:
+    rc = kafs_core_ns_readdir(&fctx, ctx, pp, pfi, req.arg, resp, resp_cap, resp_len);
+    break;
+  case KAFS_RPC_OP_CREATE:
+    if (req.flags & KAFS_RPC_NS_F_OPEN)
+    {
+      rc = kafs_op_create(pp, (mode_t)req.mode, &fi);
+      if (rc == 0)
+        rc = kafs_core_getattr(ctx, (kafs_inocnt_t)fi.fh, &st);
+      want_attr = 1;
+    }
+    else
+      rc = kafs_op_mknod(pp, (mode_t)req.mode, (dev_t)req.arg);
+    break;
+  case KAFS_RPC_OP_MKDIR:
+    rc = kafs_op_mkdir(pp, (mode_t)req.mode);
+    break;
+  case KAFS_RPC_OP_UNLINK:
+    rc = kafs_op_unlink(pp);
+    break;
+  case KAFS_RPC_OP_RMDIR:
+    rc = kafs_op_rmdir(pp);
+    break;
+  case KAFS_RPC_OP_RENAME:
+    rc = kafs_op_rename(pp, pp2, req.op_flags);
+    break;
+  case KAFS_RPC_OP_LINK:
+    rc = kafs_op_link(pp, pp2);
+    break;
+  case KAFS_RPC_OP_SYMLINK:
+    rc = kafs_op_symlink(pp2, pp);
+    break;
+  case KAFS_RPC_OP_READLINK:
+  {
+    uint32_t cap = req.arg < resp_cap ? (uint32_t)req.arg : resp_cap;
+    char target[KAFS_RPC_MAX_PAYLOAD + 1];
+    if (cap > KAFS_RPC_MAX_PAYLOAD)
+      cap = KAFS_RPC_MAX_PAYLOAD;
+    rc = kafs_op_readlink(pp, target, (size_t)cap + 1u);
+    if (rc == 0)
+    {
+      *resp_len = (uint32_t)strlen(target);
+      memcpy(resp, target, *resp_len);
+    }
+    break;
+  }
+  case KAFS_RPC_OP_SETATTR:
+    rc = kafs_core_ns_setattr(&req, extra, pp, pfi);
+    break;
+  case KAFS_RPC_OP_OPEN:
+    rc = kafs_op_open(pp, &fi);
+    if (rc == 0)
+      rc = kafs_core_getattr(ctx, (kafs_inocnt_t)fi.fh, &st);
+    want_attr = 1;
+    break;
+  case KAFS_RPC_OP_RELEASE:
+    // A handle the front opened before this back took over (or a repeated release after a
+    // reconnect) has no count here; dropping it again would wrap the open count.
+    if (!pfi || kafs_sparse_u32_get(ctx->c_open_cnt, req.ino) == 0)
+      rc = 0;
+    else
+      rc = kafs_op_release(pp, pfi);
+    break;
+  case KAFS_RPC_OP_FSYNC:
+    rc = kafs_op_fsync(pp, (int)req.op_flags, pfi);
+    break;
+  default:
+    rc = -ENOSYS;
+    break;
+  }
+  g_kafs_fctx_override = NULL;
+
+  if (rc == 0 && want_attr)
+  {
+    kafs_rpc_attr_t attr;
+    if (resp_cap < sizeof(attr))
+      return -EMSGSIZE;
+    kafs_rpc_attr_from_stat(&attr, &st);
+    memcpy(resp, &attr, sizeof(attr));
+    *resp_len = (uint32_t)sizeof(attr);
+  }
+  return rc;
+}
+
 #if !defined(KAFS_NO_MAIN) || defined(KAFS_V6_ENTRYPOINT)
 static struct fuse_operations kafs_operations = {
     .init = kafs_op_init,
@@ -11174,6 +13050,8 @@ static void usage(const char *prog)
           "    -o dedup_worker_nice=...          Alias of pending_worker_nice\n"
           "    -o pending_ttl_soft_ms=<N>        Soft TTL for pending entries (ms)\n"
           "    -o pending_ttl_hard_ms=<N>        Hard TTL for pending entries (ms)\n"
+          "    -o pending_workers=<1..8>         Resolver shards, split by inode (default: 2;\n"
+          "                                      raises bg_threads to match)\n"
           "    -o pendinglog_cap_initial=<N>     Pending queue initial effective capacity\n"
           "    -o pendinglog_cap_min=<N>         Pending queue minimum effective capacity\n"
           "    -o pendinglog_cap_max=<N>         Pending queue maximum effective capacity\n"
@@ -11192,9 +13070,45 @@ static void usage(const char *prog)
           "    -o bg_dedup_worker_prio=<normal|idle> Dedicated bg-dedup worker scheduling mode\n"
           "    -o bg_dedup_worker_nice=<0..19>  Dedicated bg-dedup worker nice value\n"
           "\n"
+          "  [Background Work]\n"
+          "    -o bg_threads=<1..16>             Executor threads for pending/GC/dedup work\n"
+          "                                      (default: 2, plus one low-priority thread)\n"
+          "    -o bg_busy_pct=<1..100>           Share of each 100ms window background work may\n"
+          "                                      use while foreground I/O is busy (default: 25)\n"
+          "\n"
+          "  [Allocation]\n"
+          "    -o prealloc_blocks=<0..1024>      Per-inode append preallocation window (blocks,\n"
+          "                                      default: 16, 0/1: disabled)\n"
+          "\n"
+          "  [Dedup Bypass]\n"
+          "    -o dedup_bypass_sample=<0..4095>  HRL results per inode before deciding whether\n"
+          "                                      to bypass HRL (default: 32, 0: never bypass)\n"
+          "    -o dedup_bypass_hit_pct=<1..100>  Write direct when the hit rate is below N%%\n"
+          "                                      (default: 5)\n"
+          "\n"
+          "  [Compression]\n"
+          "    -o compress=<on|off>              Store file data blocks LZ-compressed on images\n"
+          "                                      made with mkfs --compress (default: on)\n"
+          "    -o blk_cache_mb=<0..4096>         Cache for decompressed blocks, in MiB\n"
+          "                                      (default: 16, 0: disabled)\n"
+          "\n"
           "  [Sync Policy]\n"
           "    -o fsync_policy=<journal_only|full|adaptive>\n"
           "                                      fsync/fdatasync runtime policy\n"
+          "    -o fsync_ranged=<on|off>          Sync only the file's dirty ranges plus dirty\n"
+          "                                      metadata and the journal (default: on)\n"
+          "\n"
+          "  [Metadata Mapping]\n"
+          "    -o meta_hugepage=<on|off>         2MiB-align the image map and advise huge pages\n"
+          "                                      for metadata regions (default: off)\n"
+          "    -o meta_prefault=<on|off>         Prefault metadata regions in the background\n"
+          "                                      after mount (default: off)\n"
+          "    -o io_engine=<mmap|pread|direct>  Data block I/O: through the image map, with\n"
+          "                                      pread/pwrite, or with O_DIRECT (default: mmap)\n"
+          "\n"
+          "  [Memory Budget]\n"
+          "    -o mem_budget=<off|SIZE>          Cap in-process caches and lock tables and page\n"
+          "                                      out idle metadata (K/M/G, >= 4M, default: off)\n"
           "\n"
           "Environment:\n"
           "    KAFS_IMAGE                        Fallback image path\n"
@@ -11206,6 +13120,7 @@ static void usage(const char *prog)
           "    KAFS_PENDING_WORKER_NICE          pending_worker_nice default\n"
           "    KAFS_PENDING_TTL_SOFT_MS          pending soft TTL (ms)\n"
           "    KAFS_PENDING_TTL_HARD_MS          pending hard TTL (ms)\n"
+          "    KAFS_PENDING_WORKERS              pending_workers default\n"
           "    KAFS_PENDINGLOG_CAP_INITIAL       pending initial effective capacity\n"
           "    KAFS_PENDINGLOG_CAP_MIN           pending minimum effective capacity\n"
           "    KAFS_PENDINGLOG_CAP_MAX           pending maximum effective capacity\n"
@@ -11218,6 +13133,18 @@ static void usage(const char *prog)
           "    KAFS_BG_DEDUP_WORKER_PRIO         dedicated bg-dedup worker prio mode\n"
           "    KAFS_BG_DEDUP_WORKER_NICE         dedicated bg-dedup worker nice value\n"
           "    KAFS_FSYNC_POLICY                 fsync policy default\n"
+          "    KAFS_FSYNC_RANGED                 fsync_ranged default\n"
+          "    KAFS_META_HUGEPAGE                meta_hugepage default\n"
+          "    KAFS_META_PREFAULT                meta_prefault default\n"
+          "    KAFS_IO_ENGINE                    io_engine default\n"
+          "    KAFS_MEM_BUDGET                   mem_budget default\n"
+          "    KAFS_PREALLOC_BLOCKS              prealloc_blocks default\n"
+          "    KAFS_DEDUP_BYPASS_SAMPLE          dedup_bypass_sample default\n"
+          "    KAFS_DEDUP_BYPASS_HIT_PCT         dedup_bypass_hit_pct default\n"
+          "    KAFS_COMPRESS                     compress default\n"
+          "    KAFS_BLK_CACHE_MB                 blk_cache_mb default\n"
+          "    KAFS_BG_THREADS                   bg_threads default\n"
+          "    KAFS_BG_BUSY_PCT                  bg_busy_pct default\n"
           "    KAFS_HOTPLUG_UDS                  Hotplug UDS path (legacy/env)\n"
           "    KAFS_HOTPLUG_BACK_BIN             Backend binary path hint\n"
           "\n"
@@ -11422,8 +13349,10 @@ static void kafs_migrate_ctx_close(kafs_context_t *ctx)
     return;
   (void)kafs_hrl_close(ctx);
   kafs_bitmap_descriptor_mapping_clear(ctx);
-  free(ctx->c_ino_epoch);
+  kafs_sparse_u32_destroy(ctx->c_ino_epoch);
   ctx->c_ino_epoch = NULL;
+  kafs_sparse_u32_destroy(ctx->c_dedup_policy);
+  ctx->c_dedup_policy = NULL;
   free(ctx->c_diag_create_seq);
   free(ctx->c_diag_create_mode);
   free(ctx->c_diag_create_first_write_seen);
@@ -11553,6 +13482,7 @@ typedef struct kafs_main_options
   int pending_worker_nice;
   uint32_t pending_ttl_soft_ms;
   uint32_t pending_ttl_hard_ms;
+  uint32_t pending_workers;
   uint32_t pending_cap_initial;
   uint32_t pending_cap_min;
   uint32_t pending_cap_max;
@@ -11565,6 +13495,18 @@ typedef struct kafs_main_options
   uint32_t bg_dedup_worker_prio_mode;
   int bg_dedup_worker_nice;
   uint32_t fsync_policy;
+  uint32_t fsync_ranged;
+  uint32_t meta_hugepage;
+  uint32_t meta_prefault;
+  uint32_t io_engine;
+  uint64_t mem_budget;
+  uint32_t prealloc_blocks;
+  uint32_t dedup_bypass_sample;
+  uint32_t dedup_bypass_hit_pct;
+  uint32_t compress;
+  uint32_t blk_cache_mb;
+  uint32_t bg_threads;
+  uint32_t bg_busy_pct;
   uint32_t sd_card_profile;
 } kafs_main_options_t;
 
@@ -11576,6 +13518,7 @@ static void kafs_main_options_init_profile_tuning(kafs_main_options_t *opts)
   opts->pending_worker_nice = 0;
   opts->pending_ttl_soft_ms = 5000;
   opts->pending_ttl_hard_ms = 30000;
+  opts->pending_workers = KAFS_PENDING_WORKERS_DEFAULT;
   opts->bg_dedup_scan_enabled = 1u;
   opts->bg_dedup_interval_ms = KAFS_BG_DEDUP_INTERVAL_MS_DEFAULT;
   opts->bg_dedup_quiet_interval_ms = KAFS_BG_DEDUP_QUIET_INTERVAL_MS_DEFAULT;
@@ -11585,6 +13528,18 @@ static void kafs_main_options_init_profile_tuning(kafs_main_options_t *opts)
   opts->bg_dedup_worker_prio_mode = KAFS_PENDING_WORKER_PRIO_IDLE;
   opts->bg_dedup_worker_nice = 19;
   opts->fsync_policy = KAFS_FSYNC_POLICY_JOURNAL_ONLY;
+  opts->fsync_ranged = 1u;
+  opts->meta_hugepage = 0u;
+  opts->meta_prefault = 0u;
+  opts->io_engine = KAFS_IO_ENGINE_MMAP;
+  opts->mem_budget = 0;
+  opts->prealloc_blocks = KAFS_PREALLOC_BLOCKS_DEFAULT;
+  opts->dedup_bypass_sample = KAFS_DEDUP_BYPASS_SAMPLE_DEFAULT;
+  opts->dedup_bypass_hit_pct = KAFS_DEDUP_BYPASS_HIT_PCT_DEFAULT;
+  opts->compress = 1u;
+  opts->blk_cache_mb = KAFS_BLK_CACHE_MB_DEFAULT;
+  opts->bg_threads = KAFS_BG_THREADS_DEFAULT;
+  opts->bg_busy_pct = KAFS_BG_BUSY_PCT_DEFAULT;
   opts->sd_card_profile = KAFS_SD_CARD_PROFILE_NONE;
 }
 
@@ -11705,8 +13660,11 @@ static int kafs_main_apply_pending_env_overrides(kafs_main_options_t *opts)
   if (kafs_main_parse_u32_env("KAFS_PENDING_TTL_SOFT_MS", getenv("KAFS_PENDING_TTL_SOFT_MS"), 0,
                               3600000u, &opts->pending_ttl_soft_ms) != 0)
     return 2;
-  return kafs_main_parse_u32_env("KAFS_PENDING_TTL_HARD_MS", getenv("KAFS_PENDING_TTL_HARD_MS"), 0,
-                                 3600000u, &opts->pending_ttl_hard_ms);
+  if (kafs_main_parse_u32_env("KAFS_PENDING_TTL_HARD_MS", getenv("KAFS_PENDING_TTL_HARD_MS"), 0,
+                              3600000u, &opts->pending_ttl_hard_ms) != 0)
+    return 2;
+  return kafs_main_parse_u32_env("KAFS_PENDING_WORKERS", getenv("KAFS_PENDING_WORKERS"), 1,
+                                 KAFS_BG_PENDING_SHARDS_MAX, &opts->pending_workers);
 }
 
 static int kafs_main_apply_pending_cap_env_overrides(kafs_main_options_t *opts)
@@ -11777,6 +13735,60 @@ static int kafs_main_apply_misc_env_overrides(kafs_main_options_t *opts)
     fprintf(stderr, "invalid KAFS_FSYNC_POLICY: '%s'\n", fsp);
     return 2;
   }
+  const char *fsr = getenv("KAFS_FSYNC_RANGED");
+  if (fsr && *fsr && kafs_parse_onoff(fsr, &opts->fsync_ranged) != 0)
+  {
+    fprintf(stderr, "invalid KAFS_FSYNC_RANGED: '%s'\n", fsr);
+    return 2;
+  }
+  const char *mhp = getenv("KAFS_META_HUGEPAGE");
+  if (mhp && *mhp && kafs_parse_onoff(mhp, &opts->meta_hugepage) != 0)
+  {
+    fprintf(stderr, "invalid KAFS_META_HUGEPAGE: '%s'\n", mhp);
+    return 2;
+  }
+  const char *mpf = getenv("KAFS_META_PREFAULT");
+  if (mpf && *mpf && kafs_parse_onoff(mpf, &opts->meta_prefault) != 0)
+  {
+    fprintf(stderr, "invalid KAFS_META_PREFAULT: '%s'\n", mpf);
+    return 2;
+  }
+  const char *ioe = getenv("KAFS_IO_ENGINE");
+  if (ioe && *ioe && kafs_io_engine_parse(ioe, &opts->io_engine) != 0)
+  {
+    fprintf(stderr, "invalid KAFS_IO_ENGINE: '%s'\n", ioe);
+    return 2;
+  }
+  const char *mb = getenv("KAFS_MEM_BUDGET");
+  if (mb && *mb && kafs_mem_budget_parse(mb, &opts->mem_budget) != 0)
+  {
+    fprintf(stderr, "invalid KAFS_MEM_BUDGET: '%s'\n", mb);
+    return 2;
+  }
+  if (kafs_main_parse_u32_env("KAFS_PREALLOC_BLOCKS", getenv("KAFS_PREALLOC_BLOCKS"), 0,
+                              KAFS_PREALLOC_BLOCKS_MAX, &opts->prealloc_blocks) != 0)
+    return 2;
+  if (kafs_main_parse_u32_env("KAFS_DEDUP_BYPASS_SAMPLE", getenv("KAFS_DEDUP_BYPASS_SAMPLE"), 0,
+                              KAFS_DEDUP_POLICY_SAMPLE_MAX, &opts->dedup_bypass_sample) != 0)
+    return 2;
+  if (kafs_main_parse_u32_env("KAFS_DEDUP_BYPASS_HIT_PCT", getenv("KAFS_DEDUP_BYPASS_HIT_PCT"), 1,
+                              100u, &opts->dedup_bypass_hit_pct) != 0)
+    return 2;
+  const char *cmp = getenv("KAFS_COMPRESS");
+  if (cmp && *cmp && kafs_parse_onoff(cmp, &opts->compress) != 0)
+  {
+    fprintf(stderr, "invalid KAFS_COMPRESS: '%s'\n", cmp);
+    return 2;
+  }
+  if (kafs_main_parse_u32_env("KAFS_BLK_CACHE_MB", getenv("KAFS_BLK_CACHE_MB"), 0,
+                              KAFS_BLK_CACHE_MB_MAX, &opts->blk_cache_mb) != 0)
+    return 2;
+  if (kafs_main_parse_u32_env("KAFS_BG_THREADS", getenv("KAFS_BG_THREADS"), 1,
+                              KAFS_BG_THREADS_MAX, &opts->bg_threads) != 0)
+    return 2;
+  if (kafs_main_parse_u32_env("KAFS_BG_BUSY_PCT", getenv("KAFS_BG_BUSY_PCT"), 1, 100,
+                              &opts->bg_busy_pct) != 0)
+    return 2;
 
   const char *mt = getenv("KAFS_MT");
   opts->enable_mt = (mt && strcmp(mt, "1") == 0) ? KAFS_TRUE : KAFS_FALSE;
@@ -12279,6 +14291,20 @@ static int kafs_main_parse_token_u32_alias2(const char *tok, const char *prefix_
   return 1;
 }
 
+static int kafs_main_parse_token_onoff(const char *tok, const char *prefix, uint32_t *value_out,
+                                       const char *error_label)
+{
+  size_t prefix_len = strlen(prefix);
+  if (strncmp(tok, prefix, prefix_len) != 0)
+    return 0;
+  if (kafs_parse_onoff(tok + prefix_len, value_out) != 0)
+  {
+    fprintf(stderr, "invalid -o %s: '%s'\n", error_label, tok + prefix_len);
+    return 2;
+  }
+  return 1;
+}
+
 static int kafs_main_parse_token_onoff_alias2(const char *tok, const char *prefix_a,
                                               const char *prefix_b, uint32_t *value_out,
                                               const char *error_label)
@@ -12317,6 +14343,11 @@ static int kafs_main_handle_pending_token(kafs_main_options_t *opts, const char
   if (rc != 0)
     return rc;
 
+  rc = kafs_main_parse_token_u32(tok, "pending_workers=", 1, KAFS_BG_PENDING_SHARDS_MAX,
+                                 &opts->pending_workers, "pending_workers");
+  if (rc != 0)
+    return rc;
+
   rc = kafs_main_parse_token_u32_alias2(tok, "pendinglog_cap_initial=", "pending_cap_initial=", 0,
                                         1000000000u, &opts->pending_cap_initial,
                                         "pendinglog_cap_initial");
@@ -12343,10 +14374,51 @@ static int kafs_main_handle_pending_token(kafs_main_options_t *opts, const char
     }
     return 1;
   }
-
   return 0;
 }
 
+static int kafs_main_handle_fsync_token(kafs_main_options_t *opts, const char *tok)
+{
+  return kafs_main_parse_token_onoff(tok, "fsync_ranged=", &opts->fsync_ranged, "fsync_ranged");
+}
+
+static int kafs_main_handle_meta_map_token(kafs_main_options_t *opts, const char *tok)
+{
+  int rc = kafs_main_parse_token_onoff(tok, "meta_hugepage=", &opts->meta_hugepage,
+                                       "meta_hugepage");
+  if (rc != 0)
+    return rc;
+
+  return kafs_main_parse_token_onoff(tok, "meta_prefault=", &opts->meta_prefault,
+                                     "meta_prefault");
+}
+
+static int kafs_main_handle_io_engine_token(kafs_main_options_t *opts, const char *tok)
+{
+  const char *value = kafs_main_token_value_alias2(tok, "io_engine=", "io-engine=");
+  if (!value)
+    return 0;
+  if (kafs_io_engine_parse(value, &opts->io_engine) != 0)
+  {
+    fprintf(stderr, "invalid -o io_engine: '%s'\n", value);
+    return 2;
+  }
+  return 1;
+}
+
+static int kafs_main_handle_mem_budget_token(kafs_main_options_t *opts, const char *tok)
+{
+  const char *value = kafs_main_token_value_alias2(tok, "mem_budget=", "mem-budget=");
+  if (!value)
+    return 0;
+  if (kafs_mem_budget_parse(value, &opts->mem_budget) != 0)
+  {
+    fprintf(stderr, "invalid -o mem_budget: '%s' (off or >= 4M)\n", value);
+    return 2;
+  }
+  return 1;
+}
+
 static int kafs_main_handle_bg_dedup_scan_token(kafs_main_options_t *opts, const char *tok)
 {
   if (strcmp(tok, "bg_dedup_scan") == 0 || strcmp(tok, "bg_dedup_scan=on") == 0 ||
@@ -12433,6 +14505,44 @@ static int kafs_main_handle_bg_dedup_token(kafs_main_options_t *opts, const char
   return kafs_main_handle_bg_dedup_priority_token(opts, tok);
 }
 
+static int kafs_main_handle_alloc_token(kafs_main_options_t *opts, const char *tok)
+{
+  return kafs_main_parse_token_u32(tok, "prealloc_blocks=", 0, KAFS_PREALLOC_BLOCKS_MAX,
+                                   &opts->prealloc_blocks, "prealloc_blocks");
+}
+
+static int kafs_main_handle_dedup_bypass_token(kafs_main_options_t *opts, const char *tok)
+{
+  int rc = kafs_main_parse_token_u32(tok, "dedup_bypass_sample=", 0, KAFS_DEDUP_POLICY_SAMPLE_MAX,
+                                     &opts->dedup_bypass_sample, "dedup_bypass_sample");
+  if (rc != 0)
+    return rc;
+
+  return kafs_main_parse_token_u32(tok, "dedup_bypass_hit_pct=", 1, 100u,
+                                   &opts->dedup_bypass_hit_pct, "dedup_bypass_hit_pct");
+}
+
+static int kafs_main_handle_compress_token(kafs_main_options_t *opts, const char *tok)
+{
+  int rc = kafs_main_parse_token_onoff(tok, "compress=", &opts->compress, "compress");
+  if (rc != 0)
+    return rc;
+
+  return kafs_main_parse_token_u32(tok, "blk_cache_mb=", 0, KAFS_BLK_CACHE_MB_MAX,
+                                   &opts->blk_cache_mb, "blk_cache_mb");
+}
+
+static int kafs_main_handle_bg_sched_token(kafs_main_options_t *opts, const char *tok)
+{
+  int rc = kafs_main_parse_token_u32(tok, "bg_threads=", 1, KAFS_BG_THREADS_MAX,
+                                     &opts->bg_threads, "bg_threads");
+  if (rc != 0)
+    return rc;
+
+  return kafs_main_parse_token_u32(tok, "bg_busy_pct=", 1, 100, &opts->bg_busy_pct,
+                                   "bg_busy_pct");
+}
+
 static void kafs_main_append_filtered_token(char *filtered, size_t *used, const char *tok)
 {
   size_t tlen = strlen(tok);
@@ -12472,6 +14582,38 @@ static int kafs_main_handle_mount_token(kafs_main_options_t *opts, const char *t
   if (rc != 0)
     return rc;
 
+  rc = kafs_main_handle_fsync_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
+  rc = kafs_main_handle_meta_map_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
+  rc = kafs_main_handle_io_engine_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
+  rc = kafs_main_handle_mem_budget_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
+  rc = kafs_main_handle_alloc_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
+  rc = kafs_main_handle_dedup_bypass_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
+  rc = kafs_main_handle_compress_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
+  rc = kafs_main_handle_bg_sched_token(opts, tok);
+  if (rc != 0)
+    return rc;
+
   return kafs_main_handle_bg_dedup_token(opts, tok);
 }
 
@@ -12745,11 +14887,12 @@ static void kafs_main_init_context(kafs_context_t *ctx, const kafs_main_options_
   kafs_main_set_mountpoint(ctx, mount_arg, mnt_abs, mnt_abs_size);
 
   ctx->c_fd = -1;
+  ctx->c_direct_fd = -1;
   ctx->c_hotplug_fd = -1;
   ctx->c_hotplug_state = KAFS_HOTPLUG_STATE_DISABLED;
   ctx->c_hotplug_wait_queue_limit = KAFS_HOTPLUG_WAIT_QUEUE_LIMIT_DEFAULT;
   ctx->c_hotplug_wait_timeout_ms = KAFS_HOTPLUG_WAIT_TIMEOUT_MS_DEFAULT;
-  ctx->c_hotplug_data_mode = KAFS_RPC_DATA_INLINE;
+  ctx->c_hotplug_data_mode = KAFS_RPC_DATA_SHM; // 後段が対応していなければ INLINE で流す
   ctx->c_hotplug_front_major = KAFS_RPC_HELLO_MAJOR;
   ctx->c_hotplug_front_minor = KAFS_RPC_HELLO_MINOR;
   ctx->c_hotplug_front_features = KAFS_RPC_HELLO_FEATURES;
@@ -12759,9 +14902,9 @@ static void kafs_main_init_context(kafs_context_t *ctx, const kafs_main_options_
   ctx->c_pending_worker_nice = opts->pending_worker_nice;
   ctx->c_pending_worker_prio_base_mode = opts->pending_worker_prio_mode;
   ctx->c_pending_worker_nice_base = opts->pending_worker_nice;
-  ctx->c_pending_worker_prio_dirty = 1;
   ctx->c_pending_ttl_soft_ms = opts->pending_ttl_soft_ms;
   ctx->c_pending_ttl_hard_ms = opts->pending_ttl_hard_ms;
+  ctx->c_pending_workers = opts->pending_workers;
   ctx->c_pendinglog_capacity = opts->pending_cap_initial;
   ctx->c_pendinglog_capacity_min = opts->pending_cap_min;
   ctx->c_pendinglog_capacity_max = opts->pending_cap_max;
@@ -12777,10 +14920,23 @@ static void kafs_main_init_context(kafs_context_t *ctx, const kafs_main_options_
   ctx->c_bg_dedup_worker_nice = opts->bg_dedup_worker_nice;
   ctx->c_bg_dedup_worker_prio_base_mode = opts->bg_dedup_worker_prio_mode;
   ctx->c_bg_dedup_worker_nice_base = opts->bg_dedup_worker_nice;
-  ctx->c_bg_dedup_worker_prio_dirty = 1;
   ctx->c_bg_dedup_mode = KAFS_BG_DEDUP_MODE_COLD;
 
   ctx->c_fsync_policy = opts->fsync_policy;
+  ctx->c_fsync_ranged = opts->fsync_ranged;
+  ctx->c_meta_hugepage = opts->meta_hugepage;
+  ctx->c_meta_prefault = opts->meta_prefault;
+  ctx->c_io_engine = opts->io_engine;
+  ctx->c_mem_budget = opts->mem_budget;
+  ctx->c_prealloc_blocks = opts->prealloc_blocks;
+  ctx->c_dedup_bypass_sample = opts->dedup_bypass_sample;
+  ctx->c_dedup_bypass_hit_pct = opts->dedup_bypass_hit_pct;
+  ctx->c_cblk_enabled = opts->compress; // イメージを開いてから機能ビットで絞る
+  ctx->c_blk_cache_mb = opts->blk_cache_mb;
+  // 解決シャードが全部同時に走れるだけの NORMAL レーンを用意する。
+  ctx->c_bg_threads =
+      opts->bg_threads > opts->pending_workers ? opts->bg_threads : opts->pending_workers;
+  ctx->c_bg_busy_pct = opts->bg_busy_pct;
   ctx->c_sd_card_profile = opts->sd_card_profile;
   ctx->c_atime_policy = KAFS_ATIME_POLICY_NO_RUNTIME_UPDATES;
 }
@@ -12981,9 +15137,26 @@ static void kafs_main_log_runtime_options(kafs_context_t *ctx, kafs_bool_t write
            ctx->c_bg_dedup_start_used_pct, ctx->c_bg_dedup_pressure_used_pct,
            kafs_worker_prio_mode_name(ctx->c_bg_dedup_worker_prio_mode),
            ctx->c_bg_dedup_worker_nice);
-  kafs_log(KAFS_LOG_INFO, "kafs: pending_worker_prio %s nice=%d\n",
-           kafs_worker_prio_mode_name(ctx->c_pending_worker_prio_mode), ctx->c_pending_worker_nice);
+  kafs_log(KAFS_LOG_INFO, "kafs: pending_worker_prio %s nice=%d workers=%u\n",
+           kafs_worker_prio_mode_name(ctx->c_pending_worker_prio_mode), ctx->c_pending_worker_nice,
+           ctx->c_pending_workers);
   kafs_log(KAFS_LOG_INFO, "kafs: fsync_policy %s\n", kafs_fsync_policy_name(ctx->c_fsync_policy));
+  kafs_log(KAFS_LOG_INFO, "kafs: fsync_ranged %s\n", ctx->c_fsync_ranged ? "on" : "off");
+  kafs_log(KAFS_LOG_INFO, "kafs: meta_hugepage %s (%" PRIu64 " bytes advised) meta_prefault %s\n",
+           ctx->c_meta_hugepage ? "on" : "off", ctx->c_stat_meta_hugepage_bytes,
+           ctx->c_meta_prefault ? "on" : "off");
+  kafs_log(KAFS_LOG_INFO, "kafs: io_engine %s\n", kafs_io_engine_name(ctx->c_io_engine));
+  kafs_log(KAFS_LOG_INFO,
+           "kafs: mem_budget %" PRIu64 " bytes (hrl_locks=%u inode_stripes=%u meta_delta=%s)\n",
+           ctx->c_mem_budget, kafs_hrl_bucket_locks(ctx), kafs_inode_lock_stripes(ctx),
+           ctx->c_meta_bitmap_words_enabled ? "on" : "off");
+  kafs_log(KAFS_LOG_INFO, "kafs: prealloc_blocks %u\n", ctx->c_prealloc_blocks);
+  kafs_log(KAFS_LOG_INFO, "kafs: dedup_bypass sample=%u hit_pct=%u\n",
+           ctx->c_dedup_bypass_sample, ctx->c_dedup_bypass_hit_pct);
+  kafs_log(KAFS_LOG_INFO, "kafs: compress %s blk_cache %zu bytes\n",
+           ctx->c_cblk_enabled ? "on" : "off", kafs_bcache_bytes(ctx->c_bcache));
+  kafs_log(KAFS_LOG_INFO, "kafs: bg_threads %u (+1 low) bg_busy_pct %u\n", ctx->c_bg_threads,
+           ctx->c_bg_busy_pct);
 
   if (kafs_debug_level() >= 1)
   {
@@ -13156,9 +15329,7 @@ static void kafs_main_v6_apply_delayed_mutation_policy(kafs_context_t *ctx)
   ctx->c_pendinglog_size = 0u;
   ctx->c_pendinglog_capacity = 0u;
   ctx->c_pending_worker_stop = 1;
-  ctx->c_tombstone_gc_worker_stop = 1;
   ctx->c_bg_dedup_enabled = 0u;
-  ctx->c_bg_dedup_worker_stop = 1;
   ctx->c_v6_delayed_mutation_policy_applied = 1u;
 }
 
@@ -13300,7 +15471,7 @@ static int kafs_main_v6_inspection_mount(kafs_context_t *ctx, const kafs_ssuperb
 static void kafs_main_map_runtime_memory(kafs_context_t *ctx, uint32_t fmt_ver, off_t imgsize,
                                          off_t mapsize, intptr_t blkmask_off, intptr_t inotbl_off)
 {
-  ctx->c_img_base = mmap(NULL, imgsize, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->c_fd, 0);
+  ctx->c_img_base = kafs_meta_map_image(ctx, (size_t)imgsize, PROT_READ | PROT_WRITE);
   if (ctx->c_img_base == MAP_FAILED)
   {
     perror("mmap");
@@ -13312,6 +15483,7 @@ static void kafs_main_map_runtime_memory(kafs_context_t *ctx, uint32_t fmt_ver,
   ctx->c_mapsize = (size_t)mapsize;
   ctx->c_blkmasktbl = (void *)ctx->c_superblock + blkmask_off;
   ctx->c_inotbl = (void *)ctx->c_superblock + inotbl_off;
+  kafs_meta_map_advise(ctx);
   if (!kafs_ctx_runtime_mount_supported(ctx))
   {
     fprintf(stderr, "unsupported format version: %u (runtime admission failed).\n", fmt_ver);
@@ -13347,12 +15519,15 @@ static void kafs_main_init_runtime_diag(kafs_context_t *ctx, const char *image_p
 {
   kafs_ctx_init_diag_state(ctx, image_path, inocnt);
   ctx->c_alloc_v3_summary_dirty = 1;
+  // Without shards the counters still work (c_stat_fallback), just without per-thread lines.
+  if (kafs_stat_shards_alloc(&ctx->c_stat_shards, &ctx->c_stat_shard_mask) != 0)
+    kafs_log(KAFS_LOG_WARNING, "stats: shard allocation failed; using shared counters\n");
 }
 
 static void kafs_main_init_runtime_journal(kafs_context_t *ctx, const char *image_path,
                                            kafs_blkcnt_t r_blkcnt)
 {
-  kafs_ctx_init_runtime_journal(ctx, image_path, r_blkcnt, 0);
+  (void)kafs_ctx_init_runtime_journal(ctx, image_path, r_blkcnt, 0, NULL);
 }
 
 static void kafs_main_lock_runtime_image(kafs_context_t *ctx, const char *image_path)
@@ -13370,6 +15545,39 @@ static void kafs_main_lock_runtime_image(kafs_context_t *ctx, const char *image_
   }
 }
 
+static void kafs_main_apply_compress_feature(kafs_context_t *ctx, const kafs_ssuperblock_t *sb)
+{
+  if (!ctx->c_cblk_enabled)
+    return;
+  // mkfs --compress で作ったイメージだけ。参照の bit 幅に収まらない大きさなら使わない。
+  if ((kafs_sb_feature_flags_get(sb) & KAFS_FEATURE_COMPRESS) == 0 ||
+      kafs_sb_blksize_get(sb) > KAFS_LZ_MAX_INPUT ||
+      kafs_sb_r_blkcnt_get(sb) > KAFS_CBLK_REF_BLO_LIMIT)
+  {
+    ctx->c_cblk_enabled = 0;
+    return;
+  }
+  // コンテナの世代は展開キャッシュの照合に使うので、マウントごとにずらしておく。
+  ctx->c_cblk_generation = (uint32_t)kafs_now_realtime_ns();
+}
+
+/// @brief io_engine=direct 用に O_DIRECT の fd を開く。開けなければ（tmpfs など）pread に落とす。
+static void kafs_main_open_direct_fd(kafs_context_t *ctx, const char *image_path, int open_flags)
+{
+  if (ctx->c_io_engine != KAFS_IO_ENGINE_DIRECT)
+    return;
+  int fd = kafs_io_direct_open(image_path, open_flags);
+  if (fd < 0)
+  {
+    char errbuf[128];
+    kafs_log(KAFS_LOG_WARNING, "kafs: io_engine=direct unavailable (%s), using pread\n",
+             kafs_main_rc_text(fd, errbuf, sizeof(errbuf)));
+    ctx->c_io_engine = KAFS_IO_ENGINE_PREAD;
+    return;
+  }
+  ctx->c_direct_fd = fd;
+}
+
 static void kafs_main_open_runtime_context(kafs_context_t *ctx, const char *image_path,
                                            kafs_bool_t auto_migrate, kafs_bool_t migrate_yes,
                                            kafs_bool_t v6_inspection_mount,
@@ -13399,6 +15607,8 @@ static void kafs_main_open_runtime_context(kafs_context_t *ctx, const char *imag
     fprintf(stderr, "invalid magic. run mkfs.kafs to format.\n");
     exit(2);
   }
+  kafs_main_apply_compress_feature(ctx, &sbdisk);
+  kafs_main_open_direct_fd(ctx, image_path, open_flags);
 
   uint32_t fmt_ver = kafs_sb_format_version_get(&sbdisk);
   if (v6_inspection_mount && fmt_ver != KAFS_FORMAT_VERSION_V6)
@@ -13456,21 +15666,63 @@ static void kafs_main_open_runtime_context(kafs_context_t *ctx, const char *imag
   kafs_main_map_runtime_image(ctx, &sbdisk, fmt_ver, &inocnt, &r_blkcnt);
   kafs_main_init_runtime_diag(ctx, image_path, inocnt);
   kafs_main_init_runtime_journal(ctx, image_path, r_blkcnt);
+  kafs_blk_cache_init(ctx);
   kafs_main_lock_runtime_image(ctx, image_path);
+  // Superblock hints are rewritten only once the image is ours: a second mount of a busy image
+  // must exit without touching them.
+  kafs_tombstone_queue_init(ctx);
+  kafs_bg_dedup_log_init(ctx);
 }
 
 static int kafs_main_cleanup(kafs_context_t *ctx, char *hotplug_uds_path, int rc)
 {
   kafs_bg_dedup_worker_stop(ctx);
+  kafs_bg_dedup_log_fini(ctx);
+  kafs_tombstone_gc_worker_stop(ctx);
+  kafs_tombstone_queue_fini(ctx);
   kafs_pending_worker_stop(ctx);
   kafs_journal_shutdown(ctx);
+  kafs_bcache_destroy(ctx->c_bcache);
+  ctx->c_bcache = NULL;
+  kafs_mem_trim_stop(ctx);
+  kafs_mem_trim_destroy(ctx->c_mem_trim);
+  ctx->c_mem_trim = NULL;
+  if (ctx->c_direct_fd >= 0)
+    close(ctx->c_direct_fd);
+  ctx->c_direct_fd = -1;
   if (ctx->c_hotplug_fd >= 0)
     close(ctx->c_hotplug_fd);
   ctx->c_hotplug_active = 0;
+  ctx->c_hotplug_shm_active = 0;
+  if (ctx->c_hotplug_shm)
+  {
+    kafs_rpc_shm_destroy(ctx->c_hotplug_shm);
+    free(ctx->c_hotplug_shm);
+    ctx->c_hotplug_shm = NULL;
+  }
+  kafs_sparse_u32_destroy(ctx->c_hotplug_ns_open);
+  ctx->c_hotplug_ns_open = NULL;
+  if (ctx->c_hotplug_rx)
+  {
+    kafs_rpc_rx_destroy(ctx->c_hotplug_rx);
+    free(ctx->c_hotplug_rx);
+    ctx->c_hotplug_rx = NULL;
+  }
+  if (ctx->c_hotplug_tx)
+  {
+    kafs_rpc_tx_destroy(ctx->c_hotplug_tx);
+    free(ctx->c_hotplug_tx);
+    ctx->c_hotplug_tx = NULL;
+  }
   if (hotplug_uds_path[0] != '\0')
     unlink(hotplug_uds_path);
   if (ctx->c_hotplug_lock_init)
     pthread_mutex_destroy(&ctx->c_hotplug_lock);
+  if (ctx->c_hotplug_mux_init)
+  {
+    pthread_cond_destroy(&ctx->c_hotplug_mux_cond);
+    pthread_mutex_destroy(&ctx->c_hotplug_mux_lock);
+  }
   if (ctx->c_hotplug_wait_lock_init)
   {
     pthread_cond_destroy(&ctx->c_hotplug_wait_cond);
@@ -13479,7 +15731,10 @@ static int kafs_main_cleanup(kafs_context_t *ctx, char *hotplug_uds_path, int rc
   kafs_bitmap_descriptor_mapping_clear(ctx);
   free(ctx->c_meta_bitmap_words);
   free(ctx->c_meta_bitmap_dirty);
-  free(ctx->c_ino_epoch);
+  kafs_sparse_u32_destroy(ctx->c_ino_epoch);
+  kafs_sparse_u32_destroy(ctx->c_dedup_policy);
+  free(ctx->c_stat_shards);
+  ctx->c_stat_shards = NULL;
   free(ctx->c_diag_create_seq);
   free(ctx->c_diag_create_mode);
   free(ctx->c_diag_create_first_write_seen);
@@ -13530,6 +15785,8 @@ static int kafs_v6_entrypoint_read_superblock(kafs_context_t *ctx, const char *i
     kafs_ctx_close_fd(ctx);
     return 2;
   }
+  kafs_main_apply_compress_feature(ctx, sbdisk);
+  kafs_main_open_direct_fd(ctx, image_path, open_flags);
   return 0;
 }
 
@@ -187,6 +187,7 @@ typedef uint_fast32_t kafs_hrid_t;
 #define KAFS_FEATURE_META_BATCH (1ull << 1)
 #define KAFS_FEATURE_ASYNC_DEDUP (1ull << 2)
 #define KAFS_FEATURE_TAIL_META_REGION (1ull << 3)
+#define KAFS_FEATURE_COMPRESS (1ull << 4)
 
 // ------------------------------------
 // 記録表現で使う型
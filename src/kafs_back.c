@@ -1,4 +1,6 @@
 #include "kafs_rpc.h"
+#include "kafs_rpc_shm.h"
+#include "kafs_back_pool.h"
 #include "kafs_cli_opts.h"
 #include "kafs_back_server.h"
 #include "kafs_context.h"
@@ -11,19 +13,22 @@
 #include <inttypes.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <unistd.h>
 
 static void usage(const char *prog)
 {
 #ifdef KAFS_BACK_ENABLE_IMAGE
-  fprintf(stderr, "Usage: %s [--fd <num>] [--uds <path>] [--image <path>]\n", prog);
+  fprintf(stderr, "Usage: %s [--fd <num>] [--uds <path>] [--workers <num>] [--image <path>]\n",
+          prog);
 #else
-  fprintf(stderr, "Usage: %s [--fd <num>] [--uds <path>]\n", prog);
+  fprintf(stderr, "Usage: %s [--fd <num>] [--uds <path>] [--workers <num>]\n", prog);
 #endif
 }
 
@@ -34,6 +39,11 @@ static int kafs_back_handshake(int fd, uint64_t *out_session_id, uint32_t *out_e
   hello.major = KAFS_RPC_HELLO_MAJOR;
   hello.minor = KAFS_RPC_HELLO_MINOR;
   hello.feature_flags = KAFS_RPC_HELLO_FEATURES;
+#ifndef KAFS_BACK_ENABLE_IMAGE
+  // Namespace ops run kafs_op_* against the image; without one there is nothing to run them on.
+  // Likewise there is no image state to hand over.
+  hello.feature_flags &= ~(KAFS_RPC_HELLO_FEATURE_NS | KAFS_RPC_HELLO_FEATURE_WARM_STATE);
+#endif
 
   uint64_t req_id = kafs_rpc_next_req_id();
   int rc = kafs_rpc_send_msg(fd, KAFS_RPC_OP_HELLO, KAFS_RPC_FLAG_ENDIAN_HOST, req_id, 1u, 0u,
@@ -60,9 +70,10 @@ static int kafs_back_handshake(int fd, uint64_t *out_session_id, uint32_t *out_e
 
 // Handle common mode gate for READ/WRITE RPCs.
 // Returns 1 when plan-only response is fully handled, 0 when caller should continue,
-// and negative errno on validation error.
+// and negative errno on validation error. SHM is accepted only after SHM_ATTACH.
 static int kafs_back_prepare_rw_mode(uint32_t data_mode, uint32_t req_size, uint32_t *out_size,
-                                     uint32_t *out_resp_len, uint32_t resp_struct_size)
+                                     uint32_t *out_resp_len, uint32_t resp_struct_size,
+                                     const kafs_rpc_shm_t *shm)
 {
   if (data_mode == KAFS_RPC_DATA_PLAN_ONLY)
   {
@@ -71,12 +82,42 @@ static int kafs_back_prepare_rw_mode(uint32_t data_mode, uint32_t req_size, uint
     return 1;
   }
 
+  if (data_mode == KAFS_RPC_DATA_SHM && shm->rs_base)
+    return 0;
+
   if (data_mode != KAFS_RPC_DATA_INLINE)
     return -EOPNOTSUPP;
 
   return 0;
 }
 
+// Resolve the shm slot reference that follows a READ/WRITE request struct.
+static int kafs_back_shm_slot(const kafs_rpc_shm_t *shm, const uint8_t *payload, uint32_t req_len,
+                              size_t req_struct_size, uint32_t size, char **out)
+{
+  kafs_rpc_shm_ref_t ref;
+  if (req_len != req_struct_size + sizeof(ref))
+    return -EBADMSG;
+  memcpy(&ref, payload + req_struct_size, sizeof(ref));
+  char *p = kafs_rpc_shm_slot_ptr(shm, ref.slot, ref.len);
+  if (!p || size > ref.len)
+    return -EBADMSG;
+  *out = p;
+  return 0;
+}
+
+// SHM_ATTACH: map the front's memfd slot ring (replacing any previous one).
+static int kafs_back_shm_attach(kafs_rpc_shm_t *shm, int shm_fd, const uint8_t *payload,
+                                uint32_t req_len)
+{
+  kafs_rpc_shm_attach_t att;
+  if (req_len != sizeof(att) || shm_fd < 0)
+    return -EBADMSG;
+  memcpy(&att, payload, sizeof(att));
+  kafs_rpc_shm_destroy(shm);
+  return kafs_rpc_shm_attach(shm, shm_fd, att.slot_count, att.slot_size);
+}
+
 static int kafs_back_finalize_rw_result(ssize_t io_len, uint32_t *out_size, uint32_t *out_resp_len,
                                         uint32_t resp_struct_size, int include_data_bytes)
 {
@@ -105,142 +146,468 @@ static int kafs_back_apply_mode_result(int mrc, int *result)
   return 0;
 }
 
-int kafs_back_rpc_serve(struct kafs_context *ctx, int fd)
+typedef struct kafs_back_server
+{
+  struct kafs_context *bs_ctx;
+  int bs_fd;
+  kafs_rpc_rx_t bs_rx;          // receiving thread only
+  kafs_rpc_tx_t bs_tx;          // responses finished together go out in one sendmsg
+  pthread_mutex_t bs_send_lock; // guards bs_send_rc
+  int bs_send_rc;               // first send error, ends the receive loop
+  kafs_rpc_shm_t bs_shm;        // replaced by SHM_ATTACH only while the pool is drained
+  kafs_back_pool_t bs_pool;
+} kafs_back_server_t;
+
+static int kafs_back_is_ns_op(uint16_t op)
 {
-  uint8_t payload[KAFS_RPC_MAX_PAYLOAD];
+  return op >= KAFS_RPC_OP_LOOKUP && op <= KAFS_RPC_OP_FSYNC;
+}
 
-  for (;;)
-  {
-    kafs_rpc_hdr_t req_hdr;
-    uint32_t req_len = 0;
-    int rc = kafs_rpc_recv_msg(fd, &req_hdr, payload, sizeof(payload), &req_len);
-    if (rc != 0)
-      return rc;
+// Pool key of a namespace request: the handle's inode, else a hash of the path, so that
+// different paths spread over the lanes.
+static uint32_t kafs_back_ns_key(uint16_t op, const uint8_t *payload, uint32_t req_len)
+{
+  kafs_rpc_ns_req_t req;
+  const uint8_t *extra;
+  const char *path;
+  const char *path2;
+  if (op == KAFS_RPC_OP_GETATTR_MULTI ||
+      kafs_rpc_ns_decode(payload, req_len, &req, &extra, &path, &path2) != 0)
+    return 0;
+  if (req.path_len == 0)
+    return req.ino;
+  uint32_t h = 2166136261u;
+  for (uint16_t i = 0; i < req.path_len; ++i)
+    h = (h ^ (uint8_t)path[i]) * 16777619u;
+  return h;
+}
 
-    int result = -ENOSYS;
-    uint8_t resp_buf[KAFS_RPC_MAX_PAYLOAD];
-    uint32_t resp_len = 0;
-    switch (req_hdr.op)
+// Execute one data (GETATTR/READ/WRITE/TRUNCATE) or namespace request. Runs on a pool worker (or
+// inline when the pool has no workers); requests with the same key are never run concurrently.
+static int kafs_back_exec(kafs_back_server_t *srv, uint16_t op, const uint8_t *payload,
+                          uint32_t req_len, uint8_t *resp_buf, uint32_t resp_cap,
+                          uint32_t *out_resp_len)
+{
+  struct kafs_context *ctx = srv->bs_ctx;
+  int result = -ENOSYS;
+  uint32_t resp_len = 0;
+  switch (op)
+  {
+  case KAFS_RPC_OP_GETATTR:
+    if (req_len != sizeof(kafs_rpc_getattr_req_t))
     {
-    case KAFS_RPC_OP_GETATTR:
-      if (req_len != sizeof(kafs_rpc_getattr_req_t))
-      {
-        result = -EBADMSG;
-        break;
-      }
-      else
-      {
-        kafs_rpc_getattr_req_t *req = (kafs_rpc_getattr_req_t *)payload;
-        kafs_rpc_getattr_resp_t *resp = (kafs_rpc_getattr_resp_t *)resp_buf;
+      result = -EBADMSG;
+      break;
+    }
+    else
+    {
+      const kafs_rpc_getattr_req_t *req = (const kafs_rpc_getattr_req_t *)payload;
+      kafs_rpc_getattr_resp_t *resp = (kafs_rpc_getattr_resp_t *)resp_buf;
 #ifdef KAFS_BACK_ENABLE_IMAGE
-        int grc = kafs_core_getattr(ctx, (kafs_inocnt_t)req->ino, &resp->st);
-        if (grc == 0)
-          resp_len = (uint32_t)sizeof(*resp);
-        result = grc;
+      int grc = kafs_core_getattr(ctx, (kafs_inocnt_t)req->ino, &resp->st);
+      if (grc == 0)
+        resp_len = (uint32_t)sizeof(*resp);
+      result = grc;
 #else
-        (void)req;
-        (void)resp;
-        result = -ENOSYS;
+      (void)req;
+      (void)resp;
+      result = -ENOSYS;
 #endif
-      }
+    }
+    break;
+  case KAFS_RPC_OP_READ:
+    if (req_len < sizeof(kafs_rpc_read_req_t))
+    {
+      result = -EBADMSG;
       break;
-    case KAFS_RPC_OP_READ:
-      if (req_len != sizeof(kafs_rpc_read_req_t))
+    }
+    else
+    {
+      const kafs_rpc_read_req_t *req = (const kafs_rpc_read_req_t *)payload;
+      kafs_rpc_read_resp_t *resp = (kafs_rpc_read_resp_t *)resp_buf;
+      int mrc = kafs_back_prepare_rw_mode(req->data_mode, req->size, &resp->size, &resp_len,
+                                          (uint32_t)sizeof(*resp), &srv->bs_shm);
+      if (kafs_back_apply_mode_result(mrc, &result))
+        break;
+#ifdef KAFS_BACK_ENABLE_IMAGE
+      if (req->data_mode == KAFS_RPC_DATA_SHM)
       {
-        result = -EBADMSG;
+        char *dst = NULL;
+        result = kafs_back_shm_slot(&srv->bs_shm, payload, req_len, sizeof(*req), req->size, &dst);
+        if (result != 0)
+          break;
+        ssize_t rlen =
+            kafs_core_read(ctx, (kafs_inocnt_t)req->ino, dst, req->size, (off_t)req->off);
+        result = kafs_back_finalize_rw_result(rlen, &resp->size, &resp_len,
+                                              (uint32_t)sizeof(*resp), 0);
         break;
       }
-      else
+      if (req_len != sizeof(*req))
       {
-        kafs_rpc_read_req_t *req = (kafs_rpc_read_req_t *)payload;
-        kafs_rpc_read_resp_t *resp = (kafs_rpc_read_resp_t *)resp_buf;
-        int mrc = kafs_back_prepare_rw_mode(req->data_mode, req->size, &resp->size, &resp_len,
-                                            (uint32_t)sizeof(*resp));
-        if (kafs_back_apply_mode_result(mrc, &result))
-          break;
-#ifdef KAFS_BACK_ENABLE_IMAGE
-        size_t max_data = KAFS_RPC_MAX_PAYLOAD - sizeof(kafs_rpc_read_resp_t);
-        size_t want = req->size;
-        if (want > max_data)
-          want = max_data;
-        ssize_t rlen = kafs_core_read(ctx, (kafs_inocnt_t)req->ino, resp_buf + sizeof(*resp), want,
-                                      (off_t)req->off);
-        result =
-            kafs_back_finalize_rw_result(rlen, &resp->size, &resp_len, (uint32_t)sizeof(*resp), 1);
+        result = -EBADMSG;
+        break;
+      }
+      size_t max_data = resp_cap - sizeof(kafs_rpc_read_resp_t);
+      size_t want = req->size;
+      if (want > max_data)
+        want = max_data;
+      ssize_t rlen = kafs_core_read(ctx, (kafs_inocnt_t)req->ino, resp_buf + sizeof(*resp), want,
+                                    (off_t)req->off);
+      result =
+          kafs_back_finalize_rw_result(rlen, &resp->size, &resp_len, (uint32_t)sizeof(*resp), 1);
 #else
-        (void)resp;
-        result = -EOPNOTSUPP;
+      (void)resp;
+      result = -EOPNOTSUPP;
 #endif
-      }
+    }
+    break;
+  case KAFS_RPC_OP_WRITE:
+    if (req_len < sizeof(kafs_rpc_write_req_t))
+    {
+      result = -EBADMSG;
       break;
-    case KAFS_RPC_OP_WRITE:
-      if (req_len < sizeof(kafs_rpc_write_req_t))
+    }
+    else
+    {
+      const kafs_rpc_write_req_t *req = (const kafs_rpc_write_req_t *)payload;
+      uint32_t data_len = req_len - (uint32_t)sizeof(*req);
+      kafs_rpc_write_resp_t *resp = (kafs_rpc_write_resp_t *)resp_buf;
+      int mrc = kafs_back_prepare_rw_mode(req->data_mode, req->size, &resp->size, &resp_len,
+                                          (uint32_t)sizeof(*resp), &srv->bs_shm);
+      if (kafs_back_apply_mode_result(mrc, &result))
+        break;
+#ifdef KAFS_BACK_ENABLE_IMAGE
+      if (req->data_mode == KAFS_RPC_DATA_SHM)
       {
-        result = -EBADMSG;
+        char *src = NULL;
+        result = kafs_back_shm_slot(&srv->bs_shm, payload, req_len, sizeof(*req), req->size, &src);
+        if (result != 0)
+          break;
+        ssize_t wlen =
+            kafs_core_write(ctx, (kafs_inocnt_t)req->ino, src, req->size, (off_t)req->off);
+        result = kafs_back_finalize_rw_result(wlen, &resp->size, &resp_len,
+                                              (uint32_t)sizeof(*resp), 0);
         break;
       }
-      else
+      if (req->size > data_len)
       {
-        kafs_rpc_write_req_t *req = (kafs_rpc_write_req_t *)payload;
-        uint32_t data_len = req_len - (uint32_t)sizeof(*req);
-        kafs_rpc_write_resp_t *resp = (kafs_rpc_write_resp_t *)resp_buf;
-        int mrc = kafs_back_prepare_rw_mode(req->data_mode, req->size, &resp->size, &resp_len,
-                                            (uint32_t)sizeof(*resp));
-        if (kafs_back_apply_mode_result(mrc, &result))
-          break;
-#ifdef KAFS_BACK_ENABLE_IMAGE
-        if (req->size > data_len)
-        {
-          result = -EBADMSG;
-          break;
-        }
-        ssize_t wlen = kafs_core_write(ctx, (kafs_inocnt_t)req->ino, payload + sizeof(*req),
-                                       req->size, (off_t)req->off);
-        result =
-            kafs_back_finalize_rw_result(wlen, &resp->size, &resp_len, (uint32_t)sizeof(*resp), 0);
+        result = -EBADMSG;
+        break;
+      }
+      ssize_t wlen = kafs_core_write(ctx, (kafs_inocnt_t)req->ino, payload + sizeof(*req),
+                                     req->size, (off_t)req->off);
+      result =
+          kafs_back_finalize_rw_result(wlen, &resp->size, &resp_len, (uint32_t)sizeof(*resp), 0);
 #else
-        (void)resp;
-        (void)data_len;
-        result = -EOPNOTSUPP;
+      (void)resp;
+      (void)data_len;
+      result = -EOPNOTSUPP;
 #endif
+    }
+    break;
+  case KAFS_RPC_OP_TRUNCATE:
+    if (req_len != sizeof(kafs_rpc_truncate_req_t))
+    {
+      result = -EBADMSG;
+      break;
+    }
+    else
+    {
+      const kafs_rpc_truncate_req_t *req = (const kafs_rpc_truncate_req_t *)payload;
+      kafs_rpc_truncate_resp_t *resp = (kafs_rpc_truncate_resp_t *)resp_buf;
+#ifdef KAFS_BACK_ENABLE_IMAGE
+      int trc = kafs_core_truncate(ctx, (kafs_inocnt_t)req->ino, (off_t)req->size);
+      if (trc == 0)
+      {
+        resp->size = req->size;
+        resp_len = (uint32_t)sizeof(*resp);
       }
+      result = trc;
+#else
+      (void)req;
+      (void)resp;
+      result = -ENOSYS;
+#endif
+    }
+    break;
+  default:
+#ifdef KAFS_BACK_ENABLE_IMAGE
+    if (kafs_back_is_ns_op(op))
+    {
+      result = kafs_core_ns_exec(ctx, op, payload, req_len, resp_buf, resp_cap, &resp_len);
       break;
+    }
+#endif
+    result = -ENOSYS;
+    break;
+  }
+#ifndef KAFS_BACK_ENABLE_IMAGE
+  (void)ctx;
+  (void)resp_cap;
+#endif
+  *out_resp_len = resp_len;
+  return result;
+}
+
+static void kafs_back_reply(kafs_back_server_t *srv, uint64_t req_id, int result,
+                            const uint8_t *resp_buf, uint32_t resp_len)
+{
+  int rc = kafs_rpc_tx_send_resp(&srv->bs_tx, srv->bs_fd, req_id, result,
+                                 resp_len ? resp_buf : NULL, resp_len);
+  if (rc == 0)
+    return;
+  pthread_mutex_lock(&srv->bs_send_lock);
+  if (srv->bs_send_rc == 0)
+    srv->bs_send_rc = rc;
+  pthread_mutex_unlock(&srv->bs_send_lock);
+}
+
+// Response buffer an inline READ needs beyond the default one (0: the default is enough).
+static uint32_t kafs_back_resp_cap(const kafs_back_job_t *job)
+{
+  const kafs_rpc_read_req_t *req = (const kafs_rpc_read_req_t *)job->bj_payload;
+  if (job->bj_op != KAFS_RPC_OP_READ || job->bj_len != sizeof(*req) ||
+      req->data_mode != KAFS_RPC_DATA_INLINE)
+    return 0;
+  uint32_t max_data = KAFS_RPC_MAX_PAYLOAD_LARGE - (uint32_t)sizeof(kafs_rpc_read_resp_t);
+  return (uint32_t)sizeof(kafs_rpc_read_resp_t) + (req->size < max_data ? req->size : max_data);
+}
+
+static void kafs_back_run_job(void *arg, kafs_back_job_t *job)
+{
+  kafs_back_server_t *srv = (kafs_back_server_t *)arg;
+  uint8_t stack_buf[KAFS_RPC_MAX_PAYLOAD];
+  uint8_t *resp_buf = stack_buf;
+  uint32_t resp_cap = (uint32_t)sizeof(stack_buf);
+  uint32_t want = kafs_back_resp_cap(job);
+  if (want > resp_cap)
+  {
+    // Without memory the read is just cut to the default size.
+    uint8_t *big = (uint8_t *)malloc(want);
+    if (big)
+    {
+      resp_buf = big;
+      resp_cap = want;
+    }
+  }
+  uint32_t resp_len = 0;
+  int result = kafs_back_exec(srv, job->bj_op, job->bj_payload, job->bj_len, resp_buf, resp_cap,
+                              &resp_len);
+  kafs_back_reply(srv, job->bj_req_id, result, resp_buf, resp_len);
+  if (resp_buf != stack_buf)
+    free(resp_buf);
+}
+
+#ifdef KAFS_BACK_ENABLE_IMAGE
+// STATE_SAVE: finish everything already received, close the image and answer with the state the
+// next kafs-back starts from. Returns 1 once handed off (the loop then stops reading).
+static int kafs_back_state_save(kafs_back_server_t *srv, uint64_t req_id)
+{
+  kafs_back_pool_drain(&srv->bs_pool);
+  uint8_t *buf = (uint8_t *)malloc(KAFS_RPC_MAX_PAYLOAD_LARGE);
+  uint32_t len = 0;
+  int rc = buf ? kafs_core_close_image_warm(srv->bs_ctx, buf, KAFS_RPC_MAX_PAYLOAD_LARGE, &len)
+               : -ENOMEM;
+  kafs_back_reply(srv, req_id, rc, buf, rc == 0 ? len : 0u);
+  if (rc == 0)
+    fprintf(stderr, "kafs-back: state saved for successor (%u bytes)\n", len);
+  free(buf);
+  return rc == 0 ? 1 : 0;
+}
+
+// After a handoff the image is closed: drop whatever still arrives until the front disconnects,
+// so calls in flight fail on the front's side exactly as on a cold restart.
+static int kafs_back_wait_peer_close(kafs_back_server_t *srv, uint8_t *payload)
+{
+  for (;;)
+  {
+    kafs_rpc_hdr_t hdr;
+    uint32_t len = 0;
+    int rx_fd = -1;
+    if (kafs_rpc_rx_recv_msg_fd(&srv->bs_rx, &hdr, payload, KAFS_RPC_MAX_PAYLOAD_LARGE, &len,
+                                &rx_fd) != 0)
+      return 0;
+    if (rx_fd >= 0)
+      close(rx_fd);
+  }
+}
+#endif
+
+static int kafs_back_send_rc(kafs_back_server_t *srv)
+{
+  pthread_mutex_lock(&srv->bs_send_lock);
+  int rc = srv->bs_send_rc;
+  pthread_mutex_unlock(&srv->bs_send_lock);
+  return rc;
+}
+
+// The receiving thread only decodes headers: data ops are handed to the pool keyed by inode (and
+// namespace ops by kafs_back_ns_key) and answered from the workers in completion order (the front
+// matches responses by req_id).
+// SHM_ATTACH and CTL_STATUS are answered inline; STATE_SAVE ends the loop.
+// Requests are cut out of a read-ahead buffer, so a burst pipelined by the front costs one recvmsg.
+static int kafs_back_serve_loop(kafs_back_server_t *srv, uint8_t *payload)
+{
+  for (;;)
+  {
+    kafs_rpc_hdr_t req_hdr;
+    uint32_t req_len = 0;
+    int rx_fd = -1;
+    int rc = kafs_rpc_rx_recv_msg_fd(&srv->bs_rx, &req_hdr, payload, KAFS_RPC_MAX_PAYLOAD_LARGE,
+                                     &req_len, &rx_fd);
+    if (rc != 0)
+      return rc;
+    if (rx_fd >= 0 && req_hdr.op != KAFS_RPC_OP_SHM_ATTACH)
+    {
+      close(rx_fd);
+      rx_fd = -1;
+    }
+
+    int result = -ENOSYS;
+    uint8_t resp_buf[sizeof(kafs_rpc_back_status_t)];
+    uint32_t resp_len = 0;
+    switch (req_hdr.op)
+    {
+    case KAFS_RPC_OP_GETATTR:
+    case KAFS_RPC_OP_READ:
+    case KAFS_RPC_OP_WRITE:
     case KAFS_RPC_OP_TRUNCATE:
-      if (req_len != sizeof(kafs_rpc_truncate_req_t))
+    case KAFS_RPC_OP_LOOKUP:
+    case KAFS_RPC_OP_GETATTR_MULTI:
+    case KAFS_RPC_OP_READDIR:
+    case KAFS_RPC_OP_CREATE:
+    case KAFS_RPC_OP_MKDIR:
+    case KAFS_RPC_OP_UNLINK:
+    case KAFS_RPC_OP_RMDIR:
+    case KAFS_RPC_OP_RENAME:
+    case KAFS_RPC_OP_LINK:
+    case KAFS_RPC_OP_SYMLINK:
+    case KAFS_RPC_OP_READLINK:
+    case KAFS_RPC_OP_SETATTR:
+    case KAFS_RPC_OP_OPEN:
+    case KAFS_RPC_OP_RELEASE:
+    case KAFS_RPC_OP_FSYNC:
+    {
+      // Every data request starts with the inode number.
+      uint32_t key = 0;
+      if (kafs_back_is_ns_op(req_hdr.op))
+        key = kafs_back_ns_key(req_hdr.op, payload, req_len);
+      else if (req_len >= sizeof(key))
+        memcpy(&key, payload, sizeof(key));
+      kafs_back_job_t *job = kafs_back_job_new(req_hdr.op, req_hdr.req_id, key, payload, req_len);
+      if (job)
       {
-        result = -EBADMSG;
-        break;
+        kafs_back_pool_submit(&srv->bs_pool, job);
+        rc = kafs_back_send_rc(srv);
+        if (rc != 0)
+          return rc;
+        continue;
       }
-      else
-      {
-        kafs_rpc_truncate_req_t *req = (kafs_rpc_truncate_req_t *)payload;
-        kafs_rpc_truncate_resp_t *resp = (kafs_rpc_truncate_resp_t *)resp_buf;
+      result = -ENOMEM;
+      break;
+    }
+    case KAFS_RPC_OP_SHM_ATTACH:
+      // Workers may be reading or writing slots of the current ring.
+      kafs_back_pool_drain(&srv->bs_pool);
+      result = kafs_back_shm_attach(&srv->bs_shm, rx_fd, payload, req_len);
+      if (result != 0 && rx_fd >= 0 && srv->bs_shm.rs_fd != rx_fd)
+        close(rx_fd);
+      rx_fd = -1;
+      if (result == 0)
+        fprintf(stderr, "kafs-back: shm data plane attached (%u slots x %u bytes)\n",
+                srv->bs_shm.rs_slot_count, srv->bs_shm.rs_slot_size);
+      break;
 #ifdef KAFS_BACK_ENABLE_IMAGE
-        int trc = kafs_core_truncate(ctx, (kafs_inocnt_t)req->ino, (off_t)req->size);
-        if (trc == 0)
-        {
-          resp->size = req->size;
-          resp_len = (uint32_t)sizeof(*resp);
-        }
-        result = trc;
-#else
-        (void)req;
-        (void)resp;
-        result = -ENOSYS;
+    case KAFS_RPC_OP_STATE_SAVE:
+      if (kafs_back_state_save(srv, req_hdr.req_id))
+        return kafs_back_wait_peer_close(srv, payload);
+      rc = kafs_back_send_rc(srv);
+      if (rc != 0)
+        return rc;
+      continue;
 #endif
-      }
+    case KAFS_RPC_OP_CTL_STATUS:
+    {
+      kafs_rpc_back_status_t st;
+      kafs_back_pool_status(&srv->bs_pool, &st);
+      memcpy(resp_buf, &st, sizeof(st));
+      resp_len = (uint32_t)sizeof(st);
+      result = 0;
       break;
+    }
     default:
       result = -ENOSYS;
       break;
     }
 
-    rc = kafs_rpc_send_resp(fd, req_hdr.req_id, result, resp_len ? resp_buf : NULL, resp_len);
+    kafs_back_reply(srv, req_hdr.req_id, result, resp_buf, resp_len);
+    rc = kafs_back_send_rc(srv);
     if (rc != 0)
       return rc;
   }
 }
 
+int kafs_back_rpc_serve(struct kafs_context *ctx, int fd, uint32_t workers)
+{
+  kafs_back_server_t srv;
+  memset(&srv, 0, sizeof(srv));
+  srv.bs_ctx = ctx;
+  srv.bs_fd = fd;
+  uint8_t *payload = (uint8_t *)malloc(KAFS_RPC_MAX_PAYLOAD_LARGE);
+  if (!payload || kafs_rpc_rx_init(&srv.bs_rx, fd) != 0)
+  {
+    free(payload);
+    return -ENOMEM;
+  }
+  kafs_rpc_tx_init(&srv.bs_tx);
+  pthread_mutex_init(&srv.bs_send_lock, NULL);
+  kafs_rpc_shm_reset(&srv.bs_shm);
+  uint32_t started = kafs_back_pool_start(&srv.bs_pool, workers, kafs_back_run_job, &srv);
+  if (started != workers)
+    fprintf(stderr, "kafs-back: started %u of %u workers\n", started, workers);
+
+  int rc = kafs_back_serve_loop(&srv, payload);
+  // Queued requests still run; their responses fail quietly once the peer is gone.
+  kafs_back_pool_stop(&srv.bs_pool);
+  kafs_rpc_shm_destroy(&srv.bs_shm);
+  pthread_mutex_destroy(&srv.bs_send_lock);
+  kafs_rpc_tx_destroy(&srv.bs_tx);
+  kafs_rpc_rx_destroy(&srv.bs_rx);
+  free(payload);
+  return rc;
+}
+
+#ifdef KAFS_BACK_ENABLE_IMAGE
+// The front passes what the previous kafs-back returned for STATE_SAVE as a memfd.
+// Anything unreadable is dropped: the image is then opened cold.
+static void kafs_back_load_warm_state(const char *fd_env, uint8_t **out, uint32_t *out_len)
+{
+  if (!fd_env || fd_env[0] == '\0')
+    return;
+  char *end = NULL;
+  long val = strtol(fd_env, &end, 10);
+  if (!end || *end != '\0' || val < 0 || val > INT_MAX)
+    return;
+  int fd = (int)val;
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    return;
+  uint8_t *buf = NULL;
+  if (st.st_size > 0 && st.st_size <= (off_t)KAFS_RPC_MAX_PAYLOAD_LARGE)
+    buf = (uint8_t *)malloc((size_t)st.st_size);
+  if (buf && pread(fd, buf, (size_t)st.st_size, 0) == (ssize_t)st.st_size)
+  {
+    *out = buf;
+    *out_len = (uint32_t)st.st_size;
+  }
+  else
+  {
+    free(buf);
+  }
+  close(fd);
+}
+#endif
+
 int main(int argc, char **argv)
 {
   kafs_crash_diag_install("kafs-back");
@@ -253,6 +620,7 @@ int main(int argc, char **argv)
 
   const char *fd_env = getenv("KAFS_HOTPLUG_BACK_FD");
   const char *uds_path = getenv("KAFS_HOTPLUG_UDS");
+  const char *workers_env = getenv("KAFS_BACK_WORKERS");
 #ifdef KAFS_BACK_ENABLE_IMAGE
   const char *image_path = getenv("KAFS_IMAGE");
 #endif
@@ -271,6 +639,16 @@ int main(int argc, char **argv)
       fd_env = argv[++i];
       continue;
     }
+    if (strcmp(argv[i], "--workers") == 0)
+    {
+      if (i + 1 >= argc)
+      {
+        usage(argv[0]);
+        return 2;
+      }
+      workers_env = argv[++i];
+      continue;
+    }
 
     int consume_next = 0;
     int exit_code = -1;
@@ -305,12 +683,22 @@ int main(int argc, char **argv)
     return 2;
   }
 
-  rc = kafs_core_open_image(image_path, &ctx);
+  uint8_t *warm = NULL;
+  uint32_t warm_len = 0;
+  kafs_back_load_warm_state(getenv("KAFS_BACK_WARM_FD"), &warm, &warm_len);
+  int warm_adopted = 0;
+  rc = kafs_core_open_image_warm(image_path, &ctx, warm, warm_len, &warm_adopted);
   if (rc != 0)
   {
+    free(warm);
     fprintf(stderr, "kafs-back: failed to open image rc=%d\n", rc);
     return 2;
   }
+  if (warm && warm_adopted)
+    fprintf(stderr, "kafs-back: warm start from predecessor state (%u bytes)\n", warm_len);
+  else if (warm)
+    fprintf(stderr, "kafs-back: predecessor state is stale; HRL free list rebuilt\n");
+  free(warm);
 #endif
 
   int fd = -1;
@@ -359,6 +747,17 @@ int main(int argc, char **argv)
     }
   }
 
+  uint32_t workers = KAFS_BACK_WORKERS_DEFAULT;
+  if (workers_env && workers_env[0] != '\0')
+  {
+    char *end = NULL;
+    unsigned long val = strtoul(workers_env, &end, 10);
+    if (end && *end == '\0' && val <= KAFS_BACK_WORKERS_MAX)
+      workers = (uint32_t)val;
+    else
+      fprintf(stderr, "kafs-back: invalid worker count '%s', using %u\n", workers_env, workers);
+  }
+
   uint64_t session_id = 0;
   uint32_t epoch = 0;
   rc = kafs_back_handshake(fd, &session_id, &epoch);
@@ -372,9 +771,10 @@ int main(int argc, char **argv)
     return 2;
   }
 
-  fprintf(stderr, "kafs-back: handshake ok (session=%" PRIu64 " epoch=%u)\n", session_id, epoch);
+  fprintf(stderr, "kafs-back: handshake ok (session=%" PRIu64 " epoch=%u workers=%u)\n",
+          session_id, epoch, workers);
 
-  rc = kafs_back_rpc_serve(&ctx, fd);
+  rc = kafs_back_rpc_serve(&ctx, fd, workers);
   if (rc != 0 && rc != -EIO)
     fprintf(stderr, "kafs-back: serve rc=%d\n", rc);
 
@@ -0,0 +1,232 @@
+#pragma once
+#include "kafs_rpc.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// kafs-back の要求実行スレッド。受信スレッドは要求を 1 件ずつ kafs_back_job_t に写して投げ、
+// 実行スレッドが kafs_core_* を呼んで応答を返す（前段は req_id で突き合わせるので順不同でよい）。
+// 実行スレッドごとにレーン（FIFO）を 1 本持ち、要求は key（inode 番号）でレーンを選ぶ。
+// 同じ inode への要求は同じレーンに受けた順で並ぶので、WRITE / TRUNCATE / READ の順序は
+// 直列に実行していたときと変わらない。別の inode は別のレーンで並行に走る
+// （同じレーンに落ちた別の inode は順番待ちになる）。
+// レーン数 0 は受信スレッドがその場で実行する（従来の直列動作）。統計は両方で同じように数える。
+
+#define KAFS_BACK_WORKERS_DEFAULT 4u
+#define KAFS_BACK_WORKERS_MAX 64u
+
+typedef struct kafs_back_job
+{
+  struct kafs_back_job *bj_next;
+  uint64_t bj_req_id;
+  uint64_t bj_enq_ns;
+  uint32_t bj_key;
+  uint32_t bj_len;
+  uint16_t bj_op;
+  uint8_t bj_payload[] __attribute__((aligned(8))); // 要求構造体をそのまま参照できるように
+} kafs_back_job_t;
+
+/// @brief 1 件を実行して応答まで返す（job の解放は実行器が行う）
+typedef void (*kafs_back_job_fn)(void *arg, kafs_back_job_t *job);
+
+struct kafs_back_pool;
+
+typedef struct kafs_back_lane
+{
+  struct kafs_back_pool *bl_pool;
+  pthread_t bl_tid;
+  pthread_cond_t bl_cond;
+  kafs_back_job_t *bl_head;
+  kafs_back_job_t *bl_tail;
+} kafs_back_lane_t;
+
+typedef struct kafs_back_pool
+{
+  pthread_mutex_t bp_lock;
+  pthread_cond_t bp_idle_cond; // bp_inflight が 0 になった
+  kafs_back_lane_t *bp_lanes;
+  uint32_t bp_nlanes;
+  int bp_stop;
+  uint32_t bp_inflight; // 投げてから実行し終えるまでの件数
+  kafs_back_job_fn bp_fn;
+  void *bp_arg;
+  // 統計（bp_lock の下で更新する）
+  uint32_t bp_queue_depth; // レーンに積まれて未着手の件数
+  uint32_t bp_queue_depth_max;
+  uint64_t bp_requests;
+  uint64_t bp_service_ns;
+  uint64_t bp_service_ns_max;
+  uint64_t bp_queue_wait_ns;
+} kafs_back_pool_t;
+
+static inline uint64_t kafs_back_pool_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/// @brief 要求 1 件分の job を作る（payload は len バイト写す）
+/// @return job、失敗時は NULL
+static inline kafs_back_job_t *kafs_back_job_new(uint16_t op, uint64_t req_id, uint32_t key,
+                                                 const void *payload, uint32_t len)
+{
+  kafs_back_job_t *job = (kafs_back_job_t *)malloc(sizeof(*job) + len);
+  if (!job)
+    return NULL;
+  job->bj_next = NULL;
+  job->bj_req_id = req_id;
+  job->bj_enq_ns = kafs_back_pool_now_ns();
+  job->bj_key = key;
+  job->bj_len = len;
+  job->bj_op = op;
+  if (len)
+    memcpy(job->bj_payload, payload, len);
+  return job;
+}
+
+static inline void kafs_back_pool_run(kafs_back_pool_t *p, kafs_back_job_t *job)
+{
+  uint64_t start = kafs_back_pool_now_ns();
+  p->bp_fn(p->bp_arg, job);
+  uint64_t svc = kafs_back_pool_now_ns() - start;
+  uint64_t wait = start - job->bj_enq_ns;
+  free(job);
+
+  pthread_mutex_lock(&p->bp_lock);
+  p->bp_requests++;
+  p->bp_service_ns += svc;
+  if (svc > p->bp_service_ns_max)
+    p->bp_service_ns_max = svc;
+  p->bp_queue_wait_ns += wait;
+  if (--p->bp_inflight == 0)
+    pthread_cond_broadcast(&p->bp_idle_cond);
+  pthread_mutex_unlock(&p->bp_lock);
+}
+
+static inline void *kafs_back_pool_lane_main(void *arg)
+{
+  kafs_back_lane_t *l = (kafs_back_lane_t *)arg;
+  kafs_back_pool_t *p = l->bl_pool;
+  pthread_mutex_lock(&p->bp_lock);
+  for (;;)
+  {
+    while (!l->bl_head && !p->bp_stop)
+      pthread_cond_wait(&l->bl_cond, &p->bp_lock);
+    kafs_back_job_t *job = l->bl_head;
+    if (!job)
+      break; // 止める指示があり、積まれた分は実行し終えた
+    l->bl_head = job->bj_next;
+    if (!l->bl_head)
+      l->bl_tail = NULL;
+    p->bp_queue_depth--;
+    pthread_mutex_unlock(&p->bp_lock);
+    kafs_back_pool_run(p, job);
+    pthread_mutex_lock(&p->bp_lock);
+  }
+  pthread_mutex_unlock(&p->bp_lock);
+  return NULL;
+}
+
+/// @brief nlanes 本の実行スレッドを起こす（KAFS_BACK_WORKERS_MAX で頭打ち）
+/// スレッドを作れなかった分はレーンを減らす（1 本も作れなければ直列で動く）。
+/// @return 起こせたレーン数
+static inline uint32_t kafs_back_pool_start(kafs_back_pool_t *p, uint32_t nlanes,
+                                            kafs_back_job_fn fn, void *arg)
+{
+  memset(p, 0, sizeof(*p));
+  p->bp_fn = fn;
+  p->bp_arg = arg;
+  pthread_mutex_init(&p->bp_lock, NULL);
+  pthread_cond_init(&p->bp_idle_cond, NULL);
+  if (nlanes > KAFS_BACK_WORKERS_MAX)
+    nlanes = KAFS_BACK_WORKERS_MAX;
+  if (nlanes == 0)
+    return 0;
+  p->bp_lanes = (kafs_back_lane_t *)calloc(nlanes, sizeof(*p->bp_lanes));
+  if (!p->bp_lanes)
+    return 0;
+  for (uint32_t i = 0; i < nlanes; ++i)
+  {
+    kafs_back_lane_t *l = &p->bp_lanes[i];
+    l->bl_pool = p;
+    pthread_cond_init(&l->bl_cond, NULL);
+    if (pthread_create(&l->bl_tid, NULL, kafs_back_pool_lane_main, l) != 0)
+    {
+      pthread_cond_destroy(&l->bl_cond);
+      break;
+    }
+    p->bp_nlanes = i + 1u;
+  }
+  return p->bp_nlanes;
+}
+
+/// @brief job を投げる（所有権は実行器に移る）。レーンが無ければその場で実行する
+static inline void kafs_back_pool_submit(kafs_back_pool_t *p, kafs_back_job_t *job)
+{
+  pthread_mutex_lock(&p->bp_lock);
+  p->bp_inflight++;
+  if (p->bp_nlanes == 0)
+  {
+    pthread_mutex_unlock(&p->bp_lock);
+    kafs_back_pool_run(p, job);
+    return;
+  }
+  kafs_back_lane_t *l = &p->bp_lanes[job->bj_key % p->bp_nlanes];
+  if (l->bl_tail)
+    l->bl_tail->bj_next = job;
+  else
+    l->bl_head = job;
+  l->bl_tail = job;
+  if (++p->bp_queue_depth > p->bp_queue_depth_max)
+    p->bp_queue_depth_max = p->bp_queue_depth;
+  pthread_cond_signal(&l->bl_cond);
+  pthread_mutex_unlock(&p->bp_lock);
+}
+
+/// @brief 投げた job がすべて実行し終わるまで待つ
+static inline void kafs_back_pool_drain(kafs_back_pool_t *p)
+{
+  pthread_mutex_lock(&p->bp_lock);
+  while (p->bp_inflight)
+    pthread_cond_wait(&p->bp_idle_cond, &p->bp_lock);
+  pthread_mutex_unlock(&p->bp_lock);
+}
+
+/// @brief 積まれた分を実行し終えてからスレッドを止める
+static inline void kafs_back_pool_stop(kafs_back_pool_t *p)
+{
+  pthread_mutex_lock(&p->bp_lock);
+  p->bp_stop = 1;
+  for (uint32_t i = 0; i < p->bp_nlanes; ++i)
+    pthread_cond_signal(&p->bp_lanes[i].bl_cond);
+  pthread_mutex_unlock(&p->bp_lock);
+  for (uint32_t i = 0; i < p->bp_nlanes; ++i)
+  {
+    pthread_join(p->bp_lanes[i].bl_tid, NULL);
+    pthread_cond_destroy(&p->bp_lanes[i].bl_cond);
+  }
+  free(p->bp_lanes);
+  p->bp_lanes = NULL;
+  p->bp_nlanes = 0;
+  pthread_cond_destroy(&p->bp_idle_cond);
+  pthread_mutex_destroy(&p->bp_lock);
+}
+
+static inline void kafs_back_pool_status(kafs_back_pool_t *p, kafs_rpc_back_status_t *out)
+{
+  memset(out, 0, sizeof(*out));
+  pthread_mutex_lock(&p->bp_lock);
+  out->workers = p->bp_nlanes;
+  out->queue_depth = p->bp_queue_depth;
+  out->queue_depth_max = p->bp_queue_depth_max;
+  out->requests = p->bp_requests;
+  out->service_ns = p->bp_service_ns;
+  out->service_ns_max = p->bp_service_ns_max;
+  out->queue_wait_ns = p->bp_queue_wait_ns;
+  pthread_mutex_unlock(&p->bp_lock);
+}
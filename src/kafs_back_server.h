@@ -1,7 +1,9 @@
 #pragma once
+#include <stdint.h>
 
 struct kafs_context;
 
-// Runs the RPC loop on an already-handshaked connection.
+// Runs the RPC loop on an already-handshaked connection. Data requests are executed by
+// `workers` threads (0 = inline on the receiving thread), ordered per inode.
 // Returns 0 on orderly shutdown, or <0 (-errno) on errors.
-int kafs_back_rpc_serve(struct kafs_context *ctx, int fd);
\ No newline at end of file
+int kafs_back_rpc_serve(struct kafs_context *ctx, int fd, uint32_t workers);
\ No newline at end of file
@@ -0,0 +1,271 @@
+#pragma once
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 展開済み・よく読むブロックのキャッシュ。
+// キーはデータ参照（圧縮参照ならスロットまで含む 32bit 値）。HRL で共有されたブロックは多くの
+// inode から同じ参照で読まれるので、1 度展開すれば以降はここから写すだけで済む。
+// io_engine=pread/direct では生のブロックもブロック番号をキーに置く（direct の読み出しはページ
+// キャッシュを通らないので、共有ブロックを読むたびにデバイスまで行かないように）。
+// シャードごとに mutex・固定数のスロット・チェイン式のハッシュ表を持ち、追い出しは GCLOCK
+// （当たるたびに使用カウントを 3 まで積み、針が 1 つずつ減らして 0 のものを追い出す）。
+// 中身の入れ替わり（生のブロックへの書き込み、HRL の参照数が 0 になってブロックやスロットを
+// 解放する）ときは呼び出し側が kafs_bcache_invalidate する。書き込み・解放と読み出しが競合しても
+// 古い中身を入れないよう、無効化のたびにシャードの epoch を進め、get で得た epoch が変わって
+// いれば put は入れない。
+// キー 0（KAFS_BLO_NONE）は入れない。
+
+#define KAFS_BCACHE_SHARDS 16u
+#define KAFS_BCACHE_USE_MAX 3u
+#define KAFS_BCACHE_NIL UINT32_MAX
+#define KAFS_BLK_CACHE_MB_DEFAULT 16u
+#define KAFS_BLK_CACHE_MB_MAX 4096u
+
+typedef struct kafs_bcache_slot
+{
+  uint32_t bs_key;  // 0: 空き
+  uint32_t bs_next; // 同じバケットの次のスロット
+  uint32_t bs_use;  // GCLOCK の使用カウント
+} kafs_bcache_slot_t;
+
+typedef struct kafs_bcache_shard
+{
+  pthread_mutex_t sh_lock;
+  uint32_t sh_hand;
+  uint32_t sh_epoch;
+  uint32_t *sh_bucket; // バケット → 先頭スロット
+  kafs_bcache_slot_t *sh_slot;
+  char *sh_data; // bc_slots * bc_bs
+  uint64_t sh_hits;
+  uint64_t sh_misses;
+  uint64_t sh_inserts;
+  uint64_t sh_evictions;
+  uint64_t sh_invalidations;
+} __attribute__((aligned(64))) kafs_bcache_shard_t;
+
+typedef struct kafs_bcache
+{
+  uint32_t bc_shard_mask;
+  uint32_t bc_slots; // シャードあたりのスロット数
+  uint32_t bc_bucket_mask;
+  uint32_t bc_bs;
+  kafs_bcache_shard_t bc_shard[];
+} kafs_bcache_t;
+
+typedef struct kafs_bcache_counters
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t inserts;
+  uint64_t evictions;
+  uint64_t invalidations;
+} kafs_bcache_counters_t;
+
+static inline uint32_t kafs_bcache_hash(uint32_t key) { return key * 2654435761u; }
+
+static inline kafs_bcache_shard_t *kafs_bcache_shard_of(kafs_bcache_t *c, uint32_t key)
+{
+  return &c->bc_shard[(kafs_bcache_hash(key) >> 24) & c->bc_shard_mask];
+}
+
+static inline uint32_t *kafs_bcache_bucket_of(kafs_bcache_t *c, kafs_bcache_shard_t *sh,
+                                              uint32_t key)
+{
+  return &sh->sh_bucket[kafs_bcache_hash(key) & c->bc_bucket_mask];
+}
+
+static inline void kafs_bcache_destroy(kafs_bcache_t *c)
+{
+  if (!c)
+    return;
+  for (uint32_t i = 0; i <= c->bc_shard_mask; ++i)
+  {
+    kafs_bcache_shard_t *sh = &c->bc_shard[i];
+    pthread_mutex_destroy(&sh->sh_lock);
+    free(sh->sh_bucket);
+    free(sh->sh_slot);
+    free(sh->sh_data);
+  }
+  free(c);
+}
+
+/// @brief budget バイトに収まるキャッシュを作る
+/// シャード数は 1 シャードに 1 スロット以上入るまで減らす。
+/// @return キャッシュ, NULL: budget がブロック 1 つに満たない / メモリ不足
+static inline kafs_bcache_t *kafs_bcache_create(size_t budget, uint32_t bs)
+{
+  if (bs == 0 || budget / bs == 0)
+    return NULL;
+  size_t blocks = budget / bs;
+  uint32_t shards = KAFS_BCACHE_SHARDS;
+  while (shards > 1u && blocks < shards)
+    shards >>= 1;
+  size_t per = blocks / shards;
+  if (per > (1u << 24))
+    per = 1u << 24;
+  uint32_t buckets = 1u;
+  while (buckets < per)
+    buckets <<= 1;
+
+  kafs_bcache_t *c =
+      (kafs_bcache_t *)calloc(1, sizeof(*c) + (size_t)shards * sizeof(kafs_bcache_shard_t));
+  if (!c)
+    return NULL;
+  c->bc_shard_mask = shards - 1u;
+  c->bc_slots = (uint32_t)per;
+  c->bc_bucket_mask = buckets - 1u;
+  c->bc_bs = bs;
+  for (uint32_t i = 0; i < shards; ++i)
+  {
+    kafs_bcache_shard_t *sh = &c->bc_shard[i];
+    pthread_mutex_init(&sh->sh_lock, NULL);
+    sh->sh_bucket = (uint32_t *)malloc((size_t)buckets * sizeof(uint32_t));
+    sh->sh_slot = (kafs_bcache_slot_t *)calloc(per, sizeof(kafs_bcache_slot_t));
+    sh->sh_data = (char *)malloc(per * (size_t)bs); // 触るまで物理ページは使わない
+    if (!sh->sh_bucket || !sh->sh_slot || !sh->sh_data)
+    {
+      c->bc_shard_mask = i; // 初期化済みのシャードまで片付ける
+      kafs_bcache_destroy(c);
+      return NULL;
+    }
+    memset(sh->sh_bucket, 0xff, (size_t)buckets * sizeof(uint32_t));
+  }
+  return c;
+}
+
+/// @brief 実際に使うバイト数
+static inline size_t kafs_bcache_bytes(const kafs_bcache_t *c)
+{
+  return c ? (size_t)(c->bc_shard_mask + 1u) * c->bc_slots * c->bc_bs : 0u;
+}
+
+static inline uint32_t kafs_bcache_find_locked(kafs_bcache_t *c, kafs_bcache_shard_t *sh,
+                                               uint32_t key, uint32_t **link)
+{
+  uint32_t *l = kafs_bcache_bucket_of(c, sh, key);
+  while (*l != KAFS_BCACHE_NIL && sh->sh_slot[*l].bs_key != key)
+    l = &sh->sh_slot[*l].bs_next;
+  if (link)
+    *link = l;
+  return *l;
+}
+
+/// @brief key を探して buf に写す
+/// @param epoch 外れたときに put へ渡す値（NULL 可）
+/// @return 1: 当たり, 0: 外れ
+static inline int kafs_bcache_get(kafs_bcache_t *c, uint32_t key, void *buf, uint32_t *epoch)
+{
+  if (!c || key == 0)
+    return 0;
+  kafs_bcache_shard_t *sh = kafs_bcache_shard_of(c, key);
+  pthread_mutex_lock(&sh->sh_lock);
+  uint32_t i = kafs_bcache_find_locked(c, sh, key, NULL);
+  int hit = (i != KAFS_BCACHE_NIL);
+  if (hit)
+  {
+    memcpy(buf, sh->sh_data + (size_t)i * c->bc_bs, c->bc_bs);
+    if (sh->sh_slot[i].bs_use < KAFS_BCACHE_USE_MAX)
+      sh->sh_slot[i].bs_use++;
+    sh->sh_hits++;
+  }
+  else
+  {
+    sh->sh_misses++;
+  }
+  if (epoch)
+    *epoch = sh->sh_epoch;
+  pthread_mutex_unlock(&sh->sh_lock);
+  return hit;
+}
+
+/// @brief 針を回して空きか使用カウント 0 のスロットを選び、前の中身をハッシュ表から外す
+static inline uint32_t kafs_bcache_victim_locked(kafs_bcache_t *c, kafs_bcache_shard_t *sh)
+{
+  for (;;)
+  {
+    uint32_t i = sh->sh_hand;
+    sh->sh_hand = (i + 1u == c->bc_slots) ? 0u : i + 1u;
+    kafs_bcache_slot_t *s = &sh->sh_slot[i];
+    if (s->bs_key == 0)
+      return i;
+    if (s->bs_use > 0)
+    {
+      s->bs_use--;
+      continue;
+    }
+    uint32_t *link = NULL;
+    (void)kafs_bcache_find_locked(c, sh, s->bs_key, &link);
+    *link = s->bs_next;
+    s->bs_key = 0;
+    sh->sh_evictions++;
+    return i;
+  }
+}
+
+/// @brief get で外れた key の中身を入れる（その間に無効化があれば入れない）
+/// @return 1: 入れた, 0: 入れなかった
+static inline int kafs_bcache_put(kafs_bcache_t *c, uint32_t key, const void *buf, uint32_t epoch)
+{
+  if (!c || key == 0)
+    return 0;
+  kafs_bcache_shard_t *sh = kafs_bcache_shard_of(c, key);
+  pthread_mutex_lock(&sh->sh_lock);
+  if (sh->sh_epoch != epoch || kafs_bcache_find_locked(c, sh, key, NULL) != KAFS_BCACHE_NIL)
+  {
+    pthread_mutex_unlock(&sh->sh_lock);
+    return 0;
+  }
+  uint32_t i = kafs_bcache_victim_locked(c, sh);
+  kafs_bcache_slot_t *s = &sh->sh_slot[i];
+  memcpy(sh->sh_data + (size_t)i * c->bc_bs, buf, c->bc_bs);
+  uint32_t *head = kafs_bcache_bucket_of(c, sh, key);
+  s->bs_key = key;
+  s->bs_use = 0;
+  s->bs_next = *head;
+  *head = i;
+  sh->sh_inserts++;
+  pthread_mutex_unlock(&sh->sh_lock);
+  return 1;
+}
+
+/// @brief key の中身が変わる・無くなるので捨てる（入っていなくても epoch は進める）
+static inline void kafs_bcache_invalidate(kafs_bcache_t *c, uint32_t key)
+{
+  if (!c || key == 0)
+    return;
+  kafs_bcache_shard_t *sh = kafs_bcache_shard_of(c, key);
+  pthread_mutex_lock(&sh->sh_lock);
+  sh->sh_epoch++;
+  uint32_t *link = NULL;
+  uint32_t i = kafs_bcache_find_locked(c, sh, key, &link);
+  if (i != KAFS_BCACHE_NIL)
+  {
+    *link = sh->sh_slot[i].bs_next;
+    sh->sh_slot[i].bs_key = 0;
+    sh->sh_slot[i].bs_use = 0;
+    sh->sh_invalidations++;
+  }
+  pthread_mutex_unlock(&sh->sh_lock);
+}
+
+static inline void kafs_bcache_counters(kafs_bcache_t *c, kafs_bcache_counters_t *out)
+{
+  memset(out, 0, sizeof(*out));
+  if (!c)
+    return;
+  for (uint32_t i = 0; i <= c->bc_shard_mask; ++i)
+  {
+    kafs_bcache_shard_t *sh = &c->bc_shard[i];
+    pthread_mutex_lock(&sh->sh_lock);
+    out->hits += sh->sh_hits;
+    out->misses += sh->sh_misses;
+    out->inserts += sh->sh_inserts;
+    out->evictions += sh->sh_evictions;
+    out->invalidations += sh->sh_invalidations;
+    pthread_mutex_unlock(&sh->sh_lock);
+  }
+}
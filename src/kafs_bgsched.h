@@ -0,0 +1,518 @@
+#pragma once
+#include "kafs.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// バックグラウンド作業（pending worker / tombstone GC / bg dedup）の共通実行器。
+// 作業ごとに専用スレッドと mutex/cond・バックオフ・優先度ブーストを持つ代わりに、型付きの作業項目を
+// 小さなスレッドプールで回す。各項目は w_run が「次に走らせるまでの ms」を返し、実行器はそれを
+// 期限（due）としてレーンごとの二分ヒープに積む。1 項目が同時に 2 スレッドで走ることはない。
+//
+// レーンは 2 本:
+//   NORMAL: nice 0 / SCHED_OTHER のまま動くスレッド群（bg_threads 本）
+//   LOW   : 項目が望む idle / nice を当てるスレッド 1 本。非特権では nice を戻せないので
+//           このスレッドは下げる方向にしか動かさない。
+// 望む優先度が normal の項目と、w_run が urgent を返した項目（容量逼迫・pending 水位超過）は
+// NORMAL に積む。これが旧来の「auto boost で優先度を戻す」処理の置き換え。
+//
+// 前景負荷の予算: KAFS_BG_WINDOW_NS ごとに s_fg_probe（FUSE 操作の累積数）の増分を見て、
+// s_busy_ops 以上なら「前景が忙しい」とし、次の窓で非 urgent 項目が使える時間を
+// 窓の s_busy_pct % に絞る（超えた項目は次の窓の頭まで後回し）。前景が静かなら制限しない。
+//
+// pending の解決は inode でシャードに分けて項目を最大 KAFS_BG_PENDING_SHARDS_MAX 個並べる
+// （シャード 0 が KAFS_BG_WORK_PENDING、1 以降は KAFS_BG_WORK_PENDING_SHARD1 から）。
+
+#define KAFS_BG_THREADS_MAX 16u
+#define KAFS_BG_THREADS_DEFAULT 2u
+#define KAFS_BG_WAIT_KICK UINT32_MAX // w_run の戻り値: kick されるまで寝る
+#define KAFS_BG_WINDOW_NS 100000000ull
+#define KAFS_BG_BUSY_OPS_DEFAULT 64u // 窓あたりの前景操作数
+#define KAFS_BG_BUSY_PCT_DEFAULT 25u
+
+enum
+{
+  KAFS_BG_WORK_PENDING = 0,
+  KAFS_BG_WORK_TOMBSTONE_GC = 1,
+  KAFS_BG_WORK_BG_DEDUP = 2,
+  KAFS_BG_WORK_PENDING_SHARD1 = 3,
+};
+
+#define KAFS_BG_PENDING_SHARDS_MAX 8u
+// mem_budget の休眠メタデータのトリム（pending シャードの後ろ）
+#define KAFS_BG_WORK_MEM_TRIM (KAFS_BG_WORK_PENDING_SHARD1 + KAFS_BG_PENDING_SHARDS_MAX - 1u)
+#define KAFS_BG_WORK_MAX (KAFS_BG_WORK_MEM_TRIM + 1u)
+
+/// @brief pending シャード shard の作業 id
+static inline uint32_t kafs_bg_work_pending_id(uint32_t shard)
+{
+  return shard == 0 ? KAFS_BG_WORK_PENDING : KAFS_BG_WORK_PENDING_SHARD1 + shard - 1u;
+}
+
+enum
+{
+  KAFS_BG_LANE_NORMAL = 0,
+  KAFS_BG_LANE_LOW = 1,
+  KAFS_BG_LANES = 2,
+};
+
+typedef struct kafs_bg_work
+{
+  uint32_t w_order; // 期限が同じなら小さい方から
+  /// @return 次に走らせるまでの ms（0: すぐ, KAFS_BG_WAIT_KICK: kick 待ち）
+  uint32_t (*w_run)(void *arg, uint32_t *urgent);
+  void *w_arg;
+  const uint32_t *w_prio_mode; // 望むスケジューリング（KAFS_PENDING_WORKER_PRIO_*、NULL: normal）
+  const int32_t *w_nice;
+  int32_t *w_prio_err; // LOW レーンで当てた結果（NULL 可）
+} kafs_bg_work_t;
+
+typedef struct kafs_bg_item
+{
+  kafs_bg_work_t it_work;
+  uint32_t it_registered;
+  uint32_t it_running;
+  uint32_t it_kicked; // 実行中に kick された: WAIT_KICK を返しても積み直す
+  uint32_t it_urgent;
+  int32_t it_lane; // 入っているヒープ（-1: どこにもない）
+  uint32_t it_heap_idx;
+  uint64_t it_due_ns;
+  uint64_t it_runs;
+  uint64_t it_run_ns;
+  uint64_t it_throttled;
+} kafs_bg_item_t;
+
+struct kafs_bgsched;
+
+typedef struct kafs_bg_thread
+{
+  struct kafs_bgsched *t_s;
+  pthread_t t_tid;
+  uint32_t t_lane;
+  uint32_t t_prio_mode; // このスレッドに当たっている優先度
+  int32_t t_nice;
+} kafs_bg_thread_t;
+
+typedef struct kafs_bgsched
+{
+  pthread_mutex_t s_lock;
+  pthread_cond_t s_cond[KAFS_BG_LANES];
+  pthread_cond_t s_done; // 実行が終わるたびに broadcast（unregister の待ち合わせ）
+  int s_stop;
+  uint32_t s_nthreads; // 起動できたスレッド数（両レーン合計）
+  kafs_bg_thread_t s_threads[KAFS_BG_THREADS_MAX + 1u];
+  kafs_bg_item_t s_items[KAFS_BG_WORK_MAX];
+  uint32_t s_heap[KAFS_BG_LANES][KAFS_BG_WORK_MAX];
+  uint32_t s_heap_len[KAFS_BG_LANES];
+  int (*s_apply_prio)(uint32_t mode, int nice);
+  uint64_t (*s_fg_probe)(void *arg);
+  void *s_fg_arg;
+  uint32_t s_busy_ops;
+  uint32_t s_busy_pct;
+  uint32_t s_fg_busy;
+  uint64_t s_fg_last;
+  uint64_t s_window_start_ns;
+  uint64_t s_window_used_ns;
+  uint64_t s_budget_ns;
+  uint64_t s_stat_windows;
+  uint64_t s_stat_busy_windows;
+} kafs_bgsched_t;
+
+typedef struct kafs_bgsched_stats
+{
+  uint32_t threads;
+  uint32_t fg_busy;
+  uint64_t windows;
+  uint64_t busy_windows;
+  uint64_t runs[KAFS_BG_WORK_MAX];
+  uint64_t run_ns[KAFS_BG_WORK_MAX];
+  uint64_t throttled[KAFS_BG_WORK_MAX];
+} kafs_bgsched_stats_t;
+
+static inline uint64_t kafs_bgsched_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline int kafs_bgsched_before(const kafs_bgsched_t *s, uint32_t a, uint32_t b)
+{
+  const kafs_bg_item_t *x = &s->s_items[a], *y = &s->s_items[b];
+  if (x->it_due_ns != y->it_due_ns)
+    return x->it_due_ns < y->it_due_ns;
+  return x->it_work.w_order < y->it_work.w_order;
+}
+
+static inline void kafs_bgsched_heap_swap(kafs_bgsched_t *s, uint32_t lane, uint32_t i, uint32_t j)
+{
+  uint32_t *h = s->s_heap[lane];
+  uint32_t t = h[i];
+  h[i] = h[j];
+  h[j] = t;
+  s->s_items[h[i]].it_heap_idx = i;
+  s->s_items[h[j]].it_heap_idx = j;
+}
+
+static void kafs_bgsched_heap_fix(kafs_bgsched_t *s, uint32_t lane, uint32_t i)
+{
+  uint32_t *h = s->s_heap[lane];
+  uint32_t n = s->s_heap_len[lane];
+  while (i > 0 && kafs_bgsched_before(s, h[i], h[(i - 1u) / 2u]))
+  {
+    kafs_bgsched_heap_swap(s, lane, i, (i - 1u) / 2u);
+    i = (i - 1u) / 2u;
+  }
+  for (;;)
+  {
+    uint32_t l = 2u * i + 1u, r = l + 1u, m = i;
+    if (l < n && kafs_bgsched_before(s, h[l], h[m]))
+      m = l;
+    if (r < n && kafs_bgsched_before(s, h[r], h[m]))
+      m = r;
+    if (m == i)
+      return;
+    kafs_bgsched_heap_swap(s, lane, i, m);
+    i = m;
+  }
+}
+
+static void kafs_bgsched_heap_remove(kafs_bgsched_t *s, uint32_t id)
+{
+  kafs_bg_item_t *it = &s->s_items[id];
+  if (it->it_lane < 0)
+    return;
+  uint32_t lane = (uint32_t)it->it_lane;
+  uint32_t i = it->it_heap_idx;
+  uint32_t last = --s->s_heap_len[lane];
+  if (i != last)
+  {
+    kafs_bgsched_heap_swap(s, lane, i, last);
+    kafs_bgsched_heap_fix(s, lane, i);
+  }
+  it->it_lane = -1;
+}
+
+/// @brief 項目が望む優先度が normal / nice 0 か
+static inline int kafs_bgsched_wants_normal(const kafs_bg_item_t *it)
+{
+  uint32_t mode = it->it_work.w_prio_mode
+                      ? __atomic_load_n(it->it_work.w_prio_mode, __ATOMIC_RELAXED)
+                      : KAFS_PENDING_WORKER_PRIO_NORMAL;
+  int32_t nice = it->it_work.w_nice ? __atomic_load_n(it->it_work.w_nice, __ATOMIC_RELAXED) : 0;
+  return mode == KAFS_PENDING_WORKER_PRIO_NORMAL && nice == 0;
+}
+
+/// @brief 期限 due で積む（積み済みなら早い方の期限に寄せてレーンも選び直す）。s_lock 保持で呼ぶ。
+static void kafs_bgsched_enqueue_locked(kafs_bgsched_t *s, uint32_t id, uint64_t due,
+                                        uint32_t urgent)
+{
+  kafs_bg_item_t *it = &s->s_items[id];
+  if (it->it_lane >= 0)
+  {
+    if (it->it_due_ns < due)
+      due = it->it_due_ns;
+    urgent |= it->it_urgent;
+    kafs_bgsched_heap_remove(s, id);
+  }
+  uint32_t lane =
+      (urgent || kafs_bgsched_wants_normal(it)) ? KAFS_BG_LANE_NORMAL : KAFS_BG_LANE_LOW;
+  it->it_due_ns = due;
+  it->it_urgent = urgent;
+  it->it_lane = (int32_t)lane;
+  it->it_heap_idx = s->s_heap_len[lane]++;
+  s->s_heap[lane][it->it_heap_idx] = id;
+  kafs_bgsched_heap_fix(s, lane, it->it_heap_idx);
+  pthread_cond_signal(&s->s_cond[lane]);
+}
+
+/// @brief 予算の窓を進める。前景の操作数の増分で次の窓の非 urgent 予算を決める。
+static void kafs_bgsched_roll_window_locked(kafs_bgsched_t *s, uint64_t now)
+{
+  uint64_t elapsed = now - s->s_window_start_ns;
+  if (elapsed < KAFS_BG_WINDOW_NS)
+    return;
+  uint64_t ops = s->s_fg_probe ? s->s_fg_probe(s->s_fg_arg) : 0;
+  uint64_t delta = ops - s->s_fg_last;
+  s->s_fg_last = ops;
+  // 複数窓ぶん空いたときは窓あたりに均す。
+  s->s_fg_busy =
+      s->s_busy_ops > 0 && delta * KAFS_BG_WINDOW_NS >= (uint64_t)s->s_busy_ops * elapsed;
+  s->s_budget_ns = s->s_fg_busy ? KAFS_BG_WINDOW_NS * s->s_busy_pct / 100u : UINT64_MAX;
+  s->s_window_start_ns = now;
+  s->s_window_used_ns = 0;
+  s->s_stat_windows++;
+  if (s->s_fg_busy)
+    s->s_stat_busy_windows++;
+}
+
+static void kafs_bgsched_wait_until_locked(kafs_bgsched_t *s, uint32_t lane, uint64_t due)
+{
+  struct timespec ts = {.tv_sec = (time_t)(due / 1000000000ull),
+                        .tv_nsec = (long)(due % 1000000000ull)};
+  (void)pthread_cond_timedwait(&s->s_cond[lane], &s->s_lock, &ts);
+}
+
+/// @brief LOW レーン: 項目が望む優先度をスレッドに当てる（変わったときだけ）
+static void kafs_bgsched_apply_prio(kafs_bgsched_t *s, kafs_bg_thread_t *t, kafs_bg_item_t *it)
+{
+  if (t->t_lane != KAFS_BG_LANE_LOW || !s->s_apply_prio || !it->it_work.w_prio_mode)
+    return;
+  uint32_t mode = __atomic_load_n(it->it_work.w_prio_mode, __ATOMIC_RELAXED);
+  int32_t nice = it->it_work.w_nice ? __atomic_load_n(it->it_work.w_nice, __ATOMIC_RELAXED) : 0;
+  if (mode == t->t_prio_mode && nice == t->t_nice)
+    return;
+  int err = s->s_apply_prio(mode, nice);
+  if (it->it_work.w_prio_err)
+    __atomic_store_n(it->it_work.w_prio_err, (int32_t)err, __ATOMIC_RELAXED);
+  t->t_prio_mode = mode;
+  t->t_nice = nice;
+}
+
+static void *kafs_bgsched_thread_main(void *arg)
+{
+  kafs_bg_thread_t *t = (kafs_bg_thread_t *)arg;
+  kafs_bgsched_t *s = t->t_s;
+  uint32_t lane = t->t_lane;
+
+  pthread_mutex_lock(&s->s_lock);
+  while (!s->s_stop)
+  {
+    uint64_t now = kafs_bgsched_now_ns();
+    kafs_bgsched_roll_window_locked(s, now);
+    if (s->s_heap_len[lane] == 0)
+    {
+      pthread_cond_wait(&s->s_cond[lane], &s->s_lock);
+      continue;
+    }
+    uint32_t id = s->s_heap[lane][0];
+    kafs_bg_item_t *it = &s->s_items[id];
+    if (it->it_due_ns > now)
+    {
+      kafs_bgsched_wait_until_locked(s, lane, it->it_due_ns);
+      continue;
+    }
+    if (!it->it_urgent && s->s_window_used_ns >= s->s_budget_ns)
+    {
+      // 前景が忙しい窓で予算を使い切った: 次の窓の頭まで後回し。
+      it->it_due_ns = s->s_window_start_ns + KAFS_BG_WINDOW_NS;
+      it->it_throttled++;
+      kafs_bgsched_heap_fix(s, lane, 0);
+      continue;
+    }
+
+    kafs_bgsched_heap_remove(s, id);
+    it->it_running = 1;
+    it->it_kicked = 0;
+    it->it_urgent = 0;
+    pthread_mutex_unlock(&s->s_lock);
+
+    kafs_bgsched_apply_prio(s, t, it);
+    uint32_t urgent = 0;
+    uint64_t t0 = kafs_bgsched_now_ns();
+    uint32_t next_ms = it->it_work.w_run(it->it_work.w_arg, &urgent);
+    uint64_t t1 = kafs_bgsched_now_ns();
+
+    pthread_mutex_lock(&s->s_lock);
+    it->it_running = 0;
+    it->it_runs++;
+    it->it_run_ns += t1 - t0;
+    s->s_window_used_ns += t1 - t0;
+    if (it->it_registered)
+    {
+      if (it->it_kicked)
+      {
+        next_ms = 0;
+        urgent |= it->it_urgent;
+      }
+      if (next_ms != KAFS_BG_WAIT_KICK)
+        kafs_bgsched_enqueue_locked(s, id, t1 + (uint64_t)next_ms * 1000000ull, urgent);
+    }
+    pthread_cond_broadcast(&s->s_done);
+  }
+  pthread_mutex_unlock(&s->s_lock);
+  return NULL;
+}
+
+static void kafs_bgsched_destroy(kafs_bgsched_t *s);
+
+/// @brief 実行器を作ってスレッドを起こす（NORMAL に threads 本、LOW に 1 本）
+/// threads / busy_pct は 0 なら既定値。
+/// @param fg_probe 前景操作の累積数を返す（NULL: 予算なし）
+/// @return 実行器、失敗時は NULL (errno 設定済み)
+static kafs_bgsched_t *kafs_bgsched_create(uint32_t threads, uint32_t busy_pct,
+                                           int (*apply_prio)(uint32_t mode, int nice),
+                                           uint64_t (*fg_probe)(void *arg), void *fg_arg)
+{
+  if (threads == 0)
+    threads = KAFS_BG_THREADS_DEFAULT;
+  if (threads > KAFS_BG_THREADS_MAX)
+    threads = KAFS_BG_THREADS_MAX;
+  if (busy_pct == 0)
+    busy_pct = KAFS_BG_BUSY_PCT_DEFAULT;
+  if (busy_pct > 100u)
+    busy_pct = 100u;
+
+  kafs_bgsched_t *s = (kafs_bgsched_t *)calloc(1, sizeof(*s));
+  if (!s)
+    return NULL;
+  pthread_condattr_t ca;
+  pthread_condattr_init(&ca);
+  pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+  pthread_mutex_init(&s->s_lock, NULL);
+  for (uint32_t l = 0; l < KAFS_BG_LANES; ++l)
+    pthread_cond_init(&s->s_cond[l], &ca);
+  pthread_cond_init(&s->s_done, NULL);
+  pthread_condattr_destroy(&ca);
+  for (uint32_t i = 0; i < KAFS_BG_WORK_MAX; ++i)
+    s->s_items[i].it_lane = -1;
+  s->s_apply_prio = apply_prio;
+  s->s_fg_probe = fg_probe;
+  s->s_fg_arg = fg_arg;
+  s->s_busy_ops = fg_probe ? KAFS_BG_BUSY_OPS_DEFAULT : 0u;
+  s->s_busy_pct = busy_pct;
+  s->s_budget_ns = UINT64_MAX;
+  s->s_window_start_ns = kafs_bgsched_now_ns();
+  s->s_fg_last = fg_probe ? fg_probe(fg_arg) : 0;
+
+  pthread_mutex_lock(&s->s_lock);
+  for (uint32_t i = 0; i <= threads; ++i)
+  {
+    kafs_bg_thread_t *t = &s->s_threads[i];
+    t->t_s = s;
+    t->t_lane = (i == threads) ? KAFS_BG_LANE_LOW : KAFS_BG_LANE_NORMAL;
+    t->t_prio_mode = KAFS_PENDING_WORKER_PRIO_NORMAL;
+    int rc = pthread_create(&t->t_tid, NULL, kafs_bgsched_thread_main, t);
+    if (rc != 0)
+    {
+      pthread_mutex_unlock(&s->s_lock);
+      kafs_bgsched_destroy(s);
+      errno = rc;
+      return NULL;
+    }
+    s->s_nthreads++;
+  }
+  pthread_mutex_unlock(&s->s_lock);
+  return s;
+}
+
+/// @brief スレッドを止めて解放する（実行中の w_run は最後まで走る）
+static void kafs_bgsched_destroy(kafs_bgsched_t *s)
+{
+  if (!s)
+    return;
+  pthread_mutex_lock(&s->s_lock);
+  s->s_stop = 1;
+  for (uint32_t l = 0; l < KAFS_BG_LANES; ++l)
+    pthread_cond_broadcast(&s->s_cond[l]);
+  pthread_mutex_unlock(&s->s_lock);
+  for (uint32_t i = 0; i < s->s_nthreads; ++i)
+    pthread_join(s->s_threads[i].t_tid, NULL);
+  for (uint32_t l = 0; l < KAFS_BG_LANES; ++l)
+    pthread_cond_destroy(&s->s_cond[l]);
+  pthread_cond_destroy(&s->s_done);
+  pthread_mutex_destroy(&s->s_lock);
+  free(s);
+}
+
+/// @brief 項目を登録してすぐ走らせる
+/// @return 0: 成功, -EINVAL: id 範囲外, -EBUSY: 登録済み
+static int kafs_bgsched_register(kafs_bgsched_t *s, uint32_t id, const kafs_bg_work_t *w)
+{
+  if (!s || !w || !w->w_run || id >= KAFS_BG_WORK_MAX)
+    return -EINVAL;
+  pthread_mutex_lock(&s->s_lock);
+  kafs_bg_item_t *it = &s->s_items[id];
+  if (it->it_registered)
+  {
+    pthread_mutex_unlock(&s->s_lock);
+    return -EBUSY;
+  }
+  it->it_work = *w;
+  it->it_registered = 1;
+  kafs_bgsched_enqueue_locked(s, id, kafs_bgsched_now_ns(), 0);
+  pthread_mutex_unlock(&s->s_lock);
+  return 0;
+}
+
+/// @brief 登録を外す。実行中なら終わるまで待つので、戻った後は w_arg を片付けてよい。
+static void kafs_bgsched_unregister(kafs_bgsched_t *s, uint32_t id)
+{
+  if (!s || id >= KAFS_BG_WORK_MAX)
+    return;
+  pthread_mutex_lock(&s->s_lock);
+  kafs_bg_item_t *it = &s->s_items[id];
+  it->it_registered = 0;
+  kafs_bgsched_heap_remove(s, id);
+  while (it->it_running)
+    pthread_cond_wait(&s->s_done, &s->s_lock);
+  it->it_kicked = 0;
+  it->it_urgent = 0;
+  pthread_mutex_unlock(&s->s_lock);
+}
+
+/// @brief 登録中の項目数
+static inline uint32_t kafs_bgsched_registered(kafs_bgsched_t *s)
+{
+  uint32_t n = 0;
+  pthread_mutex_lock(&s->s_lock);
+  for (uint32_t i = 0; i < KAFS_BG_WORK_MAX; ++i)
+    n += s->s_items[i].it_registered ? 1u : 0u;
+  pthread_mutex_unlock(&s->s_lock);
+  return n;
+}
+
+/// @brief 期限はそのままでレーンだけ選び直す（望む優先度が変わったとき）
+static void kafs_bgsched_reprio(kafs_bgsched_t *s, uint32_t id)
+{
+  if (!s || id >= KAFS_BG_WORK_MAX)
+    return;
+  pthread_mutex_lock(&s->s_lock);
+  kafs_bg_item_t *it = &s->s_items[id];
+  if (it->it_lane >= 0)
+    kafs_bgsched_enqueue_locked(s, id, it->it_due_ns, it->it_urgent);
+  pthread_mutex_unlock(&s->s_lock);
+}
+
+/// @brief 項目を今すぐ走らせる（urgent: 予算を無視して NORMAL レーンで）
+static void kafs_bgsched_kick(kafs_bgsched_t *s, uint32_t id, uint32_t urgent)
+{
+  if (!s || id >= KAFS_BG_WORK_MAX)
+    return;
+  pthread_mutex_lock(&s->s_lock);
+  kafs_bg_item_t *it = &s->s_items[id];
+  if (it->it_registered)
+  {
+    if (it->it_running)
+    {
+      it->it_kicked = 1;
+      it->it_urgent |= urgent;
+    }
+    else
+      kafs_bgsched_enqueue_locked(s, id, kafs_bgsched_now_ns(), urgent);
+  }
+  pthread_mutex_unlock(&s->s_lock);
+}
+
+static void kafs_bgsched_stats_get(kafs_bgsched_t *s, kafs_bgsched_stats_t *out)
+{
+  memset(out, 0, sizeof(*out));
+  if (!s)
+    return;
+  pthread_mutex_lock(&s->s_lock);
+  out->threads = s->s_nthreads;
+  out->fg_busy = s->s_fg_busy;
+  out->windows = s->s_stat_windows;
+  out->busy_windows = s->s_stat_busy_windows;
+  for (uint32_t i = 0; i < KAFS_BG_WORK_MAX; ++i)
+  {
+    out->runs[i] = s->s_items[i].it_runs;
+    out->run_ns[i] = s->s_items[i].it_run_ns;
+    out->throttled[i] = s->s_items[i].it_throttled;
+  }
+  pthread_mutex_unlock(&s->s_lock);
+}
@@ -902,7 +902,7 @@ static void kafs_blk_account_bit_update(struct kafs_context *ctx, const kafs_bit
   if (ref->count_block_bitmap_write)
     kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_BLOCK_BITMAP, sizeof(*ref->word_ptr));
   uint64_t t_bit1 = kafs_blk_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_blk_set_usage_ns_bit_update, t_bit1 - t_bit0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_NS_BIT_UPDATE, t_bit1 - t_bit0);
 }
 
 static void kafs_blk_account_meta_update(struct kafs_context *ctx, kafs_ssuperblock_t *sb,
@@ -929,8 +929,7 @@ static void kafs_blk_account_meta_update(struct kafs_context *ctx, kafs_ssuperbl
                               sizeof(sb->s_blkcnt_free));
   }
   uint64_t t_free1 = kafs_blk_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_blk_set_usage_ns_freecnt_update, t_free1 - t_free0,
-                     __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_NS_FREECNT_UPDATE, t_free1 - t_free0);
 
   uint64_t t_wtime0 = kafs_blk_now_ns();
   if (ctx->c_meta_delta_enabled)
@@ -943,8 +942,7 @@ static void kafs_blk_account_meta_update(struct kafs_context *ctx, kafs_ssuperbl
     kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_SUPERBLOCK_CHECKPOINT, sizeof(sb->s_wtime));
   }
   uint64_t t_wtime1 = kafs_blk_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_blk_set_usage_ns_wtime_update, t_wtime1 - t_wtime0,
-                     __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_NS_WTIME_UPDATE, t_wtime1 - t_wtime0);
 
   if (kafs_alloc_v3_summary_sync_one(ctx, blo) < 0)
     ctx->c_alloc_v3_summary_dirty = 1u;
@@ -973,10 +971,10 @@ static int kafs_blk_set_usage_nolock(struct kafs_context *ctx, kafs_blkcnt_t blo
 
   kafs_blkmask_t word = ref.word;
   int was_used = (word & ref.bit) != 0;
-  __atomic_add_fetch(&ctx->c_stat_blk_set_usage_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_CALLS, 1u);
   if (usage == KAFS_TRUE)
   {
-    __atomic_add_fetch(&ctx->c_stat_blk_set_usage_alloc_calls, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_ALLOC_CALLS, 1u);
     if (!was_used)
     {
       word |= ref.bit;
@@ -986,7 +984,7 @@ static int kafs_blk_set_usage_nolock(struct kafs_context *ctx, kafs_blkcnt_t blo
   }
   else
   {
-    __atomic_add_fetch(&ctx->c_stat_blk_set_usage_free_calls, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_FREE_CALLS, 1u);
     if (was_used)
     {
       word &= (kafs_blkmask_t)~ref.bit;
@@ -1041,8 +1039,8 @@ static int kafs_blk_try_claim_nolock(struct kafs_context *ctx, kafs_blkcnt_t blo
   if ((word & ref.bit) != 0)
     return 0;
 
-  __atomic_add_fetch(&ctx->c_stat_blk_set_usage_calls, 1u, __ATOMIC_RELAXED);
-  __atomic_add_fetch(&ctx->c_stat_blk_set_usage_alloc_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_CALLS, 1u);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_SET_USAGE_ALLOC_CALLS, 1u);
 
   word |= ref.bit;
   kafs_blk_account_bit_update(ctx, &ref, word);
@@ -1059,12 +1057,12 @@ static int kafs_blk_claim_candidate(struct kafs_context *ctx, kafs_blkcnt_t cand
   uint64_t t_set0 = kafs_blk_now_ns();
   int claimed = kafs_blk_try_claim_nolock(ctx, candidate);
   uint64_t t_set1 = kafs_blk_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_set_usage, t_set1 - t_set0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_SET_USAGE, t_set1 - t_set0);
   if (claimed < 0)
   {
     kafs_bitmap_unlock(ctx);
     uint64_t t_claim1 = kafs_blk_now_ns();
-    __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_claim, t_claim1 - t_claim0, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_CLAIM, t_claim1 - t_claim0);
     return claimed;
   }
   if (claimed > 0)
@@ -1073,13 +1071,13 @@ static int kafs_blk_claim_candidate(struct kafs_context *ctx, kafs_blkcnt_t cand
     *pblo = candidate;
     kafs_bitmap_unlock(ctx);
     uint64_t t_claim1 = kafs_blk_now_ns();
-    __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_claim, t_claim1 - t_claim0, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_CLAIM, t_claim1 - t_claim0);
     return 1;
   }
   kafs_bitmap_unlock(ctx);
   uint64_t t_claim1 = kafs_blk_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_claim, t_claim1 - t_claim0, __ATOMIC_RELAXED);
-  __atomic_add_fetch(&ctx->c_stat_blk_alloc_claim_retries, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_CLAIM, t_claim1 - t_claim0);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_CLAIM_RETRIES, 1u);
   return 0;
 }
 
@@ -1108,7 +1106,7 @@ static int kafs_blk_alloc_prepare(struct kafs_context *ctx, kafs_blkcnt_t *pblo,
   assert(pblo != NULL);
   assert(*pblo == KAFS_BLO_NONE);
 
-  __atomic_add_fetch(&ctx->c_stat_blk_alloc_calls, 1u, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_CALLS, 1u);
 
   *out_blocnt = kafs_sb_blkcnt_get(ctx->c_superblock);
   *out_fdb = kafs_sb_first_data_block_get(ctx->c_superblock);
@@ -1163,8 +1161,7 @@ static int kafs_blk_alloc_legacy(struct kafs_context *ctx, kafs_blkcnt_t *pblo)
       if (blo_found >= fdb && blo_found < blocnt)
       {
         uint64_t t_scan_stop = kafs_blk_now_ns();
-        __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_scan, t_scan_stop - t_scan_start,
-                           __ATOMIC_RELAXED);
+        kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_SCAN, t_scan_stop - t_scan_start);
 
         int claim_rc = kafs_blk_claim_candidate(ctx, blo_found, pblo);
         if (claim_rc < 0)
@@ -1178,7 +1175,7 @@ static int kafs_blk_alloc_legacy(struct kafs_context *ctx, kafs_blkcnt_t *pblo)
   }
 
   uint64_t t_scan_end = kafs_blk_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_scan, t_scan_end - t_scan_start, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_SCAN, t_scan_end - t_scan_start);
 
   return -ENOSPC;
 }
@@ -1389,14 +1386,12 @@ static int kafs_blk_alloc_v3(struct kafs_context *ctx, kafs_blkcnt_t *pblo)
     if (!found)
     {
       uint64_t t_scan_end = kafs_blk_now_ns();
-      __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_scan, t_scan_end - t_scan_start,
-                         __ATOMIC_RELAXED);
+      kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_SCAN, t_scan_end - t_scan_start);
       return -ENOSPC;
     }
 
     uint64_t t_scan_stop = kafs_blk_now_ns();
-    __atomic_add_fetch(&ctx->c_stat_blk_alloc_ns_scan, t_scan_stop - t_scan_start,
-                       __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_BLK_ALLOC_NS_SCAN, t_scan_stop - t_scan_start);
 
     int claim_rc = kafs_blk_claim_candidate(ctx, candidate, pblo);
     if (claim_rc < 0)
@@ -0,0 +1,188 @@
+#pragma once
+#include "kafs.h"
+#include "kafs_lz.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+// 圧縮データブロックのコンテナ（KAFS_FEATURE_COMPRESS）。
+// ファイルデータのブロックを kafs_lz で圧縮し、縮んだものだけを tailmeta のスロットコンテナと
+// 同じ要領で 1 ブロックのコンテナに詰める。コンテナはヘッダ・スロット表・圧縮データの順で、
+// 圧縮データは tail に追記するだけ（解放したスロットの穴は詰め直さない）。生きたスロットが
+// 無くなったらコンテナのブロックごと解放する。
+// データ参照は 32bit のまま、圧縮ブロックを次の形で表す（pending 参照の最上位 bit と重ならない）。
+//   bit 31: 0, bit 30: 1, bit 4-29: コンテナのブロック番号, bit 0-3: スロット
+// なのでコンテナに使えるのは KAFS_CBLK_REF_BLO_LIMIT 未満のブロックだけ（mkfs で確かめる）。
+// HRL の重複判定は展開した内容で行うので、圧縮の有無で dedup の結果は変わらない。
+// 参照の解放・読み出しは kafs_hrl.c（ブロックの解放経路が HRL と同じなので）で実装する。
+
+#define KAFS_CBLK_MAGIC 0x4B43424Bu /* 'KCBK' */
+#define KAFS_CBLK_VERSION 1u
+#define KAFS_CBLK_SLOTS 16u
+#define KAFS_CBLK_REF_FLAG 0x40000000u
+#define KAFS_CBLK_REF_KIND_MASK 0xC0000000u
+#define KAFS_CBLK_REF_SLOT_BITS 4u
+#define KAFS_CBLK_REF_BLO_LIMIT (1u << 26)
+
+struct kafs_scblk_slot
+{
+  kafs_su32_t cs_off; // コンテナ先頭からのオフセット
+  kafs_su32_t cs_len; // 圧縮後のバイト数（0: 解放済み）
+} __attribute__((packed));
+
+struct kafs_scblk_hdr
+{
+  kafs_su32_t cb_magic;
+  uint16_t cb_version;
+  uint16_t cb_slot_count; // 追記したスロット数（解放済みを含む）
+  uint16_t cb_live_count;
+  uint16_t cb_reserved0;
+  kafs_su32_t cb_generation; // 確保ごとに変わる（展開キャッシュの照合用）
+  kafs_su32_t cb_tail;       // 次の圧縮データを置くオフセット
+  struct kafs_scblk_slot cb_slots[KAFS_CBLK_SLOTS];
+} __attribute__((packed));
+
+typedef struct kafs_scblk_hdr kafs_cblk_hdr_t;
+
+static inline int kafs_cblk_ref_is(kafs_blkcnt_t ref)
+{
+  return ((uint32_t)ref & KAFS_CBLK_REF_KIND_MASK) == KAFS_CBLK_REF_FLAG;
+}
+
+static inline kafs_blkcnt_t kafs_cblk_ref_make(kafs_blkcnt_t blo, uint32_t slot)
+{
+  return (kafs_blkcnt_t)(KAFS_CBLK_REF_FLAG | ((uint32_t)blo << KAFS_CBLK_REF_SLOT_BITS) | slot);
+}
+
+static inline kafs_blkcnt_t kafs_cblk_ref_blo(kafs_blkcnt_t ref)
+{
+  return (kafs_blkcnt_t)(((uint32_t)ref & ~KAFS_CBLK_REF_KIND_MASK) >> KAFS_CBLK_REF_SLOT_BITS);
+}
+
+static inline uint32_t kafs_cblk_ref_slot(kafs_blkcnt_t ref)
+{
+  return (uint32_t)ref & (KAFS_CBLK_SLOTS - 1u);
+}
+
+/// @brief データ参照が実際に占める物理ブロック（圧縮ならコンテナ、それ以外はそのまま）
+static inline kafs_blkcnt_t kafs_cblk_phys_blo(kafs_blkcnt_t ref)
+{
+  return kafs_cblk_ref_is(ref) ? kafs_cblk_ref_blo(ref) : ref;
+}
+
+/// @brief 生のブロックをブロックキャッシュに置くときのキー（圧縮参照と同じ上位 bit を持つ
+/// 番号は 0 を返し、キャッシュしない）
+static inline uint32_t kafs_cblk_raw_cache_key(kafs_blkcnt_t blo)
+{
+  return ((uint32_t)blo & KAFS_CBLK_REF_KIND_MASK) ? 0u : (uint32_t)blo;
+}
+
+/// @brief 圧縮して格納する上限（1/4 以上縮まないブロックは生のまま書く）
+static inline uint32_t kafs_cblk_payload_cap(kafs_blksize_t bs)
+{
+  uint32_t cap = (uint32_t)bs - (uint32_t)bs / 4u;
+  uint32_t room = (uint32_t)bs > sizeof(kafs_cblk_hdr_t) ? (uint32_t)bs - sizeof(kafs_cblk_hdr_t)
+                                                          : 0u;
+  return cap < room ? cap : room;
+}
+
+static inline void kafs_cblk_init(void *blk, kafs_blksize_t bs, uint32_t generation)
+{
+  memset(blk, 0, bs);
+  kafs_cblk_hdr_t *h = (kafs_cblk_hdr_t *)blk;
+  h->cb_magic = kafs_u32_htos(KAFS_CBLK_MAGIC);
+  h->cb_version = KAFS_CBLK_VERSION;
+  h->cb_generation = kafs_u32_htos(generation);
+  h->cb_tail = kafs_u32_htos((uint32_t)sizeof(kafs_cblk_hdr_t));
+}
+
+static inline int kafs_cblk_valid(const void *blk, kafs_blksize_t bs)
+{
+  const kafs_cblk_hdr_t *h = (const kafs_cblk_hdr_t *)blk;
+  uint32_t tail = kafs_u32_stoh(h->cb_tail);
+  return kafs_u32_stoh(h->cb_magic) == KAFS_CBLK_MAGIC && h->cb_version == KAFS_CBLK_VERSION &&
+         h->cb_slot_count <= KAFS_CBLK_SLOTS && h->cb_live_count <= h->cb_slot_count &&
+         tail >= sizeof(kafs_cblk_hdr_t) && tail <= bs;
+}
+
+static inline uint32_t kafs_cblk_generation(const void *blk)
+{
+  return kafs_u32_stoh(((const kafs_cblk_hdr_t *)blk)->cb_generation);
+}
+
+/// @brief 圧縮データを追記する
+/// @return 使ったスロット番号, -ENOSPC: スロットか領域が足りない
+static inline int kafs_cblk_append(void *blk, kafs_blksize_t bs, const void *payload, uint32_t len)
+{
+  kafs_cblk_hdr_t *h = (kafs_cblk_hdr_t *)blk;
+  uint32_t tail = kafs_u32_stoh(h->cb_tail);
+  if (len == 0 || h->cb_slot_count >= KAFS_CBLK_SLOTS || tail > bs || bs - tail < len)
+    return -ENOSPC;
+  uint32_t slot = h->cb_slot_count;
+  memcpy((char *)blk + tail, payload, len);
+  h->cb_slots[slot].cs_off = kafs_u32_htos(tail);
+  h->cb_slots[slot].cs_len = kafs_u32_htos(len);
+  h->cb_tail = kafs_u32_htos(tail + len);
+  h->cb_slot_count = (uint16_t)(slot + 1u);
+  h->cb_live_count++;
+  return (int)slot;
+}
+
+/// @brief 生きたスロットの圧縮データの位置を得る
+/// @return 0: 成功, -ENOENT: 解放済み, -EIO: コンテナかスロットが壊れている
+static inline int kafs_cblk_slot_get(const void *blk, kafs_blksize_t bs, uint32_t slot,
+                                     uint32_t *off, uint32_t *len)
+{
+  const kafs_cblk_hdr_t *h = (const kafs_cblk_hdr_t *)blk;
+  if (!kafs_cblk_valid(blk, bs) || slot >= h->cb_slot_count)
+    return -EIO;
+  uint32_t o = kafs_u32_stoh(h->cb_slots[slot].cs_off);
+  uint32_t l = kafs_u32_stoh(h->cb_slots[slot].cs_len);
+  if (l == 0)
+    return -ENOENT;
+  if (o < sizeof(kafs_cblk_hdr_t) || o > bs || bs - o < l)
+    return -EIO;
+  *off = o;
+  *len = l;
+  return 0;
+}
+
+/// @brief スロットを展開して 1 ブロック分を out に書く
+/// @return 0: 成功, -ENOENT: 解放済み, -EIO: 壊れている
+static inline int kafs_cblk_decode(const void *blk, kafs_blksize_t bs, uint32_t slot, void *out)
+{
+  uint32_t off = 0, len = 0;
+  int rc = kafs_cblk_slot_get(blk, bs, slot, &off, &len);
+  if (rc != 0)
+    return rc;
+  size_t got = 0;
+  if (kafs_lz_decompress((const char *)blk + off, len, out, bs, &got) != 0 || got != bs)
+    return -EIO;
+  return 0;
+}
+
+/// @brief スロットを解放する
+/// @return 残りの生きたスロット数, -ENOENT: 解放済み, -EIO: 壊れている
+static inline int kafs_cblk_slot_free(void *blk, kafs_blksize_t bs, uint32_t slot)
+{
+  uint32_t off = 0, len = 0;
+  int rc = kafs_cblk_slot_get(blk, bs, slot, &off, &len);
+  if (rc != 0)
+    return rc;
+  kafs_cblk_hdr_t *h = (kafs_cblk_hdr_t *)blk;
+  if (h->cb_live_count == 0)
+    return -EIO;
+  h->cb_slots[slot].cs_len = kafs_u32_htos(0);
+  h->cb_live_count--;
+  return (int)h->cb_live_count;
+}
+
+struct kafs_context;
+
+// kafs_hrl.c
+/// @brief ブロックを圧縮してコンテナに格納する
+/// @return 0: *out_ref に圧縮参照, -ENOTSUP: 圧縮が無効, -E2BIG: 縮まない（生で書く）, < 0: 失敗
+int kafs_cblk_store(struct kafs_context *ctx, const void *buf, kafs_blkcnt_t *out_ref);
+/// @brief 圧縮参照を展開して読む（ブロックキャッシュ kafs_bcache.h を通す）
+int kafs_cblk_read(struct kafs_context *ctx, kafs_blkcnt_t ref, void *buf);
@@ -6,6 +6,7 @@
 #include "kafs_hotplug.h"
 #include "kafs_meta_region.h"
 #include "kafs_profile.h"
+#include "kafs_stats_shard.h"
 #include <pthread.h>
 #include <stdlib.h>
 #include <sys/un.h>
@@ -40,6 +41,16 @@ typedef struct kafs_v6_hrl_runtime_shard
   uint32_t group_id;
 } kafs_v6_hrl_runtime_shard_t;
 
+// 圧縮コンテナの追記口の数（スレッドごとに振り分け、それぞれ cblk ストライプのロックで守る）
+#define KAFS_CBLK_STRIPES 8u
+
+/// @brief 追記中の圧縮コンテナ（kafs_cblk.h）。中身をメモリに持ち、追記のたびに読み直さない。
+typedef struct kafs_cblk_open
+{
+  kafs_blkcnt_t co_blo; // 追記中のコンテナ（KAFS_BLO_NONE: 無し）。ロック無しでも読む
+  char *co_buf;         // 最後に書いたコンテナの中身（初回に確保、kafs_hrl_close で解放）
+} __attribute__((aligned(64))) kafs_cblk_open_t;
+
 /// @brief コンテキスト
 struct kafs_context
 {
@@ -78,78 +89,16 @@ struct kafs_context
   void *c_journal; // opaque pointer to journal state (kafs_journal_t*)
 
   // --- Runtime stats (best-effort) ---
-  uint64_t c_stat_hrl_put_calls;
-  uint64_t c_stat_hrl_put_hits;
-  uint64_t c_stat_hrl_put_misses;
-  uint64_t c_stat_hrl_put_fallback_legacy;
-  uint64_t c_stat_hrl_put_ns_hash;
-  uint64_t c_stat_hrl_put_ns_find;
-  uint64_t c_stat_hrl_put_ns_cmp_content;
-  uint64_t c_stat_hrl_put_ns_slot_alloc;
-  uint64_t c_stat_hrl_put_ns_blk_alloc;
-  uint64_t c_stat_hrl_put_ns_blk_write;
-  uint64_t c_stat_hrl_put_chain_steps;
-  uint64_t c_stat_hrl_put_cmp_calls;
-  uint64_t c_stat_hrl_rescue_attempts;
-  uint64_t c_stat_hrl_rescue_hits;
-  uint64_t c_stat_hrl_rescue_evicts;
-
-  uint64_t c_stat_lock_hrl_bucket_acquire;
-  uint64_t c_stat_lock_hrl_bucket_contended;
-  uint64_t c_stat_lock_hrl_bucket_wait_ns;
-  uint64_t c_stat_lock_hrl_global_acquire;
-  uint64_t c_stat_lock_hrl_global_contended;
-  uint64_t c_stat_lock_hrl_global_wait_ns;
-  uint64_t c_stat_lock_bitmap_acquire;
-  uint64_t c_stat_lock_bitmap_contended;
-  uint64_t c_stat_lock_bitmap_wait_ns;
-  uint64_t c_stat_lock_inode_acquire;
-  uint64_t c_stat_lock_inode_contended;
-  uint64_t c_stat_lock_inode_wait_ns;
-  uint64_t c_stat_lock_inode_alloc_acquire;
-  uint64_t c_stat_lock_inode_alloc_contended;
-  uint64_t c_stat_lock_inode_alloc_wait_ns;
-
-  uint64_t c_stat_access_calls;
-  uint64_t c_stat_access_path_walk_calls;
-  uint64_t c_stat_access_fh_fastpath_hits;
-  uint64_t c_stat_access_path_components;
-  uint64_t c_stat_dir_snapshot_calls;
-  uint64_t c_stat_dir_snapshot_bytes;
-  uint64_t c_stat_dir_snapshot_meta_load_calls;
-  uint64_t c_stat_dirent_view_next_calls;
-
-  uint64_t c_stat_pwrite_calls;
-  uint64_t c_stat_pwrite_bytes;
-  uint64_t c_stat_pwrite_ns_iblk_read;
-  uint64_t c_stat_pwrite_ns_iblk_write;
+  // Hot-path counters are sharded per thread (see kafs_stats_shard.h); use kafs_stat_add/sum.
+  kafs_stat_shard_t *c_stat_shards; // NULL: count into c_stat_fallback
+  uint32_t c_stat_shard_mask;
+  uint64_t c_stat_fallback[KAFS_STAT_COUNT];
+
   uint64_t c_stat_pwrite_iblk_write_sample_seq;
   uint32_t c_stat_pwrite_iblk_write_sample_count;
   uint32_t c_stat_pwrite_iblk_write_sample_cap;
   uint64_t c_stat_pwrite_iblk_write_samples[1024];
-  uint64_t c_stat_iblk_write_ns_hrl_put;
-  uint64_t c_stat_iblk_write_ns_legacy_blk_write;
-  uint64_t c_stat_iblk_write_ns_dec_ref;
-
-  uint64_t c_stat_blk_alloc_calls;
-  uint64_t c_stat_blk_alloc_claim_retries;
-  uint64_t c_stat_blk_alloc_ns_scan;
-  uint64_t c_stat_blk_alloc_ns_claim;
-  uint64_t c_stat_blk_alloc_ns_set_usage;
-
-  uint64_t c_stat_blk_set_usage_calls;
-  uint64_t c_stat_blk_set_usage_alloc_calls;
-  uint64_t c_stat_blk_set_usage_free_calls;
-  uint64_t c_stat_blk_set_usage_ns_bit_update;
-  uint64_t c_stat_blk_set_usage_ns_freecnt_update;
-  uint64_t c_stat_blk_set_usage_ns_wtime_update;
-
-  // copy_file_range fast path stats (best-effort)
-  uint64_t c_stat_copy_share_attempt_blocks;
-  uint64_t c_stat_copy_share_done_blocks;
-  uint64_t c_stat_copy_share_fallback_blocks;
-  uint64_t c_stat_copy_share_skip_unaligned;
-  uint64_t c_stat_copy_share_skip_dst_inline;
+
   uint64_t c_stat_bg_dedup_replacements;
   uint64_t c_stat_bg_dedup_evicts;
   uint64_t c_stat_bg_dedup_retries;
@@ -166,6 +115,7 @@ struct kafs_context
   uint64_t c_stat_pending_worker_main_entries;
   uint64_t c_stat_pending_worker_main_exits;
   uint64_t c_stat_pending_resolved;
+  uint64_t c_stat_pending_resolved_ahead; // resolved while an older entry was still unresolved
   uint64_t c_stat_pending_old_block_freed;
   uint64_t c_stat_trim_issued;
   uint64_t c_stat_trim_failed;
@@ -218,6 +168,11 @@ struct kafs_context
   kafs_v6_hrl_runtime_shard_t *c_v6_hrl_entry_shards;
   uint32_t c_v6_hrl_entry_shard_count;
 
+  // --- Background executor for pending / tombstone GC / bg dedup (see kafs_bgsched.h) ---
+  struct kafs_bgsched *c_bgsched; // created on the first registration, freed with the last
+  uint32_t c_bg_threads;          // normal-lane threads (0: default)
+  uint32_t c_bg_busy_pct;         // share of a budget window left to background under load
+
   // --- Phase3 pending log runtime state ---
   uint32_t c_pendinglog_enabled;
   void *c_pendinglog_base;
@@ -225,13 +180,12 @@ struct kafs_context
   uint32_t c_pendinglog_capacity;
   uint32_t c_pendinglog_capacity_min;
   uint32_t c_pendinglog_capacity_max;
-  pthread_t c_pending_worker_tid;
-  pthread_mutex_t c_pending_worker_lock;
+  pthread_mutex_t c_pending_worker_lock; // pending log の更新と drain 待ち
   pthread_cond_t c_pending_worker_cond;
   int c_pending_worker_lock_init;
-  int c_pending_worker_running;
+  int c_pending_worker_running; // 実行器に登録済み
   int c_pending_worker_stop;
-  uint32_t c_pending_worker_backoff_ms;
+  uint32_t c_pending_worker_urgent; // 高水位 / soft TTL 超過: 前景予算を無視して回す
   uint32_t c_pending_worker_prio_mode;
   int32_t c_pending_worker_nice;
   uint32_t c_pending_worker_prio_base_mode;
@@ -243,16 +197,19 @@ struct kafs_context
   uint32_t c_pending_ttl_over_soft;
   uint32_t c_pending_ttl_over_hard;
   int32_t c_pending_worker_prio_apply_error;
-  uint32_t c_pending_worker_prio_dirty;
+  uint32_t c_pending_workers;                  // resolver shards (ino % n), fixed at mount
+  struct kafs_pending_shard *c_pending_shards; // per-shard cursor, while registered
 
   // --- Logical delete / tombstone GC runtime state ---
-  pthread_t c_tombstone_gc_worker_tid;
-  pthread_mutex_t c_tombstone_gc_worker_lock;
-  pthread_cond_t c_tombstone_gc_worker_cond;
-  int c_tombstone_gc_worker_lock_init;
   int c_tombstone_gc_worker_running;
-  int c_tombstone_gc_worker_stop;
-  uint32_t c_tombstone_gc_cursor;
+  uint32_t c_tombstone_gc_cursor;      // next inode for the mount-time sweep
+  struct kafs_reclaimq *c_reclaimq;    // tombstones waiting for GC (NULL: not tracked)
+  uint32_t c_tombstone_sweep;          // 1: queue still being rebuilt from the inode table
+  uint32_t c_tombstone_sweep_left;     // tombstones the sweep still expects (UINT32_MAX: unknown)
+  uint32_t c_tombstone_untracked;      // a tombstone missed the queue: leave the hint unknown
+  uint64_t c_stat_tombstone_reclaimed; // tombstones reclaimed on any path
+  uint64_t c_stat_tombstone_gc_visits; // queue entries the GC looked at
+  uint64_t c_stat_tombstone_sweep_scanned;
 
   // --- Idle background dedup scan runtime config ---
   uint32_t c_bg_dedup_enabled;
@@ -261,19 +218,13 @@ struct kafs_context
   uint32_t c_bg_dedup_pressure_interval_ms;
   uint32_t c_bg_dedup_start_used_pct;
   uint32_t c_bg_dedup_pressure_used_pct;
-  pthread_t c_bg_dedup_worker_tid;
-  pthread_mutex_t c_bg_dedup_worker_lock;
-  pthread_cond_t c_bg_dedup_worker_cond;
-  int c_bg_dedup_worker_lock_init;
   int c_bg_dedup_worker_running;
-  int c_bg_dedup_worker_stop;
   uint32_t c_bg_dedup_worker_prio_mode;
   int32_t c_bg_dedup_worker_nice;
   uint32_t c_bg_dedup_worker_prio_base_mode;
   int32_t c_bg_dedup_worker_nice_base;
   uint32_t c_bg_dedup_worker_auto_boosted;
   int32_t c_bg_dedup_worker_prio_apply_error;
-  uint32_t c_bg_dedup_worker_prio_dirty;
   uint32_t c_bg_dedup_mode;
   uint32_t c_bg_dedup_telemetry_valid;
   uint64_t c_bg_dedup_last_scanned_blocks;
@@ -291,6 +242,34 @@ struct kafs_context
   uint32_t c_bg_dedup_anchor_advance_count;
   uint64_t c_bg_dedup_cooldown_until_ns;
   uint32_t c_bg_dedup_prng;
+  struct kafs_dedup_log *c_bg_dedup_log; // direct blocks written since bg dedup last looked
+  uint32_t c_bg_dedup_sweep;             // 1: inode-table sweep owed (unknown history or overflow)
+  uint32_t c_bg_dedup_untracked;         // a hotplug back wrote outside the log: hint stays unknown
+  uint64_t c_stat_bg_dedup_log_consumed; // log entries bg dedup examined
+  uint64_t c_stat_bg_dedup_log_stale;    // entries whose block was rewritten before bg dedup came
+  uint64_t c_stat_bg_dedup_sweeps;       // completed inode-table sweeps
+
+  // --- Per-inode dedup bypass (kafs_dedup_policy.h) ---
+  uint32_t c_dedup_bypass_sample;      // HRL results per decision window (0: policy off)
+  uint32_t c_dedup_bypass_hit_pct;     // bypass when the window hit rate is below this
+  uint64_t c_stat_dedup_bypass_probes; // bypassed inodes' blocks sent to HRL as a probe
+  uint64_t c_stat_dedup_bypass_enter;  // windows that switched an inode to bypass
+  uint64_t c_stat_dedup_bypass_leave;  // hits while bypassing that put an inode back to sampling
+  uint64_t c_stat_dedup_bypass_keep;   // windows that kept an inode on HRL
+
+  // --- Compressed data blocks (kafs_cblk.h) ---
+  uint32_t c_cblk_enabled;               // store new file blocks compressed (feature + compress=on)
+  kafs_cblk_open_t c_cblk_open[KAFS_CBLK_STRIPES]; // open containers, one per cblk stripe
+  uint32_t c_cblk_generation;            // last container generation handed out
+  uint64_t c_stat_cblk_stored;           // blocks stored compressed
+  uint64_t c_stat_cblk_raw;              // blocks that did not shrink enough and went raw
+  uint64_t c_stat_cblk_bytes_out;        // compressed bytes stored
+  uint64_t c_stat_cblk_containers;       // containers allocated
+  uint64_t c_stat_cblk_containers_freed; // containers freed when their last slot went
+
+  // --- Block cache (kafs_bcache.h) ---
+  struct kafs_bcache *c_bcache; // decoded blocks by data ref, raw by blo (NULL: off)
+  uint32_t c_blk_cache_mb;      // budget requested with -o blk_cache_mb
 
   uint32_t c_bg_dedup_idx_count;
   uint32_t c_bg_dedup_idx_next_insert;
@@ -306,12 +285,52 @@ struct kafs_context
   uint64_t c_hrl_rescue_recent_fast[64];
   uint32_t c_hrl_rescue_recent_blo[64];
 
+  // --- Per-inode preallocation windows (in-memory only, see kafs_prealloc.h) ---
+  uint32_t c_prealloc_blocks;      // blocks reserved per window refill (<= 1: disabled)
+  void *c_prealloc_windows;        // kafs_prealloc_window_t[KAFS_PREALLOC_WINDOW_SLOTS]
+  uint64_t c_prealloc_outstanding; // reserved blocks not yet consumed
+  pthread_mutex_t c_prealloc_lock;
+
   // fsync/fdatasync behavior policy
   uint32_t c_fsync_policy;
 
+  // --- Dirty-range tracking for ranged fsync (in-memory only, see kafs_dirty.h) ---
+  uint32_t c_fsync_ranged;    // requested at mount; tracking is live while c_dirty_tbl != NULL
+  uint32_t c_dirty_full;      // tracking overflowed: the next fsync syncs the whole image
+  uint32_t c_dirty_meta_mask; // bit per kafs_meta_region_id written since the last sync
+  void *c_dirty_tbl;          // kafs_dirty_table_t
+  pthread_mutex_t c_dirty_lock;
+  uint64_t c_stat_fsync_ranged;
+  uint64_t c_stat_fsync_full;
+  uint64_t c_stat_fsync_ranged_bytes;
+  uint64_t c_stat_dirty_overflows;
+
+  // --- Metadata mapping tuning (see kafs_meta_map.h) ---
+  uint32_t c_meta_hugepage;        // 2MiB-aligned map + MADV_HUGEPAGE on metadata regions
+  uint32_t c_meta_prefault;        // populate metadata regions in a background thread after mount
+  uint32_t c_meta_prefault_state;  // KAFS_META_PREFAULT_*
+  uint32_t c_meta_prefault_stop;
+  int c_meta_prefault_running;
+  pthread_t c_meta_prefault_tid;
+  uint64_t c_stat_meta_hugepage_bytes;
+  uint64_t c_stat_meta_prefault_bytes;
+  uint64_t c_stat_meta_prefault_ns;
+
+  // --- Data block I/O engine (see kafs_io_engine.h) ---
+  uint32_t c_io_engine; // KAFS_IO_ENGINE_*; 0 (mmap) for tools that memset the context
+  int c_direct_fd;      // O_DIRECT fd for io_engine=direct (-1: not open)
+  uint64_t c_stat_io_direct_fallbacks; // direct I/O refused (EINVAL) and redone buffered
+
+  // --- Memory budget (see kafs_mem_budget.h) ---
+  uint64_t c_mem_budget;            // -o mem_budget in bytes (0: unlimited)
+  struct kafs_mem_trim *c_mem_trim; // idle metadata trimming (NULL: off)
+  int c_mem_trim_running;
+
   // --- Runtime inode open counts (in-memory only) ---
-  uint32_t *c_open_cnt;  // sized to superblock inocnt (allocated at mount)
-  uint32_t *c_ino_epoch; // sized to superblock inocnt (optimistic guard for pending worker)
+  // Sparse (chunks allocated on first write), so memory follows touched inodes, not inocnt.
+  struct kafs_sparse_u32 *c_open_cnt;     // allocated with the inode locks
+  struct kafs_sparse_u32 *c_ino_epoch;    // optimistic guard for pending worker (untouched = 1)
+  struct kafs_sparse_u32 *c_dedup_policy; // per-inode dedup bypass state (untouched = 0)
 
   // --- Debug create->first-pwrite correlation (allocated only when debug enabled) ---
   uint64_t c_diag_create_seq_next;
@@ -345,12 +364,46 @@ struct kafs_context
   int32_t c_hotplug_compat_reason;
   uint32_t c_hotplug_env_count;
   kafs_hotplug_env_entry_t c_hotplug_env[KAFS_HOTPLUG_ENV_MAX];
-  pthread_mutex_t c_hotplug_lock;
+  pthread_mutex_t c_hotplug_lock; // the env table
   int c_hotplug_lock_init;
+  // Outstanding calls matched to responses by req_id. A waiting caller takes the reader role
+  // (c_hotplug_mux_reader) and hands other callers' responses over through c_hotplug_mux_cond.
+  pthread_mutex_t c_hotplug_mux_lock;
+  pthread_cond_t c_hotplug_mux_cond;
+  int c_hotplug_mux_init;
+  int c_hotplug_mux_reader;
+  struct kafs_hotplug_call *c_hotplug_calls;
+  uint32_t c_hotplug_inflight;
+  uint32_t c_hotplug_inflight_max;
+  uint64_t c_stat_hotplug_rpc_calls;
+  uint64_t c_stat_hotplug_rpc_handoffs; // responses read by another waiting caller
+  uint64_t c_stat_hotplug_rpc_orphans;  // responses whose caller was already failed
+  // Sends are group-committed through c_hotplug_tx; the reader role owns c_hotplug_rx and rebinds
+  // it when c_hotplug_conn_gen moves (bumped on every completed handshake).
+  struct kafs_rpc_tx *c_hotplug_tx;
+  struct kafs_rpc_rx *c_hotplug_rx;
+  uint64_t c_hotplug_conn_gen;
+  uint64_t c_hotplug_rx_gen;
+  uint32_t c_hotplug_max_payload; // largest request/response body agreed in HELLO
+  // Explicit restarts that handed the old back's state to the new one (STATE_SAVE) or did not.
+  uint64_t c_stat_hotplug_warm_restarts;
+  uint64_t c_stat_hotplug_cold_restarts;
+  uint32_t c_stat_hotplug_warm_state_bytes; // size of the last state handed over
   pthread_mutex_t c_hotplug_wait_lock;
   pthread_cond_t c_hotplug_wait_cond;
   int c_hotplug_wait_lock_init;
   int c_hotplug_connecting;
+  struct kafs_rpc_shm *c_hotplug_shm; // memfd slot ring for data_mode=shm (NULL: not created)
+  int c_hotplug_shm_active;           // ring attached to the current back (else data goes inline)
+  uint64_t c_stat_hotplug_shm_reads;
+  uint64_t c_stat_hotplug_shm_writes;
+  uint64_t c_stat_hotplug_shm_bytes;
+  uint64_t c_stat_hotplug_shm_slot_misses; // no free slot, request went inline or local
+  // Namespace ops forwarded to a back with KAFS_RPC_HELLO_FEATURE_NS (created on that handshake).
+  struct kafs_sparse_u32 *c_hotplug_ns_open; // per-inode handles opened through the back
+  uint64_t c_stat_hotplug_ns_calls;
+  uint64_t c_stat_hotplug_ns_readdir_chunks;
+  uint64_t c_stat_hotplug_ns_multi_attrs; // attributes fetched by GETATTR_MULTI for readdirplus
   char c_hotplug_uds_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
 };
 
@@ -368,8 +421,44 @@ static inline void kafs_ctx_meta_write_count(kafs_context_t *ctx, uint32_t regio
     region = KAFS_META_REGION_UNKNOWN;
   __atomic_add_fetch(&ctx->c_meta_region_writes[region], 1u, __ATOMIC_RELAXED);
   __atomic_add_fetch(&ctx->c_meta_region_bytes[region], bytes, __ATOMIC_RELAXED);
+  if (!(__atomic_load_n(&ctx->c_dirty_meta_mask, __ATOMIC_RELAXED) & (1u << region)))
+    __atomic_or_fetch(&ctx->c_dirty_meta_mask, 1u << region, __ATOMIC_RELAXED);
+}
+
+/// @brief シャード化カウンタへの加算先（呼び出しスレッドのシャード）
+static inline uint64_t *kafs_stat_slot(kafs_context_t *ctx, kafs_stat_id_t id)
+{
+  if (!ctx->c_stat_shards)
+    return &ctx->c_stat_fallback[id];
+  return &ctx->c_stat_shards[kafs_stat_thread_shard() & ctx->c_stat_shard_mask].v[id];
+}
+
+static inline void kafs_stat_add(kafs_context_t *ctx, kafs_stat_id_t id, uint64_t n)
+{
+  __atomic_add_fetch(kafs_stat_slot(ctx, id), n, __ATOMIC_RELAXED);
 }
 
+/// @brief 全シャードの合計（fsstat 用、加算と並行して読むので best-effort）
+static inline uint64_t kafs_stat_sum(const kafs_context_t *ctx, kafs_stat_id_t id)
+{
+  uint64_t v = __atomic_load_n(&ctx->c_stat_fallback[id], __ATOMIC_RELAXED);
+  if (ctx->c_stat_shards)
+    for (uint32_t i = 0; i <= ctx->c_stat_shard_mask; ++i)
+      v += __atomic_load_n(&ctx->c_stat_shards[i].v[id], __ATOMIC_RELAXED);
+  return v;
+}
+
+// レコード単位のカウンタ（X(..., 1)）。KAFS_ENABLE_RECORD_STATS == 0 では加算ごと消える。
+#if KAFS_ENABLE_RECORD_STATS
+#define kafs_stat_add_rec(ctx, id, n) kafs_stat_add((ctx), (id), (n))
+#else
+#define kafs_stat_add_rec(ctx, id, n)                                                              \
+  do                                                                                               \
+  {                                                                                                \
+    (void)(ctx);                                                                                   \
+  } while (0)
+#endif
+
 static inline uint32_t kafs_ctx_inode_format(const kafs_context_t *ctx)
 {
   assert(ctx != NULL);
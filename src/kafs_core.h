@@ -7,11 +7,24 @@
 #include <sys/stat.h>
 
 int kafs_core_open_image(const char *image_path, kafs_context_t *ctx);
+// Like kafs_core_open_image, starting from the state a previous kafs-back returned for STATE_SAVE
+// (kafs_rpc_warm_state_t and its open table). Cursors and the HRL free list are adopted only when
+// the image is unchanged since; otherwise it falls back to the cold path. *out_warm is set to 1
+// when they were adopted.
+int kafs_core_open_image_warm(const char *image_path, kafs_context_t *ctx, const void *state,
+                              uint32_t state_len, int *out_warm);
 void kafs_core_close_image(kafs_context_t *ctx);
+// Closes the image like kafs_core_close_image after writing the state a successor needs into buf.
+// Returns -E2BIG (image still open) when it does not fit in cap.
+int kafs_core_close_image_warm(kafs_context_t *ctx, void *buf, uint32_t cap, uint32_t *out_len);
 int kafs_core_getattr(kafs_context_t *ctx, kafs_inocnt_t ino, struct stat *st);
 ssize_t kafs_core_read(kafs_context_t *ctx, kafs_inocnt_t ino, void *buf, size_t size,
                        off_t offset);
 ssize_t kafs_core_write(kafs_context_t *ctx, kafs_inocnt_t ino, const void *buf, size_t size,
                         off_t offset);
 int kafs_core_truncate(kafs_context_t *ctx, kafs_inocnt_t ino, off_t size);
+// Runs one namespace RPC (KAFS_RPC_OP_LOOKUP .. KAFS_RPC_OP_FSYNC) for kafs-back.
+// Returns 0 or -errno; the answer (if any) is written to resp and its length to *resp_len.
+int kafs_core_ns_exec(kafs_context_t *ctx, uint16_t op, const void *payload, uint32_t len,
+                      void *resp, uint32_t resp_cap, uint32_t *resp_len);
 int kafs_core_migrate_image(const char *image_path, int assume_yes);
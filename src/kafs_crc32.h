@@ -0,0 +1,194 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+// CRC32 (IEEE 802.3, reflected 0xEDB88320) と CRC32C (Castagnoli, reflected 0x82F63B78)。
+// どちらも slice-by-8 テーブルで計算し、CRC32C は SSE4.2 / ARMv8 CRC 命令があれば実行時に選択する。
+// update 系は crc=0 から開始し、連結呼び出しで分割バッファにも使える。
+
+#define KAFS_CRC32_POLY 0xEDB88320u
+#define KAFS_CRC32C_POLY 0x82F63B78u
+
+typedef struct kafs_crc_table
+{
+  uint32_t t[8][256];
+} kafs_crc_table_t;
+
+/// @brief 1bit ずつの参照実装（テーブル生成前のフォールバック・テスト用）
+static inline uint32_t kafs_crc_bitwise(uint32_t poly, uint32_t crc, const uint8_t *buf, size_t len)
+{
+  crc = ~crc;
+  for (size_t i = 0; i < len; ++i)
+  {
+    crc ^= buf[i];
+    for (int k = 0; k < 8; ++k)
+      crc = (crc >> 1) ^ (poly & (uint32_t)(0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+static inline void kafs_crc_table_build(kafs_crc_table_t *tab, uint32_t poly)
+{
+  for (uint32_t i = 0; i < 256u; ++i)
+  {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k)
+      c = (c >> 1) ^ (poly & (uint32_t)(0u - (c & 1u)));
+    tab->t[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256u; ++i)
+    for (int k = 1; k < 8; ++k)
+      tab->t[k][i] = (tab->t[k - 1][i] >> 8) ^ tab->t[0][tab->t[k - 1][i] & 0xffu];
+}
+
+/// @brief テーブルを初回利用時に生成して返す。他スレッドが生成中なら NULL（呼び出し側は bitwise）。
+static inline const kafs_crc_table_t *kafs_crc_table_get(int castagnoli)
+{
+  static kafs_crc_table_t tabs[2];
+  static int state[2]; // 0: none, 1: building, 2: ready
+  int i = castagnoli ? 1 : 0;
+  int st = __atomic_load_n(&state[i], __ATOMIC_ACQUIRE);
+  if (st == 2)
+    return &tabs[i];
+  int expected = 0;
+  if (st == 0 && __atomic_compare_exchange_n(&state[i], &expected, 1, 0, __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE))
+  {
+    kafs_crc_table_build(&tabs[i], castagnoli ? KAFS_CRC32C_POLY : KAFS_CRC32_POLY);
+    __atomic_store_n(&state[i], 2, __ATOMIC_RELEASE);
+    return &tabs[i];
+  }
+  return NULL;
+}
+
+static inline uint32_t kafs_crc_slice8(const kafs_crc_table_t *tab, uint32_t crc, const uint8_t *p,
+                                       size_t len)
+{
+  const uint32_t(*t)[256] = tab->t;
+  crc = ~crc;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; len && ((uintptr_t)p & 7u); --len)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xffu];
+  for (; len >= 8; len -= 8, p += 8)
+  {
+    uint32_t lo, hi;
+    memcpy(&lo, p, sizeof(lo));
+    memcpy(&hi, p + 4, sizeof(hi));
+    lo ^= crc;
+    crc = t[7][lo & 0xffu] ^ t[6][(lo >> 8) & 0xffu] ^ t[5][(lo >> 16) & 0xffu] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xffu] ^ t[2][(hi >> 8) & 0xffu] ^ t[1][(hi >> 16) & 0xffu] ^ t[0][hi >> 24];
+  }
+#endif
+  for (; len; --len)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xffu];
+  return ~crc;
+}
+
+static inline uint32_t kafs_crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  const kafs_crc_table_t *tab = kafs_crc_table_get(0);
+  return tab ? kafs_crc_slice8(tab, crc, buf, len) : kafs_crc_bitwise(KAFS_CRC32_POLY, crc, buf, len);
+}
+
+static inline uint32_t kafs_crc32c_update_sw(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  const kafs_crc_table_t *tab = kafs_crc_table_get(1);
+  return tab ? kafs_crc_slice8(tab, crc, buf, len)
+             : kafs_crc_bitwise(KAFS_CRC32C_POLY, crc, buf, len);
+}
+
+// --- CRC32C 命令 fast path ---
+#if defined(__x86_64__) && defined(__GNUC__)
+#define KAFS_CRC32C_HAVE_HW 1
+
+__attribute__((target("sse4.2"))) static inline uint32_t
+kafs_crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+  uint64_t c = (uint32_t)~crc;
+  for (; len && ((uintptr_t)p & 7u); --len)
+    c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+  for (; len >= 8; len -= 8, p += 8)
+  {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    c = __builtin_ia32_crc32di(c, v);
+  }
+  for (; len; --len)
+    c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+  return ~(uint32_t)c;
+}
+
+static inline int kafs_crc32c_hw_detect(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2") ? 1 : 0;
+}
+
+#elif defined(__aarch64__) && defined(__linux__) && defined(__GNUC__)
+#define KAFS_CRC32C_HAVE_HW 1
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1u << 7)
+#endif
+#if defined(__clang__)
+#define KAFS_ARM_CRC32CB __builtin_arm_crc32cb
+#define KAFS_ARM_CRC32CD __builtin_arm_crc32cd
+#else
+#define KAFS_ARM_CRC32CB __builtin_aarch64_crc32cb
+#define KAFS_ARM_CRC32CD __builtin_aarch64_crc32cx
+#endif
+
+__attribute__((target("+crc"))) static inline uint32_t
+kafs_crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+  uint32_t c = ~crc;
+  for (; len && ((uintptr_t)p & 7u); --len)
+    c = KAFS_ARM_CRC32CB(c, *p++);
+  for (; len >= 8; len -= 8, p += 8)
+  {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    c = KAFS_ARM_CRC32CD(c, v);
+  }
+  for (; len; --len)
+    c = KAFS_ARM_CRC32CB(c, *p++);
+  return ~c;
+}
+
+static inline int kafs_crc32c_hw_detect(void)
+{
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) ? 1 : 0;
+}
+
+#else
+#define KAFS_CRC32C_HAVE_HW 0
+#endif
+
+/// @brief CRC32C 命令が使えるか（初回のみ検出し、結果をキャッシュ）
+static inline int kafs_crc32c_hw_available(void)
+{
+#if KAFS_CRC32C_HAVE_HW
+  static int hw = -1;
+  int h = __atomic_load_n(&hw, __ATOMIC_RELAXED);
+  if (h < 0)
+  {
+    h = kafs_crc32c_hw_detect();
+    __atomic_store_n(&hw, h, __ATOMIC_RELAXED);
+  }
+  return h;
+#else
+  return 0;
+#endif
+}
+
+static inline uint32_t kafs_crc32c_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+#if KAFS_CRC32C_HAVE_HW
+  if (kafs_crc32c_hw_available())
+    return kafs_crc32c_update_hw(crc, buf, len);
+#endif
+  return kafs_crc32c_update_sw(crc, buf, len);
+}
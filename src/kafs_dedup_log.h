@@ -0,0 +1,142 @@
+#pragma once
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// 背景 dedup 用の書き込みログ。
+// HRL を通らずに書いた（direct）データブロックを (ino, iblk, blo) として固定長のリングに積み、
+// 背景 dedup はこの差分だけを HRL 全体と突き合わせる。積んだ後で書き換えられたブロックは
+// 取り出したときの (ino, iblk) → blo の照合で捨てる。
+// リングが溢れたら dl_lost を立てて以降の分は捨てる。取り出し側はそれを見て、inode 表の巡回
+// （旧来の sweep）を 1 周やり直す。dl_lock は葉ロック（inode ロックを持ったまま積んでよい）。
+
+typedef struct kafs_dedup_log_ent
+{
+  uint32_t dl_ino;
+  uint32_t dl_iblk;
+  uint32_t dl_blo;
+} kafs_dedup_log_ent_t;
+
+typedef struct kafs_dedup_log
+{
+  pthread_mutex_t dl_lock;
+  uint32_t dl_mask; // 容量 - 1（容量は 2 のべき）
+  uint32_t dl_head; // 次に取り出す位置（単調増加、mask で添字化）
+  uint32_t dl_tail; // 次に積む位置
+  uint32_t dl_lost; // 溢れて捨てた分がある
+  uint64_t dl_noted;
+  uint64_t dl_dropped;
+  kafs_dedup_log_ent_t dl_ent[];
+} kafs_dedup_log_t;
+
+/// @brief 容量 cap（2 のべきに切り上げ）のログを作る
+/// @return ログ、失敗時は NULL
+static inline kafs_dedup_log_t *kafs_dedup_log_create(uint32_t cap)
+{
+  if (cap < 2u || cap > (1u << 30))
+    return NULL;
+  uint32_t n = 1u;
+  while (n < cap)
+    n <<= 1;
+  kafs_dedup_log_t *l =
+      (kafs_dedup_log_t *)calloc(1, sizeof(*l) + (size_t)n * sizeof(kafs_dedup_log_ent_t));
+  if (!l)
+    return NULL;
+  pthread_mutex_init(&l->dl_lock, NULL);
+  l->dl_mask = n - 1u;
+  return l;
+}
+
+static inline void kafs_dedup_log_destroy(kafs_dedup_log_t *l)
+{
+  if (!l)
+    return;
+  pthread_mutex_destroy(&l->dl_lock);
+  free(l);
+}
+
+/// @brief 1 件積む
+/// @return 0: 積んだ, -ENOSPC: 満杯なので捨てた（dl_lost が立つ）, -EINVAL: l が NULL
+static inline int kafs_dedup_log_note(kafs_dedup_log_t *l, uint32_t ino, uint32_t iblk,
+                                      uint32_t blo)
+{
+  if (!l)
+    return -EINVAL;
+  int rc = 0;
+  pthread_mutex_lock(&l->dl_lock);
+  if (l->dl_tail - l->dl_head > l->dl_mask)
+  {
+    l->dl_lost = 1u;
+    l->dl_dropped++;
+    rc = -ENOSPC;
+  }
+  else
+  {
+    kafs_dedup_log_ent_t *e = &l->dl_ent[l->dl_tail & l->dl_mask];
+    e->dl_ino = ino;
+    e->dl_iblk = iblk;
+    e->dl_blo = blo;
+    l->dl_tail++;
+    l->dl_noted++;
+  }
+  pthread_mutex_unlock(&l->dl_lock);
+  return rc;
+}
+
+/// @brief 古い順に最大 max 件取り出す
+/// @return 取り出した件数
+static inline uint32_t kafs_dedup_log_take(kafs_dedup_log_t *l, kafs_dedup_log_ent_t *out,
+                                           uint32_t max)
+{
+  if (!l)
+    return 0;
+  uint32_t n = 0;
+  pthread_mutex_lock(&l->dl_lock);
+  while (n < max && l->dl_head != l->dl_tail)
+  {
+    out[n++] = l->dl_ent[l->dl_head & l->dl_mask];
+    l->dl_head++;
+  }
+  pthread_mutex_unlock(&l->dl_lock);
+  return n;
+}
+
+/// @brief 溢れたかを返して下ろす
+static inline int kafs_dedup_log_take_lost(kafs_dedup_log_t *l)
+{
+  if (!l)
+    return 0;
+  pthread_mutex_lock(&l->dl_lock);
+  int lost = l->dl_lost != 0;
+  l->dl_lost = 0;
+  pthread_mutex_unlock(&l->dl_lock);
+  return lost;
+}
+
+/// @brief 未処理件数と溢れの有無（統計・アンマウント用）
+static inline uint32_t kafs_dedup_log_pending(kafs_dedup_log_t *l, int *lost)
+{
+  if (lost)
+    *lost = 0;
+  if (!l)
+    return 0;
+  pthread_mutex_lock(&l->dl_lock);
+  uint32_t n = l->dl_tail - l->dl_head;
+  if (lost)
+    *lost = l->dl_lost != 0;
+  pthread_mutex_unlock(&l->dl_lock);
+  return n;
+}
+
+static inline void kafs_dedup_log_counters(kafs_dedup_log_t *l, uint64_t *noted, uint64_t *dropped)
+{
+  *noted = 0;
+  *dropped = 0;
+  if (!l)
+    return;
+  pthread_mutex_lock(&l->dl_lock);
+  *noted = l->dl_noted;
+  *dropped = l->dl_dropped;
+  pthread_mutex_unlock(&l->dl_lock);
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <stdint.h>
+
+// inode ごとの dedup 迂回ポリシー。
+// 動画・アーカイブ・暗号化データのように重複しない書き込みは、HRL に通しても hash・バケット
+// ロック・エントリを使うだけで当たらず、有用なエントリを追い出す。そこで inode ごとに直近
+// sample ブロックの HRL ヒット率を数え、hit_pct % 未満なら以降のブロックを direct で書く
+// （背景 dedup の書き込みログには積むので、後から重複が見つかればそちらでまとめる）。
+// 迂回中も KAFS_DEDUP_POLICY_PROBE_EVERY ブロックに 1 つは HRL に通し、当たったら数え直す。
+// 状態は 32bit 1 語にまとめ（疎配列 c_dedup_policy の要素）、CAS で更新する。0 が初期状態。
+//   bit 0-11: 窓内のブロック数（迂回中は前回の試し書きからのブロック数）
+//   bit 12-23: 窓内のヒット数
+//   bit 24-25: モード
+// ヒット率は HRL を通した結果（pending 経路なら解決時）で数えるので、判定は少し遅れて効く。
+
+#define KAFS_DEDUP_BYPASS_SAMPLE_DEFAULT 32u
+#define KAFS_DEDUP_BYPASS_HIT_PCT_DEFAULT 5u
+#define KAFS_DEDUP_POLICY_SAMPLE_MAX 4095u
+#define KAFS_DEDUP_POLICY_PROBE_EVERY 256u
+
+enum
+{
+  KAFS_DEDUP_POLICY_SAMPLING = 0, // 最初の窓を数えている
+  KAFS_DEDUP_POLICY_DEDUP = 1,    // HRL に通す（窓ごとに判定し直す）
+  KAFS_DEDUP_POLICY_BYPASS = 2,   // direct で書く
+};
+
+// kafs_dedup_policy_note の戻り値（統計用の遷移）
+enum
+{
+  KAFS_DEDUP_POLICY_NOTE_NONE = 0,
+  KAFS_DEDUP_POLICY_NOTE_KEEP = 1,  // 窓を判定して HRL を使い続ける
+  KAFS_DEDUP_POLICY_NOTE_ENTER = 2, // 迂回に入った
+  KAFS_DEDUP_POLICY_NOTE_LEAVE = 3, // 迂回中に当たったので数え直す
+};
+
+static inline uint32_t kafs_dedup_policy_cnt(uint32_t st) { return st & 0xfffu; }
+
+static inline uint32_t kafs_dedup_policy_hits(uint32_t st) { return (st >> 12) & 0xfffu; }
+
+static inline uint32_t kafs_dedup_policy_mode(uint32_t st) { return (st >> 24) & 0x3u; }
+
+static inline uint32_t kafs_dedup_policy_pack(uint32_t mode, uint32_t hits, uint32_t cnt)
+{
+  return (mode << 24) | ((hits & 0xfffu) << 12) | (cnt & 0xfffu);
+}
+
+/// @brief このブロックを迂回するか決める
+/// @param st 状態語（NULL なら迂回しない）
+/// @param sample 窓の大きさ（0 ならポリシー無効）
+/// @param probe 迂回中の試し書きに当たったら 1（NULL 可）
+/// @return 1: direct で書く, 0: 通常経路（HRL / pending）
+static inline int kafs_dedup_policy_route(uint32_t *st, uint32_t sample, int *probe)
+{
+  if (probe)
+    *probe = 0;
+  if (!st || sample == 0)
+    return 0;
+  uint32_t cur = __atomic_load_n(st, __ATOMIC_RELAXED);
+  for (;;)
+  {
+    if (kafs_dedup_policy_mode(cur) != KAFS_DEDUP_POLICY_BYPASS)
+      return 0;
+    uint32_t cnt = kafs_dedup_policy_cnt(cur) + 1u;
+    int is_probe = cnt >= KAFS_DEDUP_POLICY_PROBE_EVERY;
+    uint32_t next = kafs_dedup_policy_pack(KAFS_DEDUP_POLICY_BYPASS, 0, is_probe ? 0 : cnt);
+    if (__atomic_compare_exchange_n(st, &cur, next, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+      if (is_probe && probe)
+        *probe = 1;
+      return !is_probe;
+    }
+  }
+}
+
+/// @brief HRL に通したブロックの結果を数える
+/// @param hit 既存ブロックに当たったら 1
+/// @return KAFS_DEDUP_POLICY_NOTE_*
+static inline int kafs_dedup_policy_note(uint32_t *st, uint32_t sample, uint32_t hit_pct, int hit)
+{
+  if (!st || sample == 0)
+    return KAFS_DEDUP_POLICY_NOTE_NONE;
+  if (sample > KAFS_DEDUP_POLICY_SAMPLE_MAX)
+    sample = KAFS_DEDUP_POLICY_SAMPLE_MAX;
+  uint32_t cur = __atomic_load_n(st, __ATOMIC_RELAXED);
+  for (;;)
+  {
+    uint32_t mode = kafs_dedup_policy_mode(cur);
+    uint32_t next;
+    int ret = KAFS_DEDUP_POLICY_NOTE_NONE;
+    if (mode == KAFS_DEDUP_POLICY_BYPASS)
+    {
+      // 迂回中に届くのは試し書きか、迂回に入る前に積んだ pending の解決結果。どちらでも
+      // 当たったなら重複があるので窓を数え直す。
+      if (!hit)
+        return KAFS_DEDUP_POLICY_NOTE_NONE;
+      next = kafs_dedup_policy_pack(KAFS_DEDUP_POLICY_SAMPLING, 0, 0);
+      ret = KAFS_DEDUP_POLICY_NOTE_LEAVE;
+    }
+    else
+    {
+      uint32_t cnt = kafs_dedup_policy_cnt(cur) + 1u;
+      uint32_t hits = kafs_dedup_policy_hits(cur) + (hit ? 1u : 0u);
+      if (cnt < sample)
+        next = kafs_dedup_policy_pack(mode, hits, cnt);
+      else if ((uint64_t)hits * 100u < (uint64_t)hit_pct * cnt)
+      {
+        next = kafs_dedup_policy_pack(KAFS_DEDUP_POLICY_BYPASS, 0, 0);
+        ret = KAFS_DEDUP_POLICY_NOTE_ENTER;
+      }
+      else
+      {
+        next = kafs_dedup_policy_pack(KAFS_DEDUP_POLICY_DEDUP, 0, 0);
+        ret = KAFS_DEDUP_POLICY_NOTE_KEEP;
+      }
+    }
+    if (__atomic_compare_exchange_n(st, &cur, next, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      return ret;
+  }
+}
@@ -0,0 +1,336 @@
+#pragma once
+#include "kafs_config.h"
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_block.h"
+#include "kafs_cblk.h"
+#include "kafs_hash.h"
+#include "kafs_meta_region.h"
+#include "kafs_mmap_io.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Dirty-range tracking for ranged fsync.
+//
+// Every data or indirect block written through the mapping is recorded against the inode that
+// wrote it (or in a shared "orphan" list when no inode owns the write: pending worker, background
+// dedup, truncate). fsync(ino) then msyncs only that inode's extents, the orphan extents, and the
+// metadata regions dirtied since the last sync, so its cost follows the file's own dirty data
+// instead of every dirty page in the image. msync(MS_SYNC) on a range is a ranged fdatasync of the
+// image file, so the device cache is flushed as with a full fsync.
+//
+// The per-inode table is direct-mapped by inode number; a colliding inode spills the previous
+// owner's extents into the orphan list. When the orphan list overflows, tracking is abandoned
+// until the next fsync, which then syncs the whole image. Writes and truncates forwarded to a
+// hotplug back land through the back's own mapping and do the same. c_dirty_lock is a leaf lock.
+
+/// 追跡表のスロット数 (inode 番号で direct-map)
+#define KAFS_DIRTY_SLOTS 256u
+/// スロット毎のエクステント数
+#define KAFS_DIRTY_SLOT_EXTENTS 8u
+/// 所有 inode 不明な書き込みのエクステント数
+#define KAFS_DIRTY_ORPHAN_EXTENTS 64u
+/// dirty ビットに関わらず毎回同期するメタデータ領域
+/// (superblock/bitmap/inode 表はカウンタを経由しない in-place 更新があるため、allocator summary は未計上のため)
+#define KAFS_DIRTY_META_ALWAYS                                                                     \
+  ((1u << KAFS_META_REGION_SUPERBLOCK_CHECKPOINT) | (1u << KAFS_META_REGION_ALLOCATOR_SUMMARY))
+
+/// @brief 連続した dirty ブロック範囲
+typedef struct kafs_dirty_extent
+{
+  kafs_blkcnt_t de_blo;
+  uint32_t de_cnt;
+} kafs_dirty_extent_t;
+
+/// @brief inode 毎の dirty 範囲
+typedef struct kafs_dirty_slot
+{
+  /// @brief 所有 inode (KAFS_INO_NONE: 空き)
+  uint32_t ds_ino;
+  uint32_t ds_count;
+  kafs_dirty_extent_t ds_ext[KAFS_DIRTY_SLOT_EXTENTS];
+} kafs_dirty_slot_t;
+
+typedef struct kafs_dirty_table
+{
+  kafs_dirty_slot_t dt_slots[KAFS_DIRTY_SLOTS];
+  uint32_t dt_orphan_count;
+  kafs_dirty_extent_t dt_orphan[KAFS_DIRTY_ORPHAN_EXTENTS];
+  /// @brief メタデータ領域のバイト範囲 (journal はリング側で同期するので含めない)
+  uint64_t dt_meta_off[KAFS_META_REGION_COUNT];
+  uint64_t dt_meta_len[KAFS_META_REGION_COUNT];
+} kafs_dirty_table_t;
+
+static int kafs_dirty_enabled(const struct kafs_context *ctx)
+{
+  return ctx && ctx->c_dirty_tbl != NULL;
+}
+
+/// @brief [blo, blo + cnt) が e と重なるか隣接していれば e に併合する
+/// @return 1: 併合した, 0: 離れている
+static int kafs_dirty_ext_merge(kafs_dirty_extent_t *e, kafs_blkcnt_t blo, uint32_t cnt)
+{
+  uint64_t lo = e->de_blo, hi = (uint64_t)e->de_blo + e->de_cnt;
+  if ((uint64_t)blo > hi || (uint64_t)blo + cnt < lo)
+    return 0;
+  if (blo < lo)
+    lo = blo;
+  if ((uint64_t)blo + cnt > hi)
+    hi = (uint64_t)blo + cnt;
+  e->de_blo = (kafs_blkcnt_t)lo;
+  e->de_cnt = (uint32_t)(hi - lo);
+  return 1;
+}
+
+/// @brief 範囲を既存エクステントへ併合するか末尾に追加する
+/// @return 0: 成功, -1: 空きなし
+static int kafs_dirty_ext_add(kafs_dirty_extent_t *ext, uint32_t *count, uint32_t cap,
+                              kafs_blkcnt_t blo, uint32_t cnt)
+{
+  // Newest first: sequential writers extend the extent they added last.
+  for (uint32_t i = *count; i-- > 0;)
+  {
+    if (!kafs_dirty_ext_merge(&ext[i], blo, cnt))
+      continue;
+    // The grown extent may now bridge to another one (filling a one-block gap).
+    for (uint32_t j = 0; j < *count; ++j)
+    {
+      if (j == i || !kafs_dirty_ext_merge(&ext[i], ext[j].de_blo, ext[j].de_cnt))
+        continue;
+      ext[j] = ext[--*count];
+      break;
+    }
+    return 0;
+  }
+  if (*count >= cap)
+    return -1;
+  ext[*count].de_blo = blo;
+  ext[*count].de_cnt = cnt;
+  ++*count;
+  return 0;
+}
+
+// Caller holds c_dirty_lock.
+static void kafs_dirty_orphan_add_locked(struct kafs_context *ctx, kafs_dirty_table_t *t,
+                                         kafs_blkcnt_t blo, uint32_t cnt)
+{
+  if (ctx->c_dirty_full)
+    return;
+  if (kafs_dirty_ext_add(t->dt_orphan, &t->dt_orphan_count, KAFS_DIRTY_ORPHAN_EXTENTS, blo, cnt) ==
+      0)
+    return;
+  ctx->c_dirty_full = 1;
+  t->dt_orphan_count = 0;
+  __atomic_add_fetch(&ctx->c_stat_dirty_overflows, 1u, __ATOMIC_RELAXED);
+}
+
+// Move a slot's extents to the orphan list and free the slot (caller holds c_dirty_lock).
+static void kafs_dirty_spill_locked(struct kafs_context *ctx, kafs_dirty_table_t *t,
+                                    kafs_dirty_slot_t *s)
+{
+  for (uint32_t i = 0; i < s->ds_count; ++i)
+    kafs_dirty_orphan_add_locked(ctx, t, s->ds_ext[i].de_blo, s->ds_ext[i].de_cnt);
+  s->ds_count = 0;
+}
+
+static void kafs_dirty_reset_locked(kafs_dirty_table_t *t)
+{
+  for (uint32_t i = 0; i < KAFS_DIRTY_SLOTS; ++i)
+  {
+    t->dt_slots[i].ds_ino = KAFS_INO_NONE;
+    t->dt_slots[i].ds_count = 0;
+  }
+  t->dt_orphan_count = 0;
+}
+
+/// @brief 書き込んだブロックを dirty として記録する
+/// @param ctx コンテキスト
+/// @param ino 書き込み元 inode 番号 (KAFS_INO_NONE: 所有者不明)
+/// @param blo 書き込んだ物理ブロック番号（圧縮参照ならそのコンテナ）
+static void kafs_dirty_note(struct kafs_context *ctx, uint32_t ino, kafs_blkcnt_t blo)
+{
+  if (!kafs_dirty_enabled(ctx) || blo == KAFS_BLO_NONE)
+    return;
+  blo = kafs_cblk_phys_blo(blo);
+  kafs_dirty_table_t *t = (kafs_dirty_table_t *)ctx->c_dirty_tbl;
+  pthread_mutex_lock(&ctx->c_dirty_lock);
+  if (ctx->c_dirty_full)
+  {
+    pthread_mutex_unlock(&ctx->c_dirty_lock);
+    return;
+  }
+  if (ino == KAFS_INO_NONE)
+  {
+    kafs_dirty_orphan_add_locked(ctx, t, blo, 1u);
+    pthread_mutex_unlock(&ctx->c_dirty_lock);
+    return;
+  }
+  kafs_dirty_slot_t *s = &t->dt_slots[ino % KAFS_DIRTY_SLOTS];
+  if (s->ds_ino != ino)
+  {
+    kafs_dirty_spill_locked(ctx, t, s);
+    s->ds_ino = ino;
+  }
+  if (kafs_dirty_ext_add(s->ds_ext, &s->ds_count, KAFS_DIRTY_SLOT_EXTENTS, blo, 1u) != 0)
+  {
+    // Too fragmented for the slot: keep the extents, but as orphans.
+    kafs_dirty_spill_locked(ctx, t, s);
+    (void)kafs_dirty_ext_add(s->ds_ext, &s->ds_count, KAFS_DIRTY_SLOT_EXTENTS, blo, 1u);
+  }
+  pthread_mutex_unlock(&ctx->c_dirty_lock);
+}
+
+/// @brief 以後の fsync を全体同期にする（同期失敗で範囲を失ったとき）
+static void kafs_dirty_mark_full(struct kafs_context *ctx)
+{
+  if (!kafs_dirty_enabled(ctx))
+    return;
+  pthread_mutex_lock(&ctx->c_dirty_lock);
+  ctx->c_dirty_full = 1;
+  pthread_mutex_unlock(&ctx->c_dirty_lock);
+}
+
+static void kafs_dirty_meta_set(kafs_dirty_table_t *t, uint32_t region, uint64_t off, uint64_t len)
+{
+  t->dt_meta_off[region] = off;
+  t->dt_meta_len[region] = off ? len : 0u;
+}
+
+/// @brief 追跡表を初期化する (c_fsync_ranged == 0 か全体マップなしなら何もしない)
+/// @param ctx コンテキスト
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static int kafs_dirty_init(struct kafs_context *ctx)
+{
+  if (!ctx->c_fsync_ranged || ctx->c_dirty_tbl || !ctx->c_img_base || ctx->c_mapsize == 0)
+    return 0;
+  if (pthread_mutex_init(&ctx->c_dirty_lock, NULL) != 0)
+    return -ENOMEM;
+  kafs_dirty_table_t *t = calloc(1, sizeof(*t));
+  if (!t)
+  {
+    pthread_mutex_destroy(&ctx->c_dirty_lock);
+    return -ENOMEM;
+  }
+  kafs_dirty_reset_locked(t);
+
+  const kafs_ssuperblock_t *sb = ctx->c_superblock;
+  // Superblock, block bitmap and inode table form the fixed prefix of the image.
+  t->dt_meta_off[KAFS_META_REGION_SUPERBLOCK_CHECKPOINT] = 0;
+  t->dt_meta_len[KAFS_META_REGION_SUPERBLOCK_CHECKPOINT] = ctx->c_mapsize;
+  kafs_dirty_meta_set(t, KAFS_META_REGION_ALLOCATOR_SUMMARY, kafs_sb_allocator_offset_get(sb),
+                      kafs_sb_allocator_size_get(sb));
+  kafs_dirty_meta_set(t, KAFS_META_REGION_HRL_INDEX, kafs_sb_hrl_index_offset_get(sb),
+                      kafs_sb_hrl_index_size_get(sb));
+  kafs_dirty_meta_set(t, KAFS_META_REGION_HRL_ENTRIES, kafs_sb_hrl_entry_offset_get(sb),
+                      (uint64_t)kafs_sb_hrl_entry_cnt_get(sb) * sizeof(kafs_hrl_entry_t));
+  kafs_dirty_meta_set(t, KAFS_META_REGION_PENDING_LOG, kafs_sb_pendinglog_offset_get(sb),
+                      kafs_sb_pendinglog_size_get(sb));
+  kafs_dirty_meta_set(t, KAFS_META_REGION_TAIL_METADATA, kafs_sb_tailmeta_offset_get(sb),
+                      kafs_sb_tailmeta_size_get(sb));
+
+  __atomic_store_n(&ctx->c_dirty_meta_mask, 0u, __ATOMIC_RELAXED);
+  // Writes made before tracking started (mount, replay) are unknown: the first fsync is full.
+  ctx->c_dirty_full = 1;
+  ctx->c_dirty_tbl = t;
+  return 0;
+}
+
+/// @brief 追跡表を破棄する
+static void kafs_dirty_destroy(struct kafs_context *ctx)
+{
+  if (!ctx->c_dirty_tbl)
+    return;
+  free(ctx->c_dirty_tbl);
+  ctx->c_dirty_tbl = NULL;
+  pthread_mutex_destroy(&ctx->c_dirty_lock);
+}
+
+static int kafs_dirty_ext_cmp(const void *a, const void *b)
+{
+  kafs_blkcnt_t x = ((const kafs_dirty_extent_t *)a)->de_blo;
+  kafs_blkcnt_t y = ((const kafs_dirty_extent_t *)b)->de_blo;
+  return (x > y) - (x < y);
+}
+
+/// @brief inode の dirty 範囲・所有者不明の範囲・dirty なメタデータ領域を msync する
+/// journal リングは含まない（呼び出し側で kafs_journal_force_flush する）。
+/// @param ctx コンテキスト
+/// @param ino 対象 inode 番号 (KAFS_INO_NONE: inode 分なし)
+/// @return 0: 成功, 1: 追跡が溢れていたので全体同期が必要 (表はリセット済み), < 0: 失敗 (-errno)
+static int kafs_dirty_sync(struct kafs_context *ctx, uint32_t ino)
+{
+  kafs_dirty_table_t *t = (kafs_dirty_table_t *)ctx->c_dirty_tbl;
+  kafs_dirty_extent_t ext[KAFS_DIRTY_SLOT_EXTENTS + KAFS_DIRTY_ORPHAN_EXTENTS];
+  uint32_t n = 0;
+
+  // Detach before syncing: blocks noted from here on belong to the next fsync.
+  pthread_mutex_lock(&ctx->c_dirty_lock);
+  if (ctx->c_dirty_full)
+  {
+    ctx->c_dirty_full = 0;
+    kafs_dirty_reset_locked(t);
+    pthread_mutex_unlock(&ctx->c_dirty_lock);
+    __atomic_store_n(&ctx->c_dirty_meta_mask, 0u, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ctx->c_stat_fsync_full, 1u, __ATOMIC_RELAXED);
+    return 1;
+  }
+  if (ino != KAFS_INO_NONE)
+  {
+    kafs_dirty_slot_t *s = &t->dt_slots[ino % KAFS_DIRTY_SLOTS];
+    if (s->ds_ino == ino)
+    {
+      memcpy(ext, s->ds_ext, s->ds_count * sizeof(ext[0]));
+      n = s->ds_count;
+      s->ds_ino = KAFS_INO_NONE;
+      s->ds_count = 0;
+    }
+  }
+  memcpy(ext + n, t->dt_orphan, t->dt_orphan_count * sizeof(ext[0]));
+  n += t->dt_orphan_count;
+  t->dt_orphan_count = 0;
+  pthread_mutex_unlock(&ctx->c_dirty_lock);
+  uint32_t mask = __atomic_exchange_n(&ctx->c_dirty_meta_mask, 0u, __ATOMIC_RELAXED);
+
+  qsort(ext, n, sizeof(ext[0]), kafs_dirty_ext_cmp);
+  uint32_t m = 0;
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    if (m > 0 && ext[i].de_blo <= ext[m - 1].de_blo + ext[m - 1].de_cnt)
+    {
+      uint64_t end = (uint64_t)ext[i].de_blo + ext[i].de_cnt;
+      if (end > (uint64_t)ext[m - 1].de_blo + ext[m - 1].de_cnt)
+        ext[m - 1].de_cnt = (uint32_t)(end - ext[m - 1].de_blo);
+      continue;
+    }
+    ext[m++] = ext[i];
+  }
+
+  kafs_logblksize_t log_blksize = kafs_sb_log_blksize_get(ctx->c_superblock);
+  uint64_t bytes = 0;
+  int rc = 0;
+  for (uint32_t i = 0; i < m && rc == 0; ++i)
+  {
+    uint64_t len = (uint64_t)ext[i].de_cnt << log_blksize;
+    rc = kafs_img_sync_range(ctx, (uint64_t)ext[i].de_blo << log_blksize, len);
+    bytes += len;
+  }
+  mask |= KAFS_DIRTY_META_ALWAYS;
+  for (uint32_t r = 0; r < KAFS_META_REGION_COUNT && rc == 0; ++r)
+  {
+    if (!(mask & (1u << r)) || t->dt_meta_len[r] == 0)
+      continue;
+    rc = kafs_img_sync_range(ctx, t->dt_meta_off[r], t->dt_meta_len[r]);
+    bytes += t->dt_meta_len[r];
+  }
+  if (rc < 0)
+  {
+    // The detached ranges are gone; make the next fsync cover everything.
+    kafs_dirty_mark_full(ctx);
+    return rc;
+  }
+  __atomic_add_fetch(&ctx->c_stat_fsync_ranged, 1u, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ctx->c_stat_fsync_ranged_bytes, bytes, __ATOMIC_RELAXED);
+  return 0;
+}
@@ -24,6 +24,11 @@ typedef struct
 // 初期化/オープン/クローズ
 int kafs_hrl_format(kafs_context_t *ctx);
 int kafs_hrl_open(kafs_context_t *ctx);
+// 前の後段が残した空きリストの先頭と数をそのまま使う（全エントリの走査を省く）。
+// 先頭が空きでなければ走査し直して -ESTALE を返す（開くこと自体は済んでいる）。
+int kafs_hrl_open_warm(kafs_context_t *ctx, uint32_t free_head_plus1, uint32_t free_slot_count);
+// 空きリストをイメージ全体の走査で組み直す
+int kafs_hrl_rebuild_free_list(kafs_context_t *ctx);
 int kafs_hrl_close(kafs_context_t *ctx);
 
 // 参照操作
@@ -6,7 +6,7 @@
 #define KAFS_HOTPLUG_ENV_VALUE_MAX 256
 #define KAFS_HOTPLUG_ENV_MAX 32
 
-#define KAFS_HOTPLUG_STATUS_VERSION 5u
+#define KAFS_HOTPLUG_STATUS_VERSION 6u
 
 enum
 {
@@ -59,4 +59,13 @@ typedef struct kafs_hotplug_status
   uint64_t pending_oldest_age_ms;
   uint32_t pending_ttl_over_soft;
   uint32_t pending_ttl_over_hard;
+  // 後段の実行スレッド（v6。後段が KAFS_RPC_HELLO_FEATURE_BACK_STATUS を広告したときだけ埋まる）
+  uint32_t back_workers;
+  uint32_t back_queue_depth;
+  uint32_t back_queue_depth_max;
+  uint32_t back_status_valid;
+  uint64_t back_requests;
+  uint64_t back_service_ns;
+  uint64_t back_service_ns_max;
+  uint64_t back_queue_wait_ns;
 } kafs_hotplug_status_t;
@@ -1,6 +1,9 @@
 #include "kafs_hash.h"
 #include "kafs_locks.h"
 #include "kafs_block.h"
+#include "kafs_cblk.h"
+#include "kafs_bcache.h"
+#include "kafs_io_engine.h"
 #include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
@@ -170,7 +173,7 @@ static void hrl_publish_free_slot(kafs_context_t *ctx, uint32_t idx)
   kafs_hrl_global_unlock(ctx);
 }
 
-static int hrl_read_blo(kafs_context_t *ctx, kafs_blkcnt_t blo, void *out)
+static int hrl_pread_blk(kafs_context_t *ctx, kafs_blkcnt_t blo, void *out)
 {
   kafs_blksize_t bs = hrl_blksize(ctx);
   kafs_logblksize_t l2 = hrl_log_blksize(ctx);
@@ -178,6 +181,13 @@ static int hrl_read_blo(kafs_context_t *ctx, kafs_blkcnt_t blo, void *out)
   return (r == (ssize_t)bs) ? 0 : -EIO;
 }
 
+static int hrl_read_blo(kafs_context_t *ctx, kafs_blkcnt_t blo, void *out)
+{
+  if (kafs_cblk_ref_is(blo))
+    return kafs_cblk_read(ctx, blo, out);
+  return hrl_pread_blk(ctx, blo, out);
+}
+
 #if KAFS_ENABLE_EXTRA_DIAG
 static void hrl_build_sample_strings(const unsigned char *buf, size_t len, char *hex,
                                      size_t hex_size, char *ascii, size_t ascii_size)
@@ -278,18 +288,207 @@ static int hrl_write_blo(kafs_context_t *ctx, kafs_blkcnt_t blo, const void *buf
   hrl_maybe_log_write_diag(ctx, blo, buf);
 #endif
   ssize_t w = pwrite(ctx->c_fd, buf, bs, (off_t)blo << l2);
+  // pread/direct では生のブロックもブロック番号でキャッシュされる（解放時のゼロ埋めも通る）
+  kafs_bcache_invalidate(ctx->c_bcache, kafs_cblk_raw_cache_key(blo));
   return (w == (ssize_t)bs) ? 0 : -EIO;
 }
 
-static int hrl_release_blo(kafs_context_t *ctx, kafs_blkcnt_t *pblo)
+static void hrl_release_raw_blo(kafs_context_t *ctx, kafs_blkcnt_t blo)
 {
-  if (!pblo || *pblo == KAFS_BLO_NONE)
-    return 0;
   kafs_blksize_t bs = hrl_blksize(ctx);
   char z[bs];
   memset(z, 0, bs);
-  (void)hrl_write_blo(ctx, *pblo, z);
-  (void)kafs_blk_set_usage(ctx, *pblo, KAFS_FALSE);
+  (void)hrl_write_blo(ctx, blo, z);
+  (void)kafs_blk_set_usage(ctx, blo, KAFS_FALSE);
+}
+
+// ---------------------------------------------------------
+// 圧縮ブロック（kafs_cblk.h）
+// ---------------------------------------------------------
+
+/// @brief コンテナを読む（io_engine=mmap で image 全体が map されていればそこを直接見る）
+static const void *hrl_cblk_view(kafs_context_t *ctx, kafs_blkcnt_t blo, void *tmp)
+{
+  kafs_blksize_t bs = hrl_blksize(ctx);
+  off_t off = (off_t)blo << hrl_log_blksize(ctx);
+  if (ctx->c_io_engine == KAFS_IO_ENGINE_MMAP && ctx->c_img_base &&
+      (size_t)off + bs <= ctx->c_img_size)
+    return (const char *)ctx->c_img_base + off;
+  return hrl_pread_blk(ctx, blo, tmp) == 0 ? tmp : NULL;
+}
+
+int kafs_cblk_read(kafs_context_t *ctx, kafs_blkcnt_t ref, void *buf)
+{
+  if (!ctx || !buf || !kafs_cblk_ref_is(ref))
+    return -EINVAL;
+  kafs_blkcnt_t blo = kafs_cblk_ref_blo(ref);
+  if (blo >= kafs_sb_r_blkcnt_get(ctx->c_superblock))
+    return -EIO;
+
+  // 同じ圧縮ブロックを続けて読む（ブロックより細かい read・HRL の内容比較・共有ブロック）
+  // たびに展開し直さないよう、展開結果はブロックキャッシュに置く。
+  uint32_t epoch = 0;
+  if (kafs_bcache_get(ctx->c_bcache, (uint32_t)ref, buf, &epoch))
+  {
+    kafs_stat_add(ctx, KAFS_STAT_CBLK_READ_HITS, 1);
+    return 0;
+  }
+
+  kafs_blksize_t bs = hrl_blksize(ctx);
+  char tmp[bs];
+  const void *blk = hrl_cblk_view(ctx, blo, tmp);
+  if (!blk || kafs_cblk_decode(blk, bs, kafs_cblk_ref_slot(ref), buf) != 0)
+    return -EIO;
+  kafs_stat_add(ctx, KAFS_STAT_CBLK_READ_DECODES, 1);
+  (void)kafs_bcache_put(ctx->c_bcache, (uint32_t)ref, buf, epoch);
+  return 0;
+}
+
+int kafs_cblk_store(kafs_context_t *ctx, const void *buf, kafs_blkcnt_t *out_ref)
+{
+  if (!ctx || !buf || !out_ref)
+    return -EINVAL;
+  if (!ctx->c_cblk_enabled)
+    return -ENOTSUP;
+
+  kafs_blksize_t bs = hrl_blksize(ctx);
+  char packed[bs];
+  size_t len = kafs_lz_compress(buf, bs, packed, kafs_cblk_payload_cap(bs));
+  if (len == 0)
+  {
+    __atomic_add_fetch(&ctx->c_stat_cblk_raw, 1u, __ATOMIC_RELAXED);
+    return -E2BIG;
+  }
+
+  // 追記口はスレッドごとに振り分ける。開いているコンテナの中身はメモリに持っているので、追記は
+  // 写しに足して書き出すだけで、コンテナを読み直さない。
+  uint32_t stripe = kafs_stat_thread_shard() & (KAFS_CBLK_STRIPES - 1u);
+  kafs_cblk_open_t *co = &ctx->c_cblk_open[stripe];
+  kafs_cblk_lock(ctx, stripe);
+  if (!co->co_buf)
+    co->co_buf = malloc(bs);
+  char *blk = co->co_buf;
+  if (!blk)
+  {
+    kafs_cblk_unlock(ctx, stripe);
+    return -ENOMEM;
+  }
+  kafs_blkcnt_t blo = co->co_blo;
+  int slot = -ENOSPC;
+  if (blo != KAFS_BLO_NONE)
+    slot = kafs_cblk_append(blk, bs, packed, (uint32_t)len);
+  int fresh = 0;
+  if (slot < 0)
+  {
+    // 開いているコンテナに入らなければ新しく確保する（前のコンテナの残りは使わない）。
+    // 前のコンテナは閉じ、以降の解放はブロック番号のストライプで読み書きする。
+    blo = KAFS_BLO_NONE;
+    int rc = kafs_blk_alloc(ctx, &blo);
+    if (rc != 0)
+    {
+      kafs_cblk_unlock(ctx, stripe);
+      return rc;
+    }
+    __atomic_store_n(&co->co_blo, KAFS_BLO_NONE, __ATOMIC_RELEASE);
+    kafs_cblk_init(blk, bs, __atomic_add_fetch(&ctx->c_cblk_generation, 1u, __ATOMIC_RELAXED));
+    slot = kafs_cblk_append(blk, bs, packed, (uint32_t)len);
+    fresh = 1;
+  }
+  int rc = hrl_write_blo(ctx, blo, blk);
+  if (rc != 0)
+  {
+    // 写しとディスクがずれたので閉じる（このコンテナの残りの解放はディスクから読む）
+    __atomic_store_n(&co->co_blo, KAFS_BLO_NONE, __ATOMIC_RELEASE);
+    if (fresh)
+      hrl_release_raw_blo(ctx, blo);
+    kafs_cblk_unlock(ctx, stripe);
+    return rc;
+  }
+  if (fresh)
+  {
+    __atomic_store_n(&co->co_blo, blo, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ctx->c_stat_cblk_containers, 1u, __ATOMIC_RELAXED);
+  }
+  kafs_cblk_unlock(ctx, stripe);
+
+  __atomic_add_fetch(&ctx->c_stat_cblk_stored, 1u, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ctx->c_stat_cblk_bytes_out, (uint64_t)len, __ATOMIC_RELAXED);
+  *out_ref = kafs_cblk_ref_make(blo, (uint32_t)slot);
+  return 0;
+}
+
+/// @brief コンテナ blk（co: 追記中ならその追記口）のスロットを解放して書き戻す。
+/// 最後のスロットならコンテナごと解放する。呼び出し側がコンテナのストライプのロックを持つ。
+static int hrl_cblk_slot_release_locked(kafs_context_t *ctx, kafs_blkcnt_t ref, char *blk,
+                                        kafs_cblk_open_t *co)
+{
+  kafs_blkcnt_t blo = kafs_cblk_ref_blo(ref);
+  int live = kafs_cblk_slot_free(blk, hrl_blksize(ctx), kafs_cblk_ref_slot(ref));
+  if (live >= 0 || live == -ENOENT)
+    kafs_bcache_invalidate(ctx->c_bcache, (uint32_t)ref); // コンテナが同じ参照を使い回す前に
+  int rc = 0;
+  if (live == 0)
+  {
+    if (co)
+      __atomic_store_n(&co->co_blo, KAFS_BLO_NONE, __ATOMIC_RELEASE);
+    hrl_release_raw_blo(ctx, blo);
+    __atomic_add_fetch(&ctx->c_stat_cblk_containers_freed, 1u, __ATOMIC_RELAXED);
+  }
+  else if (live > 0)
+  {
+    rc = hrl_write_blo(ctx, blo, blk);
+  }
+  if (live == -ENOENT)
+    return 0;
+  return (live < 0) ? live : rc;
+}
+
+/// @brief 圧縮参照のスロットを解放し、最後のスロットならコンテナごと解放する
+/// @return 0: 成功（解放済みも含む）, < 0: コンテナが壊れている
+static int hrl_cblk_release(kafs_context_t *ctx, kafs_blkcnt_t ref)
+{
+  kafs_blkcnt_t blo = kafs_cblk_ref_blo(ref);
+  if (blo >= kafs_sb_r_blkcnt_get(ctx->c_superblock))
+    return -EIO;
+
+  // 追記中のコンテナなら、その追記口のロックでメモリ上の写しを直す。参照を持っている以上
+  // コンテナは一度開かれており、閉じたコンテナは開き直さないので、どの追記口にも無ければ
+  // 閉じている（ブロック番号のストライプで読み書きする）。
+  for (uint32_t i = 0; i < KAFS_CBLK_STRIPES; ++i)
+  {
+    kafs_cblk_open_t *co = &ctx->c_cblk_open[i];
+    if (__atomic_load_n(&co->co_blo, __ATOMIC_ACQUIRE) != blo)
+      continue;
+    kafs_cblk_lock(ctx, i);
+    if (co->co_blo == blo)
+    {
+      int rc = hrl_cblk_slot_release_locked(ctx, ref, co->co_buf, co);
+      kafs_cblk_unlock(ctx, i);
+      return rc;
+    }
+    kafs_cblk_unlock(ctx, i);
+    break;
+  }
+
+  kafs_blksize_t bs = hrl_blksize(ctx);
+  uint32_t stripe = (uint32_t)blo & (KAFS_CBLK_STRIPES - 1u);
+  char blk[bs];
+  kafs_cblk_lock(ctx, stripe);
+  int rc = hrl_pread_blk(ctx, blo, blk);
+  if (rc == 0)
+    rc = hrl_cblk_slot_release_locked(ctx, ref, blk, NULL);
+  kafs_cblk_unlock(ctx, stripe);
+  return rc;
+}
+
+static int hrl_release_blo(kafs_context_t *ctx, kafs_blkcnt_t *pblo)
+{
+  if (!pblo || *pblo == KAFS_BLO_NONE)
+    return 0;
+  if (kafs_cblk_ref_is(*pblo))
+    (void)hrl_cblk_release(ctx, *pblo);
+  else
+    hrl_release_raw_blo(ctx, *pblo);
   *pblo = KAFS_BLO_NONE;
   return 0;
 }
@@ -437,7 +636,7 @@ static int hrl_find_by_hash(kafs_context_t *ctx, uint64_t fast, const void *buf,
   // Guard against corrupted/looping chains: cap iterations.
   for (uint32_t steps = 0; head != 0 && steps < cap; ++steps)
   {
-    __atomic_add_fetch(&ctx->c_stat_hrl_put_chain_steps, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add_rec(ctx, KAFS_STAT_HRL_PUT_CHAIN_STEPS, 1u);
     uint32_t i = head - 1u;
     if (i >= cap)
       return -EIO;
@@ -446,11 +645,11 @@ static int hrl_find_by_hash(kafs_context_t *ctx, uint64_t fast, const void *buf,
       return -EIO;
     if (e->refcnt != 0)
     {
-      __atomic_add_fetch(&ctx->c_stat_hrl_put_cmp_calls, 1u, __ATOMIC_RELAXED);
+      kafs_stat_add_rec(ctx, KAFS_STAT_HRL_PUT_CMP_CALLS, 1u);
       uint64_t t_cmp0 = hrl_now_ns();
       int match = hrl_entry_cmp_content(ctx, e, buf, fast);
       uint64_t t_cmp1 = hrl_now_ns();
-      __atomic_add_fetch(&ctx->c_stat_hrl_put_ns_cmp_content, t_cmp1 - t_cmp0, __ATOMIC_RELAXED);
+      kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_NS_CMP_CONTENT, t_cmp1 - t_cmp0);
       if (match)
       {
         *out_index = i;
@@ -518,7 +717,29 @@ static int hrl_chain_remove(kafs_context_t *ctx, uint32_t idx, uint64_t fast)
   return (head == 0) ? -ENOENT : -EIO;
 }
 
-int kafs_hrl_open(kafs_context_t *ctx)
+int kafs_hrl_rebuild_free_list(kafs_context_t *ctx)
+{
+  if (!ctx || !ctx->c_superblock)
+    return -EINVAL;
+  ctx->c_hrl_free_head_plus1 = 0;
+  ctx->c_hrl_free_slot_count = 0;
+  if (!ctx->c_hrl_index && !hrl_descriptor_mapping_enabled(ctx))
+    return 0;
+  uint32_t cap = hrl_capacity(ctx);
+  for (uint32_t i = cap; i > 0; --i)
+  {
+    uint32_t idx = i - 1u;
+    kafs_hrl_entry_t *e = hrl_entry_ptr(ctx, idx);
+    if (!e)
+      return -EIO;
+    if (hrl_slot_is_reusable(e))
+      hrl_free_list_push_raw(ctx, idx);
+  }
+  return 0;
+}
+
+static int hrl_open_common(kafs_context_t *ctx, int warm, uint32_t free_head_plus1,
+                           uint32_t free_slot_count)
 {
   if (!ctx || !ctx->c_superblock)
     return -EINVAL;
@@ -538,26 +759,51 @@ int kafs_hrl_open(kafs_context_t *ctx)
     ctx->c_hrl_index = (void *)(base + index_off);
     ctx->c_hrl_bucket_cnt = (uint32_t)(index_size / sizeof(uint32_t));
   }
-  ctx->c_hrl_free_head_plus1 = 0;
-  ctx->c_hrl_free_slot_count = 0;
-  uint32_t cap = hrl_capacity(ctx);
-  for (uint32_t i = cap; i > 0; --i)
+  int rc = -ESTALE;
+  if (warm)
   {
-    uint32_t idx = i - 1u;
-    kafs_hrl_entry_t *e = hrl_entry_ptr(ctx, idx);
-    if (!e)
-      return -EIO;
-    if (hrl_slot_is_reusable(e))
-      hrl_free_list_push_raw(ctx, idx);
+    // The free list is threaded through the entries in the image; only its head was kept.
+    uint32_t cap = hrl_capacity(ctx);
+    kafs_hrl_entry_t *e =
+        free_head_plus1 ? hrl_entry_ptr(ctx, free_head_plus1 - 1u) : (kafs_hrl_entry_t *)NULL;
+    if (free_slot_count <= cap && free_head_plus1 <= cap &&
+        (free_head_plus1 == 0 ? free_slot_count == 0 : (e && hrl_slot_is_reusable(e))))
+    {
+      ctx->c_hrl_free_head_plus1 = free_head_plus1;
+      ctx->c_hrl_free_slot_count = free_slot_count;
+      rc = 0;
+    }
+  }
+  if (rc != 0)
+  {
+    rc = kafs_hrl_rebuild_free_list(ctx);
+    if (rc != 0)
+      return rc;
+    if (warm)
+      rc = -ESTALE;
   }
   (void)kafs_ctx_locks_init(ctx);
-  return 0;
+  return rc;
+}
+
+int kafs_hrl_open(kafs_context_t *ctx) { return hrl_open_common(ctx, 0, 0, 0); }
+
+int kafs_hrl_open_warm(kafs_context_t *ctx, uint32_t free_head_plus1, uint32_t free_slot_count)
+{
+  return hrl_open_common(ctx, 1, free_head_plus1, free_slot_count);
 }
 
 int kafs_hrl_close(kafs_context_t *ctx)
 {
-  if (ctx)
-    kafs_ctx_locks_destroy(ctx);
+  if (!ctx)
+    return 0;
+  kafs_ctx_locks_destroy(ctx);
+  for (uint32_t i = 0; i < KAFS_CBLK_STRIPES; ++i)
+  {
+    free(ctx->c_cblk_open[i].co_buf);
+    ctx->c_cblk_open[i].co_buf = NULL;
+    ctx->c_cblk_open[i].co_blo = KAFS_BLO_NONE;
+  }
   return 0;
 }
 
@@ -631,7 +877,7 @@ static int hrl_find_existing_locked(kafs_context_t *ctx, uint64_t fast, const vo
   int find_rc = hrl_find_by_hash(ctx, fast, block_data, &idx);
   uint64_t t_find1 = hrl_now_ns();
 
-  __atomic_add_fetch(&ctx->c_stat_hrl_put_ns_find, t_find1 - t_find0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_NS_FIND, t_find1 - t_find0);
   if (find_rc != 0)
     return find_rc;
 
@@ -641,32 +887,49 @@ static int hrl_find_existing_locked(kafs_context_t *ctx, uint64_t fast, const vo
   return hrl_publish_existing_hit(ctx, e, idx, out_hrid, out_is_new, out_blo);
 }
 
-static int hrl_populate_new_entry_locked(kafs_context_t *ctx, uint32_t idx, uint64_t fast,
-                                         const void *block_data, kafs_blkcnt_t *out_blo)
+/// @brief HRL の新しいエントリ用にブロックを書く（縮むなら圧縮コンテナへ、でなければ生で）
+static int hrl_store_new_blo(kafs_context_t *ctx, const void *block_data, kafs_blkcnt_t *out_blo)
 {
-  kafs_hrl_entry_t *e = hrl_entry_ptr(ctx, idx);
-  if (!e)
-    return -EIO;
+  uint64_t t_blk_write0 = hrl_now_ns();
+  int rc = kafs_cblk_store(ctx, block_data, out_blo);
+  if (rc == 0)
+  {
+    kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_NS_BLK_WRITE, hrl_now_ns() - t_blk_write0);
+    return 0;
+  }
+
   kafs_blkcnt_t blo = KAFS_BLO_NONE;
   uint64_t t_blk_alloc0 = hrl_now_ns();
-  int rc = kafs_blk_alloc(ctx, &blo);
+  rc = kafs_blk_alloc(ctx, &blo);
   uint64_t t_blk_alloc1 = hrl_now_ns();
 
-  __atomic_add_fetch(&ctx->c_stat_hrl_put_ns_blk_alloc, t_blk_alloc1 - t_blk_alloc0,
-                     __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_NS_BLK_ALLOC, t_blk_alloc1 - t_blk_alloc0);
   if (rc != 0)
     return rc;
 
-  uint64_t t_blk_write0 = hrl_now_ns();
+  t_blk_write0 = hrl_now_ns();
   rc = hrl_write_blo(ctx, blo, block_data);
   uint64_t t_blk_write1 = hrl_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_hrl_put_ns_blk_write, t_blk_write1 - t_blk_write0,
-                     __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_NS_BLK_WRITE, t_blk_write1 - t_blk_write0);
   if (rc != 0)
   {
     (void)hrl_release_blo(ctx, &blo);
     return rc;
   }
+  *out_blo = blo;
+  return 0;
+}
+
+static int hrl_populate_new_entry_locked(kafs_context_t *ctx, uint32_t idx, uint64_t fast,
+                                         const void *block_data, kafs_blkcnt_t *out_blo)
+{
+  kafs_hrl_entry_t *e = hrl_entry_ptr(ctx, idx);
+  if (!e)
+    return -EIO;
+  kafs_blkcnt_t blo = KAFS_BLO_NONE;
+  int rc = hrl_store_new_blo(ctx, block_data, &blo);
+  if (rc != 0)
+    return rc;
 
   e->blo = blo;
   e->fast = fast;
@@ -695,7 +958,7 @@ int kafs_hrl_put(kafs_context_t *ctx, const void *block_data, kafs_hrid_t *out_h
   uint64_t t_hash0 = hrl_now_ns();
   uint64_t fast = hrl_hash64(block_data, hrl_blksize(ctx));
   uint64_t t_hash1 = hrl_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_hrl_put_ns_hash, t_hash1 - t_hash0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_NS_HASH, t_hash1 - t_hash0);
   int b = hrl_bucket_index(ctx, fast);
 
   kafs_hrl_bucket_lock(ctx, (uint32_t)b);
@@ -713,7 +976,7 @@ int kafs_hrl_put(kafs_context_t *ctx, const void *block_data, kafs_hrid_t *out_h
   uint32_t reserved_idx = 0;
   int slot_rc = hrl_reserve_free_slot(ctx, &reserved_idx);
   uint64_t t_slot1 = hrl_now_ns();
-  __atomic_add_fetch(&ctx->c_stat_hrl_put_ns_slot_alloc, t_slot1 - t_slot0, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_HRL_PUT_NS_SLOT_ALLOC, t_slot1 - t_slot0);
   if (slot_rc != 0)
     return slot_rc;
 
@@ -926,7 +1189,7 @@ static int hrl_try_dec_ref_in_bucket(kafs_context_t *ctx, uint32_t bucket, uint6
 
 static int hrl_release_legacy_blo(kafs_context_t *ctx, kafs_blkcnt_t blo)
 {
-  if (kafs_blk_get_usage_locked(ctx, blo) == 0)
+  if (kafs_blk_get_usage_locked(ctx, kafs_cblk_phys_blo(blo)) == 0)
     return 0;
   return hrl_release_blo(ctx, &blo);
 }
@@ -91,6 +91,8 @@ static void print_superblock_summary(const kafs_ssuperblock_t *sb)
   printf("tail metadata: enabled=%s off=%" PRIu64 " size=%" PRIu64 "\n",
          (kafs_sb_feature_flags_get(sb) & KAFS_FEATURE_TAIL_META_REGION) ? "true" : "false",
          (uint64_t)kafs_sb_tailmeta_offset_get(sb), (uint64_t)kafs_sb_tailmeta_size_get(sb));
+  printf("compressed data: enabled=%s\n",
+         (kafs_sb_feature_flags_get(sb) & KAFS_FEATURE_COMPRESS) ? "true" : "false");
 }
 
 static void print_tombstone_summary(int fd, const kafs_ssuperblock_t *sb, uint64_t file_size)
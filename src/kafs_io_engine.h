@@ -0,0 +1,221 @@
+#pragma once
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// データブロックの I/O エンジン（-o io_engine）。
+//   mmap   : イメージ全体のマップに memcpy する（従来どおり）
+//   pread  : データブロックは pread / pwrite で読み書きし、マップには触れない
+//   direct : pread に加えて O_DIRECT の fd を使いページキャッシュを通さない
+// どのエンジンでもメタデータ領域はマップのまま。pread / direct では大きなイメージでもデータ側の
+// ページフォルトと、マップ経由で汚れたページのカーネル任せの書き戻しが起きない。
+// 同じファイルへの mmap と pread / pwrite / O_DIRECT はカーネルが一貫性を保つので、マップ経由で
+// データを見る経路（fsck や HRL のコンテナ読み出し）と混ざっても壊れない。ranged fsync の msync は
+// ファイル範囲の fsync になるので、pwrite で汚したページもそのまま書き出される。
+// O_DIRECT はバッファ・オフセット・長さの整列が要るので、整列していないバッファはスレッドごとの
+// 整列済みバッファを経由する。O_DIRECT が EINVAL を返したら（tmpfs、論理ブロックより小さい
+// ブロックなど）通常の fd に落とす。
+
+#define KAFS_IO_DIRECT_ALIGN 4096u
+
+enum
+{
+  KAFS_IO_ENGINE_MMAP = 0,
+  KAFS_IO_ENGINE_PREAD = 1,
+  KAFS_IO_ENGINE_DIRECT = 2,
+};
+
+static inline int kafs_io_engine_parse(const char *s, uint32_t *engine)
+{
+  if (!s || !engine)
+    return -EINVAL;
+  if (strcmp(s, "mmap") == 0)
+    *engine = KAFS_IO_ENGINE_MMAP;
+  else if (strcmp(s, "pread") == 0 || strcmp(s, "pwrite") == 0)
+    *engine = KAFS_IO_ENGINE_PREAD;
+  else if (strcmp(s, "direct") == 0 || strcmp(s, "o_direct") == 0)
+    *engine = KAFS_IO_ENGINE_DIRECT;
+  else
+    return -EINVAL;
+  return 0;
+}
+
+static inline const char *kafs_io_engine_name(uint32_t engine)
+{
+  switch (engine)
+  {
+  case KAFS_IO_ENGINE_MMAP:
+    return "mmap";
+  case KAFS_IO_ENGINE_PREAD:
+    return "pread";
+  case KAFS_IO_ENGINE_DIRECT:
+    return "direct";
+  default:
+    return "unknown";
+  }
+}
+
+/// @brief len バイトを読み切る（EINTR と短い読み出しは続ける）
+/// @return 0: 成功, -EIO: ファイル末尾, < 0: 失敗 (-errno)
+static inline int kafs_io_pread_full(int fd, void *buf, size_t len, off_t off)
+{
+  char *p = (char *)buf;
+  while (len > 0)
+  {
+    ssize_t r = pread(fd, p, len, off);
+    if (r < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    if (r == 0)
+      return -EIO;
+    p += r;
+    off += r;
+    len -= (size_t)r;
+  }
+  return 0;
+}
+
+/// @brief len バイトを書き切る（EINTR と短い書き込みは続ける）
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static inline int kafs_io_pwrite_full(int fd, const void *buf, size_t len, off_t off)
+{
+  const char *p = (const char *)buf;
+  while (len > 0)
+  {
+    ssize_t w = pwrite(fd, p, len, off);
+    if (w < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    if (w == 0)
+      return -EIO;
+    p += w;
+    off += w;
+    len -= (size_t)w;
+  }
+  return 0;
+}
+
+/// @brief O_DIRECT で開く
+/// @return fd, < 0: 失敗 (-errno)。O_DIRECT の無い環境では -ENOTSUP
+static inline int kafs_io_direct_open(const char *path, int flags)
+{
+#ifdef O_DIRECT
+  int fd = open(path, flags | O_DIRECT, 0666);
+  return fd >= 0 ? fd : -errno;
+#else
+  (void)path;
+  (void)flags;
+  return -ENOTSUP;
+#endif
+}
+
+typedef struct kafs_io_bounce
+{
+  void *ib_buf;
+  size_t ib_len;
+} kafs_io_bounce_t;
+
+static pthread_key_t kafs_io_bounce_key;
+static pthread_once_t kafs_io_bounce_once = PTHREAD_ONCE_INIT;
+
+static void kafs_io_bounce_free(void *p)
+{
+  kafs_io_bounce_t *b = (kafs_io_bounce_t *)p;
+  free(b->ib_buf);
+  free(b);
+}
+
+static void kafs_io_bounce_key_init(void)
+{
+  (void)pthread_key_create(&kafs_io_bounce_key, kafs_io_bounce_free);
+}
+
+/// @brief 呼び出しスレッドの整列済みバッファ（len 以上、スレッド終了で解放）
+/// @return バッファ, NULL: メモリ不足
+static inline void *kafs_io_bounce_get(size_t len)
+{
+  pthread_once(&kafs_io_bounce_once, kafs_io_bounce_key_init);
+  kafs_io_bounce_t *b = (kafs_io_bounce_t *)pthread_getspecific(kafs_io_bounce_key);
+  if (!b)
+  {
+    b = (kafs_io_bounce_t *)calloc(1, sizeof(*b));
+    if (!b)
+      return NULL;
+    if (pthread_setspecific(kafs_io_bounce_key, b) != 0)
+    {
+      free(b);
+      return NULL;
+    }
+  }
+  if (b->ib_len < len)
+  {
+    void *p = NULL;
+    if (posix_memalign(&p, KAFS_IO_DIRECT_ALIGN, len) != 0)
+      return NULL;
+    free(b->ib_buf);
+    b->ib_buf = p;
+    b->ib_len = len;
+  }
+  return b->ib_buf;
+}
+
+static inline int kafs_io_aligned(const void *buf, size_t len, off_t off)
+{
+  return ((uintptr_t)buf % KAFS_IO_DIRECT_ALIGN) == 0 && (len % 512u) == 0 &&
+         ((uint64_t)off % 512u) == 0;
+}
+
+/// @brief dfd（O_DIRECT）で読む。使えなければ fd で読み、*fallbacks を数える
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static inline int kafs_io_direct_pread(int dfd, int fd, void *buf, size_t len, off_t off,
+                                       uint64_t *fallbacks)
+{
+  if (dfd >= 0 && (len % 512u) == 0 && ((uint64_t)off % 512u) == 0)
+  {
+    void *io = kafs_io_aligned(buf, len, off) ? buf : kafs_io_bounce_get(len);
+    if (io)
+    {
+      int rc = kafs_io_pread_full(dfd, io, len, off);
+      if (rc == 0 && io != buf)
+        memcpy(buf, io, len);
+      if (rc != -EINVAL)
+        return rc;
+    }
+  }
+  if (fallbacks)
+    __atomic_add_fetch(fallbacks, 1u, __ATOMIC_RELAXED);
+  return kafs_io_pread_full(fd, buf, len, off);
+}
+
+/// @brief dfd（O_DIRECT）で書く。使えなければ fd で書き、*fallbacks を数える
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static inline int kafs_io_direct_pwrite(int dfd, int fd, const void *buf, size_t len, off_t off,
+                                        uint64_t *fallbacks)
+{
+  if (dfd >= 0 && (len % 512u) == 0 && ((uint64_t)off % 512u) == 0)
+  {
+    void *io = kafs_io_aligned(buf, len, off) ? (void *)buf : kafs_io_bounce_get(len);
+    if (io)
+    {
+      if (io != buf)
+        memcpy(io, buf, len);
+      int rc = kafs_io_pwrite_full(dfd, io, len, off);
+      if (rc != -EINVAL)
+        return rc;
+    }
+  }
+  if (fallbacks)
+    __atomic_add_fetch(fallbacks, 1u, __ATOMIC_RELAXED);
+  return kafs_io_pwrite_full(fd, buf, len, off);
+}
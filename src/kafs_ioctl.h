@@ -11,6 +11,12 @@
 
 #define KAFS_IOCTL_MAGIC 'k'
 
+// bg_work_* の添字（kafs_bgsched.h の KAFS_BG_WORK_* と同じ並び）
+#define KAFS_STATS_BG_PENDING 0u
+#define KAFS_STATS_BG_TOMBSTONE_GC 1u
+#define KAFS_STATS_BG_DEDUP 2u
+#define KAFS_STATS_BG_WORK 3u
+
 struct kafs_stats
 {
   uint32_t struct_size;
@@ -161,6 +167,171 @@ struct kafs_stats
   int32_t pending_worker_nice;
   uint32_t bg_dedup_worker_prio_mode;
   int32_t bg_dedup_worker_nice;
+
+  uint32_t prealloc_blocks;
+  uint32_t prealloc_reserved1;
+  uint64_t prealloc_windows;
+  uint64_t prealloc_reserved_blocks;
+  uint64_t prealloc_hits;
+  uint64_t prealloc_misses;
+  uint64_t prealloc_wasted_blocks;
+  uint64_t prealloc_outstanding_blocks;
+
+  uint64_t journal_commits;
+  uint64_t journal_flushes;
+  uint64_t journal_sync_waits;
+  uint64_t journal_gc_window_ns;
+  uint64_t journal_gc_max_window_ns;
+  uint32_t journal_flusher_running;
+  uint32_t journal_uring;
+
+  uint32_t fsync_ranged;
+  uint32_t fsync_reserved1;
+  uint64_t fsync_ranged_calls;
+  uint64_t fsync_full_calls;
+  uint64_t fsync_ranged_bytes;
+  uint64_t fsync_dirty_overflows;
+
+  uint64_t journal_uring_flushes;
+
+  uint32_t meta_hugepage;       // metadata regions advised MADV_HUGEPAGE
+  uint32_t meta_prefault_state; // 0=off 1=running 2=done 3=stopped
+  uint64_t meta_hugepage_bytes;
+  uint64_t meta_prefault_bytes;
+  uint64_t meta_prefault_ns; // wall time spent prefaulting so far
+
+  uint32_t lock_inode_stripes;   // size of the striped inode lock table
+  uint32_t lock_reserved1;
+  uint64_t lock_inode_reentrant; // inode locks that found their stripe already held
+  uint64_t inode_track_bytes;    // sparse open-count + epoch tables
+
+  uint32_t stats_shards;          // per-thread counter shards summed into this snapshot
+  uint32_t stats_record_counters; // 0: per-record counters compiled out (read as 0)
+
+  // Background executor (pending / tombstone GC / bg dedup), indexed by KAFS_STATS_BG_*.
+  uint32_t bg_threads;  // executor threads, both lanes (0: not running)
+  uint32_t bg_busy_pct; // budget share for background work while foreground is busy
+  uint32_t bg_fg_busy;  // last window saw foreground load
+  uint32_t bg_reserved1;
+  uint64_t bg_windows;
+  uint64_t bg_busy_windows;
+  uint64_t bg_fg_ops; // read/write/access/readdir calls seen by the budget probe
+  uint64_t bg_work_runs[KAFS_STATS_BG_WORK];
+  uint64_t bg_work_run_ns[KAFS_STATS_BG_WORK];
+  uint64_t bg_work_throttled[KAFS_STATS_BG_WORK]; // deferred to the next window by the budget
+
+  // Tombstone reclaim queue. While it is ready, tombstone_inodes / oldest come from the queue
+  // without -v.
+  uint32_t tombstone_queue_state; // 0=off 1=ready 2=mount sweep running
+  uint32_t tombstone_reserved1;
+  uint64_t tombstone_reclaimed;     // inodes reclaimed (unlink, last close and GC)
+  uint64_t tombstone_gc_visits;     // queue entries the GC looked at
+  uint64_t tombstone_sweep_scanned; // inodes scanned by the mount-time sweep
+
+  // Background dedup write log: direct (non-HRL) blocks written since bg dedup last looked.
+  uint32_t bg_dedup_log_cap; // 0: no log, every step sweeps the inode table
+  uint32_t bg_dedup_sweep;   // 1: an inode-table sweep is still owed
+  uint64_t bg_dedup_log_pending;
+  uint64_t bg_dedup_log_noted;
+  uint64_t bg_dedup_log_dropped; // lost to overflow (an overflow owes one sweep)
+  uint64_t bg_dedup_log_consumed;
+  uint64_t bg_dedup_log_stale; // block rewritten or freed before bg dedup reached it
+  uint64_t bg_dedup_sweeps;    // completed inode-table sweeps
+
+  // Pending log resolver shards (entries split by inode). bg_work_*[KAFS_STATS_BG_PENDING] sums
+  // every shard.
+  uint32_t pending_workers;
+  uint32_t pending_reserved2;
+  uint64_t pending_resolved_ahead; // resolved while an older entry was still unresolved
+
+  // Per-inode dedup bypass: inodes whose recent HRL hit rate is below dedup_bypass_hit_pct write
+  // straight to direct blocks (bg dedup still sees them through its write log).
+  uint32_t dedup_bypass_sample; // 0: policy off
+  uint32_t dedup_bypass_hit_pct;
+  uint64_t dedup_bypass_blocks; // blocks written direct because of the policy
+  uint64_t dedup_bypass_probes; // bypassed inodes' blocks sent to HRL to re-check the hit rate
+  uint64_t dedup_bypass_enter;  // windows that switched an inode to bypass
+  uint64_t dedup_bypass_leave;  // hits while bypassing that restarted sampling
+  uint64_t dedup_bypass_keep;   // windows that kept an inode on HRL
+
+  // Compressed data blocks (mkfs --compress, -o compress): blocks that shrink by at least a
+  // quarter are packed into shared container blocks.
+  uint32_t compress_enabled;      // feature present and compress=on
+  uint32_t cblk_slots;            // blocks per container
+  uint64_t cblk_stored;           // blocks stored compressed
+  uint64_t cblk_raw;              // blocks that did not shrink enough and were written raw
+  uint64_t cblk_bytes_out;        // compressed bytes written for cblk_stored
+  uint64_t cblk_containers;       // container blocks allocated
+  uint64_t cblk_containers_freed; // container blocks freed after their last slot
+  uint64_t cblk_read_hits;        // compressed reads served from the decode cache
+  uint64_t cblk_read_decodes;     // compressed reads that decoded a slot
+  uint64_t lock_cblk_acquire;
+  uint64_t lock_cblk_contended;
+  uint64_t lock_cblk_wait_ns;
+
+  // Block cache of decoded blocks keyed by data ref (-o blk_cache_mb).
+  uint64_t blk_cache_bytes;         // 0: cache off
+  uint64_t blk_cache_hits;
+  uint64_t blk_cache_misses;
+  uint64_t blk_cache_inserts;
+  uint64_t blk_cache_evictions;     // entries pushed out by the clock hand
+  uint64_t blk_cache_invalidations; // entries dropped because their block or slot was released
+
+  // Data block I/O engine (-o io_engine).
+  uint32_t io_engine; // 0=mmap 1=pread 2=direct
+  uint32_t io_reserved1;
+  uint64_t io_read_blocks;      // data blocks read through the engine
+  uint64_t io_write_blocks;     // data blocks written through the engine
+  uint64_t io_direct_fallbacks; // O_DIRECT refused (EINVAL) and redone through the page cache
+
+  // Memory budget (-o mem_budget) and in-process footprint by component, in bytes.
+  uint64_t mem_budget;            // 0 = unlimited
+  uint64_t mem_blk_cache_bytes;   // block cache slots and data
+  uint64_t mem_lock_bytes;        // HRL bucket mutexes and inode lock stripes
+  uint64_t mem_track_bytes;       // sparse per-inode tables (open count, epoch, dedup, reclaim)
+  uint64_t mem_meta_bitmap_bytes; // bitmap copy for metadata delta journaling
+  uint64_t mem_fixed_bytes;       // fixed-size tables (bg dedup index/log, dirty ranges, stats)
+  uint32_t mem_hrl_locks;         // HRL bucket mutexes (fewer than buckets when striped)
+  uint32_t mem_reserved1;
+  uint64_t mem_meta_resident; // metadata map pages resident at the last trim pass
+  uint64_t mem_meta_target;   // resident metadata the trim aims for (0: no trim)
+  uint64_t mem_trim_runs;
+  uint64_t mem_cold_bytes;    // advised MADV_COLD after one idle pass
+  uint64_t mem_pageout_bytes; // advised MADV_PAGEOUT while over the target
+
+  // Hotplug RPC shared-memory data plane (KAFS_HOTPLUG_DATA_MODE=shm).
+  uint32_t hotplug_shm_slots; // 0: ring not attached to the current back
+  uint32_t hotplug_shm_slot_size;
+  uint64_t hotplug_shm_reads;
+  uint64_t hotplug_shm_writes;
+  uint64_t hotplug_shm_bytes;
+  uint64_t hotplug_shm_slot_misses; // no free slot; the request went inline or local
+
+  // Hotplug RPC pipelining: calls from FUSE threads share the socket, matched by req_id.
+  uint64_t hotplug_rpc_calls;
+  uint64_t hotplug_rpc_handoffs;     // responses read by another waiting caller and handed over
+  uint64_t hotplug_rpc_orphans;      // responses whose caller had already been failed
+  uint32_t hotplug_rpc_inflight;     // outstanding calls right now
+  uint32_t hotplug_rpc_inflight_max; // most outstanding calls seen at once
+
+  // Namespace and metadata ops forwarded to a back with the NS feature.
+  uint64_t hotplug_ns_calls;
+  uint64_t hotplug_ns_readdir_chunks; // READDIR round trips
+  uint64_t hotplug_ns_multi_attrs;    // entry attributes fetched by GETATTR_MULTI (readdirplus)
+
+  // Hotplug RPC transport: batched sends and read-ahead receives on the front's socket.
+  uint64_t hotplug_rpc_tx_msgs;
+  uint64_t hotplug_rpc_tx_batches; // sendmsg calls carrying those messages
+  uint64_t hotplug_rpc_rx_msgs;
+  uint64_t hotplug_rpc_rx_syscalls; // recvmsg calls carrying those messages
+  uint32_t hotplug_rpc_tx_batch_max;
+  uint32_t hotplug_rpc_max_payload; // body limit agreed with the current back
+
+  // Explicit back restarts: warm ones hand the old back's runtime state to the new one.
+  uint64_t hotplug_warm_restarts;
+  uint64_t hotplug_cold_restarts;
+  uint32_t hotplug_warm_state_bytes; // size of the last state handed over
+  uint32_t hotplug_reserved1;
 };
 
 typedef struct kafs_stats kafs_stats_t;
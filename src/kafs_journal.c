@@ -1,7 +1,9 @@
 #include "kafs_journal.h"
 #include "kafs_context.h"
 #include "kafs_locks.h"
+#include "kafs_mmap_io.h"
 #include "kafs_superblock.h"
+#include "kafs_uring.h"
 #include "kafs_v6_layout.h"
 
 #include <stdio.h>
@@ -11,7 +13,9 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <sched.h>
 #include <inttypes.h>
 
 #ifdef __has_include
@@ -57,7 +61,14 @@ typedef struct journal_state
 
 static journal_state_t g_state = {0};
 
-static int kj_write_record(kafs_journal_t *j, uint32_t tag, uint64_t seq, const char *payload);
+static int kj_write_recordv(kafs_journal_t *j, uint32_t tag, uint64_t seq,
+                            const struct iovec *parts, int nparts);
+static int kj_write_record(kafs_journal_t *j, uint32_t tag, uint64_t seq, const void *payload,
+                           size_t len);
+static void kj_persist_header(kafs_journal_t *j, int do_fsync);
+
+// Dirty bitmap words that fit here are journaled without touching the heap.
+#define KJ_MDT_INLINE_WORDS 32u
 
 typedef struct kj_meta_snapshot
 {
@@ -66,17 +77,19 @@ typedef struct kj_meta_snapshot
   kafs_time_t wtime;
   uint32_t wtime_dirty;
   size_t word_count;
-  uint32_t *word_idx;
-  kafs_blkmask_t *word_val;
+  kj_mdt_word_t *words; // inline_words or heap
+  kj_mdt_word_t inline_words[KJ_MDT_INLINE_WORDS];
 } kj_meta_snapshot_t;
 
 static void kj_meta_snapshot_clear(kj_meta_snapshot_t *s)
 {
   if (!s)
     return;
-  free(s->word_idx);
-  free(s->word_val);
-  memset(s, 0, sizeof(*s));
+  if (s->words && s->words != s->inline_words)
+    free(s->words);
+  s->words = NULL;
+  s->word_count = 0;
+  s->valid = 0;
 }
 
 static int kj_collect_meta_snapshot(struct kafs_context *ctx, kj_meta_snapshot_t *out)
@@ -106,29 +119,22 @@ static int kj_collect_meta_snapshot(struct kafs_context *ctx, kj_meta_snapshot_t
       ctx->c_meta_bitmap_wordcnt > 0 && ctx->c_meta_bitmap_dirty_count > 0)
   {
     size_t dirty_count = ctx->c_meta_bitmap_dirty_count;
-    out->word_idx = (uint32_t *)calloc(dirty_count, sizeof(uint32_t));
-    out->word_val = (kafs_blkmask_t *)calloc(dirty_count, sizeof(kafs_blkmask_t));
-    if (out->word_idx && out->word_val)
+    out->words = (dirty_count <= KJ_MDT_INLINE_WORDS)
+                     ? out->inline_words
+                     : (kj_mdt_word_t *)calloc(dirty_count, sizeof(kj_mdt_word_t));
+    if (out->words)
     {
       size_t n = 0;
       for (size_t i = 0; i < ctx->c_meta_bitmap_wordcnt && n < dirty_count; ++i)
       {
         if (!ctx->c_meta_bitmap_dirty[i])
           continue;
-        out->word_idx[n] = (uint32_t)i;
-        out->word_val[n] = ctx->c_meta_bitmap_words[i];
+        out->words[n].idx = (uint32_t)i;
+        out->words[n].val = (uint64_t)ctx->c_meta_bitmap_words[i];
         ++n;
       }
       out->word_count = n;
     }
-    else
-    {
-      free(out->word_idx);
-      free(out->word_val);
-      out->word_idx = NULL;
-      out->word_val = NULL;
-      out->word_count = 0;
-    }
   }
 
   kafs_bitmap_unlock(ctx);
@@ -142,38 +148,56 @@ static int kj_write_meta_delta_record(kafs_journal_t *j, uint64_t seq, const kj_
   if (!j || !s || !s->valid)
     return 0;
 
-  size_t cap = 160u + (s->word_count * 44u);
-  char *payload = (char *)calloc(cap, 1u);
-  if (!payload)
-    return -ENOMEM;
+  kj_mdt_hdr_t mh = {
+      .free_abs = (uint64_t)s->free_abs,
+      .wtime_sec = (int64_t)s->wtime.tv_sec,
+      .wtime_nsec = (uint32_t)s->wtime.tv_nsec,
+      .flags = s->wtime_dirty ? KJ_MDT_FLAG_WTIME_DIRTY : 0u,
+      .word_count = (uint32_t)s->word_count,
+      .reserved = 0,
+  };
+  struct iovec parts[2] = {
+      {.iov_base = &mh, .iov_len = sizeof(mh)},
+      {.iov_base = (void *)s->words, .iov_len = s->word_count * sizeof(kj_mdt_word_t)},
+  };
+  return kj_write_recordv(j, KJ_TAG_MDT, seq, parts, s->word_count ? 2 : 1);
+}
 
-  int n = snprintf(payload, cap,
-                   "free_abs=%" PRIuFAST32 " wtime_dirty=%u wtime_sec=%lld "
-                   "wtime_nsec=%ld wc=%zu words=",
-                   s->free_abs, s->wtime_dirty, (long long)s->wtime.tv_sec, s->wtime.tv_nsec,
-                   s->word_count);
-  if (n < 0)
-  {
-    free(payload);
-    return -EINVAL;
-  }
-  size_t off = (size_t)n;
+static void kj_replay_apply_sb(struct kafs_context *ctx, uint64_t free_abs, int wtime_dirty,
+                               kafs_time_t wtime)
+{
+  kafs_blkcnt_t blkcnt = kafs_sb_blkcnt_get(ctx->c_superblock);
+  if (free_abs > (uint64_t)blkcnt)
+    free_abs = (uint64_t)blkcnt;
+  kafs_sb_blkcnt_free_set(ctx->c_superblock, (kafs_blkcnt_t)free_abs);
+  kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_SUPERBLOCK_CHECKPOINT,
+                            sizeof(ctx->c_superblock->s_blkcnt_free));
 
-  for (size_t i = 0; i < s->word_count && off < cap; ++i)
+  if (wtime_dirty)
   {
-    int m = snprintf(payload + off, cap - off, "%s%u:%" PRIxMAX, (i == 0) ? "" : ",",
-                     s->word_idx[i], (uintmax_t)s->word_val[i]);
-    if (m < 0)
-      break;
-    off += (size_t)m;
+    kafs_sb_wtime_set(ctx->c_superblock, wtime);
+    kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_SUPERBLOCK_CHECKPOINT,
+                              sizeof(ctx->c_superblock->s_wtime));
   }
+}
 
-  int rc = kj_write_record(j, KJ_TAG_MDT, seq, payload);
-  free(payload);
-  return rc;
+static size_t kj_replay_bitmap_wordcnt(struct kafs_context *ctx)
+{
+  size_t bits = sizeof(kafs_blkmask_t) * 8u;
+  return ((size_t)kafs_sb_blkcnt_get(ctx->c_superblock) + bits - 1u) / bits;
 }
 
-static void kj_replay_apply_meta_delta(struct kafs_context *ctx, const char *payload)
+static void kj_replay_apply_word(struct kafs_context *ctx, size_t wordcnt, uint32_t idx,
+                                 uint64_t val)
+{
+  if ((size_t)idx >= wordcnt)
+    return;
+  ctx->c_blkmasktbl[idx] = (kafs_blkmask_t)val;
+  kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_BLOCK_BITMAP, sizeof(ctx->c_blkmasktbl[idx]));
+}
+
+// v2 rings carry "free_abs=... words=idx:hex,..." text; parsed only when replaying an old image.
+static void kj_replay_apply_meta_delta_text(struct kafs_context *ctx, const char *payload)
 {
   if (!ctx || !payload || !*payload)
     return;
@@ -196,28 +220,15 @@ static void kj_replay_apply_meta_delta(struct kafs_context *ctx, const char *pay
   if (p)
     (void)sscanf(p, "wtime_nsec=%ld", &wtime_nsec);
 
-  kafs_blkcnt_t blkcnt = kafs_sb_blkcnt_get(ctx->c_superblock);
-  if (free_abs > (uint64_t)blkcnt)
-    free_abs = (uint64_t)blkcnt;
-  kafs_sb_blkcnt_free_set(ctx->c_superblock, (kafs_blkcnt_t)free_abs);
-  kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_SUPERBLOCK_CHECKPOINT,
-                            sizeof(ctx->c_superblock->s_blkcnt_free));
-
-  if (wtime_dirty)
-  {
-    kafs_time_t wt = {.tv_sec = (time_t)wtime_sec, .tv_nsec = wtime_nsec};
-    kafs_sb_wtime_set(ctx->c_superblock, wt);
-    kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_SUPERBLOCK_CHECKPOINT,
-                              sizeof(ctx->c_superblock->s_wtime));
-  }
+  kj_replay_apply_sb(ctx, free_abs, wtime_dirty != 0,
+                     (kafs_time_t){.tv_sec = (time_t)wtime_sec, .tv_nsec = wtime_nsec});
 
   const char *w = strstr(payload, "words=");
   if (!w)
     return;
   w += 6;
 
-  size_t bits = sizeof(kafs_blkmask_t) * 8u;
-  size_t wordcnt = ((size_t)kafs_sb_blkcnt_get(ctx->c_superblock) + bits - 1u) / bits;
+  size_t wordcnt = kj_replay_bitmap_wordcnt(ctx);
 
   char *copy = strdup(w);
   if (!copy)
@@ -230,10 +241,7 @@ static void kj_replay_apply_meta_delta(struct kafs_context *ctx, const char *pay
     uintmax_t val = 0;
     if (sscanf(tok, "%u:%" SCNxMAX, &idx, &val) != 2)
       continue;
-    if ((size_t)idx >= wordcnt)
-      continue;
-    ctx->c_blkmasktbl[idx] = (kafs_blkmask_t)val;
-    kafs_ctx_meta_write_count(ctx, KAFS_META_REGION_BLOCK_BITMAP, sizeof(ctx->c_blkmasktbl[idx]));
+    kj_replay_apply_word(ctx, wordcnt, idx, (uint64_t)val);
   }
   free(copy);
 }
@@ -301,19 +309,6 @@ static uint64_t nsec_now_mono(void)
   return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 }
 
-static void sleep_ns(uint64_t ns)
-{
-  if (ns == 0)
-    return;
-  struct timespec req;
-  req.tv_sec = (time_t)(ns / 1000000000ull);
-  req.tv_nsec = (long)(ns % 1000000000ull);
-  while (nanosleep(&req, &req) == -1 && errno == EINTR)
-  {
-    // retry with remaining time in req
-  }
-}
-
 static int jlock(kafs_journal_t *j)
 {
 #if KAFS_JOURNAL_HAS_PTHREAD
@@ -366,10 +361,14 @@ typedef enum
 } kj_sidecar_kind_t;
 
 static void kj_write_sidecar_tsline(kafs_journal_t *j, kj_sidecar_kind_t kind, uint64_t seq,
-                                    const char *op, const char *opt_fmt, va_list opt_ap)
+                                    const uint8_t *payload, size_t len)
 {
   if (j->fd < 0)
     return;
+  kj_op_hdr_t oh = {0};
+  if (len >= sizeof(oh))
+    memcpy(&oh, payload, sizeof(oh));
+  const char *op = kj_op_name(oh.op);
   struct timespec ts;
   timespec_now(&ts);
   char prefix[160];
@@ -388,10 +387,11 @@ static void kj_write_sidecar_tsline(kafs_journal_t *j, kj_sidecar_kind_t kind, u
              ts.tv_nsec);
     break;
   }
-  dprintf(j->fd, "%s", prefix);
-  if (opt_fmt && *opt_fmt)
-    vdprintf(j->fd, opt_fmt, opt_ap);
-  dprintf(j->fd, "\n");
+  // The sidecar is a human-readable debug log, so it renders the encoded fields back to text.
+  char args[1024] = "";
+  if (len > sizeof(oh))
+    (void)kj_format_fields(payload + sizeof(oh), len - sizeof(oh), args, sizeof(args), 0);
+  dprintf(j->fd, "%s%s\n", prefix, args);
   fsync(j->fd);
 }
 
@@ -420,6 +420,16 @@ static int kj_pwrite_nosync(int fd, const void *buf, size_t sz, off_t off)
   return (w == (ssize_t)sz) ? 0 : -EIO;
 }
 
+static int kj_pwritev(int fd, const struct iovec *iov, int cnt, size_t sz, off_t off, int do_fsync)
+{
+  ssize_t w = pwritev(fd, iov, cnt, off);
+  if (w != (ssize_t)sz)
+    return -EIO;
+  if (do_fsync)
+    fsync(fd);
+  return 0;
+}
+
 static void kj_count_meta_write(uint32_t region, uint64_t bytes)
 {
   kafs_ctx_meta_write_count(g_state.ctx, region, bytes);
@@ -495,6 +505,16 @@ static int kj_header_load_best(kafs_journal_t *j, kj_header_t *out)
 
   j->active_header_slot = best_slot;
   j->header_generation = best.reserved0;
+  // The slot after the newest valid one is where a torn header write lands; skip the generation
+  // it may carry instead of reissuing it.
+  if (j->header_slot_count > 1u)
+  {
+    kj_header_t next;
+    uint32_t next_slot = (best_slot + 1u) % j->header_slot_count;
+    if (kj_header_load_slot(j, next_slot, &next) == 0 && next.magic == KJ_MAGIC &&
+        !kj_header_valid_for_area(&next, j->area_size))
+      j->header_generation = best.reserved0 + 1u;
+  }
   if (out)
     *out = best;
   return 0;
@@ -504,21 +524,25 @@ static void kj_header_build(const kafs_journal_t *j, kj_header_t *hdr, uint64_t
 {
   *hdr = (kj_header_t){
       .magic = KJ_MAGIC,
-      .version = KJ_VER,
+      .version = j->rec_version,
       .flags = (j->header_slot_count > 1u) ? KJ_HEADER_FLAG_ROTATED : 0u,
       .area_size = j->area_size,
       .write_off = j->write_off,
-      .seq = j->seq,
+      .seq = __atomic_load_n(&j->seq, __ATOMIC_RELAXED),
       .reserved0 = generation,
       .header_crc = 0,
   };
   hdr->header_crc = kj_header_crc_calc(hdr);
 }
 
+static uint32_t kj_header_next_slot(const kafs_journal_t *j)
+{
+  return (j->header_slot_count > 1u) ? ((j->active_header_slot + 1u) % j->header_slot_count) : 0u;
+}
+
 static int kj_header_store_next(kafs_journal_t *j, int do_fsync)
 {
-  uint32_t slot =
-      (j->header_slot_count > 1u) ? ((j->active_header_slot + 1u) % j->header_slot_count) : 0u;
+  uint32_t slot = kj_header_next_slot(j);
   uint64_t generation = j->header_generation + 1u;
   kj_header_t hdr;
 
@@ -557,9 +581,12 @@ static int kj_init_or_load(kafs_journal_t *j)
   {
     j->write_off = hdr.write_off;
     j->seq = hdr.seq;
+    // An empty ring holds no old-format records, so it switches to KJ_VER on the next header write.
+    j->rec_version = (hdr.write_off == 0) ? KJ_VER : hdr.version;
     return 0;
   }
   // initialize fresh header
+  j->rec_version = KJ_VER;
   j->write_off = 0;
   j->seq = 0;
   j->active_header_slot = (j->header_slot_count > 1u) ? (j->header_slot_count - 1u) : 0u;
@@ -575,78 +602,603 @@ static void kj_persist_header(kafs_journal_t *j, int do_fsync)
   (void)kj_header_store_next(j, do_fsync);
 }
 
-static int kj_ring_write(kafs_journal_t *j, const void *data, size_t len, int do_fsync)
+// ----------------------
+// Lock-free ring reservation
+// ----------------------
+// 書き手は ring_resv の CAS だけで {ticket, lap, offset} を予約し、レコードの組み立て・CRC・pwritev を
+// ロック外（自スレッドのスタック上）で行って完了スロットに ticket を公開する。write_off / write_seq と
+// ヘッダは、完了スロットを ticket 順に取り込む側（flusher またはインライン flush、jlock 下）だけが進める。
+// 未公開の範囲（公開済み位置から予約カーソルまで）は上書きしない。
+
+#define KJ_RING_SLOTS 256u // in-flight records; must stay below the ticket modulus
+#define KJ_RESV_OFF_BITS 40
+#define KJ_RESV_OFF_MASK ((1ull << KJ_RESV_OFF_BITS) - 1u)
+#define KJ_RESV_LAP_BIT (1ull << KJ_RESV_OFF_BITS)
+#define KJ_RESV_TICKET_SHIFT (KJ_RESV_OFF_BITS + 1)
+#define KJ_RESV_TICKET_MASK ((1ull << (64 - KJ_RESV_TICKET_SHIFT)) - 1u)
+#define KJ_RESV_NO_WRAP UINT64_MAX
+
+typedef struct kj_ring_slot
+{
+  uint64_t done; // ticket + 1 once the record is on disk
+  uint64_t end;  // {lap, offset} just past the record
+} kj_ring_slot_t;
+
+typedef struct kj_ring_resv
 {
-  if (!j->use_inimage)
+  uint64_t ticket;
+  uint64_t off;      // record start within the ring
+  uint64_t wrap_off; // unused tail this reservation skipped, or KJ_RESV_NO_WRAP
+  uint64_t end;      // {lap, offset} after the record
+} kj_ring_resv_t;
+
+static uint64_t kj_resv_pack(uint64_t ticket, uint64_t pos)
+{
+  return ((ticket & KJ_RESV_TICKET_MASK) << KJ_RESV_TICKET_SHIFT) |
+         (pos & (KJ_RESV_LAP_BIT | KJ_RESV_OFF_MASK));
+}
+
+/// @brief 予約語の切り詰めた ticket を公開済み数 pub 基準で 64bit に戻す（未公開は KJ_RING_SLOTS 未満）
+static uint64_t kj_resv_ticket(uint64_t word, uint64_t pub)
+{
+  uint64_t t = word >> KJ_RESV_TICKET_SHIFT;
+  return pub + ((t - pub) & KJ_RESV_TICKET_MASK);
+}
+
+static void kj_ring_reset_cursor(kafs_journal_t *j)
+{
+  j->ring_pub_pos = j->write_off;
+  __atomic_store_n(&j->ring_resv, kj_resv_pack(j->write_seq, j->write_off), __ATOMIC_RELEASE);
+}
+
+/// @brief 予約済み（書込み中を含む）レコード数
+static uint64_t kj_ring_reserved(kafs_journal_t *j)
+{
+  uint64_t pub = __atomic_load_n(&j->write_seq, __ATOMIC_ACQUIRE);
+  return kj_resv_ticket(__atomic_load_n(&j->ring_resv, __ATOMIC_ACQUIRE), pub);
+}
+
+/// @brief 完了スロットを ticket 順に取り込み write_off / write_seq を進める（jlock 下）
+static void kj_ring_publish_locked(kafs_journal_t *j)
+{
+  kj_ring_slot_t *slots = (kj_ring_slot_t *)j->ring_slots;
+  if (!slots)
+    return;
+  uint64_t pub = j->write_seq;
+  uint64_t pos = j->ring_pub_pos;
+  for (;;)
+  {
+    kj_ring_slot_t *sl = &slots[pub % KJ_RING_SLOTS];
+    if (__atomic_load_n(&sl->done, __ATOMIC_ACQUIRE) != pub + 1u)
+      break;
+    pos = sl->end;
+    ++pub;
+  }
+  if (pub == j->write_seq)
+    return;
+  j->write_off = pos & KJ_RESV_OFF_MASK;
+  __atomic_store_n(&j->ring_pub_pos, pos, __ATOMIC_RELEASE);
+  __atomic_store_n(&j->write_seq, pub, __ATOMIC_RELEASE);
+}
+
+/// @brief 予約できないとき: 取り込みを進めてから譲る。まだ何も予約していないので jlock を取っても
+/// 書込み中のレコードの完了待ちと循環しない。
+static void kj_ring_backoff(kafs_journal_t *j)
+{
+  jlock(j);
+  kj_ring_publish_locked(j);
+  junlock(j);
+  sched_yield();
+}
+
+static void kj_ring_reserve(kafs_journal_t *j, uint64_t len, kj_ring_resv_t *out)
+{
+  const uint64_t area = j->area_size;
+  for (;;)
+  {
+    // Published state first: it only moves forward, so a stale value overestimates the backlog.
+    uint64_t pub = __atomic_load_n(&j->write_seq, __ATOMIC_ACQUIRE);
+    uint64_t pub_pos = __atomic_load_n(&j->ring_pub_pos, __ATOMIC_ACQUIRE);
+    uint64_t cur = __atomic_load_n(&j->ring_resv, __ATOMIC_ACQUIRE);
+    uint64_t ticket = kj_resv_ticket(cur, pub);
+    uint64_t lap = cur & KJ_RESV_LAP_BIT;
+    uint64_t off = cur & KJ_RESV_OFF_MASK;
+    uint64_t pub_off = pub_pos & KJ_RESV_OFF_MASK;
+    uint64_t used = (lap == (pub_pos & KJ_RESV_LAP_BIT)) ? off - pub_off : area - pub_off + off;
+
+    uint64_t start = off;
+    uint64_t wrap = KJ_RESV_NO_WRAP;
+    uint64_t need = len;
+    if (len > area - off)
+    {
+      wrap = off;
+      start = 0;
+      need += area - off;
+      lap ^= KJ_RESV_LAP_BIT;
+    }
+    // Everything published: the whole ring is free. Otherwise stay clear of unpublished bytes.
+    if (ticket - pub >= KJ_RING_SLOTS || (used && used + need >= area))
+    {
+      kj_ring_backoff(j);
+      continue;
+    }
+    uint64_t end = lap | (start + len);
+    if (__atomic_compare_exchange_n(&j->ring_resv, &cur, kj_resv_pack(ticket + 1u, end), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      out->ticket = ticket;
+      out->off = start;
+      out->wrap_off = wrap;
+      out->end = end;
+      return;
+    }
+  }
+}
+
+static void kj_gc_kick_waiters(kafs_journal_t *j);
+
+// Ticket of the last record this thread appended (COMMIT reads it right after writing CMT).
+static __thread uint64_t kj_tls_last_ticket;
+
+/// @brief 予約したレコードを書き込み完了スロットに公開する。書込み失敗でも ticket 順の取り込みを
+/// 止めないよう公開はする（壊れたレコードはリプレイ時に CRC 不一致で走査が止まる）。
+static int kj_ring_writev(kafs_journal_t *j, const struct iovec *iov, int cnt, size_t len)
+{
+  if (!j->use_inimage || !j->ring_slots)
     return -EINVAL;
-  uint64_t remaining = j->area_size - j->write_off;
-  if ((uint64_t)len > remaining)
+  if ((uint64_t)len > j->area_size)
+    return -ENOSPC;
+
+  kj_ring_resv_t r;
+  kj_ring_reserve(j, (uint64_t)len, &r);
+  int rc = 0;
+  if (r.wrap_off != KJ_RESV_NO_WRAP && j->area_size - r.wrap_off >= sizeof(kj_rec_hdr_t))
   {
-    // write WRAP marker if space allows
     kj_rec_hdr_t wrap = {.tag = KJ_TAG_WRAP, .size = 0, .seq = 0};
-    if (remaining >= sizeof(wrap))
-    {
-      if (kj_pwrite_nosync(j->fd, &wrap, sizeof(wrap), (off_t)(j->data_off + j->write_off)) != 0)
-        return -EIO;
+    if (kj_pwrite_nosync(j->fd, &wrap, sizeof(wrap), (off_t)(j->data_off + r.wrap_off)) == 0)
       kj_count_meta_write(KAFS_META_REGION_JOURNAL_DATA, sizeof(wrap));
-    }
-    j->write_off = 0;
+    else
+      rc = -EIO;
+  }
+  if (kj_pwritev(j->fd, iov, cnt, len, (off_t)(j->data_off + r.off), 0) == 0)
+    kj_count_meta_write(KAFS_META_REGION_JOURNAL_DATA, len);
+  else
+    rc = -EIO;
+
+  kj_ring_slot_t *sl = &((kj_ring_slot_t *)j->ring_slots)[r.ticket % KJ_RING_SLOTS];
+  sl->end = r.end;
+  __atomic_store_n(&sl->done, r.ticket + 1u, __ATOMIC_RELEASE);
+  kj_tls_last_ticket = r.ticket;
+  kj_gc_kick_waiters(j);
+  return rc;
+}
+
+// ----------------------
+// Group commit
+// ----------------------
+// COMMIT は記録を追記して flusher を起こすだけで戻る。flusher はコミット到着間隔から決めた窓だけ
+// 待ち、完了スロットを取り込んでヘッダを書き、1 回の fsync でそれまでの記録をまとめて耐久化して
+// durable_seq を進める。fsync 呼び出し側は呼び出し時点までに予約された記録が耐久化されるまで
+// 条件変数で待つ（同時に来た呼び出しは同じ fsync を共有する）。
+
+#define KJ_GC_DELAY_DEFAULT_NS 10000000ull // 10ms
+#define KJ_GC_DELAY_MAX_NS 1000000000ull   // 1s
+#define KJ_GC_BATCH_TARGET 8u              // commits one window aims to gather
+#define KJ_GC_EWMA_SHIFT 3                 // gap average weight: 1/8
+#define KJ_GC_INFLIGHT_POLL_NS 50000ull    // recheck while earlier records are still being written
+
+#if KAFS_JOURNAL_HAS_PTHREAD
+typedef struct kj_flusher
+{
+  pthread_cond_t kick;    // commit/waiter arrived or stop requested
+  pthread_cond_t durable; // durable_seq advanced (or a flush failed)
+  pthread_t tid;
+  int stop;
+  // io_uring backend, owned by the flusher thread (fd < 0: pwrite + fsync)
+  kafs_uring_t uring;
+  kj_header_t uring_hdr;
+  struct iovec uring_iov;
+} kj_flusher_t;
+#endif
+
+/// @brief コミット到着を記録し、到着間隔の移動平均から次の窓を決める。
+/// 書き手がロックなしで更新するので値は近似（relaxed）でよい。
+static void kj_gc_note_arrival(kafs_journal_t *j, uint64_t now)
+{
+  uint64_t cap = j->gc_delay_ns * 2u;
+  uint64_t last = __atomic_exchange_n(&j->gc_last_ns, now, __ATOMIC_RELAXED);
+  uint64_t gap = (last && now > last) ? now - last : cap;
+  if (gap > cap)
+    gap = cap;
+  uint64_t avg = __atomic_load_n(&j->gc_gap_ewma_ns, __ATOMIC_RELAXED);
+  avg = avg ? avg - (avg >> KJ_GC_EWMA_SHIFT) + (gap >> KJ_GC_EWMA_SHIFT) : gap;
+  __atomic_store_n(&j->gc_gap_ewma_ns, avg, __ATOMIC_RELAXED);
+
+  // Fewer than two more commits expected within the max window: waiting only adds latency.
+  uint64_t w = avg * KJ_GC_BATCH_TARGET;
+  if (avg * 2u >= j->gc_delay_ns)
+    w = 0;
+  __atomic_store_n(&j->gc_window_ns, (w < j->gc_delay_ns) ? w : j->gc_delay_ns,
+                   __ATOMIC_RELAXED);
+}
+
+/// @brief 稼働中（停止要求前）の flusher。NULL ならその場で fsync する。
+static void *kj_gc_flusher_live(kafs_journal_t *j)
+{
+#if KAFS_JOURNAL_HAS_PTHREAD
+  kj_flusher_t *f = (kj_flusher_t *)__atomic_load_n(&j->gc_flusher, __ATOMIC_ACQUIRE);
+  return (f && !__atomic_load_n(&f->stop, __ATOMIC_ACQUIRE)) ? f : NULL;
+#else
+  (void)j;
+  return NULL;
+#endif
+}
+
+static void kj_gc_kick_locked(kafs_journal_t *j)
+{
+#if KAFS_JOURNAL_HAS_PTHREAD
+  kj_flusher_t *f = (kj_flusher_t *)kj_gc_flusher_live(j);
+  if (f)
+    pthread_cond_signal(&f->kick);
+#else
+  (void)j;
+#endif
+}
+
+/// @brief fsync 待ちがいるときだけ、書き終えたことを flusher に知らせる
+static void kj_gc_kick_waiters(kafs_journal_t *j)
+{
+  if (!__atomic_load_n(&j->gc_waiters, __ATOMIC_ACQUIRE))
+    return;
+  jlock(j);
+  kj_gc_kick_locked(j);
+  junlock(j);
+}
+
+static void kj_gc_broadcast_durable(kafs_journal_t *j)
+{
+#if KAFS_JOURNAL_HAS_PTHREAD
+  kj_flusher_t *f = (kj_flusher_t *)j->gc_flusher;
+  if (f)
+    pthread_cond_broadcast(&f->durable);
+#else
+  (void)j;
+#endif
+}
+
+/// @brief リングの耐久化範囲を求める
+/// ranged fsync が有効ならリングの範囲（最大 2 つ）、無効なら 0（イメージ全体を fsync する）。
+static int kj_sync_ranges(const kafs_journal_t *j, uint64_t off[2], uint64_t len[2])
+{
+  struct kafs_context *ctx = g_state.ctx;
+  if (!j->use_inimage || !ctx || !ctx->c_dirty_tbl)
+    return 0;
+  uint64_t hsz = (uint64_t)kj_header_size();
+  if (j->descriptor_backed)
+  {
+    off[0] = j->base_off;
+    len[0] = hsz;
+    off[1] = j->data_off;
+    len[1] = j->area_size;
+    return 2;
+  }
+  // Legacy layout: header slot 0, data area, then the remaining header slots.
+  uint64_t end = j->data_off + j->area_size;
+  if (j->header_slot_count > 1u)
+    end = kj_header_slot_offset(j->base_off, j->area_size, j->header_slot_count - 1u) + hsz;
+  off[0] = j->base_off;
+  len[0] = end - j->base_off;
+  return 1;
+}
+
+/// @brief リング（ヘッダスロットとデータ領域）を耐久化する
+/// ranged fsync が有効ならリングの範囲だけを msync し、無効ならイメージ全体を fsync する。
+static int kj_sync_ring(kafs_journal_t *j)
+{
+  uint64_t off[2], len[2];
+  int n = kj_sync_ranges(j, off, len);
+  if (n == 0)
+    return (fsync(j->fd) == 0) ? 0 : -errno;
+  for (int i = 0; i < n; ++i)
+  {
+    int rc = kafs_img_sync_range(g_state.ctx, off[i], len[i]);
+    if (rc != 0)
+      return rc;
   }
-  if ((do_fsync ? kj_pwrite_fsync : kj_pwrite_nosync)(j->fd, data, len,
-                                                      (off_t)(j->data_off + j->write_off)) != 0)
-    return -EIO;
-  kj_count_meta_write(KAFS_META_REGION_JOURNAL_DATA, len);
-  j->write_off += len;
-  // persist header with updated write offset and seq
-  kj_persist_header(j, do_fsync);
   return 0;
 }
 
-static int kj_write_record(kafs_journal_t *j, uint32_t tag, uint64_t seq, const char *payload)
+#if KAFS_JOURNAL_HAS_PTHREAD
+/// @brief flusher 用: 次のヘッダ書込みと fsync を IOSQE_IO_LINK でつなぎ、1 回の io_uring_enter で
+/// 投入・完了待ちする。ロック保持で呼び、待つ間だけ外す。
+/// @return 0 / -errno。1: リングが使えなくなった（破棄済み。呼び出し側は同期経路でやり直す）
+static int kj_gc_flush_uring_locked(kafs_journal_t *j, kj_flusher_t *f)
 {
-  kj_rec_hdr_t rh = {.tag = tag, .size = 0, .seq = seq, .crc32 = 0};
-  size_t psize = 0;
-  if (payload && *payload)
-    psize = strlen(payload);
-  rh.size = (uint32_t)psize;
-  // write header then payload atomically w.r.t. ring wrap logic
-  // Simple approach: allocate contiguous buffer and write once via kj_ring_write.
-  size_t total = sizeof(rh) + psize;
-  char *buf = (char *)malloc(total);
-  if (!buf)
-    return -ENOMEM;
-  memcpy(buf, &rh, sizeof(rh));
-  if (psize)
-    memcpy(buf + sizeof(rh), payload, psize);
-  // compute CRC over header(with crc32=0) + payload, then write back to header.crc32
-  uint32_t c = kj_crc32(buf, total);
-  ((kj_rec_hdr_t *)buf)->crc32 = c;
-  int rc = kj_ring_write(j, buf, total, 0);
-  free(buf);
+  uint32_t slot = kj_header_next_slot(j);
+  uint64_t generation = j->header_generation + 1u;
+  kj_header_build(j, &f->uring_hdr, generation);
+  f->uring_iov.iov_base = &f->uring_hdr;
+  f->uring_iov.iov_len = sizeof(f->uring_hdr);
+
+  uint64_t off[2], len[2];
+  int nr = kj_sync_ranges(j, off, len);
+  struct io_uring_sqe *sqe = kafs_uring_get_sqe(&f->uring);
+  kafs_uring_prep_writev(sqe, j->fd, &f->uring_iov, 1, kj_header_slot_file_off(j, slot));
+  sqe->flags |= IOSQE_IO_LINK;
+  sqe->user_data = 0;
+  unsigned nsqe = 1;
+  for (int i = 0; i < (nr ? nr : 1); ++i, ++nsqe)
+  {
+    sqe = kafs_uring_get_sqe(&f->uring);
+    if (nr == 0)
+      kafs_uring_prep_fsync(sqe, j->fd, 0, 0, 0);
+    else
+      // A range past 4GiB cannot be expressed; len 0 widens it to the whole file.
+      kafs_uring_prep_fsync(sqe, j->fd, off[i], (len[i] > UINT32_MAX) ? 0u : (uint32_t)len[i],
+                            IORING_FSYNC_DATASYNC);
+    if (i + 1 < nr)
+      sqe->flags |= IOSQE_IO_LINK;
+    sqe->user_data = nsqe;
+  }
+
+  int res[3] = {-ECANCELED, -ECANCELED, -ECANCELED};
+  j->gc_hdr_busy = 1;
+  junlock(j);
+  int rc = kafs_uring_submit_wait(&f->uring, res, nsqe);
+  jlock(j);
+  j->gc_hdr_busy = 0;
+  if (rc < 0)
+  {
+    kafs_uring_destroy(&f->uring);
+    j->gc_uring_on = 0;
+    return 1;
+  }
+  if (res[0] != (int)sizeof(f->uring_hdr))
+    return (res[0] < 0) ? res[0] : -EIO;
+  kj_count_meta_write(KAFS_META_REGION_JOURNAL_HEADER, sizeof(f->uring_hdr));
+  j->active_header_slot = slot;
+  j->header_generation = generation;
+  for (unsigned i = 1; i < nsqe; ++i)
+    if (res[i] < 0)
+      return res[i];
+  __atomic_add_fetch(&j->stat_uring_flushes, 1u, __ATOMIC_RELAXED);
+  return 0;
+}
+#endif
+
+/// @brief 取り込み済みの記録を耐久化する。ロック保持で呼び、fsync の間だけロックを外す。
+/// バッチを締めるヘッダを書いてから fsync するので、1 回で記録とヘッダの両方が揃う。
+/// f（flusher 自身）に io_uring があれば、ヘッダ書込みと fsync を 1 回の投入で済ませる。
+static int kj_gc_flush_locked(kafs_journal_t *j, void *f)
+{
+  // A header write still in flight on the ring must land before the next one is issued.
+  while (j->gc_hdr_busy)
+  {
+    junlock(j);
+    sched_yield();
+    jlock(j);
+  }
+  kj_ring_publish_locked(j);
+  uint64_t target = j->write_seq;
+  if (target <= j->durable_seq)
+    return 0;
+  uint64_t start = nsec_now_mono();
+  int rc = 1;
+#if KAFS_JOURNAL_HAS_PTHREAD
+  if (f && kafs_uring_ready(&((kj_flusher_t *)f)->uring))
+    rc = kj_gc_flush_uring_locked(j, (kj_flusher_t *)f);
+#else
+  (void)f;
+#endif
+  if (rc == 1)
+  {
+    kj_persist_header(j, 0);
+    junlock(j);
+    rc = kj_sync_ring(j);
+    jlock(j);
+  }
+  j->gc_err = rc;
+  if (rc == 0 && target > j->durable_seq)
+  {
+    j->durable_seq = target;
+    __atomic_add_fetch(&j->stat_flushes, 1u, __ATOMIC_RELAXED);
+  }
+  // Commits that landed during the fsync open the next batch from when it started.
+  if (rc == 0 && __atomic_load_n(&j->gc_commit_need, __ATOMIC_SEQ_CST) > j->durable_seq)
+    __atomic_store_n(&j->gc_first_ns, start, __ATOMIC_SEQ_CST);
+  kj_gc_broadcast_durable(j);
+  return rc;
+}
+
+/// @brief flusher なしで need 件目までを耐久化する（書込み中の先行レコードは完了を待つ）
+static int kj_gc_sync_inline(kafs_journal_t *j, uint64_t need)
+{
+  jlock(j);
+  for (;;)
+  {
+    kj_ring_publish_locked(j);
+    if (j->write_seq >= need)
+      break;
+    junlock(j);
+    sched_yield();
+    jlock(j);
+  }
+  int rc = (j->durable_seq < need) ? kj_gc_flush_locked(j, NULL) : 0;
+  junlock(j);
   return rc;
 }
 
-static void j_build_payload(char *dst, size_t cap, const char *op, const char *fmt, va_list ap)
+static void kj_gc_commit_need_raise(kafs_journal_t *j, uint64_t need)
+{
+  uint64_t cur = __atomic_load_n(&j->gc_commit_need, __ATOMIC_SEQ_CST);
+  while (cur < need && !__atomic_compare_exchange_n(&j->gc_commit_need, &cur, need, 0,
+                                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+  {
+  }
+}
+
+#if KAFS_JOURNAL_HAS_PTHREAD
+static void kj_gc_timedwait(kafs_journal_t *j, kj_flusher_t *f, uint64_t deadline_ns)
+{
+  struct timespec ts;
+  ts.tv_sec = (time_t)(deadline_ns / 1000000000ull);
+  ts.tv_nsec = (long)(deadline_ns % 1000000000ull);
+  (void)pthread_cond_timedwait(&f->kick, (pthread_mutex_t *)j->mtx, &ts);
+}
+
+static void *kj_flusher_main(void *arg)
 {
-  size_t n = 0;
-  if (op && *op)
-    n = (size_t)snprintf(dst, cap, "op=%s", op);
-  if (fmt && *fmt && n < cap)
+  kafs_journal_t *j = (kafs_journal_t *)arg;
+  kj_flusher_t *f = (kj_flusher_t *)j->gc_flusher;
+  // The ring lives on this thread only; without it (old kernel, seccomp, KAFS_JOURNAL_URING=0)
+  // flushes stay on pwrite + fsync.
+  const char *env = getenv("KAFS_JOURNAL_URING");
+  if (!env || strcmp(env, "0") != 0)
+    (void)kafs_uring_init(&f->uring);
+  jlock(j);
+  j->gc_uring_on = kafs_uring_ready(&f->uring) ? 1u : 0u;
+  while (!f->stop)
   {
-    if (n > 0 && dst[n - 1] != ' ')
+    int sync = j->gc_waiters && j->gc_sync_need > j->durable_seq;
+    int async = __atomic_load_n(&j->gc_commit_need, __ATOMIC_SEQ_CST) > j->durable_seq;
+    if (!sync && !async)
     {
-      dst[n++] = ' ';
+      // Go idle only with the batch stamp cleared, so the next commit's CAS sees 0 and kicks.
+      __atomic_store_n(&j->gc_first_ns, 0, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&j->gc_commit_need, __ATOMIC_SEQ_CST) <= j->durable_seq)
+        pthread_cond_wait(&f->kick, (pthread_mutex_t *)j->mtx);
+      continue;
     }
-    vsnprintf(dst + n, cap - n, fmt, ap);
+    uint64_t now = nsec_now_mono();
+    // A blocked fsync caller ends the window early; background commits wait it out.
+    uint64_t window = __atomic_load_n(&j->gc_window_ns, __ATOMIC_RELAXED);
+    uint64_t first = __atomic_load_n(&j->gc_first_ns, __ATOMIC_SEQ_CST);
+    if (!sync && window && first && now < first + window)
+    {
+      kj_gc_timedwait(j, f, first + window);
+      continue;
+    }
+    kj_ring_publish_locked(j);
+    if (j->write_seq <= j->durable_seq)
+    {
+      kj_gc_timedwait(j, f, now + KJ_GC_INFLIGHT_POLL_NS);
+      continue;
+    }
+    if (kj_gc_flush_locked(j, f) < 0)
+      kj_gc_timedwait(j, f, nsec_now_mono() + j->gc_delay_ns);
+  }
+  (void)kj_gc_flush_locked(j, f);
+  j->gc_uring_on = 0;
+  junlock(j);
+  kafs_uring_destroy(&f->uring);
+  return NULL;
+}
+#endif
+
+#define KJ_RECORD_MAX_PARTS 2
+
+// Header and payload parts go out in one pwritev; the CRC is chained over the parts so the
+// record never needs a contiguous (heap) copy.
+static int kj_write_recordv(kafs_journal_t *j, uint32_t tag, uint64_t seq,
+                            const struct iovec *parts, int nparts)
+{
+  if (nparts < 0 || nparts > KJ_RECORD_MAX_PARTS)
+    return -EINVAL;
+  size_t psize = 0;
+  for (int i = 0; i < nparts; ++i)
+    psize += parts[i].iov_len;
+  if (psize > UINT32_MAX)
+    return -E2BIG;
+
+  kj_rec_hdr_t rh = {.tag = tag, .size = (uint32_t)psize, .seq = seq, .crc32 = 0};
+  // CRC over header(with crc32=0) + payload
+  uint32_t c = kj_rec_crc_update(j->rec_version, 0, (const uint8_t *)&rh, sizeof(rh));
+  struct iovec iov[KJ_RECORD_MAX_PARTS + 1];
+  iov[0].iov_base = &rh;
+  iov[0].iov_len = sizeof(rh);
+  int cnt = 1;
+  for (int i = 0; i < nparts; ++i)
+  {
+    if (parts[i].iov_len == 0)
+      continue;
+    c = kj_rec_crc_update(j->rec_version, c, (const uint8_t *)parts[i].iov_base,
+                          parts[i].iov_len);
+    iov[cnt++] = parts[i];
   }
+  rh.crc32 = c;
+  return kj_ring_writev(j, iov, cnt, sizeof(rh) + psize);
 }
 
-static void kj_write_inimage_payload(kafs_journal_t *j, uint32_t tag, uint64_t seq, const char *op,
-                                     const char *fmt, va_list ap)
+static int kj_write_record(kafs_journal_t *j, uint32_t tag, uint64_t seq, const void *payload,
+                           size_t len)
 {
-  char payload[512];
-  j_build_payload(payload, sizeof(payload), op, fmt, ap);
-  (void)kj_write_record(j, tag, seq, payload);
+  struct iovec part = {.iov_base = (void *)payload, .iov_len = len};
+  return kj_write_recordv(j, tag, seq, &part, (payload && len) ? 1 : 0);
+}
+
+/// @brief (id, value) の可変長引数列を v3 操作ペイロードへ符号化する。
+/// 収まらないフィールドは捨て、文字列は切り詰める。
+static size_t kj_encode_op(uint8_t *dst, size_t cap, uint16_t op, va_list ap)
+{
+  kj_op_hdr_t oh = {.op = op, .nfields = 0};
+  size_t n = sizeof(oh);
+  for (;;)
+  {
+    int id = va_arg(ap, int);
+    if (id == KJ_F_END)
+      break;
+    uint8_t num[8];
+    const void *val = num;
+    size_t vlen;
+    switch ((unsigned)id & KJ_FT_MASK)
+    {
+    case KJ_FT_U32:
+    {
+      uint32_t v = va_arg(ap, unsigned);
+      memcpy(num, &v, sizeof(v));
+      vlen = sizeof(v);
+      break;
+    }
+    case KJ_FT_I32:
+    {
+      int32_t v = va_arg(ap, int);
+      memcpy(num, &v, sizeof(v));
+      vlen = sizeof(v);
+      break;
+    }
+    case KJ_FT_U64:
+    {
+      uint64_t v = va_arg(ap, uint64_t);
+      memcpy(num, &v, sizeof(v));
+      vlen = sizeof(v);
+      break;
+    }
+    default:
+    {
+      const char *str = va_arg(ap, const char *);
+      val = str ? str : "";
+      vlen = strlen((const char *)val);
+      break;
+    }
+    }
+    if (cap - n < sizeof(kj_tlv_hdr_t))
+      continue;
+    size_t room = cap - n - sizeof(kj_tlv_hdr_t);
+    if (vlen > room)
+    {
+      if (((unsigned)id & KJ_FT_MASK) != KJ_FT_STR)
+        continue;
+      vlen = room;
+    }
+    kj_tlv_hdr_t th = {.id = (uint8_t)id, .reserved = 0, .len = (uint16_t)vlen};
+    memcpy(dst + n, &th, sizeof(th));
+    n += sizeof(th);
+    memcpy(dst + n, val, vlen);
+    n += vlen;
+    oh.nfields++;
+  }
+  memcpy(dst, &oh, sizeof(oh));
+  return n;
 }
 
 static void kj_state_disable(struct kafs_context *ctx)
@@ -666,9 +1218,21 @@ static void kj_state_disable(struct kafs_context *ctx)
   g_state.j.header_slot_count = 0;
   g_state.j.active_header_slot = 0;
   g_state.j.header_generation = 0;
+  g_state.j.ring_resv = 0;
+  g_state.j.ring_pub_pos = 0;
+  g_state.j.ring_slots = NULL;
+  g_state.j.write_seq = 0;
+  g_state.j.durable_seq = 0;
+  g_state.j.gc_commit_need = 0;
+  g_state.j.gc_sync_need = 0;
   g_state.j.gc_delay_ns = 0;
+  g_state.j.gc_window_ns = 0;
+  g_state.j.gc_gap_ewma_ns = 0;
   g_state.j.gc_last_ns = 0;
-  g_state.j.gc_pending = 0;
+  g_state.j.gc_first_ns = 0;
+  g_state.j.gc_waiters = 0;
+  g_state.j.gc_err = 0;
+  g_state.j.gc_flusher = NULL;
 }
 
 static int kj_configure_v6_descriptor_segment(struct kafs_context *ctx, kafs_journal_t *j)
@@ -778,10 +1342,17 @@ int kafs_journal_init(struct kafs_context *ctx, const char *image_path)
   }
 
   next.mtx = kj_mutex_alloc();
+  next.ring_slots = calloc(KJ_RING_SLOTS, sizeof(kj_ring_slot_t));
+  if (!next.ring_slots)
+  {
+    kj_mutex_free(next.mtx);
+    kj_state_disable(ctx);
+    return -ENOMEM;
+  }
   const char *gc = getenv("KAFS_JOURNAL_GC_NS");
-  next.gc_delay_ns = gc ? strtoull(gc, NULL, 0) : 10000000ull;
-  next.gc_last_ns = 0;
-  next.gc_pending = 0;
+  next.gc_delay_ns = gc ? strtoull(gc, NULL, 0) : KJ_GC_DELAY_DEFAULT_NS;
+  if (next.gc_delay_ns > KJ_GC_DELAY_MAX_NS)
+    next.gc_delay_ns = KJ_GC_DELAY_MAX_NS;
 
   g_state.ctx = ctx;
   g_state.j = next;
@@ -789,10 +1360,127 @@ int kafs_journal_init(struct kafs_context *ctx, const char *image_path)
   if (rc != 0)
   {
     kj_mutex_free(g_state.j.mtx);
+    free(g_state.j.ring_slots);
     kj_state_disable(ctx);
     return rc;
   }
+  kj_ring_reset_cursor(&g_state.j);
+  return 0;
+}
+
+int kafs_journal_flusher_start(struct kafs_context *ctx)
+{
+#if KAFS_JOURNAL_HAS_PTHREAD
+  if (g_state.ctx != ctx || !g_state.j.enabled || !g_state.j.use_inimage)
+    return 0;
+  kafs_journal_t *j = &g_state.j;
+  if (!j->mtx || j->gc_delay_ns == 0 || kj_gc_flusher_live(j))
+    return 0;
+
+  // The flusher state outlives a stop so lock-free committers never see it freed; it is
+  // released in kafs_journal_shutdown().
+  kj_flusher_t *f = (kj_flusher_t *)j->gc_flusher;
+  if (!f)
+  {
+    f = calloc(1, sizeof(*f));
+    if (!f)
+      return -ENOMEM;
+    kafs_uring_reset(&f->uring);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int rc = pthread_cond_init(&f->kick, &attr);
+    pthread_condattr_destroy(&attr);
+    if (rc != 0)
+    {
+      free(f);
+      return -rc;
+    }
+    rc = pthread_cond_init(&f->durable, NULL);
+    if (rc != 0)
+    {
+      pthread_cond_destroy(&f->kick);
+      free(f);
+      return -rc;
+    }
+    f->stop = 1;
+    __atomic_store_n(&j->gc_flusher, f, __ATOMIC_RELEASE);
+  }
+
+  jlock(j);
+  __atomic_store_n(&f->stop, 0, __ATOMIC_RELEASE);
+  int rc = pthread_create(&f->tid, NULL, kj_flusher_main, j);
+  if (rc != 0)
+    __atomic_store_n(&f->stop, 1, __ATOMIC_RELEASE);
+  junlock(j);
+  return -rc;
+#else
+  (void)ctx;
   return 0;
+#endif
+}
+
+void kafs_journal_flusher_stop(struct kafs_context *ctx)
+{
+#if KAFS_JOURNAL_HAS_PTHREAD
+  if (g_state.ctx != ctx)
+    return;
+  kafs_journal_t *j = &g_state.j;
+  kj_flusher_t *f = (kj_flusher_t *)kj_gc_flusher_live(j);
+  if (!f)
+    return;
+  jlock(j);
+  __atomic_store_n(&f->stop, 1, __ATOMIC_RELEASE);
+  pthread_cond_signal(&f->kick);
+  junlock(j);
+  pthread_join(f->tid, NULL);
+#else
+  (void)ctx;
+#endif
+}
+
+static void kj_flusher_free(kafs_journal_t *j)
+{
+#if KAFS_JOURNAL_HAS_PTHREAD
+  kj_flusher_t *f = (kj_flusher_t *)j->gc_flusher;
+  if (!f)
+    return;
+  // The final flush woke every waiter; let them leave the condvar before it goes away.
+  jlock(j);
+  while (j->gc_waiters)
+  {
+    junlock(j);
+    sched_yield();
+    jlock(j);
+  }
+  j->gc_flusher = NULL;
+  junlock(j);
+  pthread_cond_destroy(&f->durable);
+  pthread_cond_destroy(&f->kick);
+  free(f);
+#else
+  (void)j;
+#endif
+}
+
+void kafs_journal_stats_get(struct kafs_context *ctx, kafs_journal_stats_t *out)
+{
+  if (!out)
+    return;
+  memset(out, 0, sizeof(*out));
+  if (g_state.ctx != ctx || !g_state.j.enabled)
+    return;
+  kafs_journal_t *j = &g_state.j;
+  jlock(j);
+  out->commits = __atomic_load_n(&j->stat_commits, __ATOMIC_RELAXED);
+  out->flushes = __atomic_load_n(&j->stat_flushes, __ATOMIC_RELAXED);
+  out->sync_waits = j->stat_sync_waits;
+  out->window_ns = __atomic_load_n(&j->gc_window_ns, __ATOMIC_RELAXED);
+  out->max_window_ns = j->gc_delay_ns;
+  out->flusher_running = kj_gc_flusher_live(j) ? 1u : 0u;
+  out->uring = j->gc_uring_on;
+  out->uring_flushes = __atomic_load_n(&j->stat_uring_flushes, __ATOMIC_RELAXED);
+  junlock(j);
 }
 
 void kafs_journal_shutdown(struct kafs_context *ctx)
@@ -800,19 +1488,14 @@ void kafs_journal_shutdown(struct kafs_context *ctx)
   kj_apply_meta_delta(ctx);
   if (g_state.ctx != ctx)
     return;
+  kafs_journal_flusher_stop(ctx);
   kafs_journal_t *j = &g_state.j;
   if (j->fd >= 0)
   {
     if (j->use_inimage && j->enabled)
     {
       // flush pending group commit batch, if any
-      jlock(j);
-      if (j->gc_pending)
-      {
-        kj_persist_header(j, 1);
-        j->gc_pending = 0;
-      }
-      junlock(j);
+      (void)kj_gc_sync_inline(j, kj_ring_reserved(j));
     }
     if (!j->use_inimage)
     {
@@ -824,7 +1507,9 @@ void kafs_journal_shutdown(struct kafs_context *ctx)
     }
     // in-image: header/state is persisted by writes; underlying fd is owned by ctx
   }
+  kj_flusher_free(j);
   kj_mutex_free(j->mtx);
+  free(j->ring_slots);
   memset(&g_state, 0, sizeof(g_state));
 }
 
@@ -833,51 +1518,83 @@ int kafs_journal_is_enabled(struct kafs_context *ctx)
   return (g_state.ctx == ctx && g_state.j.enabled) ? 1 : 0;
 }
 
-void kafs_journal_force_flush(struct kafs_context *ctx)
+uint64_t kafs_journal_seq(struct kafs_context *ctx)
+{
+  if (g_state.ctx != ctx || !g_state.j.enabled)
+    return 0;
+  return __atomic_load_n(&g_state.j.seq, __ATOMIC_RELAXED);
+}
+
+int kafs_journal_force_flush(struct kafs_context *ctx)
 {
   if (!ctx)
-    return;
+    return 0;
 
   kj_apply_meta_delta(ctx);
 
   if (g_state.ctx != ctx || !g_state.j.enabled)
-    return;
+    return 0;
 
   kafs_journal_t *j = &g_state.j;
-  jlock(j);
-  if (j->use_inimage)
+  int rc = 0;
+  if (!j->use_inimage)
   {
-    kj_persist_header(j, 1);
-    j->gc_pending = 0;
+    jlock(j);
+    if (j->fd >= 0 && fsync(j->fd) != 0)
+      rc = -errno;
+    junlock(j);
+    return rc;
   }
-  else if (j->fd >= 0)
+
+  // Everything reserved so far, including records other threads are still writing.
+  uint64_t target = kj_ring_reserved(j);
+#if KAFS_JOURNAL_HAS_PTHREAD
+  jlock(j);
+  kj_flusher_t *f = (kj_flusher_t *)kj_gc_flusher_live(j);
+  if (f && j->durable_seq < target)
   {
-    fsync(j->fd);
+    __atomic_add_fetch(&j->gc_waiters, 1u, __ATOMIC_SEQ_CST);
+    j->stat_sync_waits++;
+    if (j->gc_sync_need < target)
+      j->gc_sync_need = target;
+    pthread_cond_signal(&f->kick);
+    while (j->durable_seq < target)
+    {
+      pthread_cond_wait(&f->durable, (pthread_mutex_t *)j->mtx);
+      if (j->durable_seq < target && j->gc_err)
+      {
+        rc = j->gc_err;
+        break;
+      }
+    }
+    __atomic_sub_fetch(&j->gc_waiters, 1u, __ATOMIC_SEQ_CST);
+    junlock(j);
+    return rc;
   }
   junlock(j);
+#endif
+  return kj_gc_sync_inline(j, target);
 }
 
-uint64_t kafs_journal_begin(struct kafs_context *ctx, const char *op, const char *fmt, ...)
+uint64_t kafs_journal_begin(struct kafs_context *ctx, kj_op_t op, ...)
 {
   if (g_state.ctx != ctx || !g_state.j.enabled)
     return 0;
   kafs_journal_t *j = &g_state.j;
-  jlock(j);
-  uint64_t id = ++j->seq;
+  uint8_t payload[KJ_OP_PAYLOAD_MAX];
+  va_list ap;
+  va_start(ap, op);
+  size_t len = kj_encode_op(payload, sizeof(payload), (uint16_t)op, ap);
+  va_end(ap);
+
+  uint64_t id = __atomic_add_fetch(&j->seq, 1u, __ATOMIC_RELAXED);
   if (j->use_inimage)
   {
-    va_list ap;
-    va_start(ap, fmt);
-    kj_write_inimage_payload(j, KJ_TAG_BEG, id, op, fmt, ap);
-    va_end(ap);
-  }
-  else
-  {
-    va_list ap;
-    va_start(ap, fmt);
-    kj_write_sidecar_tsline(j, KJ_SIDECAR_BEGIN, id, op, fmt, ap);
-    va_end(ap);
+    (void)kj_write_record(j, KJ_TAG_BEG, id, payload, len);
+    return id;
   }
+  jlock(j);
+  kj_write_sidecar_tsline(j, KJ_SIDECAR_BEGIN, id, payload, len);
   junlock(j);
   return id;
 }
@@ -893,124 +1610,186 @@ void kafs_journal_commit(struct kafs_context *ctx, uint64_t seq)
   kj_apply_meta_delta(ctx);
 
   kafs_journal_t *j = &g_state.j;
-  jlock(j);
   if (j->use_inimage)
   {
     if (meta.valid)
       (void)kj_write_meta_delta_record(j, seq, &meta);
+    kj_meta_snapshot_clear(&meta);
 
-    // COMMITは書き込み自体は非同期。グループコミット窓の最後に1回だけfsync+ヘッダ更新。
-    kj_rec_hdr_t rh = {.tag = KJ_TAG_CMT, .size = 0, .seq = seq, .crc32 = 0};
-    rh.crc32 = 0;
-    rh.crc32 = kj_crc32(&rh, sizeof(rh));
-    (void)kj_ring_write(j, &rh, sizeof(rh), 0);
+    // COMMITは書き込み自体は非同期。耐久化は flusher のバッチ fsync に任せる。
+    if (kj_write_record(j, KJ_TAG_CMT, seq, NULL, 0) != 0)
+      return;
+    uint64_t need = kj_tls_last_ticket + 1u;
+    __atomic_add_fetch(&j->stat_commits, 1u, __ATOMIC_RELAXED);
 
-    uint64_t delay = j->gc_delay_ns;
-    if (delay == 0)
+    if (j->gc_delay_ns == 0 || !kj_gc_flusher_live(j))
     {
-      // すぐに耐久化
-      kj_persist_header(j, 1);
-      junlock(j);
-      kj_meta_snapshot_clear(&meta);
+      // 窓なし、または flusher 起動前: その場で耐久化
+      (void)kj_gc_sync_inline(j, need);
       return;
     }
 
-    // リーダースレッド選出: 最初のCOMMITのみ待機してバッチフラッシュを担当
-    if (!j->gc_pending)
+    uint64_t now = nsec_now_mono();
+    kj_gc_commit_need_raise(j, need);
+    kj_gc_note_arrival(j, now);
+    // Only the commit that opens a batch wakes the flusher; the rest ride along lock-free.
+    uint64_t idle = 0;
+    if (__atomic_compare_exchange_n(&j->gc_first_ns, &idle, now, 0, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_SEQ_CST))
     {
-      j->gc_pending = 1;
-      j->gc_last_ns = nsec_now_mono();
-      // unlockして窓が閉じるまで待機
-      uint64_t start = j->gc_last_ns;
-      junlock(j);
-      uint64_t now = nsec_now_mono();
-      uint64_t elapsed = now - start;
-      if (elapsed < delay)
-        sleep_ns(delay - elapsed);
-      // 再ロックしてフラッシュ（まだ自分が担当なら）
       jlock(j);
-      if (j->gc_pending && (nsec_now_mono() - j->gc_last_ns) >= delay)
-      {
-        kj_persist_header(j, 1);
-        j->gc_pending = 0;
-      }
+      kj_gc_kick_locked(j);
       junlock(j);
-      kj_meta_snapshot_clear(&meta);
-      return;
     }
-    // 非リーダー: すでにバッチ中。フラッシュはリーダーに任せる。
-    junlock(j);
-    kj_meta_snapshot_clear(&meta);
     return;
   }
-  else
-  {
-    struct timespec ts;
-    timespec_now(&ts);
-    dprintf(j->fd, "COMMIT %llu %ld.%09ld\n", (unsigned long long)seq, (long)ts.tv_sec, ts.tv_nsec);
-    fsync(j->fd);
-  }
+
+  jlock(j);
+  struct timespec ts;
+  timespec_now(&ts);
+  dprintf(j->fd, "COMMIT %llu %ld.%09ld\n", (unsigned long long)seq, (long)ts.tv_sec, ts.tv_nsec);
+  fsync(j->fd);
   junlock(j);
   kj_meta_snapshot_clear(&meta);
 }
 
-void kafs_journal_abort(struct kafs_context *ctx, uint64_t seq, const char *reason_fmt, ...)
+void kafs_journal_abort(struct kafs_context *ctx, uint64_t seq, ...)
 {
   if (g_state.ctx != ctx || !g_state.j.enabled || seq == 0)
     return;
   kafs_journal_t *j = &g_state.j;
-  jlock(j);
+  uint8_t payload[KJ_OP_PAYLOAD_MAX];
+  va_list ap;
+  va_start(ap, seq);
+  size_t len = kj_encode_op(payload, sizeof(payload), KJ_OP_NONE, ap);
+  va_end(ap);
+
   if (j->use_inimage)
   {
-    char payload[256] = {0};
-    if (reason_fmt && *reason_fmt)
-    {
-      va_list ap;
-      va_start(ap, reason_fmt);
-      vsnprintf(payload, sizeof(payload), reason_fmt, ap);
-      va_end(ap);
-    }
-    (void)kj_write_record(j, KJ_TAG_ABR, seq, payload[0] ? payload : NULL);
-  }
-  else
-  {
-    va_list ap;
-    va_start(ap, reason_fmt);
-    kj_write_sidecar_tsline(j, KJ_SIDECAR_ABORT, seq, NULL, reason_fmt, ap);
-    va_end(ap);
+    (void)kj_write_record(j, KJ_TAG_ABR, seq, payload, len);
+    return;
   }
+  jlock(j);
+  kj_write_sidecar_tsline(j, KJ_SIDECAR_ABORT, seq, payload, len);
   junlock(j);
 }
 
-void kafs_journal_note(struct kafs_context *ctx, const char *op, const char *fmt, ...)
+void kafs_journal_note(struct kafs_context *ctx, kj_op_t op, ...)
 {
   if (g_state.ctx != ctx || !g_state.j.enabled)
     return;
   kafs_journal_t *j = &g_state.j;
-  jlock(j);
+  uint8_t payload[KJ_OP_PAYLOAD_MAX];
+  va_list ap;
+  va_start(ap, op);
+  size_t len = kj_encode_op(payload, sizeof(payload), (uint16_t)op, ap);
+  va_end(ap);
+
   if (j->use_inimage)
   {
-    va_list ap;
-    va_start(ap, fmt);
-    kj_write_inimage_payload(j, KJ_TAG_NOTE, 0, op, fmt, ap);
-    va_end(ap);
-  }
-  else
-  {
-    va_list ap;
-    va_start(ap, fmt);
-    kj_write_sidecar_tsline(j, KJ_SIDECAR_NOTE, 0, op, fmt, ap);
-    va_end(ap);
+    (void)kj_write_record(j, KJ_TAG_NOTE, 0, payload, len);
+    return;
   }
+  jlock(j);
+  kj_write_sidecar_tsline(j, KJ_SIDECAR_NOTE, 0, payload, len);
   junlock(j);
 }
 
 // ----------------------
 // Replay
 // ----------------------
+// Records never straddle the wrap point, so payloads are addressed by ring offset and re-read
+// on demand instead of being copied to the heap while their transaction is open.
+static int kj_replay_record_crc_ok(const kafs_journal_t *j, const kj_rec_hdr_t *rh, uint64_t pl_pos)
+{
+  kj_rec_hdr_t tmp = *rh;
+  tmp.crc32 = 0;
+  uint32_t c = kj_rec_crc_update(j->rec_version, 0, (const uint8_t *)&tmp, sizeof(tmp));
+  uint8_t chunk[4096];
+  for (uint32_t done = 0; done < rh->size;)
+  {
+    size_t n = rh->size - done;
+    if (n > sizeof(chunk))
+      n = sizeof(chunk);
+    if (kj_pread(j->fd, chunk, n, (off_t)(j->data_off + pl_pos + done)) != 0)
+      return 0;
+    c = kj_rec_crc_update(j->rec_version, c, chunk, n);
+    done += (uint32_t)n;
+  }
+  return c == rh->crc32;
+}
+
+static void kj_replay_apply_meta_delta(struct kafs_context *ctx, const kafs_journal_t *j,
+                                       uint64_t pl_pos, uint32_t size)
+{
+  if (j->rec_version == KJ_VER_TEXT)
+  {
+    char *payload = (char *)malloc((size_t)size + 1u);
+    if (!payload)
+      return;
+    if (kj_pread(j->fd, payload, size, (off_t)(j->data_off + pl_pos)) == 0)
+    {
+      payload[size] = '\0';
+      kj_replay_apply_meta_delta_text(ctx, payload);
+    }
+    free(payload);
+    return;
+  }
+
+  kj_mdt_hdr_t mh;
+  if (size < sizeof(mh) || kj_pread(j->fd, &mh, sizeof(mh), (off_t)(j->data_off + pl_pos)) != 0)
+    return;
+  if ((uint64_t)mh.word_count * sizeof(kj_mdt_word_t) > (uint64_t)(size - sizeof(mh)))
+    return;
+
+  kj_replay_apply_sb(ctx, mh.free_abs, (mh.flags & KJ_MDT_FLAG_WTIME_DIRTY) != 0,
+                     (kafs_time_t){.tv_sec = (time_t)mh.wtime_sec, .tv_nsec = mh.wtime_nsec});
+
+  size_t wordcnt = kj_replay_bitmap_wordcnt(ctx);
+  kj_mdt_word_t words[256];
+  uint64_t off = pl_pos + sizeof(mh);
+  for (uint32_t done = 0; done < mh.word_count;)
+  {
+    uint32_t n = mh.word_count - done;
+    if (n > 256u)
+      n = 256u;
+    if (kj_pread(j->fd, words, (size_t)n * sizeof(words[0]), (off_t)(j->data_off + off)) != 0)
+      return;
+    for (uint32_t i = 0; i < n; ++i)
+      kj_replay_apply_word(ctx, wordcnt, words[i].idx, words[i].val);
+    off += (uint64_t)n * sizeof(words[0]);
+    done += n;
+  }
+}
+
+static void kj_replay_invoke(struct kafs_context *ctx, const kafs_journal_t *j, uint64_t pl_pos,
+                             uint32_t size, kafs_journal_replay_cb cb, void *user)
+{
+  uint8_t pl[KJ_OP_PAYLOAD_MAX];
+  if (size > sizeof(pl) - 1u)
+    size = (j->rec_version == KJ_VER_TEXT) ? (uint32_t)(sizeof(pl) - 1u) : 0u;
+  if (size && kj_pread(j->fd, pl, size, (off_t)(j->data_off + pl_pos)) != 0)
+    return;
+
+  if (j->rec_version == KJ_VER_TEXT)
+  {
+    // payload is "op=NAME <args>"; only the op survives the format change
+    pl[size] = '\0';
+    const char *op = strstr((const char *)pl, "op=");
+    op = op ? op + 3 : "";
+    (void)cb(ctx, kj_op_from_name(op, strcspn(op, " ")), NULL, 0, user);
+    return;
+  }
+
+  kj_op_hdr_t oh;
+  if (size < sizeof(oh))
+    return;
+  memcpy(&oh, pl, sizeof(oh));
+  (void)cb(ctx, oh.op, pl + sizeof(oh), size - sizeof(oh), user);
+}
+
 int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, void *user)
 {
-  (void)user;
   if (!ctx || !ctx->c_superblock)
     return -EINVAL;
 
@@ -1038,8 +1817,11 @@ int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, voi
   struct
   {
     uint64_t seq;
-    char *payload;
-    char *meta_payload;
+    uint64_t beg_pos;
+    uint32_t beg_size;
+    uint32_t mdt_size;
+    uint64_t mdt_pos;
+    int has_mdt;
   } open[MAX_OPEN];
   size_t open_cnt = 0;
   while (pos + sizeof(kj_rec_hdr_t) <= j.write_off)
@@ -1055,45 +1837,10 @@ int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, voi
     }
     if (pos + rh.size > j.write_off)
       break; // partial tail
-    char *pl = NULL;
-    if (rh.size)
-    {
-      pl = (char *)malloc(rh.size + 1);
-      if (!pl)
-        break;
-      if (kj_pread(j.fd, pl, rh.size, (off_t)(j.data_off + pos)) != 0)
-      {
-        free(pl);
-        break;
-      }
-      pl[rh.size] = '\0';
-    }
+    if (!kj_replay_record_crc_ok(&j, &rh, pos))
+      break;
+    uint64_t pl_pos = pos;
     pos += rh.size;
-    // CRC検証（WRAPは除外）
-    if (rh.tag != KJ_TAG_WRAP)
-    {
-      size_t total = sizeof(rh) + rh.size;
-      char *buf = (char *)malloc(total);
-      if (!buf)
-      {
-        if (pl)
-          free(pl);
-        break;
-      }
-      kj_rec_hdr_t rh2 = rh;
-      rh2.crc32 = 0;
-      memcpy(buf, &rh2, sizeof(rh2));
-      if (rh.size && pl)
-        memcpy(buf + sizeof(rh2), pl, rh.size);
-      uint32_t c = kj_crc32(buf, total);
-      free(buf);
-      if (c != rh.crc32)
-      {
-        if (pl)
-          free(pl);
-        break;
-      }
-    }
     switch (rh.tag)
     {
     case KJ_TAG_BEG:
@@ -1101,10 +1848,10 @@ int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, voi
       if (open_cnt < MAX_OPEN)
       {
         open[open_cnt].seq = rh.seq;
-        open[open_cnt].payload = pl;
-        open[open_cnt].meta_payload = NULL;
+        open[open_cnt].beg_pos = pl_pos;
+        open[open_cnt].beg_size = rh.size;
+        open[open_cnt].has_mdt = 0;
         open_cnt++;
-        pl = NULL;
       }
       break;
     }
@@ -1114,9 +1861,9 @@ int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, voi
       {
         if (open[i].seq != rh.seq)
           continue;
-        free(open[i].meta_payload);
-        open[i].meta_payload = pl;
-        pl = NULL;
+        open[i].mdt_pos = pl_pos;
+        open[i].mdt_size = rh.size;
+        open[i].has_mdt = 1;
         break;
       }
       break;
@@ -1128,27 +1875,10 @@ int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, voi
       {
         if (open[i].seq == rh.seq)
         {
-          if (open[i].meta_payload)
-            kj_replay_apply_meta_delta(ctx, open[i].meta_payload);
-          if (cb && open[i].payload)
-          {
-            // payload is "op=... <args>"
-            const char *payload = open[i].payload;
-            const char *opkv = strstr(payload, "op=");
-            const char *sp = opkv ? strchr(opkv, '=') : NULL;
-            const char *op = sp ? (sp + 1) : "";
-            const char *args = op ? strchr(op, ' ') : NULL;
-            size_t oplen = args ? (size_t)(args - op) : strlen(op);
-            char opbuf[64];
-            if (oplen >= sizeof(opbuf))
-              oplen = sizeof(opbuf) - 1;
-            memcpy(opbuf, op, oplen);
-            opbuf[oplen] = '\0';
-            const char *argstr = args ? (args + 1) : "";
-            (void)cb(ctx, opbuf, argstr, user);
-          }
-          free(open[i].payload);
-          free(open[i].meta_payload);
+          if (open[i].has_mdt)
+            kj_replay_apply_meta_delta(ctx, &j, open[i].mdt_pos, open[i].mdt_size);
+          if (cb)
+            kj_replay_invoke(ctx, &j, open[i].beg_pos, open[i].beg_size, cb, user);
           // compact remove
           open[i] = open[open_cnt - 1];
           open_cnt--;
@@ -1163,8 +1893,6 @@ int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, voi
       for (size_t i = 0; i < open_cnt; ++i)
         if (open[i].seq == rh.seq)
         {
-          free(open[i].payload);
-          free(open[i].meta_payload);
           open[i] = open[open_cnt - 1];
           open_cnt--;
           break;
@@ -1175,22 +1903,19 @@ int kafs_journal_replay(struct kafs_context *ctx, kafs_journal_replay_cb cb, voi
     default:
       break;
     }
-    if (pl)
-      free(pl);
   }
 
-  // cleanup: reset ring for fresh start
+  // cleanup: reset ring for fresh start; an empty ring is always rewritten as KJ_VER
   j.write_off = 0;
-  j.seq = j.seq; // keep seq as loaded
+  j.rec_version = KJ_VER;
   kj_reset_area(&j);
   (void)kj_header_store_next(&j, 1);
   if (g_state.ctx == ctx && g_state.j.enabled && g_state.j.use_inimage &&
       g_state.j.base_off == j.base_off && g_state.j.segment_id == j.segment_id)
-    g_state.j.write_off = 0;
-  for (size_t i = 0; i < open_cnt; ++i)
   {
-    free(open[i].payload);
-    free(open[i].meta_payload);
+    g_state.j.write_off = 0;
+    g_state.j.rec_version = KJ_VER;
+    kj_ring_reset_cursor(&g_state.j);
   }
   return 0;
 }
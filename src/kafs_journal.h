@@ -1,12 +1,17 @@
 #pragma once
 #include "kafs_config.h"
+#include "kafs_crc32.h"
 #include <stdint.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <string.h>
 
 // In-image journal format (shared with fsck)
 #define KJ_MAGIC 0x4b414a4c /* 'KAJL' */
-#define KJ_VER 2
+#define KJ_VER 4      /* binary TLV payloads, CRC32C checksums */
+#define KJ_VER_TLV 3  /* binary TLV payloads, CRC32 checksums (decode only) */
+#define KJ_VER_TEXT 2 /* printf text payloads, CRC32 checksums (decode only) */
 #define KJ_HEADER_FLAG_ROTATED (1u << 0)
 #define KAFS_JOURNAL_FLAG_ROTATING_HEADERS (1u << 0)
 #define KJ_HEADER_ROTATION_SLOTS 8u
@@ -38,16 +43,378 @@ typedef struct kj_rec_hdr
   uint32_t crc32;
 } __attribute__((packed)) kj_rec_hdr_t;
 
-static inline uint32_t kj_crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
+// --- v3 record payloads ---
+// BEG/ABR/NOTE: kj_op_hdr_t followed by nfields TLVs (kj_tlv_hdr_t + value).
+// The top two bits of a field id select its fixed value type; strings are not NUL-terminated.
+typedef struct kj_op_hdr
+{
+  uint16_t op;
+  uint16_t nfields;
+} __attribute__((packed)) kj_op_hdr_t;
+
+typedef struct kj_tlv_hdr
+{
+  uint8_t id;
+  uint8_t reserved;
+  uint16_t len;
+} __attribute__((packed)) kj_tlv_hdr_t;
+
+// MDT: kj_mdt_hdr_t followed by word_count kj_mdt_word_t entries.
+#define KJ_MDT_FLAG_WTIME_DIRTY (1u << 0)
+
+typedef struct kj_mdt_hdr
+{
+  uint64_t free_abs;
+  int64_t wtime_sec;
+  uint32_t wtime_nsec;
+  uint32_t flags;
+  uint32_t word_count;
+  uint32_t reserved;
+} __attribute__((packed)) kj_mdt_hdr_t;
+
+typedef struct kj_mdt_word
+{
+  uint32_t idx;
+  uint64_t val;
+} __attribute__((packed)) kj_mdt_word_t;
+
+// Upper bound of an encoded BEG/ABR/NOTE payload; longer strings are clipped.
+#define KJ_OP_PAYLOAD_MAX 1024u
+
+typedef enum kj_op
+{
+  KJ_OP_NONE = 0,
+  KJ_OP_CREATE = 1,
+  KJ_OP_MKDIR = 2,
+  KJ_OP_RMDIR = 3,
+  KJ_OP_UNLINK = 4,
+  KJ_OP_RENAME = 5,
+  KJ_OP_CHMOD = 6,
+  KJ_OP_CHOWN = 7,
+  KJ_OP_SYMLINK = 8,
+  KJ_OP_LINK = 9,
+  KJ_OP_PENDINGLOG = 10,
+  KJ_OP_PROBE = 11, // diagnostics/tests
+} kj_op_t;
+
+#define KJ_FT_U32 0x00u
+#define KJ_FT_U64 0x40u
+#define KJ_FT_I32 0x80u
+#define KJ_FT_STR 0xc0u
+#define KJ_FT_MASK 0xc0u
+
+// Field ids. Variadic journal APIs take (id, value) pairs terminated by KJ_F_END;
+// the value must be unsigned/int/uint64_t/const char * according to the id type.
+typedef enum kj_field
+{
+  KJ_F_END = 0,
+  KJ_F_MODE = KJ_FT_U32 | 1,
+  KJ_F_UID = KJ_FT_U32 | 2,
+  KJ_F_GID = KJ_FT_U32 | 3,
+  KJ_F_FLAGS = KJ_FT_U32 | 4,
+  KJ_F_INO = KJ_FT_U32 | 5,
+  KJ_F_INO2 = KJ_FT_U32 | 6,
+  KJ_F_ENTRIES = KJ_FT_U32 | 7,
+  KJ_F_CAP = KJ_FT_U32 | 8,
+  KJ_F_REQUEUED = KJ_FT_U32 | 9,
+  KJ_F_DROPPED = KJ_FT_U32 | 10,
+  KJ_F_VALUE = KJ_FT_U64 | 1,
+  KJ_F_ERR = KJ_FT_I32 | 1,
+  KJ_F_PATH = KJ_FT_STR | 1,
+  KJ_F_PATH2 = KJ_FT_STR | 2,
+  KJ_F_TARGET = KJ_FT_STR | 3,
+  KJ_F_REASON = KJ_FT_STR | 4,
+} kj_field_t;
+
+static inline int kj_version_supported(uint16_t version)
+{
+  return version >= KJ_VER_TEXT && version <= KJ_VER;
+}
+
+static inline const char *kj_op_name(uint16_t op)
+{
+  switch (op)
+  {
+  case KJ_OP_CREATE:
+    return "CREATE";
+  case KJ_OP_MKDIR:
+    return "MKDIR";
+  case KJ_OP_RMDIR:
+    return "RMDIR";
+  case KJ_OP_UNLINK:
+    return "UNLINK";
+  case KJ_OP_RENAME:
+    return "RENAME";
+  case KJ_OP_CHMOD:
+    return "CHMOD";
+  case KJ_OP_CHOWN:
+    return "CHOWN";
+  case KJ_OP_SYMLINK:
+    return "SYMLINK";
+  case KJ_OP_LINK:
+    return "LINK";
+  case KJ_OP_PENDINGLOG:
+    return "PENDINGLOG";
+  case KJ_OP_PROBE:
+    return "PROBE";
+  default:
+    return NULL;
+  }
+}
+
+static inline uint16_t kj_op_from_name(const char *name, size_t len)
 {
-  crc = ~crc;
-  for (size_t i = 0; i < len; ++i)
+  for (uint16_t op = KJ_OP_CREATE; op <= KJ_OP_PROBE; ++op)
   {
-    crc ^= buf[i];
-    for (int k = 0; k < 8; ++k)
-      crc = (crc >> 1) ^ (0xEDB88320u & (uint32_t)(0u - (crc & 1u)));
+    const char *n = kj_op_name(op);
+    if (n && strlen(n) == len && memcmp(n, name, len) == 0)
+      return op;
   }
-  return ~crc;
+  return KJ_OP_NONE;
+}
+
+static inline const char *kj_field_name(uint8_t id)
+{
+  switch (id)
+  {
+  case KJ_F_MODE:
+    return "mode";
+  case KJ_F_UID:
+    return "uid";
+  case KJ_F_GID:
+    return "gid";
+  case KJ_F_FLAGS:
+    return "flags";
+  case KJ_F_INO:
+    return "ino";
+  case KJ_F_INO2:
+    return "ino2";
+  case KJ_F_ENTRIES:
+    return "entries";
+  case KJ_F_CAP:
+    return "cap";
+  case KJ_F_REQUEUED:
+    return "requeued";
+  case KJ_F_DROPPED:
+    return "dropped";
+  case KJ_F_VALUE:
+    return "value";
+  case KJ_F_ERR:
+    return "err";
+  case KJ_F_PATH:
+    return "path";
+  case KJ_F_PATH2:
+    return "path2";
+  case KJ_F_TARGET:
+    return "target";
+  case KJ_F_REASON:
+    return "reason";
+  default:
+    return NULL;
+  }
+}
+
+/// @brief TLV 列を1つ進める。off は fields 先頭からの位置。
+/// @return 1: 取得, 0: 終端, -1: 破損
+static inline int kj_tlv_next(const uint8_t *fields, size_t len, size_t *off, uint8_t *id,
+                              const uint8_t **val, uint16_t *vlen)
+{
+  if (*off == len)
+    return 0;
+  if (len - *off < sizeof(kj_tlv_hdr_t))
+    return -1;
+  kj_tlv_hdr_t th;
+  memcpy(&th, fields + *off, sizeof(th));
+  size_t body = *off + sizeof(th);
+  if (th.len > len - body)
+    return -1;
+  switch (th.id & KJ_FT_MASK)
+  {
+  case KJ_FT_U32:
+  case KJ_FT_I32:
+    if (th.len != 4u)
+      return -1;
+    break;
+  case KJ_FT_U64:
+    if (th.len != 8u)
+      return -1;
+    break;
+  default:
+    break;
+  }
+  *id = th.id;
+  *val = fields + body;
+  *vlen = th.len;
+  *off = body + th.len;
+  return 1;
+}
+
+static inline uint32_t kj_tlv_u32(const uint8_t *val)
+{
+  uint32_t v;
+  memcpy(&v, val, sizeof(v));
+  return v;
+}
+
+static inline uint64_t kj_tlv_u64(const uint8_t *val)
+{
+  uint64_t v;
+  memcpy(&v, val, sizeof(v));
+  return v;
+}
+
+/// @brief 操作ペイロードの TLV 列を検査する（fsck 用）
+static inline int kj_op_payload_valid(const uint8_t *pl, size_t len)
+{
+  if (len < sizeof(kj_op_hdr_t))
+    return 0;
+  kj_op_hdr_t oh;
+  memcpy(&oh, pl, sizeof(oh));
+  const uint8_t *fields = pl + sizeof(oh);
+  size_t flen = len - sizeof(oh);
+  size_t off = 0;
+  uint16_t n = 0;
+  uint8_t id;
+  const uint8_t *val;
+  uint16_t vlen;
+  int r;
+  while ((r = kj_tlv_next(fields, flen, &off, &id, &val, &vlen)) > 0)
+    n++;
+  return r == 0 && n == oh.nfields;
+}
+
+// --- Text decoding (kafsdump / fsck.kafs only; the write path never formats text) ---
+
+static inline size_t kj_text_append(char *out, size_t cap, size_t n, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static inline size_t kj_text_append(char *out, size_t cap, size_t n, const char *fmt, ...)
+{
+  if (n >= cap)
+    return n;
+  va_list ap;
+  va_start(ap, fmt);
+  int m = vsnprintf(out + n, cap - n, fmt, ap);
+  va_end(ap);
+  if (m < 0)
+    return n;
+  return (n + (size_t)m < cap) ? n + (size_t)m : cap - 1u;
+}
+
+/// @brief TLV 列を "key=value ..." 形式に整形する
+static inline size_t kj_format_fields(const uint8_t *fields, size_t len, char *out, size_t cap,
+                                      size_t n)
+{
+  size_t off = 0;
+  uint8_t id;
+  const uint8_t *val;
+  uint16_t vlen;
+  int r;
+  while ((r = kj_tlv_next(fields, len, &off, &id, &val, &vlen)) > 0)
+  {
+    const char *name = kj_field_name(id);
+    char unk[16];
+    if (!name)
+    {
+      snprintf(unk, sizeof(unk), "f%02x", (unsigned)id);
+      name = unk;
+    }
+    const char *sep = (n > 0) ? " " : "";
+    switch (id & KJ_FT_MASK)
+    {
+    case KJ_FT_U32:
+      n = kj_text_append(out, cap, n, (id == KJ_F_MODE) ? "%s%s=%o" : "%s%s=%u", sep, name,
+                         (unsigned)kj_tlv_u32(val));
+      break;
+    case KJ_FT_I32:
+      n = kj_text_append(out, cap, n, "%s%s=%d", sep, name, (int)kj_tlv_u32(val));
+      break;
+    case KJ_FT_U64:
+      n = kj_text_append(out, cap, n, "%s%s=%llu", sep, name,
+                         (unsigned long long)kj_tlv_u64(val));
+      break;
+    default:
+      n = kj_text_append(out, cap, n, "%s%s=%.*s", sep, name, (int)vlen, (const char *)val);
+      break;
+    }
+  }
+  if (r < 0)
+    n = kj_text_append(out, cap, n, "%s<corrupt>", (n > 0) ? " " : "");
+  return n;
+}
+
+/// @brief 1レコードを人間可読テキストへ変換する。version はヘッダの KJ_VER/KJ_VER_TEXT。
+static inline void kj_format_record(uint16_t version, const kj_rec_hdr_t *rh, const uint8_t *pl,
+                                    size_t pl_len, char *out, size_t cap)
+{
+  if (!out || cap == 0)
+    return;
+  out[0] = '\0';
+  const char *tag = "?";
+  switch (rh->tag)
+  {
+  case KJ_TAG_BEG:
+    tag = "BEGIN";
+    break;
+  case KJ_TAG_CMT:
+    tag = "COMMIT";
+    break;
+  case KJ_TAG_ABR:
+    tag = "ABORT";
+    break;
+  case KJ_TAG_NOTE:
+    tag = "NOTE";
+    break;
+  case KJ_TAG_MDT:
+    tag = "META";
+    break;
+  case KJ_TAG_WRAP:
+    tag = "WRAP";
+    break;
+  default:
+    break;
+  }
+  size_t n = kj_text_append(out, cap, 0, "%s seq=%llu", tag, (unsigned long long)rh->seq);
+  if (!pl || pl_len == 0)
+    return;
+  if (version == KJ_VER_TEXT)
+  {
+    kj_text_append(out, cap, n, " %.*s", (int)pl_len, (const char *)pl);
+    return;
+  }
+  if (rh->tag == KJ_TAG_MDT)
+  {
+    kj_mdt_hdr_t mh;
+    if (pl_len < sizeof(mh))
+    {
+      kj_text_append(out, cap, n, " <corrupt>");
+      return;
+    }
+    memcpy(&mh, pl, sizeof(mh));
+    kj_text_append(out, cap, n, " free_abs=%llu wtime_dirty=%u wtime=%lld.%09u words=%u",
+                   (unsigned long long)mh.free_abs, (mh.flags & KJ_MDT_FLAG_WTIME_DIRTY) ? 1u : 0u,
+                   (long long)mh.wtime_sec, (unsigned)mh.wtime_nsec, (unsigned)mh.word_count);
+    return;
+  }
+  if (pl_len < sizeof(kj_op_hdr_t))
+  {
+    kj_text_append(out, cap, n, " <corrupt>");
+    return;
+  }
+  kj_op_hdr_t oh;
+  memcpy(&oh, pl, sizeof(oh));
+  const char *opname = kj_op_name(oh.op);
+  if (opname)
+    n = kj_text_append(out, cap, n, " op=%s", opname);
+  else if (oh.op != KJ_OP_NONE)
+    n = kj_text_append(out, cap, n, " op=#%u", (unsigned)oh.op);
+  (void)kj_format_fields(pl + sizeof(oh), pl_len - sizeof(oh), out, cap, n);
+}
+
+// Plain CRC32; still used by the v6 layout descriptors and by pre-v4 journals.
+static inline uint32_t kj_crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  return kafs_crc32_update(crc, buf, len);
 }
 
 static inline uint32_t kj_crc32(const void *buf, size_t len)
@@ -55,6 +422,16 @@ static inline uint32_t kj_crc32(const void *buf, size_t len)
   return kj_crc32_update(0, (const uint8_t *)buf, len);
 }
 
+// Journal header/record checksum. The algorithm follows the header version so older rings stay
+// verifiable: CRC32C from KJ_VER 4 on, CRC32 before.
+static inline uint32_t kj_rec_crc_update(uint16_t version, uint32_t crc, const uint8_t *buf,
+                                         size_t len)
+{
+  if (version >= KJ_VER)
+    return kafs_crc32c_update(crc, buf, len);
+  return kafs_crc32_update(crc, buf, len);
+}
+
 static inline size_t kj_header_size(void)
 {
   size_t s = sizeof(kj_header_t);
@@ -102,7 +479,7 @@ static inline uint32_t kj_header_crc_calc(const kj_header_t *hdr)
   kj_header_t tmp = *hdr;
 
   tmp.header_crc = 0;
-  return kj_crc32(&tmp, sizeof(tmp));
+  return kj_rec_crc_update(hdr->version, 0, (const uint8_t *)&tmp, sizeof(tmp));
 }
 
 static inline int kj_header_crc_ok(const kj_header_t *hdr)
@@ -114,7 +491,7 @@ static inline int kj_header_valid_for_area(const kj_header_t *hdr, uint64_t area
 {
   if (!hdr)
     return 0;
-  if (hdr->magic != KJ_MAGIC || hdr->version != KJ_VER)
+  if (hdr->magic != KJ_MAGIC || !kj_version_supported(hdr->version))
     return 0;
   if (hdr->area_size != area_size)
     return 0;
@@ -185,32 +562,80 @@ typedef struct kafs_journal
   uint32_t header_slot_count;
   uint32_t active_header_slot;
   uint64_t header_generation;
+  uint16_t rec_version; // payload/checksum format of the loaded ring (KJ_VER_TEXT..KJ_VER)
   char *base_ptr; // mapped base pointer (ctx->c_superblock + base_off)
+  // lock-free ring reservation: writers CAS ring_resv and fill their record outside jlock;
+  // write_off/write_seq and the header only advance when completed slots are published in order.
+  uint64_t ring_resv;    // packed {ticket, lap, offset} of the next reservation
+  uint64_t ring_pub_pos; // {lap, offset} after the last published record
+  void *ring_slots;      // per-ticket completion slots (opaque)
   // group commit controls
-  uint64_t gc_delay_ns; // group commit window (nanoseconds), 0 disables grouping
-  uint64_t gc_last_ns;  // batch start timestamp (CLOCK_MONOTONIC, ns)
-  int gc_pending;       // 1 if there are unflushed records
+  // write_seq/durable_seq count ring records in ticket order (not transaction ids): every record
+  // up to durable_seq is covered by an fsync that also persisted the header describing it.
+  uint64_t write_seq;      // records published (write_off covers them)
+  uint64_t durable_seq;    // records known durable
+  uint64_t gc_commit_need; // write_seq a flush must reach to cover every COMMIT so far
+  uint64_t gc_sync_need;   // highest target of a blocked fsync caller
+  uint64_t gc_delay_ns;    // upper bound of the batching window (ns), 0 = synchronous commit
+  uint64_t gc_window_ns;   // current window, adapted to the commit arrival rate
+  uint64_t gc_gap_ewma_ns; // moving average of the gap between commits
+  uint64_t gc_last_ns;     // last commit arrival (CLOCK_MONOTONIC, ns)
+  uint64_t gc_first_ns;    // arrival of the oldest commit not yet durable
+  uint32_t gc_waiters;     // threads blocked until durable_seq catches up
+  int gc_err;              // last flush error (-errno), reported to waiters
+  void *gc_flusher;        // opaque flusher thread state (NULL: commits flush inline)
+  uint32_t gc_hdr_busy;    // a header write is in flight on the flusher's io_uring
+  uint32_t gc_uring_on;    // the flusher submits header write + fsync through io_uring
+  uint64_t stat_commits;
+  uint64_t stat_flushes;
+  uint64_t stat_sync_waits;
+  uint64_t stat_uring_flushes;
 } kafs_journal_t;
 
+typedef struct kafs_journal_stats
+{
+  uint64_t commits;    // committed transactions
+  uint64_t flushes;    // fsyncs that advanced durable_seq
+  uint64_t sync_waits; // fsync callers that had to wait for a flush
+  uint64_t window_ns;  // current adaptive batching window
+  uint64_t max_window_ns;
+  uint32_t flusher_running;
+  uint32_t uring;         // flushes go through io_uring (header write linked to fsync)
+  uint64_t uring_flushes; // flushes completed with one io_uring submission
+} kafs_journal_stats_t;
+
 // Initialize journal. In-image journalが存在すれば有効化。KAFS_JOURNAL=0で明示無効。
 int kafs_journal_init(struct kafs_context *ctx, const char *image_path);
 void kafs_journal_shutdown(struct kafs_context *ctx);
 int kafs_journal_is_enabled(struct kafs_context *ctx);
-void kafs_journal_force_flush(struct kafs_context *ctx);
+// Last sequence id handed out (0 when disabled). A successor that loads the journal header
+// sees the same value when nothing was appended in between.
+uint64_t kafs_journal_seq(struct kafs_context *ctx);
+// Make every record appended so far durable. With the flusher running the caller only waits
+// for the batch that covers it; concurrent callers share one fsync. Returns 0 or -errno.
+int kafs_journal_force_flush(struct kafs_context *ctx);
+// Background flusher thread. Start it after daemonizing (threads do not survive fork);
+// without it commits fsync inline. Stopping flushes whatever is still pending.
+int kafs_journal_flusher_start(struct kafs_context *ctx);
+void kafs_journal_flusher_stop(struct kafs_context *ctx);
+void kafs_journal_stats_get(struct kafs_context *ctx, kafs_journal_stats_t *out);
 
 // Start and finish a journal entry. begin returns sequence id (0 when disabled).
-uint64_t kafs_journal_begin(struct kafs_context *ctx, const char *op, const char *fmt, ...);
+// Variadic arguments are (kj_field_t, value) pairs terminated by KJ_F_END, e.g.
+//   kafs_journal_begin(ctx, KJ_OP_CREATE, KJ_F_PATH, path, KJ_F_MODE, (unsigned)mode, KJ_F_END);
+uint64_t kafs_journal_begin(struct kafs_context *ctx, kj_op_t op, ...);
 void kafs_journal_commit(struct kafs_context *ctx, uint64_t seq);
-void kafs_journal_abort(struct kafs_context *ctx, uint64_t seq, const char *reason_fmt, ...);
+void kafs_journal_abort(struct kafs_context *ctx, uint64_t seq, ...);
 
-// Fire-and-forget single-line note (no transaction tracking)
-void kafs_journal_note(struct kafs_context *ctx, const char *op, const char *fmt, ...);
+// Fire-and-forget note (no transaction tracking)
+void kafs_journal_note(struct kafs_context *ctx, kj_op_t op, ...);
 
 // --- Replay support ---
-// Callback: op is the operation name (e.g., "CREATE"), args is the formatted argument string
-// (e.g., "path=/foo mode=100644"). Return 0 on success; nonzero to abort replay early.
-typedef int (*kafs_journal_replay_cb)(struct kafs_context *ctx, const char *op, const char *args,
-                                      void *user);
+// Callback: op is KJ_OP_*, fields is the raw TLV list (walk with kj_tlv_next()).
+// Legacy text rings report the mapped op with no fields. Return 0 on success; nonzero to abort
+// replay early.
+typedef int (*kafs_journal_replay_cb)(struct kafs_context *ctx, uint16_t op, const uint8_t *fields,
+                                      size_t fields_len, void *user);
 
 // Scan the in-image journal ring and invoke cb for each committed operation in order.
 // External sidecar journals are ignored by replay for now (function returns 0 without actions).
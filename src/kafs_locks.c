@@ -1,6 +1,8 @@
 #include "kafs_locks.h"
 #include "kafs_block.h"
 #include "kafs_hash.h"
+#include "kafs_mem_budget.h"
+#include "kafs_sparse.h"
 #include <errno.h>
 #include <inttypes.h>
 #include <stdlib.h>
@@ -19,21 +21,67 @@
 #define KAFS_NOINLINE
 #endif
 
+/// @brief inode 用ストライプ数: inocnt 以上の 2 のべき（上限 KAFS_INODE_LOCK_STRIPES_MAX）
+static uint32_t kafs_inode_stripe_count(uint32_t inocnt)
+{
+  uint32_t n = 1;
+  while (n < inocnt && n < KAFS_INODE_LOCK_STRIPES_MAX)
+    n <<= 1;
+  return n;
+}
+
+int kafs_open_cnt_inc(struct kafs_context *ctx, uint32_t ino)
+{
+  if (!ctx || !ctx->c_open_cnt)
+    return 0;
+  uint32_t *slot = kafs_sparse_u32_slot(ctx->c_open_cnt, ino);
+  if (!slot)
+    return (ino < ctx->c_open_cnt->sp_count) ? -ENOMEM : 0;
+  __atomic_add_fetch(slot, 1u, __ATOMIC_RELAXED);
+  return 0;
+}
+
+uint32_t kafs_open_cnt_dec(struct kafs_context *ctx, uint32_t ino)
+{
+  if (!ctx || !ctx->c_open_cnt)
+    return 0;
+  // inc が確保したチャンクを引くだけなので、ここで新たに確保することはない
+  uint32_t *slot = kafs_sparse_u32_slot(ctx->c_open_cnt, ino);
+  if (!slot)
+    return 0;
+  return __atomic_sub_fetch(slot, 1u, __ATOMIC_RELAXED);
+}
+
 #if KAFS_HAS_PTHREAD
 #include <pthread.h>
 
+// pthread_mutex_t (40B) を 1 キャッシュラインに 1 つ置き、隣のストライプと偽共有しない
+typedef struct
+{
+  pthread_mutex_t m;
+} __attribute__((aligned(64))) kafs_inode_stripe_t;
+
 typedef struct
 {
   pthread_mutex_t global;
   pthread_mutex_t bitmap;
+  pthread_mutex_t cblk[KAFS_CBLK_STRIPES];
   pthread_mutex_t *buckets;
   uint32_t bucket_cnt;
-  // inode locks
-  pthread_mutex_t *inode_mutexes;
-  uint32_t inode_cnt;
+  // inode locks: ino & inode_mask -> stripe
+  kafs_inode_stripe_t *inode_stripes;
+  uint32_t inode_mask;
   pthread_mutex_t inode_alloc;
 } kafs_lock_state_t;
 
+// このスレッドが持っているストライプ（同じストライプの別 inode は再入で数えるだけ）
+typedef struct
+{
+  const kafs_lock_state_t *st;
+  uint32_t stripe;
+  uint32_t cnt;
+} kafs_inode_held_t;
+
 static uint32_t g_robust_unsupported_warned = 0;
 
 typedef enum
@@ -42,6 +90,7 @@ typedef enum
   KAFS_LOCK_RANK_INODE_ALLOC = 20,
   KAFS_LOCK_RANK_INODE = 30,
   KAFS_LOCK_RANK_HRL_BUCKET = 40,
+  KAFS_LOCK_RANK_CBLK = 45,
   KAFS_LOCK_RANK_BITMAP = 50,
 } kafs_lock_rank_t;
 
@@ -56,6 +105,8 @@ static __thread uint32_t g_inode_lock_depth = 0;
 static __thread kafs_blkcnt_t *g_deferred_hrl_refs = NULL;
 static __thread size_t g_deferred_hrl_ref_count = 0;
 static __thread size_t g_deferred_hrl_ref_cap = 0;
+static __thread kafs_inode_held_t g_inode_held[KAFS_INODE_LOCK_HELD_MAX];
+static __thread uint32_t g_inode_held_n = 0;
 
 static long kafs_lock_tid(void);
 static void kafs_lock_dump_backtrace(void);
@@ -420,6 +471,12 @@ static KAFS_NOINLINE void kafs_mutex_unlock_checked(pthread_mutex_t *m, const ch
     kafs_lock_panic("unlock", name, rc);
 }
 
+static void kafs_cblk_locks_destroy(kafs_lock_state_t *st, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; ++i)
+    pthread_mutex_destroy(&st->cblk[i]);
+}
+
 int kafs_ctx_locks_init(struct kafs_context *ctx)
 {
   if (!ctx)
@@ -438,10 +495,27 @@ int kafs_ctx_locks_init(struct kafs_context *ctx)
     free(st);
     return -1;
   }
-  st->bucket_cnt = ctx->c_hrl_bucket_cnt ? ctx->c_hrl_bucket_cnt : 1u;
+  for (uint32_t i = 0; i < KAFS_CBLK_STRIPES; ++i)
+  {
+    if (kafs_mutex_init_checked(&st->cblk[i], "cblk") != 0)
+    {
+      kafs_cblk_locks_destroy(st, i);
+      pthread_mutex_destroy(&st->bitmap);
+      pthread_mutex_destroy(&st->global);
+      free(st);
+      return -1;
+    }
+  }
+  // mem_budget ではロック表の予算を HRL と inode で半分ずつ使い、溢れる分はストライプにまとめる
+  // （バケットロックは 1 つずつしか持たないので、共有しても順序の問題は起きない）。
+  kafs_mem_plan_t plan;
+  kafs_mem_plan(ctx->c_mem_budget, &plan);
+  st->bucket_cnt = kafs_mem_cap_count(plan.mp_locks / 2u, sizeof(pthread_mutex_t),
+                                      ctx->c_hrl_bucket_cnt ? ctx->c_hrl_bucket_cnt : 1u);
   st->buckets = (pthread_mutex_t *)calloc(st->bucket_cnt, sizeof(pthread_mutex_t));
   if (!st->buckets)
   {
+    kafs_cblk_locks_destroy(st, KAFS_CBLK_STRIPES);
     pthread_mutex_destroy(&st->bitmap);
     pthread_mutex_destroy(&st->global);
     free(st);
@@ -454,6 +528,7 @@ int kafs_ctx_locks_init(struct kafs_context *ctx)
       for (uint32_t j = 0; j < i; ++j)
         pthread_mutex_destroy(&st->buckets[j]);
       free(st->buckets);
+      kafs_cblk_locks_destroy(st, KAFS_CBLK_STRIPES);
       pthread_mutex_destroy(&st->bitmap);
       pthread_mutex_destroy(&st->global);
       free(st);
@@ -461,36 +536,33 @@ int kafs_ctx_locks_init(struct kafs_context *ctx)
     }
   }
   // inode locks
-  st->inode_cnt = (uint32_t)kafs_sb_inocnt_get(ctx->c_superblock);
-  if (st->inode_cnt == 0)
-    st->inode_cnt = 1;
-
-  // open-count array (best-effort; only used for unlink/close reclamation)
-  ctx->c_open_cnt = (uint32_t *)calloc(st->inode_cnt, sizeof(uint32_t));
-  st->inode_mutexes = (pthread_mutex_t *)calloc(st->inode_cnt, sizeof(pthread_mutex_t));
-  if (!st->inode_mutexes)
+  uint32_t inocnt = (uint32_t)kafs_sb_inocnt_get(ctx->c_superblock);
+  uint32_t stripes = kafs_mem_cap_count(plan.mp_locks / 2u, sizeof(kafs_inode_stripe_t),
+                                        kafs_inode_stripe_count(inocnt));
+  st->inode_mask = stripes - 1u;
+
+  // open counts (best-effort; only used for unlink/close reclamation)
+  ctx->c_open_cnt = kafs_sparse_u32_create(inocnt ? inocnt : 1u, 0);
+  void *mem = NULL;
+  if (posix_memalign(&mem, sizeof(kafs_inode_stripe_t), stripes * sizeof(kafs_inode_stripe_t)) !=
+      0)
     goto fail_cleanup_buckets;
-  for (uint32_t i = 0; i < st->inode_cnt; ++i)
+  st->inode_stripes = (kafs_inode_stripe_t *)mem;
+  for (uint32_t i = 0; i < stripes; ++i)
   {
-    if (kafs_mutex_init_checked(&st->inode_mutexes[i], "inode") != 0)
+    if (kafs_mutex_init_checked(&st->inode_stripes[i].m, "inode") != 0)
     {
       for (uint32_t j = 0; j < i; ++j)
-        pthread_mutex_destroy(&st->inode_mutexes[j]);
-      free(st->inode_mutexes);
-      for (uint32_t j = 0; j < st->bucket_cnt; ++j)
-        pthread_mutex_destroy(&st->buckets[j]);
-      free(st->buckets);
-      pthread_mutex_destroy(&st->bitmap);
-      pthread_mutex_destroy(&st->global);
-      free(st);
-      return -1;
+        pthread_mutex_destroy(&st->inode_stripes[j].m);
+      free(st->inode_stripes);
+      goto fail_cleanup_buckets;
     }
   }
   if (kafs_mutex_init_checked(&st->inode_alloc, "inode_alloc") != 0)
   {
-    for (uint32_t i = 0; i < st->inode_cnt; ++i)
-      pthread_mutex_destroy(&st->inode_mutexes[i]);
-    free(st->inode_mutexes);
+    for (uint32_t i = 0; i < stripes; ++i)
+      pthread_mutex_destroy(&st->inode_stripes[i].m);
+    free(st->inode_stripes);
     goto fail_cleanup_buckets;
   }
   ctx->c_lock_hrl_global = st;
@@ -500,9 +572,12 @@ int kafs_ctx_locks_init(struct kafs_context *ctx)
   return 0;
 
 fail_cleanup_buckets:
+  kafs_sparse_u32_destroy(ctx->c_open_cnt);
+  ctx->c_open_cnt = NULL;
   for (uint32_t i = 0; i < st->bucket_cnt; ++i)
     pthread_mutex_destroy(&st->buckets[i]);
   free(st->buckets);
+  kafs_cblk_locks_destroy(st, KAFS_CBLK_STRIPES);
   pthread_mutex_destroy(&st->bitmap);
   pthread_mutex_destroy(&st->global);
   free(st);
@@ -517,17 +592,15 @@ void kafs_ctx_locks_destroy(struct kafs_context *ctx)
   for (uint32_t i = 0; i < st->bucket_cnt; ++i)
     pthread_mutex_destroy(&st->buckets[i]);
   free(st->buckets);
-  for (uint32_t i = 0; i < st->inode_cnt; ++i)
-    pthread_mutex_destroy(&st->inode_mutexes[i]);
-  free(st->inode_mutexes);
+  for (uint32_t i = 0; i <= st->inode_mask; ++i)
+    pthread_mutex_destroy(&st->inode_stripes[i].m);
+  free(st->inode_stripes);
   pthread_mutex_destroy(&st->global);
   pthread_mutex_destroy(&st->bitmap);
+  kafs_cblk_locks_destroy(st, KAFS_CBLK_STRIPES);
   pthread_mutex_destroy(&st->inode_alloc);
-  if (ctx->c_open_cnt)
-  {
-    free(ctx->c_open_cnt);
-    ctx->c_open_cnt = NULL;
-  }
+  kafs_sparse_u32_destroy(ctx->c_open_cnt);
+  ctx->c_open_cnt = NULL;
   free(st);
   ctx->c_lock_hrl_buckets = NULL;
   ctx->c_lock_hrl_global = NULL;
@@ -541,9 +614,10 @@ void kafs_hrl_bucket_lock(struct kafs_context *ctx, uint32_t bucket)
     return;
   kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_hrl_buckets;
   kafs_mutex_lock_stat(&st->buckets[bucket % st->bucket_cnt], "hrl_bucket",
-                       KAFS_LOCK_RANK_HRL_BUCKET, &ctx->c_stat_lock_hrl_bucket_acquire,
-                       &ctx->c_stat_lock_hrl_bucket_contended,
-                       &ctx->c_stat_lock_hrl_bucket_wait_ns);
+                       KAFS_LOCK_RANK_HRL_BUCKET,
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_HRL_BUCKET_ACQUIRE),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_HRL_BUCKET_CONTENDED),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_HRL_BUCKET_WAIT_NS));
 }
 
 void kafs_hrl_bucket_unlock(struct kafs_context *ctx, uint32_t bucket)
@@ -561,8 +635,9 @@ void kafs_hrl_global_lock(struct kafs_context *ctx)
     return;
   kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_hrl_global;
   kafs_mutex_lock_stat(&st->global, "hrl_global", KAFS_LOCK_RANK_HRL_GLOBAL,
-                       &ctx->c_stat_lock_hrl_global_acquire, &ctx->c_stat_lock_hrl_global_contended,
-                       &ctx->c_stat_lock_hrl_global_wait_ns);
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_ACQUIRE),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_CONTENDED),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_WAIT_NS));
 }
 
 void kafs_hrl_global_unlock(struct kafs_context *ctx)
@@ -579,8 +654,9 @@ void kafs_bitmap_lock(struct kafs_context *ctx)
     return;
   kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_bitmap;
   kafs_mutex_lock_stat(&st->bitmap, "bitmap", KAFS_LOCK_RANK_BITMAP,
-                       &ctx->c_stat_lock_bitmap_acquire, &ctx->c_stat_lock_bitmap_contended,
-                       &ctx->c_stat_lock_bitmap_wait_ns);
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_BITMAP_ACQUIRE),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_BITMAP_CONTENDED),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_BITMAP_WAIT_NS));
 }
 
 void kafs_bitmap_unlock(struct kafs_context *ctx)
@@ -591,14 +667,60 @@ void kafs_bitmap_unlock(struct kafs_context *ctx)
   kafs_mutex_unlock_checked(&st->bitmap, "bitmap", KAFS_LOCK_RANK_BITMAP);
 }
 
+void kafs_cblk_lock(struct kafs_context *ctx, uint32_t stripe)
+{
+  if (!ctx || !ctx->c_lock_bitmap)
+    return;
+  kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_bitmap;
+  kafs_mutex_lock_stat(&st->cblk[stripe % KAFS_CBLK_STRIPES], "cblk", KAFS_LOCK_RANK_CBLK,
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_CBLK_ACQUIRE),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_CBLK_CONTENDED),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_CBLK_WAIT_NS));
+}
+
+void kafs_cblk_unlock(struct kafs_context *ctx, uint32_t stripe)
+{
+  if (!ctx || !ctx->c_lock_bitmap)
+    return;
+  kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_bitmap;
+  kafs_mutex_unlock_checked(&st->cblk[stripe % KAFS_CBLK_STRIPES], "cblk", KAFS_LOCK_RANK_CBLK);
+}
+
+static kafs_inode_held_t *kafs_inode_held_find(const kafs_lock_state_t *st, uint32_t stripe)
+{
+  for (uint32_t i = 0; i < g_inode_held_n; ++i)
+    if (g_inode_held[i].st == st && g_inode_held[i].stripe == stripe)
+      return &g_inode_held[i];
+  return NULL;
+}
+
 void kafs_inode_lock(struct kafs_context *ctx, uint32_t ino)
 {
   if (!ctx || !ctx->c_lock_inode)
     return;
   kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_inode;
-  kafs_mutex_lock_stat(&st->inode_mutexes[ino % st->inode_cnt], "inode", KAFS_LOCK_RANK_INODE,
-                       &ctx->c_stat_lock_inode_acquire, &ctx->c_stat_lock_inode_contended,
-                       &ctx->c_stat_lock_inode_wait_ns);
+  uint32_t stripe = ino & st->inode_mask;
+  kafs_inode_held_t *h = kafs_inode_held_find(st, stripe);
+  if (h)
+  {
+    // 同じストライプの inode をすでに持っている（同一 inode の多重ロックは従来どおり呼び出し側の誤り）
+    h->cnt++;
+    kafs_stat_add(ctx, KAFS_STAT_LOCK_INODE_ACQUIRE, 1u);
+    kafs_stat_add(ctx, KAFS_STAT_LOCK_INODE_REENTRANT, 1u);
+    g_inode_lock_depth++;
+    return;
+  }
+  if (g_inode_held_n >= KAFS_INODE_LOCK_HELD_MAX)
+  {
+    kafs_log(KAFS_LOG_ERR, "inode-lock-held-overflow: tid=%ld ino=%u\n", kafs_lock_tid(), ino);
+    kafs_lock_dump_backtrace();
+    abort();
+  }
+  kafs_mutex_lock_stat(&st->inode_stripes[stripe].m, "inode", KAFS_LOCK_RANK_INODE,
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_INODE_ACQUIRE),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_INODE_CONTENDED),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_INODE_WAIT_NS));
+  g_inode_held[g_inode_held_n++] = (kafs_inode_held_t){st, stripe, 1u};
   g_inode_lock_depth++;
 }
 
@@ -607,26 +729,62 @@ void kafs_inode_unlock(struct kafs_context *ctx, uint32_t ino)
   if (!ctx || !ctx->c_lock_inode)
     return;
   kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_inode;
-  kafs_mutex_unlock_checked(&st->inode_mutexes[ino % st->inode_cnt], "inode", KAFS_LOCK_RANK_INODE);
-  if (g_inode_lock_depth == 0)
+  uint32_t stripe = ino & st->inode_mask;
+  kafs_inode_held_t *h = kafs_inode_held_find(st, stripe);
+  if (!h || g_inode_lock_depth == 0)
   {
     kafs_log(KAFS_LOG_ERR, "inode-lock-depth-underflow: tid=%ld ino=%u\n", kafs_lock_tid(), ino);
     abort();
   }
+  if (--h->cnt == 0)
+  {
+    *h = g_inode_held[--g_inode_held_n];
+    kafs_mutex_unlock_checked(&st->inode_stripes[stripe].m, "inode", KAFS_LOCK_RANK_INODE);
+  }
   g_inode_lock_depth--;
   if (g_inode_lock_depth == 0)
     kafs_inode_flush_deferred_hrl_refs(ctx);
 }
 
+uint32_t kafs_inode_lock_stripes(struct kafs_context *ctx)
+{
+  if (!ctx || !ctx->c_lock_inode)
+    return 0;
+  return ((kafs_lock_state_t *)ctx->c_lock_inode)->inode_mask + 1u;
+}
+
+uint32_t kafs_hrl_bucket_locks(struct kafs_context *ctx)
+{
+  if (!ctx || !ctx->c_lock_hrl_buckets)
+    return 0;
+  return ((kafs_lock_state_t *)ctx->c_lock_hrl_buckets)->bucket_cnt;
+}
+
+uint64_t kafs_ctx_locks_bytes(struct kafs_context *ctx)
+{
+  if (!ctx || !ctx->c_lock_hrl_global)
+    return 0;
+  const kafs_lock_state_t *st = (const kafs_lock_state_t *)ctx->c_lock_hrl_global;
+  return sizeof(*st) + (uint64_t)st->bucket_cnt * sizeof(pthread_mutex_t) +
+         ((uint64_t)st->inode_mask + 1u) * sizeof(kafs_inode_stripe_t);
+}
+
+uint32_t kafs_inode_lock_stripe(struct kafs_context *ctx, uint32_t ino)
+{
+  if (!ctx || !ctx->c_lock_inode)
+    return ino;
+  return ino & ((kafs_lock_state_t *)ctx->c_lock_inode)->inode_mask;
+}
+
 void kafs_inode_alloc_lock(struct kafs_context *ctx)
 {
   if (!ctx || !ctx->c_lock_inode)
     return;
   kafs_lock_state_t *st = (kafs_lock_state_t *)ctx->c_lock_inode;
   kafs_mutex_lock_stat(&st->inode_alloc, "inode_alloc", KAFS_LOCK_RANK_INODE_ALLOC,
-                       &ctx->c_stat_lock_inode_alloc_acquire,
-                       &ctx->c_stat_lock_inode_alloc_contended,
-                       &ctx->c_stat_lock_inode_alloc_wait_ns);
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_INODE_ALLOC_ACQUIRE),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_INODE_ALLOC_CONTENDED),
+                       kafs_stat_slot(ctx, KAFS_STAT_LOCK_INODE_ALLOC_WAIT_NS));
 }
 
 void kafs_inode_alloc_unlock(struct kafs_context *ctx)
@@ -644,16 +802,14 @@ int kafs_ctx_locks_init(struct kafs_context *ctx)
   if (!ctx)
     return 0;
   uint32_t cnt = (uint32_t)kafs_sb_inocnt_get(ctx->c_superblock);
-  if (cnt == 0)
-    cnt = 1;
-  ctx->c_open_cnt = (uint32_t *)calloc(cnt, sizeof(uint32_t));
+  ctx->c_open_cnt = kafs_sparse_u32_create(cnt ? cnt : 1u, 0);
   return 0;
 }
 void kafs_ctx_locks_destroy(struct kafs_context *ctx)
 {
   if (ctx && ctx->c_open_cnt)
   {
-    free(ctx->c_open_cnt);
+    kafs_sparse_u32_destroy(ctx->c_open_cnt);
     ctx->c_open_cnt = NULL;
   }
 }
@@ -672,6 +828,16 @@ void kafs_hrl_global_unlock(struct kafs_context *ctx) { (void)ctx; }
 
 void kafs_bitmap_lock(struct kafs_context *ctx) { (void)ctx; }
 void kafs_bitmap_unlock(struct kafs_context *ctx) { (void)ctx; }
+void kafs_cblk_lock(struct kafs_context *ctx, uint32_t stripe)
+{
+  (void)ctx;
+  (void)stripe;
+}
+void kafs_cblk_unlock(struct kafs_context *ctx, uint32_t stripe)
+{
+  (void)ctx;
+  (void)stripe;
+}
 
 void kafs_inode_lock(struct kafs_context *ctx, uint32_t ino)
 {
@@ -685,6 +851,26 @@ void kafs_inode_unlock(struct kafs_context *ctx, uint32_t ino)
 }
 void kafs_inode_alloc_lock(struct kafs_context *ctx) { (void)ctx; }
 void kafs_inode_alloc_unlock(struct kafs_context *ctx) { (void)ctx; }
+uint32_t kafs_inode_lock_stripes(struct kafs_context *ctx)
+{
+  (void)ctx;
+  return 0;
+}
+uint32_t kafs_inode_lock_stripe(struct kafs_context *ctx, uint32_t ino)
+{
+  (void)ctx;
+  return ino;
+}
+uint32_t kafs_hrl_bucket_locks(struct kafs_context *ctx)
+{
+  (void)ctx;
+  return 0;
+}
+uint64_t kafs_ctx_locks_bytes(struct kafs_context *ctx)
+{
+  (void)ctx;
+  return 0;
+}
 
 int kafs_inode_release_hrl_ref(struct kafs_context *ctx, kafs_blkcnt_t blo)
 {
@@ -694,3 +880,42 @@ int kafs_inode_release_hrl_ref(struct kafs_context *ctx, kafs_blkcnt_t blo)
 }
 
 #endif
+
+/// @brief ロック順に並べる（ストライプ昇順、同じストライプ内は inode 番号昇順）
+void kafs_inode_lock_sort(struct kafs_context *ctx, uint32_t *inos, size_t n)
+{
+  for (size_t i = 1; i < n; ++i)
+  {
+    uint32_t v = inos[i];
+    uint32_t vs = kafs_inode_lock_stripe(ctx, v);
+    size_t j = i;
+    for (; j > 0; --j)
+    {
+      uint32_t ps = kafs_inode_lock_stripe(ctx, inos[j - 1]);
+      if (ps < vs || (ps == vs && inos[j - 1] <= v))
+        break;
+      inos[j] = inos[j - 1];
+    }
+    inos[j] = v;
+  }
+}
+
+void kafs_inode_lock_pair(struct kafs_context *ctx, uint32_t a, uint32_t b)
+{
+  uint32_t l[2] = {a, b};
+  if (a == b)
+  {
+    kafs_inode_lock(ctx, a);
+    return;
+  }
+  kafs_inode_lock_sort(ctx, l, 2);
+  kafs_inode_lock(ctx, l[0]);
+  kafs_inode_lock(ctx, l[1]);
+}
+
+void kafs_inode_unlock_pair(struct kafs_context *ctx, uint32_t a, uint32_t b)
+{
+  kafs_inode_unlock(ctx, b);
+  if (a != b)
+    kafs_inode_unlock(ctx, a);
+}
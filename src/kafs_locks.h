@@ -22,11 +22,41 @@ void kafs_hrl_global_unlock(struct kafs_context *ctx);
 void kafs_bitmap_lock(struct kafs_context *ctx);
 void kafs_bitmap_unlock(struct kafs_context *ctx);
 
-// Inode locking: per-inode mutex array and an allocation mutex
+// Compressed-block container locks (kafs_cblk.h), KAFS_CBLK_STRIPES of them: stripe i guards open
+// container i, and stripe blo % KAFS_CBLK_STRIPES the slot table of a container no longer open.
+// At most one is held at a time, after the HRL bucket lock and before the bitmap lock.
+void kafs_cblk_lock(struct kafs_context *ctx, uint32_t stripe);
+void kafs_cblk_unlock(struct kafs_context *ctx, uint32_t stripe);
+
+// Inode locking: a fixed striped mutex table (ino -> stripe) and an allocation mutex.
+// Stripe count is the next power of two >= inocnt, capped at KAFS_INODE_LOCK_STRIPES_MAX,
+// so small images keep one mutex per inode. Distinct inodes may share a stripe; a thread
+// may lock several inodes of the same stripe (the stripe is held reentrantly).
+#define KAFS_INODE_LOCK_STRIPES_MAX 16384u
+#define KAFS_INODE_LOCK_HELD_MAX 16u // distinct stripes held at once by one thread
+
 void kafs_inode_lock(struct kafs_context *ctx, uint32_t ino);
 void kafs_inode_unlock(struct kafs_context *ctx, uint32_t ino);
 void kafs_inode_alloc_lock(struct kafs_context *ctx);
 void kafs_inode_alloc_unlock(struct kafs_context *ctx);
+uint32_t kafs_inode_lock_stripes(struct kafs_context *ctx);
+uint32_t kafs_inode_lock_stripe(struct kafs_context *ctx, uint32_t ino);
+
+// Lock table footprint. Under -o mem_budget the HRL bucket mutexes and inode stripes are capped
+// (see kafs_mem_budget.h), so several buckets may share one mutex.
+uint32_t kafs_hrl_bucket_locks(struct kafs_context *ctx);
+uint64_t kafs_ctx_locks_bytes(struct kafs_context *ctx);
+
+// Multi-inode locking (rename/link/create/copy_file_range): always acquire in stripe order,
+// not inode-number order, otherwise two threads can deadlock on shared stripes.
+void kafs_inode_lock_sort(struct kafs_context *ctx, uint32_t *inos, size_t n);
+void kafs_inode_lock_pair(struct kafs_context *ctx, uint32_t a, uint32_t b);
+void kafs_inode_unlock_pair(struct kafs_context *ctx, uint32_t a, uint32_t b);
+
+// Runtime open counts (sparse; see kafs_sparse.h). No-ops when tracking is unavailable.
+// kafs_open_cnt_inc returns -ENOMEM when the counter chunk cannot be allocated.
+int kafs_open_cnt_inc(struct kafs_context *ctx, uint32_t ino);
+uint32_t kafs_open_cnt_dec(struct kafs_context *ctx, uint32_t ino);
 
 // Release an HRL-backed block reference safely from inode paths.
 // If the current thread still holds any inode locks, the actual dec-ref is
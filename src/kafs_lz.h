@@ -0,0 +1,206 @@
+#pragma once
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// データブロック圧縮用の LZ 符号器・復号器（lz4 などへの依存を増やさないための自前実装）。
+// 形式は LZ4 のブロック形式と同じ。シーケンスは
+//   トークン（上位 4bit: リテラル長, 下位 4bit: 一致長 - 4）, 長さの続き（255 の連続 + 端数）,
+//   リテラル, オフセット（2 バイト LE）, 一致長の続き
+// を並べたもので、最後のシーケンスはリテラルだけ。末尾 KAFS_LZ_LAST_LITERALS バイトは必ず
+// リテラルにし、最後の一致は末尾から KAFS_LZ_MFLIMIT バイト以上前で始める。
+// 符号器は 4 バイトのハッシュ表 1 つで貪欲に一致を探すだけ（lz4 の fast 相当）。入力は
+// ブロック 1 つ（KAFS_LZ_MAX_INPUT 以下）。復号器は入力を信用せず、読み書きとも範囲を確かめる
+// （壊れたコンテナを読んでもバッファの外に出ない）。
+
+#define KAFS_LZ_MIN_MATCH 4u
+#define KAFS_LZ_LAST_LITERALS 5u
+#define KAFS_LZ_MFLIMIT 12u
+#define KAFS_LZ_HASH_LOG 12u
+#define KAFS_LZ_MAX_OFFSET 65535u
+#define KAFS_LZ_MAX_INPUT 65536u
+
+static inline uint32_t kafs_lz_read32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t kafs_lz_hash(uint32_t v)
+{
+  return (v * 2654435761u) >> (32u - KAFS_LZ_HASH_LOG);
+}
+
+/// @brief 15 を超えた長さの続きを書く（呼び出し側が空きを確かめてある）
+static inline uint8_t *kafs_lz_put_len(uint8_t *op, uint32_t len)
+{
+  while (len >= 255u)
+  {
+    *op++ = 255u;
+    len -= 255u;
+  }
+  *op++ = (uint8_t)len;
+  return op;
+}
+
+/// @brief リテラル lit バイトと一致（mlen == 0 なら無し）を 1 シーケンスとして書く
+/// @return 書いた後の位置, NULL: cap に収まらない
+static inline uint8_t *kafs_lz_put_seq(uint8_t *op, const uint8_t *oend, const uint8_t *lit_p,
+                                       uint32_t lit, uint32_t off, uint32_t mlen)
+{
+  size_t need = 1u + lit + (lit >= 15u ? lit / 255u + 1u : 0u);
+  if (mlen)
+    need += 2u + (mlen - KAFS_LZ_MIN_MATCH >= 15u ? (mlen - KAFS_LZ_MIN_MATCH) / 255u + 1u : 0u);
+  if ((size_t)(oend - op) < need)
+    return NULL;
+
+  uint8_t *token = op++;
+  *token = (uint8_t)((lit >= 15u ? 15u : lit) << 4);
+  if (lit >= 15u)
+    op = kafs_lz_put_len(op, lit - 15u);
+  memcpy(op, lit_p, lit);
+  op += lit;
+  if (!mlen)
+    return op;
+
+  *op++ = (uint8_t)off;
+  *op++ = (uint8_t)(off >> 8);
+  uint32_t ml = mlen - KAFS_LZ_MIN_MATCH;
+  *token |= (uint8_t)(ml >= 15u ? 15u : ml);
+  if (ml >= 15u)
+    op = kafs_lz_put_len(op, ml - 15u);
+  return op;
+}
+
+/// @brief src の n バイトを圧縮する
+/// @return 圧縮後のバイト数, 0: cap に収まらない（または入力が大きすぎる）
+static inline size_t kafs_lz_compress(const void *src, size_t n, void *dst, size_t cap)
+{
+  if (n > KAFS_LZ_MAX_INPUT)
+    return 0;
+
+  const uint8_t *base = (const uint8_t *)src;
+  const uint8_t *ip = base;
+  const uint8_t *anchor = base;
+  const uint8_t *iend = base + n;
+  uint8_t *op = (uint8_t *)dst;
+  const uint8_t *oend = op + cap;
+  uint32_t table[1u << KAFS_LZ_HASH_LOG]; // 位置 + 1（0 は空き）
+  memset(table, 0, sizeof(table));
+
+  if (n > KAFS_LZ_MFLIMIT)
+  {
+    const uint8_t *mflimit = iend - KAFS_LZ_MFLIMIT;
+    const uint8_t *matchlimit = iend - KAFS_LZ_LAST_LITERALS;
+    uint32_t misses = 0; // 外れが続くほど歩幅を広げる（縮まないデータを早く諦める）
+    while (ip < mflimit)
+    {
+      uint32_t seq = kafs_lz_read32(ip);
+      uint32_t h = kafs_lz_hash(seq);
+      uint32_t cand = table[h];
+      table[h] = (uint32_t)(ip - base) + 1u;
+      if (cand == 0 || (size_t)(ip - base) - (cand - 1u) > KAFS_LZ_MAX_OFFSET ||
+          kafs_lz_read32(base + cand - 1u) != seq)
+      {
+        ip += 1u + (misses++ >> 6);
+        continue;
+      }
+      misses = 0;
+      const uint8_t *ref = base + cand - 1u;
+      while (ip > anchor && ref > base && ip[-1] == ref[-1])
+      {
+        ip--;
+        ref--;
+      }
+      const uint8_t *mp = ip + KAFS_LZ_MIN_MATCH;
+      const uint8_t *rp = ref + KAFS_LZ_MIN_MATCH;
+      while (mp < matchlimit && *mp == *rp)
+      {
+        mp++;
+        rp++;
+      }
+      op = kafs_lz_put_seq(op, oend, anchor, (uint32_t)(ip - anchor), (uint32_t)(ip - ref),
+                           (uint32_t)(mp - ip));
+      if (!op)
+        return 0;
+      ip = mp;
+      anchor = ip;
+    }
+  }
+
+  op = kafs_lz_put_seq(op, oend, anchor, (uint32_t)(iend - anchor), 0, 0);
+  if (!op)
+    return 0;
+  return (size_t)(op - (uint8_t *)dst);
+}
+
+/// @brief 長さの続き（255 の連続 + 端数）を読む
+static inline int kafs_lz_get_len(const uint8_t **pip, const uint8_t *iend, size_t *len)
+{
+  const uint8_t *ip = *pip;
+  uint8_t b;
+  do
+  {
+    if (ip >= iend)
+      return -EIO;
+    b = *ip++;
+    *len += b;
+  } while (b == 255u);
+  *pip = ip;
+  return 0;
+}
+
+/// @brief src の n バイトを dst（cap バイト）に展開する
+/// @param out_len 展開したバイト数
+/// @return 0: 成功, -EIO: 形式が壊れている / cap に収まらない
+static inline int kafs_lz_decompress(const void *src, size_t n, void *dst, size_t cap,
+                                     size_t *out_len)
+{
+  const uint8_t *ip = (const uint8_t *)src;
+  const uint8_t *iend = ip + n;
+  uint8_t *ostart = (uint8_t *)dst;
+  uint8_t *op = ostart;
+  const uint8_t *oend = ostart + cap;
+
+  for (;;)
+  {
+    if (ip >= iend)
+      return -EIO;
+    uint32_t token = *ip++;
+    size_t lit = token >> 4;
+    if (lit == 15u && kafs_lz_get_len(&ip, iend, &lit) != 0)
+      return -EIO;
+    if ((size_t)(iend - ip) < lit || (size_t)(oend - op) < lit)
+      return -EIO;
+    memcpy(op, ip, lit);
+    op += lit;
+    ip += lit;
+    if (ip == iend)
+      break;
+
+    if (iend - ip < 2)
+      return -EIO;
+    size_t off = (size_t)ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    if (off == 0 || off > (size_t)(op - ostart))
+      return -EIO;
+    size_t mlen = token & 15u;
+    if (mlen == 15u && kafs_lz_get_len(&ip, iend, &mlen) != 0)
+      return -EIO;
+    mlen += KAFS_LZ_MIN_MATCH;
+    if ((size_t)(oend - op) < mlen)
+      return -EIO;
+    const uint8_t *m = op - off;
+    if (off >= mlen)
+      memcpy(op, m, mlen);
+    else
+      for (size_t i = 0; i < mlen; ++i) // 重なる一致（繰り返し）は 1 バイトずつ
+        op[i] = m[i];
+    op += mlen;
+  }
+  if (out_len)
+    *out_len = (size_t)(op - ostart);
+  return 0;
+}
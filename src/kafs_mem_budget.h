@@ -0,0 +1,280 @@
+#pragma once
+#include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 省メモリモード（-o mem_budget=SIZE）。小さな機器向けに、イメージの大きさに比例して育つ
+// プロセス内の表とキャッシュを予算の内側に収め、メタデータ領域のマップの常駐を抑える。
+// 予算は次の割合で配る（残りは疎な表・固定長の表・スレッドのスタックなどの余裕）:
+//   ブロックキャッシュ 1/4  : blk_cache_mb をこの値で頭打ちにする
+//   ロック表           1/16 : HRL バケットロックと inode ストライプで半分ずつ。収まらない分は
+//                             複数のバケット / inode で 1 つのロックを共有する（ストライプ化）
+//   ビットマップの複製 1/8  : メタデータ差分ジャーナル用。収まらなければ差分を使わない
+//   メタデータの常駐   1/2  : トリムの目標
+// 疎な表（open 数、epoch、dedup 方針、回収キュー）は触った inode に比例するので頭打ちにはせず、
+// 使用量を報告するだけにする。
+//
+// トリム: メタデータ領域を KAFS_MEM_TRIM_CHUNK ごとに mincore で数え、前回から常駐ページが
+// 増えていない（新しいフォルトが無い）チャンクを休眠とみなす。休眠 1 回目で MADV_COLD を掛け
+// （参照されればカーネルが戻す）、常駐の合計が目標を超えていれば 2 回以上続けて休眠している
+// チャンクから MADV_PAGEOUT する。MAP_SHARED のファイルページなので、汚れていても書き戻されて
+// から落ちるだけで内容は失われない。古いカーネルの EINVAL を見たらその madvise は以後使わない。
+
+#define KAFS_MEM_BUDGET_MIN (4ull << 20)
+#define KAFS_MEM_TRIM_CHUNK (2u * 1024u * 1024u)
+#define KAFS_MEM_TRIM_INTERVAL_MS 5000u
+#define KAFS_MEM_TRIM_REGIONS 8u
+
+#ifndef MADV_COLD
+#define MADV_COLD 20
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+/// @brief "0" / "off" か、k/m/g 接尾辞付きのバイト数を読む
+/// @return 0: 成功（*out = 0 は無制限）, -EINVAL: 書式違いか KAFS_MEM_BUDGET_MIN 未満
+static inline int kafs_mem_budget_parse(const char *s, uint64_t *out)
+{
+  if (!s || !out || *s == '\0')
+    return -EINVAL;
+  if (s[0] == 'o' && s[1] == 'f' && s[2] == 'f' && s[3] == '\0')
+  {
+    *out = 0;
+    return 0;
+  }
+  if (!isdigit((unsigned char)*s))
+    return -EINVAL;
+  char *end = NULL;
+  errno = 0;
+  unsigned long long v = strtoull(s, &end, 10);
+  if (errno != 0 || end == s)
+    return -EINVAL;
+  unsigned shift = 0;
+  if (*end != '\0')
+  {
+    switch (tolower((unsigned char)*end))
+    {
+    case 'k':
+      shift = 10;
+      break;
+    case 'm':
+      shift = 20;
+      break;
+    case 'g':
+      shift = 30;
+      break;
+    default:
+      return -EINVAL;
+    }
+    if (end[1] != '\0')
+      return -EINVAL;
+  }
+  if (v > (UINT64_MAX >> shift))
+    return -EINVAL;
+  v <<= shift;
+  if (v != 0 && v < KAFS_MEM_BUDGET_MIN)
+    return -EINVAL;
+  *out = (uint64_t)v;
+  return 0;
+}
+
+/// @brief 予算の配分（0 は「制限なし」）
+typedef struct kafs_mem_plan
+{
+  uint64_t mp_budget;
+  uint64_t mp_blk_cache;     // ブロックキャッシュの上限
+  uint64_t mp_locks;         // HRL バケットロック + inode ストライプ
+  uint64_t mp_meta_bitmap;   // メタデータ差分用のビットマップ複製
+  uint64_t mp_meta_resident; // トリムが目指すメタデータの常駐量
+} kafs_mem_plan_t;
+
+static inline void kafs_mem_plan(uint64_t budget, kafs_mem_plan_t *p)
+{
+  p->mp_budget = budget;
+  p->mp_blk_cache = budget / 4u;
+  p->mp_locks = budget / 16u;
+  p->mp_meta_bitmap = budget / 8u;
+  p->mp_meta_resident = budget / 2u;
+}
+
+/// @brief unit バイトの要素を cap バイトに収める数（want 以下の 2 のべきに切り下げ、最低 1）
+/// cap が 0 なら want のまま。
+static inline uint32_t kafs_mem_cap_count(uint64_t cap, size_t unit, uint32_t want)
+{
+  if (cap == 0 || unit == 0 || (uint64_t)want * unit <= cap)
+    return want;
+  uint64_t fit = cap / unit;
+  uint32_t n = 1u;
+  while ((uint64_t)n * 2u <= fit && n * 2u <= want && n < (1u << 30))
+    n <<= 1;
+  return n;
+}
+
+/// @brief 休眠メタデータのトリム状態（bg 実行器の 1 項目からしか触らない。統計は atomic で読む）
+typedef struct kafs_mem_trim
+{
+  uint32_t mt_nregions;
+  char *mt_base[KAFS_MEM_TRIM_REGIONS]; // ページ境界に揃えた領域
+  size_t mt_len[KAFS_MEM_TRIM_REGIONS];
+  uint32_t mt_nchunks;
+  uint32_t mt_cursor;    // MADV_PAGEOUT を始めるチャンク（毎回ずらす）
+  uint32_t *mt_resident; // チャンクごとの前回の常駐ページ数
+  uint8_t *mt_idle;      // 続けて休眠した回数（UINT8_MAX で止める）
+  size_t mt_page;
+  int mt_cold_ok;
+  int mt_pageout_ok;
+  uint64_t mt_resident_bytes; // 前回のパスで数えた常駐
+  uint64_t mt_runs;
+  uint64_t mt_cold_bytes;
+  uint64_t mt_pageout_bytes;
+} kafs_mem_trim_t;
+
+/// @brief n 個の領域（先頭はページ境界）を見るトリム状態を作る
+/// @return 状態、失敗時は NULL
+static inline kafs_mem_trim_t *kafs_mem_trim_create(uint32_t n, char *const base[],
+                                                    const size_t len[])
+{
+  if (n > KAFS_MEM_TRIM_REGIONS)
+    n = KAFS_MEM_TRIM_REGIONS;
+  kafs_mem_trim_t *t = (kafs_mem_trim_t *)calloc(1, sizeof(*t));
+  if (!t)
+    return NULL;
+  t->mt_page = (size_t)sysconf(_SC_PAGESIZE);
+  if (t->mt_page == 0 || t->mt_page > KAFS_MEM_TRIM_CHUNK)
+    t->mt_page = 4096u;
+  t->mt_cold_ok = 1;
+  t->mt_pageout_ok = 1;
+  uint64_t chunks = 0;
+  for (uint32_t i = 0; i < n; ++i)
+  {
+    if (!base[i] || len[i] == 0)
+      continue;
+    t->mt_base[t->mt_nregions] = base[i];
+    t->mt_len[t->mt_nregions] = len[i];
+    t->mt_nregions++;
+    chunks += (len[i] + KAFS_MEM_TRIM_CHUNK - 1u) / KAFS_MEM_TRIM_CHUNK;
+  }
+  if (chunks > UINT32_MAX)
+    chunks = UINT32_MAX;
+  t->mt_nchunks = (uint32_t)chunks;
+  t->mt_resident = (uint32_t *)calloc(chunks ? chunks : 1u, sizeof(uint32_t));
+  t->mt_idle = (uint8_t *)calloc(chunks ? chunks : 1u, sizeof(uint8_t));
+  if (!t->mt_resident || !t->mt_idle)
+  {
+    free(t->mt_resident);
+    free(t->mt_idle);
+    free(t);
+    return NULL;
+  }
+  return t;
+}
+
+static inline void kafs_mem_trim_destroy(kafs_mem_trim_t *t)
+{
+  if (!t)
+    return;
+  free(t->mt_resident);
+  free(t->mt_idle);
+  free(t);
+}
+
+/// @brief 状態が占めるバイト数
+static inline uint64_t kafs_mem_trim_bytes(const kafs_mem_trim_t *t)
+{
+  if (!t)
+    return 0;
+  return sizeof(*t) + (uint64_t)t->mt_nchunks * (sizeof(uint32_t) + sizeof(uint8_t));
+}
+
+/// @brief チャンク c の先頭と長さ
+static inline char *kafs_mem_trim_chunk(const kafs_mem_trim_t *t, uint32_t c, size_t *out_len)
+{
+  for (uint32_t r = 0; r < t->mt_nregions; ++r)
+  {
+    uint32_t n = (uint32_t)((t->mt_len[r] + KAFS_MEM_TRIM_CHUNK - 1u) / KAFS_MEM_TRIM_CHUNK);
+    if (c < n)
+    {
+      size_t off = (size_t)c * KAFS_MEM_TRIM_CHUNK;
+      size_t rest = t->mt_len[r] - off;
+      *out_len = rest < KAFS_MEM_TRIM_CHUNK ? rest : KAFS_MEM_TRIM_CHUNK;
+      return t->mt_base[r] + off;
+    }
+    c -= n;
+  }
+  *out_len = 0;
+  return NULL;
+}
+
+/// @brief [p, p + len) の常駐ページ数（mincore が失敗したら 0）
+static inline uint32_t kafs_mem_trim_resident(const kafs_mem_trim_t *t, char *p, size_t len)
+{
+  unsigned char vec[KAFS_MEM_TRIM_CHUNK / 4096u];
+  size_t pages = (len + t->mt_page - 1u) / t->mt_page;
+  if (pages > sizeof(vec) || mincore(p, len, vec) != 0)
+    return 0;
+  uint32_t n = 0;
+  for (size_t i = 0; i < pages; ++i)
+    n += vec[i] & 1u;
+  return n;
+}
+
+/// @brief 1 回分のトリム。target を超えていれば休眠の続いたチャンクを MADV_PAGEOUT する
+/// （target 0 は常駐量を数えて MADV_COLD するだけ）
+/// @return 今回数えた常駐バイト数（MADV_PAGEOUT した分は差し引く）
+static inline uint64_t kafs_mem_trim_pass(kafs_mem_trim_t *t, uint64_t target)
+{
+  if (!t)
+    return 0;
+  uint64_t resident = 0;
+  for (uint32_t c = 0; c < t->mt_nchunks; ++c)
+  {
+    size_t len;
+    char *p = kafs_mem_trim_chunk(t, c, &len);
+    uint32_t pages = p ? kafs_mem_trim_resident(t, p, len) : 0u;
+    if (pages > 0 && pages <= t->mt_resident[c])
+    {
+      if (t->mt_idle[c] < UINT8_MAX)
+        t->mt_idle[c]++;
+    }
+    else
+    {
+      t->mt_idle[c] = 0;
+    }
+    if (t->mt_idle[c] == 1u && t->mt_cold_ok)
+    {
+      if (madvise(p, len, MADV_COLD) == 0)
+        __atomic_add_fetch(&t->mt_cold_bytes, (uint64_t)pages * t->mt_page, __ATOMIC_RELAXED);
+      else if (errno == EINVAL)
+        t->mt_cold_ok = 0;
+    }
+    t->mt_resident[c] = pages;
+    resident += (uint64_t)pages * t->mt_page;
+  }
+
+  for (uint32_t i = 0; i < t->mt_nchunks && target && resident > target && t->mt_pageout_ok; ++i)
+  {
+    uint32_t c = (t->mt_cursor + i) % t->mt_nchunks;
+    if (t->mt_idle[c] < 2u || t->mt_resident[c] == 0)
+      continue;
+    size_t len;
+    char *p = kafs_mem_trim_chunk(t, c, &len);
+    if (madvise(p, len, MADV_PAGEOUT) != 0)
+    {
+      if (errno == EINVAL)
+        t->mt_pageout_ok = 0;
+      continue;
+    }
+    uint64_t bytes = (uint64_t)t->mt_resident[c] * t->mt_page;
+    resident -= bytes;
+    __atomic_add_fetch(&t->mt_pageout_bytes, bytes, __ATOMIC_RELAXED);
+    t->mt_cursor = (c + 1u) % t->mt_nchunks;
+  }
+  __atomic_store_n(&t->mt_resident_bytes, resident, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&t->mt_runs, 1u, __ATOMIC_RELAXED);
+  return resident;
+}
@@ -0,0 +1,207 @@
+#pragma once
+#include "kafs_config.h"
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_hash.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// メタデータ領域（superblock + ビットマップ + inode 表の固定プレフィックス、allocator、HRL index /
+// entries、pendinglog、tailmeta）の mmap 最適化。イメージは従来どおり 1 本の MAP_SHARED マップだが、
+// meta_hugepage では先頭を 2MiB 境界に置いてメタデータ領域だけに MADV_HUGEPAGE を掛け、
+// meta_prefault ではマウント後にバックグラウンドスレッドで MADV_POPULATE_READ して初回アクセスの
+// ページフォルトを前倒しする。どちらも失敗しても動作には影響しない（統計に残すだけ）。
+
+#define KAFS_META_HUGEPAGE_ALIGN (2u * 1024u * 1024u)
+#define KAFS_META_PREFAULT_CHUNK (8u * 1024u * 1024u) // stop フラグを見る間隔
+#define KAFS_META_MAP_REGIONS 6
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+
+enum
+{
+  KAFS_META_PREFAULT_OFF = 0,
+  KAFS_META_PREFAULT_RUNNING = 1,
+  KAFS_META_PREFAULT_DONE = 2,
+  KAFS_META_PREFAULT_STOPPED = 3, // アンマウントで途中終了
+};
+
+static inline uint64_t kafs_meta_map_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/// @brief イメージを PROT_READ|WRITE / MAP_SHARED でマップする
+/// c_meta_hugepage なら仮想アドレスを 2MiB 境界に揃える（ファイル先頭と同じ位相にしないと
+/// huge page で張れない）。余白は予約後に返すので munmap(c_img_base, c_img_size) で解放できる。
+/// @return マップ先頭、失敗時は MAP_FAILED (errno 設定済み)
+static void *kafs_meta_map_image(struct kafs_context *ctx, size_t imgsize, int prot)
+{
+  if (!ctx->c_meta_hugepage)
+    return mmap(NULL, imgsize, prot, MAP_SHARED, ctx->c_fd, 0);
+
+  size_t align = KAFS_META_HUGEPAGE_ALIGN;
+  char *resv = mmap(NULL, imgsize + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (resv == MAP_FAILED)
+    return mmap(NULL, imgsize, prot, MAP_SHARED, ctx->c_fd, 0);
+  char *base = (char *)(((uintptr_t)resv + align - 1u) & ~((uintptr_t)align - 1u));
+  if (base > resv)
+    munmap(resv, (size_t)(base - resv));
+  size_t tail = (size_t)((resv + imgsize + align) - (base + imgsize));
+  if (tail)
+    munmap(base + imgsize, tail);
+  void *p = mmap(base, imgsize, prot, MAP_SHARED | MAP_FIXED, ctx->c_fd, 0);
+  if (p == MAP_FAILED)
+  {
+    int err = errno;
+    munmap(base, imgsize);
+    errno = err;
+  }
+  return p;
+}
+
+/// @brief メタデータ領域の一覧（イメージ先頭からのオフセット、マップ外は切り詰め・空は除外）
+/// @return 領域数
+static int kafs_meta_map_regions(const struct kafs_context *ctx,
+                                 uint64_t off[KAFS_META_MAP_REGIONS],
+                                 uint64_t len[KAFS_META_MAP_REGIONS])
+{
+  const kafs_ssuperblock_t *sb = ctx->c_superblock;
+  const uint64_t cand[KAFS_META_MAP_REGIONS][2] = {
+      {0, ctx->c_mapsize},
+      {kafs_sb_allocator_offset_get(sb), kafs_sb_allocator_size_get(sb)},
+      {kafs_sb_hrl_index_offset_get(sb), kafs_sb_hrl_index_size_get(sb)},
+      {kafs_sb_hrl_entry_offset_get(sb),
+       (uint64_t)kafs_sb_hrl_entry_cnt_get(sb) * sizeof(kafs_hrl_entry_t)},
+      {kafs_sb_pendinglog_offset_get(sb), kafs_sb_pendinglog_size_get(sb)},
+      {kafs_sb_tailmeta_offset_get(sb), kafs_sb_tailmeta_size_get(sb)},
+  };
+  int n = 0;
+  for (int i = 0; i < KAFS_META_MAP_REGIONS; ++i)
+  {
+    uint64_t o = cand[i][0], l = cand[i][1];
+    if (l == 0 || (i > 0 && o == 0) || o >= ctx->c_img_size)
+      continue;
+    if (l > ctx->c_img_size - o)
+      l = ctx->c_img_size - o;
+    off[n] = o;
+    len[n] = l;
+    ++n;
+  }
+  return n;
+}
+
+/// @brief [off, off + len) をページ境界に広げてマップ内のアドレスと長さにする
+static inline char *kafs_meta_map_span(const struct kafs_context *ctx, uint64_t off, uint64_t len,
+                                       size_t *out_len)
+{
+  uint64_t pg = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t start = off & ~(pg - 1u);
+  uint64_t end = (off + len + pg - 1u) & ~(pg - 1u);
+  if (end > ctx->c_img_size)
+    end = ctx->c_img_size;
+  *out_len = (size_t)(end - start);
+  return (char *)ctx->c_img_base + start;
+}
+
+/// @brief meta_hugepage: メタデータ領域に MADV_HUGEPAGE を掛ける（データ領域はそのまま）
+static void kafs_meta_map_advise(struct kafs_context *ctx)
+{
+  if (!ctx->c_meta_hugepage || !ctx->c_img_base || !ctx->c_superblock)
+    return;
+  uint64_t off[KAFS_META_MAP_REGIONS], len[KAFS_META_MAP_REGIONS];
+  int n = kafs_meta_map_regions(ctx, off, len);
+  for (int i = 0; i < n; ++i)
+  {
+    size_t sz;
+    char *p = kafs_meta_map_span(ctx, off[i], len[i], &sz);
+    // EINVAL: THP disabled in the kernel; the mapping stays on 4KiB pages.
+    if (madvise(p, sz, MADV_HUGEPAGE) == 0)
+      __atomic_add_fetch(&ctx->c_stat_meta_hugepage_bytes, (uint64_t)sz, __ATOMIC_RELAXED);
+  }
+}
+
+/// @brief 1 チャンクを読みフォルトで埋める。MADV_POPULATE_READ が無いカーネルでは 1 ページずつ触る。
+static void kafs_meta_prefault_chunk(char *p, size_t sz, int *use_madvise)
+{
+  if (*use_madvise)
+  {
+    if (madvise(p, sz, MADV_POPULATE_READ) == 0)
+      return;
+    if (errno != EINVAL)
+      return;
+    *use_madvise = 0;
+  }
+  size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+  for (size_t o = 0; o < sz; o += pg)
+    (void)*(volatile const char *)(p + o);
+}
+
+static void *kafs_meta_prefault_main(void *arg)
+{
+  struct kafs_context *ctx = (struct kafs_context *)arg;
+  uint64_t off[KAFS_META_MAP_REGIONS], len[KAFS_META_MAP_REGIONS];
+  int n = kafs_meta_map_regions(ctx, off, len);
+  int use_madvise = 1;
+  uint64_t start = kafs_meta_map_now_ns();
+  uint32_t state = KAFS_META_PREFAULT_DONE;
+  for (int i = 0; i < n && state == KAFS_META_PREFAULT_DONE; ++i)
+  {
+    size_t sz;
+    char *p = kafs_meta_map_span(ctx, off[i], len[i], &sz);
+    for (size_t done = 0; done < sz; done += KAFS_META_PREFAULT_CHUNK)
+    {
+      if (__atomic_load_n(&ctx->c_meta_prefault_stop, __ATOMIC_ACQUIRE))
+      {
+        state = KAFS_META_PREFAULT_STOPPED;
+        break;
+      }
+      size_t chunk = (sz - done < KAFS_META_PREFAULT_CHUNK) ? sz - done : KAFS_META_PREFAULT_CHUNK;
+      kafs_meta_prefault_chunk(p + done, chunk, &use_madvise);
+      __atomic_add_fetch(&ctx->c_stat_meta_prefault_bytes, (uint64_t)chunk, __ATOMIC_RELAXED);
+      __atomic_store_n(&ctx->c_stat_meta_prefault_ns, kafs_meta_map_now_ns() - start,
+                       __ATOMIC_RELAXED);
+    }
+  }
+  __atomic_store_n(&ctx->c_meta_prefault_state, state, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/// @brief meta_prefault: メタデータ領域の先読みフォルトをバックグラウンドで始める
+/// スレッドは daemonize 後でないと残らないので kafs_op_init から呼ぶ。
+/// @return 0: 開始（または無効）, < 0: 失敗 (-errno)
+static int kafs_meta_prefault_start(struct kafs_context *ctx)
+{
+  if (!ctx->c_meta_prefault || ctx->c_meta_prefault_running || !ctx->c_img_base ||
+      !ctx->c_superblock)
+    return 0;
+  ctx->c_meta_prefault_stop = 0;
+  __atomic_store_n(&ctx->c_meta_prefault_state, KAFS_META_PREFAULT_RUNNING, __ATOMIC_RELEASE);
+  int rc = pthread_create(&ctx->c_meta_prefault_tid, NULL, kafs_meta_prefault_main, ctx);
+  if (rc != 0)
+  {
+    __atomic_store_n(&ctx->c_meta_prefault_state, KAFS_META_PREFAULT_OFF, __ATOMIC_RELEASE);
+    return -rc;
+  }
+  ctx->c_meta_prefault_running = 1;
+  return 0;
+}
+
+static void kafs_meta_prefault_stop(struct kafs_context *ctx)
+{
+  if (!ctx->c_meta_prefault_running)
+    return;
+  __atomic_store_n(&ctx->c_meta_prefault_stop, 1u, __ATOMIC_RELEASE);
+  pthread_join(ctx->c_meta_prefault_tid, NULL);
+  ctx->c_meta_prefault_running = 0;
+}
@@ -4,7 +4,10 @@
 #include "kafs_context.h"
 #include "kafs_superblock.h"
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 static inline void *kafs_img_ptr(struct kafs_context *ctx, off_t off, size_t len)
 {
@@ -25,3 +28,22 @@ static inline int kafs_img_write(struct kafs_context *ctx, const void *src, size
   memcpy(kafs_img_ptr(ctx, off, len), src, len);
   return 0;
 }
+
+/// @brief イメージの [off, off + len) だけを耐久化する
+/// マップ内ならページ境界に広げて msync(MS_SYNC)（カーネルは範囲内の dirty ページのみ書き出し、
+/// デバイスキャッシュもフラッシュする）。マップ外・未マップなら fdatasync にフォールバックする。
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static inline int kafs_img_sync_range(struct kafs_context *ctx, uint64_t off, uint64_t len)
+{
+  if (len == 0)
+    return 0;
+  if (!ctx->c_img_base || off >= ctx->c_img_size)
+    return (fdatasync(ctx->c_fd) == 0) ? 0 : -errno;
+  if (len > ctx->c_img_size - off)
+    len = ctx->c_img_size - off;
+  uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t start = off & ~(page - 1u);
+  if (msync((char *)ctx->c_img_base + start, (size_t)(off + len - start), MS_SYNC) != 0)
+    return -errno;
+  return 0;
+}
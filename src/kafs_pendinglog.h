@@ -0,0 +1,131 @@
+#pragma once
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// phase3 pending log のイメージ上の形式と、解決スレッドのシャード分けの補助。
+// ログはヘッダの後ろにエントリを並べたリングで、書き込み側が tail に積み、解決側が
+// 終わった（RESOLVED / FAILED）エントリを head から外す。
+// 解決は inode 番号でシャードに分け（ino % n）、シャードごとに 1 本ずつ並行に回す。
+// 同じ inode のエントリは常に同じシャードに入り、シャードはログの順に 1 件ずつ解決するので
+// inode ごとの順序は変わらない（取り付け時の ino_epoch / pending id の照合もそのまま）。
+// 別シャードのエントリは順不同で終わるので、head は先頭から続く終わった分だけ進める。
+// ここの関数はどれも c_pending_worker_lock を持って呼ぶ。
+
+enum
+{
+  KAFS_PENDING_QUEUED = 1,
+  KAFS_PENDING_HASHED = 2,
+  KAFS_PENDING_RESOLVED = 3,
+  KAFS_PENDING_FAILED = 4,
+};
+
+typedef struct kafs_pendinglog_hdr
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+  uint32_t entry_size;
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t tail;
+  uint64_t next_pending_id;
+  uint64_t last_seq;
+  uint64_t reserved[4];
+} __attribute__((packed)) kafs_pendinglog_hdr_t;
+
+typedef struct kafs_pendinglog_entry
+{
+  uint64_t pending_id;
+  uint32_t ino;
+  uint32_t iblk;
+  uint32_t ino_epoch;
+  uint32_t temp_blo;
+  uint32_t state;
+  uint32_t target_hrid;
+  uint32_t reserved0;
+  uint64_t seq;
+} __attribute__((packed)) kafs_pendinglog_entry_t;
+
+// シャードの走査位置。pc_idx より前にあるこのシャードのエントリは全部終わっている。
+// リングの添字は使い回されるので、その位置にあるはずの pending id も覚えて確かめる
+// （pc_idx == tail のときは次に積まれる id）。
+typedef struct kafs_pending_cursor
+{
+  uint32_t pc_idx;
+  uint64_t pc_id;
+} kafs_pending_cursor_t;
+
+static inline uint32_t kafs_pendinglog_next_idx(const kafs_pendinglog_hdr_t *hdr, uint32_t idx)
+{
+  idx += 1u;
+  if (idx >= hdr->capacity)
+    idx = 0;
+  return idx;
+}
+
+static inline kafs_pendinglog_entry_t *kafs_pendinglog_slot(kafs_pendinglog_hdr_t *hdr,
+                                                            uint32_t idx)
+{
+  return (kafs_pendinglog_entry_t *)((char *)(hdr + 1) + (size_t)idx * (size_t)hdr->entry_size);
+}
+
+static inline int kafs_pendinglog_state_done(uint32_t state)
+{
+  return state == KAFS_PENDING_RESOLVED || state == KAFS_PENDING_FAILED;
+}
+
+/// @brief head から idx までの距離（リング上）
+static inline uint32_t kafs_pendinglog_dist(const kafs_pendinglog_hdr_t *hdr, uint32_t idx)
+{
+  return idx >= hdr->head ? idx - hdr->head : hdr->capacity - hdr->head + idx;
+}
+
+/// @brief 走査位置がまだ使えるか（窓 [head, tail] の中にあり、id も一致する）
+static inline int kafs_pending_cursor_valid(kafs_pendinglog_hdr_t *hdr,
+                                            const kafs_pending_cursor_t *cur)
+{
+  if (cur->pc_idx >= hdr->capacity ||
+      kafs_pendinglog_dist(hdr, cur->pc_idx) > kafs_pendinglog_dist(hdr, hdr->tail))
+    return 0;
+  if (cur->pc_idx == hdr->tail)
+    return cur->pc_id == hdr->next_pending_id;
+  return kafs_pendinglog_slot(hdr, cur->pc_idx)->pending_id == cur->pc_id;
+}
+
+/// @brief シャード shard（n 本中）の次の未解決エントリを走査位置から探す
+/// @return 0: *idx に見つけた（走査位置はそこで止まる）, -ENOENT: このシャードの分は無い
+static inline int kafs_pending_shard_next(kafs_pendinglog_hdr_t *hdr, uint32_t shard, uint32_t n,
+                                          kafs_pending_cursor_t *cur, uint32_t *idx)
+{
+  if (hdr->capacity == 0 || n == 0)
+    return -ENOENT;
+  uint32_t i = kafs_pending_cursor_valid(hdr, cur) ? cur->pc_idx : hdr->head;
+  for (; i != hdr->tail; i = kafs_pendinglog_next_idx(hdr, i))
+  {
+    kafs_pendinglog_entry_t *slot = kafs_pendinglog_slot(hdr, i);
+    if (slot->ino % n != shard || kafs_pendinglog_state_done(slot->state))
+      continue;
+    cur->pc_idx = i;
+    cur->pc_id = slot->pending_id;
+    *idx = i;
+    return 0;
+  }
+  cur->pc_idx = hdr->tail;
+  cur->pc_id = hdr->next_pending_id;
+  return -ENOENT;
+}
+
+/// @brief 先頭から続く終わったエントリを外す
+/// @return 外した件数
+static inline uint32_t kafs_pendinglog_trim_done(kafs_pendinglog_hdr_t *hdr)
+{
+  uint32_t n = 0;
+  while (hdr->capacity > 0 && hdr->head != hdr->tail &&
+         kafs_pendinglog_state_done(kafs_pendinglog_slot(hdr, hdr->head)->state))
+  {
+    hdr->head = kafs_pendinglog_next_idx(hdr, hdr->head);
+    n++;
+  }
+  return n;
+}
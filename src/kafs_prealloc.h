@@ -0,0 +1,271 @@
+#pragma once
+#include "kafs_config.h"
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_block.h"
+#include "kafs_locks.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Per-inode speculative preallocation windows.
+//
+// An appending writer (write at or past EOF) arms a window for its inode. The next block
+// allocation for that inode reserves a contiguous run of up to c_prealloc_blocks blocks in the
+// bitmap; subsequent sequential block writes consume the run instead of going through the
+// allocator scan. Unused blocks are returned on last close, truncate, slot eviction, ENOSPC and
+// unmount. Reserved blocks are ordinary "used" bits in the bitmap and are never referenced by an
+// inode, so a crash can only leak them (fsck --punch-hole-unreferenced-data-blocks reclaims).
+//
+// The table is direct-mapped by inode number. c_prealloc_lock is a leaf lock: it is never held
+// while taking the bitmap (or any other) lock.
+
+/// 既定の予約ブロック数 (0: 無効)
+#define KAFS_PREALLOC_BLOCKS_DEFAULT 16u
+/// 予約ブロック数の上限
+#define KAFS_PREALLOC_BLOCKS_MAX 1024u
+/// 予約ウィンドウ表のスロット数 (inode 番号で direct-map)
+#define KAFS_PREALLOC_WINDOW_SLOTS 256u
+
+/// @brief inode 毎の予約ウィンドウ
+typedef struct kafs_prealloc_window
+{
+  /// @brief 所有 inode (KAFS_INO_NONE: 空き)
+  uint32_t pw_ino;
+  /// @brief 次に消費する論理ブロック番号
+  kafs_iblkcnt_t pw_next_iblk;
+  /// @brief 次に消費する物理ブロック番号
+  kafs_blkcnt_t pw_next_blo;
+  /// @brief 未消費の予約ブロック数
+  uint32_t pw_remaining;
+} kafs_prealloc_window_t;
+
+static int kafs_prealloc_enabled(const struct kafs_context *ctx)
+{
+  return ctx && ctx->c_prealloc_windows != NULL && ctx->c_prealloc_blocks > 1u;
+}
+
+static kafs_prealloc_window_t *kafs_prealloc_slot(struct kafs_context *ctx, uint32_t ino)
+{
+  kafs_prealloc_window_t *tbl = (kafs_prealloc_window_t *)ctx->c_prealloc_windows;
+  return &tbl[ino % KAFS_PREALLOC_WINDOW_SLOTS];
+}
+
+/// @brief 予約済み未使用ブロックをビットマップへ返却する
+static void kafs_prealloc_release_run(struct kafs_context *ctx, kafs_blkcnt_t blo, uint32_t cnt)
+{
+  if (cnt == 0)
+    return;
+  for (uint32_t i = 0; i < cnt; ++i)
+    (void)kafs_blk_set_usage(ctx, blo + i, KAFS_FALSE);
+  __atomic_sub_fetch(&ctx->c_prealloc_outstanding, (uint64_t)cnt, __ATOMIC_RELAXED);
+  kafs_stat_add(ctx, KAFS_STAT_PREALLOC_WASTED_BLOCKS, (uint64_t)cnt);
+}
+
+// Detach the unused tail of a window (caller holds c_prealloc_lock).
+static void kafs_prealloc_detach_locked(kafs_prealloc_window_t *w, kafs_blkcnt_t *blo,
+                                        uint32_t *cnt)
+{
+  *blo = w->pw_next_blo;
+  *cnt = w->pw_remaining;
+  memset(w, 0, sizeof(*w));
+}
+
+/// @brief 予約ウィンドウ表を初期化する (c_prealloc_blocks <= 1 なら何もしない)
+/// @param ctx コンテキスト
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static int kafs_prealloc_init(struct kafs_context *ctx)
+{
+  if (ctx->c_prealloc_blocks <= 1u || ctx->c_prealloc_windows)
+    return 0;
+  if (pthread_mutex_init(&ctx->c_prealloc_lock, NULL) != 0)
+    return -ENOMEM;
+  ctx->c_prealloc_windows = calloc(KAFS_PREALLOC_WINDOW_SLOTS, sizeof(kafs_prealloc_window_t));
+  if (!ctx->c_prealloc_windows)
+  {
+    pthread_mutex_destroy(&ctx->c_prealloc_lock);
+    return -ENOMEM;
+  }
+  return 0;
+}
+
+/// @brief inode の予約ウィンドウを解放する（最終 close / truncate 時）
+static void kafs_prealloc_release_ino(struct kafs_context *ctx, uint32_t ino)
+{
+  if (!kafs_prealloc_enabled(ctx))
+    return;
+  kafs_blkcnt_t blo = KAFS_BLO_NONE;
+  uint32_t cnt = 0;
+  pthread_mutex_lock(&ctx->c_prealloc_lock);
+  kafs_prealloc_window_t *w = kafs_prealloc_slot(ctx, ino);
+  if (w->pw_ino == ino)
+    kafs_prealloc_detach_locked(w, &blo, &cnt);
+  pthread_mutex_unlock(&ctx->c_prealloc_lock);
+  kafs_prealloc_release_run(ctx, blo, cnt);
+}
+
+/// @brief 全ウィンドウの未使用ブロックを返却する
+/// @return 返却したブロック数
+static uint32_t kafs_prealloc_release_all(struct kafs_context *ctx)
+{
+  if (!kafs_prealloc_enabled(ctx))
+    return 0;
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < KAFS_PREALLOC_WINDOW_SLOTS; ++i)
+  {
+    kafs_blkcnt_t blo = KAFS_BLO_NONE;
+    uint32_t cnt = 0;
+    pthread_mutex_lock(&ctx->c_prealloc_lock);
+    kafs_prealloc_window_t *w = &((kafs_prealloc_window_t *)ctx->c_prealloc_windows)[i];
+    if (w->pw_ino != KAFS_INO_NONE)
+      kafs_prealloc_detach_locked(w, &blo, &cnt);
+    pthread_mutex_unlock(&ctx->c_prealloc_lock);
+    kafs_prealloc_release_run(ctx, blo, cnt);
+    total += cnt;
+  }
+  return total;
+}
+
+/// @brief 予約ウィンドウ表を破棄する（未使用ブロックは返却）
+static void kafs_prealloc_destroy(struct kafs_context *ctx)
+{
+  if (!ctx->c_prealloc_windows)
+    return;
+  (void)kafs_prealloc_release_all(ctx);
+  free(ctx->c_prealloc_windows);
+  ctx->c_prealloc_windows = NULL;
+  pthread_mutex_destroy(&ctx->c_prealloc_lock);
+}
+
+/// @brief EOF 以降への追記開始時にウィンドウを張る
+/// @param ctx コンテキスト
+/// @param ino inode 番号
+/// @param iblk 追記で最初に書き込む論理ブロック番号
+static void kafs_prealloc_arm(struct kafs_context *ctx, uint32_t ino, kafs_iblkcnt_t iblk)
+{
+  if (!kafs_prealloc_enabled(ctx))
+    return;
+  kafs_blkcnt_t blo = KAFS_BLO_NONE;
+  uint32_t cnt = 0;
+  pthread_mutex_lock(&ctx->c_prealloc_lock);
+  kafs_prealloc_window_t *w = kafs_prealloc_slot(ctx, ino);
+  // A continuing append re-enters at the block after the last one written, or rewrites the
+  // partially filled last block; keep the window in both cases.
+  if (w->pw_ino == ino && (iblk == w->pw_next_iblk || iblk + 1u == w->pw_next_iblk))
+  {
+    pthread_mutex_unlock(&ctx->c_prealloc_lock);
+    return;
+  }
+  if (w->pw_ino != KAFS_INO_NONE)
+    kafs_prealloc_detach_locked(w, &blo, &cnt);
+  w->pw_ino = ino;
+  w->pw_next_iblk = iblk;
+  pthread_mutex_unlock(&ctx->c_prealloc_lock);
+  kafs_prealloc_release_run(ctx, blo, cnt);
+}
+
+// Reserve [*pblo, *pblo + *pcnt) with the first block coming from the regular allocator and the
+// rest claimed contiguously after it. Extension is skipped when free space is low.
+static int kafs_prealloc_reserve_run(struct kafs_context *ctx, uint32_t want, kafs_blkcnt_t *pblo,
+                                     uint32_t *pcnt)
+{
+  kafs_blkcnt_t blo = KAFS_BLO_NONE;
+  int rc = kafs_blk_alloc(ctx, &blo);
+  if (rc < 0)
+    return rc;
+
+  kafs_blkcnt_t blocnt = kafs_sb_blkcnt_get(ctx->c_superblock);
+  uint32_t cnt = 1;
+  kafs_bitmap_lock(ctx);
+  kafs_blkcnt_t free_blocks = kafs_sb_blkcnt_free_get(ctx->c_superblock);
+  if ((uint64_t)free_blocks >= (uint64_t)want * KAFS_PREALLOC_WINDOW_SLOTS)
+  {
+    while (cnt < want && blo + cnt < blocnt)
+    {
+      if (kafs_blk_try_claim_nolock(ctx, blo + cnt) <= 0)
+        break;
+      ++cnt;
+    }
+    if (cnt > 1u)
+      ctx->c_blo_search = blo + cnt - 1u;
+  }
+  kafs_bitmap_unlock(ctx);
+
+  *pblo = blo;
+  *pcnt = cnt;
+  return 0;
+}
+
+/// @brief データブロックを確保する（予約ウィンドウがあれば優先して消費）
+/// @param ctx コンテキスト
+/// @param ino 書き込み先 inode 番号
+/// @param iblk 書き込み先の論理ブロック番号
+/// @param pblo 確保したブロック番号 (*pblo == KAFS_BLO_NONE で呼ぶこと)
+/// @return 0: 成功, < 0: 失敗 (-errno)
+static int kafs_prealloc_blk_alloc(struct kafs_context *ctx, uint32_t ino, kafs_iblkcnt_t iblk,
+                                   kafs_blkcnt_t *pblo)
+{
+  if (!kafs_prealloc_enabled(ctx))
+    return kafs_blk_alloc(ctx, pblo);
+
+  pthread_mutex_lock(&ctx->c_prealloc_lock);
+  kafs_prealloc_window_t *w = kafs_prealloc_slot(ctx, ino);
+  if (w->pw_ino != ino)
+  {
+    pthread_mutex_unlock(&ctx->c_prealloc_lock);
+    int rc = kafs_blk_alloc(ctx, pblo);
+    if (rc == -ENOSPC && kafs_prealloc_release_all(ctx) > 0)
+      rc = kafs_blk_alloc(ctx, pblo);
+    return rc;
+  }
+  if (w->pw_next_iblk == iblk && w->pw_remaining > 0)
+  {
+    *pblo = w->pw_next_blo++;
+    w->pw_next_iblk++;
+    w->pw_remaining--;
+    pthread_mutex_unlock(&ctx->c_prealloc_lock);
+    __atomic_sub_fetch(&ctx->c_prealloc_outstanding, 1u, __ATOMIC_RELAXED);
+    kafs_stat_add(ctx, KAFS_STAT_PREALLOC_HITS, 1u);
+    return 0;
+  }
+  if (w->pw_next_iblk != iblk)
+  {
+    // Out-of-order write into an armed inode (e.g. rewrite of the partial tail block).
+    pthread_mutex_unlock(&ctx->c_prealloc_lock);
+    kafs_stat_add(ctx, KAFS_STAT_PREALLOC_MISSES, 1u);
+    return kafs_blk_alloc(ctx, pblo);
+  }
+  pthread_mutex_unlock(&ctx->c_prealloc_lock);
+
+  // Window exhausted (or freshly armed): reserve the next run outside the table lock.
+  kafs_blkcnt_t run_blo = KAFS_BLO_NONE;
+  uint32_t run_cnt = 0;
+  int rc = kafs_prealloc_reserve_run(ctx, ctx->c_prealloc_blocks, &run_blo, &run_cnt);
+  if (rc == -ENOSPC && kafs_prealloc_release_all(ctx) > 0)
+    rc = kafs_prealloc_reserve_run(ctx, 1u, &run_blo, &run_cnt);
+  if (rc < 0)
+    return rc;
+  kafs_stat_add(ctx, KAFS_STAT_PREALLOC_WINDOWS, 1u);
+  kafs_stat_add(ctx, KAFS_STAT_PREALLOC_RESERVED_BLOCKS, (uint64_t)run_cnt);
+  // Not served from an existing window: hits count only blocks a window saved a scan for.
+  kafs_stat_add(ctx, KAFS_STAT_PREALLOC_MISSES, 1u);
+  __atomic_add_fetch(&ctx->c_prealloc_outstanding, (uint64_t)(run_cnt - 1u), __ATOMIC_RELAXED);
+
+  kafs_blkcnt_t spare_blo = run_blo + 1u;
+  uint32_t spare_cnt = run_cnt - 1u;
+  pthread_mutex_lock(&ctx->c_prealloc_lock);
+  if (w->pw_ino == ino && w->pw_next_iblk == iblk && w->pw_remaining == 0)
+  {
+    w->pw_next_iblk = iblk + 1u;
+    w->pw_next_blo = spare_blo;
+    w->pw_remaining = spare_cnt;
+    spare_cnt = 0;
+  }
+  pthread_mutex_unlock(&ctx->c_prealloc_lock);
+  // The slot was re-armed or evicted concurrently; give the spare blocks back.
+  kafs_prealloc_release_run(ctx, spare_blo, spare_cnt);
+
+  *pblo = run_blo;
+  return 0;
+}
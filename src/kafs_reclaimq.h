@@ -0,0 +1,233 @@
+#pragma once
+#include "kafs_sparse.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// tombstone（linkcnt 0 / dtime あり）inode の回収待ちキュー。
+// inode 番号で引く前後リンクを疎な配列（kafs_sparse.h）に持つ侵入型の双方向リストで、
+// unlink / 最後の close で末尾に積み、回収時にどこからでも O(1) で外す。積む時刻 = dtime なので
+// 先頭が最も古い tombstone になる（マウント後の走査で見つけた分は sort で並べ直す）。
+// リンク 0 は「なし」: inode 0 は使われないので番兵にできる。先頭は rq_prev が 0 なので
+// 登録済みかは「先頭か、rq_prev が非 0 か」で判定する。
+// ロック順: inode ロック → rq_lock（コールバックは rq_lock を持ったまま呼ぶので
+// 他のロックを取らない）
+
+typedef struct kafs_reclaimq
+{
+  pthread_mutex_t rq_lock;
+  kafs_sparse_u32_t *rq_prev;
+  kafs_sparse_u32_t *rq_next;
+  uint32_t rq_head; // 0: 空
+  uint32_t rq_tail;
+  uint32_t rq_len;
+} kafs_reclaimq_t;
+
+/// @brief inode 総数 count のキューを作る（リンク用のチャンクは積んだときに確保する）
+/// @return キュー、失敗時は NULL
+static inline kafs_reclaimq_t *kafs_reclaimq_create(uint32_t count)
+{
+  kafs_reclaimq_t *q = (kafs_reclaimq_t *)calloc(1, sizeof(*q));
+  if (!q)
+    return NULL;
+  q->rq_prev = kafs_sparse_u32_create(count, 0);
+  q->rq_next = kafs_sparse_u32_create(count, 0);
+  if (!q->rq_prev || !q->rq_next)
+  {
+    kafs_sparse_u32_destroy(q->rq_prev);
+    kafs_sparse_u32_destroy(q->rq_next);
+    free(q);
+    return NULL;
+  }
+  pthread_mutex_init(&q->rq_lock, NULL);
+  return q;
+}
+
+static inline void kafs_reclaimq_destroy(kafs_reclaimq_t *q)
+{
+  if (!q)
+    return;
+  pthread_mutex_destroy(&q->rq_lock);
+  kafs_sparse_u32_destroy(q->rq_prev);
+  kafs_sparse_u32_destroy(q->rq_next);
+  free(q);
+}
+
+static inline int kafs_reclaimq_contains_locked(const kafs_reclaimq_t *q, uint32_t ino)
+{
+  return ino != 0 && (ino == q->rq_head || kafs_sparse_u32_get(q->rq_prev, ino) != 0);
+}
+
+static inline void kafs_reclaimq_link_set(kafs_sparse_u32_t *sp, uint32_t ino, uint32_t v)
+{
+  uint32_t *slot = kafs_sparse_u32_slot(sp, ino);
+  if (slot)
+    *slot = v;
+}
+
+/// @brief 末尾（at_head なら先頭）に積む。積み済みなら何もしない。
+/// @return 1: 積んだ, 0: 積み済み, -EINVAL: ino 範囲外, -ENOMEM: リンク用チャンクを確保できない
+static int kafs_reclaimq_push(kafs_reclaimq_t *q, uint32_t ino, int at_head)
+{
+  if (!q || ino == 0 || ino >= q->rq_prev->sp_count)
+    return -EINVAL;
+  // 書く前にチャンクを確保しておき、途中で失敗してリストが壊れないようにする。
+  if (!kafs_sparse_u32_slot(q->rq_prev, ino) || !kafs_sparse_u32_slot(q->rq_next, ino))
+    return -ENOMEM;
+  pthread_mutex_lock(&q->rq_lock);
+  if (kafs_reclaimq_contains_locked(q, ino))
+  {
+    pthread_mutex_unlock(&q->rq_lock);
+    return 0;
+  }
+  if (q->rq_head == 0)
+  {
+    kafs_reclaimq_link_set(q->rq_prev, ino, 0);
+    kafs_reclaimq_link_set(q->rq_next, ino, 0);
+    q->rq_head = q->rq_tail = ino;
+  }
+  else if (at_head)
+  {
+    kafs_reclaimq_link_set(q->rq_prev, ino, 0);
+    kafs_reclaimq_link_set(q->rq_next, ino, q->rq_head);
+    kafs_reclaimq_link_set(q->rq_prev, q->rq_head, ino);
+    q->rq_head = ino;
+  }
+  else
+  {
+    kafs_reclaimq_link_set(q->rq_prev, ino, q->rq_tail);
+    kafs_reclaimq_link_set(q->rq_next, ino, 0);
+    kafs_reclaimq_link_set(q->rq_next, q->rq_tail, ino);
+    q->rq_tail = ino;
+  }
+  q->rq_len++;
+  pthread_mutex_unlock(&q->rq_lock);
+  return 1;
+}
+
+/// @brief キューから外す
+/// @return 1: 外した, 0: 入っていなかった
+static int kafs_reclaimq_remove(kafs_reclaimq_t *q, uint32_t ino)
+{
+  if (!q)
+    return 0;
+  pthread_mutex_lock(&q->rq_lock);
+  if (!kafs_reclaimq_contains_locked(q, ino))
+  {
+    pthread_mutex_unlock(&q->rq_lock);
+    return 0;
+  }
+  uint32_t prev = kafs_sparse_u32_get(q->rq_prev, ino);
+  uint32_t next = kafs_sparse_u32_get(q->rq_next, ino);
+  if (prev)
+    kafs_reclaimq_link_set(q->rq_next, prev, next);
+  else
+    q->rq_head = next;
+  if (next)
+    kafs_reclaimq_link_set(q->rq_prev, next, prev);
+  else
+    q->rq_tail = prev;
+  kafs_reclaimq_link_set(q->rq_prev, ino, 0);
+  kafs_reclaimq_link_set(q->rq_next, ino, 0);
+  q->rq_len--;
+  pthread_mutex_unlock(&q->rq_lock);
+  return 1;
+}
+
+/// @brief 先頭（最も古い tombstone）と件数
+/// @return 先頭の inode 番号、空なら 0
+static inline uint32_t kafs_reclaimq_peek(kafs_reclaimq_t *q, uint32_t *len)
+{
+  if (!q)
+  {
+    if (len)
+      *len = 0;
+    return 0;
+  }
+  pthread_mutex_lock(&q->rq_lock);
+  uint32_t head = q->rq_head;
+  if (len)
+    *len = q->rq_len;
+  pthread_mutex_unlock(&q->rq_lock);
+  return head;
+}
+
+/// @brief 先頭から skip が 0 を返すものを最大 max 個集める（見るのは最大 max_visit 個）
+/// @param visited 見た件数（NULL 可）
+/// @return 集めた件数
+static uint32_t kafs_reclaimq_collect(kafs_reclaimq_t *q, uint32_t *out, uint32_t max,
+                                      uint32_t max_visit, int (*skip)(void *arg, uint32_t ino),
+                                      void *arg, uint32_t *visited)
+{
+  uint32_t n = 0, seen = 0;
+  if (q)
+  {
+    pthread_mutex_lock(&q->rq_lock);
+    for (uint32_t ino = q->rq_head; ino != 0 && n < max && seen < max_visit;
+         ino = kafs_sparse_u32_get(q->rq_next, ino))
+    {
+      seen++;
+      if (!skip || !skip(arg, ino))
+        out[n++] = ino;
+    }
+    pthread_mutex_unlock(&q->rq_lock);
+  }
+  if (visited)
+    *visited = seen;
+  return n;
+}
+
+typedef struct
+{
+  uint64_t key;
+  uint32_t ino;
+} kafs_reclaimq_sort_ent_t;
+
+static int kafs_reclaimq_sort_cmp(const void *a, const void *b)
+{
+  const kafs_reclaimq_sort_ent_t *x = a, *y = b;
+  if (x->key != y->key)
+    return x->key < y->key ? -1 : 1;
+  return x->ino < y->ino ? -1 : (x->ino > y->ino);
+}
+
+/// @brief key（dtime など）の昇順に並べ直す。走査で先頭に積んだ分を整列させるのに 1 回だけ使う。
+/// @return 0: 成功, -ENOMEM: 作業領域を確保できない（順序はそのまま）
+static int kafs_reclaimq_sort(kafs_reclaimq_t *q, uint64_t (*key)(void *arg, uint32_t ino),
+                              void *arg)
+{
+  if (!q)
+    return 0;
+  pthread_mutex_lock(&q->rq_lock);
+  uint32_t n = q->rq_len;
+  kafs_reclaimq_sort_ent_t *ents =
+      n > 1 ? (kafs_reclaimq_sort_ent_t *)malloc((size_t)n * sizeof(*ents)) : NULL;
+  if (n > 1 && !ents)
+  {
+    pthread_mutex_unlock(&q->rq_lock);
+    return -ENOMEM;
+  }
+  if (n > 1)
+  {
+    uint32_t i = 0;
+    for (uint32_t ino = q->rq_head; ino != 0 && i < n; ino = kafs_sparse_u32_get(q->rq_next, ino))
+    {
+      ents[i].key = key(arg, ino);
+      ents[i].ino = ino;
+      i++;
+    }
+    qsort(ents, n, sizeof(*ents), kafs_reclaimq_sort_cmp);
+    for (i = 0; i < n; ++i)
+    {
+      kafs_reclaimq_link_set(q->rq_prev, ents[i].ino, i > 0 ? ents[i - 1u].ino : 0);
+      kafs_reclaimq_link_set(q->rq_next, ents[i].ino, i + 1u < n ? ents[i + 1u].ino : 0);
+    }
+    q->rq_head = ents[0].ino;
+    q->rq_tail = ents[n - 1u].ino;
+  }
+  pthread_mutex_unlock(&q->rq_lock);
+  free(ents);
+  return 0;
+}
@@ -1,23 +1,47 @@
 #include "kafs_rpc.h"
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-static int kafs_rpc_write_full(int fd, const void *buf, size_t len)
+int kafs_rpc_writev_full(int fd, struct iovec *iov, int iovcnt)
 {
-  const char *p = (const char *)buf;
-  size_t off = 0;
-  while (off < len)
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  for (;;)
   {
-    ssize_t w = write(fd, p + off, len - off);
+    while (iovcnt > 0 && iov->iov_len == 0)
+    {
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt == 0)
+      return 0;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t)iovcnt;
+    ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (w < 0 && errno == ENOTSOCK)
+      w = writev(fd, iov, iovcnt);
     if (w < 0)
       return -errno;
     if (w == 0)
       return -EIO;
-    off += (size_t)w;
+    size_t left = (size_t)w;
+    while (iovcnt > 0 && left >= iov->iov_len)
+    {
+      left -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0)
+    {
+      iov->iov_base = (char *)iov->iov_base + left;
+      iov->iov_len -= left;
+    }
   }
-  return 0;
 }
 
 static int kafs_rpc_read_full(int fd, void *buf, size_t len)
@@ -38,7 +62,7 @@ static int kafs_rpc_read_full(int fd, void *buf, size_t len)
 
 static int kafs_rpc_discard(int fd, uint32_t len)
 {
-  char tmp[256];
+  char tmp[4096];
   uint32_t left = len;
   while (left > 0)
   {
@@ -54,18 +78,43 @@ static int kafs_rpc_discard(int fd, uint32_t len)
 static int kafs_rpc_send_with_hdr(int fd, const void *hdr, size_t hdr_len, const void *payload,
                                   uint32_t payload_len)
 {
-  int rc = kafs_rpc_write_full(fd, hdr, hdr_len);
-  if (rc != 0)
-    return rc;
-  if (payload_len == 0)
-    return 0;
-  return kafs_rpc_write_full(fd, payload, payload_len);
+  struct iovec iov[2];
+  iov[0].iov_base = (void *)hdr;
+  iov[0].iov_len = hdr_len;
+  iov[1].iov_base = (void *)payload;
+  iov[1].iov_len = payload_len;
+  return kafs_rpc_writev_full(fd, iov, 2);
+}
+
+static int kafs_rpc_check_hdr(const kafs_rpc_hdr_t *hdr)
+{
+  if (hdr->magic != KAFS_RPC_MAGIC)
+    return -EBADMSG;
+  if (hdr->version != KAFS_RPC_VERSION)
+    return -EPROTONOSUPPORT;
+  if ((hdr->flags & KAFS_RPC_FLAG_ENDIAN_HOST) == 0)
+    return -EPROTONOSUPPORT;
+  return 0;
+}
+
+static void kafs_rpc_fill_hdr(kafs_rpc_hdr_t *hdr, uint16_t op, uint32_t flags, uint64_t req_id,
+                              uint64_t session_id, uint32_t epoch, uint32_t payload_len)
+{
+  memset(hdr, 0, sizeof(*hdr));
+  hdr->magic = KAFS_RPC_MAGIC;
+  hdr->version = KAFS_RPC_VERSION;
+  hdr->op = op;
+  hdr->flags = flags;
+  hdr->req_id = req_id;
+  hdr->session_id = session_id;
+  hdr->epoch = epoch;
+  hdr->payload_len = payload_len;
 }
 
 static int kafs_rpc_recv_payload(int fd, uint32_t in_len, void *payload, uint32_t payload_cap,
                                  uint32_t *payload_len)
 {
-  if (in_len > KAFS_RPC_MAX_PAYLOAD)
+  if (in_len > KAFS_RPC_MAX_PAYLOAD_LARGE)
     return -EMSGSIZE;
   if (payload_len)
     *payload_len = in_len;
@@ -88,42 +137,130 @@ uint64_t kafs_rpc_next_req_id(void)
 int kafs_rpc_send_msg(int fd, uint16_t op, uint32_t flags, uint64_t req_id, uint64_t session_id,
                       uint32_t epoch, const void *payload, uint32_t payload_len)
 {
-  if (payload_len > KAFS_RPC_MAX_PAYLOAD)
+  if (payload_len > KAFS_RPC_MAX_PAYLOAD_LARGE)
     return -EMSGSIZE;
   if (payload_len != 0 && payload == NULL)
     return -EINVAL;
   kafs_rpc_hdr_t hdr;
-  memset(&hdr, 0, sizeof(hdr));
-  hdr.magic = KAFS_RPC_MAGIC;
-  hdr.version = KAFS_RPC_VERSION;
-  hdr.op = op;
-  hdr.flags = flags;
-  hdr.req_id = req_id;
-  hdr.session_id = session_id;
-  hdr.epoch = epoch;
-  hdr.payload_len = payload_len;
+  kafs_rpc_fill_hdr(&hdr, op, flags, req_id, session_id, epoch, payload_len);
   return kafs_rpc_send_with_hdr(fd, &hdr, sizeof(hdr), payload, payload_len);
 }
 
+// ヘッダと本文を 1 回の sendmsg で送り、pass_fd >= 0 なら SCM_RIGHTS で添える。
+// 途中で切れた残りは普通に書く（fd は最初の 1 バイトと一緒に届いている）。
+int kafs_rpc_send_msg_fd(int fd, uint16_t op, uint32_t flags, uint64_t req_id, uint64_t session_id,
+                         uint32_t epoch, const void *payload, uint32_t payload_len, int pass_fd)
+{
+  if (payload_len > KAFS_RPC_MAX_PAYLOAD_LARGE)
+    return -EMSGSIZE;
+  if (payload_len != 0 && payload == NULL)
+    return -EINVAL;
+  kafs_rpc_hdr_t hdr;
+  kafs_rpc_fill_hdr(&hdr, op, flags, req_id, session_id, epoch, payload_len);
+
+  struct iovec iov[2];
+  iov[0].iov_base = &hdr;
+  iov[0].iov_len = sizeof(hdr);
+  iov[1].iov_base = (void *)payload;
+  iov[1].iov_len = payload_len;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } cbuf;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = payload_len ? 2 : 1;
+  if (pass_fd >= 0)
+  {
+    memset(&cbuf, 0, sizeof(cbuf));
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = sizeof(cbuf.buf);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &pass_fd, sizeof(int));
+  }
+  ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  if (w < 0)
+    return -errno;
+  size_t sent = (size_t)w;
+  if (sent < sizeof(hdr))
+  {
+    iov[0].iov_base = (char *)&hdr + sent;
+    iov[0].iov_len = sizeof(hdr) - sent;
+    return kafs_rpc_writev_full(fd, iov, 2);
+  }
+  sent -= sizeof(hdr);
+  iov[1].iov_base = (char *)payload + sent;
+  iov[1].iov_len = payload_len - sent;
+  return kafs_rpc_writev_full(fd, &iov[1], 1);
+}
+
 int kafs_rpc_recv_msg(int fd, kafs_rpc_hdr_t *hdr, void *payload, uint32_t payload_cap,
                       uint32_t *payload_len)
 {
-  int rc = kafs_rpc_read_full(fd, hdr, sizeof(*hdr));
-  if (rc != 0)
-    return rc;
-  if (hdr->magic != KAFS_RPC_MAGIC)
-    return -EBADMSG;
-  if (hdr->version != KAFS_RPC_VERSION)
-    return -EPROTONOSUPPORT;
-  if ((hdr->flags & KAFS_RPC_FLAG_ENDIAN_HOST) == 0)
-    return -EPROTONOSUPPORT;
-  return kafs_rpc_recv_payload(fd, hdr->payload_len, payload, payload_cap, payload_len);
+  return kafs_rpc_recv_msg_fd(fd, hdr, payload, payload_cap, payload_len, NULL);
+}
+
+// ヘッダを recvmsg で読み、添えられた fd を *out_fd に返す（無ければ -1）。
+// out_fd が NULL のときや検証に失敗したときは受け取った fd を閉じる。
+int kafs_rpc_recv_msg_fd(int fd, kafs_rpc_hdr_t *hdr, void *payload, uint32_t payload_cap,
+                         uint32_t *payload_len, int *out_fd)
+{
+  if (out_fd)
+    *out_fd = -1;
+  struct iovec iov;
+  iov.iov_base = hdr;
+  iov.iov_len = sizeof(*hdr);
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } cbuf;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf.buf;
+  msg.msg_controllen = sizeof(cbuf.buf);
+  ssize_t r = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  if (r < 0)
+    return -errno;
+  if (r == 0)
+    return -EIO;
+
+  int got_fd = -1;
+  for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+        cm->cmsg_len >= CMSG_LEN(sizeof(int)) && got_fd < 0)
+      memcpy(&got_fd, CMSG_DATA(cm), sizeof(int));
+  }
+
+  int rc = 0;
+  if ((size_t)r < sizeof(*hdr))
+    rc = kafs_rpc_read_full(fd, (char *)hdr + r, sizeof(*hdr) - (size_t)r);
+  if (rc == 0)
+    rc = kafs_rpc_check_hdr(hdr);
+  if (rc == 0)
+    rc = kafs_rpc_recv_payload(fd, hdr->payload_len, payload, payload_cap, payload_len);
+  if (got_fd >= 0)
+  {
+    if (rc == 0 && out_fd)
+      *out_fd = got_fd;
+    else
+      close(got_fd);
+  }
+  return rc;
 }
 
 int kafs_rpc_send_resp(int fd, uint64_t req_id, int32_t result, const void *payload,
                        uint32_t payload_len)
 {
-  if (payload_len > KAFS_RPC_MAX_PAYLOAD)
+  if (payload_len > KAFS_RPC_MAX_PAYLOAD_LARGE)
     return -EMSGSIZE;
   if (payload_len != 0 && payload == NULL)
     return -EINVAL;
@@ -137,8 +274,372 @@ int kafs_rpc_send_resp(int fd, uint64_t req_id, int32_t result, const void *payl
 int kafs_rpc_recv_resp(int fd, kafs_rpc_resp_hdr_t *hdr, void *payload, uint32_t payload_cap,
                        uint32_t *payload_len)
 {
-  int rc = kafs_rpc_read_full(fd, hdr, sizeof(*hdr));
+  int rc = kafs_rpc_recv_resp_hdr(fd, hdr);
   if (rc != 0)
     return rc;
+  return kafs_rpc_recv_resp_body(fd, hdr, payload, payload_cap, payload_len);
+}
+
+int kafs_rpc_recv_resp_hdr(int fd, kafs_rpc_resp_hdr_t *hdr)
+{
+  return kafs_rpc_read_full(fd, hdr, sizeof(*hdr));
+}
+
+int kafs_rpc_recv_resp_body(int fd, const kafs_rpc_resp_hdr_t *hdr, void *payload,
+                            uint32_t payload_cap, uint32_t *payload_len)
+{
   return kafs_rpc_recv_payload(fd, hdr->payload_len, payload, payload_cap, payload_len);
 }
+
+// ---- 先読み受信 ----
+
+int kafs_rpc_rx_init(kafs_rpc_rx_t *rx, int fd)
+{
+  memset(rx, 0, sizeof(*rx));
+  rx->rx_fd = fd;
+  rx->rx_pending_fd = -1;
+  rx->rx_buf = (uint8_t *)malloc(KAFS_RPC_RX_BUF);
+  return rx->rx_buf ? 0 : -ENOMEM;
+}
+
+void kafs_rpc_rx_reset(kafs_rpc_rx_t *rx, int fd)
+{
+  if (rx->rx_pending_fd >= 0)
+    close(rx->rx_pending_fd);
+  rx->rx_pending_fd = -1;
+  rx->rx_fd = fd;
+  rx->rx_head = rx->rx_tail = 0;
+  rx->rx_in = rx->rx_out = rx->rx_fd_pos = 0;
+}
+
+void kafs_rpc_rx_destroy(kafs_rpc_rx_t *rx)
+{
+  kafs_rpc_rx_reset(rx, -1);
+  free(rx->rx_buf);
+  rx->rx_buf = NULL;
+}
+
+// 1 回の recvmsg で dst へ最大 len バイト読み、添えられた fd を覚えておく。
+static ssize_t kafs_rpc_rx_fill(kafs_rpc_rx_t *rx, void *dst, size_t len)
+{
+  struct iovec iov;
+  iov.iov_base = dst;
+  iov.iov_len = len;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } cbuf;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf.buf;
+  msg.msg_controllen = sizeof(cbuf.buf);
+  ssize_t r = recvmsg(rx->rx_fd, &msg, MSG_CMSG_CLOEXEC);
+  if (r < 0 && errno == ENOTSOCK)
+  {
+    r = read(rx->rx_fd, dst, len);
+    msg.msg_controllen = 0;
+  }
+  if (r < 0)
+    return -errno;
+  if (r == 0)
+    return -EIO;
+  rx->rx_syscalls++;
+  rx->rx_in += (uint64_t)r;
+  for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS ||
+        cm->cmsg_len < CMSG_LEN(sizeof(int)))
+      continue;
+    int got_fd;
+    memcpy(&got_fd, CMSG_DATA(cm), sizeof(int));
+    if (rx->rx_pending_fd >= 0)
+      close(rx->rx_pending_fd); // 前の fd は誰にも渡らなかった
+    rx->rx_pending_fd = got_fd;
+    rx->rx_fd_pos = rx->rx_in;
+  }
+  return r;
+}
+
+// len バイトを dst へ切り出す（dst == NULL なら読み捨てる）。
+static int kafs_rpc_rx_read(kafs_rpc_rx_t *rx, void *dst, size_t len)
+{
+  char *p = (char *)dst;
+  while (len > 0)
+  {
+    uint32_t avail = rx->rx_tail - rx->rx_head;
+    if (avail > 0)
+    {
+      size_t n = avail < len ? avail : len;
+      if (p)
+      {
+        memcpy(p, rx->rx_buf + rx->rx_head, n);
+        p += n;
+      }
+      rx->rx_head += (uint32_t)n;
+      rx->rx_out += n;
+      len -= n;
+      continue;
+    }
+    rx->rx_head = rx->rx_tail = 0;
+    if (p && len >= KAFS_RPC_RX_BUF / 2u)
+    {
+      // 大きな本文はバッファを経由させない
+      ssize_t r = kafs_rpc_rx_fill(rx, p, len);
+      if (r < 0)
+        return (int)r;
+      p += r;
+      rx->rx_out += (uint64_t)r;
+      len -= (size_t)r;
+      continue;
+    }
+    ssize_t r = kafs_rpc_rx_fill(rx, rx->rx_buf, KAFS_RPC_RX_BUF);
+    if (r < 0)
+      return (int)r;
+    rx->rx_tail = (uint32_t)r;
+  }
+  return 0;
+}
+
+// ストリーム上の [start, end) を占めるメッセージに届いた fd を渡す（無ければ -1）。
+static int kafs_rpc_rx_take_fd(kafs_rpc_rx_t *rx, uint64_t start, uint64_t end)
+{
+  if (rx->rx_pending_fd < 0)
+    return -1;
+  uint64_t at = rx->rx_fd_pos - 1u;
+  if (at >= end)
+    return -1; // 後ろのメッセージの分
+  int fd = rx->rx_pending_fd;
+  rx->rx_pending_fd = -1;
+  if (at < start)
+  {
+    close(fd); // 前のメッセージに添えられていたが受け取り手がいなかった
+    return -1;
+  }
+  return fd;
+}
+
+int kafs_rpc_rx_recv_msg_fd(kafs_rpc_rx_t *rx, kafs_rpc_hdr_t *hdr, void *payload,
+                            uint32_t payload_cap, uint32_t *payload_len, int *out_fd)
+{
+  if (out_fd)
+    *out_fd = -1;
+  uint64_t start = rx->rx_out;
+  int rc = kafs_rpc_rx_read(rx, hdr, sizeof(*hdr));
+  if (rc != 0)
+    return rc;
+  rc = kafs_rpc_check_hdr(hdr);
+  if (rc == 0 && hdr->payload_len > KAFS_RPC_MAX_PAYLOAD_LARGE)
+    rc = -EMSGSIZE;
+  if (rc == 0)
+  {
+    if (payload_len)
+      *payload_len = hdr->payload_len;
+    if (hdr->payload_len > payload_cap)
+    {
+      rc = kafs_rpc_rx_read(rx, NULL, hdr->payload_len);
+      if (rc == 0)
+        rc = -EMSGSIZE;
+    }
+    else
+      rc = kafs_rpc_rx_read(rx, payload, hdr->payload_len);
+  }
+  rx->rx_msgs++;
+  int got_fd = kafs_rpc_rx_take_fd(rx, start, rx->rx_out);
+  if (got_fd >= 0)
+  {
+    if (rc == 0 && out_fd)
+      *out_fd = got_fd;
+    else
+      close(got_fd);
+  }
+  return rc;
+}
+
+int kafs_rpc_rx_recv_resp_hdr(kafs_rpc_rx_t *rx, kafs_rpc_resp_hdr_t *hdr)
+{
+  int rc = kafs_rpc_rx_read(rx, hdr, sizeof(*hdr));
+  if (rc == 0)
+    rx->rx_msgs++;
+  return rc;
+}
+
+int kafs_rpc_rx_recv_resp_body(kafs_rpc_rx_t *rx, const kafs_rpc_resp_hdr_t *hdr,
+                               const struct iovec *iov, int iovcnt, uint32_t *payload_len)
+{
+  uint32_t in_len = hdr->payload_len;
+  if (in_len > KAFS_RPC_MAX_PAYLOAD_LARGE)
+    return -EMSGSIZE;
+  if (payload_len)
+    *payload_len = in_len;
+  size_t cap = 0;
+  for (int i = 0; i < iovcnt; ++i)
+    cap += iov[i].iov_len;
+  if (in_len > cap)
+  {
+    int rc = kafs_rpc_rx_read(rx, NULL, in_len);
+    return rc != 0 ? rc : -EMSGSIZE;
+  }
+  size_t left = in_len;
+  for (int i = 0; i < iovcnt && left > 0; ++i)
+  {
+    size_t n = iov[i].iov_len < left ? iov[i].iov_len : left;
+    int rc = kafs_rpc_rx_read(rx, iov[i].iov_base, n);
+    if (rc != 0)
+      return rc;
+    left -= n;
+  }
+  return 0;
+}
+
+// ---- まとめ送り ----
+
+typedef struct kafs_rpc_txmsg
+{
+  struct kafs_rpc_txmsg *tm_next;
+  int tm_fd;
+  int tm_done;
+  int tm_rc;
+  int tm_iovcnt;
+  struct iovec tm_iov[1 + KAFS_RPC_IOV_MAX];
+  union
+  {
+    kafs_rpc_hdr_t req;
+    kafs_rpc_resp_hdr_t resp;
+  } tm_hdr;
+} kafs_rpc_txmsg_t;
+
+void kafs_rpc_tx_init(kafs_rpc_tx_t *tx)
+{
+  memset(tx, 0, sizeof(*tx));
+  pthread_mutex_init(&tx->tx_lock, NULL);
+  pthread_cond_init(&tx->tx_cond, NULL);
+}
+
+void kafs_rpc_tx_destroy(kafs_rpc_tx_t *tx)
+{
+  pthread_cond_destroy(&tx->tx_cond);
+  pthread_mutex_destroy(&tx->tx_lock);
+}
+
+static int kafs_rpc_tx_submit(kafs_rpc_tx_t *tx, kafs_rpc_txmsg_t *m)
+{
+  m->tm_next = NULL;
+  m->tm_done = 0;
+  m->tm_rc = 0;
+  pthread_mutex_lock(&tx->tx_lock);
+  if (tx->tx_tail)
+    tx->tx_tail->tm_next = m;
+  else
+    tx->tx_head = m;
+  tx->tx_tail = m;
+  tx->tx_queued++;
+  while (!m->tm_done)
+  {
+    if (tx->tx_busy)
+    {
+      pthread_cond_wait(&tx->tx_cond, &tx->tx_lock);
+      continue;
+    }
+    // 書き手になり、先頭と同じ fd 宛てに積まれている分をまとめて送る
+    tx->tx_busy = 1;
+    kafs_rpc_txmsg_t *first = tx->tx_head;
+    kafs_rpc_txmsg_t *last = first;
+    int fd = first->tm_fd;
+    struct iovec iov[KAFS_RPC_TX_BATCH * (1u + KAFS_RPC_IOV_MAX)];
+    int iovcnt = 0;
+    uint32_t n = 0;
+    for (kafs_rpc_txmsg_t *t = first; t && t->tm_fd == fd && n < KAFS_RPC_TX_BATCH;
+         t = t->tm_next)
+    {
+      memcpy(&iov[iovcnt], t->tm_iov, (size_t)t->tm_iovcnt * sizeof(struct iovec));
+      iovcnt += t->tm_iovcnt;
+      n++;
+      last = t;
+    }
+    tx->tx_head = last->tm_next;
+    if (!tx->tx_head)
+      tx->tx_tail = NULL;
+    tx->tx_queued -= n;
+    tx->tx_msgs += n;
+    tx->tx_batches++;
+    if (n > tx->tx_batch_max)
+      tx->tx_batch_max = n;
+    pthread_mutex_unlock(&tx->tx_lock);
+
+    int rc = kafs_rpc_writev_full(fd, iov, iovcnt);
+
+    pthread_mutex_lock(&tx->tx_lock);
+    for (kafs_rpc_txmsg_t *t = first;; t = t->tm_next)
+    {
+      t->tm_rc = rc;
+      t->tm_done = 1;
+      if (t == last)
+        break;
+    }
+    tx->tx_busy = 0;
+    pthread_cond_broadcast(&tx->tx_cond);
+  }
+  pthread_mutex_unlock(&tx->tx_lock);
+  return m->tm_rc;
+}
+
+static int kafs_rpc_tx_set_body(kafs_rpc_txmsg_t *m, const struct iovec *iov, int iovcnt,
+                                uint32_t *payload_len)
+{
+  if (iovcnt < 0 || iovcnt > KAFS_RPC_IOV_MAX)
+    return -EINVAL;
+  size_t total = 0;
+  m->tm_iovcnt = 1;
+  for (int i = 0; i < iovcnt; ++i)
+  {
+    if (iov[i].iov_len == 0)
+      continue;
+    if (iov[i].iov_base == NULL)
+      return -EINVAL;
+    total += iov[i].iov_len;
+    m->tm_iov[m->tm_iovcnt++] = iov[i];
+  }
+  if (total > KAFS_RPC_MAX_PAYLOAD_LARGE)
+    return -EMSGSIZE;
+  *payload_len = (uint32_t)total;
+  return 0;
+}
+
+int kafs_rpc_tx_send_msg(kafs_rpc_tx_t *tx, int fd, uint16_t op, uint32_t flags, uint64_t req_id,
+                         uint64_t session_id, uint32_t epoch, const struct iovec *iov, int iovcnt)
+{
+  kafs_rpc_txmsg_t m;
+  uint32_t payload_len;
+  int rc = kafs_rpc_tx_set_body(&m, iov, iovcnt, &payload_len);
+  if (rc != 0)
+    return rc;
+  kafs_rpc_fill_hdr(&m.tm_hdr.req, op, flags, req_id, session_id, epoch, payload_len);
+  m.tm_fd = fd;
+  m.tm_iov[0].iov_base = &m.tm_hdr.req;
+  m.tm_iov[0].iov_len = sizeof(m.tm_hdr.req);
+  return kafs_rpc_tx_submit(tx, &m);
+}
+
+int kafs_rpc_tx_send_resp(kafs_rpc_tx_t *tx, int fd, uint64_t req_id, int32_t result,
+                          const void *payload, uint32_t payload_len)
+{
+  if (payload_len != 0 && payload == NULL)
+    return -EINVAL;
+  kafs_rpc_txmsg_t m;
+  struct iovec iov;
+  iov.iov_base = (void *)payload;
+  iov.iov_len = payload_len;
+  int rc = kafs_rpc_tx_set_body(&m, &iov, 1, &payload_len);
+  if (rc != 0)
+    return rc;
+  m.tm_hdr.resp.req_id = req_id;
+  m.tm_hdr.resp.result = result;
+  m.tm_hdr.resp.payload_len = payload_len;
+  m.tm_fd = fd;
+  m.tm_iov[0].iov_base = &m.tm_hdr.resp;
+  m.tm_iov[0].iov_len = sizeof(m.tm_hdr.resp);
+  return kafs_rpc_tx_submit(tx, &m);
+}
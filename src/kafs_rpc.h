@@ -1,17 +1,31 @@
 #pragma once
 
 #include "kafs_config.h"
+#include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include "kafs_hotplug.h"
 
 #define KAFS_RPC_MAGIC 0x4b415250u
 #define KAFS_RPC_VERSION 1u
 #define KAFS_RPC_MAX_PAYLOAD 16384u
+// KAFS_RPC_HELLO_FEATURE_LARGE_PAYLOAD を広告した後段とはここまで大きな本文をやり取りする
+// （INLINE の READ / WRITE を FUSE の 1 要求のまま運べる）。受信側は相手を問わずここまで受ける。
+#define KAFS_RPC_MAX_PAYLOAD_LARGE (256u * 1024u)
 
 #define KAFS_RPC_HELLO_MAJOR 1u
 #define KAFS_RPC_HELLO_MINOR 0u
-#define KAFS_RPC_HELLO_FEATURES 0u
+#define KAFS_RPC_HELLO_FEATURE_SHM 0x1u // SHM_ATTACH で memfd のスロットリングを受け取れる
+#define KAFS_RPC_HELLO_FEATURE_BACK_STATUS 0x2u // CTL_STATUS に kafs_rpc_back_status_t を返す
+#define KAFS_RPC_HELLO_FEATURE_NS 0x4u // 名前空間・メタデータ操作（LOOKUP .. FSYNC）を実行できる
+#define KAFS_RPC_HELLO_FEATURE_LARGE_PAYLOAD 0x8u // 本文を KAFS_RPC_MAX_PAYLOAD_LARGE まで受ける
+#define KAFS_RPC_HELLO_FEATURE_WARM_STATE 0x10u // STATE_SAVE で実行時状態を後継に引き継げる
+#define KAFS_RPC_HELLO_FEATURES                                                                    \
+  (KAFS_RPC_HELLO_FEATURE_SHM | KAFS_RPC_HELLO_FEATURE_BACK_STATUS | KAFS_RPC_HELLO_FEATURE_NS |   \
+   KAFS_RPC_HELLO_FEATURE_LARGE_PAYLOAD | KAFS_RPC_HELLO_FEATURE_WARM_STATE)
 
 #define KAFS_RPC_FLAG_ENDIAN_HOST 0x1u
 
@@ -50,6 +64,24 @@ enum
   KAFS_RPC_OP_WRITE = 5,
   KAFS_RPC_OP_TRUNCATE = 6,
   KAFS_RPC_OP_SESSION_RESTORE = 7,
+  KAFS_RPC_OP_SHM_ATTACH = 8,
+  // 名前空間・メタデータ（KAFS_RPC_HELLO_FEATURE_NS）。GETATTR_MULTI 以外は kafs_rpc_ns_req_t
+  KAFS_RPC_OP_LOOKUP = 9,
+  KAFS_RPC_OP_GETATTR_MULTI = 10,
+  KAFS_RPC_OP_READDIR = 11,
+  KAFS_RPC_OP_CREATE = 12,
+  KAFS_RPC_OP_MKDIR = 13,
+  KAFS_RPC_OP_UNLINK = 14,
+  KAFS_RPC_OP_RMDIR = 15,
+  KAFS_RPC_OP_RENAME = 16,
+  KAFS_RPC_OP_LINK = 17,
+  KAFS_RPC_OP_SYMLINK = 18,
+  KAFS_RPC_OP_READLINK = 19,
+  KAFS_RPC_OP_SETATTR = 20,
+  KAFS_RPC_OP_OPEN = 21,
+  KAFS_RPC_OP_RELEASE = 22,
+  KAFS_RPC_OP_FSYNC = 23,
+  KAFS_RPC_OP_STATE_SAVE = 24,
   KAFS_RPC_OP_CTL_STATUS = 50,
   KAFS_RPC_OP_CTL_COMPAT = 51,
   KAFS_RPC_OP_CTL_RESTART = 52,
@@ -73,6 +105,20 @@ typedef struct
   uint32_t open_handle_count;
 } kafs_rpc_session_restore_t;
 
+// SHM_ATTACH: memfd を SCM_RIGHTS で添えて送る。後段は slot_count * slot_size をマップする。
+typedef struct
+{
+  uint32_t slot_count;
+  uint32_t slot_size;
+} kafs_rpc_shm_attach_t;
+
+// data_mode=SHM の READ / WRITE は要求構造体の直後にこれを付け、データはスロットで受け渡す。
+typedef struct
+{
+  uint32_t slot;
+  uint32_t len;
+} kafs_rpc_shm_ref_t;
+
 typedef struct
 {
   uint32_t ino;
@@ -130,8 +176,259 @@ typedef struct
   uint64_t size;
 } kafs_rpc_truncate_resp_t;
 
+// 名前空間要求: この構造体の後ろに extra（extra_len）、path（path_len）、path2（path2_len）を
+// NUL 無しで詰める。path2 は RENAME / LINK の宛先と SYMLINK の target。
+// path が空で KAFS_RPC_NS_F_FH が立っていれば ino（開いたハンドル）で対象を指す。
+typedef struct
+{
+  uint32_t ino;
+  uint32_t uid;
+  uint32_t gid;
+  uint32_t pid;
+  uint32_t mode;     // CREATE / MKDIR / SETATTR(chmod)
+  uint32_t flags;    // KAFS_RPC_NS_F_*
+  uint32_t op_flags; // OPEN / CREATE の open(2) flags、RENAME の flags、FSYNC の datasync
+  uint16_t path_len;
+  uint16_t path2_len;
+  uint64_t arg; // CREATE(mknod) の dev、READDIR の再開位置、READLINK で受け取れる長さ
+  uint32_t extra_len;
+  uint32_t reserved;
+} kafs_rpc_ns_req_t;
+
+#define KAFS_RPC_NS_F_FH 0x1u   // ino のハンドルも渡す（fi->fh）
+#define KAFS_RPC_NS_F_OPEN 0x2u // CREATE: create(2) としてハンドルを開く
+#define KAFS_RPC_NS_PATH_MAX 4095u
+
+// SETATTR の extra。valid で chmod（mode は kafs_rpc_ns_req_t.mode）/ chown / utimens を 1 つ選ぶ。
+typedef struct
+{
+  uint32_t valid;
+  uint32_t uid; // chown の引数をそのまま運ぶ
+  uint32_t gid;
+  uint32_t atime_nsec; // UTIME_NOW / UTIME_OMIT もそのまま運ぶ
+  int64_t atime_sec;
+  int64_t mtime_sec;
+  uint32_t mtime_nsec;
+  uint32_t reserved;
+} kafs_rpc_setattr_t;
+
+#define KAFS_RPC_SETATTR_MODE 0x1u
+#define KAFS_RPC_SETATTR_OWNER 0x2u
+#define KAFS_RPC_SETATTR_TIMES 0x4u
+
+// struct stat（144 バイト）の代わりに運ぶ属性。
+// LOOKUP / CREATE（KAFS_RPC_NS_F_OPEN）/ OPEN の応答。
+typedef struct
+{
+  uint32_t ino;
+  uint32_t mode;
+  uint32_t nlink;
+  uint32_t uid;
+  uint32_t gid;
+  uint32_t rdev;
+  uint64_t size;
+  uint64_t blocks;
+  int64_t atime_sec;
+  int64_t mtime_sec;
+  int64_t ctime_sec;
+  uint32_t atime_nsec;
+  uint32_t mtime_nsec;
+  uint32_t ctime_nsec;
+  uint32_t blksize;
+} kafs_rpc_attr_t;
+
+// GETATTR_MULTI: 要求は count と ino[count]、応答は kafs_rpc_attr_result_t[count]。
+#define KAFS_RPC_GETATTR_MULTI_MAX 128u
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t reserved;
+} kafs_rpc_getattr_multi_req_t;
+
+typedef struct
+{
+  int32_t result;
+  uint32_t reserved;
+  kafs_rpc_attr_t attr;
+} kafs_rpc_attr_result_t;
+
+// READDIR: arg（エントリの通し番号）から応答に収まるだけ返す。応答は kafs_rpc_readdir_resp_t に
+// kafs_rpc_dirent_t + 名前（NUL 無し、詰めて並べる）が count 個続く。
+typedef struct
+{
+  uint32_t count;
+  uint32_t eof;
+  uint64_t next; // 続きを読むときの arg
+} kafs_rpc_readdir_resp_t;
+
+typedef struct
+{
+  uint32_t ino;
+  uint32_t mode;
+  uint16_t name_len;
+  uint16_t reserved;
+} kafs_rpc_dirent_t;
+
+static inline void kafs_rpc_attr_from_stat(kafs_rpc_attr_t *a, const struct stat *st)
+{
+  a->ino = (uint32_t)st->st_ino;
+  a->mode = (uint32_t)st->st_mode;
+  a->nlink = (uint32_t)st->st_nlink;
+  a->uid = (uint32_t)st->st_uid;
+  a->gid = (uint32_t)st->st_gid;
+  a->rdev = (uint32_t)st->st_rdev;
+  a->size = (uint64_t)st->st_size;
+  a->blocks = (uint64_t)st->st_blocks;
+  a->atime_sec = (int64_t)st->st_atim.tv_sec;
+  a->mtime_sec = (int64_t)st->st_mtim.tv_sec;
+  a->ctime_sec = (int64_t)st->st_ctim.tv_sec;
+  a->atime_nsec = (uint32_t)st->st_atim.tv_nsec;
+  a->mtime_nsec = (uint32_t)st->st_mtim.tv_nsec;
+  a->ctime_nsec = (uint32_t)st->st_ctim.tv_nsec;
+  a->blksize = (uint32_t)st->st_blksize;
+}
+
+static inline void kafs_rpc_attr_to_stat(struct stat *st, const kafs_rpc_attr_t *a)
+{
+  memset(st, 0, sizeof(*st));
+  st->st_ino = a->ino;
+  st->st_mode = (mode_t)a->mode;
+  st->st_nlink = (nlink_t)a->nlink;
+  st->st_uid = (uid_t)a->uid;
+  st->st_gid = (gid_t)a->gid;
+  st->st_rdev = (dev_t)a->rdev;
+  st->st_size = (off_t)a->size;
+  st->st_blocks = (blkcnt_t)a->blocks;
+  st->st_atim.tv_sec = (time_t)a->atime_sec;
+  st->st_mtim.tv_sec = (time_t)a->mtime_sec;
+  st->st_ctim.tv_sec = (time_t)a->ctime_sec;
+  st->st_atim.tv_nsec = (long)a->atime_nsec;
+  st->st_mtim.tv_nsec = (long)a->mtime_nsec;
+  st->st_ctim.tv_nsec = (long)a->ctime_nsec;
+  st->st_blksize = (blksize_t)a->blksize;
+}
+
+/// @brief 名前空間要求を buf に詰める（path / path2 は NULL なら空）
+/// @return 詰めた長さ, -ENAMETOOLONG: パスが長すぎる, -EMSGSIZE: cap に収まらない
+static inline int kafs_rpc_ns_encode(void *buf, uint32_t cap, kafs_rpc_ns_req_t *req,
+                                     const void *extra, uint32_t extra_len, const char *path,
+                                     const char *path2)
+{
+  size_t l1 = path ? strlen(path) : 0;
+  size_t l2 = path2 ? strlen(path2) : 0;
+  if (l1 > KAFS_RPC_NS_PATH_MAX || l2 > KAFS_RPC_NS_PATH_MAX)
+    return -ENAMETOOLONG;
+  size_t total = sizeof(*req) + extra_len + l1 + l2;
+  if (total > cap)
+    return -EMSGSIZE;
+  req->path_len = (uint16_t)l1;
+  req->path2_len = (uint16_t)l2;
+  req->extra_len = extra_len;
+  req->reserved = 0;
+  uint8_t *p = (uint8_t *)buf;
+  memcpy(p, req, sizeof(*req));
+  p += sizeof(*req);
+  if (extra_len)
+    memcpy(p, extra, extra_len);
+  p += extra_len;
+  if (l1)
+    memcpy(p, path, l1);
+  p += l1;
+  if (l2)
+    memcpy(p, path2, l2);
+  return (int)total;
+}
+
+/// @brief 名前空間要求を読む。extra / path / path2 は payload の中を指す（NUL 終端ではない）
+/// @return 0: 成功, -EBADMSG: 長さが合わない
+static inline int kafs_rpc_ns_decode(const void *payload, uint32_t len, kafs_rpc_ns_req_t *req,
+                                     const uint8_t **extra, const char **path, const char **path2)
+{
+  if (len < sizeof(*req))
+    return -EBADMSG;
+  memcpy(req, payload, sizeof(*req));
+  if (req->path_len > KAFS_RPC_NS_PATH_MAX || req->path2_len > KAFS_RPC_NS_PATH_MAX ||
+      (uint64_t)sizeof(*req) + req->extra_len + req->path_len + req->path2_len != len)
+    return -EBADMSG;
+  const uint8_t *p = (const uint8_t *)payload + sizeof(*req);
+  *extra = p;
+  *path = (const char *)(p + req->extra_len);
+  *path2 = *path + req->path_len;
+  return 0;
+}
+
 typedef kafs_hotplug_status_t kafs_rpc_hotplug_status_t;
 
+// STATE_SAVE（前段 -> 後段、本文なし）の応答。後段は実行中の要求を終えてイメージを閉じ、
+// 閉じる直前の実行時状態を返してから接続を切る。前段はこれを memfd に写し、次の後段へ
+// 環境変数 KAFS_BACK_WARM_FD で渡す。後段はイメージの同一性・ジャーナル seq・空き数が
+// 一致したときだけ採用し、合わなければ従来どおり走査して組み直す（カーソルはヒントに過ぎない）。
+// 直後に open_count 個の kafs_rpc_warm_open_t が続く。
+#define KAFS_RPC_WARM_MAGIC 0x4b57524du // "KWRM"
+#define KAFS_RPC_WARM_VERSION 1u
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t img_dev;
+  uint64_t img_ino;
+  uint64_t img_size;
+  uint64_t journal_seq; // ジャーナル無効なら 0
+  uint64_t blkcnt_free;
+  uint64_t inocnt_free;
+  uint64_t ino_search;
+  uint64_t blo_search;
+  uint32_t hrl_free_head_plus1; // HRL 空きリストの先頭（リスト自体はイメージ内にある）
+  uint32_t hrl_free_slot_count;
+  uint32_t alloc_summary_clean; // イメージ内の割り当て要約が最新
+  uint32_t open_count;
+} kafs_rpc_warm_state_t;
+
+// 後段で開いたままのハンドル数（inode ごと）。unlink 済みで開いているファイルを守る。
+typedef struct
+{
+  uint32_t ino;
+  uint32_t count;
+} kafs_rpc_warm_open_t;
+
+#define KAFS_RPC_WARM_OPEN_MAX                                                                     \
+  ((KAFS_RPC_MAX_PAYLOAD_LARGE - (uint32_t)sizeof(kafs_rpc_warm_state_t)) /                        \
+   (uint32_t)sizeof(kafs_rpc_warm_open_t))
+
+/// @brief STATE_SAVE の本文を検める（同一性の照合は受け取った側が行う）
+/// @return 0: 成功, -EBADMSG: 形式・長さが合わない
+static inline int kafs_rpc_warm_decode(const void *payload, uint32_t len,
+                                       kafs_rpc_warm_state_t *ws,
+                                       const kafs_rpc_warm_open_t **opens)
+{
+  if (len < sizeof(*ws))
+    return -EBADMSG;
+  memcpy(ws, payload, sizeof(*ws));
+  if (ws->magic != KAFS_RPC_WARM_MAGIC || ws->version != KAFS_RPC_WARM_VERSION ||
+      ws->open_count > KAFS_RPC_WARM_OPEN_MAX ||
+      (uint64_t)sizeof(*ws) + (uint64_t)ws->open_count * sizeof(kafs_rpc_warm_open_t) != len)
+    return -EBADMSG;
+  *opens = (const kafs_rpc_warm_open_t *)((const uint8_t *)payload + sizeof(*ws));
+  return 0;
+}
+
+// データソケット上の CTL_STATUS（前段 -> 後段）: 後段の実行スレッドの様子。
+// queue_depth は受信済みで未着手の要求数、service_ns は実行の所要時間、
+// queue_wait_ns は受信から着手までの待ち（いずれも累計）。
+typedef struct
+{
+  uint32_t workers; // 0 は受信スレッドで直列に実行
+  uint32_t queue_depth;
+  uint32_t queue_depth_max;
+  uint32_t reserved;
+  uint64_t requests;
+  uint64_t service_ns;
+  uint64_t service_ns_max;
+  uint64_t queue_wait_ns;
+} kafs_rpc_back_status_t;
+
 typedef struct
 {
   uint32_t timeout_ms;
@@ -176,7 +473,81 @@ int kafs_rpc_send_msg(int fd, uint16_t op, uint32_t flags, uint64_t req_id, uint
                       uint32_t epoch, const void *payload, uint32_t payload_len);
 int kafs_rpc_recv_msg(int fd, kafs_rpc_hdr_t *hdr, void *payload, uint32_t payload_cap,
                       uint32_t *payload_len);
+int kafs_rpc_send_msg_fd(int fd, uint16_t op, uint32_t flags, uint64_t req_id, uint64_t session_id,
+                         uint32_t epoch, const void *payload, uint32_t payload_len, int pass_fd);
+int kafs_rpc_recv_msg_fd(int fd, kafs_rpc_hdr_t *hdr, void *payload, uint32_t payload_cap,
+                         uint32_t *payload_len, int *out_fd);
 int kafs_rpc_send_resp(int fd, uint64_t req_id, int32_t result, const void *payload,
                        uint32_t payload_len);
 int kafs_rpc_recv_resp(int fd, kafs_rpc_resp_hdr_t *hdr, void *payload, uint32_t payload_cap,
                        uint32_t *payload_len);
+// Split receive for demultiplexing: read the header, pick the destination by req_id, then the body.
+// The body is discarded (stream stays in sync) and -EMSGSIZE returned when it exceeds payload_cap.
+int kafs_rpc_recv_resp_hdr(int fd, kafs_rpc_resp_hdr_t *hdr);
+int kafs_rpc_recv_resp_body(int fd, const kafs_rpc_resp_hdr_t *hdr, void *payload,
+                            uint32_t payload_cap, uint32_t *payload_len);
+
+/// @brief iovec をすべて書く（ソケットなら sendmsg、それ以外は writev）。iov は書き換える
+int kafs_rpc_writev_full(int fd, struct iovec *iov, int iovcnt);
+
+// 受信の先読みバッファ。1 回の recvmsg でソケットに溜まっている分をまとめて取り込み、ヘッダと
+// 本文（続けて届いた後続のメッセージも）をそこから切り出す。大きな本文は呼び出し元へ直接読む。
+// SCM_RIGHTS の fd は、それが届いた読み込みの末尾バイトを含むメッセージに渡す
+// （カーネルは fd を添えた送信の分を読んだところで読み込みを打ち切る）。
+// 同時に使えるのは 1 スレッドだけ。
+#define KAFS_RPC_RX_BUF (64u * 1024u)
+
+typedef struct kafs_rpc_rx
+{
+  int rx_fd;
+  uint8_t *rx_buf;
+  uint32_t rx_head;
+  uint32_t rx_tail;
+  uint64_t rx_in;     // ストリームから読んだバイト数
+  uint64_t rx_out;    // 切り出し済みのバイト数（次のメッセージの開始位置）
+  int rx_pending_fd;  // 受け取ってまだ渡していない fd
+  uint64_t rx_fd_pos; // その fd が届いた読み込みの直後の rx_in
+  uint64_t rx_msgs;
+  uint64_t rx_syscalls;
+} kafs_rpc_rx_t;
+
+int kafs_rpc_rx_init(kafs_rpc_rx_t *rx, int fd);
+/// @brief 先読み分と未配布の fd を捨てて fd に付け替える（再接続時）
+void kafs_rpc_rx_reset(kafs_rpc_rx_t *rx, int fd);
+void kafs_rpc_rx_destroy(kafs_rpc_rx_t *rx);
+int kafs_rpc_rx_recv_msg_fd(kafs_rpc_rx_t *rx, kafs_rpc_hdr_t *hdr, void *payload,
+                            uint32_t payload_cap, uint32_t *payload_len, int *out_fd);
+int kafs_rpc_rx_recv_resp_hdr(kafs_rpc_rx_t *rx, kafs_rpc_resp_hdr_t *hdr);
+/// @brief 応答本文を iov へ順に散らして読む（合計より長ければ読み捨てて -EMSGSIZE）
+int kafs_rpc_rx_recv_resp_body(kafs_rpc_rx_t *rx, const kafs_rpc_resp_hdr_t *hdr,
+                               const struct iovec *iov, int iovcnt, uint32_t *payload_len);
+
+// まとめ送り。送る側は自分のメッセージを列に積み、誰も書いていなければ自分が書き手になって
+// 列に溜まっている分（同じ fd 宛て、KAFS_RPC_TX_BATCH 件まで）を 1 回の sendmsg で送る。
+// 書いている間に積まれた分は次の書き手がまとめて送る。呼び出しは自分の分が書き終わるまで戻らない
+// ので、本文はコピーせず呼び出し元のバッファを iovec で指す。
+#define KAFS_RPC_IOV_MAX 2   // 1 メッセージの本文に並べられる iovec の数
+#define KAFS_RPC_TX_BATCH 32u
+
+struct kafs_rpc_txmsg;
+
+typedef struct kafs_rpc_tx
+{
+  pthread_mutex_t tx_lock;
+  pthread_cond_t tx_cond;
+  struct kafs_rpc_txmsg *tx_head;
+  struct kafs_rpc_txmsg *tx_tail;
+  int tx_busy;        // 書き手がいる
+  uint32_t tx_queued; // 列で書き手を待っている件数
+  // 統計（tx_lock の下で更新する）
+  uint64_t tx_msgs;
+  uint64_t tx_batches; // 書き手になった回数（= sendmsg、短い書き込みの続きは数えない）
+  uint32_t tx_batch_max;
+} kafs_rpc_tx_t;
+
+void kafs_rpc_tx_init(kafs_rpc_tx_t *tx);
+void kafs_rpc_tx_destroy(kafs_rpc_tx_t *tx);
+int kafs_rpc_tx_send_msg(kafs_rpc_tx_t *tx, int fd, uint16_t op, uint32_t flags, uint64_t req_id,
+                         uint64_t session_id, uint32_t epoch, const struct iovec *iov, int iovcnt);
+int kafs_rpc_tx_send_resp(kafs_rpc_tx_t *tx, int fd, uint64_t req_id, int32_t result,
+                          const void *payload, uint32_t payload_len);
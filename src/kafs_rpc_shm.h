@@ -0,0 +1,142 @@
+#pragma once
+#include "kafs_config.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// hotplug RPC の共有メモリ・データプレーン（KAFS_RPC_DATA_SHM）。
+// 前段が memfd にスロットを並べたリングを作り、HELLO で後段が KAFS_RPC_HELLO_FEATURE_SHM を
+// 広告していれば READY の後に SHM_ATTACH で fd を渡す。READ / WRITE はスロット番号と長さだけを
+// ソケットに流し、データはスロット越しに受け渡す。
+//   WRITE: 前段がスロットへ写す -> 後段はスロットから直接 kafs_core_write
+//   READ : 後段がスロットへ直接 kafs_core_read -> 前段が呼び出し元のバッファへ写す
+// ソケット経由（INLINE）のように送受信でカーネルを 2 回くぐらず、1 要求が
+// KAFS_RPC_MAX_PAYLOAD に縛られないので FUSE の max_write をそのまま運べる。
+// スロットは使用中ビットの CAS で取るので、複数の要求が同時に飛んでいても衝突しない。
+// memfd はページを触るまで実メモリを使わない。
+
+#define KAFS_RPC_SHM_SLOTS 16u
+#define KAFS_RPC_SHM_SLOT_SIZE (1024u * 1024u)
+
+typedef struct kafs_rpc_shm
+{
+  int rs_fd;
+  char *rs_base;
+  size_t rs_len;
+  uint32_t rs_slot_count;
+  uint32_t rs_slot_size;
+  uint64_t rs_busy; // 前段だけが使う。ビット i がスロット i の使用中
+} kafs_rpc_shm_t;
+
+static inline void kafs_rpc_shm_reset(kafs_rpc_shm_t *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->rs_fd = -1;
+}
+
+/// @brief スロットの並びを確かめる（数は 1..64、大きさは 4KiB の倍数、合計 1GiB まで）
+static inline int kafs_rpc_shm_geometry_ok(uint32_t slot_count, uint32_t slot_size)
+{
+  return slot_count >= 1u && slot_count <= 64u && slot_size >= 4096u &&
+         (slot_size % 4096u) == 0 && (uint64_t)slot_count * slot_size <= (1ull << 30);
+}
+
+static inline int kafs_rpc_shm_map(kafs_rpc_shm_t *s, int fd, uint32_t slot_count,
+                                   uint32_t slot_size)
+{
+  size_t len = (size_t)slot_count * slot_size;
+  void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    return -errno;
+  s->rs_fd = fd;
+  s->rs_base = (char *)p;
+  s->rs_len = len;
+  s->rs_slot_count = slot_count;
+  s->rs_slot_size = slot_size;
+  s->rs_busy = 0;
+  return 0;
+}
+
+/// @brief 前段: memfd を作ってマップする
+/// @return 0: 成功, < 0: 失敗 (-errno)。memfd の無い環境では -ENOSYS
+static inline int kafs_rpc_shm_create(kafs_rpc_shm_t *s, uint32_t slot_count, uint32_t slot_size)
+{
+  kafs_rpc_shm_reset(s);
+  if (!kafs_rpc_shm_geometry_ok(slot_count, slot_size))
+    return -EINVAL;
+#ifdef MFD_CLOEXEC
+  int fd = memfd_create("kafs-rpc-shm", MFD_CLOEXEC);
+  if (fd < 0)
+    return -errno;
+  if (ftruncate(fd, (off_t)slot_count * slot_size) != 0)
+  {
+    int rc = -errno;
+    close(fd);
+    return rc;
+  }
+  int rc = kafs_rpc_shm_map(s, fd, slot_count, slot_size);
+  if (rc != 0)
+    close(fd);
+  return rc;
+#else
+  return -ENOSYS;
+#endif
+}
+
+/// @brief 後段: 受け取った fd をマップする（fd が slot_count * slot_size に足りなければ -EINVAL）
+static inline int kafs_rpc_shm_attach(kafs_rpc_shm_t *s, int fd, uint32_t slot_count,
+                                      uint32_t slot_size)
+{
+  kafs_rpc_shm_reset(s);
+  if (!kafs_rpc_shm_geometry_ok(slot_count, slot_size))
+    return -EINVAL;
+  off_t end = lseek(fd, 0, SEEK_END);
+  if (end < 0)
+    return -errno;
+  if ((uint64_t)end < (uint64_t)slot_count * slot_size)
+    return -EINVAL;
+  return kafs_rpc_shm_map(s, fd, slot_count, slot_size);
+}
+
+static inline void kafs_rpc_shm_destroy(kafs_rpc_shm_t *s)
+{
+  if (s->rs_base)
+    munmap(s->rs_base, s->rs_len);
+  if (s->rs_fd >= 0)
+    close(s->rs_fd);
+  kafs_rpc_shm_reset(s);
+}
+
+/// @brief 空きスロットを 1 つ取る
+/// @return スロット番号, -EAGAIN: 空きが無い
+static inline int kafs_rpc_shm_slot_get(kafs_rpc_shm_t *s)
+{
+  uint64_t all = s->rs_slot_count >= 64u ? UINT64_MAX : ((1ull << s->rs_slot_count) - 1u);
+  uint64_t cur = __atomic_load_n(&s->rs_busy, __ATOMIC_RELAXED);
+  for (;;)
+  {
+    uint64_t freemask = ~cur & all;
+    if (freemask == 0)
+      return -EAGAIN;
+    uint64_t bit = freemask & (~freemask + 1u);
+    if (__atomic_compare_exchange_n(&s->rs_busy, &cur, cur | bit, 0, __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED))
+      return __builtin_ctzll(bit);
+  }
+}
+
+static inline void kafs_rpc_shm_slot_put(kafs_rpc_shm_t *s, int slot)
+{
+  __atomic_and_fetch(&s->rs_busy, ~(1ull << (unsigned)slot), __ATOMIC_RELEASE);
+}
+
+/// @brief スロット slot の先頭（番号が範囲外か len がスロットに収まらなければ NULL）
+static inline char *kafs_rpc_shm_slot_ptr(const kafs_rpc_shm_t *s, uint32_t slot, uint32_t len)
+{
+  if (!s->rs_base || slot >= s->rs_slot_count || len > s->rs_slot_size)
+    return NULL;
+  return s->rs_base + (size_t)slot * s->rs_slot_size;
+}
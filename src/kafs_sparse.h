@@ -0,0 +1,134 @@
+#pragma once
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// inode 番号で引く実行時カウンタ（open 数、pending worker 用 epoch）の疎な配列。
+// 先頭にチャンクへのポインタ表だけを持ち、値を書くときに初めてチャンク（1 ページ分）を確保する。
+// 触っていない要素は sp_init を返すので、メモリは inode 総数ではなく実際に触った範囲に比例する。
+// チャンクは CAS で差し込み、アンマウントまで解放しない（読み手はロックなしで辿れる）。
+
+#define KAFS_SPARSE_CHUNK_SHIFT 10u
+#define KAFS_SPARSE_CHUNK_ELEMS (1u << KAFS_SPARSE_CHUNK_SHIFT)
+
+typedef struct kafs_sparse_u32
+{
+  uint32_t **sp_chunks;
+  uint32_t sp_nchunks;
+  uint32_t sp_count;
+  uint32_t sp_init;         // 未確保の要素が持つ値
+  uint32_t sp_chunks_alloc; // 確保済みチャンク数（統計用）
+} kafs_sparse_u32_t;
+
+/// @brief count 要素の疎配列を作る（チャンクはまだ確保しない）
+/// @return 配列、失敗時は NULL
+static inline kafs_sparse_u32_t *kafs_sparse_u32_create(uint32_t count, uint32_t init)
+{
+  kafs_sparse_u32_t *sp = (kafs_sparse_u32_t *)calloc(1, sizeof(*sp));
+  if (!sp)
+    return NULL;
+  sp->sp_count = count;
+  sp->sp_init = init;
+  sp->sp_nchunks = (uint32_t)(((uint64_t)count + KAFS_SPARSE_CHUNK_ELEMS - 1u) >>
+                              KAFS_SPARSE_CHUNK_SHIFT);
+  if (sp->sp_nchunks == 0)
+    sp->sp_nchunks = 1;
+  sp->sp_chunks = (uint32_t **)calloc(sp->sp_nchunks, sizeof(uint32_t *));
+  if (!sp->sp_chunks)
+  {
+    free(sp);
+    return NULL;
+  }
+  return sp;
+}
+
+static inline void kafs_sparse_u32_destroy(kafs_sparse_u32_t *sp)
+{
+  if (!sp)
+    return;
+  for (uint32_t i = 0; i < sp->sp_nchunks; ++i)
+    free(sp->sp_chunks[i]);
+  free(sp->sp_chunks);
+  free(sp);
+}
+
+/// @brief 要素を読む（未確保なら sp_init、範囲外なら 0）
+static inline uint32_t kafs_sparse_u32_get(const kafs_sparse_u32_t *sp, uint32_t idx)
+{
+  if (!sp || idx >= sp->sp_count)
+    return 0;
+  uint32_t *chunk =
+      __atomic_load_n(&sp->sp_chunks[idx >> KAFS_SPARSE_CHUNK_SHIFT], __ATOMIC_ACQUIRE);
+  if (!chunk)
+    return sp->sp_init;
+  return __atomic_load_n(&chunk[idx & (KAFS_SPARSE_CHUNK_ELEMS - 1u)], __ATOMIC_RELAXED);
+}
+
+/// @brief 要素への書き込み用ポインタ。チャンクが無ければ sp_init で埋めて差し込む。
+/// @return 要素のアドレス、範囲外・確保失敗なら NULL
+static inline uint32_t *kafs_sparse_u32_slot(kafs_sparse_u32_t *sp, uint32_t idx)
+{
+  if (!sp || idx >= sp->sp_count)
+    return NULL;
+  uint32_t **pp = &sp->sp_chunks[idx >> KAFS_SPARSE_CHUNK_SHIFT];
+  uint32_t *chunk = __atomic_load_n(pp, __ATOMIC_ACQUIRE);
+  if (!chunk)
+  {
+    uint32_t *fresh = (uint32_t *)malloc(KAFS_SPARSE_CHUNK_ELEMS * sizeof(uint32_t));
+    if (!fresh)
+      return NULL;
+    for (uint32_t i = 0; i < KAFS_SPARSE_CHUNK_ELEMS; ++i)
+      fresh[i] = sp->sp_init;
+    uint32_t *expected = NULL;
+    if (__atomic_compare_exchange_n(pp, &expected, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      __atomic_add_fetch(&sp->sp_chunks_alloc, 1u, __ATOMIC_RELAXED);
+      chunk = fresh;
+    }
+    else
+    {
+      free(fresh);
+      chunk = expected;
+    }
+  }
+  return &chunk[idx & (KAFS_SPARSE_CHUNK_ELEMS - 1u)];
+}
+
+/// @brief *idx 以降で sp_init と異なる最初の要素を探す（未確保のチャンクは飛ばす）
+/// @return 見つかれば 1（*idx と *val に入れる）、無ければ 0
+static inline int kafs_sparse_u32_next(const kafs_sparse_u32_t *sp, uint32_t *idx, uint32_t *val)
+{
+  if (!sp)
+    return 0;
+  for (uint32_t i = *idx; i < sp->sp_count;)
+  {
+    uint32_t *chunk =
+        __atomic_load_n(&sp->sp_chunks[i >> KAFS_SPARSE_CHUNK_SHIFT], __ATOMIC_ACQUIRE);
+    if (!chunk)
+    {
+      i = ((i >> KAFS_SPARSE_CHUNK_SHIFT) + 1u) << KAFS_SPARSE_CHUNK_SHIFT;
+      if (i == 0) // 最後のチャンクを越えて一周した
+        return 0;
+      continue;
+    }
+    uint32_t v = __atomic_load_n(&chunk[i & (KAFS_SPARSE_CHUNK_ELEMS - 1u)], __ATOMIC_RELAXED);
+    if (v != sp->sp_init)
+    {
+      *idx = i;
+      *val = v;
+      return 1;
+    }
+    ++i;
+  }
+  return 0;
+}
+
+/// @brief 確保済みチャンクと表が占めるバイト数
+static inline uint64_t kafs_sparse_u32_bytes(const kafs_sparse_u32_t *sp)
+{
+  if (!sp)
+    return 0;
+  return (uint64_t)sp->sp_nchunks * sizeof(uint32_t *) +
+         (uint64_t)__atomic_load_n(&sp->sp_chunks_alloc, __ATOMIC_RELAXED) *
+             KAFS_SPARSE_CHUNK_ELEMS * sizeof(uint32_t);
+}
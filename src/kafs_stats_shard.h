@@ -0,0 +1,137 @@
+#pragma once
+#include "kafs_config.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// FUSE ワーカーが毎回叩く実行時カウンタのシャード化。
+// 1 本の uint64_t に全スレッドが __atomic_add_fetch すると同じキャッシュラインが往復するので、
+// カウンタ一式（シャード）を CPU 数ぶん 64B 境界で並べ、スレッドごとに 1 つを割り当てて加算する。
+// 読み出し（kafsctl fsstat）は全シャードを足し合わせる。シャードを共有するスレッドもいるので
+// 加算は relaxed atomic のまま。シャード未確保の context（テスト・ツール）は c_stat_fallback に数える。
+//
+// X(ID, name, per_record): per_record = 1 はレコード / ループ 1 周ごとに数えるもので、
+// kafs_stat_add_rec で加算する。KAFS_ENABLE_RECORD_STATS == 0 のビルド（configure の既定）では消える。
+
+#define KAFS_STAT_SHARDED_LIST(X)                                                                  \
+  X(HRL_PUT_CALLS, hrl_put_calls, 0)                                                               \
+  X(HRL_PUT_HITS, hrl_put_hits, 0)                                                                 \
+  X(HRL_PUT_MISSES, hrl_put_misses, 0)                                                             \
+  X(HRL_PUT_FALLBACK_LEGACY, hrl_put_fallback_legacy, 0)                                           \
+  X(HRL_PUT_NS_HASH, hrl_put_ns_hash, 0)                                                           \
+  X(HRL_PUT_NS_FIND, hrl_put_ns_find, 0)                                                           \
+  X(HRL_PUT_NS_CMP_CONTENT, hrl_put_ns_cmp_content, 0)                                             \
+  X(HRL_PUT_NS_SLOT_ALLOC, hrl_put_ns_slot_alloc, 0)                                               \
+  X(HRL_PUT_NS_BLK_ALLOC, hrl_put_ns_blk_alloc, 0)                                                 \
+  X(HRL_PUT_NS_BLK_WRITE, hrl_put_ns_blk_write, 0)                                                 \
+  X(HRL_PUT_CHAIN_STEPS, hrl_put_chain_steps, 1)                                                   \
+  X(HRL_PUT_CMP_CALLS, hrl_put_cmp_calls, 1)                                                       \
+  X(HRL_RESCUE_ATTEMPTS, hrl_rescue_attempts, 0)                                                   \
+  X(HRL_RESCUE_HITS, hrl_rescue_hits, 0)                                                           \
+  X(HRL_RESCUE_EVICTS, hrl_rescue_evicts, 0)                                                       \
+  X(LOCK_HRL_BUCKET_ACQUIRE, lock_hrl_bucket_acquire, 0)                                           \
+  X(LOCK_HRL_BUCKET_CONTENDED, lock_hrl_bucket_contended, 0)                                       \
+  X(LOCK_HRL_BUCKET_WAIT_NS, lock_hrl_bucket_wait_ns, 0)                                           \
+  X(LOCK_HRL_GLOBAL_ACQUIRE, lock_hrl_global_acquire, 0)                                           \
+  X(LOCK_HRL_GLOBAL_CONTENDED, lock_hrl_global_contended, 0)                                       \
+  X(LOCK_HRL_GLOBAL_WAIT_NS, lock_hrl_global_wait_ns, 0)                                           \
+  X(LOCK_BITMAP_ACQUIRE, lock_bitmap_acquire, 0)                                                   \
+  X(LOCK_BITMAP_CONTENDED, lock_bitmap_contended, 0)                                               \
+  X(LOCK_BITMAP_WAIT_NS, lock_bitmap_wait_ns, 0)                                                   \
+  X(LOCK_CBLK_ACQUIRE, lock_cblk_acquire, 0)                                                       \
+  X(LOCK_CBLK_CONTENDED, lock_cblk_contended, 0)                                                   \
+  X(LOCK_CBLK_WAIT_NS, lock_cblk_wait_ns, 0)                                                       \
+  X(LOCK_INODE_ACQUIRE, lock_inode_acquire, 0)                                                     \
+  X(LOCK_INODE_CONTENDED, lock_inode_contended, 0)                                                 \
+  X(LOCK_INODE_WAIT_NS, lock_inode_wait_ns, 0)                                                     \
+  X(LOCK_INODE_REENTRANT, lock_inode_reentrant, 0)                                                 \
+  X(LOCK_INODE_ALLOC_ACQUIRE, lock_inode_alloc_acquire, 0)                                         \
+  X(LOCK_INODE_ALLOC_CONTENDED, lock_inode_alloc_contended, 0)                                     \
+  X(LOCK_INODE_ALLOC_WAIT_NS, lock_inode_alloc_wait_ns, 0)                                         \
+  X(ACCESS_CALLS, access_calls, 0)                                                                 \
+  X(ACCESS_PATH_WALK_CALLS, access_path_walk_calls, 0)                                             \
+  X(ACCESS_FH_FASTPATH_HITS, access_fh_fastpath_hits, 0)                                           \
+  X(ACCESS_PATH_COMPONENTS, access_path_components, 1)                                             \
+  X(DIR_SNAPSHOT_CALLS, dir_snapshot_calls, 0)                                                     \
+  X(DIR_SNAPSHOT_BYTES, dir_snapshot_bytes, 0)                                                     \
+  X(DIR_SNAPSHOT_META_LOAD_CALLS, dir_snapshot_meta_load_calls, 0)                                 \
+  X(DIRENT_VIEW_NEXT_CALLS, dirent_view_next_calls, 1)                                             \
+  X(PREAD_CALLS, pread_calls, 0)                                                                   \
+  X(PWRITE_CALLS, pwrite_calls, 0)                                                                 \
+  X(PWRITE_BYTES, pwrite_bytes, 0)                                                                 \
+  X(PWRITE_NS_IBLK_READ, pwrite_ns_iblk_read, 0)                                                   \
+  X(PWRITE_NS_IBLK_WRITE, pwrite_ns_iblk_write, 0)                                                 \
+  X(IBLK_WRITE_NS_HRL_PUT, iblk_write_ns_hrl_put, 0)                                               \
+  X(IBLK_WRITE_NS_LEGACY_BLK_WRITE, iblk_write_ns_legacy_blk_write, 0)                             \
+  X(IBLK_WRITE_NS_DEC_REF, iblk_write_ns_dec_ref, 0)                                               \
+  X(BLK_ALLOC_CALLS, blk_alloc_calls, 0)                                                           \
+  X(BLK_ALLOC_CLAIM_RETRIES, blk_alloc_claim_retries, 0)                                           \
+  X(BLK_ALLOC_NS_SCAN, blk_alloc_ns_scan, 0)                                                       \
+  X(BLK_ALLOC_NS_CLAIM, blk_alloc_ns_claim, 0)                                                     \
+  X(BLK_ALLOC_NS_SET_USAGE, blk_alloc_ns_set_usage, 0)                                             \
+  X(BLK_SET_USAGE_CALLS, blk_set_usage_calls, 0)                                                   \
+  X(BLK_SET_USAGE_ALLOC_CALLS, blk_set_usage_alloc_calls, 0)                                       \
+  X(BLK_SET_USAGE_FREE_CALLS, blk_set_usage_free_calls, 0)                                         \
+  X(BLK_SET_USAGE_NS_BIT_UPDATE, blk_set_usage_ns_bit_update, 0)                                   \
+  X(BLK_SET_USAGE_NS_FREECNT_UPDATE, blk_set_usage_ns_freecnt_update, 0)                           \
+  X(BLK_SET_USAGE_NS_WTIME_UPDATE, blk_set_usage_ns_wtime_update, 0)                               \
+  X(COPY_SHARE_ATTEMPT_BLOCKS, copy_share_attempt_blocks, 0)                                       \
+  X(COPY_SHARE_DONE_BLOCKS, copy_share_done_blocks, 0)                                             \
+  X(COPY_SHARE_FALLBACK_BLOCKS, copy_share_fallback_blocks, 0)                                     \
+  X(COPY_SHARE_SKIP_UNALIGNED, copy_share_skip_unaligned, 0)                                       \
+  X(COPY_SHARE_SKIP_DST_INLINE, copy_share_skip_dst_inline, 0)                                     \
+  X(PREALLOC_WINDOWS, prealloc_windows, 0)                                                         \
+  X(PREALLOC_RESERVED_BLOCKS, prealloc_reserved_blocks, 0)                                         \
+  X(PREALLOC_HITS, prealloc_hits, 0)                                                               \
+  X(PREALLOC_MISSES, prealloc_misses, 0)                                                           \
+  X(PREALLOC_WASTED_BLOCKS, prealloc_wasted_blocks, 0)                                             \
+  X(DEDUP_BYPASS_BLOCKS, dedup_bypass_blocks, 0)                                                   \
+  X(CBLK_READ_HITS, cblk_read_hits, 0)                                                             \
+  X(CBLK_READ_DECODES, cblk_read_decodes, 0)                                                       \
+  X(IO_READ_BLOCKS, io_read_blocks, 0)                                                             \
+  X(IO_WRITE_BLOCKS, io_write_blocks, 0)
+
+#define KAFS_STAT_ENUM_(id, name, rec) KAFS_STAT_##id,
+typedef enum
+{
+  KAFS_STAT_SHARDED_LIST(KAFS_STAT_ENUM_) KAFS_STAT_COUNT
+} kafs_stat_id_t;
+#undef KAFS_STAT_ENUM_
+
+#define KAFS_STAT_SHARD_ALIGN 64u
+#define KAFS_STAT_SHARD_WORDS ((KAFS_STAT_COUNT + 7u) & ~7u) // 64B の倍数に丸める
+#define KAFS_STAT_SHARDS_MAX 64u
+
+typedef struct
+{
+  uint64_t v[KAFS_STAT_SHARD_WORDS];
+} kafs_stat_shard_t;
+
+/// @brief シャード表を確保する（オンライン CPU 数以上の 2 のべき、上限 KAFS_STAT_SHARDS_MAX）
+/// @return 0: 成功, -ENOMEM: 失敗（*out は NULL のまま、フォールバックで数える）
+static inline int kafs_stat_shards_alloc(kafs_stat_shard_t **out, uint32_t *out_mask)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_CONF);
+  uint32_t n = 1;
+  while ((long)n < cpus && n < KAFS_STAT_SHARDS_MAX)
+    n <<= 1;
+  void *mem = NULL;
+  if (posix_memalign(&mem, KAFS_STAT_SHARD_ALIGN, (size_t)n * sizeof(kafs_stat_shard_t)) != 0)
+    return -ENOMEM;
+  for (size_t i = 0; i < (size_t)n * KAFS_STAT_SHARD_WORDS; ++i)
+    ((uint64_t *)mem)[i] = 0;
+  *out = (kafs_stat_shard_t *)mem;
+  *out_mask = n - 1u;
+  return 0;
+}
+
+/// @brief 呼び出しスレッドのシャード番号（初回に round-robin で決める）
+static inline uint32_t kafs_stat_thread_shard(void)
+{
+  static uint32_t next;
+  static __thread uint32_t mine; // 0: 未割当、それ以外は番号 + 1
+  if (mine == 0)
+    mine = __atomic_add_fetch(&next, 1u, __ATOMIC_RELAXED);
+  return mine - 1u;
+}
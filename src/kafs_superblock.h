@@ -86,7 +86,13 @@ struct kafs_ssuperblock
   kafs_su64_t s_tailmeta_offset; // +192 (8)
   /// @brief tail metadata region のサイズ（バイト）
   kafs_su64_t s_tailmeta_size;   // +200 (8)
-  uint8_t s_reserved[256 - 208]; // +208 .. +255
+  uint8_t s_reserved[240 - 208]; // +208 .. +239 (v6: superblock anchor)
+  /// @brief 回収待ち tombstone 数のヒント（0: 不明 → マウント時に inode 表を走査, n + 1: n 個）
+  kafs_su32_t s_tombstone_hint; // +240 (4)
+  /// @brief 背景 dedup のヒント（0: 未確認の direct ブロックがあるかもしれない → マウント時に巡回,
+  /// 1: 正常アンマウント時に書き込みログを消化済み）
+  kafs_su32_t s_bg_dedup_hint;    // +244 (4)
+  uint8_t s_reserved2[256 - 248]; // +248 .. +255
 } __attribute__((packed));
 
 typedef struct kafs_ssuperblock kafs_ssuperblock_t;
@@ -381,6 +387,24 @@ static inline void kafs_sb_tailmeta_size_set(struct kafs_ssuperblock *sb, uint64
   sb->s_tailmeta_size = kafs_u64_htos(v);
 }
 
+static inline uint32_t kafs_sb_tombstone_hint_get(const struct kafs_ssuperblock *sb)
+{
+  return kafs_u32_stoh(sb->s_tombstone_hint);
+}
+static inline void kafs_sb_tombstone_hint_set(struct kafs_ssuperblock *sb, uint32_t v)
+{
+  sb->s_tombstone_hint = kafs_u32_htos(v);
+}
+
+static inline uint32_t kafs_sb_bg_dedup_hint_get(const struct kafs_ssuperblock *sb)
+{
+  return kafs_u32_stoh(sb->s_bg_dedup_hint);
+}
+static inline void kafs_sb_bg_dedup_hint_set(struct kafs_ssuperblock *sb, uint32_t v)
+{
+  sb->s_bg_dedup_hint = kafs_u32_htos(v);
+}
+
 static kafs_blksize_t kafs_sb_blksize_get(const struct kafs_ssuperblock *sb)
 {
   assert(sb != NULL);
@@ -0,0 +1,225 @@
+#pragma once
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// 最小限の io_uring ラッパー（liburing には依存せず io_uring_setup / io_uring_enter を直接呼ぶ）。
+// 複数の SQE を IOSQE_IO_LINK でつないで 1 回の io_uring_enter で投入・完了待ちするためだけに使う。
+// 実行時に setup と IORING_REGISTER_PROBE で必要な op を確かめ、使えなければ -ENOSYS を返すので、
+// 呼び出し側は pwrite / fsync の同期経路にフォールバックする。スレッド安全ではない（所有者が直列化する）。
+
+#if defined(IO_URING_OP_SUPPORTED) && defined(IORING_FEAT_SINGLE_MMAP) &&                        \
+    defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) &&                             \
+    defined(__NR_io_uring_register)
+#define KAFS_URING_HAVE 1
+#else
+#define KAFS_URING_HAVE 0
+#endif
+
+#define KAFS_URING_ENTRIES 8u
+
+typedef struct kafs_uring
+{
+  int fd; // -1: 未初期化または利用不可
+  void *ring;
+  size_t ring_sz;
+  void *sqes;
+  size_t sqes_sz;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  void *cqes;
+  unsigned queued; // 次の submit で投入する SQE 数
+} kafs_uring_t;
+
+static inline void kafs_uring_reset(kafs_uring_t *u)
+{
+  memset(u, 0, sizeof(*u));
+  u->fd = -1;
+}
+
+static inline int kafs_uring_ready(const kafs_uring_t *u) { return u && u->fd >= 0; }
+
+#if KAFS_URING_HAVE
+
+static inline void kafs_uring_destroy(kafs_uring_t *u)
+{
+  if (!u)
+    return;
+  if (u->sqes)
+    munmap(u->sqes, u->sqes_sz);
+  if (u->ring)
+    munmap(u->ring, u->ring_sz);
+  if (u->fd >= 0)
+    close(u->fd);
+  kafs_uring_reset(u);
+}
+
+/// @brief 必要な op（WRITEV / FSYNC）をカーネルが実装しているか確かめる
+static inline int kafs_uring_probe_ops(int fd)
+{
+  const unsigned nops = 64u;
+  size_t sz = sizeof(struct io_uring_probe) + nops * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *p = calloc(1, sz);
+  if (!p)
+    return -ENOMEM;
+  int rc = -ENOSYS;
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, p, nops) == 0 &&
+      p->last_op >= IORING_OP_FSYNC && (p->ops[IORING_OP_WRITEV].flags & IO_URING_OP_SUPPORTED) &&
+      (p->ops[IORING_OP_FSYNC].flags & IO_URING_OP_SUPPORTED))
+    rc = 0;
+  free(p);
+  return rc;
+}
+
+/// @brief リングを作る。seccomp やカーネルの都合で使えなければ -errno（u は未初期化のまま）
+static inline int kafs_uring_init(kafs_uring_t *u)
+{
+  kafs_uring_reset(u);
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int fd = (int)syscall(__NR_io_uring_setup, KAFS_URING_ENTRIES, &p);
+  if (fd < 0)
+    return -errno;
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP) || kafs_uring_probe_ops(fd) != 0)
+  {
+    close(fd);
+    return -ENOSYS;
+  }
+
+  size_t sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  size_t cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  u->fd = fd;
+  u->ring_sz = (sq_sz > cq_sz) ? sq_sz : cq_sz;
+  u->ring = mmap(NULL, u->ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                 IORING_OFF_SQ_RING);
+  if (u->ring == MAP_FAILED)
+  {
+    u->ring = NULL;
+    int err = -errno;
+    kafs_uring_destroy(u);
+    return err;
+  }
+  u->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = mmap(NULL, u->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                 IORING_OFF_SQES);
+  if (u->sqes == MAP_FAILED)
+  {
+    u->sqes = NULL;
+    int err = -errno;
+    kafs_uring_destroy(u);
+    return err;
+  }
+  char *r = (char *)u->ring;
+  u->sq_head = (unsigned *)(r + p.sq_off.head);
+  u->sq_tail = (unsigned *)(r + p.sq_off.tail);
+  u->sq_mask = (unsigned *)(r + p.sq_off.ring_mask);
+  u->sq_array = (unsigned *)(r + p.sq_off.array);
+  u->cq_head = (unsigned *)(r + p.cq_off.head);
+  u->cq_tail = (unsigned *)(r + p.cq_off.tail);
+  u->cq_mask = (unsigned *)(r + p.cq_off.ring_mask);
+  u->cqes = r + p.cq_off.cqes;
+  return 0;
+}
+
+/// @brief 空き SQE を 1 つ取り、ゼロクリアして返す（満杯なら NULL）
+static inline struct io_uring_sqe *kafs_uring_get_sqe(kafs_uring_t *u)
+{
+  unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+  unsigned tail = *u->sq_tail + u->queued;
+  if (tail - head >= KAFS_URING_ENTRIES)
+    return NULL;
+  unsigned idx = tail & *u->sq_mask;
+  struct io_uring_sqe *sqe = &((struct io_uring_sqe *)u->sqes)[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  u->sq_array[idx] = idx;
+  u->queued++;
+  return sqe;
+}
+
+static inline void kafs_uring_prep_writev(struct io_uring_sqe *sqe, int fd, const struct iovec *iov,
+                                          unsigned cnt, uint64_t off)
+{
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)iov;
+  sqe->len = cnt;
+  sqe->off = off;
+}
+
+/// @brief len == 0 ならファイル全体、それ以外は [off, off + len) を同期する
+static inline void kafs_uring_prep_fsync(struct io_uring_sqe *sqe, int fd, uint64_t off,
+                                         uint32_t len, unsigned fsync_flags)
+{
+  sqe->opcode = IORING_OP_FSYNC;
+  sqe->fd = fd;
+  sqe->off = off;
+  sqe->len = len;
+  sqe->fsync_flags = fsync_flags;
+}
+
+/// @brief 積んだ SQE をまとめて投入し、全件の完了を待つ。res[i] に user_data == i の結果。
+/// @return 0: 全件完了（個々の成否は res）, < 0: io_uring_enter 自体の失敗 (-errno)。
+///         失敗時はリングの状態が不定なので、呼び出し側は kafs_uring_destroy して同期経路に戻る。
+static inline int kafs_uring_submit_wait(kafs_uring_t *u, int *res, unsigned nres)
+{
+  unsigned n = u->queued;
+  if (n == 0)
+    return 0;
+  __atomic_store_n(u->sq_tail, *u->sq_tail + n, __ATOMIC_RELEASE);
+  u->queued = 0;
+  unsigned submitted = 0, reaped = 0;
+  while (reaped < n)
+  {
+    long rc = syscall(__NR_io_uring_enter, u->fd, n - submitted, n - reaped, IORING_ENTER_GETEVENTS,
+                      NULL, 0);
+    if (rc < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -errno;
+    }
+    submitted += (unsigned)rc;
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head, ++reaped)
+    {
+      const struct io_uring_cqe *cqe = &((const struct io_uring_cqe *)u->cqes)[head & *u->cq_mask];
+      if (cqe->user_data < nres)
+        res[cqe->user_data] = cqe->res;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  }
+  return 0;
+}
+
+#else
+
+static inline void kafs_uring_destroy(kafs_uring_t *u)
+{
+  if (u)
+    kafs_uring_reset(u);
+}
+
+static inline int kafs_uring_init(kafs_uring_t *u)
+{
+  kafs_uring_reset(u);
+  return -ENOSYS;
+}
+
+#endif
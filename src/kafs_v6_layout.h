@@ -1742,7 +1742,8 @@ static inline int kafs_v6_journal_scan_data_fd(int fd, const kafs_v6_journal_dat
     if (rec.size != 0u)
       rc = kafs_pread_all(fd, buf + sizeof(crc_rec), rec.size,
                           (off_t)(data->data_off + payload_off));
-    if (rc == 0 && kj_crc32(buf, (size_t)total) != rec.crc32)
+    if (rc == 0 && kj_rec_crc_update(hdr->version, 0, (const uint8_t *)buf, (size_t)total) !=
+                       rec.crc32)
       rc = -EINVAL;
     free(buf);
     if (rc != 0)
@@ -551,6 +551,66 @@ static const char *fsync_policy_str(uint32_t policy)
   }
 }
 
+static const char *bg_work_name(uint32_t id)
+{
+  switch (id)
+  {
+  case KAFS_STATS_BG_PENDING:
+    return "pending";
+  case KAFS_STATS_BG_TOMBSTONE_GC:
+    return "tombstone_gc";
+  case KAFS_STATS_BG_DEDUP:
+    return "dedup";
+  default:
+    return "unknown";
+  }
+}
+
+static const char *meta_prefault_state_str(uint32_t state)
+{
+  switch (state)
+  {
+  case 1:
+    return "running";
+  case 2:
+    return "done";
+  case 3:
+    return "stopped";
+  case 0:
+  default:
+    return "off";
+  }
+}
+
+static const char *io_engine_str(uint32_t engine)
+{
+  switch (engine)
+  {
+  case 0:
+    return "mmap";
+  case 1:
+    return "pread";
+  case 2:
+    return "direct";
+  default:
+    return "unknown";
+  }
+}
+
+static const char *tombstone_queue_state_str(uint32_t state)
+{
+  switch (state)
+  {
+  case 1:
+    return "ready";
+  case 2:
+    return "sweeping";
+  case 0:
+  default:
+    return "off";
+  }
+}
+
 static int parse_fsync_policy(const char *s, uint32_t *out)
 {
   if (!s || !out)
@@ -1011,6 +1071,14 @@ static void hotplug_status_from_rpc(kafs_hotplug_status_t *out, const kafs_rpc_h
   out->pending_oldest_age_ms = in->pending_oldest_age_ms;
   out->pending_ttl_over_soft = in->pending_ttl_over_soft;
   out->pending_ttl_over_hard = in->pending_ttl_over_hard;
+  out->back_workers = in->back_workers;
+  out->back_queue_depth = in->back_queue_depth;
+  out->back_queue_depth_max = in->back_queue_depth_max;
+  out->back_status_valid = in->back_status_valid;
+  out->back_requests = in->back_requests;
+  out->back_service_ns = in->back_service_ns;
+  out->back_service_ns_max = in->back_service_ns_max;
+  out->back_queue_wait_ns = in->back_queue_wait_ns;
 }
 
 static int get_hotplug_status(const char *mnt, kafs_hotplug_status_t *out)
@@ -1099,7 +1167,15 @@ static int cmd_hotplug_status(const char *mnt, int json)
     printf("  \"pending_ttl_hard_ms\": %u,\n", st.pending_ttl_hard_ms);
     printf("  \"pending_oldest_age_ms\": %" PRIu64 ",\n", st.pending_oldest_age_ms);
     printf("  \"pending_ttl_over_soft\": %u,\n", st.pending_ttl_over_soft);
-    printf("  \"pending_ttl_over_hard\": %u\n", st.pending_ttl_over_hard);
+    printf("  \"pending_ttl_over_hard\": %u,\n", st.pending_ttl_over_hard);
+    printf("  \"back_status_valid\": %u,\n", st.back_status_valid);
+    printf("  \"back_workers\": %u,\n", st.back_workers);
+    printf("  \"back_queue_depth\": %u,\n", st.back_queue_depth);
+    printf("  \"back_queue_depth_max\": %u,\n", st.back_queue_depth_max);
+    printf("  \"back_requests\": %" PRIu64 ",\n", st.back_requests);
+    printf("  \"back_service_ns\": %" PRIu64 ",\n", st.back_service_ns);
+    printf("  \"back_service_ns_max\": %" PRIu64 ",\n", st.back_service_ns_max);
+    printf("  \"back_queue_wait_ns\": %" PRIu64 "\n", st.back_queue_wait_ns);
     printf("}\n");
     return 0;
   }
@@ -1130,6 +1206,17 @@ static int cmd_hotplug_status(const char *mnt, int json)
   printf("  pending_oldest_age_ms: %" PRIu64 "\n", st.pending_oldest_age_ms);
   printf("  pending_ttl_over_soft: %u\n", st.pending_ttl_over_soft);
   printf("  pending_ttl_over_hard: %u\n", st.pending_ttl_over_hard);
+  if (!st.back_status_valid)
+  {
+    printf("  back_exec: unavailable\n");
+    return 0;
+  }
+  uint64_t n = st.back_requests ? st.back_requests : 1u;
+  printf("  back_exec: workers=%u queue_depth=%u queue_depth_max=%u requests=%" PRIu64
+         " service_avg_us=%.1f service_max_us=%.1f queue_wait_avg_us=%.1f\n",
+         st.back_workers, st.back_queue_depth, st.back_queue_depth_max, st.back_requests,
+         (double)st.back_service_ns / (double)n / 1000.0, (double)st.back_service_ns_max / 1000.0,
+         (double)st.back_queue_wait_ns / (double)n / 1000.0);
   return 0;
 }
 
@@ -2067,6 +2154,9 @@ typedef struct kafs_stats_report
   double hrl_hit_rate_pct;
   double hrl_miss_rate_pct;
   double hrl_rescue_hit_rate;
+  double prealloc_hit_rate;
+  double prealloc_waste_rate;
+  double journal_commits_per_flush;
   char tombstone_oldest_buf[64];
 } kafs_stats_report_t;
 
@@ -2218,6 +2308,17 @@ static void kafsctl_stats_compute_bg_metrics(kafs_stats_report_t *report)
                                                ? (double)report->st.pending_worker_start_failures /
                                                      (double)report->st.pending_worker_start_calls
                                                : 0.0;
+  uint64_t prealloc_allocs = report->st.prealloc_hits + report->st.prealloc_misses;
+  report->prealloc_hit_rate =
+      (prealloc_allocs > 0) ? (double)report->st.prealloc_hits / (double)prealloc_allocs : 0.0;
+  report->prealloc_waste_rate = (report->st.prealloc_reserved_blocks > 0)
+                                    ? (double)report->st.prealloc_wasted_blocks /
+                                          (double)report->st.prealloc_reserved_blocks
+                                    : 0.0;
+  report->journal_commits_per_flush =
+      (report->st.journal_flushes > 0)
+          ? (double)report->st.journal_commits / (double)report->st.journal_flushes
+          : 0.0;
 }
 
 static void kafsctl_stats_compute_report(kafs_stats_report_t *report)
@@ -2313,6 +2414,9 @@ static int kafsctl_stats_print_json(const kafs_stats_report_t *report)
   printf("  \"lock_inode_wait_ns\": %" PRIu64 ",\n", st->lock_inode_wait_ns);
   printf("  \"lock_inode_contended_rate\": %.6f,\n", report->lock_inode_cont_rate);
   printf("  \"lock_inode_wait_ms\": %.3f,\n", report->lock_inode_wait_ms);
+  printf("  \"lock_inode_stripes\": %" PRIu32 ",\n", st->lock_inode_stripes);
+  printf("  \"lock_inode_reentrant\": %" PRIu64 ",\n", st->lock_inode_reentrant);
+  printf("  \"inode_track_bytes\": %" PRIu64 ",\n", st->inode_track_bytes);
   printf("  \"lock_inode_alloc_acquire\": %" PRIu64 ",\n", st->lock_inode_alloc_acquire);
   printf("  \"lock_inode_alloc_contended\": %" PRIu64 ",\n", st->lock_inode_alloc_contended);
   printf("  \"lock_inode_alloc_wait_ns\": %" PRIu64 ",\n", st->lock_inode_alloc_wait_ns);
@@ -2405,6 +2509,39 @@ static int kafsctl_stats_print_json(const kafs_stats_report_t *report)
   printf("  \"bg_dedup_last_replacements\": %" PRIu64 ",\n", st->bg_dedup_last_replacements);
   printf("  \"bg_dedup_idle_skip_streak\": %" PRIu64 ",\n", st->bg_dedup_idle_skip_streak);
   printf("  \"bg_dedup_cold_start_due_ms\": %" PRIu64 ",\n", st->bg_dedup_cold_start_due_ms);
+  printf("  \"bg_dedup_log_cap\": %" PRIu32 ",\n", st->bg_dedup_log_cap);
+  printf("  \"bg_dedup_sweep\": %" PRIu32 ",\n", st->bg_dedup_sweep);
+  printf("  \"bg_dedup_log_pending\": %" PRIu64 ",\n", st->bg_dedup_log_pending);
+  printf("  \"bg_dedup_log_noted\": %" PRIu64 ",\n", st->bg_dedup_log_noted);
+  printf("  \"bg_dedup_log_dropped\": %" PRIu64 ",\n", st->bg_dedup_log_dropped);
+  printf("  \"bg_dedup_log_consumed\": %" PRIu64 ",\n", st->bg_dedup_log_consumed);
+  printf("  \"bg_dedup_log_stale\": %" PRIu64 ",\n", st->bg_dedup_log_stale);
+  printf("  \"bg_dedup_sweeps\": %" PRIu64 ",\n", st->bg_dedup_sweeps);
+  printf("  \"dedup_bypass_sample\": %" PRIu32 ",\n", st->dedup_bypass_sample);
+  printf("  \"dedup_bypass_hit_pct\": %" PRIu32 ",\n", st->dedup_bypass_hit_pct);
+  printf("  \"dedup_bypass_blocks\": %" PRIu64 ",\n", st->dedup_bypass_blocks);
+  printf("  \"dedup_bypass_probes\": %" PRIu64 ",\n", st->dedup_bypass_probes);
+  printf("  \"dedup_bypass_enter\": %" PRIu64 ",\n", st->dedup_bypass_enter);
+  printf("  \"dedup_bypass_leave\": %" PRIu64 ",\n", st->dedup_bypass_leave);
+  printf("  \"dedup_bypass_keep\": %" PRIu64 ",\n", st->dedup_bypass_keep);
+  printf("  \"compress_enabled\": %" PRIu32 ",\n", st->compress_enabled);
+  printf("  \"cblk_slots\": %" PRIu32 ",\n", st->cblk_slots);
+  printf("  \"cblk_stored\": %" PRIu64 ",\n", st->cblk_stored);
+  printf("  \"cblk_raw\": %" PRIu64 ",\n", st->cblk_raw);
+  printf("  \"cblk_bytes_out\": %" PRIu64 ",\n", st->cblk_bytes_out);
+  printf("  \"cblk_containers\": %" PRIu64 ",\n", st->cblk_containers);
+  printf("  \"cblk_containers_freed\": %" PRIu64 ",\n", st->cblk_containers_freed);
+  printf("  \"cblk_read_hits\": %" PRIu64 ",\n", st->cblk_read_hits);
+  printf("  \"cblk_read_decodes\": %" PRIu64 ",\n", st->cblk_read_decodes);
+  printf("  \"lock_cblk_acquire\": %" PRIu64 ",\n", st->lock_cblk_acquire);
+  printf("  \"lock_cblk_contended\": %" PRIu64 ",\n", st->lock_cblk_contended);
+  printf("  \"lock_cblk_wait_ns\": %" PRIu64 ",\n", st->lock_cblk_wait_ns);
+  printf("  \"blk_cache_bytes\": %" PRIu64 ",\n", st->blk_cache_bytes);
+  printf("  \"blk_cache_hits\": %" PRIu64 ",\n", st->blk_cache_hits);
+  printf("  \"blk_cache_misses\": %" PRIu64 ",\n", st->blk_cache_misses);
+  printf("  \"blk_cache_inserts\": %" PRIu64 ",\n", st->blk_cache_inserts);
+  printf("  \"blk_cache_evictions\": %" PRIu64 ",\n", st->blk_cache_evictions);
+  printf("  \"blk_cache_invalidations\": %" PRIu64 ",\n", st->blk_cache_invalidations);
   printf("  \"pending_queue_depth\": %" PRIu64 ",\n", st->pending_queue_depth);
   printf("  \"pending_queue_capacity\": %" PRIu64 ",\n", st->pending_queue_capacity);
   printf("  \"pending_queue_head\": %" PRIu64 ",\n", st->pending_queue_head);
@@ -2421,6 +2558,95 @@ static int kafsctl_stats_print_json(const kafs_stats_report_t *report)
   printf("  \"pending_worker_main_exits\": %" PRIu64 ",\n", st->pending_worker_main_exits);
   printf("  \"pending_resolved\": %" PRIu64 ",\n", st->pending_resolved);
   printf("  \"pending_old_block_freed\": %" PRIu64 ",\n", st->pending_old_block_freed);
+  printf("  \"pending_workers\": %" PRIu32 ",\n", st->pending_workers);
+  printf("  \"pending_resolved_ahead\": %" PRIu64 ",\n", st->pending_resolved_ahead);
+  printf("  \"prealloc_blocks\": %" PRIu32 ",\n", st->prealloc_blocks);
+  printf("  \"prealloc_windows\": %" PRIu64 ",\n", st->prealloc_windows);
+  printf("  \"prealloc_reserved_blocks\": %" PRIu64 ",\n", st->prealloc_reserved_blocks);
+  printf("  \"prealloc_hits\": %" PRIu64 ",\n", st->prealloc_hits);
+  printf("  \"prealloc_misses\": %" PRIu64 ",\n", st->prealloc_misses);
+  printf("  \"prealloc_hit_rate\": %.6f,\n", report->prealloc_hit_rate);
+  printf("  \"prealloc_wasted_blocks\": %" PRIu64 ",\n", st->prealloc_wasted_blocks);
+  printf("  \"prealloc_waste_rate\": %.6f,\n", report->prealloc_waste_rate);
+  printf("  \"prealloc_outstanding_blocks\": %" PRIu64 ",\n", st->prealloc_outstanding_blocks);
+  printf("  \"journal_commits\": %" PRIu64 ",\n", st->journal_commits);
+  printf("  \"journal_flushes\": %" PRIu64 ",\n", st->journal_flushes);
+  printf("  \"journal_commits_per_flush\": %.6f,\n", report->journal_commits_per_flush);
+  printf("  \"journal_sync_waits\": %" PRIu64 ",\n", st->journal_sync_waits);
+  printf("  \"journal_gc_window_ns\": %" PRIu64 ",\n", st->journal_gc_window_ns);
+  printf("  \"journal_gc_max_window_ns\": %" PRIu64 ",\n", st->journal_gc_max_window_ns);
+  printf("  \"journal_flusher_running\": %" PRIu32 ",\n", st->journal_flusher_running);
+  printf("  \"journal_uring\": %" PRIu32 ",\n", st->journal_uring);
+  printf("  \"journal_uring_flushes\": %" PRIu64 ",\n", st->journal_uring_flushes);
+  printf("  \"fsync_ranged\": %" PRIu32 ",\n", st->fsync_ranged);
+  printf("  \"fsync_ranged_calls\": %" PRIu64 ",\n", st->fsync_ranged_calls);
+  printf("  \"fsync_full_calls\": %" PRIu64 ",\n", st->fsync_full_calls);
+  printf("  \"fsync_ranged_bytes\": %" PRIu64 ",\n", st->fsync_ranged_bytes);
+  printf("  \"fsync_dirty_overflows\": %" PRIu64 ",\n", st->fsync_dirty_overflows);
+  printf("  \"meta_hugepage\": %" PRIu32 ",\n", st->meta_hugepage);
+  printf("  \"meta_hugepage_bytes\": %" PRIu64 ",\n", st->meta_hugepage_bytes);
+  printf("  \"meta_prefault_state\": \"%s\",\n",
+         meta_prefault_state_str(st->meta_prefault_state));
+  printf("  \"meta_prefault_bytes\": %" PRIu64 ",\n", st->meta_prefault_bytes);
+  printf("  \"meta_prefault_ns\": %" PRIu64 ",\n", st->meta_prefault_ns);
+  printf("  \"io_engine\": \"%s\",\n", io_engine_str(st->io_engine));
+  printf("  \"io_read_blocks\": %" PRIu64 ",\n", st->io_read_blocks);
+  printf("  \"io_write_blocks\": %" PRIu64 ",\n", st->io_write_blocks);
+  printf("  \"io_direct_fallbacks\": %" PRIu64 ",\n", st->io_direct_fallbacks);
+  printf("  \"mem_budget\": %" PRIu64 ",\n", st->mem_budget);
+  printf("  \"mem_blk_cache_bytes\": %" PRIu64 ",\n", st->mem_blk_cache_bytes);
+  printf("  \"mem_lock_bytes\": %" PRIu64 ",\n", st->mem_lock_bytes);
+  printf("  \"mem_track_bytes\": %" PRIu64 ",\n", st->mem_track_bytes);
+  printf("  \"mem_meta_bitmap_bytes\": %" PRIu64 ",\n", st->mem_meta_bitmap_bytes);
+  printf("  \"mem_fixed_bytes\": %" PRIu64 ",\n", st->mem_fixed_bytes);
+  printf("  \"mem_hrl_locks\": %" PRIu32 ",\n", st->mem_hrl_locks);
+  printf("  \"mem_meta_resident\": %" PRIu64 ",\n", st->mem_meta_resident);
+  printf("  \"mem_meta_target\": %" PRIu64 ",\n", st->mem_meta_target);
+  printf("  \"mem_trim_runs\": %" PRIu64 ",\n", st->mem_trim_runs);
+  printf("  \"mem_cold_bytes\": %" PRIu64 ",\n", st->mem_cold_bytes);
+  printf("  \"mem_pageout_bytes\": %" PRIu64 ",\n", st->mem_pageout_bytes);
+  printf("  \"hotplug_shm_slots\": %" PRIu32 ",\n", st->hotplug_shm_slots);
+  printf("  \"hotplug_shm_slot_size\": %" PRIu32 ",\n", st->hotplug_shm_slot_size);
+  printf("  \"hotplug_shm_reads\": %" PRIu64 ",\n", st->hotplug_shm_reads);
+  printf("  \"hotplug_shm_writes\": %" PRIu64 ",\n", st->hotplug_shm_writes);
+  printf("  \"hotplug_shm_bytes\": %" PRIu64 ",\n", st->hotplug_shm_bytes);
+  printf("  \"hotplug_shm_slot_misses\": %" PRIu64 ",\n", st->hotplug_shm_slot_misses);
+  printf("  \"hotplug_rpc_calls\": %" PRIu64 ",\n", st->hotplug_rpc_calls);
+  printf("  \"hotplug_rpc_handoffs\": %" PRIu64 ",\n", st->hotplug_rpc_handoffs);
+  printf("  \"hotplug_rpc_orphans\": %" PRIu64 ",\n", st->hotplug_rpc_orphans);
+  printf("  \"hotplug_rpc_inflight\": %" PRIu32 ",\n", st->hotplug_rpc_inflight);
+  printf("  \"hotplug_rpc_inflight_max\": %" PRIu32 ",\n", st->hotplug_rpc_inflight_max);
+  printf("  \"hotplug_rpc_tx_msgs\": %" PRIu64 ",\n", st->hotplug_rpc_tx_msgs);
+  printf("  \"hotplug_rpc_tx_batches\": %" PRIu64 ",\n", st->hotplug_rpc_tx_batches);
+  printf("  \"hotplug_rpc_tx_batch_max\": %" PRIu32 ",\n", st->hotplug_rpc_tx_batch_max);
+  printf("  \"hotplug_rpc_rx_msgs\": %" PRIu64 ",\n", st->hotplug_rpc_rx_msgs);
+  printf("  \"hotplug_rpc_rx_syscalls\": %" PRIu64 ",\n", st->hotplug_rpc_rx_syscalls);
+  printf("  \"hotplug_rpc_max_payload\": %" PRIu32 ",\n", st->hotplug_rpc_max_payload);
+  printf("  \"hotplug_warm_restarts\": %" PRIu64 ",\n", st->hotplug_warm_restarts);
+  printf("  \"hotplug_cold_restarts\": %" PRIu64 ",\n", st->hotplug_cold_restarts);
+  printf("  \"hotplug_warm_state_bytes\": %" PRIu32 ",\n", st->hotplug_warm_state_bytes);
+  printf("  \"hotplug_ns_calls\": %" PRIu64 ",\n", st->hotplug_ns_calls);
+  printf("  \"hotplug_ns_readdir_chunks\": %" PRIu64 ",\n", st->hotplug_ns_readdir_chunks);
+  printf("  \"hotplug_ns_multi_attrs\": %" PRIu64 ",\n", st->hotplug_ns_multi_attrs);
+  printf("  \"stats_shards\": %" PRIu32 ",\n", st->stats_shards);
+  printf("  \"stats_record_counters\": %" PRIu32 ",\n", st->stats_record_counters);
+  printf("  \"bg_threads\": %" PRIu32 ",\n", st->bg_threads);
+  printf("  \"bg_busy_pct\": %" PRIu32 ",\n", st->bg_busy_pct);
+  printf("  \"bg_fg_busy\": %" PRIu32 ",\n", st->bg_fg_busy);
+  printf("  \"bg_windows\": %" PRIu64 ",\n", st->bg_windows);
+  printf("  \"bg_busy_windows\": %" PRIu64 ",\n", st->bg_busy_windows);
+  printf("  \"bg_fg_ops\": %" PRIu64 ",\n", st->bg_fg_ops);
+  for (uint32_t i = 0; i < KAFS_STATS_BG_WORK; ++i)
+  {
+    const char *name = bg_work_name(i);
+    printf("  \"bg_%s_runs\": %" PRIu64 ",\n", name, st->bg_work_runs[i]);
+    printf("  \"bg_%s_run_ns\": %" PRIu64 ",\n", name, st->bg_work_run_ns[i]);
+    printf("  \"bg_%s_throttled\": %" PRIu64 ",\n", name, st->bg_work_throttled[i]);
+  }
+  printf("  \"tombstone_queue_state\": %" PRIu32 ",\n", st->tombstone_queue_state);
+  printf("  \"tombstone_reclaimed\": %" PRIu64 ",\n", st->tombstone_reclaimed);
+  printf("  \"tombstone_gc_visits\": %" PRIu64 ",\n", st->tombstone_gc_visits);
+  printf("  \"tombstone_sweep_scanned\": %" PRIu64 ",\n", st->tombstone_sweep_scanned);
   printf("  \"bg_dedup_retry_rate\": %.6f,\n", report->bg_dedup_retry_rate);
   printf("  \"copy_share_hit_rate\": %.6f,\n", report->copy_share_hit_rate);
   printf("  \"pwrite_iblk_read_ms\": %.3f,\n", report->pwrite_iblk_read_ms);
@@ -2502,7 +2728,7 @@ static int kafsctl_stats_print_text(const kafs_stats_report_t *report, kafs_unit
   printf(")\n");
   printf("      inodes total=%" PRIu64 " free=%" PRIu64 "\n", st->fs_inodes_total,
          st->fs_inodes_free);
-  if (!report->have_verbose_scan)
+  if (!report->have_verbose_scan && st->tombstone_queue_state != 1u)
     printf("      tombstones: omitted without -v\n");
   else if (st->tombstone_inodes > 0)
     printf("      tombstones count=%" PRIu64 " oldest_dtime=%s (%" PRIu64 ".%09" PRIu64 ")\n",
@@ -2547,6 +2773,9 @@ static int kafsctl_stats_print_text(const kafs_stats_report_t *report, kafs_unit
   printf("  lock[inode]: acquire=%" PRIu64 " contended=%" PRIu64 " rate=%.3f wait_ms=%.3f\n",
          st->lock_inode_acquire, st->lock_inode_contended, report->lock_inode_cont_rate,
          report->lock_inode_wait_ms);
+  printf("  lock[inode] table: stripes=%" PRIu32 " reentrant=%" PRIu64
+         " track_bytes=%" PRIu64 "\n",
+         st->lock_inode_stripes, st->lock_inode_reentrant, st->inode_track_bytes);
   printf("  lock[inode_alloc]: acquire=%" PRIu64 " contended=%" PRIu64 " rate=%.3f wait_ms=%.3f\n",
          st->lock_inode_alloc_acquire, st->lock_inode_alloc_contended,
          report->lock_inode_alloc_cont_rate, report->lock_inode_alloc_wait_ms);
@@ -2619,6 +2848,29 @@ static int kafsctl_stats_print_text(const kafs_stats_report_t *report, kafs_unit
          st->bg_dedup_last_scanned_blocks, st->bg_dedup_last_direct_candidates,
          st->bg_dedup_last_replacements, st->bg_dedup_idle_skip_streak,
          st->bg_dedup_cold_start_due_ms);
+  printf("            log: cap=%" PRIu32 " pending=%" PRIu64 " noted=%" PRIu64 " dropped=%" PRIu64
+         " consumed=%" PRIu64 " stale=%" PRIu64 " sweep=%s sweeps=%" PRIu64 "\n",
+         st->bg_dedup_log_cap, st->bg_dedup_log_pending, st->bg_dedup_log_noted,
+         st->bg_dedup_log_dropped, st->bg_dedup_log_consumed, st->bg_dedup_log_stale,
+         st->bg_dedup_sweep ? "owed" : "none", st->bg_dedup_sweeps);
+  printf("  dedup_bypass: sample=%" PRIu32 " hit_pct=%" PRIu32 " blocks=%" PRIu64
+         " probes=%" PRIu64 " enter=%" PRIu64 " leave=%" PRIu64 " keep=%" PRIu64 "\n",
+         st->dedup_bypass_sample, st->dedup_bypass_hit_pct, st->dedup_bypass_blocks,
+         st->dedup_bypass_probes, st->dedup_bypass_enter, st->dedup_bypass_leave,
+         st->dedup_bypass_keep);
+  printf("  compress: %s stored=%" PRIu64 " raw=%" PRIu64 " bytes_out=%" PRIu64
+         " containers=%" PRIu64 " freed=%" PRIu64 " read_hits=%" PRIu64 " decodes=%" PRIu64
+         " lock_wait_ms=%.3f\n",
+         st->compress_enabled ? "on" : "off", st->cblk_stored, st->cblk_raw, st->cblk_bytes_out,
+         st->cblk_containers, st->cblk_containers_freed, st->cblk_read_hits,
+         st->cblk_read_decodes, (double)st->lock_cblk_wait_ns / 1000000.0);
+  printf("  blk_cache: bytes=%" PRIu64 " hits=%" PRIu64 " misses=%" PRIu64 " hit_rate=%.3f"
+         " inserts=%" PRIu64 " evictions=%" PRIu64 " invalidations=%" PRIu64 "\n",
+         st->blk_cache_bytes, st->blk_cache_hits, st->blk_cache_misses,
+         (st->blk_cache_hits + st->blk_cache_misses) > 0
+             ? (double)st->blk_cache_hits / (double)(st->blk_cache_hits + st->blk_cache_misses)
+             : 0.0,
+         st->blk_cache_inserts, st->blk_cache_evictions, st->blk_cache_invalidations);
   printf("  pending: depth=%" PRIu64 "/%" PRIu64 " head=%" PRIu64 " tail=%" PRIu64 "\n",
          st->pending_queue_depth, st->pending_queue_capacity, st->pending_queue_head,
          st->pending_queue_tail);
@@ -2629,8 +2881,77 @@ static int kafsctl_stats_print_text(const kafs_stats_report_t *report, kafs_unit
          st->pending_worker_start_last_error, st->pending_worker_lwp_tid);
   printf("           worker_main entries=%" PRIu64 " exits=%" PRIu64 "\n",
          st->pending_worker_main_entries, st->pending_worker_main_exits);
-  printf("           pending_resolved=%" PRIu64 " old_block_freed=%" PRIu64 "\n",
-         st->pending_resolved, st->pending_old_block_freed);
+  printf("           pending_resolved=%" PRIu64 " old_block_freed=%" PRIu64 " workers=%" PRIu32
+         " resolved_ahead=%" PRIu64 "\n",
+         st->pending_resolved, st->pending_old_block_freed, st->pending_workers,
+         st->pending_resolved_ahead);
+  printf("  prealloc: window_blocks=%" PRIu32 " windows=%" PRIu64 " reserved=%" PRIu64
+         " hits=%" PRIu64 " misses=%" PRIu64 " hit_rate=%.3f\n",
+         st->prealloc_blocks, st->prealloc_windows, st->prealloc_reserved_blocks,
+         st->prealloc_hits, st->prealloc_misses, report->prealloc_hit_rate);
+  printf("            wasted=%" PRIu64 " waste_rate=%.3f outstanding=%" PRIu64 "\n",
+         st->prealloc_wasted_blocks, report->prealloc_waste_rate,
+         st->prealloc_outstanding_blocks);
+  printf("  journal: commits=%" PRIu64 " flushes=%" PRIu64 " commits_per_flush=%.2f"
+         " sync_waits=%" PRIu64 "\n",
+         st->journal_commits, st->journal_flushes, report->journal_commits_per_flush,
+         st->journal_sync_waits);
+  printf("           window_us=%.1f max_window_us=%.1f flusher=%" PRIu32 " uring=%" PRIu32
+         " uring_flushes=%" PRIu64 "\n",
+         (double)st->journal_gc_window_ns / 1000.0,
+         (double)st->journal_gc_max_window_ns / 1000.0, st->journal_flusher_running,
+         st->journal_uring, st->journal_uring_flushes);
+  printf("  fsync: ranged=%" PRIu32 " ranged_calls=%" PRIu64 " full_calls=%" PRIu64
+         " ranged_bytes=%" PRIu64 " overflows=%" PRIu64 "\n",
+         st->fsync_ranged, st->fsync_ranged_calls, st->fsync_full_calls, st->fsync_ranged_bytes,
+         st->fsync_dirty_overflows);
+  printf("  meta_map: hugepage=%" PRIu32 " hugepage_bytes=%" PRIu64 " prefault=%s"
+         " prefault_bytes=%" PRIu64 " prefault_ms=%.1f\n",
+         st->meta_hugepage, st->meta_hugepage_bytes,
+         meta_prefault_state_str(st->meta_prefault_state), st->meta_prefault_bytes,
+         (double)st->meta_prefault_ns / 1000000.0);
+  printf("  io: engine=%s read_blocks=%" PRIu64 " write_blocks=%" PRIu64
+         " direct_fallbacks=%" PRIu64 "\n",
+         io_engine_str(st->io_engine), st->io_read_blocks, st->io_write_blocks,
+         st->io_direct_fallbacks);
+  printf("  mem: budget=%" PRIu64 " blk_cache=%" PRIu64 " locks=%" PRIu64 " (hrl_locks=%" PRIu32
+         ") track=%" PRIu64 " meta_bitmap=%" PRIu64 " fixed=%" PRIu64 "\n",
+         st->mem_budget, st->mem_blk_cache_bytes, st->mem_lock_bytes, st->mem_hrl_locks,
+         st->mem_track_bytes, st->mem_meta_bitmap_bytes, st->mem_fixed_bytes);
+  printf("  mem_trim: meta_resident=%" PRIu64 " target=%" PRIu64 " runs=%" PRIu64
+         " cold_bytes=%" PRIu64 " pageout_bytes=%" PRIu64 "\n",
+         st->mem_meta_resident, st->mem_meta_target, st->mem_trim_runs, st->mem_cold_bytes,
+         st->mem_pageout_bytes);
+  printf("  hotplug_shm: slots=%" PRIu32 " slot_size=%" PRIu32 " reads=%" PRIu64
+         " writes=%" PRIu64 " bytes=%" PRIu64 " slot_misses=%" PRIu64 "\n",
+         st->hotplug_shm_slots, st->hotplug_shm_slot_size, st->hotplug_shm_reads,
+         st->hotplug_shm_writes, st->hotplug_shm_bytes, st->hotplug_shm_slot_misses);
+  printf("  hotplug_rpc: calls=%" PRIu64 " inflight=%" PRIu32 " inflight_max=%" PRIu32
+         " handoffs=%" PRIu64 " orphans=%" PRIu64 "\n",
+         st->hotplug_rpc_calls, st->hotplug_rpc_inflight, st->hotplug_rpc_inflight_max,
+         st->hotplug_rpc_handoffs, st->hotplug_rpc_orphans);
+  printf("  hotplug_rpc_io: tx_msgs=%" PRIu64 " tx_batches=%" PRIu64 " tx_batch_max=%" PRIu32
+         " rx_msgs=%" PRIu64 " rx_syscalls=%" PRIu64 " max_payload=%" PRIu32 "\n",
+         st->hotplug_rpc_tx_msgs, st->hotplug_rpc_tx_batches, st->hotplug_rpc_tx_batch_max,
+         st->hotplug_rpc_rx_msgs, st->hotplug_rpc_rx_syscalls, st->hotplug_rpc_max_payload);
+  printf("  hotplug_restart: warm=%" PRIu64 " cold=%" PRIu64 " warm_state_bytes=%" PRIu32 "\n",
+         st->hotplug_warm_restarts, st->hotplug_cold_restarts, st->hotplug_warm_state_bytes);
+  printf("  hotplug_ns: calls=%" PRIu64 " readdir_chunks=%" PRIu64 " multi_attrs=%" PRIu64 "\n",
+         st->hotplug_ns_calls, st->hotplug_ns_readdir_chunks, st->hotplug_ns_multi_attrs);
+  printf("  stats: shards=%" PRIu32 " record_counters=%s\n", st->stats_shards,
+         st->stats_record_counters ? "on" : "off");
+  printf("  bg_sched: threads=%" PRIu32 " busy_pct=%" PRIu32 " fg_busy=%" PRIu32
+         " windows=%" PRIu64 " busy_windows=%" PRIu64 " fg_ops=%" PRIu64 "\n",
+         st->bg_threads, st->bg_busy_pct, st->bg_fg_busy, st->bg_windows, st->bg_busy_windows,
+         st->bg_fg_ops);
+  for (uint32_t i = 0; i < KAFS_STATS_BG_WORK; ++i)
+    printf("            %s runs=%" PRIu64 " run_ms=%.1f throttled=%" PRIu64 "\n",
+           bg_work_name(i), st->bg_work_runs[i], (double)st->bg_work_run_ns[i] / 1000000.0,
+           st->bg_work_throttled[i]);
+  printf("  tombstone_queue: state=%s reclaimed=%" PRIu64 " gc_visits=%" PRIu64
+         " sweep_scanned=%" PRIu64 "\n",
+         tombstone_queue_state_str(st->tombstone_queue_state), st->tombstone_reclaimed,
+         st->tombstone_gc_visits, st->tombstone_sweep_scanned);
   return 0;
 }
 
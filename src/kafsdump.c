@@ -74,7 +74,10 @@ static int dump_read_journal_header_slot(void *user, uint32_t slot, kj_header_t
   return kafs_pread_all(ctx->fd, hdr, sizeof(*hdr), (off_t)off);
 }
 
-static void usage(const char *prog) { fprintf(stderr, "Usage: %s [--json] <image>\n", prog); }
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [--json | --journal-records] <image>\n", prog);
+}
 
 static const char *rc_to_text(int rc)
 {
@@ -839,9 +842,59 @@ static void print_json(const struct dump_report *dump)
   printf("}\n");
 }
 
+// Decode the in-image ring back to text. Binary (v3) payloads are only rendered here and in fsck.
+static void print_journal_records(int fd, const kafs_ssuperblock_t *sb,
+                                  const struct journal_summary *jr)
+{
+  printf("journal_records:\n");
+  if (!jr->available || !jr->crc_ok || !kj_version_supported(jr->header.version))
+  {
+    printf("  status: unavailable\n");
+    return;
+  }
+  if (kafs_sb_format_version_get(sb) == KAFS_FORMAT_VERSION_V6)
+  {
+    printf("  status: unsupported (v6 descriptor-backed segments)\n");
+    return;
+  }
+
+  uint64_t data_off = kj_journal_data_offset(kafs_sb_journal_offset_get(sb));
+  uint64_t pos = 0;
+  uint64_t count = 0;
+  uint8_t pl[KJ_OP_PAYLOAD_MAX];
+  char text[1024];
+  while (pos + sizeof(kj_rec_hdr_t) <= jr->header.write_off)
+  {
+    kj_rec_hdr_t rh;
+    if (kafs_pread_all(fd, &rh, sizeof(rh), (off_t)(data_off + pos)) != 0)
+      break;
+    uint64_t rec_off = pos;
+    pos += sizeof(rh);
+    if (rh.tag == KJ_TAG_WRAP)
+    {
+      pos = 0;
+      continue;
+    }
+    if (pos + rh.size > jr->header.write_off)
+    {
+      printf("  - off=%" PRIu64 " <partial tail>\n", rec_off);
+      break;
+    }
+    size_t n = (rh.size < sizeof(pl)) ? rh.size : sizeof(pl);
+    if (n && kafs_pread_all(fd, pl, n, (off_t)(data_off + pos)) != 0)
+      break;
+    kj_format_record(jr->header.version, &rh, pl, n, text, sizeof(text));
+    printf("  - off=%" PRIu64 " %s\n", rec_off, text);
+    pos += rh.size;
+    count++;
+  }
+  printf("  count: %" PRIu64 "\n", count);
+}
+
 int main(int argc, char **argv)
 {
   int json = 0;
+  int journal_records = 0;
   const char *image = NULL;
 
   if (kafs_cli_exit_if_help(argc, argv, usage, argv[0]) == 0)
@@ -854,6 +907,11 @@ int main(int argc, char **argv)
       json = 1;
       continue;
     }
+    if (strcmp(argv[i], "--journal-records") == 0)
+    {
+      journal_records = 1;
+      continue;
+    }
 
     if (argv[i][0] == '-')
     {
@@ -864,7 +922,7 @@ int main(int argc, char **argv)
     image = argv[i];
   }
 
-  if (!image)
+  if (!image || (json && journal_records))
   {
     usage(argv[0]);
     return 2;
@@ -997,6 +1055,8 @@ int main(int argc, char **argv)
     print_json(&dump);
   else
     print_text(&dump);
+  if (journal_records)
+    print_journal_records(fd, &sb, &jr);
 
   free(v6_desc);
   close(fd);
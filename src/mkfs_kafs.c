@@ -7,6 +7,7 @@
 #include "kafs_hash.h"
 #include "kafs_journal.h"
 #include "kafs_tailmeta.h"
+#include "kafs_cblk.h"
 #include "kafs_v6_layout.h"
 #include "kafs_cli_opts.h"
 #include "kafs_tool_util.h"
@@ -47,6 +48,10 @@ static void usage(const char *prog)
                   "0.75, range: (0,1])\n");
   fprintf(stderr, "    --yes                             Skip overwrite confirmation prompt\n");
   fprintf(stderr, "\n");
+  fprintf(stderr, "  [Data]\n");
+  fprintf(stderr, "    --compress                        Allow LZ-compressed data blocks "
+                  "(blocks <= 2^26, blksize <= 64KiB)\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "  [Space Reclaim]\n");
   fprintf(stderr,
           "    --trim-data-area                  Punch holes for free data area after format\n");
@@ -323,6 +328,7 @@ typedef struct mkfs_options
   int inocnt_arg_provided;
   int trim_data_area;
   int journal_header_rotation;
+  int compress;
   int assume_yes;
 } mkfs_options_t;
 
@@ -425,6 +431,11 @@ static int mkfs_handle_arg(int argc, char **argv, int *index, mkfs_options_t *op
     }
     return 0;
   }
+  if (strcmp(arg, "--compress") == 0)
+  {
+    opts->compress = 1;
+    return 0;
+  }
   if (strcmp(arg, "--trim-data-area") == 0)
   {
     opts->trim_data_area = 1;
@@ -656,6 +667,8 @@ static void mkfs_init_superblock(kafs_context_t *ctx, uint32_t format_version,
   kafs_sb_tailmeta_size_set(ctx->c_superblock, (uint64_t)layout->tailmeta_size);
   kafs_sb_feature_flags_set(ctx->c_superblock, mkfs_feature_flags_for_format(format_version));
   kafs_sb_compat_flags_set(ctx->c_superblock, 0);
+  kafs_sb_tombstone_hint_set(ctx->c_superblock, 1u); // 新規イメージに tombstone はない
+  kafs_sb_bg_dedup_hint_set(ctx->c_superblock, 1u);  // 未確認の direct ブロックもない
   if (format_version == KAFS_FORMAT_VERSION_V6)
     kafs_v6_anchor_init(ctx->c_superblock, (uint64_t)layout->v6_desc_off, layout->v6_desc_bytes,
                         layout->v6_candidate_count);
@@ -860,6 +873,14 @@ int main(int argc, char **argv)
                           assume_yes, &total_bytes, &st, &layout, &blkcnt);
   if (prepare_rc != 0)
     return prepare_rc;
+  if (opts.compress && (blkcnt > KAFS_CBLK_REF_BLO_LIMIT || blksize > KAFS_LZ_MAX_INPUT))
+  {
+    // 圧縮参照はコンテナのブロック番号を 26bit で持つ
+    fprintf(stderr, "--compress requires at most %u blocks and blksize <= %u (got %u, %u)\n",
+            KAFS_CBLK_REF_BLO_LIMIT, KAFS_LZ_MAX_INPUT, (unsigned)blkcnt, (unsigned)blksize);
+    close(ctx.c_fd);
+    return 2;
+  }
 
   off_t mapsize = layout.mapsize;
   if (mkfs_map_metadata(&ctx, mapsize, blkcnt, format_version, inocnt, &layout) != 0)
@@ -870,6 +891,9 @@ int main(int argc, char **argv)
 
   mkfs_init_superblock(&ctx, format_version, log_blksize, inocnt, blkcnt, mapsize, journal_bytes,
                        journal_flags, &layout);
+  if (opts.compress)
+    kafs_sb_feature_flags_set(ctx.c_superblock, kafs_sb_feature_flags_get(ctx.c_superblock) |
+                                                    KAFS_FEATURE_COMPRESS);
   mkfs_init_root_inode(&ctx, format_version, mapsize);
   mkfs_init_runtime_regions(&ctx, &layout, journal_bytes, journal_flags, blksize, mapsize);
   if (mkfs_write_v6_descriptor(&ctx, &layout, total_bytes) != 0)
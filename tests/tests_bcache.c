@@ -0,0 +1,107 @@
+#include "kafs_bcache.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BS 64u
+
+static void fill(char *buf, uint32_t key) { memset(buf, (int)(key & 0xffu), BS); }
+
+static int has(kafs_bcache_t *c, uint32_t key)
+{
+  char buf[BS];
+  uint32_t ep;
+  if (!kafs_bcache_get(c, key, buf, &ep))
+    return 0;
+  char want[BS];
+  fill(want, key);
+  assert(memcmp(buf, want, BS) == 0);
+  return 1;
+}
+
+static void load(kafs_bcache_t *c, uint32_t key)
+{
+  char buf[BS];
+  uint32_t ep = 0;
+  assert(!kafs_bcache_get(c, key, buf, &ep));
+  fill(buf, key);
+  assert(kafs_bcache_put(c, key, buf, ep) == 1);
+}
+
+int main(void)
+{
+  char buf[BS];
+  uint32_t ep = 0;
+
+  // Budgets below one block and a missing cache are no-ops.
+  assert(kafs_bcache_create(BS - 1u, BS) == NULL);
+  assert(!kafs_bcache_get(NULL, 1, buf, &ep));
+  assert(kafs_bcache_put(NULL, 1, buf, 0) == 0);
+  kafs_bcache_invalidate(NULL, 1);
+
+  // A small budget shrinks the shard count so every shard still has a slot.
+  kafs_bcache_t *c = kafs_bcache_create(4u * BS, BS);
+  assert(c && c->bc_shard_mask == 3u && c->bc_slots == 1u);
+  assert(kafs_bcache_bytes(c) == 4u * BS);
+  kafs_bcache_destroy(c);
+
+  // Fill and hit; key 0 (KAFS_BLO_NONE) is never cached and duplicates are refused.
+  c = kafs_bcache_create(64u * BS, BS);
+  assert(c && c->bc_shard_mask == 15u && c->bc_slots == 4u);
+  for (uint32_t k = 1; k <= 4; ++k)
+    load(c, k);
+  for (uint32_t k = 1; k <= 4; ++k)
+    assert(has(c, k));
+  fill(buf, 0);
+  assert(kafs_bcache_put(c, 0, buf, 0) == 0);
+  kafs_bcache_get(c, 1, buf, &ep);
+  assert(kafs_bcache_put(c, 1, buf, ep) == 0);
+
+  // An invalidation between get and put keeps the stale copy out.
+  assert(!kafs_bcache_get(c, 1000, buf, &ep));
+  kafs_bcache_invalidate(c, 1000);
+  fill(buf, 1000);
+  assert(kafs_bcache_put(c, 1000, buf, ep) == 0);
+  assert(!has(c, 1000));
+
+  // Invalidation drops the entry.
+  assert(has(c, 2));
+  kafs_bcache_invalidate(c, 2);
+  assert(!has(c, 2));
+
+  kafs_bcache_counters_t cnt;
+  kafs_bcache_counters(c, &cnt);
+  assert(cnt.inserts == 4u && cnt.invalidations == 1u && cnt.hits == 6u);
+  kafs_bcache_destroy(c);
+
+  // A single slot is recycled by the next insert.
+  c = kafs_bcache_create(BS, BS);
+  assert(c && c->bc_shard_mask == 0u && c->bc_slots == 1u);
+  load(c, 7);
+  load(c, 8);
+  assert(!has(c, 7) && has(c, 8));
+  kafs_bcache_counters(c, &cnt);
+  assert(cnt.evictions == 1u);
+  kafs_bcache_destroy(c);
+
+  // GCLOCK: an entry hit since the hand last passed survives; the cold one goes first.
+  c = kafs_bcache_create(48u * BS, BS); // 16 shards x 3 slots
+  uint32_t keys[4];
+  uint32_t n = 0;
+  kafs_bcache_shard_t *sh0 = kafs_bcache_shard_of(c, 1);
+  for (uint32_t k = 1; n < 4u; ++k)
+    if (kafs_bcache_shard_of(c, k) == sh0)
+      keys[n++] = k;
+  for (uint32_t i = 0; i < 3u; ++i)
+    load(c, keys[i]);
+  assert(has(c, keys[0]) && has(c, keys[0]));
+  load(c, keys[3]);
+  assert(has(c, keys[0]) && has(c, keys[2]) && has(c, keys[3]));
+  assert(!has(c, keys[1]));
+  kafs_bcache_destroy(c);
+
+  printf("bcache OK\n");
+  return 0;
+}
@@ -50,10 +50,8 @@ int main(void)
   assert(kafs_hrl_open(&ctx) == 0);
 
   kafs_inocnt_t inocnt = kafs_sb_inocnt_get(ctx.c_superblock);
-  ctx.c_ino_epoch = calloc((size_t)inocnt, sizeof(uint32_t));
+  ctx.c_ino_epoch = kafs_sparse_u32_create((uint32_t)inocnt, 1u);
   assert(ctx.c_ino_epoch != NULL);
-  for (kafs_inocnt_t ino = 0; ino < inocnt; ++ino)
-    ctx.c_ino_epoch[ino] = 1u;
 
   kafs_blksize_t blksize = kafs_sb_blksize_get(ctx.c_superblock);
   char *block = malloc((size_t)blksize);
@@ -91,7 +89,7 @@ int main(void)
   }
 
   free(block);
-  free(ctx.c_ino_epoch);
+  kafs_sparse_u32_destroy(ctx.c_ino_epoch);
   ctx.c_ino_epoch = NULL;
   kafs_ctx_locks_destroy(&ctx);
   (void)kafs_hrl_close(&ctx);
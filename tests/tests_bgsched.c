@@ -0,0 +1,167 @@
+#include "kafs.h"
+#include "kafs_bgsched.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint32_t g_kick_runs;
+static uint32_t g_tick_runs;
+static uint32_t g_low_runs;
+static uint32_t g_slow_in_run;
+static uint32_t g_spin_runs;
+static uint32_t g_applied_mode = UINT32_MAX;
+static int32_t g_applied_nice = -1;
+static uint64_t g_fg_ops;
+static uint64_t g_fg_step;
+
+static void sleep_ms(unsigned ms)
+{
+  struct timespec ts = {.tv_sec = ms / 1000u, .tv_nsec = (long)(ms % 1000u) * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+static uint32_t load(const uint32_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+static uint32_t kick_run(void *arg, uint32_t *urgent)
+{
+  __atomic_add_fetch(&g_kick_runs, 1u, __ATOMIC_RELEASE);
+  return KAFS_BG_WAIT_KICK;
+}
+
+static uint32_t tick_run(void *arg, uint32_t *urgent)
+{
+  __atomic_add_fetch(&g_tick_runs, 1u, __ATOMIC_RELEASE);
+  return 1;
+}
+
+static uint32_t low_run(void *arg, uint32_t *urgent)
+{
+  __atomic_add_fetch(&g_low_runs, 1u, __ATOMIC_RELEASE);
+  return KAFS_BG_WAIT_KICK;
+}
+
+static uint32_t slow_run(void *arg, uint32_t *urgent)
+{
+  __atomic_store_n(&g_slow_in_run, 1u, __ATOMIC_RELEASE);
+  sleep_ms(50);
+  __atomic_store_n(&g_slow_in_run, 0u, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// 1 回 5ms 走り続ける作業。前景が忙しい窓では予算で間引かれるはず。
+static uint32_t spin_run(void *arg, uint32_t *urgent)
+{
+  __atomic_add_fetch(&g_spin_runs, 1u, __ATOMIC_RELEASE);
+  uint64_t end = kafs_bgsched_now_ns() + 5000000ull;
+  while (kafs_bgsched_now_ns() < end)
+    ;
+  return 0;
+}
+
+static int fake_apply_prio(uint32_t mode, int nice)
+{
+  __atomic_store_n(&g_applied_mode, mode, __ATOMIC_RELEASE);
+  __atomic_store_n(&g_applied_nice, (int32_t)nice, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static uint64_t fake_fg_probe(void *arg)
+{
+  return __atomic_add_fetch(&g_fg_ops, __atomic_load_n(&g_fg_step, __ATOMIC_RELAXED),
+                            __ATOMIC_RELAXED);
+}
+
+static void wait_for(const uint32_t *p, uint32_t want)
+{
+  for (int i = 0; i < 2000 && load(p) < want; ++i)
+    sleep_ms(1);
+  assert(load(p) >= want);
+}
+
+int main(void)
+{
+  kafs_bgsched_t *s = kafs_bgsched_create(2, 0, fake_apply_prio, NULL, NULL);
+  assert(s != NULL);
+  kafs_bgsched_stats_t st;
+  kafs_bgsched_stats_get(s, &st);
+  assert(st.threads == 3); // 2 normal + 1 low
+
+  // WAIT_KICK: runs once on registration, then only when kicked.
+  kafs_bg_work_t w = {.w_order = 0, .w_run = kick_run};
+  assert(kafs_bgsched_register(s, 0, &w) == 0);
+  assert(kafs_bgsched_register(s, 0, &w) == -EBUSY);
+  assert(kafs_bgsched_register(s, KAFS_BG_WORK_MAX, &w) == -EINVAL);
+  wait_for(&g_kick_runs, 1);
+  sleep_ms(20);
+  assert(load(&g_kick_runs) == 1);
+  kafs_bgsched_kick(s, 0, 0);
+  wait_for(&g_kick_runs, 2);
+
+  // Periodic work is re-queued by the delay it returns.
+  kafs_bg_work_t t = {.w_order = 1, .w_run = tick_run};
+  assert(kafs_bgsched_register(s, 1, &t) == 0);
+  wait_for(&g_tick_runs, 10);
+
+  // An item that asks for idle scheduling runs on the low lane, which applies it.
+  uint32_t idle = KAFS_PENDING_WORKER_PRIO_IDLE;
+  int32_t nice = 19, err = -1;
+  kafs_bg_work_t l = {.w_order = 2,
+                      .w_run = low_run,
+                      .w_prio_mode = &idle,
+                      .w_nice = &nice,
+                      .w_prio_err = &err};
+  assert(kafs_bgsched_register(s, 2, &l) == 0);
+  wait_for(&g_low_runs, 1);
+  assert(__atomic_load_n(&g_applied_mode, __ATOMIC_ACQUIRE) == KAFS_PENDING_WORKER_PRIO_IDLE);
+  assert(__atomic_load_n(&g_applied_nice, __ATOMIC_ACQUIRE) == 19);
+  assert(__atomic_load_n(&err, __ATOMIC_RELAXED) == 0);
+
+  // An urgent kick goes to a normal-lane thread, so the low thread's priority is left alone.
+  __atomic_store_n(&g_applied_mode, UINT32_MAX, __ATOMIC_RELEASE);
+  nice = 10;
+  kafs_bgsched_kick(s, 2, 1);
+  wait_for(&g_low_runs, 2);
+  assert(__atomic_load_n(&g_applied_mode, __ATOMIC_ACQUIRE) == UINT32_MAX);
+
+  // unregister waits for a running pass to finish.
+  kafs_bg_work_t sl = {.w_order = 3, .w_run = slow_run};
+  assert(kafs_bgsched_register(s, 3, &sl) == 0);
+  wait_for(&g_slow_in_run, 1);
+  kafs_bgsched_unregister(s, 3);
+  assert(load(&g_slow_in_run) == 0);
+  assert(kafs_bgsched_registered(s) == 3);
+
+  kafs_bgsched_unregister(s, 1);
+  uint32_t ticks = load(&g_tick_runs);
+  sleep_ms(20);
+  assert(load(&g_tick_runs) == ticks);
+  kafs_bgsched_stats_get(s, &st);
+  assert(st.runs[0] == 2 && st.runs[1] == ticks && st.runs[2] == 2);
+  kafs_bgsched_unregister(s, 0);
+  kafs_bgsched_unregister(s, 2);
+  assert(kafs_bgsched_registered(s) == 0);
+  kafs_bgsched_destroy(s);
+
+  // Foreground budget: every window looks busy, so a 10% share throttles a spinning item.
+  __atomic_store_n(&g_fg_step, 1000000u, __ATOMIC_RELAXED);
+  s = kafs_bgsched_create(1, 10, NULL, fake_fg_probe, NULL);
+  assert(s != NULL);
+  kafs_bg_work_t sp = {.w_order = 0, .w_run = spin_run};
+  assert(kafs_bgsched_register(s, 0, &sp) == 0);
+  sleep_ms(350);
+  kafs_bgsched_unregister(s, 0);
+  kafs_bgsched_stats_get(s, &st);
+  assert(st.busy_windows >= 1 && st.fg_busy == 1);
+  assert(st.throttled[0] > 0);
+  // The first window is unthrottled; after that each one allows about 10ms + one overrun.
+  assert(st.run_ns[0] < 250000000ull);
+  kafs_bgsched_destroy(s);
+
+  printf("bgsched OK\n");
+  return 0;
+}
@@ -0,0 +1,91 @@
+#define KAFS_NO_MAIN
+#include "kafs.c"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("blk_cache_raw") != 0)
+    return 77;
+
+  const char *img = "./blk_cache_raw.img";
+  kafs_context_t ctx;
+  off_t mapsize = 0;
+  assert(kafs_test_mkimg_with_hrl(img, 64 * 1024 * 1024u, 12, 64, &ctx, &mapsize) == 0);
+
+  struct stat st;
+  assert(fstat(ctx.c_fd, &st) == 0);
+  ctx.c_img_base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx.c_fd, 0);
+  assert(ctx.c_img_base != MAP_FAILED);
+  ctx.c_img_size = (size_t)st.st_size;
+
+  assert(kafs_ctx_locks_init(&ctx) == 0);
+  assert(kafs_hrl_open(&ctx) == 0);
+
+  // An uncompressed image under mmap gets no block cache: raw blocks are copied from the mapping.
+  ctx.c_blk_cache_mb = 1;
+  ctx.c_io_engine = KAFS_IO_ENGINE_MMAP;
+  kafs_blk_cache_init(&ctx);
+  assert(ctx.c_bcache == NULL);
+
+  ctx.c_io_engine = KAFS_IO_ENGINE_PREAD;
+  kafs_blk_cache_init(&ctx);
+  assert(ctx.c_bcache != NULL);
+
+  kafs_blksize_t blksize = kafs_sb_blksize_get(ctx.c_superblock);
+  char *block = malloc((size_t)blksize);
+  char *out = malloc((size_t)blksize);
+  assert(block && out);
+
+  kafs_blkcnt_t blo = KAFS_BLO_NONE;
+  assert(kafs_blk_alloc(&ctx, &blo) == 0 && blo != KAFS_BLO_NONE);
+  memset(block, 0x11, (size_t)blksize);
+  assert(kafs_blk_write(&ctx, blo, block) == 0);
+
+  // The first read goes to the image, the second comes from the cache by block number.
+  kafs_bcache_counters_t bc;
+  assert(kafs_blk_read(&ctx, blo, out) == 0 && memcmp(out, block, (size_t)blksize) == 0);
+  assert(kafs_blk_read(&ctx, blo, out) == 0 && memcmp(out, block, (size_t)blksize) == 0);
+  kafs_bcache_counters(ctx.c_bcache, &bc);
+  assert(bc.misses == 1u && bc.hits == 1u && bc.inserts == 1u);
+
+  // Rewriting the block drops the entry, so the next read sees the new contents.
+  memset(block, 0x22, (size_t)blksize);
+  assert(kafs_blk_write(&ctx, blo, block) == 0);
+  assert(kafs_blk_read(&ctx, blo, out) == 0 && memcmp(out, block, (size_t)blksize) == 0);
+  kafs_bcache_counters(ctx.c_bcache, &bc);
+  assert(bc.misses == 2u && bc.hits == 1u);
+
+  // An HRL block that is released (zeroed and freed) is dropped as well.
+  memset(block, 0x5a, (size_t)blksize);
+  kafs_hrid_t hrid = 0;
+  int is_new = 0;
+  kafs_blkcnt_t hrl_blo = KAFS_BLO_NONE;
+  assert(kafs_hrl_put(&ctx, block, &hrid, &is_new, &hrl_blo) == 0 && is_new);
+  assert(!kafs_cblk_ref_is(hrl_blo));
+  assert(kafs_blk_read(&ctx, hrl_blo, out) == 0 && memcmp(out, block, (size_t)blksize) == 0);
+  assert(kafs_hrl_dec_ref(&ctx, hrid) == 0);
+  memset(block, 0, (size_t)blksize);
+  assert(kafs_blk_read(&ctx, hrl_blo, out) == 0 && memcmp(out, block, (size_t)blksize) == 0);
+
+  free(block);
+  free(out);
+  kafs_bcache_destroy(ctx.c_bcache);
+  ctx.c_bcache = NULL;
+  kafs_ctx_locks_destroy(&ctx);
+  (void)kafs_hrl_close(&ctx);
+  munmap(ctx.c_img_base, ctx.c_img_size);
+  munmap(ctx.c_superblock, (size_t)mapsize);
+  close(ctx.c_fd);
+  unlink(img);
+  printf("blk_cache_raw OK\n");
+  return 0;
+}
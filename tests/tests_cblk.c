@@ -0,0 +1,124 @@
+#include "kafs_cblk.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BS 4096u
+
+static uint32_t g_rng = 12345u;
+
+static uint32_t rnd(void)
+{
+  g_rng = g_rng * 1103515245u + 12345u;
+  return g_rng >> 8;
+}
+
+static size_t roundtrip(const uint8_t *src, size_t n)
+{
+  uint8_t packed[BS * 2];
+  uint8_t out[BS];
+  size_t len = kafs_lz_compress(src, n, packed, sizeof(packed));
+  assert(len > 0);
+  size_t got = 0;
+  assert(kafs_lz_decompress(packed, len, out, sizeof(out), &got) == 0);
+  assert(got == n && memcmp(src, out, n) == 0);
+  return len;
+}
+
+int main(void)
+{
+  uint8_t blk[BS];
+  uint8_t text[BS];
+  uint8_t noise[BS];
+  uint8_t out[BS];
+
+  // Zeroes, text-like data and short inputs round-trip; repeats shrink well.
+  memset(blk, 0, sizeof(blk));
+  assert(roundtrip(blk, BS) < 64u);
+  for (uint32_t i = 0; i < BS; ++i)
+    text[i] = (uint8_t)("kafs compresses file data blocks "[i % 33u] + (i / 512u));
+  assert(roundtrip(text, BS) < BS / 4u);
+  assert(roundtrip(text, 1) == 2u);
+  roundtrip(text, 13);
+  for (uint32_t i = 0; i < BS; ++i)
+    noise[i] = (uint8_t)rnd();
+  roundtrip(noise, BS);
+
+  // Random data does not fit the container payload cap; that means "write raw".
+  uint8_t packed[BS];
+  uint32_t cap = kafs_cblk_payload_cap(BS);
+  assert(cap == BS - BS / 4u);
+  assert(kafs_lz_compress(noise, BS, packed, cap) == 0);
+
+  // The decoder rejects truncated input, bad offsets and output overrun.
+  size_t len = kafs_lz_compress(text, BS, packed, cap);
+  size_t got = 0;
+  assert(kafs_lz_decompress(packed, len - 1u, out, BS, &got) == -EIO);
+  assert(kafs_lz_decompress(packed, len, out, BS - 1u, &got) == -EIO);
+  const uint8_t bad_off[] = {0x10, 'a', 0x05, 0x00};
+  assert(kafs_lz_decompress(bad_off, sizeof(bad_off), out, BS, &got) == -EIO);
+  const uint8_t long_lit[] = {0xF0, 0xFF, 0xFF};
+  assert(kafs_lz_decompress(long_lit, sizeof(long_lit), out, BS, &got) == -EIO);
+
+  // Reference encoding never collides with pending refs.
+  kafs_blkcnt_t ref = kafs_cblk_ref_make(KAFS_CBLK_REF_BLO_LIMIT - 1u, 15u);
+  assert(kafs_cblk_ref_is(ref) && ((uint32_t)ref & 0x80000000u) == 0);
+  assert(kafs_cblk_ref_blo(ref) == KAFS_CBLK_REF_BLO_LIMIT - 1u);
+  assert(kafs_cblk_ref_slot(ref) == 15u);
+  assert(kafs_cblk_phys_blo(ref) == KAFS_CBLK_REF_BLO_LIMIT - 1u);
+  assert(!kafs_cblk_ref_is(1234u) && kafs_cblk_phys_blo(1234u) == 1234u);
+  assert(!kafs_cblk_ref_is((kafs_blkcnt_t)(0x80000000u | 7u)));
+  // Raw blocks share the block cache only under keys no compressed ref can take.
+  assert(kafs_cblk_raw_cache_key(1234u) == 1234u);
+  assert(kafs_cblk_raw_cache_key((kafs_blkcnt_t)(KAFS_CBLK_REF_FLAG | 1234u)) == 0u);
+  assert(kafs_cblk_raw_cache_key((kafs_blkcnt_t)(0x80000000u | 7u)) == 0u);
+
+  // Containers fill until slots or space run out, decode each slot and free on the last one.
+  kafs_cblk_init(blk, BS, 77u);
+  assert(kafs_cblk_valid(blk, BS) && kafs_cblk_generation(blk) == 77u);
+  uint8_t zeros[BS];
+  memset(zeros, 0, sizeof(zeros));
+  size_t zlen = kafs_lz_compress(zeros, BS, packed, cap);
+  int slot = -1;
+  for (uint32_t i = 0; i < KAFS_CBLK_SLOTS; ++i)
+  {
+    slot = kafs_cblk_append(blk, BS, packed, (uint32_t)zlen);
+    assert(slot == (int)i);
+  }
+  assert(kafs_cblk_append(blk, BS, packed, (uint32_t)zlen) == -ENOSPC);
+  for (uint32_t i = 0; i < KAFS_CBLK_SLOTS; ++i)
+  {
+    memset(out, 0xAA, sizeof(out));
+    assert(kafs_cblk_decode(blk, BS, i, out) == 0);
+    assert(memcmp(out, zeros, BS) == 0);
+  }
+  assert(kafs_cblk_slot_free(blk, BS, 3u) == (int)KAFS_CBLK_SLOTS - 1);
+  assert(kafs_cblk_slot_free(blk, BS, 3u) == -ENOENT);
+  assert(kafs_cblk_decode(blk, BS, 3u, out) == -ENOENT);
+  for (uint32_t i = 0; i < KAFS_CBLK_SLOTS; ++i)
+    if (i != 3u)
+      assert(kafs_cblk_slot_free(blk, BS, i) >= 0);
+  assert(((kafs_cblk_hdr_t *)blk)->cb_live_count == 0);
+
+  // A payload that would run past the block end is refused.
+  kafs_cblk_init(blk, BS, 78u);
+  len = kafs_lz_compress(text, BS, packed, cap);
+  while (kafs_cblk_append(blk, BS, packed, (uint32_t)len) >= 0)
+    ;
+  assert(kafs_u32_stoh(((kafs_cblk_hdr_t *)blk)->cb_tail) <= BS);
+
+  // Corrupt headers and slot tables read as -EIO.
+  kafs_cblk_init(blk, BS, 79u);
+  assert(kafs_cblk_append(blk, BS, packed, (uint32_t)len) == 0);
+  assert(kafs_cblk_decode(blk, BS, 1u, out) == -EIO);
+  ((kafs_cblk_hdr_t *)blk)->cb_slots[0].cs_len = kafs_u32_htos(BS);
+  assert(kafs_cblk_decode(blk, BS, 0u, out) == -EIO);
+  ((kafs_cblk_hdr_t *)blk)->cb_magic = kafs_u32_htos(0);
+  assert(!kafs_cblk_valid(blk, BS));
+  assert(kafs_cblk_slot_free(blk, BS, 0u) == -EIO);
+
+  printf("cblk OK\n");
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_hash.h"
+#include "kafs_cblk.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define THREADS 4u
+#define PER_THREAD 48u
+
+typedef struct
+{
+  kafs_context_t *ctx;
+  uint32_t id;
+  kafs_hrid_t hrid[PER_THREAD];
+  kafs_blkcnt_t ref[PER_THREAD];
+} worker_t;
+
+// Distinct (so dedup keeps them apart) but compressible block contents.
+static void fill(char *p, kafs_blksize_t bs, uint32_t id, uint32_t i)
+{
+  memset(p, 'a' + (int)(i % 26u), bs);
+  snprintf(p, 32, "t%u-b%u", (unsigned)id, (unsigned)i);
+}
+
+static void *store_worker(void *arg)
+{
+  worker_t *w = (worker_t *)arg;
+  kafs_blksize_t bs = kafs_sb_blksize_get(w->ctx->c_superblock);
+  char *buf = malloc(bs);
+  assert(buf);
+  for (uint32_t i = 0; i < PER_THREAD; ++i)
+  {
+    int is_new = 0;
+    fill(buf, bs, w->id, i);
+    assert(kafs_hrl_put(w->ctx, buf, &w->hrid[i], &is_new, &w->ref[i]) == 0 && is_new);
+    assert(kafs_cblk_ref_is(w->ref[i]));
+  }
+  free(buf);
+  return NULL;
+}
+
+static void *release_worker(void *arg)
+{
+  worker_t *w = (worker_t *)arg;
+  for (uint32_t i = 0; i < PER_THREAD; ++i)
+    assert(kafs_hrl_dec_ref(w->ctx, w->hrid[i]) == 0);
+  return NULL;
+}
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("cblk_store") != 0)
+    return 77;
+
+  const char *img = "./cblk_store.img";
+  kafs_context_t ctx;
+  off_t mapsize = 0;
+  assert(kafs_test_mkimg_with_hrl(img, 64 * 1024 * 1024u, 12, 64, &ctx, &mapsize) == 0);
+  assert(kafs_hrl_open(&ctx) == 0);
+  ctx.c_cblk_enabled = 1;
+
+  kafs_blksize_t bs = kafs_sb_blksize_get(ctx.c_superblock);
+  kafs_blkcnt_t free0 = kafs_sb_blkcnt_free_get(ctx.c_superblock);
+  char *buf = malloc(bs);
+  char *out = malloc(bs);
+  assert(buf && out);
+
+  // One thread appends to one open container without reading it back.
+  kafs_hrid_t h1, h2;
+  kafs_blkcnt_t r1, r2;
+  int is_new = 0;
+  fill(buf, bs, 99u, 1u);
+  assert(kafs_hrl_put(&ctx, buf, &h1, &is_new, &r1) == 0 && kafs_cblk_ref_is(r1));
+  fill(buf, bs, 99u, 2u);
+  assert(kafs_hrl_put(&ctx, buf, &h2, &is_new, &r2) == 0 && kafs_cblk_ref_is(r2));
+  assert(kafs_cblk_ref_blo(r1) == kafs_cblk_ref_blo(r2));
+  assert(ctx.c_stat_cblk_containers == 1u);
+  assert(kafs_cblk_read(&ctx, r2, out) == 0 && memcmp(out, buf, bs) == 0);
+
+  // Freeing a slot of the open container updates the in-memory copy: the next append keeps it free.
+  assert(kafs_hrl_dec_ref(&ctx, h1) == 0);
+  kafs_hrid_t h3;
+  kafs_blkcnt_t r3;
+  fill(buf, bs, 99u, 3u);
+  assert(kafs_hrl_put(&ctx, buf, &h3, &is_new, &r3) == 0);
+  assert(kafs_cblk_ref_blo(r3) == kafs_cblk_ref_blo(r1) && r3 != r1);
+  assert(kafs_cblk_read(&ctx, r1, out) == -EIO);
+  assert(kafs_hrl_dec_ref(&ctx, h2) == 0);
+  assert(kafs_hrl_dec_ref(&ctx, h3) == 0);
+  assert(ctx.c_stat_cblk_containers_freed == 1u);
+
+  // Threads store through their own open containers; every block reads back, and releasing
+  // everything from other threads frees every container.
+  worker_t w[THREADS];
+  pthread_t th[THREADS];
+  for (uint32_t t = 0; t < THREADS; ++t)
+  {
+    w[t].ctx = &ctx;
+    w[t].id = t;
+    assert(pthread_create(&th[t], NULL, store_worker, &w[t]) == 0);
+  }
+  for (uint32_t t = 0; t < THREADS; ++t)
+    assert(pthread_join(th[t], NULL) == 0);
+  for (uint32_t t = 0; t < THREADS; ++t)
+  {
+    for (uint32_t i = 0; i < PER_THREAD; ++i)
+    {
+      fill(buf, bs, t, i);
+      assert(kafs_cblk_read(&ctx, w[t].ref[i], out) == 0 && memcmp(out, buf, bs) == 0);
+    }
+  }
+  for (uint32_t t = 0; t < THREADS; ++t)
+    assert(pthread_create(&th[t], NULL, release_worker, &w[(t + 1u) % THREADS]) == 0);
+  for (uint32_t t = 0; t < THREADS; ++t)
+    assert(pthread_join(th[t], NULL) == 0);
+  assert(ctx.c_stat_cblk_containers_freed == ctx.c_stat_cblk_containers);
+  assert(kafs_sb_blkcnt_free_get(ctx.c_superblock) == free0);
+
+  free(buf);
+  free(out);
+  (void)kafs_hrl_close(&ctx);
+  munmap(ctx.c_superblock, (size_t)mapsize);
+  close(ctx.c_fd);
+  unlink(img);
+  printf("cblk_store OK\n");
+  return 0;
+}
@@ -0,0 +1,339 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_core.h"
+#include "kafs_inode.h"
+#include "kafs_rpc.h"
+#include "kafs_sparse.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static uint8_t g_resp[KAFS_RPC_MAX_PAYLOAD];
+
+static int run_cmd(char *const argv[])
+{
+  pid_t p = fork();
+  if (p < 0)
+    return -errno;
+  if (p == 0)
+  {
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+  int st = 0;
+  if (waitpid(p, &st, 0) < 0)
+    return -errno;
+  return (WIFEXITED(st) && WEXITSTATUS(st) == 0) ? 0 : -1;
+}
+
+static void req_init(kafs_rpc_ns_req_t *req)
+{
+  memset(req, 0, sizeof(*req));
+  req->uid = (uint32_t)getuid();
+  req->gid = (uint32_t)getgid();
+  req->pid = (uint32_t)getpid();
+}
+
+// Encodes one namespace request the way the front does and runs it as kafs-back would.
+static int ns_cap(kafs_context_t *ctx, uint16_t op, kafs_rpc_ns_req_t *req, const char *path,
+                  const char *path2, uint32_t resp_cap, uint32_t *resp_len)
+{
+  static uint8_t buf[sizeof(kafs_rpc_ns_req_t) + 2u * KAFS_RPC_NS_PATH_MAX];
+  int len = kafs_rpc_ns_encode(buf, sizeof(buf), req, NULL, 0, path, path2);
+  assert(len > 0);
+  uint32_t dummy;
+  return kafs_core_ns_exec(ctx, op, buf, (uint32_t)len, g_resp, resp_cap,
+                           resp_len ? resp_len : &dummy);
+}
+
+static int ns(kafs_context_t *ctx, uint16_t op, kafs_rpc_ns_req_t *req, const char *path,
+              const char *path2, uint32_t *resp_len)
+{
+  return ns_cap(ctx, op, req, path, path2, sizeof(g_resp), resp_len);
+}
+
+static int ns_lookup(kafs_context_t *ctx, const char *path, kafs_rpc_attr_t *a)
+{
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  uint32_t len = 0;
+  int rc = ns(ctx, KAFS_RPC_OP_LOOKUP, &req, path, NULL, &len);
+  if (rc == 0)
+  {
+    assert(len == sizeof(*a));
+    memcpy(a, g_resp, sizeof(*a));
+  }
+  return rc;
+}
+
+static uint32_t ns_create_open(kafs_context_t *ctx, const char *path, uint32_t mode)
+{
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  req.flags = KAFS_RPC_NS_F_OPEN;
+  req.mode = S_IFREG | mode;
+  req.op_flags = O_RDWR;
+  uint32_t len = 0;
+  assert(ns(ctx, KAFS_RPC_OP_CREATE, &req, path, NULL, &len) == 0);
+  assert(len == sizeof(kafs_rpc_attr_t));
+  kafs_rpc_attr_t a;
+  memcpy(&a, g_resp, sizeof(a));
+  assert(S_ISREG(a.mode) && a.ino > KAFS_INO_ROOTDIR);
+  return a.ino;
+}
+
+static int ns_release(kafs_context_t *ctx, uint32_t ino)
+{
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  req.flags = KAFS_RPC_NS_F_FH;
+  req.ino = ino;
+  req.op_flags = O_RDWR;
+  return ns(ctx, KAFS_RPC_OP_RELEASE, &req, NULL, NULL, NULL);
+}
+
+static int inode_in_use(kafs_context_t *ctx, uint32_t ino)
+{
+  return kafs_ino_get_usage(kafs_ctx_inode(ctx, ino)) != 0;
+}
+
+static void test_lookup_create(kafs_context_t *ctx)
+{
+  kafs_rpc_attr_t a;
+  assert(ns_lookup(ctx, "/", &a) == 0);
+  assert(a.ino == KAFS_INO_ROOTDIR && S_ISDIR(a.mode));
+  assert(ns_lookup(ctx, "/missing", &a) == -ENOENT);
+
+  // CREATE with KAFS_RPC_NS_F_OPEN opens a handle the back counts, and answers with attributes.
+  uint32_t ino = ns_create_open(ctx, "/f", 0640);
+  assert(kafs_sparse_u32_get(ctx->c_open_cnt, ino) == 1u);
+  assert(ns_lookup(ctx, "/f", &a) == 0);
+  assert(a.ino == ino && (a.mode & 07777) == 0640 && a.uid == (uint32_t)getuid());
+  assert(ns_release(ctx, ino) == 0);
+  assert(kafs_sparse_u32_get(ctx->c_open_cnt, ino) == 0);
+
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  req.op_flags = O_RDONLY;
+  uint32_t len = 0;
+  assert(ns(ctx, KAFS_RPC_OP_OPEN, &req, "/f", NULL, &len) == 0);
+  assert(len == sizeof(a));
+  memcpy(&a, g_resp, sizeof(a));
+  assert(a.ino == ino && kafs_sparse_u32_get(ctx->c_open_cnt, ino) == 1u);
+  assert(ns_release(ctx, ino) == 0);
+
+  // Paths must be absolute, and path ops need one.
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_LOOKUP, &req, "f", NULL, NULL) == -EINVAL);
+  assert(ns(ctx, KAFS_RPC_OP_UNLINK, &req, NULL, NULL, NULL) == -EINVAL);
+
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_UNLINK, &req, "/f", NULL, NULL) == 0);
+}
+
+// A response buffer that holds only a few entries makes the back page the directory.
+static void test_readdir_paging(kafs_context_t *ctx)
+{
+  enum
+  {
+    NFILES = 40
+  };
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  req.mode = 0755;
+  assert(ns(ctx, KAFS_RPC_OP_MKDIR, &req, "/d", NULL, NULL) == 0);
+  for (int i = 0; i < NFILES; ++i)
+  {
+    char path[32];
+    snprintf(path, sizeof(path), "/d/e%02d", i);
+    req_init(&req);
+    req.mode = S_IFREG | 0644;
+    assert(ns(ctx, KAFS_RPC_OP_CREATE, &req, path, NULL, NULL) == 0);
+  }
+
+  int seen[NFILES];
+  memset(seen, 0, sizeof(seen));
+  uint32_t cap = (uint32_t)sizeof(kafs_rpc_readdir_resp_t);
+  cap += 4u * (uint32_t)(sizeof(kafs_rpc_dirent_t) + 3u); // four "eNN" entries
+  uint64_t next = 0;
+  int chunks = 0;
+  for (;;)
+  {
+    req_init(&req);
+    req.arg = next;
+    uint32_t len = 0;
+    assert(ns_cap(ctx, KAFS_RPC_OP_READDIR, &req, "/d", NULL, cap, &len) == 0);
+    kafs_rpc_readdir_resp_t hdr;
+    assert(len >= sizeof(hdr) && len <= cap);
+    memcpy(&hdr, g_resp, sizeof(hdr));
+    ++chunks;
+    uint32_t off = sizeof(hdr);
+    for (uint32_t k = 0; k < hdr.count; ++k)
+    {
+      kafs_rpc_dirent_t d;
+      memcpy(&d, g_resp + off, sizeof(d));
+      off += sizeof(d);
+      char name[16] = {0};
+      assert(d.name_len < sizeof(name));
+      memcpy(name, g_resp + off, d.name_len);
+      off += d.name_len;
+      int idx;
+      if (sscanf(name, "e%d", &idx) == 1)
+      {
+        assert(idx >= 0 && idx < NFILES && S_ISREG(d.mode));
+        seen[idx]++;
+      }
+    }
+    assert(off == len);
+    if (hdr.eof)
+      break;
+    assert(hdr.count > 0 && hdr.next > next);
+    next = hdr.next;
+  }
+  assert(chunks > NFILES / 4);
+  for (int i = 0; i < NFILES; ++i)
+    assert(seen[i] == 1);
+
+  // A buffer too small for even the header is refused.
+  req_init(&req);
+  assert(ns_cap(ctx, KAFS_RPC_OP_READDIR, &req, "/d", NULL, sizeof(kafs_rpc_readdir_resp_t) - 1u,
+                NULL) == -EMSGSIZE);
+}
+
+static void test_rename(kafs_context_t *ctx)
+{
+  uint32_t a_ino = ns_create_open(ctx, "/ra", 0644);
+  assert(ns_release(ctx, a_ino) == 0);
+  uint32_t b_ino = ns_create_open(ctx, "/rb", 0644);
+  assert(ns_release(ctx, b_ino) == 0);
+
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_RENAME, &req, "/ra", "/rc", NULL) == 0);
+  kafs_rpc_attr_t a;
+  assert(ns_lookup(ctx, "/ra", &a) == -ENOENT);
+  assert(ns_lookup(ctx, "/rc", &a) == 0 && a.ino == a_ino);
+
+  // Renaming over a closed file reclaims the replaced inode right away.
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_RENAME, &req, "/rc", "/rb", NULL) == 0);
+  assert(ns_lookup(ctx, "/rb", &a) == 0 && a.ino == a_ino);
+  assert(!inode_in_use(ctx, b_ino));
+
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_RENAME, &req, "/rb", NULL, NULL) == -EINVAL);
+  assert(ns(ctx, KAFS_RPC_OP_UNLINK, &req, "/rb", NULL, NULL) == 0);
+}
+
+// A release the back has no count for (opened before it took over, or repeated after a
+// reconnect) must not wrap the open count.
+static void test_release_without_count(kafs_context_t *ctx)
+{
+  uint32_t ino = ns_create_open(ctx, "/r0", 0644);
+  assert(ns_release(ctx, ino) == 0);
+  assert(kafs_sparse_u32_get(ctx->c_open_cnt, ino) == 0);
+  assert(ns_release(ctx, ino) == 0);
+  assert(kafs_sparse_u32_get(ctx->c_open_cnt, ino) == 0);
+  assert(inode_in_use(ctx, ino));
+
+  // No handle at all is just as harmless.
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  req.ino = ino;
+  assert(ns(ctx, KAFS_RPC_OP_RELEASE, &req, "/r0", NULL, NULL) == 0);
+  assert(kafs_sparse_u32_get(ctx->c_open_cnt, ino) == 0);
+
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_UNLINK, &req, "/r0", NULL, NULL) == 0);
+  assert(!inode_in_use(ctx, ino));
+}
+
+// The caller's uid/gid from the request, not the back's own, decide permissions.
+static void test_credentials(kafs_context_t *ctx)
+{
+  const uint32_t other = (uint32_t)getuid() + 4242u;
+  uint32_t ino = ns_create_open(ctx, "/priv", 0600);
+  assert(ns_release(ctx, ino) == 0);
+
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  req.uid = other;
+  req.gid = other;
+  req.op_flags = O_RDONLY;
+  assert(ns(ctx, KAFS_RPC_OP_OPEN, &req, "/priv", NULL, NULL) == -EACCES);
+  assert(kafs_sparse_u32_get(ctx->c_open_cnt, ino) == 0);
+
+  req_init(&req);
+  req.mode = 0755;
+  assert(ns(ctx, KAFS_RPC_OP_MKDIR, &req, "/mine", NULL, NULL) == 0);
+  req_init(&req);
+  req.uid = other;
+  req.gid = other;
+  req.mode = S_IFREG | 0644;
+  assert(ns(ctx, KAFS_RPC_OP_CREATE, &req, "/mine/x", NULL, NULL) == -EACCES);
+  req.mode = 0;
+  assert(ns(ctx, KAFS_RPC_OP_UNLINK, &req, "/priv", NULL, NULL) == -EACCES);
+  kafs_rpc_attr_t a;
+  assert(ns_lookup(ctx, "/mine/x", &a) == -ENOENT);
+
+  // The owner may.
+  req_init(&req);
+  req.op_flags = O_RDONLY;
+  assert(ns(ctx, KAFS_RPC_OP_OPEN, &req, "/priv", NULL, NULL) == 0);
+  assert(ns_release(ctx, ino) == 0);
+}
+
+// kafs-back has no reclaim queue: a tombstone it makes must not wait for a GC that never runs.
+static void test_unlink_reclaims(kafs_context_t *ctx)
+{
+  uint32_t ino = ns_create_open(ctx, "/gone", 0644);
+  assert(ns_release(ctx, ino) == 0);
+  kafs_rpc_ns_req_t req;
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_UNLINK, &req, "/gone", NULL, NULL) == 0);
+  assert(!inode_in_use(ctx, ino));
+
+  // Still open: the last release reclaims it.
+  ino = ns_create_open(ctx, "/held", 0644);
+  req_init(&req);
+  assert(ns(ctx, KAFS_RPC_OP_UNLINK, &req, "/held", NULL, NULL) == 0);
+  assert(inode_in_use(ctx, ino));
+  assert(ns_release(ctx, ino) == 0);
+  assert(!inode_in_use(ctx, ino));
+}
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("core_ns") != 0)
+    return 77;
+  const char *img = "./core_ns.img";
+  char *mkfs_args[] = {(char *)kafs_test_mkfs_bin(), (char *)img, "-s", "64M", NULL};
+  if (run_cmd(mkfs_args) != 0)
+  {
+    fprintf(stderr, "mkfs failed\n");
+    return 77;
+  }
+  kafs_context_t ctx;
+  assert(kafs_core_open_image(img, &ctx) == 0);
+  assert(ctx.c_reclaimq == NULL);
+
+  test_lookup_create(&ctx);
+  test_readdir_paging(&ctx);
+  test_rename(&ctx);
+  test_unlink_reclaims(&ctx);
+  test_release_without_count(&ctx);
+  test_credentials(&ctx);
+
+  kafs_core_close_image(&ctx);
+  unlink(img);
+  printf("core_ns OK\n");
+  return 0;
+}
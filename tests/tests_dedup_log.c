@@ -0,0 +1,56 @@
+#include "kafs_dedup_log.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+int main(void)
+{
+  assert(kafs_dedup_log_create(1) == NULL);
+  assert(kafs_dedup_log_note(NULL, 1, 2, 3) == -EINVAL);
+  assert(kafs_dedup_log_pending(NULL, NULL) == 0);
+  assert(kafs_dedup_log_take_lost(NULL) == 0);
+
+  // Capacity rounds up to a power of two.
+  kafs_dedup_log_t *l = kafs_dedup_log_create(5);
+  assert(l != NULL);
+  assert(l->dl_mask + 1u == 8u);
+
+  kafs_dedup_log_ent_t out[16];
+  assert(kafs_dedup_log_take(l, out, 16) == 0);
+
+  // Entries come back oldest first, across the ring boundary.
+  for (uint32_t round = 0; round < 3; ++round)
+  {
+    for (uint32_t i = 0; i < 6; ++i)
+      assert(kafs_dedup_log_note(l, 10u + i, i, 100u + i) == 0);
+    int lost = 1;
+    assert(kafs_dedup_log_pending(l, &lost) == 6 && lost == 0);
+    assert(kafs_dedup_log_take(l, out, 4) == 4);
+    assert(out[0].dl_ino == 10 && out[0].dl_iblk == 0 && out[0].dl_blo == 100);
+    assert(out[3].dl_ino == 13 && out[3].dl_blo == 103);
+    assert(kafs_dedup_log_take(l, out, 16) == 2);
+    assert(out[0].dl_ino == 14 && out[1].dl_ino == 15 && out[1].dl_blo == 105);
+  }
+
+  // A full log drops new entries and remembers it until the consumer takes the flag.
+  for (uint32_t i = 0; i < 8; ++i)
+    assert(kafs_dedup_log_note(l, 1, i, 200u + i) == 0);
+  assert(kafs_dedup_log_note(l, 1, 8, 208) == -ENOSPC);
+  assert(kafs_dedup_log_note(l, 1, 9, 209) == -ENOSPC);
+  int lost = 0;
+  assert(kafs_dedup_log_pending(l, &lost) == 8 && lost == 1);
+  uint64_t noted = 0, dropped = 0;
+  kafs_dedup_log_counters(l, &noted, &dropped);
+  assert(noted == 26 && dropped == 2);
+  assert(kafs_dedup_log_take_lost(l) == 1);
+  assert(kafs_dedup_log_take_lost(l) == 0);
+  assert(kafs_dedup_log_take(l, out, 16) == 8);
+  assert(out[7].dl_iblk == 7 && out[7].dl_blo == 207);
+  assert(kafs_dedup_log_note(l, 1, 8, 208) == 0);
+  assert(kafs_dedup_log_pending(l, &lost) == 1 && lost == 0);
+
+  kafs_dedup_log_destroy(l);
+  printf("dedup_log OK\n");
+  return 0;
+}
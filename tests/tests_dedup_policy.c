@@ -0,0 +1,65 @@
+#include "kafs_dedup_policy.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SAMPLE 8u
+#define HIT_PCT 25u
+
+static int route(uint32_t *st, int *probe) { return kafs_dedup_policy_route(st, SAMPLE, probe); }
+
+static int note(uint32_t *st, int hit) { return kafs_dedup_policy_note(st, SAMPLE, HIT_PCT, hit); }
+
+int main(void)
+{
+  uint32_t st = 0;
+  int probe = 1;
+
+  // Disabled policy and missing state never bypass or count.
+  assert(kafs_dedup_policy_route(NULL, SAMPLE, &probe) == 0 && probe == 0);
+  assert(kafs_dedup_policy_route(&st, 0, NULL) == 0);
+  assert(kafs_dedup_policy_note(&st, 0, HIT_PCT, 0) == KAFS_DEDUP_POLICY_NOTE_NONE);
+  assert(st == 0);
+
+  // A window with enough hits keeps the inode on HRL and starts the next window.
+  for (uint32_t i = 0; i + 1u < SAMPLE; ++i)
+  {
+    assert(route(&st, &probe) == 0 && probe == 0);
+    assert(note(&st, i < 2u) == KAFS_DEDUP_POLICY_NOTE_NONE);
+  }
+  assert(kafs_dedup_policy_cnt(st) == SAMPLE - 1u && kafs_dedup_policy_hits(st) == 2u);
+  assert(note(&st, 0) == KAFS_DEDUP_POLICY_NOTE_KEEP);
+  assert(kafs_dedup_policy_mode(st) == KAFS_DEDUP_POLICY_DEDUP);
+  assert(kafs_dedup_policy_cnt(st) == 0 && kafs_dedup_policy_hits(st) == 0);
+
+  // A window below the threshold (1/8 < 25%) switches to bypass.
+  assert(note(&st, 1) == KAFS_DEDUP_POLICY_NOTE_NONE);
+  for (uint32_t i = 1; i + 1u < SAMPLE; ++i)
+    assert(note(&st, 0) == KAFS_DEDUP_POLICY_NOTE_NONE);
+  assert(note(&st, 0) == KAFS_DEDUP_POLICY_NOTE_ENTER);
+  assert(kafs_dedup_policy_mode(st) == KAFS_DEDUP_POLICY_BYPASS);
+
+  // Bypassed writes go direct; every PROBE_EVERY-th goes through HRL.
+  for (uint32_t i = 0; i + 1u < KAFS_DEDUP_POLICY_PROBE_EVERY; ++i)
+    assert(route(&st, &probe) == 1 && probe == 0);
+  assert(route(&st, &probe) == 0 && probe == 1);
+  assert(route(&st, &probe) == 1 && probe == 0);
+
+  // Misses while bypassing change nothing; a hit restarts sampling.
+  uint32_t before = st;
+  assert(note(&st, 0) == KAFS_DEDUP_POLICY_NOTE_NONE && st == before);
+  assert(note(&st, 1) == KAFS_DEDUP_POLICY_NOTE_LEAVE);
+  assert(st == kafs_dedup_policy_pack(KAFS_DEDUP_POLICY_SAMPLING, 0, 0));
+  assert(route(&st, &probe) == 0 && probe == 0);
+
+  // A sample size above the field width is clamped rather than never deciding.
+  st = 0;
+  int last = KAFS_DEDUP_POLICY_NOTE_NONE;
+  for (uint32_t i = 0; i < KAFS_DEDUP_POLICY_SAMPLE_MAX; ++i)
+    last = kafs_dedup_policy_note(&st, 100000u, HIT_PCT, 0);
+  assert(last == KAFS_DEDUP_POLICY_NOTE_ENTER);
+
+  printf("dedup_policy OK\n");
+  return 0;
+}
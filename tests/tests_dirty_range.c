@@ -0,0 +1,112 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_dirty.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+static kafs_dirty_slot_t *slot_of(kafs_context_t *ctx, uint32_t ino)
+{
+  return &((kafs_dirty_table_t *)ctx->c_dirty_tbl)->dt_slots[ino % KAFS_DIRTY_SLOTS];
+}
+
+static uint32_t orphan_count(kafs_context_t *ctx)
+{
+  return ((kafs_dirty_table_t *)ctx->c_dirty_tbl)->dt_orphan_count;
+}
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("dirty_range") != 0)
+    return 77;
+
+  const char *img = "./dirty_range.img";
+  kafs_context_t ctx;
+  off_t mapsize;
+  assert(kafs_test_mkimg_no_hrl(img, 32 * 1024 * 1024u, 12, 1024, &ctx, &mapsize) == 0);
+
+  // Map the whole image the way the mount does; data blocks follow the metadata prefix.
+  struct stat st;
+  assert(fstat(ctx.c_fd, &st) == 0);
+  ctx.c_img_base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx.c_fd, 0);
+  assert(ctx.c_img_base != MAP_FAILED);
+  ctx.c_img_size = (size_t)st.st_size;
+  ctx.c_mapsize = (size_t)mapsize;
+  kafs_blkcnt_t fdb = kafs_sb_first_data_block_get(ctx.c_superblock);
+
+  ctx.c_fsync_ranged = 1;
+  assert(kafs_dirty_init(&ctx) == 0);
+  assert(kafs_dirty_enabled(&ctx));
+
+  // Writes from before tracking started are unknown: the first sync asks for a full one.
+  kafs_dirty_note(&ctx, 5, fdb);
+  assert(kafs_dirty_sync(&ctx, 5) == 1);
+  assert(ctx.c_stat_fsync_full == 1 && ctx.c_stat_fsync_ranged == 0);
+
+  // Sequential and out-of-order notes coalesce into one extent.
+  const uint32_t ino = 5;
+  const uint32_t other = 6;
+  kafs_dirty_note(&ctx, ino, fdb + 10);
+  kafs_dirty_note(&ctx, ino, fdb + 12);
+  kafs_dirty_note(&ctx, ino, fdb + 11);
+  kafs_dirty_note(&ctx, ino, fdb + 11);
+  assert(slot_of(&ctx, ino)->ds_count == 1);
+  assert(slot_of(&ctx, ino)->ds_ext[0].de_blo == fdb + 10);
+  assert(slot_of(&ctx, ino)->ds_ext[0].de_cnt == 3);
+  kafs_dirty_note(&ctx, other, fdb + 40);
+  kafs_dirty_note(&ctx, KAFS_INO_NONE, fdb + 50);
+  assert(orphan_count(&ctx) == 1);
+
+  // fsync(ino) takes its own extents and the orphans, and leaves other inodes alone.
+  kafs_ctx_meta_write_count(&ctx, KAFS_META_REGION_INODE_TABLE, 64);
+  assert(ctx.c_dirty_meta_mask & (1u << KAFS_META_REGION_INODE_TABLE));
+  assert(kafs_dirty_sync(&ctx, ino) == 0);
+  assert(ctx.c_stat_fsync_ranged == 1);
+  assert(ctx.c_stat_fsync_ranged_bytes >= 4u * 1024u + (uint64_t)mapsize);
+  assert(slot_of(&ctx, ino)->ds_ino == KAFS_INO_NONE);
+  assert(slot_of(&ctx, other)->ds_ino == other && slot_of(&ctx, other)->ds_count == 1);
+  assert(orphan_count(&ctx) == 0);
+  assert(ctx.c_dirty_meta_mask == 0);
+
+  // A colliding inode spills the previous owner's extents into the orphan list.
+  kafs_dirty_note(&ctx, other + KAFS_DIRTY_SLOTS, fdb + 60);
+  assert(slot_of(&ctx, other)->ds_ino == other + KAFS_DIRTY_SLOTS);
+  assert(orphan_count(&ctx) == 1);
+
+  // A fragmented writer spills its slot too, and the orphan list eventually overflows.
+  for (uint32_t i = 0; i < KAFS_DIRTY_SLOT_EXTENTS + 1u; ++i)
+    kafs_dirty_note(&ctx, ino, fdb + 100 + 2 * i);
+  assert(slot_of(&ctx, ino)->ds_count == 1);
+  assert(orphan_count(&ctx) == 1 + KAFS_DIRTY_SLOT_EXTENTS);
+  for (uint32_t i = 0; i < KAFS_DIRTY_ORPHAN_EXTENTS; ++i)
+    kafs_dirty_note(&ctx, KAFS_INO_NONE, fdb + 200 + 2 * i);
+  assert(ctx.c_dirty_full == 1);
+  assert(ctx.c_stat_dirty_overflows == 1);
+  kafs_dirty_note(&ctx, ino, fdb + 1000);
+  assert(kafs_dirty_sync(&ctx, other) == 1);
+  assert(ctx.c_stat_fsync_full == 2);
+  assert(orphan_count(&ctx) == 0 && slot_of(&ctx, ino)->ds_ino == KAFS_INO_NONE);
+
+  // Back to ranged syncs once the full one has been handed out.
+  kafs_dirty_note(&ctx, ino, fdb + 3);
+  assert(kafs_dirty_sync(&ctx, ino) == 0);
+  assert(ctx.c_stat_fsync_ranged == 2);
+
+  kafs_dirty_destroy(&ctx);
+  assert(!kafs_dirty_enabled(&ctx));
+  kafs_dirty_note(&ctx, ino, fdb + 3);
+
+  munmap(ctx.c_img_base, ctx.c_img_size);
+  munmap(ctx.c_superblock, mapsize);
+  close(ctx.c_fd);
+  unlink(img);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#define KAFS_NO_MAIN
+#include "kafs.c"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define NCALLS 8
+
+static kafs_context_t g_ctx;
+static int g_back_fd = -1;
+
+typedef struct
+{
+  uint32_t ino;
+  int rc;
+  int32_t result;
+  uint64_t size;
+} call_arg_t;
+
+static void *caller(void *p)
+{
+  call_arg_t *a = (call_arg_t *)p;
+  kafs_rpc_truncate_req_t req = {a->ino, 0, 0};
+  kafs_rpc_resp_hdr_t hdr = {0};
+  kafs_rpc_truncate_resp_t resp = {0};
+  uint32_t len = 0;
+  a->rc = kafs_hotplug_rpc_call(&g_ctx, KAFS_RPC_OP_TRUNCATE, &req, sizeof(req), &hdr, &resp,
+                                sizeof(resp), &len);
+  a->result = hdr.result;
+  a->size = resp.size;
+  return NULL;
+}
+
+// Fake back: collect n requests, then answer them in reverse order (plus one stray response),
+// or just hang up when answer == 0.
+static void *fake_back(void *p)
+{
+  int answer = *(int *)p;
+  uint64_t ids[NCALLS];
+  uint32_t inos[NCALLS];
+  for (int i = 0; i < NCALLS; ++i)
+  {
+    kafs_rpc_hdr_t hdr;
+    kafs_rpc_truncate_req_t req;
+    uint32_t len = 0;
+    assert(kafs_rpc_recv_msg(g_back_fd, &hdr, &req, sizeof(req), &len) == 0);
+    assert(hdr.op == KAFS_RPC_OP_TRUNCATE && len == sizeof(req));
+    ids[i] = hdr.req_id;
+    inos[i] = req.ino;
+  }
+  if (!answer)
+  {
+    shutdown(g_back_fd, SHUT_RDWR);
+    return NULL;
+  }
+  kafs_rpc_truncate_resp_t stray = {1};
+  assert(kafs_rpc_send_resp(g_back_fd, UINT64_MAX, 0, &stray, sizeof(stray)) == 0);
+  for (int i = NCALLS - 1; i >= 0; --i)
+  {
+    kafs_rpc_truncate_resp_t resp = {(uint64_t)inos[i] * 1000u};
+    assert(kafs_rpc_send_resp(g_back_fd, ids[i], 0, &resp, sizeof(resp)) == 0);
+  }
+  return NULL;
+}
+
+static void run_round(int answer, call_arg_t *args)
+{
+  pthread_t back, th[NCALLS];
+  assert(pthread_create(&back, NULL, fake_back, &answer) == 0);
+  for (int i = 0; i < NCALLS; ++i)
+  {
+    memset(&args[i], 0, sizeof(args[i]));
+    args[i].ino = (uint32_t)i + 1u;
+    assert(pthread_create(&th[i], NULL, caller, &args[i]) == 0);
+  }
+  for (int i = 0; i < NCALLS; ++i)
+    pthread_join(th[i], NULL);
+  pthread_join(back, NULL);
+}
+
+int main(void)
+{
+  int sv[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  memset(&g_ctx, 0, sizeof(g_ctx));
+  g_back_fd = sv[1];
+  kafs_hotplug_finish_handshake(&g_ctx, sv[0], 1u, 0u);
+  assert(g_ctx.c_hotplug_mux_init);
+
+  // The back answers only after all requests arrived, so every call must be in flight at once.
+  call_arg_t args[NCALLS];
+  run_round(1, args);
+  for (int i = 0; i < NCALLS; ++i)
+  {
+    assert(args[i].rc == 0 && args[i].result == 0);
+    assert(args[i].size == (uint64_t)args[i].ino * 1000u);
+  }
+  assert(g_ctx.c_hotplug_inflight == 0 && g_ctx.c_hotplug_inflight_max == NCALLS);
+  assert(g_ctx.c_stat_hotplug_rpc_calls == NCALLS);
+  assert(g_ctx.c_stat_hotplug_rpc_orphans == 1u);
+  assert(g_ctx.c_stat_hotplug_rpc_handoffs >= 1u);
+  assert(g_ctx.c_hotplug_calls == NULL);
+
+  // Hang-up fails every outstanding call instead of leaving waiters behind.
+  run_round(0, args);
+  for (int i = 0; i < NCALLS; ++i)
+    assert(args[i].rc != 0);
+  assert(g_ctx.c_hotplug_inflight == 0 && g_ctx.c_hotplug_calls == NULL);
+
+  close(sv[0]);
+  close(sv[1]);
+  printf("hotplug_mux OK\n");
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -45,9 +46,13 @@ static int test_resp_too_large(void)
   int fds[2];
   if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
     return -errno;
-  char big[KAFS_RPC_MAX_PAYLOAD + 1];
-  memset(big, 'x', sizeof(big));
-  int rc = kafs_rpc_send_resp(fds[0], 1u, 0, big, (uint32_t)sizeof(big));
+  uint32_t len = KAFS_RPC_MAX_PAYLOAD_LARGE + 1u;
+  char *big = (char *)malloc(len);
+  if (!big)
+    return -ENOMEM;
+  memset(big, 'x', len);
+  int rc = kafs_rpc_send_resp(fds[0], 1u, 0, big, len);
+  free(big);
   close(fds[0]);
   close(fds[1]);
   return rc == -EMSGSIZE ? 0 : -EINVAL;
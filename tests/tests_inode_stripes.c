@@ -0,0 +1,108 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_locks.h"
+#include "kafs_sparse.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum
+{
+  STRIPE_THREADS = 4,
+  STRIPE_ROUNDS = 20000,
+};
+
+static kafs_context_t g_ctx;
+static uint32_t g_shared[3];
+static uint64_t g_counter;
+
+// Threads take the same inodes in opposite argument orders; two of them share a stripe.
+static void *pair_main(void *arg)
+{
+  uintptr_t id = (uintptr_t)arg;
+  for (int i = 0; i < STRIPE_ROUNDS; ++i)
+  {
+    uint32_t a = g_shared[(id + (uintptr_t)i) % 3u];
+    uint32_t b = g_shared[(id + (uintptr_t)i + 1u) % 3u];
+    kafs_inode_lock_pair(&g_ctx, b, a);
+    ++g_counter;
+    kafs_inode_unlock_pair(&g_ctx, b, a);
+  }
+  return NULL;
+}
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("inode_stripes") != 0)
+    return 77;
+
+  const char *img = "./inode_stripes.img";
+  off_t mapsize;
+  assert(kafs_test_mkimg_no_hrl(img, 32 * 1024 * 1024u, 12, 20000, &g_ctx, &mapsize) == 0);
+  uint32_t inocnt = (uint32_t)kafs_sb_inocnt_get(g_ctx.c_superblock);
+  assert(kafs_ctx_locks_init(&g_ctx) == 0);
+
+  // The table is capped, so inode count no longer decides how many mutexes exist.
+  uint32_t stripes = kafs_inode_lock_stripes(&g_ctx);
+  assert(stripes == KAFS_INODE_LOCK_STRIPES_MAX && inocnt > stripes);
+  assert(kafs_inode_lock_stripe(&g_ctx, 7) == kafs_inode_lock_stripe(&g_ctx, 7 + stripes));
+
+  // Two inodes on one stripe can be held together; the second acquisition is reentrant.
+  kafs_inode_lock(&g_ctx, 7);
+  kafs_inode_lock(&g_ctx, 7 + stripes);
+  kafs_inode_unlock(&g_ctx, 7);
+  kafs_inode_unlock(&g_ctx, 7 + stripes);
+  assert(kafs_stat_sum(&g_ctx, KAFS_STAT_LOCK_INODE_REENTRANT) == 1);
+
+  // Lock order is by stripe first, so a higher inode number can come first.
+  uint32_t order[4] = {9, 3 + stripes, 3, 5};
+  kafs_inode_lock_sort(&g_ctx, order, 4);
+  assert(order[0] == 3 && order[1] == 3 + stripes && order[2] == 5 && order[3] == 9);
+
+  g_shared[0] = 11;
+  g_shared[1] = 11 + stripes;
+  g_shared[2] = 12;
+  pthread_t th[STRIPE_THREADS];
+  for (uintptr_t i = 0; i < STRIPE_THREADS; ++i)
+    assert(pthread_create(&th[i], NULL, pair_main, (void *)i) == 0);
+  for (int i = 0; i < STRIPE_THREADS; ++i)
+    pthread_join(th[i], NULL);
+  assert(g_counter == (uint64_t)STRIPE_THREADS * STRIPE_ROUNDS);
+
+  // Open counts are sparse: only the chunk around a touched inode is allocated.
+  assert(g_ctx.c_open_cnt != NULL);
+  uint64_t base = kafs_sparse_u32_bytes(g_ctx.c_open_cnt);
+  assert(kafs_sparse_u32_get(g_ctx.c_open_cnt, inocnt - 1) == 0);
+  assert(kafs_open_cnt_inc(&g_ctx, inocnt - 1) == 0);
+  assert(kafs_open_cnt_inc(&g_ctx, inocnt - 1) == 0);
+  assert(kafs_sparse_u32_get(g_ctx.c_open_cnt, inocnt - 1) == 2);
+  assert(kafs_sparse_u32_get(g_ctx.c_open_cnt, inocnt - 2) == 0);
+  assert(kafs_sparse_u32_bytes(g_ctx.c_open_cnt) ==
+         base + KAFS_SPARSE_CHUNK_ELEMS * sizeof(uint32_t));
+  assert(kafs_open_cnt_dec(&g_ctx, inocnt - 1) == 1);
+  assert(kafs_open_cnt_dec(&g_ctx, inocnt - 1) == 0);
+  assert(kafs_open_cnt_inc(&g_ctx, inocnt) == 0); // out of range: not tracked
+
+  // Epochs read as 1 until bumped.
+  kafs_sparse_u32_t *ep = kafs_sparse_u32_create(inocnt, 1u);
+  assert(ep != NULL && kafs_sparse_u32_get(ep, 42) == 1u);
+  uint32_t *slot = kafs_sparse_u32_slot(ep, 42);
+  assert(slot && ++*slot == 2u);
+  assert(kafs_sparse_u32_get(ep, 42) == 2u && kafs_sparse_u32_get(ep, 43) == 1u);
+  kafs_sparse_u32_destroy(ep);
+
+  kafs_ctx_locks_destroy(&g_ctx);
+  assert(g_ctx.c_open_cnt == NULL);
+  munmap(g_ctx.c_superblock, mapsize);
+  close(g_ctx.c_fd);
+  unlink(img);
+  printf("inode_stripes OK\n");
+  return 0;
+}
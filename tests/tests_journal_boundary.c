@@ -102,16 +102,50 @@ static int read_region_bytes(int fd, uint64_t off, void *buf, size_t len)
   return (r == (ssize_t)len) ? 0 : -EIO;
 }
 
-static int replay_count_cb(struct kafs_context *ctx, const char *op, const char *args, void *user)
+static int replay_count_cb(struct kafs_context *ctx, uint16_t op, const uint8_t *fields,
+                           size_t fields_len, void *user)
 {
   (void)ctx;
   (void)op;
-  (void)args;
+  (void)fields;
+  (void)fields_len;
   int *count = (int *)user;
   (*count)++;
   return 0;
 }
 
+struct replay_capture
+{
+  int count;
+  uint16_t op;
+  char path[64];
+  uint32_t mode;
+};
+
+static int replay_capture_cb(struct kafs_context *ctx, uint16_t op, const uint8_t *fields,
+                             size_t fields_len, void *user)
+{
+  (void)ctx;
+  struct replay_capture *cap = (struct replay_capture *)user;
+  cap->count++;
+  cap->op = op;
+  size_t off = 0;
+  uint8_t id;
+  const uint8_t *val;
+  uint16_t vlen;
+  while (kj_tlv_next(fields, fields_len, &off, &id, &val, &vlen) > 0)
+  {
+    if (id == KJ_F_PATH && vlen < sizeof(cap->path))
+    {
+      memcpy(cap->path, val, vlen);
+      cap->path[vlen] = '\0';
+    }
+    else if (id == KJ_F_MODE)
+      cap->mode = kj_tlv_u32(val);
+  }
+  return 0;
+}
+
 static int run_cmd_capture(char *const argv[], int expected_exit, char *out, size_t out_sz)
 {
   int pipefd[2];
@@ -249,7 +283,7 @@ static int test_v6_descriptor_journal_routing(void)
   uint64_t seq = 0;
   if (!failed)
   {
-    seq = kafs_journal_begin(&ctx, "V6ROUTE", "path=/descriptor");
+    seq = kafs_journal_begin(&ctx, KJ_OP_PROBE, KJ_F_PATH, "/descriptor", KJ_F_END);
     if (seq == 0)
       failed = 1;
   }
@@ -347,7 +381,8 @@ int main(void)
     close(ctx.c_fd);
     return 1;
   }
-  uint64_t seq = kafs_journal_begin(&ctx, "BOUNDARY", "path=/x");
+  uint64_t seq =
+      kafs_journal_begin(&ctx, KJ_OP_PROBE, KJ_F_PATH, "/x", KJ_F_MODE, 0100644u, KJ_F_END);
   if (seq == 0)
   {
     tlogf("journal begin returned 0");
@@ -377,17 +412,42 @@ int main(void)
     return 1;
   }
 
-  int replay_count = 0;
-  if (kafs_journal_replay(&ctx, replay_count_cb, &replay_count) != 0)
+  // The BEGIN record is binary TLV; the text decoder used by fsck/kafsdump must render it.
+  kj_rec_hdr_t beg;
+  uint8_t beg_pl[KJ_OP_PAYLOAD_MAX];
+  char beg_text[256];
+  if (read_rec_hdr(ctx.c_fd, data_off, 0, &beg) != 0 || beg.tag != KJ_TAG_BEG ||
+      beg.size > sizeof(beg_pl) ||
+      read_region_bytes(ctx.c_fd, data_off + sizeof(beg), beg_pl, beg.size) != 0 ||
+      !kj_op_payload_valid(beg_pl, beg.size))
+  {
+    tlogf("binary BEGIN record unreadable (case1)");
+    munmap(ctx.c_superblock, mapsize);
+    close(ctx.c_fd);
+    return 1;
+  }
+  kj_format_record(hdr.version, &beg, beg_pl, beg.size, beg_text, sizeof(beg_text));
+  if (hdr.version != KJ_VER || !strstr(beg_text, "op=PROBE path=/x mode=100644"))
+  {
+    tlogf("unexpected BEGIN text: version=%u '%s'", (unsigned)hdr.version, beg_text);
+    munmap(ctx.c_superblock, mapsize);
+    close(ctx.c_fd);
+    return 1;
+  }
+
+  struct replay_capture cap = {0};
+  if (kafs_journal_replay(&ctx, replay_capture_cb, &cap) != 0)
   {
     tlogf("replay failed (case1)");
     munmap(ctx.c_superblock, mapsize);
     close(ctx.c_fd);
     return 1;
   }
-  if (replay_count != 1)
+  if (cap.count != 1 || cap.op != KJ_OP_PROBE || strcmp(cap.path, "/x") != 0 ||
+      cap.mode != 0100644u)
   {
-    tlogf("expected replay_count=1 at write_off==area_size, got %d", replay_count);
+    tlogf("expected one PROBE /x replay at write_off==area_size, got count=%d op=%u path=%s",
+          cap.count, (unsigned)cap.op, cap.path);
     munmap(ctx.c_superblock, mapsize);
     close(ctx.c_fd);
     return 1;
@@ -412,7 +472,7 @@ int main(void)
     close(ctx.c_fd);
     return 1;
   }
-  kafs_journal_note(&ctx, "N", "x=%d", 1);
+  kafs_journal_note(&ctx, KJ_OP_PROBE, KJ_F_VALUE, (uint64_t)1, KJ_F_END);
   kafs_journal_force_flush(&ctx);
   if (read_header(ctx.c_fd, joff, &h_after) != 0)
   {
@@ -476,7 +536,7 @@ int main(void)
     close(ctx.c_fd);
     return 1;
   }
-  kafs_journal_note(&ctx, "N", "x=%d", 2);
+  kafs_journal_note(&ctx, KJ_OP_PROBE, KJ_F_VALUE, (uint64_t)2, KJ_F_END);
   kafs_journal_force_flush(&ctx);
   if (read_header(ctx.c_fd, joff, &h_after) != 0)
   {
@@ -539,7 +599,7 @@ int main(void)
     close(ctx.c_fd);
     return 1;
   }
-  kafs_journal_note(&ctx, "N", "x=%d", 3);
+  kafs_journal_note(&ctx, KJ_OP_PROBE, KJ_F_VALUE, (uint64_t)3, KJ_F_END);
   kafs_journal_force_flush(&ctx);
   if (read_header(ctx.c_fd, joff, &h_after) != 0)
   {
@@ -641,7 +701,7 @@ int main(void)
   }
   for (uint32_t i = 0; i < rot_slots + 2u; ++i)
   {
-    kafs_journal_note(&ctx, "R", "i=%u", i);
+    kafs_journal_note(&ctx, KJ_OP_PROBE, KJ_F_INO, (unsigned)i, KJ_F_END);
     kafs_journal_force_flush(&ctx);
   }
   kafs_journal_shutdown(&ctx);
@@ -693,7 +753,7 @@ int main(void)
     close(ctx.c_fd);
     return 1;
   }
-  kafs_journal_note(&ctx, "R", "after_corrupt=1");
+  kafs_journal_note(&ctx, KJ_OP_PROBE, KJ_F_REASON, "after_corrupt", KJ_F_END);
   kafs_journal_force_flush(&ctx);
   kafs_journal_shutdown(&ctx);
 
@@ -0,0 +1,156 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_journal.h"
+#include "kafs_superblock.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum
+{
+  GC_THREADS = 8,
+  GC_COMMITS_PER_THREAD = 40,
+  GC_SYNC_EVERY = 8,
+};
+
+static kafs_context_t g_ctx;
+static int g_flush_errors;
+
+static int replay_count_cb(struct kafs_context *ctx, uint16_t op, const uint8_t *fields,
+                           size_t fields_len, void *user)
+{
+  (void)ctx;
+  (void)fields;
+  (void)fields_len;
+  if (op == KJ_OP_PROBE)
+    ++*(unsigned *)user;
+  return 0;
+}
+
+static void *committer_main(void *arg)
+{
+  (void)arg;
+  for (int i = 0; i < GC_COMMITS_PER_THREAD; ++i)
+  {
+    uint64_t seq = kafs_journal_begin(&g_ctx, KJ_OP_PROBE, KJ_F_INO, (unsigned)i, KJ_F_END);
+    assert(seq != 0);
+    kafs_journal_commit(&g_ctx, seq);
+    if ((i + 1) % GC_SYNC_EVERY == 0 && kafs_journal_force_flush(&g_ctx) != 0)
+      __atomic_add_fetch(&g_flush_errors, 1, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("journal_group_commit") != 0)
+    return 77;
+
+  const char *img = "journal-group-commit.img";
+  off_t mapsize = 0;
+  if (kafs_test_mkimg_with_hrl(img, 64u * 1024u * 1024u, 12, 4096, &g_ctx, &mapsize) != 0)
+    return 77;
+  if (kafs_sb_journal_offset_get(g_ctx.c_superblock) == 0)
+  {
+    munmap(g_ctx.c_superblock, mapsize);
+    close(g_ctx.c_fd);
+    return 77;
+  }
+
+  // 5ms upper bound keeps the test quick while leaving room to batch.
+  setenv("KAFS_JOURNAL_GC_NS", "5000000", 1);
+  assert(kafs_journal_init(&g_ctx, img) == 0);
+  assert(kafs_journal_is_enabled(&g_ctx));
+
+  // Without the flusher a commit is durable before it returns: one fsync per commit.
+  kafs_journal_stats_t st;
+  uint64_t seq = kafs_journal_begin(&g_ctx, KJ_OP_PROBE, KJ_F_END);
+  kafs_journal_commit(&g_ctx, seq);
+  kafs_journal_stats_get(&g_ctx, &st);
+  assert(st.commits == 1 && st.flushes == 1 && st.flusher_running == 0);
+  assert(st.max_window_ns == 5000000u);
+
+  assert(kafs_journal_flusher_start(&g_ctx) == 0);
+  kafs_journal_stats_get(&g_ctx, &st);
+  assert(st.flusher_running == 1);
+
+  // A lone commit sees no arrival history, so the flusher does not hold it back.
+  seq = kafs_journal_begin(&g_ctx, KJ_OP_PROBE, KJ_F_END);
+  kafs_journal_commit(&g_ctx, seq);
+  kafs_journal_stats_get(&g_ctx, &st);
+  assert(st.window_ns == 0);
+  assert(kafs_journal_force_flush(&g_ctx) == 0);
+  // Nothing new since the last flush: returns without waiting.
+  uint64_t waits = st.sync_waits;
+  assert(kafs_journal_force_flush(&g_ctx) == 0);
+  kafs_journal_stats_get(&g_ctx, &st);
+  assert(st.sync_waits <= waits + 1);
+  uint64_t flushes_before = st.flushes;
+
+  // Concurrent committers with periodic fsyncs share flushes.
+  pthread_t th[GC_THREADS];
+  for (int i = 0; i < GC_THREADS; ++i)
+    assert(pthread_create(&th[i], NULL, committer_main, NULL) == 0);
+  for (int i = 0; i < GC_THREADS; ++i)
+    pthread_join(th[i], NULL);
+  assert(g_flush_errors == 0);
+  assert(kafs_journal_force_flush(&g_ctx) == 0);
+
+  kafs_journal_stats_get(&g_ctx, &st);
+  const uint64_t total = 2u + (uint64_t)GC_THREADS * GC_COMMITS_PER_THREAD;
+  uint64_t burst_flushes = st.flushes - flushes_before;
+  printf("group commit: commits=%" PRIu64 " flushes=%" PRIu64 " sync_waits=%" PRIu64
+         " window_ns=%" PRIu64 " uring=%" PRIu32 " uring_flushes=%" PRIu64 "\n",
+         st.commits, burst_flushes, st.sync_waits, st.window_ns, st.uring, st.uring_flushes);
+  assert(st.commits == total);
+  assert(burst_flushes >= 1);
+  assert(burst_flushes < (uint64_t)GC_THREADS * GC_COMMITS_PER_THREAD);
+  assert(st.sync_waits >= 1);
+  // Back-to-back commits open a batching window, bounded by the configured maximum.
+  assert(st.window_ns > 0 && st.window_ns <= st.max_window_ns);
+  // Where the kernel offers io_uring, the flusher's header write and fsync go in one submission.
+  if (st.uring)
+    assert(st.uring_flushes >= 1 && st.uring_flushes <= st.flushes);
+
+  // Stopping drains the last batch; later commits fall back to inline fsync.
+  seq = kafs_journal_begin(&g_ctx, KJ_OP_PROBE, KJ_F_END);
+  kafs_journal_commit(&g_ctx, seq);
+  kafs_journal_flusher_stop(&g_ctx);
+  kafs_journal_stats_get(&g_ctx, &st);
+  assert(st.flusher_running == 0);
+  uint64_t flushes_stopped = st.flushes;
+  seq = kafs_journal_begin(&g_ctx, KJ_OP_PROBE, KJ_F_END);
+  kafs_journal_commit(&g_ctx, seq);
+  kafs_journal_stats_get(&g_ctx, &st);
+  assert(st.flushes == flushes_stopped + 1);
+
+  // KAFS_JOURNAL_URING=0 keeps the flusher on pwrite + fsync.
+  setenv("KAFS_JOURNAL_URING", "0", 1);
+  assert(kafs_journal_flusher_start(&g_ctx) == 0);
+  uint64_t uring_before = st.uring_flushes;
+  seq = kafs_journal_begin(&g_ctx, KJ_OP_PROBE, KJ_F_END);
+  kafs_journal_commit(&g_ctx, seq);
+  assert(kafs_journal_force_flush(&g_ctx) == 0);
+  kafs_journal_stats_get(&g_ctx, &st);
+  assert(st.uring == 0 && st.uring_flushes == uring_before);
+  kafs_journal_flusher_stop(&g_ctx);
+  unsetenv("KAFS_JOURNAL_URING");
+  kafs_journal_shutdown(&g_ctx);
+
+  // Records were reserved lock-free and written concurrently; every one must replay intact.
+  unsigned replayed = 0;
+  assert(kafs_journal_replay(&g_ctx, replay_count_cb, &replayed) == 0);
+  assert(replayed == total + 3u);
+
+  munmap(g_ctx.c_superblock, mapsize);
+  close(g_ctx.c_fd);
+  unlink(img);
+  printf("journal_group_commit OK\n");
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include "kafs_mem_budget.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define CHUNK KAFS_MEM_TRIM_CHUNK
+
+int main(void)
+{
+  uint64_t b = 1;
+  assert(kafs_mem_budget_parse("off", &b) == 0 && b == 0);
+  assert(kafs_mem_budget_parse("0", &b) == 0 && b == 0);
+  assert(kafs_mem_budget_parse("64M", &b) == 0 && b == (64ull << 20));
+  assert(kafs_mem_budget_parse("1g", &b) == 0 && b == (1ull << 30));
+  assert(kafs_mem_budget_parse("8388608", &b) == 0 && b == (8ull << 20));
+  // Below the minimum, trailing junk and negative numbers are refused and leave *out alone.
+  assert(kafs_mem_budget_parse("1M", &b) == -EINVAL && b == (8ull << 20));
+  assert(kafs_mem_budget_parse("64MB", &b) == -EINVAL);
+  assert(kafs_mem_budget_parse("-64M", &b) == -EINVAL);
+  assert(kafs_mem_budget_parse("", &b) == -EINVAL);
+
+  kafs_mem_plan_t p;
+  kafs_mem_plan(64ull << 20, &p);
+  assert(p.mp_blk_cache == (16ull << 20) && p.mp_locks == (4ull << 20));
+  assert(p.mp_meta_bitmap == (8ull << 20) && p.mp_meta_resident == (32ull << 20));
+  kafs_mem_plan(0, &p);
+  assert(p.mp_blk_cache == 0 && p.mp_locks == 0 && p.mp_meta_resident == 0);
+
+  // Tables that fit keep their size (even if not a power of two); larger ones are striped.
+  assert(kafs_mem_cap_count(0, 40, 1000000u) == 1000000u);
+  assert(kafs_mem_cap_count(40000, 40, 1000u) == 1000u);
+  assert(kafs_mem_cap_count(40000, 40, 1000000u) == 512u);
+  assert(kafs_mem_cap_count(10, 40, 1000000u) == 1u);
+
+  // Trim over a shared file mapping: 3 chunks, the last one short.
+  char path[] = "/tmp/kafs-mem-budget-XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  size_t len = 2u * CHUNK + CHUNK / 2u;
+  assert(ftruncate(fd, (off_t)len) == 0);
+  char *m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  assert(m != MAP_FAILED);
+  char *base[1] = {m};
+  size_t lens[1] = {len};
+  kafs_mem_trim_t *t = kafs_mem_trim_create(1, base, lens);
+  assert(t && t->mt_nchunks == 3u);
+  assert(kafs_mem_trim_bytes(t) > sizeof(*t));
+  size_t clen;
+  assert(kafs_mem_trim_chunk(t, 2, &clen) == m + 2u * CHUNK && clen == CHUNK / 2u);
+  assert(kafs_mem_trim_chunk(t, 3, &clen) == NULL && clen == 0);
+
+  memset(m, 0x5a, len);
+  uint64_t r1 = kafs_mem_trim_pass(t, 0);
+  assert(r1 <= len);
+  // Newly faulted chunks are not idle; nothing has been advised yet.
+  for (uint32_t c = 0; c < t->mt_nchunks; ++c)
+    assert(t->mt_idle[c] == 0);
+  assert(t->mt_cold_bytes == 0 && t->mt_pageout_bytes == 0);
+
+  // Untouched since the last pass: idle once (MADV_COLD), then twice (eligible for PAGEOUT).
+  (void)kafs_mem_trim_pass(t, 0);
+  for (uint32_t c = 0; c < t->mt_nchunks; ++c)
+    assert(t->mt_idle[c] == (t->mt_resident[c] ? 1u : 0u));
+  (void)kafs_mem_trim_pass(t, 0);
+  assert(t->mt_pageout_bytes == 0); // no target, no pageout
+  uint64_t r3 = kafs_mem_trim_pass(t, 1u);
+  if (r1 > 0 && t->mt_pageout_ok)
+    assert(t->mt_pageout_bytes > 0 && r3 < r1);
+  assert(t->mt_runs == 4u && t->mt_resident_bytes == r3);
+
+  // Touching a chunk again makes it busy.
+  uint32_t before = t->mt_resident[0];
+  memset(m, 0x33, len);
+  (void)kafs_mem_trim_pass(t, 0);
+  if (t->mt_resident[0] > before)
+    assert(t->mt_idle[0] == 0);
+  // Contents survive MADV_PAGEOUT (shared file pages are written back, not dropped).
+  for (size_t i = 0; i < len; i += 4096u)
+    assert(m[i] == 0x33);
+
+  kafs_mem_trim_destroy(t);
+  munmap(m, len);
+  close(fd);
+  unlink(path);
+  printf("mem_budget OK\n");
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_meta_map.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("meta_map") != 0)
+    return 77;
+
+  const char *img = "./meta_map.img";
+  kafs_context_t ctx;
+  off_t mapsize;
+  assert(kafs_test_mkimg_no_hrl(img, 32 * 1024 * 1024u, 12, 4096, &ctx, &mapsize) == 0);
+  struct stat st;
+  assert(fstat(ctx.c_fd, &st) == 0);
+  kafs_ssuperblock_t *prefix = ctx.c_superblock;
+
+  // Without the option the image is mapped as before.
+  void *plain = kafs_meta_map_image(&ctx, (size_t)st.st_size, PROT_READ | PROT_WRITE);
+  assert(plain != MAP_FAILED);
+  assert(memcmp(plain, prefix, sizeof(*prefix)) == 0);
+  munmap(plain, (size_t)st.st_size);
+
+  // meta_hugepage puts the image on a 2MiB boundary so the metadata prefix can use huge pages.
+  ctx.c_meta_hugepage = 1;
+  ctx.c_img_base = kafs_meta_map_image(&ctx, (size_t)st.st_size, PROT_READ | PROT_WRITE);
+  assert(ctx.c_img_base != MAP_FAILED);
+  assert(((uintptr_t)ctx.c_img_base & (KAFS_META_HUGEPAGE_ALIGN - 1u)) == 0);
+  ctx.c_img_size = (size_t)st.st_size;
+  ctx.c_superblock = (kafs_ssuperblock_t *)ctx.c_img_base;
+  ctx.c_mapsize = (size_t)mapsize;
+  assert(memcmp(ctx.c_img_base, prefix, sizeof(*prefix)) == 0);
+
+  uint64_t off[KAFS_META_MAP_REGIONS], len[KAFS_META_MAP_REGIONS];
+  int n = kafs_meta_map_regions(&ctx, off, len);
+  assert(n >= 1 && off[0] == 0 && len[0] == (uint64_t)mapsize);
+  uint64_t meta_bytes = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    assert(off[i] + len[i] <= ctx.c_img_size);
+    meta_bytes += len[i];
+  }
+  // Advice is best-effort (THP may be compiled out), but never exceeds the metadata span.
+  kafs_meta_map_advise(&ctx);
+  assert(ctx.c_stat_meta_hugepage_bytes <= ctx.c_img_size);
+
+  // Prefault runs in the background and reports bytes and time when it finishes.
+  ctx.c_meta_prefault = 1;
+  assert(kafs_meta_prefault_start(&ctx) == 0);
+  while (__atomic_load_n(&ctx.c_meta_prefault_state, __ATOMIC_ACQUIRE) ==
+         KAFS_META_PREFAULT_RUNNING)
+    sched_yield();
+  kafs_meta_prefault_stop(&ctx);
+  assert(ctx.c_meta_prefault_state == KAFS_META_PREFAULT_DONE);
+  assert(ctx.c_stat_meta_prefault_bytes >= meta_bytes);
+  printf("meta_map: regions=%d meta=%" PRIu64 " advised=%" PRIu64 " prefault=%" PRIu64
+         " ns=%" PRIu64 "\n",
+         n, meta_bytes, ctx.c_stat_meta_hugepage_bytes, ctx.c_stat_meta_prefault_bytes,
+         ctx.c_stat_meta_prefault_ns);
+
+  // Unmount may stop a prefault that is still running.
+  assert(kafs_meta_prefault_start(&ctx) == 0);
+  kafs_meta_prefault_stop(&ctx);
+  assert(ctx.c_meta_prefault_state == KAFS_META_PREFAULT_DONE ||
+         ctx.c_meta_prefault_state == KAFS_META_PREFAULT_STOPPED);
+
+  munmap(ctx.c_img_base, ctx.c_img_size);
+  munmap(prefix, mapsize);
+  close(ctx.c_fd);
+  unlink(img);
+  return 0;
+}
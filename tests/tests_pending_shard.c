@@ -0,0 +1,107 @@
+#include "kafs_pendinglog.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CAP 8u
+
+static kafs_pendinglog_hdr_t *mk_log(void)
+{
+  kafs_pendinglog_hdr_t *hdr =
+      (kafs_pendinglog_hdr_t *)calloc(1, sizeof(*hdr) + CAP * sizeof(kafs_pendinglog_entry_t));
+  assert(hdr != NULL);
+  hdr->entry_size = sizeof(kafs_pendinglog_entry_t);
+  hdr->capacity = CAP;
+  hdr->next_pending_id = 1;
+  return hdr;
+}
+
+static uint32_t push(kafs_pendinglog_hdr_t *hdr, uint32_t ino)
+{
+  uint32_t idx = hdr->tail;
+  kafs_pendinglog_entry_t *e = kafs_pendinglog_slot(hdr, idx);
+  e->pending_id = hdr->next_pending_id++;
+  e->ino = ino;
+  e->state = KAFS_PENDING_QUEUED;
+  hdr->tail = kafs_pendinglog_next_idx(hdr, hdr->tail);
+  assert(hdr->tail != hdr->head);
+  return idx;
+}
+
+static void set_state(kafs_pendinglog_hdr_t *hdr, uint32_t idx, uint32_t state)
+{
+  kafs_pendinglog_slot(hdr, idx)->state = state;
+}
+
+static uint32_t next_of(kafs_pendinglog_hdr_t *hdr, uint32_t shard, kafs_pending_cursor_t *cur)
+{
+  uint32_t idx = UINT32_MAX;
+  if (kafs_pending_shard_next(hdr, shard, 2, cur, &idx) != 0)
+    return UINT32_MAX;
+  return idx;
+}
+
+int main(void)
+{
+  kafs_pendinglog_hdr_t *hdr = mk_log();
+  kafs_pending_cursor_t c0 = {0}, c1 = {0};
+  uint32_t idx = 0;
+
+  assert(kafs_pending_shard_next(hdr, 0, 2, &c0, &idx) == -ENOENT);
+  assert(kafs_pending_shard_next(hdr, 0, 0, &c0, &idx) == -ENOENT);
+  assert(kafs_pendinglog_trim_done(hdr) == 0);
+
+  // Shards see only their own inodes, oldest first, and stay on an entry until it is done.
+  assert(push(hdr, 10) == 0);
+  assert(push(hdr, 11) == 1);
+  assert(push(hdr, 12) == 2);
+  assert(push(hdr, 13) == 3);
+  assert(push(hdr, 10) == 4);
+  assert(next_of(hdr, 0, &c0) == 0);
+  assert(next_of(hdr, 1, &c1) == 1);
+  assert(next_of(hdr, 0, &c0) == 0);
+
+  // Shard 0 runs ahead of shard 1; the head only moves over finished entries.
+  set_state(hdr, 0, KAFS_PENDING_RESOLVED);
+  assert(next_of(hdr, 0, &c0) == 2);
+  assert(kafs_pendinglog_trim_done(hdr) == 1 && hdr->head == 1);
+  set_state(hdr, 2, KAFS_PENDING_RESOLVED);
+  // The second write to inode 10 comes only after the first one.
+  assert(next_of(hdr, 0, &c0) == 4);
+  set_state(hdr, 4, KAFS_PENDING_RESOLVED);
+  assert(next_of(hdr, 0, &c0) == UINT32_MAX);
+  assert(c0.pc_idx == hdr->tail && c0.pc_id == hdr->next_pending_id);
+  assert(kafs_pendinglog_trim_done(hdr) == 0 && hdr->head == 1);
+
+  set_state(hdr, 1, KAFS_PENDING_RESOLVED);
+  assert(next_of(hdr, 1, &c1) == 3);
+  set_state(hdr, 3, KAFS_PENDING_FAILED);
+  assert(next_of(hdr, 1, &c1) == UINT32_MAX);
+  assert(kafs_pendinglog_trim_done(hdr) == 4 && hdr->head == hdr->tail);
+
+  // A cursor parked at the tail picks up the next entry written there.
+  assert(push(hdr, 20) == 5);
+  assert(next_of(hdr, 0, &c0) == 5);
+
+  // Once its slot is reused the cursor is stale and the shard rescans from the head.
+  uint32_t stale_idx = c1.pc_idx;
+  for (uint32_t i = 0; i < CAP + 2u; ++i)
+  {
+    uint32_t at = next_of(hdr, 0, &c0);
+    assert(at != UINT32_MAX);
+    set_state(hdr, at, KAFS_PENDING_RESOLVED);
+    assert(kafs_pendinglog_trim_done(hdr) == 1);
+    (void)push(hdr, 30u + 2u * i);
+  }
+  assert(!kafs_pending_cursor_valid(hdr, &c1));
+  assert(kafs_pendinglog_slot(hdr, stale_idx)->ino % 2u == 0);
+  uint32_t odd = push(hdr, 41);
+  assert(next_of(hdr, 1, &c1) == odd);
+  assert(next_of(hdr, 0, &c0) == hdr->head);
+
+  free(hdr);
+  printf("pending_shard OK\n");
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_block.h"
+#include "kafs_prealloc.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+int main(void)
+{
+  if (kafs_test_enter_tmpdir("prealloc_window") != 0)
+    return 77;
+
+  const char *img = "./prealloc_window.img";
+  kafs_context_t ctx;
+  off_t mapsize;
+  assert(kafs_test_mkimg_no_hrl(img, 32 * 1024 * 1024u, 12, 1024, &ctx, &mapsize) == 0);
+
+  const uint32_t ino = 5;
+  const uint32_t other_ino = 6;
+  ctx.c_prealloc_blocks = 8;
+  assert(kafs_prealloc_init(&ctx) == 0);
+  assert(kafs_prealloc_enabled(&ctx));
+  kafs_blkcnt_t free0 = kafs_sb_blkcnt_free_get(ctx.c_superblock);
+
+  // Not armed: plain allocation, no window accounting.
+  kafs_blkcnt_t plain = KAFS_BLO_NONE;
+  assert(kafs_prealloc_blk_alloc(&ctx, other_ino, 0, &plain) == 0);
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_HITS) == 0 &&
+         kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_WINDOWS) == 0);
+
+  // Armed append: the first allocation reserves a contiguous run, the rest consume it.
+  kafs_prealloc_arm(&ctx, ino, 0);
+  kafs_blkcnt_t blos[10];
+  for (kafs_iblkcnt_t i = 0; i < 10; ++i)
+  {
+    blos[i] = KAFS_BLO_NONE;
+    assert(kafs_prealloc_blk_alloc(&ctx, ino, i, &blos[i]) == 0);
+    assert(kafs_blk_get_usage(&ctx, blos[i]) == KAFS_TRUE);
+  }
+  for (int i = 1; i < 8; ++i)
+    assert(blos[i] == blos[0] + (kafs_blkcnt_t)i);
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_WINDOWS) == 2);
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_RESERVED_BLOCKS) == 16);
+  // The two reserving allocations are misses; the other eight come out of a window.
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_HITS) == 8);
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_MISSES) == 2);
+  assert(ctx.c_prealloc_outstanding == 6);
+
+  // A continuing append (re-entering at the next block) keeps the window.
+  kafs_prealloc_arm(&ctx, ino, 10);
+  assert(ctx.c_prealloc_outstanding == 6);
+
+  // Out-of-order rewrite falls back to the allocator without dropping the window.
+  kafs_blkcnt_t rw = KAFS_BLO_NONE;
+  assert(kafs_prealloc_blk_alloc(&ctx, ino, 3, &rw) == 0);
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_MISSES) == 3);
+  assert(ctx.c_prealloc_outstanding == 6);
+
+  // Last close returns the unused tail to the bitmap.
+  kafs_blkcnt_t spare = blos[9] + 1;
+  assert(kafs_blk_get_usage(&ctx, spare) == KAFS_TRUE);
+  kafs_prealloc_release_ino(&ctx, ino);
+  assert(kafs_blk_get_usage(&ctx, spare) == KAFS_FALSE);
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_WASTED_BLOCKS) == 6);
+  assert(ctx.c_prealloc_outstanding == 0);
+  kafs_blkcnt_t used_now = 1 + 10 + 1;
+  assert(kafs_sb_blkcnt_free_get(ctx.c_superblock) == free0 - used_now);
+
+  // Re-arming a different append position evicts the old window.
+  kafs_prealloc_arm(&ctx, ino, 100);
+  kafs_blkcnt_t b = KAFS_BLO_NONE;
+  assert(kafs_prealloc_blk_alloc(&ctx, ino, 100, &b) == 0);
+  // The run may be shorter than requested when it starts inside a previously released gap.
+  uint64_t outstanding = ctx.c_prealloc_outstanding;
+  assert(outstanding > 0 && outstanding <= 7);
+  kafs_prealloc_arm(&ctx, ino, 500);
+  assert(ctx.c_prealloc_outstanding == 0);
+  assert(kafs_stat_sum(&ctx, KAFS_STAT_PREALLOC_WASTED_BLOCKS) == 6 + outstanding);
+
+  kafs_prealloc_destroy(&ctx);
+  assert(ctx.c_prealloc_windows == NULL);
+
+  munmap(ctx.c_superblock, mapsize);
+  close(ctx.c_fd);
+  unlink(img);
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "kafs_reclaimq.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+static const uint64_t g_keys[16] = {0, 0, 0, 50, 40, 30, 20, 10, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static uint64_t key_of(void *arg, uint32_t ino) { return g_keys[ino]; }
+
+static int skip_odd(void *arg, uint32_t ino) { return (ino & 1u) != 0; }
+
+static void expect_order(kafs_reclaimq_t *q, const uint32_t *want, uint32_t n)
+{
+  uint32_t got[16];
+  uint32_t visited = 0;
+  assert(kafs_reclaimq_collect(q, got, 16, 16, NULL, NULL, &visited) == n);
+  assert(visited == n);
+  for (uint32_t i = 0; i < n; ++i)
+    assert(got[i] == want[i]);
+}
+
+int main(void)
+{
+  kafs_reclaimq_t *q = kafs_reclaimq_create(16);
+  assert(q != NULL);
+  uint32_t len = 1;
+  assert(kafs_reclaimq_peek(q, &len) == 0 && len == 0);
+
+  assert(kafs_reclaimq_push(q, 0, 0) == -EINVAL);
+  assert(kafs_reclaimq_push(q, 16, 0) == -EINVAL);
+
+  // FIFO by default; a second push is a no-op.
+  assert(kafs_reclaimq_push(q, 3, 0) == 1);
+  assert(kafs_reclaimq_push(q, 4, 0) == 1);
+  assert(kafs_reclaimq_push(q, 5, 0) == 1);
+  assert(kafs_reclaimq_push(q, 4, 0) == 0);
+  assert(kafs_reclaimq_push(q, 3, 1) == 0);
+  assert(kafs_reclaimq_peek(q, &len) == 3 && len == 3);
+  expect_order(q, (const uint32_t[]){3, 4, 5}, 3);
+
+  // Sweep results go to the front.
+  assert(kafs_reclaimq_push(q, 7, 1) == 1);
+  expect_order(q, (const uint32_t[]){7, 3, 4, 5}, 4);
+
+  // Removal from the middle, head and tail keeps the links consistent.
+  assert(kafs_reclaimq_remove(q, 3) == 1);
+  assert(kafs_reclaimq_remove(q, 3) == 0);
+  expect_order(q, (const uint32_t[]){7, 4, 5}, 3);
+  assert(kafs_reclaimq_remove(q, 7) == 1);
+  assert(kafs_reclaimq_remove(q, 5) == 1);
+  assert(kafs_reclaimq_peek(q, &len) == 4 && len == 1);
+  assert(kafs_reclaimq_remove(q, 4) == 1);
+  assert(kafs_reclaimq_peek(q, &len) == 0 && len == 0);
+  assert(kafs_reclaimq_remove(NULL, 4) == 0);
+
+  // A removed inode can be queued again.
+  for (uint32_t ino = 3; ino <= 7; ++ino)
+    assert(kafs_reclaimq_push(q, ino, 0) == 1);
+
+  // collect skips open inodes but bounds how many entries it looks at.
+  uint32_t got[16];
+  uint32_t visited = 0;
+  assert(kafs_reclaimq_collect(q, got, 16, 16, skip_odd, NULL, &visited) == 2);
+  assert(visited == 5 && got[0] == 4 && got[1] == 6);
+  assert(kafs_reclaimq_collect(q, got, 16, 2, skip_odd, NULL, &visited) == 1);
+  assert(visited == 2 && got[0] == 4);
+  assert(kafs_reclaimq_collect(q, got, 1, 16, NULL, NULL, &visited) == 1);
+  assert(visited == 1 && got[0] == 3);
+
+  // sort orders by key (dtime), oldest first.
+  assert(kafs_reclaimq_sort(q, key_of, NULL) == 0);
+  expect_order(q, (const uint32_t[]){7, 6, 5, 4, 3}, 5);
+  assert(kafs_reclaimq_push(q, 2, 0) == 1);
+  expect_order(q, (const uint32_t[]){7, 6, 5, 4, 3, 2}, 6);
+  assert(kafs_reclaimq_remove(q, 2) == 1 && kafs_reclaimq_remove(q, 7) == 1);
+  assert(kafs_reclaimq_peek(q, &len) == 6 && len == 4);
+
+  kafs_reclaimq_destroy(q);
+  printf("reclaimq OK\n");
+  return 0;
+}
@@ -0,0 +1,213 @@
+#include "kafs_rpc.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SENDERS 8
+
+static void send_u32(int fd, uint16_t op, uint32_t v)
+{
+  assert(kafs_rpc_send_msg(fd, op, KAFS_RPC_FLAG_ENDIAN_HOST, op, 1u, 0u, &v, sizeof(v)) == 0);
+}
+
+static void recv_u32(kafs_rpc_rx_t *rx, uint16_t op, uint32_t v, int *out_fd)
+{
+  kafs_rpc_hdr_t hdr;
+  uint32_t got = 0, len = 0;
+  assert(kafs_rpc_rx_recv_msg_fd(rx, &hdr, &got, sizeof(got), &len, out_fd) == 0);
+  assert(hdr.op == op && hdr.req_id == op && len == sizeof(got) && got == v);
+}
+
+// Several queued messages come out of one recvmsg; a passed fd goes to the message it was sent
+// with, not to the ones buffered around it.
+static void test_rx_readahead(void)
+{
+  int sv[2], pp[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  assert(pipe(pp) == 0);
+  send_u32(sv[0], 1, 10);
+  send_u32(sv[0], 2, 20);
+  uint32_t v = 30;
+  assert(kafs_rpc_send_msg_fd(sv[0], 3, KAFS_RPC_FLAG_ENDIAN_HOST, 3, 1u, 0u, &v, sizeof(v),
+                              pp[1]) == 0);
+  send_u32(sv[0], 4, 40);
+
+  kafs_rpc_rx_t rx;
+  assert(kafs_rpc_rx_init(&rx, sv[1]) == 0);
+  int fd = -2;
+  recv_u32(&rx, 1, 10, &fd);
+  assert(fd == -1);
+  recv_u32(&rx, 2, 20, &fd);
+  assert(fd == -1);
+  recv_u32(&rx, 3, 30, &fd);
+  assert(fd >= 0);
+  assert(write(fd, "k", 1) == 1);
+  char c = 0;
+  assert(read(pp[0], &c, 1) == 1 && c == 'k');
+  close(fd);
+  recv_u32(&rx, 4, 40, &fd);
+  assert(fd == -1);
+  assert(rx.rx_msgs == 4u && rx.rx_syscalls == 2u);
+
+  // A body larger than the caller's buffer is skipped without losing the next message.
+  send_u32(sv[0], 5, 50);
+  send_u32(sv[0], 6, 60);
+  kafs_rpc_hdr_t hdr;
+  uint8_t small[2];
+  uint32_t len = 0;
+  assert(kafs_rpc_rx_recv_msg_fd(&rx, &hdr, small, sizeof(small), &len, NULL) == -EMSGSIZE);
+  assert(hdr.op == 5 && len == 4u);
+  recv_u32(&rx, 6, 60, NULL);
+
+  kafs_rpc_rx_destroy(&rx);
+  close(pp[0]);
+  close(pp[1]);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+typedef struct
+{
+  int fd;
+  uint8_t *buf;
+  uint32_t len;
+} big_arg_t;
+
+static void *send_big(void *p)
+{
+  big_arg_t *a = (big_arg_t *)p;
+  assert(kafs_rpc_send_resp(a->fd, 7u, 0, a->buf, a->len) == 0);
+  return NULL;
+}
+
+// A negotiated large body arrives whole and is scattered into the caller's iovecs.
+static void test_large_scatter(void)
+{
+  int sv[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  uint32_t len = KAFS_RPC_MAX_PAYLOAD_LARGE;
+  uint8_t *src = (uint8_t *)malloc(len + 1u);
+  uint8_t *dst = (uint8_t *)malloc(len);
+  assert(src && dst);
+  for (uint32_t i = 0; i < len; ++i)
+    src[i] = (uint8_t)(i * 7u);
+  assert(kafs_rpc_send_resp(sv[0], 8u, 0, src, len + 1u) == -EMSGSIZE);
+
+  big_arg_t a = {sv[0], src, len};
+  pthread_t th;
+  assert(pthread_create(&th, NULL, send_big, &a) == 0);
+  kafs_rpc_rx_t rx;
+  assert(kafs_rpc_rx_init(&rx, sv[1]) == 0);
+  kafs_rpc_resp_hdr_t hdr;
+  assert(kafs_rpc_rx_recv_resp_hdr(&rx, &hdr) == 0);
+  assert(hdr.req_id == 7u && hdr.payload_len == len);
+  uint32_t head = 0, got = 0;
+  struct iovec iov[2] = {{&head, sizeof(head)}, {dst, len - sizeof(head)}};
+  assert(kafs_rpc_rx_recv_resp_body(&rx, &hdr, iov, 2, &got) == 0);
+  pthread_join(th, NULL);
+  assert(got == len);
+  assert(memcmp(&head, src, sizeof(head)) == 0);
+  assert(memcmp(dst, src + sizeof(head), len - sizeof(head)) == 0);
+
+  kafs_rpc_rx_destroy(&rx);
+  free(src);
+  free(dst);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+typedef struct
+{
+  kafs_rpc_tx_t *tx;
+  int fd;
+  uint32_t id;
+} sender_arg_t;
+
+static void *sender(void *p)
+{
+  sender_arg_t *a = (sender_arg_t *)p;
+  uint32_t body[2] = {a->id, a->id * 3u};
+  struct iovec iov[2] = {{&body[0], sizeof(body[0])}, {&body[1], sizeof(body[1])}};
+  assert(kafs_rpc_tx_send_msg(a->tx, a->fd, KAFS_RPC_OP_WRITE, KAFS_RPC_FLAG_ENDIAN_HOST, a->id,
+                              1u, 0u, iov, 2) == 0);
+  return NULL;
+}
+
+// Messages queued while another thread is writing go out together in one sendmsg.
+static void test_tx_batch(void)
+{
+  int sv[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  kafs_rpc_tx_t tx;
+  kafs_rpc_tx_init(&tx);
+
+  // Pretend a writer is busy until every sender has queued.
+  pthread_mutex_lock(&tx.tx_lock);
+  tx.tx_busy = 1;
+  pthread_mutex_unlock(&tx.tx_lock);
+  pthread_t th[SENDERS];
+  sender_arg_t args[SENDERS];
+  for (uint32_t i = 0; i < SENDERS; ++i)
+  {
+    args[i] = (sender_arg_t){&tx, sv[0], i + 1u};
+    assert(pthread_create(&th[i], NULL, sender, &args[i]) == 0);
+  }
+  for (;;)
+  {
+    pthread_mutex_lock(&tx.tx_lock);
+    uint32_t q = tx.tx_queued;
+    if (q == SENDERS)
+    {
+      tx.tx_busy = 0;
+      pthread_cond_broadcast(&tx.tx_cond);
+    }
+    pthread_mutex_unlock(&tx.tx_lock);
+    if (q == SENDERS)
+      break;
+    usleep(1000);
+  }
+  for (uint32_t i = 0; i < SENDERS; ++i)
+    pthread_join(th[i], NULL);
+  assert(tx.tx_msgs == SENDERS && tx.tx_batches == 1u && tx.tx_batch_max == SENDERS);
+  assert(tx.tx_queued == 0 && tx.tx_head == NULL);
+
+  kafs_rpc_rx_t rx;
+  assert(kafs_rpc_rx_init(&rx, sv[1]) == 0);
+  uint32_t seen = 0;
+  for (uint32_t i = 0; i < SENDERS; ++i)
+  {
+    kafs_rpc_hdr_t hdr;
+    uint32_t body[2], len = 0;
+    assert(kafs_rpc_rx_recv_msg_fd(&rx, &hdr, body, sizeof(body), &len, NULL) == 0);
+    assert(len == sizeof(body) && body[0] == hdr.req_id && body[1] == body[0] * 3u);
+    seen |= 1u << body[0];
+  }
+  assert(seen == ((1u << (SENDERS + 1)) - 2u));
+  assert(rx.rx_syscalls == 1u);
+
+  // A response with no body is just the header.
+  assert(kafs_rpc_tx_send_resp(&tx, sv[0], 9u, -ENOENT, NULL, 0) == 0);
+  kafs_rpc_resp_hdr_t rh;
+  assert(kafs_rpc_rx_recv_resp_hdr(&rx, &rh) == 0);
+  assert(rh.req_id == 9u && rh.result == -ENOENT && rh.payload_len == 0);
+
+  kafs_rpc_rx_destroy(&rx);
+  kafs_rpc_tx_destroy(&tx);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+int main(void)
+{
+  test_rx_readahead();
+  test_large_scatter();
+  test_tx_batch();
+  printf("rpc_batch OK\n");
+  return 0;
+}
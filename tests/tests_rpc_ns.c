@@ -0,0 +1,95 @@
+#include "kafs_rpc.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+int main(void)
+{
+  uint8_t buf[sizeof(kafs_rpc_ns_req_t) + sizeof(kafs_rpc_setattr_t) + 2u * KAFS_RPC_NS_PATH_MAX];
+  kafs_rpc_ns_req_t req;
+  memset(&req, 0, sizeof(req));
+  req.uid = 1000;
+  req.gid = 100;
+  req.mode = 0644;
+  req.op_flags = 1;
+  kafs_rpc_setattr_t sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.valid = KAFS_RPC_SETATTR_OWNER;
+  sa.uid = 7;
+  sa.gid = 8;
+
+  // req + extra + path + path2, no terminators.
+  int len = kafs_rpc_ns_encode(buf, sizeof(buf), &req, &sa, sizeof(sa), "/a/b", "/c");
+  assert(len == (int)(sizeof(req) + sizeof(sa) + 4u + 2u));
+  kafs_rpc_ns_req_t out;
+  const uint8_t *extra;
+  const char *path;
+  const char *path2;
+  assert(kafs_rpc_ns_decode(buf, (uint32_t)len, &out, &extra, &path, &path2) == 0);
+  assert(out.uid == 1000 && out.gid == 100 && out.mode == 0644 && out.op_flags == 1);
+  assert(out.extra_len == sizeof(sa) && out.path_len == 4 && out.path2_len == 2);
+  kafs_rpc_setattr_t sa2;
+  memcpy(&sa2, extra, sizeof(sa2));
+  assert(sa2.valid == KAFS_RPC_SETATTR_OWNER && sa2.uid == 7 && sa2.gid == 8);
+  assert(memcmp(path, "/a/b", 4) == 0 && memcmp(path2, "/c", 2) == 0);
+
+  // A handle-only request carries no path.
+  req.ino = 42;
+  req.flags = KAFS_RPC_NS_F_FH;
+  len = kafs_rpc_ns_encode(buf, sizeof(buf), &req, NULL, 0, NULL, NULL);
+  assert(len == (int)sizeof(req));
+  assert(kafs_rpc_ns_decode(buf, (uint32_t)len, &out, &extra, &path, &path2) == 0);
+  assert(out.ino == 42 && out.path_len == 0 && out.path2_len == 0 && out.extra_len == 0);
+
+  // Lengths must add up exactly; short or padded payloads are refused.
+  len = kafs_rpc_ns_encode(buf, sizeof(buf), &req, NULL, 0, "/x", NULL);
+  assert(kafs_rpc_ns_decode(buf, (uint32_t)len - 1u, &out, &extra, &path, &path2) == -EBADMSG);
+  assert(kafs_rpc_ns_decode(buf, (uint32_t)len + 1u, &out, &extra, &path, &path2) == -EBADMSG);
+  assert(kafs_rpc_ns_decode(buf, sizeof(req) - 1u, &out, &extra, &path, &path2) == -EBADMSG);
+  kafs_rpc_ns_req_t bad = req;
+  bad.path_len = (uint16_t)(KAFS_RPC_NS_PATH_MAX + 1u);
+  memcpy(buf, &bad, sizeof(bad));
+  assert(kafs_rpc_ns_decode(buf, (uint32_t)(sizeof(bad) + bad.path_len), &out, &extra, &path,
+                            &path2) == -EBADMSG);
+
+  // Over-long paths and buffers that are too small are reported, not truncated.
+  static char longpath[KAFS_RPC_NS_PATH_MAX + 2];
+  memset(longpath, 'x', sizeof(longpath) - 1u);
+  longpath[0] = '/';
+  assert(kafs_rpc_ns_encode(buf, sizeof(buf), &req, NULL, 0, longpath, NULL) == -ENAMETOOLONG);
+  longpath[KAFS_RPC_NS_PATH_MAX] = '\0';
+  assert(kafs_rpc_ns_encode(buf, sizeof(buf), &req, NULL, 0, longpath, longpath) > 0);
+  assert(kafs_rpc_ns_encode(buf, sizeof(req) + 3u, &req, NULL, 0, "/abc", NULL) == -EMSGSIZE);
+
+  // The compact attribute round-trips what kafs_core_getattr fills in.
+  struct stat st;
+  memset(&st, 0, sizeof(st));
+  st.st_ino = 9;
+  st.st_mode = S_IFREG | 0600;
+  st.st_nlink = 2;
+  st.st_uid = 1000;
+  st.st_gid = 100;
+  st.st_size = (off_t)1 << 40;
+  st.st_blocks = 16;
+  st.st_blksize = 4096;
+  st.st_mtim.tv_sec = 1700000000;
+  st.st_mtim.tv_nsec = 123456789;
+  kafs_rpc_attr_t a;
+  kafs_rpc_attr_from_stat(&a, &st);
+  struct stat st2;
+  kafs_rpc_attr_to_stat(&st2, &a);
+  assert(st2.st_ino == st.st_ino && st2.st_mode == st.st_mode && st2.st_nlink == st.st_nlink);
+  assert(st2.st_uid == st.st_uid && st2.st_gid == st.st_gid && st2.st_size == st.st_size);
+  assert(st2.st_blocks == st.st_blocks && st2.st_blksize == st.st_blksize);
+  assert(st2.st_mtim.tv_sec == st.st_mtim.tv_sec && st2.st_mtim.tv_nsec == st.st_mtim.tv_nsec);
+
+  // A full GETATTR_MULTI answer fits in one response.
+  assert(KAFS_RPC_GETATTR_MULTI_MAX * sizeof(kafs_rpc_attr_result_t) <= KAFS_RPC_MAX_PAYLOAD);
+  assert((KAFS_RPC_HELLO_FEATURES & KAFS_RPC_HELLO_FEATURE_NS) != 0);
+
+  printf("rpc_ns OK\n");
+  return 0;
+}
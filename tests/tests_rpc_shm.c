@@ -0,0 +1,90 @@
+#include "kafs_rpc.h"
+#include "kafs_rpc_shm.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int main(void)
+{
+  assert(!kafs_rpc_shm_geometry_ok(0, 4096u));
+  assert(!kafs_rpc_shm_geometry_ok(65u, 4096u));
+  assert(!kafs_rpc_shm_geometry_ok(4u, 5000u));
+  assert(kafs_rpc_shm_geometry_ok(KAFS_RPC_SHM_SLOTS, KAFS_RPC_SHM_SLOT_SIZE));
+
+  kafs_rpc_shm_t front;
+  int rc = kafs_rpc_shm_create(&front, 4u, 8192u);
+  if (rc == -ENOSYS || rc == -EPERM)
+  {
+    printf("rpc_shm SKIP (memfd rc=%d)\n", rc);
+    return 77;
+  }
+  assert(rc == 0 && front.rs_fd >= 0 && front.rs_len == 4u * 8192u);
+
+  // Slots are handed out once each until released.
+  int got[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    got[i] = kafs_rpc_shm_slot_get(&front);
+    assert(got[i] >= 0 && got[i] < 4);
+    for (int j = 0; j < i; ++j)
+      assert(got[i] != got[j]);
+  }
+  assert(kafs_rpc_shm_slot_get(&front) == -EAGAIN);
+  kafs_rpc_shm_slot_put(&front, got[2]);
+  assert(kafs_rpc_shm_slot_get(&front) == got[2]);
+  for (int i = 0; i < 4; ++i)
+    kafs_rpc_shm_slot_put(&front, got[i]);
+  assert(front.rs_busy == 0);
+
+  assert(kafs_rpc_shm_slot_ptr(&front, 3u, 8192u) == front.rs_base + 3u * 8192u);
+  assert(kafs_rpc_shm_slot_ptr(&front, 4u, 1u) == NULL);
+  assert(kafs_rpc_shm_slot_ptr(&front, 0u, 8193u) == NULL);
+
+  // SHM_ATTACH carries the memfd over the socket; the other side maps the same pages.
+  int sv[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  kafs_rpc_shm_attach_t att = {front.rs_slot_count, front.rs_slot_size};
+  rc = kafs_rpc_send_msg_fd(sv[0], KAFS_RPC_OP_SHM_ATTACH, KAFS_RPC_FLAG_ENDIAN_HOST, 7u, 1u, 0u,
+                            &att, sizeof(att), front.rs_fd);
+  assert(rc == 0);
+  kafs_rpc_hdr_t hdr;
+  kafs_rpc_shm_attach_t in;
+  uint32_t len = 0;
+  int rx_fd = -1;
+  rc = kafs_rpc_recv_msg_fd(sv[1], &hdr, &in, sizeof(in), &len, &rx_fd);
+  assert(rc == 0 && hdr.op == KAFS_RPC_OP_SHM_ATTACH && hdr.req_id == 7u);
+  assert(len == sizeof(in) && rx_fd >= 0 && rx_fd != front.rs_fd);
+  assert((fcntl(rx_fd, F_GETFD) & FD_CLOEXEC) != 0);
+
+  kafs_rpc_shm_t back;
+  assert(kafs_rpc_shm_attach(&back, rx_fd, in.slot_count + 1u, in.slot_size) == -EINVAL);
+  assert(kafs_rpc_shm_attach(&back, rx_fd, in.slot_count, in.slot_size) == 0);
+  memset(kafs_rpc_shm_slot_ptr(&front, 1u, 100u), 0xa5, 100u);
+  assert((unsigned char)kafs_rpc_shm_slot_ptr(&back, 1u, 100u)[99] == 0xa5);
+  memcpy(kafs_rpc_shm_slot_ptr(&back, 2u, 5u), "hello", 5u);
+  assert(memcmp(kafs_rpc_shm_slot_ptr(&front, 2u, 5u), "hello", 5u) == 0);
+
+  // Plain messages still flow through the fd-aware receiver, and a stray fd is dropped.
+  kafs_rpc_shm_ref_t ref = {2u, 5u};
+  assert(kafs_rpc_send_msg(sv[0], KAFS_RPC_OP_READ, KAFS_RPC_FLAG_ENDIAN_HOST, 8u, 1u, 0u, &ref,
+                           sizeof(ref)) == 0);
+  rc = kafs_rpc_recv_msg_fd(sv[1], &hdr, &ref, sizeof(ref), &len, &rx_fd);
+  assert(rc == 0 && hdr.req_id == 8u && rx_fd == -1 && ref.slot == 2u);
+  assert(kafs_rpc_send_msg_fd(sv[0], KAFS_RPC_OP_READ, KAFS_RPC_FLAG_ENDIAN_HOST, 9u, 1u, 0u, &ref,
+                              sizeof(ref), front.rs_fd) == 0);
+  rc = kafs_rpc_recv_msg(sv[1], &hdr, &ref, sizeof(ref), &len);
+  assert(rc == 0 && hdr.req_id == 9u && len == sizeof(ref));
+
+  kafs_rpc_shm_destroy(&back);
+  kafs_rpc_shm_destroy(&front);
+  assert(front.rs_base == NULL && front.rs_fd == -1);
+  close(sv[0]);
+  close(sv[1]);
+  printf("rpc_shm OK\n");
+  return 0;
+}
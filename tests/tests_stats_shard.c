@@ -0,0 +1,72 @@
+#include "kafs.h"
+#include "kafs_context.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+  SHARD_THREADS = 8,
+  SHARD_ADDS = 100000,
+};
+
+static kafs_context_t g_ctx;
+
+static void *adder_main(void *arg)
+{
+  (void)arg;
+  for (int i = 0; i < SHARD_ADDS; ++i)
+  {
+    kafs_stat_add(&g_ctx, KAFS_STAT_PWRITE_CALLS, 1u);
+    kafs_stat_add(&g_ctx, KAFS_STAT_PWRITE_BYTES, 4096u);
+    kafs_stat_add_rec(&g_ctx, KAFS_STAT_DIRENT_VIEW_NEXT_CALLS, 1u);
+  }
+  return NULL;
+}
+
+int main(void)
+{
+  memset(&g_ctx, 0, sizeof(g_ctx));
+
+  // Contexts without shards (tools, unit tests) count into the shared fallback slots.
+  kafs_stat_add(&g_ctx, KAFS_STAT_ACCESS_CALLS, 3u);
+  assert(g_ctx.c_stat_fallback[KAFS_STAT_ACCESS_CALLS] == 3u);
+  assert(kafs_stat_sum(&g_ctx, KAFS_STAT_ACCESS_CALLS) == 3u);
+
+  assert(kafs_stat_shards_alloc(&g_ctx.c_stat_shards, &g_ctx.c_stat_shard_mask) == 0);
+  uint32_t shards = g_ctx.c_stat_shard_mask + 1u;
+  assert(shards >= 1u && shards <= KAFS_STAT_SHARDS_MAX && (shards & (shards - 1u)) == 0);
+  assert(((uintptr_t)g_ctx.c_stat_shards % KAFS_STAT_SHARD_ALIGN) == 0);
+  assert(sizeof(kafs_stat_shard_t) % KAFS_STAT_SHARD_ALIGN == 0);
+
+  pthread_t th[SHARD_THREADS];
+  for (int i = 0; i < SHARD_THREADS; ++i)
+    assert(pthread_create(&th[i], NULL, adder_main, NULL) == 0);
+  for (int i = 0; i < SHARD_THREADS; ++i)
+    pthread_join(th[i], NULL);
+
+  // The snapshot sums every shard plus the fallback, so nothing is lost across threads.
+  const uint64_t total = (uint64_t)SHARD_THREADS * SHARD_ADDS;
+  assert(kafs_stat_sum(&g_ctx, KAFS_STAT_PWRITE_CALLS) == total);
+  assert(kafs_stat_sum(&g_ctx, KAFS_STAT_PWRITE_BYTES) == total * 4096u);
+  assert(kafs_stat_sum(&g_ctx, KAFS_STAT_ACCESS_CALLS) == 3u);
+  if (shards > 1u)
+  {
+    // Round-robin assignment spreads the adders over more than one shard.
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < shards; ++i)
+      used += g_ctx.c_stat_shards[i].v[KAFS_STAT_PWRITE_CALLS] != 0;
+    assert(used > 1u);
+  }
+  // Per-record counters only exist when compiled in.
+  assert(kafs_stat_sum(&g_ctx, KAFS_STAT_DIRENT_VIEW_NEXT_CALLS) ==
+         (KAFS_ENABLE_RECORD_STATS ? total : 0u));
+
+  free(g_ctx.c_stat_shards);
+  printf("stats_shard OK shards=%u record=%d\n", shards, KAFS_ENABLE_RECORD_STATS);
+  return 0;
+}
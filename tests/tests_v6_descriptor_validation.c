@@ -1531,12 +1531,13 @@ static int test_allocator_summary_runtime_allocation_mapping(void)
              (size_t)(second->physical_end - second->physical_off));
       ctx.c_alloc_v3_summary_dirty = 0u;
       ctx.c_blo_search = (kafs_blkcnt_t)(second->logical_start - 1u);
-      uint64_t calls_before = ctx.c_stat_blk_alloc_calls;
+      uint64_t calls_before = kafs_stat_sum(&ctx, KAFS_STAT_BLK_ALLOC_CALLS);
       uint64_t writes_before = ctx.c_meta_region_writes[KAFS_META_REGION_ALLOCATOR_SUMMARY];
       kafs_blkcnt_t blo = KAFS_BLO_NONE;
       int rc = kafs_blk_alloc(&ctx, &blo);
       if (rc != 0 || blo != (kafs_blkcnt_t)second->logical_start ||
-          ctx.c_alloc_v3_summary_dirty != 0u || ctx.c_stat_blk_alloc_calls <= calls_before ||
+          ctx.c_alloc_v3_summary_dirty != 0u ||
+          kafs_stat_sum(&ctx, KAFS_STAT_BLK_ALLOC_CALLS) <= calls_before ||
           ctx.c_meta_region_writes[KAFS_META_REGION_ALLOCATOR_SUMMARY] <= writes_before ||
           !kafs_blk_get_usage(&ctx, blo))
         failed = 1;
@@ -2629,11 +2630,11 @@ static int force_one_lock_contention(kafs_context_t *ctx, v6_lock_hold_kind_t ki
 
 static int force_v6_lock_contention(kafs_context_t *ctx, uint32_t bucket)
 {
-  uint64_t hrl_global_before = ctx->c_stat_lock_hrl_global_contended;
-  uint64_t inode_alloc_before = ctx->c_stat_lock_inode_alloc_contended;
-  uint64_t inode_before = ctx->c_stat_lock_inode_contended;
-  uint64_t hrl_bucket_before = ctx->c_stat_lock_hrl_bucket_contended;
-  uint64_t bitmap_before = ctx->c_stat_lock_bitmap_contended;
+  uint64_t hrl_global_before = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_CONTENDED);
+  uint64_t inode_alloc_before = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_ALLOC_CONTENDED);
+  uint64_t inode_before = kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_CONTENDED);
+  uint64_t hrl_bucket_before = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_BUCKET_CONTENDED);
+  uint64_t bitmap_before = kafs_stat_sum(ctx, KAFS_STAT_LOCK_BITMAP_CONTENDED);
 
   if (force_one_lock_contention(ctx, V6_LOCK_HOLD_HRL_GLOBAL, KAFS_INO_ROOTDIR, bucket) != 0 ||
       force_one_lock_contention(ctx, V6_LOCK_HOLD_INODE_ALLOC, KAFS_INO_ROOTDIR, bucket) != 0 ||
@@ -2642,11 +2643,11 @@ static int force_v6_lock_contention(kafs_context_t *ctx, uint32_t bucket)
       force_one_lock_contention(ctx, V6_LOCK_HOLD_BITMAP, KAFS_INO_ROOTDIR, bucket) != 0)
     return -1;
 
-  if (ctx->c_stat_lock_hrl_global_contended <= hrl_global_before ||
-      ctx->c_stat_lock_inode_alloc_contended <= inode_alloc_before ||
-      ctx->c_stat_lock_inode_contended <= inode_before ||
-      ctx->c_stat_lock_hrl_bucket_contended <= hrl_bucket_before ||
-      ctx->c_stat_lock_bitmap_contended <= bitmap_before)
+  if (kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_GLOBAL_CONTENDED) <= hrl_global_before ||
+      kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_ALLOC_CONTENDED) <= inode_alloc_before ||
+      kafs_stat_sum(ctx, KAFS_STAT_LOCK_INODE_CONTENDED) <= inode_before ||
+      kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_BUCKET_CONTENDED) <= hrl_bucket_before ||
+      kafs_stat_sum(ctx, KAFS_STAT_LOCK_BITMAP_CONTENDED) <= bitmap_before)
     return -1;
   return 0;
 }
@@ -2695,8 +2696,8 @@ static int run_v6_concurrent_hrl_mutation(kafs_context_t *ctx)
   for (uint32_t i = 0; i < block_size; ++i)
     block[i] = (unsigned char)(0x33u ^ (i * 17u));
 
-  uint64_t hrl_bucket_acquire_before = ctx->c_stat_lock_hrl_bucket_acquire;
-  uint64_t bitmap_acquire_before = ctx->c_stat_lock_bitmap_acquire;
+  uint64_t hrl_bucket_acquire_before = kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_BUCKET_ACQUIRE);
+  uint64_t bitmap_acquire_before = kafs_stat_sum(ctx, KAFS_STAT_LOCK_BITMAP_ACQUIRE);
   uint64_t hrl_entry_writes_before = ctx->c_meta_region_writes[KAFS_META_REGION_HRL_ENTRIES];
 
   int failed = 0;
@@ -2722,8 +2723,8 @@ static int run_v6_concurrent_hrl_mutation(kafs_context_t *ctx)
   }
 
   if (!failed &&
-      (ctx->c_stat_lock_hrl_bucket_acquire <= hrl_bucket_acquire_before ||
-       ctx->c_stat_lock_bitmap_acquire <= bitmap_acquire_before ||
+      (kafs_stat_sum(ctx, KAFS_STAT_LOCK_HRL_BUCKET_ACQUIRE) <= hrl_bucket_acquire_before ||
+       kafs_stat_sum(ctx, KAFS_STAT_LOCK_BITMAP_ACQUIRE) <= bitmap_acquire_before ||
        ctx->c_meta_region_writes[KAFS_META_REGION_HRL_ENTRIES] <= hrl_entry_writes_before))
     failed = 1;
 
@@ -0,0 +1,128 @@
+#include "kafs.h"
+#include "kafs_context.h"
+#include "kafs_superblock.h"
+#include "kafs_hash.h"
+#include "kafs_rpc.h"
+#include "kafs_sparse.h"
+#include "test_utils.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void test_decode(void)
+{
+  uint8_t buf[sizeof(kafs_rpc_warm_state_t) + 2u * sizeof(kafs_rpc_warm_open_t)];
+  kafs_rpc_warm_state_t ws;
+  memset(&ws, 0, sizeof(ws));
+  ws.magic = KAFS_RPC_WARM_MAGIC;
+  ws.version = KAFS_RPC_WARM_VERSION;
+  ws.journal_seq = 77;
+  ws.open_count = 2;
+  kafs_rpc_warm_open_t o[2] = {{5u, 1u}, {1000u, 3u}};
+  memcpy(buf, &ws, sizeof(ws));
+  memcpy(buf + sizeof(ws), o, sizeof(o));
+
+  kafs_rpc_warm_state_t out;
+  const kafs_rpc_warm_open_t *opens = NULL;
+  assert(kafs_rpc_warm_decode(buf, sizeof(buf), &out, &opens) == 0);
+  assert(out.journal_seq == 77u && out.open_count == 2u);
+  assert(opens[0].ino == 5u && opens[1].ino == 1000u && opens[1].count == 3u);
+
+  // The open table must fill the body exactly.
+  assert(kafs_rpc_warm_decode(buf, sizeof(buf) - 1u, &out, &opens) == -EBADMSG);
+  assert(kafs_rpc_warm_decode(buf, sizeof(ws) - 1u, &out, &opens) == -EBADMSG);
+  ws.open_count = KAFS_RPC_WARM_OPEN_MAX + 1u;
+  memcpy(buf, &ws, sizeof(ws));
+  assert(kafs_rpc_warm_decode(buf, sizeof(buf), &out, &opens) == -EBADMSG);
+  ws.open_count = 0;
+  ws.magic = 0;
+  memcpy(buf, &ws, sizeof(ws));
+  assert(kafs_rpc_warm_decode(buf, sizeof(ws), &out, &opens) == -EBADMSG);
+}
+
+static void test_sparse_next(void)
+{
+  kafs_sparse_u32_t *sp = kafs_sparse_u32_create(5u * KAFS_SPARSE_CHUNK_ELEMS, 0u);
+  assert(sp);
+  uint32_t idx = 0;
+  uint32_t val = 0;
+  assert(kafs_sparse_u32_next(sp, &idx, &val) == 0);
+  *kafs_sparse_u32_slot(sp, 3u) = 2u;
+  *kafs_sparse_u32_slot(sp, 4u * KAFS_SPARSE_CHUNK_ELEMS + 7u) = 1u;
+  (void)kafs_sparse_u32_slot(sp, 2u * KAFS_SPARSE_CHUNK_ELEMS); // allocated, still all zero
+  assert(kafs_sparse_u32_next(sp, &idx, &val) == 1 && idx == 3u && val == 2u);
+  ++idx;
+  assert(kafs_sparse_u32_next(sp, &idx, &val) == 1);
+  assert(idx == 4u * KAFS_SPARSE_CHUNK_ELEMS + 7u && val == 1u);
+  ++idx;
+  assert(kafs_sparse_u32_next(sp, &idx, &val) == 0);
+  kafs_sparse_u32_destroy(sp);
+}
+
+int main(void)
+{
+  test_decode();
+  test_sparse_next();
+
+  if (kafs_test_enter_tmpdir("warm_state") != 0)
+    return 77;
+  const char *img = "./warm_state.img";
+  kafs_context_t ctx;
+  off_t mapsize;
+  assert(kafs_test_mkimg_with_hrl(img, 64 * 1024 * 1024u, 12, 2048, &ctx, &mapsize) == 0);
+
+  // Leave a hole in the middle of the free list.
+  kafs_blksize_t bs = kafs_sb_blksize_get(ctx.c_superblock);
+  char *buf = malloc(bs);
+  kafs_hrid_t h[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    int is_new;
+    kafs_blkcnt_t blo;
+    memset(buf, 'a' + i, bs);
+    assert(kafs_hrl_put(&ctx, buf, &h[i], &is_new, &blo) == 0 && is_new);
+  }
+  assert(kafs_hrl_dec_ref(&ctx, h[1]) == 0);
+
+  // What a cold open rebuilds is what a predecessor hands over.
+  assert(kafs_hrl_open(&ctx) == 0);
+  uint32_t head = ctx.c_hrl_free_head_plus1;
+  uint32_t count = ctx.c_hrl_free_slot_count;
+  assert(head != 0 && count > 0);
+  assert(kafs_hrl_close(&ctx) == 0);
+
+  ctx.c_hrl_free_head_plus1 = 0;
+  ctx.c_hrl_free_slot_count = 0;
+  assert(kafs_hrl_open_warm(&ctx, head, count) == 0);
+  assert(ctx.c_hrl_free_head_plus1 == head && ctx.c_hrl_free_slot_count == count);
+  assert(kafs_hrl_close(&ctx) == 0);
+
+  // A head that is in use (the image changed since) or a count beyond capacity is not trusted:
+  // the list is rebuilt by the scan instead.
+  assert(kafs_hrl_open_warm(&ctx, (uint32_t)h[0] + 1u, count) == -ESTALE);
+  assert(ctx.c_hrl_free_head_plus1 == head && ctx.c_hrl_free_slot_count == count);
+  assert(kafs_hrl_close(&ctx) == 0);
+  assert(kafs_hrl_open_warm(&ctx, head, UINT32_MAX) == -ESTALE);
+  assert(ctx.c_hrl_free_slot_count == count);
+
+  // The adopted list hands out free slots as before.
+  int is_new;
+  kafs_blkcnt_t blo;
+  kafs_hrid_t hn;
+  memset(buf, 'z', bs);
+  assert(kafs_hrl_put(&ctx, buf, &hn, &is_new, &blo) == 0 && is_new);
+  assert(ctx.c_hrl_free_slot_count == count - 1u);
+  assert(kafs_hrl_close(&ctx) == 0);
+
+  munmap(ctx.c_superblock, mapsize);
+  close(ctx.c_fd);
+  unlink(img);
+  free(buf);
+  printf("warm_state OK\n");
+  return 0;
+}